@@ -0,0 +1,272 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+
+namespace
+{
+	double ElapsedNs(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Numbers as JSON takes them; it has no NaN or infinity.
+	std::string JsonNumber(double value)
+	{
+		if (!std::isfinite(value))
+			return "null";
+		char text[32];
+		snprintf(text, sizeof(text), "%.6g", value);
+		return text;
+	}
+
+	std::string JsonString(const std::string& value)
+	{
+		std::string json = "\"";
+		for (char c : value)
+		{
+			switch (c)
+			{
+			case '"': json += "\\\""; break;
+			case '\\': json += "\\\\"; break;
+			case '\n': json += "\\n"; break;
+			case '\t': json += "\\t"; break;
+			default:
+				if ((unsigned char)c < 0x20)
+				{
+					char escape[8];
+					snprintf(escape, sizeof(escape), "\\u%04x", (unsigned)(unsigned char)c);
+					json += escape;
+				}
+				else
+					json += c;
+			}
+		}
+		return json + "\"";
+	}
+}
+
+Benchmark::Benchmark(const std::string& dataDirectory, double minSeconds, uint32 repetitions)
+	: mDataDirectory(dataDirectory), mMinSeconds(minSeconds), mRepetitions((std::max)(repetitions, 1u))
+{
+}
+
+void Benchmark::SetItems(double items, const char* unit)
+{
+	mItems = items;
+	mItemUnit = unit;
+}
+
+void Benchmark::SetBytes(double bytes)
+{
+	mBytes = bytes;
+}
+
+void Benchmark::AddCounter(const std::string& name, double value)
+{
+	Counter counter;
+	counter.Name = name;
+	counter.Value = value;
+	mCounters.push_back(counter);
+}
+
+void Benchmark::Skip(const std::string& reason)
+{
+	mSkipped = true;
+	mSkipReason = reason;
+}
+
+void Benchmark::Measure(const std::function<void()>& iteration)
+{
+	if (mMeasured)
+		throw std::logic_error("Benchmark::Measure called twice");
+	mMeasured = true;
+
+	// The first run warms caches and lazily built state and is not counted.  Batches then
+	// grow until one takes a tenth of a repetition, and the count is scaled from there.
+	iteration();
+
+	const double targetNs = mMinSeconds * 1e9;
+	uint64 batch = 1;
+	double batchNs = 0.0;
+	for (;;)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64 i = 0; i < batch; ++i)
+			iteration();
+		batchNs = ElapsedNs(start);
+		if (batchNs >= targetNs * 0.1 || batch >= (uint64(1) << 40))
+			break;
+		batch *= 10;
+	}
+	mIterations = (std::max)(uint64(1), (uint64)std::ceil(targetNs / (std::max)(batchNs / (double)batch, 1.0)));
+
+	mNsPerIteration.clear();
+	for (uint32 r = 0; r < mRepetitions; ++r)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64 i = 0; i < mIterations; ++i)
+			iteration();
+		mNsPerIteration.push_back(ElapsedNs(start) / (double)mIterations);
+	}
+}
+
+void Benchmark::DoNotOptimize(const void* data)
+{
+	// GCC and Clang are told the pointer escapes into memory the asm may read; MSVC has
+	// no inline asm on x64, so the pointer goes to a volatile store instead.
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "g"(data) : "memory");
+#else
+	static const void* volatile sink;
+	sink = data;
+#endif
+}
+
+void BenchmarkSuite::Add(const std::string& name, Function function)
+{
+	Entry entry;
+	entry.Name = name;
+	entry.Run = std::move(function);
+	mEntries.push_back(std::move(entry));
+}
+
+std::vector<std::string> BenchmarkSuite::Names()const
+{
+	std::vector<std::string> names;
+	for (const Entry& entry : mEntries)
+		names.push_back(entry.Name);
+	return names;
+}
+
+std::vector<BenchmarkSuite::Result> BenchmarkSuite::Run(const Options& options, std::FILE* log)const
+{
+	std::vector<Result> results;
+	for (const Entry& entry : mEntries)
+	{
+		if (!options.Filter.empty() && entry.Name.find(options.Filter) == std::string::npos)
+			continue;
+
+		Result result;
+		result.Name = entry.Name;
+
+		Benchmark benchmark(options.DataDirectory, options.MinSeconds, options.Repetitions);
+		try
+		{
+			entry.Run(benchmark);
+			if (!benchmark.Skipped() && benchmark.NsPerIteration().empty())
+				result.Error = "nothing measured";
+		}
+		catch (const std::exception& e)
+		{
+			result.Error = e.what();
+		}
+
+		result.Skipped = benchmark.Skipped();
+		result.SkipReason = benchmark.SkipReason();
+		result.Counters = benchmark.Counters();
+		if (result.Error.empty() && !result.Skipped)
+		{
+			result.Iterations = benchmark.Iterations();
+			result.NsPerIteration = benchmark.NsPerIteration();
+
+			std::vector<double> sorted = result.NsPerIteration;
+			std::sort(sorted.begin(), sorted.end());
+			const size_t n = sorted.size();
+			result.MinNs = sorted.front();
+			result.MedianNs = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+			for (double ns : sorted)
+				result.MeanNs += ns;
+			result.MeanNs /= (double)n;
+			for (double ns : sorted)
+				result.StdDevNs += (ns - result.MeanNs) * (ns - result.MeanNs);
+			result.StdDevNs = n > 1 ? std::sqrt(result.StdDevNs / (double)(n - 1)) : 0.0;
+
+			result.ItemUnit = benchmark.ItemUnit();
+			if (benchmark.Items() > 0.0)
+				result.ItemsPerSecond = benchmark.Items() * 1e9 / result.MedianNs;
+			if (benchmark.Bytes() > 0.0)
+				result.BytesPerSecond = benchmark.Bytes() * 1e9 / result.MedianNs;
+		}
+
+		if (log != nullptr)
+		{
+			if (!result.Error.empty())
+				fprintf(log, "%-48s error: %s\n", result.Name.c_str(), result.Error.c_str());
+			else if (result.Skipped)
+				fprintf(log, "%-48s skipped: %s\n", result.Name.c_str(), result.SkipReason.c_str());
+			else
+			{
+				fprintf(log, "%-48s %12.1f ns  (min %.1f, sd %.1f%%)", result.Name.c_str(), result.MedianNs,
+					result.MinNs, result.MeanNs > 0.0 ? 100.0 * result.StdDevNs / result.MeanNs : 0.0);
+				if (result.ItemsPerSecond > 0.0)
+					fprintf(log, "  %.3g %s/s", result.ItemsPerSecond, result.ItemUnit.c_str());
+				if (result.BytesPerSecond > 0.0)
+					fprintf(log, "  %.1f MB/s", result.BytesPerSecond / (1024.0 * 1024.0));
+				fprintf(log, "\n");
+			}
+			fflush(log);
+		}
+
+		results.push_back(std::move(result));
+	}
+	return results;
+}
+
+std::string BenchmarkSuite::ToJson(const Context& context, const Options& options, const std::vector<Result>& results)
+{
+	std::string json = "{\n  \"context\": {";
+	json += "\"commit\": " + JsonString(context.Commit);
+	json += ", \"build_type\": " + JsonString(context.BuildType);
+	json += ", \"compiler\": " + JsonString(context.Compiler);
+	json += ", \"date\": " + JsonString(context.Date);
+	json += ", \"hardware_threads\": " + std::to_string(context.HardwareThreads);
+	json += ", \"min_seconds\": " + JsonNumber(options.MinSeconds);
+	json += ", \"repetitions\": " + std::to_string(options.Repetitions);
+	json += ", \"filter\": " + JsonString(options.Filter);
+	json += "},\n  \"benchmarks\": [";
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& result = results[i];
+		json += i == 0 ? "\n    {" : ",\n    {";
+		json += "\"name\": " + JsonString(result.Name);
+		if (!result.Error.empty())
+			json += ", \"error\": " + JsonString(result.Error);
+		else if (result.Skipped)
+			json += ", \"skipped\": " + JsonString(result.SkipReason);
+		else
+		{
+			json += ", \"iterations\": " + std::to_string(result.Iterations);
+			json += ", \"median_ns\": " + JsonNumber(result.MedianNs);
+			json += ", \"min_ns\": " + JsonNumber(result.MinNs);
+			json += ", \"mean_ns\": " + JsonNumber(result.MeanNs);
+			json += ", \"stddev_ns\": " + JsonNumber(result.StdDevNs);
+			json += ", \"repetitions_ns\": [";
+			for (size_t r = 0; r < result.NsPerIteration.size(); ++r)
+				json += (r == 0 ? "" : ", ") + JsonNumber(result.NsPerIteration[r]);
+			json += "]";
+			if (result.ItemsPerSecond > 0.0)
+			{
+				json += ", \"items_per_second\": " + JsonNumber(result.ItemsPerSecond);
+				json += ", \"item_unit\": " + JsonString(result.ItemUnit);
+			}
+			if (result.BytesPerSecond > 0.0)
+				json += ", \"bytes_per_second\": " + JsonNumber(result.BytesPerSecond);
+		}
+		if (!result.Counters.empty())
+		{
+			json += ", \"counters\": {";
+			for (size_t c = 0; c < result.Counters.size(); ++c)
+				json += (c == 0 ? "" : ", ") + JsonString(result.Counters[c].Name) + ": " + JsonNumber(result.Counters[c].Value);
+			json += "}";
+		}
+		json += "}";
+	}
+
+	json += "\n  ]\n}\n";
+	return json;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// One benchmark while it runs.  The function registered with the suite prepares its
+// input, then hands Measure() the work of one iteration.  Measure() finds how many
+// iterations make a batch long enough to time, then times that many iterations once per
+// repetition; each repetition gives a time per iteration.
+//
+// Whatever an iteration computes must reach memory through DoNotOptimize() or be
+// otherwise observable, or the compiler may drop the work.
+class Benchmark
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Counter
+	{
+		std::string Name;
+		double Value = 0.0;
+	};
+
+	Benchmark(const std::string& dataDirectory, double minSeconds, uint32 repetitions);
+	Benchmark(const Benchmark& rhs) = delete;
+	Benchmark& operator=(const Benchmark& rhs) = delete;
+
+	// The repository root, for the textures and models the benchmarks read.
+	const std::string& DataDirectory()const { return mDataDirectory; }
+
+	// What one iteration processes, reported per second.
+	void SetItems(double items, const char* unit);
+	void SetBytes(double bytes);
+	// Any other figure worth tracking across commits, reported as is.
+	void AddCounter(const std::string& name, double value);
+
+	// Gives up on the benchmark, for instance when its input is missing.
+	void Skip(const std::string& reason);
+	bool Skipped()const { return mSkipped; }
+	const std::string& SkipReason()const { return mSkipReason; }
+
+	// Only once per benchmark.  Throws std::logic_error on a second call.
+	void Measure(const std::function<void()>& iteration);
+
+	uint64 Iterations()const { return mIterations; }
+	const std::vector<double>& NsPerIteration()const { return mNsPerIteration; }
+	double Items()const { return mItems; }
+	const std::string& ItemUnit()const { return mItemUnit; }
+	double Bytes()const { return mBytes; }
+	const std::vector<Counter>& Counters()const { return mCounters; }
+
+	// An opaque call the optimizer cannot see through, so the memory behind 'data' must
+	// be written before it.
+	static void DoNotOptimize(const void* data);
+
+private:
+	std::string mDataDirectory;
+	double mMinSeconds = 0.0; // per repetition
+	uint32 mRepetitions = 0;
+
+	bool mMeasured = false;
+	bool mSkipped = false;
+	std::string mSkipReason;
+
+	uint64 mIterations = 0; // per repetition
+	std::vector<double> mNsPerIteration;
+
+	double mItems = 0.0;
+	std::string mItemUnit;
+	double mBytes = 0.0;
+	std::vector<Counter> mCounters;
+};
+
+// Named benchmarks, run in the order they were added, and the JSON they report.
+// Names are "group/name/parameters", so a filter can pick a group or a single case.
+class BenchmarkSuite
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	using Function = std::function<void(Benchmark&)>;
+
+	struct Options
+	{
+		double MinSeconds = 0.1; // per repetition
+		uint32 Repetitions = 5;
+		std::string Filter;      // runs the names containing it; empty runs all
+		std::string DataDirectory;
+	};
+
+	struct Result
+	{
+		std::string Name;
+		bool Skipped = false;
+		std::string SkipReason;
+		std::string Error; // what the benchmark threw
+
+		uint64 Iterations = 0; // per repetition
+		std::vector<double> NsPerIteration;
+		double MinNs = 0.0;
+		double MedianNs = 0.0;
+		double MeanNs = 0.0;
+		double StdDevNs = 0.0;
+
+		double ItemsPerSecond = 0.0; // at the median
+		std::string ItemUnit;
+		double BytesPerSecond = 0.0;
+		std::vector<Benchmark::Counter> Counters;
+	};
+
+	// Where the results came from, recorded alongside them.
+	struct Context
+	{
+		std::string Commit;
+		std::string BuildType;
+		std::string Compiler;
+		std::string Date; // UTC, ISO 8601
+		uint32 HardwareThreads = 0;
+	};
+
+	void Add(const std::string& name, Function function);
+	std::vector<std::string> Names()const;
+
+	// Runs the benchmarks 'options' selects, a line each to 'log' if not null.  A
+	// benchmark that throws is reported with the error rather than stopping the run.
+	std::vector<Result> Run(const Options& options, std::FILE* log)const;
+
+	static std::string ToJson(const Context& context, const Options& options, const std::vector<Result>& results);
+
+private:
+	struct Entry
+	{
+		std::string Name;
+		Function Run;
+	};
+
+	std::vector<Entry> mEntries;
+};
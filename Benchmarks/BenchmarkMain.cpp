@@ -0,0 +1,166 @@
+//***************************************************************************************
+// BenchmarkMain.cpp
+//
+// Runs the CPU-side benchmarks and writes their results as JSON, to stdout or a file.
+// Progress goes to stderr.
+//
+//   RadianceTransferBenchmarks [--filter=<text>] [--out=<file>] [--repetitions=<n>]
+//                              [--min-time=<seconds>] [--data=<dir>] [--commit=<id>]
+//                              [--list]
+//***************************************************************************************
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "Benchmarks.h"
+#include "../Common/FileUtil.h"
+
+#ifndef BENCHMARK_GIT_COMMIT
+#define BENCHMARK_GIT_COMMIT "unknown"
+#endif
+#ifndef BENCHMARK_BUILD_TYPE
+#define BENCHMARK_BUILD_TYPE "unknown"
+#endif
+#ifndef BENCHMARK_DATA_DIR
+#define BENCHMARK_DATA_DIR "."
+#endif
+
+namespace
+{
+	bool StartsWith(const std::string& s, const char* prefix, std::string* rest)
+	{
+		const std::string p(prefix);
+		if (s.compare(0, p.size(), p) != 0)
+			return false;
+		*rest = s.substr(p.size());
+		return true;
+	}
+
+	std::string CompilerName()
+	{
+#if defined(__clang__)
+		return "clang " __clang_version__;
+#elif defined(__GNUC__)
+		return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+		return "unknown";
+#endif
+	}
+
+	std::string UtcDate()
+	{
+		const std::time_t now = std::time(nullptr);
+		std::tm utc = {};
+#ifdef _WIN32
+		gmtime_s(&utc, &now);
+#else
+		gmtime_r(&now, &utc);
+#endif
+		char buffer[32];
+		std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+		return buffer;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: RadianceTransferBenchmarks [--filter=<text>] [--out=<file>] [--repetitions=<n>]\n"
+			"                                  [--min-time=<seconds>] [--data=<dir>] [--commit=<id>] [--list]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkSuite suite;
+	AddSHBenchmarks(suite);
+	AddGeometryBenchmarks(suite);
+	AddModelBenchmarks(suite);
+	AddTextureBenchmarks(suite);
+	AddTransformBenchmarks(suite);
+	AddRaytracingBenchmarks(suite);
+	AddProbeBenchmarks(suite);
+	AddJobBenchmarks(suite);
+	AddMemoryBenchmarks(suite);
+	AddShaderBenchmarks(suite);
+
+	BenchmarkSuite::Options options;
+	options.DataDirectory = BENCHMARK_DATA_DIR;
+
+	BenchmarkSuite::Context context;
+	context.Commit = BENCHMARK_GIT_COMMIT;
+	context.BuildType = BENCHMARK_BUILD_TYPE;
+	context.Compiler = CompilerName();
+	context.Date = UtcDate();
+	context.HardwareThreads = std::thread::hardware_concurrency();
+
+	std::string outPath;
+	bool list = false;
+	try
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			std::string value;
+			if (StartsWith(arg, "--filter=", &value))
+				options.Filter = value;
+			else if (StartsWith(arg, "--out=", &value))
+				outPath = value;
+			else if (StartsWith(arg, "--repetitions=", &value))
+				options.Repetitions = (BenchmarkSuite::uint32)std::stoul(value);
+			else if (StartsWith(arg, "--min-time=", &value))
+				options.MinSeconds = std::stod(value);
+			else if (StartsWith(arg, "--data=", &value))
+				options.DataDirectory = value;
+			else if (StartsWith(arg, "--commit=", &value))
+				context.Commit = value;
+			else if (arg == "--list")
+				list = true;
+			else
+			{
+				PrintUsage();
+				return 2;
+			}
+		}
+	}
+	catch (const std::exception&)
+	{
+		PrintUsage();
+		return 2;
+	}
+	if (options.Repetitions == 0 || options.MinSeconds < 0.0)
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	if (list)
+	{
+		for (const std::string& name : suite.Names())
+			std::printf("%s\n", name.c_str());
+		return 0;
+	}
+
+	const std::vector<BenchmarkSuite::Result> results = suite.Run(options, stderr);
+	const std::string json = BenchmarkSuite::ToJson(context, options, results);
+
+	if (outPath.empty())
+		std::fwrite(json.data(), 1, json.size(), stdout);
+	else if (!FileUtil::WriteFileAtomic(outPath, json.data(), json.size()))
+	{
+		std::fprintf(stderr, "could not write %s\n", outPath.c_str());
+		return 1;
+	}
+
+	for (const BenchmarkSuite::Result& result : results)
+	{
+		if (!result.Error.empty())
+			return 1;
+	}
+	return 0;
+}
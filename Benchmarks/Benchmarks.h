@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Benchmark.h"
+
+// The benchmarks of each area; main() adds them all.
+void AddSHBenchmarks(BenchmarkSuite& suite);
+void AddGeometryBenchmarks(BenchmarkSuite& suite);
+void AddModelBenchmarks(BenchmarkSuite& suite);
+void AddTextureBenchmarks(BenchmarkSuite& suite);
+void AddTransformBenchmarks(BenchmarkSuite& suite);
+void AddRaytracingBenchmarks(BenchmarkSuite& suite);
+void AddProbeBenchmarks(BenchmarkSuite& suite);
+void AddJobBenchmarks(BenchmarkSuite& suite);
+void AddMemoryBenchmarks(BenchmarkSuite& suite);
+void AddShaderBenchmarks(BenchmarkSuite& suite);
@@ -0,0 +1,123 @@
+#include "Benchmarks.h"
+
+#include "../Common/GeometryGenerator.h"
+#include "../RadianceTransfer_impl/MeshOptimizer.h"
+#include "../RadianceTransfer_impl/MeshSimplifier.h"
+#include "../RadianceTransfer_impl/Meshlets.h"
+#include "../RadianceTransfer_impl/VertexPacking.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using MeshData = GeometryGenerator::MeshData;
+
+	void AddShape(BenchmarkSuite& suite, const std::string& name, std::function<MeshData()> create)
+	{
+		suite.Add("geometry/" + name, [create](Benchmark& b)
+		{
+			const MeshData reference = create();
+			b.SetItems((double)reference.Vertices.size(), "vertices");
+			b.AddCounter("vertices", (double)reference.Vertices.size());
+			b.AddCounter("indices", (double)reference.Indices32.size());
+			b.Measure([&]()
+			{
+				MeshData mesh = create();
+				Benchmark::DoNotOptimize(mesh.Vertices.data());
+			});
+		});
+	}
+
+	const float* Positions(const MeshData& mesh)
+	{
+		return &mesh.Vertices[0].Position.x;
+	}
+}
+
+void AddGeometryBenchmarks(BenchmarkSuite& suite)
+{
+	// Shapes at the sizes the scenes use and well beyond.
+	AddShape(suite, "box/subdivisions=6", []() { return GeometryGenerator().CreateBox(1.0f, 1.0f, 1.0f, 6); });
+	AddShape(suite, "sphere/512x512", []() { return GeometryGenerator().CreateSphere(0.5f, 512, 512); });
+	AddShape(suite, "geosphere/subdivisions=6", []() { return GeometryGenerator().CreateGeosphere(0.5f, 6); });
+	AddShape(suite, "cylinder/512x512", []() { return GeometryGenerator().CreateCylinder(0.5f, 0.3f, 3.0f, 512, 512); });
+	AddShape(suite, "grid/1024x1024", []() { return GeometryGenerator().CreateGrid(10.0f, 10.0f, 1024, 1024); });
+
+	// What the scene loader does to each mesh after creating it.
+	suite.Add("mesh/optimize/sphere_256x256", [](Benchmark& b)
+	{
+		const MeshData reference = GeometryGenerator().CreateSphere(0.5f, 256, 256);
+		b.SetItems((double)reference.Indices32.size() / 3, "triangles");
+		b.Measure([&]()
+		{
+			MeshData mesh = reference;
+			MeshOptimizer::OptimizeMesh(mesh, {});
+			Benchmark::DoNotOptimize(mesh.Indices32.data());
+		});
+	});
+
+	suite.Add("mesh/simplify_half/sphere_128x128", [](Benchmark& b)
+	{
+		const MeshData mesh = GeometryGenerator().CreateSphere(0.5f, 128, 128);
+		b.SetItems((double)mesh.Indices32.size() / 3, "triangles");
+		b.Measure([&]()
+		{
+			std::vector<uint32> indices = MeshSimplifier::Simplify(mesh.Vertices.data(), mesh.Vertices.size(),
+				mesh.Indices32.data(), mesh.Indices32.size(), mesh.Indices32.size() / 2, 1e30f);
+			Benchmark::DoNotOptimize(indices.data());
+		});
+	});
+
+	suite.Add("mesh/build_meshlets/sphere_256x256", [](Benchmark& b)
+	{
+		const MeshData mesh = GeometryGenerator().CreateSphere(0.5f, 256, 256);
+		b.SetItems((double)mesh.Indices32.size() / 3, "triangles");
+		b.Measure([&]()
+		{
+			std::vector<Meshlets::Meshlet> meshlets = Meshlets::BuildMeshlets(mesh.Indices32.data(), mesh.Indices32.size(),
+				Positions(mesh), sizeof(GeometryGenerator::Vertex), mesh.Vertices.size());
+			Benchmark::DoNotOptimize(meshlets.data());
+		});
+	});
+
+	suite.Add("mesh/cull_meshlets/sphere_256x256", [](Benchmark& b)
+	{
+		const MeshData mesh = GeometryGenerator().CreateSphere(0.5f, 256, 256);
+		const std::vector<Meshlets::Meshlet> meshlets = Meshlets::BuildMeshlets(mesh.Indices32.data(),
+			mesh.Indices32.size(), Positions(mesh), sizeof(GeometryGenerator::Vertex), mesh.Vertices.size());
+
+		// Looking down +z from z = -2 through a 90 degree frustum, so about half the
+		// sphere faces away.
+		DirectX::XMFLOAT4X4 objectToClip;
+		DirectX::XMStoreFloat4x4(&objectToClip,
+			DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0.0f, 0.0f, -2.0f, 1.0f),
+				DirectX::XMVectorZero(), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+			DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV2, 1.0f, 0.1f, 100.0f));
+		const Meshlets::Frustum frustum = Meshlets::ExtractFrustum(objectToClip);
+		const DirectX::XMFLOAT3 eye(0.0f, 0.0f, -2.0f);
+
+		std::vector<Meshlets::DrawIndexedArgs> draws;
+		const Meshlets::CullStats stats = Meshlets::CullMeshlets(meshlets, frustum, eye, &draws);
+		b.SetItems((double)meshlets.size(), "meshlets");
+		b.AddCounter("culled", (double)(stats.FrustumCulled + stats.BackfaceCulled));
+		b.Measure([&]()
+		{
+			draws.clear();
+			Meshlets::CullStats culled = Meshlets::CullMeshlets(meshlets, frustum, eye, &draws);
+			Benchmark::DoNotOptimize(&culled);
+		});
+	});
+
+	suite.Add("mesh/pack_vertices/sphere_256x256", [](Benchmark& b)
+	{
+		const MeshData mesh = GeometryGenerator().CreateSphere(0.5f, 256, 256);
+		const VertexPacking::PositionDequantization dq =
+			VertexPacking::ComputeDequantization(mesh.Vertices.data(), mesh.Vertices.size());
+		b.SetItems((double)mesh.Vertices.size(), "vertices");
+		b.Measure([&]()
+		{
+			std::vector<VertexPacking::PackedVertex> packed =
+				VertexPacking::PackVertices(mesh.Vertices.data(), mesh.Vertices.size(), dq);
+			Benchmark::DoNotOptimize(packed.data());
+		});
+	});
+}
@@ -0,0 +1,157 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "../Common/JobSystem.h"
+#include "../Common/Profiler.h"
+#include "../RadianceTransfer_impl/NullPassRecordingDevice.h"
+#include "../RadianceTransfer_impl/PassRecorder.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// Some arithmetic per item, so ParallelFor has work to split.
+	float Work(uint32 i, uint32 rounds)
+	{
+		float x = (float)i;
+		for (uint32 r = 0; r < rounds; ++r)
+			x = std::sqrt(x * 1.0001f + 1.0f);
+		return x;
+	}
+
+	// How often the scheduler had to steal and found a queue lock taken, per call of
+	// the measured function; ResetStats() must precede Measure().
+	void AddSchedulerCounters(Benchmark& b, const JobSystem& jobs, uint32 calls)
+	{
+		const JobSystem::Stats stats = jobs.GetStats();
+		const double perCall = 1.0 / (double)(std::max)(calls, 1u);
+		b.AddCounter("workers", jobs.WorkerCount());
+		b.AddCounter("steals", (double)stats.Steals * perCall);
+		b.AddCounter("failed_steals", (double)stats.FailedSteals * perCall);
+		b.AddCounter("lock_contentions", (double)stats.LockContentions * perCall);
+	}
+}
+
+void AddJobBenchmarks(BenchmarkSuite& suite)
+{
+	// The cost of a job itself: spawned and waited for one at a time, and as children
+	// of one parent.
+	suite.Add("jobs/spawn_wait", [](Benchmark& b)
+	{
+		JobSystem jobs;
+		std::atomic<uint32> counter{ 0 };
+		b.SetItems(1, "jobs");
+		b.Measure([&]()
+		{
+			jobs.Wait(jobs.Spawn([&]() { counter.fetch_add(1, std::memory_order_relaxed); }));
+		});
+	});
+
+	suite.Add("jobs/children=1024", [](Benchmark& b)
+	{
+		JobSystem jobs;
+		std::atomic<uint32> counter{ 0 };
+		uint32 calls = 0;
+		b.SetItems(1024, "jobs");
+		jobs.ResetStats();
+		b.Measure([&]()
+		{
+			++calls;
+			JobSystem::JobHandle parent = jobs.Create([]() {});
+			for (uint32 i = 0; i < 1024; ++i)
+				jobs.Run(jobs.CreateChild(parent, [&]() { counter.fetch_add(1, std::memory_order_relaxed); }));
+			jobs.Run(parent);
+			jobs.Wait(parent);
+		});
+		AddSchedulerCounters(b, jobs, calls);
+	});
+
+	for (uint32 grain : { 64u, 1024u })
+	{
+		suite.Add("jobs/parallel_for/items=262144/grain=" + std::to_string(grain), [grain](Benchmark& b)
+		{
+			const uint32 count = 262144;
+			JobSystem jobs;
+			std::vector<float> out(count);
+			uint32 calls = 0;
+			b.SetItems(count, "items");
+			jobs.ResetStats();
+			b.Measure([&]()
+			{
+				++calls;
+				jobs.ParallelFor(count, grain, [&](uint32 first, uint32 last)
+				{
+					for (uint32 i = first; i < last; ++i)
+						out[i] = Work(i, 16);
+				});
+				Benchmark::DoNotOptimize(out.data());
+			});
+			AddSchedulerCounters(b, jobs, calls);
+		});
+	}
+
+	// A frame of passes on NullPassRecordingDevice, each writing 'commands' small
+	// commands, recorded one after the other and on the job system.
+	for (bool parallel : { false, true })
+	{
+		const std::string name = std::string("pass_recorder/passes=16/commands=2000/") + (parallel ? "parallel" : "serial");
+		suite.Add(name, [parallel](Benchmark& b)
+		{
+			const uint32 passes = 16;
+			const uint32 commands = 2000;
+			JobSystem jobs;
+			NullPassRecordingDevice device;
+			PassRecorder recorder(device, jobs);
+
+			b.SetItems(passes, "passes");
+			b.Measure([&]()
+			{
+				for (uint32 p = 0; p < passes; ++p)
+				{
+					recorder.AddPass("Pass", [&device, p](uint32 list)
+					{
+						for (uint32 c = 0; c < commands; ++c)
+						{
+							const uint32 command[4] = { p, c, (uint32)Work(c, 4), 0 };
+							device.Write(list, command, sizeof(command));
+						}
+					});
+				}
+				recorder.Execute(parallel);
+			});
+		});
+	}
+
+	// What a profiler scope costs enabled, disabled and absent, as the app's passes pay
+	// it whether or not anyone looks.
+	for (int mode = 0; mode < 3; ++mode)
+	{
+		static const char* const modes[] = { "enabled", "disabled", "null" };
+		suite.Add(std::string("profiler/scope/") + modes[mode], [mode](Benchmark& b)
+		{
+			const uint32 scopes = 1000;
+			std::unique_ptr<Profiler> profiler(mode == 2 ? nullptr : new Profiler());
+			if (profiler)
+				profiler->SetEnabled(mode == 0);
+
+			b.SetItems(scopes, "scopes");
+			b.Measure([&]()
+			{
+				if (profiler)
+					profiler->BeginFrame();
+				for (uint32 i = 0; i < scopes; ++i)
+				{
+					Profiler::Scope outer(profiler.get(), "Outer");
+					Profiler::Scope inner(profiler.get(), "Inner");
+				}
+				if (profiler)
+					profiler->EndFrame();
+			});
+		});
+	}
+}
@@ -0,0 +1,145 @@
+#include "Benchmarks.h"
+
+#include <random>
+#include <vector>
+
+#include "../RadianceTransfer_impl/DescriptorAllocator.h"
+#include "../RadianceTransfer_impl/GpuMemoryAllocator.h"
+#include "../RadianceTransfer_impl/MockGpuMemoryDevice.h"
+#include "../RadianceTransfer_impl/MockUploadMemoryDevice.h"
+#include "../RadianceTransfer_impl/UploadAllocator.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Frames in flight, as in the app: the fence of frame n completes at frame n + 3.
+	const uint64 kFramesInFlight = 3;
+}
+
+void AddMemoryBenchmarks(BenchmarkSuite& suite)
+{
+	// A frame of constant buffers, as the app pushes them: one slice per object and pass.
+	suite.Add("memory/upload_frame/constants=4096", [](Benchmark& b)
+	{
+		const uint32 count = 4096;
+		MockUploadMemoryDevice device;
+		UploadAllocator allocator(device, 4 * 1024 * 1024);
+		uint64 fence = 0;
+		float constants[64] = {};
+
+		b.SetItems(count, "allocations");
+		b.SetBytes((double)count * sizeof(constants));
+		b.Measure([&]()
+		{
+			allocator.BeginFrame(fence >= kFramesInFlight ? fence - kFramesInFlight : 0);
+			for (uint32 i = 0; i < count; ++i)
+			{
+				constants[0] = (float)i;
+				Benchmark::DoNotOptimize(allocator.Push(constants).CpuAddress);
+			}
+			allocator.EndFrame(++fence);
+		});
+	});
+
+	// Placed resources of mixed sizes coming and going, each retired and freed a few
+	// frames later as texture streaming does.
+	suite.Add("memory/gpu_allocator/churn", [](Benchmark& b)
+	{
+		const uint32 perFrame = 64;
+		MockGpuMemoryDevice device;
+		GpuMemoryAllocator allocator(device, 64ull * 1024 * 1024);
+		std::mt19937 random(11);
+		std::uniform_int_distribution<uint32> granules(1, 64);
+		std::vector<GpuMemoryAllocator::Allocation> live;
+		uint64 fence = 0;
+
+		b.SetItems(perFrame * 2, "operations");
+		b.Measure([&]()
+		{
+			allocator.BeginFrame(fence >= kFramesInFlight ? fence - kFramesInFlight : 0);
+			for (uint32 i = 0; i < perFrame; ++i)
+			{
+				const GpuMemoryClass memoryClass = i % 2 ? GpuMemoryClass::Texture : GpuMemoryClass::Buffer;
+				live.push_back(allocator.Allocate(memoryClass, granules(random) * GpuMemoryAllocator::Granularity, GpuMemoryAllocator::Granularity, true));
+			}
+			// Keeps about 4096 alive, retiring random ones.
+			while (live.size() > 4096)
+			{
+				const size_t victim = random() % live.size();
+				allocator.Retire(live[victim]);
+				live[victim] = live.back();
+				live.pop_back();
+			}
+			allocator.EndFrame(++fence);
+		});
+
+		const GpuMemoryAllocator::Stats stats = allocator.GetStats(GpuMemoryClass::Texture);
+		b.AddCounter("texture_heaps", stats.Heaps);
+		b.AddCounter("texture_fragmentation", stats.Fragmentation);
+	});
+
+	suite.Add("memory/gpu_allocator/plan_defragmentation", [](Benchmark& b)
+	{
+		MockGpuMemoryDevice device;
+		std::mt19937 random(13);
+		std::uniform_int_distribution<uint32> granules(1, 32);
+
+		b.Measure([&]()
+		{
+			// Fills heaps, then frees every other allocation so most heaps are half empty.
+			GpuMemoryAllocator allocator(device, 16ull * 1024 * 1024);
+			std::vector<GpuMemoryAllocator::Allocation> allocations;
+			for (uint32 i = 0; i < 2048; ++i)
+				allocations.push_back(allocator.Allocate(GpuMemoryClass::Texture, granules(random) * GpuMemoryAllocator::Granularity, GpuMemoryAllocator::Granularity, true));
+			for (size_t i = 0; i < allocations.size(); i += 2)
+				allocator.Free(allocations[i]);
+
+			const std::vector<GpuMemoryAllocator::Move> moves =
+				allocator.PlanDefragmentation(GpuMemoryClass::Texture, 256ull * 1024 * 1024);
+			Benchmark::DoNotOptimize(moves.data());
+		});
+	});
+
+	// Persistent descriptor ranges allocated and freed at random, then the frame's tables
+	// and the copy of what changed to the shader-visible heap.
+	suite.Add("memory/descriptors/frame", [](Benchmark& b)
+	{
+		const uint32 perFrame = 256;
+		DescriptorAllocator allocator(65536, 16384);
+		std::mt19937 random(17);
+		std::uniform_int_distribution<uint32> counts(1, 8);
+		std::vector<DescriptorAllocator::Range> live;
+		std::vector<DescriptorAllocator::Range> runs;
+		uint64 fence = 0;
+
+		b.SetItems(perFrame, "ranges");
+		b.Measure([&]()
+		{
+			allocator.BeginFrame(fence >= kFramesInFlight ? fence - kFramesInFlight : 0);
+			for (uint32 i = 0; i < perFrame; ++i)
+			{
+				live.push_back(allocator.Allocate(counts(random)));
+				allocator.MarkDirty(live.back());
+			}
+			while (live.size() > 4096)
+			{
+				const size_t victim = random() % live.size();
+				allocator.Free(live[victim]);
+				live[victim] = live.back();
+				live.pop_back();
+			}
+			for (uint32 i = 0; i < 64; ++i)
+			{
+				const DescriptorAllocator::Range table = allocator.AllocateTransient(counts(random));
+				Benchmark::DoNotOptimize(&table);
+			}
+
+			runs.clear();
+			allocator.TakeDirtyRuns(&runs);
+			allocator.EndFrame(++fence);
+		});
+		b.AddCounter("copy_runs", allocator.GetStats().CopyRuns);
+	});
+}
@@ -0,0 +1,80 @@
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+#include "../Common/FileUtil.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/JobSystem.h"
+#include "../RadianceTransfer_impl/MeshCache.h"
+
+#ifdef BENCHMARK_HAVE_ASSIMP
+#include "../RadianceTransfer_impl/Model.h"
+#endif
+
+void AddModelBenchmarks(BenchmarkSuite& suite)
+{
+	// The cold start path: assimp parsing and post-processing plus the merge into one
+	// MeshData, whose meshes are filled in on a JobSystem as the app does, or serially.
+	for (std::uint32_t threads : { 1u, 0u })
+	{
+		suite.Add("model/import/nanosuit/threads=" + std::string(threads == 0 ? "all" : std::to_string(threads)),
+			[threads](Benchmark& b)
+		{
+#ifdef BENCHMARK_HAVE_ASSIMP
+			const std::string path = b.DataDirectory() + "/RadianceTransfer_impl/Models/nanosuit/nanosuit.obj";
+			if (!FileUtil::FileExists(path))
+			{
+				b.Skip(path + " not found");
+				return;
+			}
+
+			std::unique_ptr<JobSystem> jobs(threads == 0 ? new JobSystem() : nullptr);
+			{
+				Model model(path, jobs.get());
+				b.SetItems((double)model.CreateModel().Vertices.size(), "vertices");
+			}
+			b.Measure([&]()
+			{
+				Model model(path, jobs.get());
+				Benchmark::DoNotOptimize(&model);
+			});
+#else
+			(void)threads;
+			b.Skip("built without assimp");
+#endif
+		});
+	}
+
+	// The warm start path: mapping and validating a mesh cache instead of importing.
+	suite.Add("model/cache_open/grid_1024x1024", [](Benchmark& b)
+	{
+		const std::string key = "benchmark grid 10 10 1024 1024";
+		const std::string path = "benchmark_grid.meshcache";
+		const GeometryGenerator::MeshData mesh = GeometryGenerator().CreateGrid(10.0f, 10.0f, 1024, 1024);
+
+		MeshCache::Submesh submesh;
+		submesh.Name = "grid";
+		submesh.IndexCount = (MeshCache::uint32)mesh.Indices32.size();
+		submesh.VertexCount = (MeshCache::uint32)mesh.Vertices.size();
+		if (!MeshCache::WriteForKey(path, key, mesh, { submesh }))
+		{
+			b.Skip("cannot write " + path);
+			return;
+		}
+
+		// The file is mapped, not read, so this is the cost of a warm start rather than
+		// of moving the bytes; their amount is only recorded.
+		b.AddCounter("megabytes", (mesh.Vertices.size() * sizeof(GeometryGenerator::Vertex) + mesh.Indices32.size() * 4) / (1024.0 * 1024.0));
+		b.Measure([&]()
+		{
+			MeshCache cache;
+			if (cache.OpenForKey(path, key) != MeshCache::Result::Hit)
+				throw std::runtime_error("mesh cache rejected its own file");
+			Benchmark::DoNotOptimize(cache.Vertices());
+		});
+
+		std::remove(path.c_str());
+	});
+}
@@ -0,0 +1,123 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "../Common/GeometryGenerator.h"
+#include "../RadianceTransfer_impl/CpuRayCaster.h"
+#include "../RadianceTransfer_impl/ProbeVolume.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// A ground plane with a box on it, the layout of the default scene.
+	void BuildScene(CpuRayCaster& caster)
+	{
+		GeometryGenerator geometry;
+		const GeometryGenerator::MeshData grid = geometry.CreateGrid(10.0f, 10.0f, 32, 32);
+		const GeometryGenerator::MeshData box = geometry.CreateBox(1.5f, 1.5f, 1.5f, 3);
+		const XMFLOAT4X4 gridWorld(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0.5f, -2.0f, 2.5f, 1);
+		const XMFLOAT4X4 boxWorld(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0.0f, 0.0f, 2.3f, 1);
+		caster.AddMesh(grid.Vertices.data(), grid.Indices32.data(), grid.Indices32.size(), gridWorld);
+		caster.AddMesh(box.Vertices.data(), box.Indices32.data(), box.Indices32.size(), boxWorld);
+		caster.Build();
+	}
+
+	ProbeVolume::Desc VolumeDesc(uint32 countPerAxis)
+	{
+		ProbeVolume::Desc desc;
+		desc.Origin = XMFLOAT3(-4.5f, -1.5f, -2.5f);
+		const float spacing = 10.0f / countPerAxis;
+		desc.Spacing = XMFLOAT3(spacing, spacing, spacing);
+		desc.Counts[0] = desc.Counts[1] = desc.Counts[2] = countPerAxis;
+		return desc;
+	}
+
+	// A sky brighter overhead.
+	void SkySH(float sh[ProbeVolume::SHCount * 3])
+	{
+		for (uint32 i = 0; i < ProbeVolume::SHCount * 3; ++i)
+			sh[i] = 0.0f;
+		for (uint32 c = 0; c < 3; ++c)
+		{
+			sh[c] = 3.0f;
+			sh[2 * 3 + c] = 1.0f;
+		}
+	}
+}
+
+void AddProbeBenchmarks(BenchmarkSuite& suite)
+{
+	// One frame of ProbeVolume::Update at the default ray budget: the same rays however
+	// many probes there are, which only changes how often each one is reached.
+	for (uint32 countPerAxis : { 8u, 16u })
+	{
+		suite.Add("probes/update/probes=" + std::to_string(countPerAxis * countPerAxis * countPerAxis),
+			[countPerAxis](Benchmark& b)
+		{
+			CpuRayCaster caster;
+			BuildScene(caster);
+			ProbeVolume volume(VolumeDesc(countPerAxis));
+			float sky[ProbeVolume::SHCount * 3];
+			SkySH(sky);
+			const ProbeVolume::Tracer tracer = [&caster](const XMFLOAT3& origin, const XMFLOAT3& direction,
+				float tMax, float* t)
+			{
+				return caster.Intersect(origin, direction, 0.0f, tMax, t);
+			};
+
+			b.SetItems((double)volume.ProbesPerFrame() * volume.GetDesc().RaysPerProbe, "rays");
+			b.AddCounter("frames_per_sweep", volume.FramesPerSweep());
+			std::uint64_t frame = 0;
+			b.Measure([&]()
+			{
+				volume.Update(frame++, tracer, sky);
+				Benchmark::DoNotOptimize(volume.Radiance(0));
+			});
+		});
+	}
+
+	// What ProbeShade.hlsl does per pixel: eight probes, their SH and distance moments.
+	suite.Add("probes/irradiance", [](Benchmark& b)
+	{
+		CpuRayCaster caster;
+		BuildScene(caster);
+		ProbeVolume volume(VolumeDesc(8));
+		float sky[ProbeVolume::SHCount * 3];
+		SkySH(sky);
+		const ProbeVolume::Tracer tracer = [&caster](const XMFLOAT3& origin, const XMFLOAT3& direction,
+			float tMax, float* t)
+		{
+			return caster.Intersect(origin, direction, 0.0f, tMax, t);
+		};
+		for (uint32 frame = 0; frame < volume.FramesPerSweep(); ++frame)
+			volume.Update(frame, tracer, sky);
+
+		const uint32 count = 4096;
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-4.5f, 5.5f);
+		std::normal_distribution<float> normal;
+		std::vector<XMFLOAT3> points(count);
+		std::vector<XMFLOAT3> normals(count);
+		for (uint32 i = 0; i < count; ++i)
+		{
+			points[i] = XMFLOAT3(position(random), position(random) * 0.5f + 1.0f, position(random) + 2.0f);
+			XMFLOAT3 n(normal(random), normal(random), normal(random));
+			const float length = (std::max)(std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z), 1e-6f);
+			normals[i] = XMFLOAT3(n.x / length, n.y / length, n.z / length);
+		}
+
+		std::vector<XMFLOAT3> irradiance(count);
+		b.SetItems(count, "points");
+		b.Measure([&]()
+		{
+			for (uint32 i = 0; i < count; ++i)
+				irradiance[i] = volume.Irradiance(points[i], normals[i]);
+			Benchmark::DoNotOptimize(irradiance.data());
+		});
+	});
+}
@@ -0,0 +1,190 @@
+#include "Benchmarks.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include "../RadianceTransfer_impl/nv_helpers_dx12/ShaderBindingTableGenerator.h"
+#include "../RadianceTransfer_impl/nv_helpers_dx12/TopLevelASGenerator.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// Just enough of a resource for the generators, which only ask for its address.
+	class FakeResource : public ID3D12Resource
+	{
+	public:
+		explicit FakeResource(D3D12_GPU_VIRTUAL_ADDRESS address) : mAddress(address) {}
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** object) override { *object = nullptr; return E_NOINTERFACE; }
+		ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+		ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE GetDevice(REFIID, void** device) override { *device = nullptr; return E_NOTIMPL; }
+
+		HRESULT STDMETHODCALLTYPE Map(UINT, const D3D12_RANGE*, void** data) override { *data = nullptr; return E_NOTIMPL; }
+		void STDMETHODCALLTYPE Unmap(UINT, const D3D12_RANGE*) override {}
+		D3D12_RESOURCE_DESC STDMETHODCALLTYPE GetDesc() override { return D3D12_RESOURCE_DESC(); }
+		D3D12_GPU_VIRTUAL_ADDRESS STDMETHODCALLTYPE GetGPUVirtualAddress() override { return mAddress; }
+		HRESULT STDMETHODCALLTYPE WriteToSubresource(UINT, const D3D12_BOX*, const void*, UINT, UINT) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE ReadFromSubresource(void*, UINT, UINT, UINT, const D3D12_BOX*) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE GetHeapProperties(D3D12_HEAP_PROPERTIES*, D3D12_HEAP_FLAGS*) override { return E_NOTIMPL; }
+
+	private:
+		D3D12_GPU_VIRTUAL_ADDRESS mAddress = 0;
+	};
+
+	// Hands out a made-up identifier per export name, looked up by name as the runtime
+	// does.
+	class FakeStateObjectProperties : public ID3D12StateObjectProperties
+	{
+	public:
+		void AddExport(const std::wstring& name)
+		{
+			std::vector<std::uint8_t>& id = mIdentifiers[name];
+			id.assign(D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES, (std::uint8_t)mIdentifiers.size());
+		}
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** object) override { *object = nullptr; return E_NOINTERFACE; }
+		ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+		ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+		void* STDMETHODCALLTYPE GetShaderIdentifier(LPCWSTR exportName) override
+		{
+			auto it = mIdentifiers.find(exportName);
+			return it == mIdentifiers.end() ? nullptr : it->second.data();
+		}
+		UINT64 STDMETHODCALLTYPE GetShaderStackSize(LPCWSTR) override { return 0; }
+		UINT64 STDMETHODCALLTYPE GetPipelineStackSize() override { return 0; }
+		void STDMETHODCALLTYPE SetPipelineStackSize(UINT64) override {}
+
+	private:
+		std::unordered_map<std::wstring, std::vector<std::uint8_t>> mIdentifiers;
+	};
+}
+
+void AddRaytracingBenchmarks(BenchmarkSuite& suite)
+{
+	// CreateShaderBindingTable for 'tables' receivers, as UpdateShaderBindingTables does
+	// each frame: the generator refilled, sized and written into mapped memory.
+	for (uint32 tables : { 1u, 64u })
+	{
+		suite.Add("raytracing/sbt/tables=" + std::to_string(tables), [tables](Benchmark& b)
+		{
+			FakeStateObjectProperties pipeline;
+			pipeline.AddExport(L"RayGen");
+			pipeline.AddExport(L"Miss");
+			pipeline.AddExport(L"HitGroup");
+
+			nv_helpers_dx12::ShaderBindingTableGenerator generator;
+			std::vector<std::uint8_t> ring;
+
+			b.SetItems(tables, "tables");
+			b.Measure([&]()
+			{
+				size_t offset = 0;
+				for (uint32 t = 0; t < tables; ++t)
+				{
+					generator.Reset();
+					generator.AddRayGenerationProgram(L"RayGen", {
+						(void*)(UINT64)(0x10000 + t * 256),
+						(void*)(UINT64)0x20000,
+						(void*)(UINT64)0x30000,
+						(void*)(UINT64)0x40000,
+						(void*)(UINT64)0x50000,
+						(void*)(UINT64)0x60000 });
+					generator.AddMissProgram(L"Miss", {});
+					generator.AddHitGroup(L"HitGroup", {});
+
+					const uint32 size = generator.ComputeSBTSize();
+					if (ring.size() < offset + size)
+						ring.resize(offset + size);
+					generator.Generate(ring.data() + offset, &pipeline);
+					offset += size;
+				}
+				Benchmark::DoNotOptimize(ring.data());
+			});
+			b.AddCounter("bytes_per_table", (double)ring.size() / tables);
+		});
+	}
+
+	// The tables of a scene with one hit group per instance, to see the layout scale.
+	suite.Add("raytracing/sbt/hit_groups=4096", [](Benchmark& b)
+	{
+		const uint32 count = 4096;
+		FakeStateObjectProperties pipeline;
+		pipeline.AddExport(L"RayGen");
+		pipeline.AddExport(L"Miss");
+		std::vector<std::wstring> names;
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			names.push_back(L"HitGroup" + std::to_wstring(i));
+			pipeline.AddExport(names.back());
+		}
+
+		nv_helpers_dx12::ShaderBindingTableGenerator generator;
+		std::vector<std::uint8_t> table;
+
+		b.SetItems(count, "hit groups");
+		b.Measure([&]()
+		{
+			generator.Reset();
+			generator.AddRayGenerationProgram(L"RayGen", { (void*)(UINT64)0x10000 });
+			generator.AddMissProgram(L"Miss", {});
+			for (uint32 i = 0; i < count; ++i)
+				generator.AddHitGroup(names[i % names.size()], { (void*)(UINT64)(0x100000 + i * 256), (void*)(UINT64)0x200000 });
+
+			table.resize(generator.ComputeSBTSize());
+			generator.Generate(table.data(), &pipeline);
+			Benchmark::DoNotOptimize(table.data());
+		});
+	});
+
+	// The instance descriptors of the top-level AS: written in full when it is built,
+	// rewritten for the refit every frame.
+	for (uint32 instances : { 16u, 4096u })
+	{
+		for (bool refit : { false, true })
+		{
+			const std::string name = std::string("raytracing/tlas_") + (refit ? "refit" : "build") +
+				"/instances=" + std::to_string(instances);
+			suite.Add(name, [instances, refit](Benchmark& b)
+			{
+				std::vector<FakeResource> blas;
+				std::vector<DirectX::XMMATRIX> transforms;
+				blas.reserve(instances);
+				for (uint32 i = 0; i < instances; ++i)
+				{
+					blas.emplace_back(0x1000000 + (D3D12_GPU_VIRTUAL_ADDRESS)i * 0x10000);
+					transforms.push_back(DirectX::XMMatrixScaling(1.0f + i * 0.001f, 1.0f, 1.0f) *
+						DirectX::XMMatrixTranslation((float)i, 0.0f, (float)(i % 7)));
+				}
+
+				std::vector<D3D12_RAYTRACING_INSTANCE_DESC> descs(instances);
+				nv_helpers_dx12::TopLevelASGenerator refitGenerator;
+				for (uint32 i = 0; i < instances; ++i)
+					refitGenerator.AddInstance(&blas[i], transforms[i], i, 2 * i);
+
+				b.SetItems(instances, "instances");
+				b.SetBytes((double)descs.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
+				b.Measure([&]()
+				{
+					if (refit)
+						refitGenerator.WriteInstanceDescs(descs.data(), true);
+					else
+					{
+						nv_helpers_dx12::TopLevelASGenerator generator;
+						for (uint32 i = 0; i < instances; ++i)
+							generator.AddInstance(&blas[i], transforms[i], i, 2 * i);
+						generator.WriteInstanceDescs(descs.data());
+					}
+					Benchmark::DoNotOptimize(descs.data());
+				});
+			});
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#include "Benchmarks.h"
+
+#include <cmath>
+#include <memory>
+#include <random>
+
+#include "../Common/JobSystem.h"
+#include "../RadianceTransfer_impl/EnvironmentMap.h"
+#include "../RadianceTransfer_impl/SHBasis.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	std::vector<float> RandomDirections(uint32 count)
+	{
+		std::mt19937 random(1234);
+		std::normal_distribution<float> normal;
+		std::vector<float> directions(count * 3);
+		for (uint32 i = 0; i < count; ++i)
+		{
+			float* d = &directions[i * 3];
+			float length = 0.0f;
+			while (length < 1e-6f)
+			{
+				d[0] = normal(random);
+				d[1] = normal(random);
+				d[2] = normal(random);
+				length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+			}
+			d[0] /= length;
+			d[1] /= length;
+			d[2] /= length;
+		}
+		return directions;
+	}
+
+	// A sky with some structure: a bright sun-like spot over a vertical gradient.
+	EnvironmentMap::Image SyntheticSky(uint32 width, uint32 height)
+	{
+		EnvironmentMap::Image image;
+		image.Width = width;
+		image.Height = height;
+		image.Texels.resize((size_t)width * height * 3);
+		for (uint32 y = 0; y < height; ++y)
+		{
+			for (uint32 x = 0; x < width; ++x)
+			{
+				float* texel = &image.Texels[((size_t)y * width + x) * 3];
+				const float v = (y + 0.5f) / height;
+				const float du = (x + 0.5f) / width - 0.3f;
+				const float dv = v - 0.25f;
+				const float sun = du * du + dv * dv < 0.001f ? 50.0f : 0.0f;
+				texel[0] = 0.2f + 0.8f * (1.0f - v) + sun;
+				texel[1] = 0.3f + 0.6f * (1.0f - v) + sun;
+				texel[2] = 0.5f + 0.5f * (1.0f - v) + sun;
+			}
+		}
+		return image;
+	}
+}
+
+void AddSHBenchmarks(BenchmarkSuite& suite)
+{
+	// Every order the shaders evaluate, over a batch of directions as a projection would.
+	for (uint32 order = 1; order <= SHBasis::MaxOrder; ++order)
+	{
+		suite.Add("sh/eval/order=" + std::to_string(order), [order](Benchmark& b)
+		{
+			const uint32 count = 4096;
+			const std::vector<float> directions = RandomDirections(count);
+			std::vector<float> basis((size_t)count * SHBasis::CoeffCount(order));
+
+			b.SetItems(count, "directions");
+			b.AddCounter("coefficients", SHBasis::CoeffCount(order));
+			b.Measure([&]()
+			{
+				SHBasis::EvalMany(order, directions.data(), count, basis.data());
+				Benchmark::DoNotOptimize(basis.data());
+			});
+		});
+	}
+
+	for (uint32 threads : { 1u, 0u })
+	{
+		suite.Add("sh/project_sky/1024x512/threads=" + std::string(threads == 0 ? "all" : std::to_string(threads)),
+			[threads](Benchmark& b)
+		{
+			const EnvironmentMap::Image image = SyntheticSky(1024, 512);
+			std::unique_ptr<JobSystem> jobs(threads == 0 ? new JobSystem() : nullptr);
+
+			b.SetItems((double)image.Width * image.Height, "texels");
+			b.Measure([&]()
+			{
+				EnvironmentMap::SH9 sh = EnvironmentMap::ProjectSH(image, jobs.get());
+				Benchmark::DoNotOptimize(&sh);
+			});
+		});
+	}
+}
@@ -0,0 +1,125 @@
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "../Common/FileUtil.h"
+#include "../Common/ShaderCache.h"
+
+namespace
+{
+	// The shader files the app compiles at startup, each once per stage it uses.
+	const char* const kStages[][2] =
+	{
+		{ "Default.hlsl", "vs_5_1" }, { "Default.hlsl", "ps_5_1" },
+		{ "Sky.hlsl", "vs_5_1" }, { "Sky.hlsl", "ps_5_1" },
+		{ "ProjEnv.hlsl", "vs_5_1" },
+		{ "ProjLTPerVertex.hlsl", "vs_5_1" },
+		{ "ProjLTPerVertexTextureSpace.hlsl", "vs_5_1" },
+		{ "ReconstructLight.hlsl", "vs_5_1" }, { "ReconstructLight.hlsl", "ps_5_1" },
+		{ "ProjLTPerPixelNew.hlsl", "vs_5_1" }, { "ProjLTPerPixelNew.hlsl", "ps_5_1" },
+		{ "Filter.hlsl", "vs_5_1" }, { "Filter.hlsl", "ps_5_1" },
+		{ "Outlier_removal.hlsl", "vs_5_1" }, { "Outlier_removal.hlsl", "ps_5_1" },
+		{ "FilterHorizontal.hlsl", "vs_5_1" }, { "FilterHorizontal.hlsl", "ps_5_1" },
+		{ "FilterVertical.hlsl", "vs_5_1" }, { "FilterVertical.hlsl", "ps_5_1" },
+		{ "TemporalFilter.hlsl", "vs_5_1" }, { "TemporalFilter.hlsl", "ps_5_1" },
+		{ "FilterHorizontalWorld.hlsl", "vs_5_1" }, { "FilterHorizontalWorld.hlsl", "ps_5_1" },
+		{ "FilterVerticalWorld.hlsl", "vs_5_1" }, { "FilterVerticalWorld.hlsl", "ps_5_1" },
+		{ "FilterAndReconstructPerPixel.hlsl", "vs_5_1" }, { "FilterAndReconstructPerPixel.hlsl", "ps_5_1" },
+		{ "Depth.hlsl", "vs_5_1" }, { "Depth.hlsl", "ps_5_1" },
+		{ "WriteGBuffer.hlsl", "vs_5_1" }, { "WriteGBuffer.hlsl", "ps_5_1" },
+		{ "RayGen.hlsl", "lib_6_3" },
+		{ "TextureSpaceRayGen.hlsl", "lib_6_3" },
+		{ "Miss.hlsl", "lib_6_3" },
+		{ "Hit.hlsl", "lib_6_3" },
+	};
+	const size_t kStageCount = sizeof(kStages) / sizeof(kStages[0]);
+
+	std::string EntryPoint(const char* target)
+	{
+		return target[0] == 'v' ? "VS" : target[0] == 'p' ? "PS" : "";
+	}
+}
+
+void AddShaderBenchmarks(BenchmarkSuite& suite)
+{
+	// Hashing the sources and their includes, with every file read anew as on launch.
+	suite.Add("shader/include_closure/app", [](Benchmark& b)
+	{
+		const std::string directory = b.DataDirectory() + "/RadianceTransfer_impl/Shaders/";
+		if (!FileUtil::FileExists(directory + kStages[0][0]))
+		{
+			b.Skip(directory + " not found");
+			return;
+		}
+
+		b.SetItems((double)kStageCount, "shaders");
+		b.Measure([&]()
+		{
+			ShaderIncludeHasher hasher;
+			for (size_t i = 0; i < kStageCount; ++i)
+			{
+				ShaderIncludeHasher::uint64 hash = 0;
+				std::string error;
+				if (!hasher.HashClosure(directory + kStages[i][0], &hash, &error))
+					throw std::runtime_error(error);
+				Benchmark::DoNotOptimize(&hash);
+			}
+		});
+	});
+
+	// A warm start: every shader of the app keyed and loaded from the cache.  A cold
+	// start compiles instead, which needs the Windows compilers; the app logs both.
+	suite.Add("shader/warm_start/app", [](Benchmark& b)
+	{
+		const std::string directory = b.DataDirectory() + "/RadianceTransfer_impl/Shaders/";
+		if (!FileUtil::FileExists(directory + kStages[0][0]))
+		{
+			b.Skip(directory + " not found");
+			return;
+		}
+
+		// Bytecode of about the size fxc produces for these shaders.
+		const std::string cacheDirectory = "benchmark_shader_cache";
+		const std::vector<std::uint8_t> bytecode(16 * 1024, 0xcd);
+		{
+			ShaderCache cache(cacheDirectory);
+			for (size_t i = 0; i < kStageCount; ++i)
+			{
+				std::string key;
+				if (!cache.KeyForFile(directory + kStages[i][0], EntryPoint(kStages[i][1]), kStages[i][1], {}, "benchmark", &key) ||
+					!cache.Store(key, bytecode.data(), bytecode.size()))
+				{
+					b.Skip("cannot write " + cacheDirectory);
+					return;
+				}
+			}
+		}
+
+		b.SetItems((double)kStageCount, "shaders");
+		b.SetBytes((double)kStageCount * bytecode.size());
+		b.Measure([&]()
+		{
+			ShaderCache cache(cacheDirectory);
+			std::vector<std::uint8_t> loaded;
+			for (size_t i = 0; i < kStageCount; ++i)
+			{
+				std::string key;
+				if (!cache.KeyForFile(directory + kStages[i][0], EntryPoint(kStages[i][1]), kStages[i][1], {}, "benchmark", &key) ||
+					!cache.Load(key, &loaded))
+					throw std::runtime_error("shader cache missed its own entry");
+				Benchmark::DoNotOptimize(loaded.data());
+			}
+		});
+
+		ShaderCache cache(cacheDirectory);
+		for (size_t i = 0; i < kStageCount; ++i)
+		{
+			std::string key;
+			if (cache.KeyForFile(directory + kStages[i][0], EntryPoint(kStages[i][1]), kStages[i][1], {}, "benchmark", &key))
+				std::remove(cache.PathForKey(key).c_str());
+		}
+		std::remove(cacheDirectory.c_str());
+	});
+}
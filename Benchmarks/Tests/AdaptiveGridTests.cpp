@@ -0,0 +1,236 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../Common/GeometryGenerator.h"
+#include "../../RadianceTransfer_impl/AdaptiveGrid.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using MeshData = GeometryGenerator::MeshData;
+	using Edge = std::pair<uint32, uint32>;
+
+	// Twice the signed area of a triangle seen from above, in (x, z).
+	float SignedArea(const MeshData& mesh, const uint32* t)
+	{
+		const XMFLOAT3& a = mesh.Vertices[t[0]].Position;
+		const XMFLOAT3& b = mesh.Vertices[t[1]].Position;
+		const XMFLOAT3& c = mesh.Vertices[t[2]].Position;
+		return (b.x - a.x) * (c.z - a.z) - (b.z - a.z) * (c.x - a.x);
+	}
+
+	bool OnBorder(const XMFLOAT3& p, float width, float depth)
+	{
+		const float e = 1e-4f * (std::max)(width, depth);
+		return std::fabs(std::fabs(p.x) - 0.5f * width) < e || std::fabs(std::fabs(p.z) - 0.5f * depth) < e;
+	}
+
+	// The grid covers its rectangle once, wound like GeometryGenerator::CreateGrid, and is
+	// watertight: every edge is shared with a neighbour running the other way, except
+	// along the border, so there is no T-junction or crack anywhere.  Vertices follow the
+	// CreateGrid conventions and none is repeated.
+	void CheckGrid(Test& t, const MeshData& mesh, float width, float depth, const std::string& context)
+	{
+		bool winding = true;
+		double area = 0.0;
+		std::map<Edge, uint32> edges;
+		for (size_t i = 0; i + 2 < mesh.Indices32.size(); i += 3)
+		{
+			const float a = SignedArea(mesh, &mesh.Indices32[i]);
+			winding = winding && a < 0.0f;
+			area += -0.5 * a;
+			for (uint32 k = 0; k < 3; ++k)
+				++edges[Edge(mesh.Indices32[i + k], mesh.Indices32[i + (k + 1) % 3])];
+		}
+
+		bool shared = true;
+		double border = 0.0;
+		for (const auto& edge : edges)
+		{
+			shared = shared && edge.second == 1;
+			if (edges.count(Edge(edge.first.second, edge.first.first)) != 0)
+				continue;
+
+			const XMFLOAT3& a = mesh.Vertices[edge.first.first].Position;
+			const XMFLOAT3& b = mesh.Vertices[edge.first.second].Position;
+			const XMFLOAT3 mid(0.5f * (a.x + b.x), 0.0f, 0.5f * (a.z + b.z));
+			shared = shared && OnBorder(a, width, depth) && OnBorder(b, width, depth) && OnBorder(mid, width, depth);
+			border += std::sqrt(double(b.x - a.x) * (b.x - a.x) + double(b.z - a.z) * (b.z - a.z));
+		}
+
+		std::set<std::pair<float, float>> positions;
+		bool conventions = true;
+		for (const GeometryGenerator::Vertex& v : mesh.Vertices)
+		{
+			positions.insert(std::make_pair(v.Position.x, v.Position.z));
+			conventions = conventions && v.Position.y == 0.0f && v.Normal.y == 1.0f && v.TangentU.x == 1.0f &&
+				std::fabs(v.TexC.x - (v.Position.x / width + 0.5f)) < 1e-5f &&
+				std::fabs(v.TexC.y - (0.5f - v.Position.z / depth)) < 1e-5f;
+		}
+
+		const bool ok =
+			TEST_CHECK(t, winding) &&
+			TEST_CHECK_NEAR(t, area, double(width) * depth, 1e-3 * width * depth) &&
+			TEST_CHECK(t, shared) &&
+			TEST_CHECK_NEAR(t, border, 2.0 * (width + depth), 1e-3 * (width + depth)) &&
+			TEST_CHECK(t, positions.size() == mesh.Vertices.size()) &&
+			TEST_CHECK(t, conventions);
+		if (!ok)
+			t.Fail(context, __FILE__, __LINE__);
+	}
+
+	// Shortest and longest edge of any triangle.
+	std::pair<float, float> EdgeRange(const MeshData& mesh)
+	{
+		float shortest = 1e30f, longest = 0.0f;
+		for (size_t i = 0; i + 2 < mesh.Indices32.size(); i += 3)
+		{
+			for (uint32 k = 0; k < 3; ++k)
+			{
+				const XMFLOAT3& a = mesh.Vertices[mesh.Indices32[i + k]].Position;
+				const XMFLOAT3& b = mesh.Vertices[mesh.Indices32[i + (k + 1) % 3]].Position;
+				const float length = std::sqrt((b.x - a.x) * (b.x - a.x) + (b.z - a.z) * (b.z - a.z));
+				shortest = (std::min)(shortest, length);
+				longest = (std::max)(longest, length);
+			}
+		}
+		return std::make_pair(shortest, longest);
+	}
+
+	std::vector<float> VertexValues(const MeshData& mesh, const AdaptiveGrid::Estimator& estimate)
+	{
+		std::vector<float> values;
+		for (const GeometryGenerator::Vertex& v : mesh.Vertices)
+			values.push_back(estimate(v.Position));
+		return values;
+	}
+}
+
+void AddAdaptiveGridTests(TestSuite& suite)
+{
+	// Nothing to refine: the coarse grid, with the same vertices and triangle count as
+	// GeometryGenerator::CreateGrid, from one estimate per lattice point it looked at.
+	suite.Add("adaptivegrid/uniform", [](Test& t)
+	{
+		const uint32 bases[] = { 1, 3, 8 };
+		for (uint32 base : bases)
+		{
+			AdaptiveGrid::Options options;
+			options.Width = 6.0f;
+			options.Depth = 2.0f;
+			options.BaseCells = base;
+			options.MaxLevels = 3;
+
+			uint32 calls = 0;
+			AdaptiveGrid::Stats stats;
+			const MeshData mesh = AdaptiveGrid::CreateGrid(options, [&](const XMFLOAT3&) { ++calls; return 0.5f; }, &stats);
+			const std::string name = "base " + std::to_string(base);
+			CheckGrid(t, mesh, options.Width, options.Depth, name);
+
+			TEST_CHECK(t, stats.Leaves == base * base && stats.BalanceSplits == 0);
+			TEST_CHECK(t, stats.Evaluations == calls && calls == (2 * base + 1) * (2 * base + 1));
+
+			const MeshData reference = GeometryGenerator().CreateGrid(options.Width, options.Depth, base + 1, base + 1);
+			std::set<std::pair<float, float>> expected, actual;
+			for (const GeometryGenerator::Vertex& v : reference.Vertices)
+				expected.insert(std::make_pair(std::round(v.Position.x * 1e4f), std::round(v.Position.z * 1e4f)));
+			for (const GeometryGenerator::Vertex& v : mesh.Vertices)
+				actual.insert(std::make_pair(std::round(v.Position.x * 1e4f), std::round(v.Position.z * 1e4f)));
+			TEST_CHECK(t, actual == expected);
+			TEST_CHECK(t, mesh.Indices32.size() == reference.Indices32.size());
+		}
+
+		// No levels to split into, however much the estimate varies.
+		AdaptiveGrid::Options flat;
+		flat.BaseCells = 4;
+		flat.MaxLevels = 0;
+		AdaptiveGrid::Stats stats;
+		const MeshData mesh = AdaptiveGrid::CreateGrid(flat, [](const XMFLOAT3& p) { return p.x; }, &stats);
+		CheckGrid(t, mesh, flat.Width, flat.Depth, "no levels");
+		TEST_CHECK(t, stats.Leaves == 16 && mesh.Indices32.size() == 16 * 6);
+	});
+
+	// A sharp circle refines to the finest level along it and stays coarse away from it,
+	// balanced so the mesh stays watertight, and follows the estimate more closely than
+	// a uniform grid with as many vertices.
+	suite.Add("adaptivegrid/refine", [](Test& t)
+	{
+		AdaptiveGrid::Options options;
+		options.Width = 8.0f;
+		options.Depth = 8.0f;
+		options.BaseCells = 8;
+		options.MaxLevels = 4;
+		options.Threshold = 0.05f;
+
+		std::set<std::pair<float, float>> asked;
+		uint32 calls = 0;
+		const AdaptiveGrid::Estimator shadow = [](const XMFLOAT3& p)
+		{
+			const float r = std::sqrt(p.x * p.x + p.z * p.z);
+			return (std::min)((std::max)((r - 1.5f) * 4.0f, 0.0f), 1.0f);
+		};
+		AdaptiveGrid::Stats stats;
+		const MeshData mesh = AdaptiveGrid::CreateGrid(options, [&](const XMFLOAT3& p)
+		{
+			++calls;
+			asked.insert(std::make_pair(p.x, p.z));
+			return shadow(p);
+		}, &stats);
+		CheckGrid(t, mesh, options.Width, options.Depth, "circle");
+
+		// Each lattice point is estimated once.
+		TEST_CHECK(t, stats.Evaluations == calls && asked.size() == calls);
+		TEST_CHECK(t, stats.Leaves > 64 && stats.BalanceSplits > 0);
+
+		// The finest cells, 8 / 128 across, have nothing finer next to them to fan
+		// around, so their side is the shortest edge; the corners keep their coarse
+		// cells, whose diagonal is the longest.
+		const std::pair<float, float> range = EdgeRange(mesh);
+		const float finest = options.Width / (options.BaseCells << options.MaxLevels);
+		TEST_CHECK_NEAR(t, range.first, finest, 1e-4);
+		TEST_CHECK_NEAR(t, range.second, std::sqrt(2.0f) * options.Width / options.BaseCells, 1e-4);
+
+		// Against the same number of vertices spread evenly.
+		const AdaptiveGrid::Reference reference = AdaptiveGrid::SampleReference(options.Width, options.Depth, 256, shadow);
+		const AdaptiveGrid::Error adaptive = AdaptiveGrid::MeasureError(mesh, VertexValues(mesh, shadow), reference);
+		const uint32 side = uint32(std::sqrt(float(mesh.Vertices.size())));
+		const MeshData uniform = GeometryGenerator().CreateGrid(options.Width, options.Depth, side, side);
+		const AdaptiveGrid::Error even = AdaptiveGrid::MeasureError(uniform, VertexValues(uniform, shadow), reference);
+		TEST_CHECK(t, adaptive.Rms < even.Rms && adaptive.Max < even.Max);
+		TEST_CHECK(t, adaptive.Max <= 0.5f);
+	});
+
+	// Interpolation reproduces anything linear, so the error is what was added to it.
+	suite.Add("adaptivegrid/measure_error", [](Test& t)
+	{
+		const AdaptiveGrid::Estimator linear = [](const XMFLOAT3& p) { return 0.25f * p.x - 0.5f * p.z + 1.0f; };
+		const AdaptiveGrid::Reference reference = AdaptiveGrid::SampleReference(4.0f, 2.0f, 64, linear);
+		TEST_CHECK(t, reference.Values.size() == 64 * 64);
+
+		const MeshData grid = GeometryGenerator().CreateGrid(4.0f, 2.0f, 5, 9);
+		std::vector<float> values = VertexValues(grid, linear);
+		const AdaptiveGrid::Error exact = AdaptiveGrid::MeasureError(grid, values, reference);
+		TEST_CHECK(t, exact.Rms < 1e-5f && exact.Max < 1e-5f);
+
+		for (float& value : values)
+			value += 0.125f;
+		const AdaptiveGrid::Error offset = AdaptiveGrid::MeasureError(grid, values, reference);
+		TEST_CHECK_NEAR(t, offset.Rms, 0.125, 1e-5);
+		TEST_CHECK_NEAR(t, offset.Max, 0.125, 1e-5);
+
+		// No triangles, no samples, no error.
+		MeshData empty = grid;
+		empty.Indices32.clear();
+		const AdaptiveGrid::Error none = AdaptiveGrid::MeasureError(empty, values, reference);
+		TEST_CHECK(t, none.Rms == 0.0f && none.Max == 0.0f);
+	});
+}
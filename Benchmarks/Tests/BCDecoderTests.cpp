@@ -0,0 +1,198 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../../Common/BCDecoder.h"
+#include "../../Common/DDSReader.h"
+#include "../../Common/JobSystem.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// Tests/Data/BC holds a 32x16 texture per format, random blocks with every BC6H and
+	// BC7 mode present, and its texels as decoded by Pillow's DDS plugin, RGBA8.
+	struct Reference
+	{
+		const char* Name;
+		uint32 Channels;  // compared, from red up; Pillow gives BC4 as L and BC5 as RGB
+		int Tolerance;    // Pillow rounds some interpolations the other way
+	};
+
+	const Reference kReferences[] = {
+		{ "bc1", 4, 1 }, { "bc2", 4, 1 }, { "bc3", 4, 1 }, { "bc4", 1, 1 }, { "bc5", 2, 1 },
+		{ "bc6h_uf16", 3, 1 }, { "bc7", 4, 0 } };
+
+	std::string DataPath(const Test& t, const std::string& file)
+	{
+		return t.DataDirectory() + "/Benchmarks/Tests/Data/BC/" + file;
+	}
+
+	std::vector<std::uint8_t> RandomBlocks(DXGI_FORMAT format, uint32 blockCount, uint32 seed)
+	{
+		std::mt19937 random(seed);
+		const size_t blockBytes = DDS::BitsPerPixel(format) * 2;
+		std::vector<std::uint8_t> blocks(blockBytes * blockCount);
+		for (std::uint8_t& b : blocks)
+			b = std::uint8_t(random());
+		return blocks;
+	}
+
+	const DXGI_FORMAT kFormats[] = {
+		DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC1_UNORM_SRGB, DXGI_FORMAT_BC2_UNORM, DXGI_FORMAT_BC3_UNORM,
+		DXGI_FORMAT_BC4_UNORM, DXGI_FORMAT_BC4_SNORM, DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC5_SNORM,
+		DXGI_FORMAT_BC6H_UF16, DXGI_FORMAT_BC6H_SF16, DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC7_UNORM_SRGB };
+}
+
+void AddBCDecoderTests(TestSuite& suite)
+{
+	// Every texel against an independent decoder.
+	suite.Add("bc/reference", [](Test& t)
+	{
+		for (const Reference& reference : kReferences)
+		{
+			DDSReader reader;
+			std::string error;
+			if (!TEST_CHECK(t, reader.Open(DataPath(t, std::string(reference.Name) + ".dds"), &error)))
+				continue;
+			MappedFile expected(DataPath(t, std::string(reference.Name) + ".rgba"));
+			if (!TEST_CHECK(t, expected.IsOpen()))
+				continue;
+
+			std::vector<std::uint8_t> texels;
+			if (!TEST_CHECK(t, BCDecoder::Decode(reader.Format(), reader.GetSubresource(0u, 0u), texels)))
+				continue;
+			if (!TEST_CHECK(t, texels.size() == expected.Size()))
+				continue;
+
+			int worst = 0;
+			for (size_t texel = 0; texel < texels.size() / 4; ++texel)
+			{
+				for (uint32 c = 0; c < reference.Channels; ++c)
+				{
+					const int difference = std::abs(int(texels[texel * 4 + c]) - int(expected.Data()[texel * 4 + c]));
+					worst = difference > worst ? difference : worst;
+				}
+			}
+			if (!TEST_CHECK(t, worst <= reference.Tolerance))
+				t.Fail(std::string(reference.Name) + " differs by " + std::to_string(worst), __FILE__, __LINE__);
+		}
+	});
+
+	// The two output forms describe the same texels: UNORM floats are the bytes over 255
+	// and SNORM floats map onto them from [-1, 1].
+	suite.Add("bc/rgba8_matches_float", [](Test& t)
+	{
+		const DXGI_FORMAT formats[] = {
+			DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC2_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC4_UNORM,
+			DXGI_FORMAT_BC4_SNORM, DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC5_SNORM, DXGI_FORMAT_BC7_UNORM };
+		for (DXGI_FORMAT format : formats)
+		{
+			const bool snorm = format == DXGI_FORMAT_BC4_SNORM || format == DXGI_FORMAT_BC5_SNORM;
+			const uint32 channels = format == DXGI_FORMAT_BC4_UNORM || format == DXGI_FORMAT_BC4_SNORM ? 1
+				: format == DXGI_FORMAT_BC5_UNORM || format == DXGI_FORMAT_BC5_SNORM ? 2 : 4;
+			const std::vector<std::uint8_t> blocks = RandomBlocks(format, 256, 36);
+			const size_t blockBytes = blocks.size() / 256;
+
+			float worst = 0.0f;
+			for (uint32 block = 0; block < 256; ++block)
+			{
+				std::uint8_t bytes[64];
+				float floats[64];
+				BCDecoder::DecodeBlock(format, &blocks[block * blockBytes], bytes);
+				BCDecoder::DecodeBlock(format, &blocks[block * blockBytes], floats);
+				for (uint32 texel = 0; texel < 16; ++texel)
+				{
+					for (uint32 c = 0; c < channels; ++c)
+					{
+						const float f = floats[texel * 4 + c];
+						const float asByte = snorm ? (f * 0.5f + 0.5f) * 255.0f : f * 255.0f;
+						worst = (std::max)(worst, std::fabs(asByte - float(bytes[texel * 4 + c])));
+					}
+				}
+			}
+			TEST_CHECK(t, worst <= 1.0f);
+		}
+	});
+
+	// Surfaces whose size is not a multiple of the block size are the top left corner of
+	// the padded decode, and splitting among jobs changes nothing.
+	suite.Add("bc/surfaces", [](Test& t)
+	{
+		JobSystem twoWorkers(2);
+		JobSystem sevenWorkers(7);
+		for (DXGI_FORMAT format : kFormats)
+		{
+			const uint32 width = 61;
+			const uint32 height = 29;
+			const uint32 blocksWide = (width + 3) / 4;
+			const uint32 blocksHigh = (height + 3) / 4;
+			const std::vector<std::uint8_t> blocks = RandomBlocks(format, blocksWide * blocksHigh, 7);
+			const size_t rowBytes = blocks.size() / blocksHigh;
+
+			std::vector<std::uint8_t> padded(blocksWide * 4 * blocksHigh * 4 * 4);
+			TEST_CHECK(t, BCDecoder::Decode(format, blocks.data(), rowBytes, blocksWide * 4, blocksHigh * 4,
+				padded.data(), blocksWide * 16));
+
+			for (JobSystem* jobs : { (JobSystem*)nullptr, &twoWorkers, &sevenWorkers })
+			{
+				std::vector<std::uint8_t> texels(width * height * 4);
+				TEST_CHECK(t, BCDecoder::Decode(format, blocks.data(), rowBytes, width, height,
+					texels.data(), width * 4, jobs));
+
+				bool same = true;
+				for (uint32 y = 0; y < height; ++y)
+					same &= std::equal(&texels[y * width * 4], &texels[(y + 1) * width * 4], &padded[y * blocksWide * 16]);
+				TEST_CHECK(t, same);
+			}
+
+			std::vector<float> floats(width * height * 4);
+			std::vector<float> floatsThreaded(width * height * 4);
+			TEST_CHECK(t, BCDecoder::Decode(format, blocks.data(), rowBytes, width, height,
+				floats.data(), width * 16));
+			TEST_CHECK(t, BCDecoder::Decode(format, blocks.data(), rowBytes, width, height,
+				floatsThreaded.data(), width * 16, &sevenWorkers));
+			TEST_CHECK(t, floats == floatsThreaded);
+		}
+
+		std::uint8_t texel[4];
+		TEST_CHECK(t, !BCDecoder::IsSupported(DXGI_FORMAT_R8G8B8A8_UNORM));
+		TEST_CHECK(t, !BCDecoder::Decode(DXGI_FORMAT_R8G8B8A8_UNORM, texel, 4, 1, 1, texel, 4));
+	});
+
+	// BC1 with color0 <= color1 has three colors and transparent black; BC6H reserved
+	// modes decode to black.
+	suite.Add("bc/special_blocks", [](Test& t)
+	{
+		// color0 = black, color1 = white, indices 0, 1, 2, 3 along the first row.
+		const std::uint8_t bc1[8] = { 0x00, 0x00, 0xff, 0xff, 0xe4, 0xe4, 0xe4, 0xe4 };
+		std::uint8_t texels[64];
+		BCDecoder::DecodeBlock(DXGI_FORMAT_BC1_UNORM, bc1, texels);
+		const std::uint8_t expected[16] = {
+			0, 0, 0, 255, 255, 255, 255, 255, 128, 128, 128, 255, 0, 0, 0, 0 };
+		bool same = true;
+		for (uint32 i = 0; i < 16; ++i)
+			same &= std::abs(int(texels[i]) - int(expected[i])) <= 1;
+		TEST_CHECK(t, same);
+
+		// Mode codes 10011, 10111, 11011 and 11111 are reserved.
+		for (std::uint8_t mode : { 0x13, 0x17, 0x1b, 0x1f })
+		{
+			std::uint8_t bc6h[16];
+			for (std::uint8_t& b : bc6h)
+				b = 0xa5;
+			bc6h[0] = std::uint8_t((0xa5 & ~0x1f) | mode);
+			float decoded[64];
+			BCDecoder::DecodeBlock(DXGI_FORMAT_BC6H_UF16, bc6h, decoded);
+			bool black = true;
+			for (uint32 i = 0; i < 16; ++i)
+				black &= decoded[i * 4] == 0.0f && decoded[i * 4 + 1] == 0.0f && decoded[i * 4 + 2] == 0.0f;
+			TEST_CHECK(t, black);
+		}
+	});
+}
@@ -0,0 +1,252 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../../Common/DDSReader.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	const char* const kTextures[] = {
+		"WireFence.dds", "WoodCrate01.dds", "WoodCrate02.dds", "bricks.dds", "bricks2.dds",
+		"bricks2_nmap.dds", "bricks3.dds", "bricks_nmap.dds", "checkboard.dds", "default_nmap.dds",
+		"grass.dds", "ice.dds", "stone.dds", "tile.dds", "tile_nmap.dds", "tree01S.dds",
+		"tree02S.dds", "tree35S.dds", "treeArray2.dds", "treearray.dds", "water1.dds", "white1x1.dds" };
+
+	std::vector<std::uint8_t> ReadFile(const std::string& path)
+	{
+		MappedFile file(path);
+		return file.IsOpen() ? std::vector<std::uint8_t>(file.Data(), file.Data() + file.Size())
+			: std::vector<std::uint8_t>();
+	}
+
+	// A file with a DX10 header and every subresource filled, for the layouts the
+	// textures in the repository do not have.
+	struct Layout
+	{
+		uint32 Width;
+		uint32 Height;
+		uint32 Depth;
+		uint32 Mips;
+		DXGI_FORMAT Format;
+		uint32 Dimension;
+		uint32 ArraySize;
+		bool Cube;
+	};
+
+	std::vector<std::uint8_t> MakeFile(const Layout& layout)
+	{
+		std::vector<std::uint8_t> file(4 + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10));
+		const uint32 magic = DDS_MAGIC;
+		std::memcpy(file.data(), &magic, 4);
+
+		DDS_HEADER header = {};
+		header.size = sizeof(DDS_HEADER);
+		header.flags = DDS_HEIGHT | DDS_WIDTH | (layout.Dimension == DDS_DIMENSION_TEXTURE3D ? DDS_HEADER_FLAGS_VOLUME : 0);
+		header.width = layout.Width;
+		header.height = layout.Height;
+		header.depth = layout.Depth;
+		header.mipMapCount = layout.Mips;
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		header.ddspf.flags = DDS_FOURCC;
+		header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+		std::memcpy(file.data() + 4, &header, sizeof(header));
+
+		DDS_HEADER_DXT10 dx10 = {};
+		dx10.dxgiFormat = layout.Format;
+		dx10.resourceDimension = layout.Dimension;
+		dx10.arraySize = layout.ArraySize;
+		dx10.miscFlag = layout.Cube ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+		std::memcpy(file.data() + 4 + sizeof(header), &dx10, sizeof(dx10));
+
+		const size_t items = layout.ArraySize * (layout.Cube ? 6 : 1);
+		size_t bytes = 0;
+		for (size_t item = 0; item < items; ++item)
+		{
+			size_t w = layout.Width;
+			size_t h = layout.Height;
+			size_t d = layout.Depth;
+			for (uint32 mip = 0; mip < (std::max)(layout.Mips, 1u); ++mip)
+			{
+				size_t surfaceBytes = 0;
+				DDS::GetSurfaceInfo(w, h, layout.Format, &surfaceBytes, nullptr, nullptr);
+				bytes += surfaceBytes * d;
+				w = (std::max)(w / 2, size_t(1));
+				h = (std::max)(h / 2, size_t(1));
+				d = (std::max)(d / 2, size_t(1));
+			}
+		}
+		file.resize(file.size() + bytes, 0x5a);
+		return file;
+	}
+
+	// Parses an exact-size heap copy of 'file', so a sanitizer sees any overrun.  When the
+	// file is accepted, its subresources must tile the pixel data in order and lie inside
+	// the file.  Returns whether it was accepted; 'consistent' is cleared otherwise.
+	bool ParseCopy(const std::vector<std::uint8_t>& file, bool* consistent)
+	{
+		std::vector<std::uint8_t> copy(file);
+		const std::uint8_t* begin = copy.data();
+		const std::uint8_t* end = begin + copy.size();
+
+		DDSReader reader;
+		std::string error;
+		if (!reader.Parse(begin, copy.size(), &error))
+		{
+			*consistent &= !error.empty();
+			return false;
+		}
+
+		*consistent &= reader.SubresourceCount() == (size_t)reader.MipCount() * reader.ArraySize();
+		const std::uint8_t* next = reader.BitData();
+		for (size_t i = 0; i < reader.SubresourceCount(); ++i)
+		{
+			const DDSReader::Subresource& s = reader.GetSubresource(i);
+			const size_t bytes = s.SliceBytes * s.Depth;
+			*consistent &= s.Data == next && s.Data >= begin && bytes <= size_t(end - s.Data);
+			*consistent &= s.RowBytes * s.RowCount <= s.SliceBytes + s.RowBytes;
+			next = s.Data + bytes;
+		}
+		return true;
+	}
+
+	const Layout kLayouts[] = {
+		{ 64, 1, 1, 7, DXGI_FORMAT_R8G8B8A8_UNORM, DDS_DIMENSION_TEXTURE1D, 4, false },
+		{ 32, 16, 8, 6, DXGI_FORMAT_R16G16B16A16_FLOAT, DDS_DIMENSION_TEXTURE3D, 1, false },
+		{ 16, 16, 1, 5, DXGI_FORMAT_BC6H_UF16, DDS_DIMENSION_TEXTURE2D, 2, true },
+		{ 13, 7, 1, 4, DXGI_FORMAT_BC7_UNORM, DDS_DIMENSION_TEXTURE2D, 3, false },
+		{ 10, 6, 1, 1, DXGI_FORMAT_NV12, DDS_DIMENSION_TEXTURE2D, 1, false },
+		{ 9, 5, 1, 2, DXGI_FORMAT_YUY2, DDS_DIMENSION_TEXTURE2D, 1, false },
+		{ 33, 9, 1, 3, DXGI_FORMAT_R1_UNORM, DDS_DIMENSION_TEXTURE2D, 1, false },
+		{ 5, 3, 1, 1, DXGI_FORMAT_P010, DDS_DIMENSION_TEXTURE2D, 1, false },
+		{ 17, 17, 1, 5, DXGI_FORMAT_R32G32B32_FLOAT, DDS_DIMENSION_TEXTURE2D, 1, false },
+		{ 8, 8, 1, 4, DXGI_FORMAT_NV11, DDS_DIMENSION_TEXTURE2D, 1, false } };
+}
+
+void AddDDSReaderTests(TestSuite& suite)
+{
+	// Every texture in the repository opens, with its subresources tiling the file.
+	suite.Add("dds/corpus", [](Test& t)
+	{
+		for (const char* name : kTextures)
+		{
+			const std::string path = t.DataDirectory() + "/Textures/" + name;
+			DDSReader reader;
+			std::string error;
+			if (!TEST_CHECK(t, reader.Open(path, &error)))
+			{
+				t.Fail(std::string(name) + ": " + error, __FILE__, __LINE__);
+				continue;
+			}
+			TEST_CHECK(t, reader.Width() > 0 && reader.Height() > 0 && reader.MipCount() > 0);
+
+			bool consistent = true;
+			TEST_CHECK(t, ParseCopy(ReadFile(path), &consistent));
+			TEST_CHECK(t, consistent);
+		}
+	});
+
+	// 1D arrays, volumes, cube arrays, BC6H/BC7 with partial blocks, packed and planar
+	// video formats and R1.
+	suite.Add("dds/layouts", [](Test& t)
+	{
+		for (const Layout& layout : kLayouts)
+		{
+			const std::vector<std::uint8_t> file = MakeFile(layout);
+			bool consistent = true;
+			TEST_CHECK(t, ParseCopy(file, &consistent));
+			TEST_CHECK(t, consistent);
+
+			// One byte short of the last subresource.
+			std::vector<std::uint8_t> truncated(file.begin(), file.end() - 1);
+			consistent = true;
+			TEST_CHECK(t, !ParseCopy(truncated, &consistent));
+			TEST_CHECK(t, consistent);
+		}
+	});
+
+	// Corrupted copies of the corpus and the layouts: flipped bits, boundary values in
+	// header fields, truncation and trailing bytes.  Whatever Parse() accepts must be
+	// consistent, and whatever it rejects must say why.
+	suite.Add("dds/mutations", [](Test& t)
+	{
+		std::vector<std::vector<std::uint8_t>> seeds;
+		for (const char* name : kTextures)
+		{
+			std::vector<std::uint8_t> file = ReadFile(t.DataDirectory() + "/Textures/" + name);
+			if (!file.empty())
+				seeds.push_back(std::move(file));
+		}
+		for (const Layout& layout : kLayouts)
+			seeds.push_back(MakeFile(layout));
+
+		const uint32 interesting[] = {
+			0, 1, 2, 3, 4, 5, 6, 7, 8, 15, 16, 17, 255, 2048, 2049, 16384, 16385, 65535,
+			0x7fffffff, 0x80000000, 0xfffffffe, 0xffffffff, DDS_MAGIC, MAKEFOURCC('D', 'X', '1', '0'),
+			MAKEFOURCC('D', 'X', 'T', '1'), 124, 32, DDS_CUBEMAP_ALLFACES, DDS_HEADER_FLAGS_VOLUME };
+		const uint32 interestingCount = sizeof(interesting) / sizeof(interesting[0]);
+
+		std::mt19937 random(35);
+		uint32 accepted = 0;
+		uint32 inconsistent = 0;
+		const uint32 iterations = 40000;
+		for (uint32 iteration = 0; iteration < iterations; ++iteration)
+		{
+			std::vector<std::uint8_t> file = seeds[random() % seeds.size()];
+			const uint32 mutations = 1 + random() % 4;
+			for (uint32 m = 0; m < mutations; ++m)
+			{
+				// The headers, DX10 included.
+				const size_t header = (std::min)(file.size(), size_t(148));
+				switch (random() % 5)
+				{
+				case 0:
+					if (header > 0)
+						file[random() % header] ^= std::uint8_t(1u << (random() % 8));
+					break;
+				case 1:
+					if (header >= 4)
+					{
+						const uint32 value = interesting[random() % interestingCount];
+						std::memcpy(&file[(random() % (header / 4)) * 4], &value, 4);
+					}
+					break;
+				case 2:
+					file.resize(random() % (file.size() + 1));
+					break;
+				case 3:
+					if (header > 0)
+						file[random() % header] = std::uint8_t(random());
+					break;
+				case 4:
+					file.resize(file.size() + random() % 4096, 0);
+					break;
+				}
+			}
+
+			bool consistent = true;
+			if (ParseCopy(file, &consistent))
+				++accepted;
+			if (!consistent)
+				++inconsistent;
+		}
+
+		TEST_CHECK(t, inconsistent == 0);
+		// Some mutations leave a valid file, most do not.
+		TEST_CHECK(t, accepted > 0 && accepted < iterations);
+	});
+
+	suite.Add("dds/missing_file", [](Test& t)
+	{
+		DDSReader reader;
+		std::string error;
+		TEST_CHECK(t, !reader.Open(t.DataDirectory() + "/Textures/does_not_exist.dds", &error));
+		TEST_CHECK(t, !error.empty());
+		TEST_CHECK(t, !reader.IsOpen());
+	});
+}
@@ -0,0 +1,449 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../../RadianceTransfer_impl/DescriptorAllocator.h"
+#include "../../RadianceTransfer_impl/MockDescriptorHeap.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+	using Range = DescriptorAllocator::Range;
+
+	Range MakeRange(uint32 first, uint32 count)
+	{
+		Range range;
+		range.First = first;
+		range.Count = count;
+		return range;
+	}
+
+	bool SameStats(const DescriptorAllocator::Stats& a, const DescriptorAllocator::Stats& b)
+	{
+		return a.Allocated == b.Allocated && a.Allocations == b.Allocations && a.FreeRanges == b.FreeRanges &&
+			a.LargestFreeRange == b.LargestFreeRange;
+	}
+
+	template<typename Function>
+	bool ThrowsLogicError(Function function)
+	{
+		try
+		{
+			function();
+		}
+		catch (const std::logic_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	// Which allocation owns each slot, 0 for none.
+	class SlotMap
+	{
+	public:
+		explicit SlotMap(uint32 capacity) : mOwners(capacity, 0) {}
+
+		// Where first fit puts 'count' slots, or the capacity if nowhere.
+		uint32 FirstFit(uint32 count)const
+		{
+			uint32 run = 0;
+			for (uint32 slot = 0; slot < (uint32)mOwners.size(); ++slot)
+			{
+				run = mOwners[slot] == 0 ? run + 1 : 0;
+				if (run == count)
+					return slot + 1 - count;
+			}
+			return (uint32)mOwners.size();
+		}
+
+		void Set(const Range& range, uint32 owner)
+		{
+			std::fill(mOwners.begin() + range.First, mOwners.begin() + range.First + range.Count, owner);
+		}
+
+		// The free runs, as the allocator's statistics count them.
+		void FreeRuns(uint32* runs, uint32* largest)const
+		{
+			*runs = 0;
+			*largest = 0;
+			uint32 run = 0;
+			for (uint32 slot = 0; slot <= (uint32)mOwners.size(); ++slot)
+			{
+				if (slot < mOwners.size() && mOwners[slot] == 0)
+					++run;
+				else if (run > 0)
+				{
+					++*runs;
+					*largest = (std::max)(*largest, run);
+					run = 0;
+				}
+			}
+		}
+
+	private:
+		std::vector<uint32> mOwners;
+	};
+
+	struct Table
+	{
+		Range Slots;
+		std::vector<uint64> Descriptors;
+	};
+
+	struct Frame
+	{
+		uint64 Fence = 0;
+		std::vector<Table> Tables;
+	};
+}
+
+void AddDescriptorAllocatorTests(TestSuite& suite)
+{
+	// Random allocations and frees against a map of who owns each slot: every range is
+	// placed first fit, running out of space means no free range was large enough, and
+	// freeing anything but a whole allocation throws and changes nothing.
+	suite.Add("descriptors/slot_map", [](Test& t)
+	{
+		const uint32 capacity = 1000;
+		DescriptorAllocator allocator(capacity, 0);
+		SlotMap slots(capacity);
+		std::vector<std::pair<Range, uint32>> live;
+		std::vector<Range> freed;
+		std::mt19937 random(43);
+		uint32 nextOwner = 1;
+		bool firstFit = true;
+		bool outOfSpace = true;
+		bool rejected = true;
+		bool stats = true;
+		uint32 failures = 0;
+
+		for (uint32 op = 0; op < 200000; ++op)
+		{
+			const uint32 dice = random() % 100;
+			if (dice < 52 || live.empty())
+			{
+				const uint32 count = random() % 8 == 0 ? 1 + random() % 100 : 1 + random() % 8;
+				const uint32 expected = slots.FirstFit(count);
+				try
+				{
+					const Range range = allocator.Allocate(count);
+					firstFit &= range.First == expected && range.Count == count;
+					slots.Set(range, nextOwner);
+					live.emplace_back(range, nextOwner++);
+				}
+				catch (const std::runtime_error&)
+				{
+					outOfSpace &= expected == capacity;
+					++failures;
+				}
+			}
+			else if (dice < 97)
+			{
+				const size_t victim = random() % live.size();
+				allocator.Free(live[victim].first);
+				slots.Set(live[victim].first, 0);
+				freed.push_back(live[victim].first);
+				live[victim] = live.back();
+				live.pop_back();
+			}
+			else
+			{
+				// A range freed before, possibly reused since, or part of a live one.
+				const DescriptorAllocator::Stats before = allocator.GetStats();
+				Range bad = freed.empty() ? MakeRange(0, 0) : freed[random() % freed.size()];
+				if (dice == 99 || freed.empty())
+				{
+					const Range& whole = live[random() % live.size()].first;
+					bad = whole.Count > 1 ? MakeRange(whole.First + 1, whole.Count - 1) : MakeRange(whole.First, 2);
+				}
+				bool reused = false;
+				for (const auto& allocation : live)
+					reused |= allocation.first.First == bad.First && allocation.first.Count == bad.Count;
+				if (!reused)
+				{
+					rejected &= ThrowsLogicError([&] { allocator.Free(bad); });
+					rejected &= SameStats(before, allocator.GetStats());
+				}
+			}
+
+			if (op % 1000 == 0)
+			{
+				const DescriptorAllocator::Stats& s = allocator.GetStats();
+				uint32 allocated = 0;
+				for (const auto& allocation : live)
+					allocated += allocation.first.Count;
+				uint32 runs = 0;
+				uint32 largest = 0;
+				slots.FreeRuns(&runs, &largest);
+				stats &= s.Allocated == allocated && s.Allocations == live.size() && s.FreeRanges == runs &&
+					s.LargestFreeRange == largest && s.PeakAllocated >= allocated && s.PeakAllocated <= capacity;
+			}
+		}
+		TEST_CHECK(t, firstFit);
+		TEST_CHECK(t, outOfSpace);
+		TEST_CHECK(t, failures > 0);
+		TEST_CHECK(t, rejected);
+		TEST_CHECK(t, stats);
+
+		// Everything freed coalesces back into one range.
+		for (const auto& allocation : live)
+			allocator.Free(allocation.first);
+		TEST_CHECK(t, allocator.GetStats().FreeRanges == 1 && allocator.GetStats().LargestFreeRange == capacity);
+		TEST_CHECK(t, allocator.GetStats().Allocated == 0 && allocator.GetStats().Fragmentation == 0.0f);
+	});
+
+	// Frees that do not match an allocation exactly.
+	suite.Add("descriptors/free_errors", [](Test& t)
+	{
+		DescriptorAllocator allocator(64, 16);
+		const Range a = allocator.Allocate(8);
+		const Range b = allocator.Allocate(8);
+		const DescriptorAllocator::Stats before = allocator.GetStats();
+
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(MakeRange(a.First, 4)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(MakeRange(a.First + 2, 3)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(MakeRange(a.First + 4, 8)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(MakeRange(a.First, 16)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(MakeRange(a.First, 0)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(MakeRange(32, 4)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(MakeRange(60, 8)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(MakeRange(0xFFFFFFF8u, 16)); }));
+		TEST_CHECK(t, SameStats(before, allocator.GetStats()));
+
+		allocator.Free(a);
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Free(a); }));
+		allocator.Free(b);
+		TEST_CHECK(t, allocator.GetStats().FreeRanges == 1 && allocator.GetStats().Allocations == 0);
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.Allocate(0); }));
+	});
+
+	// Dirty runs against a bitmap, over word boundaries and a capacity that is not a
+	// multiple of 64, and what the mock heap's shader-visible copy ends up holding.
+	suite.Add("descriptors/dirty_runs", [](Test& t)
+	{
+		const uint32 capacity = 1000;
+		MockDescriptorHeap heap(capacity, 64);
+		const Range all = heap.Allocate(capacity);
+		std::vector<bool> dirty(capacity, false);
+		std::mt19937 random(44);
+		bool runsMatch = true;
+		bool copied = true;
+		uint64 value = 1;
+
+		for (uint32 round = 0; round < 300; ++round)
+		{
+			const uint32 writes = random() % 40;
+			for (uint32 i = 0; i < writes; ++i)
+			{
+				const uint32 first = random() % capacity;
+				const uint32 count = (std::min)(1 + (uint32)(random() % 100), capacity - first);
+				for (uint32 slot = first; slot < first + count; ++slot)
+				{
+					heap.Write(all, slot, value++);
+					dirty[slot] = true;
+				}
+			}
+			if (round % 50 == 0)
+			{
+				for (uint32 slot = 0; slot < capacity; ++slot)
+					heap.Write(all, slot, value++);
+				dirty.assign(capacity, true);
+			}
+
+			std::vector<Range> expected;
+			for (uint32 slot = 0; slot < capacity; ++slot)
+			{
+				if (!dirty[slot])
+					continue;
+				if (!expected.empty() && expected.back().First + expected.back().Count == slot)
+					++expected.back().Count;
+				else
+					expected.push_back(MakeRange(slot, 1));
+			}
+
+			DescriptorAllocator allocator(capacity, 0);
+			for (uint32 slot = 0; slot < capacity; ++slot)
+			{
+				if (dirty[slot])
+					allocator.MarkDirty(MakeRange(slot, 1));
+			}
+			std::vector<Range> runs;
+			allocator.TakeDirtyRuns(&runs);
+			bool same = runs.size() == expected.size();
+			for (size_t i = 0; same && i < runs.size(); ++i)
+				same = runs[i].First == expected[i].First && runs[i].Count == expected[i].Count;
+			runsMatch &= same && allocator.GetStats().CopyRuns == expected.size();
+			runs.clear();
+			allocator.TakeDirtyRuns(&runs);
+			runsMatch &= runs.empty() && allocator.GetStats().CopiedDescriptors == 0;
+
+			const uint32 calls = heap.CopyCalls();
+			heap.CopyDirty();
+			copied &= heap.CopyCalls() == calls + (expected.empty() ? 0 : 1);
+			copied &= heap.Allocator().GetStats().CopyRuns == expected.size();
+			for (uint32 slot = 0; slot < capacity; ++slot)
+				copied &= heap.ShaderVisible(slot) == heap.Staging(slot);
+			dirty.assign(capacity, false);
+		}
+		TEST_CHECK(t, runsMatch);
+		TEST_CHECK(t, copied);
+	});
+
+	// Ranges outside the persistent slots, a table's included, are rejected rather than
+	// marked past the end of the bitset.
+	suite.Add("descriptors/dirty_bounds", [](Test& t)
+	{
+		const uint32 capacity = 100;
+		DescriptorAllocator allocator(capacity, 32);
+		allocator.BeginFrame(0);
+		const Range table = allocator.AllocateTransient(8);
+		TEST_CHECK(t, table.First >= capacity);
+
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.MarkDirty(table); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.MarkDirty(MakeRange(capacity, 1)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.MarkDirty(MakeRange(capacity - 4, 5)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { allocator.MarkDirty(MakeRange(0xFFFFFFF0u, 32)); }));
+		allocator.MarkDirty(MakeRange(capacity - 4, 4));
+
+		std::vector<Range> runs;
+		allocator.TakeDirtyRuns(&runs);
+		TEST_CHECK(t, runs.size() == 1 && runs[0].First == capacity - 4 && runs[0].Count == 4);
+		allocator.EndFrame(1);
+	});
+
+	// Tables built against a fence completing 0 to 30 frames late: none overlaps a table
+	// still in flight, and each holds what it was built from until its fence passes.
+	suite.Add("descriptors/fake_fence", [](Test& t)
+	{
+		for (uint32 latency : { 0u, 1u, 3u, 30u })
+		{
+			const uint32 capacity = 256;
+			const uint32 ringSize = 256;
+			MockDescriptorHeap heap(capacity, ringSize);
+			const Range all = heap.Allocate(capacity);
+			std::mt19937 random(latency + 1);
+			std::deque<Frame> inFlight;
+			uint64 fence = 0;
+			uint64 value = 1;
+			bool inRing = true;
+			bool aliased = false;
+			bool intact = true;
+			uint32 wraps = 0;
+			uint32 previousEnd = 0;
+
+			for (uint32 f = 0; f < 2000; ++f)
+			{
+				const uint64 completed = fence > latency ? fence - latency : 0;
+				while (!inFlight.empty() && inFlight.front().Fence <= completed)
+				{
+					for (const Table& table : inFlight.front().Tables)
+					{
+						for (uint32 i = 0; i < table.Slots.Count; ++i)
+							intact &= heap.ShaderVisible(table.Slots.First + i) == table.Descriptors[i];
+					}
+					inFlight.pop_front();
+				}
+				heap.BeginFrame(completed);
+
+				// Persistent descriptors change between frames; tables keep their copies.
+				for (uint32 i = 0; i < 16; ++i)
+					heap.Write(all, random() % capacity, value++);
+				heap.CopyDirty();
+
+				Frame frame;
+				frame.Fence = ++fence;
+				// At most 7 slots a frame, so 31 frames in flight always fit.
+				uint32 left = 7;
+				while (left > 0 && random() % 4 != 0)
+				{
+					const uint32 a = random() % capacity;
+					const uint32 b = random() % capacity;
+					const uint32 countA = 1 + random() % (std::min)(left, 3u);
+					const uint32 countB = (std::min)(left - countA, (uint32)random() % 3);
+					const Range rangeA = MakeRange((std::min)(a, capacity - countA), countA);
+					const Range rangeB = MakeRange((std::min)(b, capacity - countB), countB);
+					left -= countA + countB;
+
+					Table table;
+					table.Slots = heap.BuildTable({ rangeA, rangeB });
+					for (const Range& range : { rangeA, rangeB })
+					{
+						for (uint32 i = 0; i < range.Count; ++i)
+							table.Descriptors.push_back(heap.Staging(range.First + i));
+					}
+					inRing &= table.Slots.First >= capacity && table.Slots.First + table.Slots.Count <= capacity + ringSize &&
+						table.Slots.Count == countA + countB;
+					for (uint32 i = 0; i < table.Slots.Count; ++i)
+						intact &= heap.ShaderVisible(table.Slots.First + i) == table.Descriptors[i];
+
+					for (const Frame& other : inFlight)
+					{
+						for (const Table& old : other.Tables)
+						{
+							aliased |= table.Slots.First < old.Slots.First + old.Slots.Count &&
+								old.Slots.First < table.Slots.First + table.Slots.Count;
+						}
+					}
+					for (const Table& old : frame.Tables)
+					{
+						aliased |= table.Slots.First < old.Slots.First + old.Slots.Count &&
+							old.Slots.First < table.Slots.First + table.Slots.Count;
+					}
+					wraps += table.Slots.First < previousEnd;
+					previousEnd = table.Slots.First + table.Slots.Count;
+					frame.Tables.push_back(table);
+				}
+				heap.EndFrame(frame.Fence);
+				inFlight.push_back(frame);
+			}
+			TEST_CHECK(t, inRing);
+			TEST_CHECK(t, !aliased);
+			TEST_CHECK(t, intact);
+			if (latency > 0)
+				TEST_CHECK(t, wraps > 0);
+		}
+	});
+
+	// A frame that overruns the ring throws, and the ring is usable again once the
+	// frames in flight complete.
+	suite.Add("descriptors/ring_full", [](Test& t)
+	{
+		DescriptorAllocator allocator(8, 16);
+		allocator.BeginFrame(0);
+		allocator.AllocateTransient(10);
+		allocator.EndFrame(1);
+
+		allocator.BeginFrame(0);
+		const Range second = allocator.AllocateTransient(6);
+		TEST_CHECK(t, second.First == 8 + 10);
+		bool threw = false;
+		try
+		{
+			allocator.AllocateTransient(1);
+		}
+		catch (const std::runtime_error&)
+		{
+			threw = true;
+		}
+		TEST_CHECK(t, threw);
+		allocator.EndFrame(2);
+
+		// Frame 1 done: its 10 slots at the front are free, but the head stays behind the
+		// tail, so 9 fit and 10 would not.
+		allocator.BeginFrame(1);
+		const Range wrapped = allocator.AllocateTransient(9);
+		TEST_CHECK(t, wrapped.First == 8);
+		allocator.EndFrame(3);
+
+		allocator.BeginFrame(3);
+		TEST_CHECK(t, allocator.AllocateTransient(16).First == 8);
+		TEST_CHECK(t, allocator.GetStats().PeakTransientFrameSlots == 16);
+		allocator.EndFrame(4);
+	});
+}
@@ -0,0 +1,386 @@
+#include "Tests.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../../Common/JobSystem.h"
+#include "../../RadianceTransfer_impl/EnvironmentMap.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint8 = std::uint8_t;
+
+	EnvironmentMap::Image RandomImage(uint32 width, uint32 height)
+	{
+		std::mt19937 random(38);
+		std::uniform_real_distribution<float> radiance(0.0f, 4.0f);
+		EnvironmentMap::Image image;
+		image.Width = width;
+		image.Height = height;
+		image.Texels.resize(size_t(width) * height * 3);
+		for (float& texel : image.Texels)
+			texel = radiance(random);
+		return image;
+	}
+
+	// A Radiance file with the given format line and resolution line, then 'pixels'.
+	std::vector<uint8> HdrFile(const std::string& format, const std::string& resolution, const std::vector<uint8>& pixels)
+	{
+		const std::string header = "#?RADIANCE\n# test\n" + format + "\nEXPOSURE=1.0\n\n" + resolution + "\n";
+		std::vector<uint8> file(header.begin(), header.end());
+		file.insert(file.end(), pixels.begin(), pixels.end());
+		return file;
+	}
+
+	std::vector<uint8> HdrFile(const std::string& resolution, const std::vector<uint8>& pixels)
+	{
+		return HdrFile("FORMAT=32-bit_rle_rgbe", resolution, pixels);
+	}
+
+	bool Parse(const std::vector<uint8>& file, EnvironmentMap::Image& image, std::string* error = nullptr)
+	{
+		return EnvironmentMap::ParseHdr(file.data(), file.size(), image, error);
+	}
+
+	// Texel x, y of the image is the grey 'value'.
+	bool IsGrey(const EnvironmentMap::Image& image, uint32 x, uint32 y, float value)
+	{
+		const float* texel = &image.Texels[(size_t(y) * image.Width + x) * 3];
+		return texel[0] == value && texel[1] == value && texel[2] == value;
+	}
+
+	// A per-channel run-length scanline of 'width' texels, every channel the same: runs
+	// where 'texels' repeats a value, literals elsewhere.
+	std::vector<uint8> PerChannelScanline(const std::vector<uint8>& rgbe, uint32 width)
+	{
+		std::vector<uint8> line = { 2, 2, uint8(width >> 8), uint8(width & 0xff) };
+		for (uint32 c = 0; c < 4; ++c)
+		{
+			for (uint32 x = 0; x < width;)
+			{
+				uint32 run = 1;
+				while (x + run < width && run < 127 && rgbe[(x + run) * 4 + c] == rgbe[x * 4 + c])
+					++run;
+				if (run >= 3)
+				{
+					line.push_back(uint8(128 + run));
+					line.push_back(rgbe[x * 4 + c]);
+					x += run;
+					continue;
+				}
+				uint32 literal = 1;
+				while (x + literal < width && literal < 128 &&
+					!(x + literal + 2 < width && rgbe[(x + literal) * 4 + c] == rgbe[(x + literal + 1) * 4 + c] &&
+						rgbe[(x + literal) * 4 + c] == rgbe[(x + literal + 2) * 4 + c]))
+				{
+					++literal;
+				}
+				line.push_back(uint8(literal));
+				for (uint32 i = 0; i < literal; ++i)
+					line.push_back(rgbe[(x + i) * 4 + c]);
+				x += literal;
+			}
+		}
+		return line;
+	}
+
+	// Unit vectors along the axes, as the D3D documentation names the cube faces.
+	struct Axis
+	{
+		float V[3];
+	};
+
+	bool SameDirection(const float a[3], const float b[3])
+	{
+		return std::fabs(a[0] - b[0]) < 1e-5f && std::fabs(a[1] - b[1]) < 1e-5f && std::fabs(a[2] - b[2]) < 1e-5f;
+	}
+}
+
+void AddEnvironmentMapTests(TestSuite& suite)
+{
+	// A constant sky has only the first coefficient: the radiance times the integral of
+	// Y00 over the sphere, sqrt(4 pi).
+	suite.Add("environment/constant_sky", [](Test& t)
+	{
+		EnvironmentMap::Image image;
+		image.Width = 256;
+		image.Height = 128;
+		image.Texels.assign(size_t(image.Width) * image.Height * 3, 2.0f);
+
+		const EnvironmentMap::SH9 sh = EnvironmentMap::ProjectSH(image);
+		const double expected = 2.0 * std::sqrt(4.0 * 3.14159265358979323846);
+		for (uint32 c = 0; c < 3; ++c)
+			TEST_CHECK_NEAR(t, sh.Coeffs[0][c], expected, 1e-3);
+		for (uint32 i = 1; i < 9; ++i)
+			for (uint32 c = 0; c < 3; ++c)
+				TEST_CHECK_NEAR(t, sh.Coeffs[i][c], 0.0, 1e-3);
+	});
+
+	// The bands and tiles are fixed, so the result is bit for bit the same on the calling
+	// thread and spread over any number of workers.
+	suite.Add("environment/jobs_match_serial", [](Test& t)
+	{
+		const EnvironmentMap::Image image = RandomImage(300, 150);
+		const EnvironmentMap::SH9 serialSH = EnvironmentMap::ProjectSH(image);
+		const EnvironmentMap::Cubemap serialCube = EnvironmentMap::ResampleCube(image, 64);
+
+		for (uint32 workers : { 1u, 3u, 8u })
+		{
+			JobSystem jobs(workers);
+			const EnvironmentMap::SH9 sh = EnvironmentMap::ProjectSH(image, &jobs);
+			TEST_CHECK(t, std::memcmp(&sh, &serialSH, sizeof(sh)) == 0);
+
+			const EnvironmentMap::Cubemap cube = EnvironmentMap::ResampleCube(image, 64, 0, &jobs);
+			TEST_CHECK(t, cube.Size == serialCube.Size && cube.MipCount == serialCube.MipCount);
+			TEST_CHECK(t, cube.Surfaces == serialCube.Surfaces);
+		}
+	});
+
+	// Flat texels convert as mantissa * 2^(exponent - 136), exponent 0 being black, in the
+	// standard -Y orientation with the top row first.
+	suite.Add("environment/hdr_flat", [](Test& t)
+	{
+		const std::vector<uint8> pixels = {
+			128, 64, 32, 129,   0, 0, 0, 0,   255, 255, 255, 140,
+			1, 2, 3, 0,         16, 16, 16, 128,   200, 100, 50, 136,
+		};
+		EnvironmentMap::Image image;
+		std::string error;
+		if (!TEST_CHECK(t, Parse(HdrFile("-Y 2 +X 3", pixels), image, &error)))
+			t.Fail(error, __FILE__, __LINE__);
+		if (!TEST_CHECK(t, image.Width == 3 && image.Height == 2 && image.Texels.size() == 18))
+			return;
+
+		const float expected[18] = {
+			1.0f, 0.5f, 0.25f,   0.0f, 0.0f, 0.0f,   255.0f * 16.0f, 255.0f * 16.0f, 255.0f * 16.0f,
+			0.0f, 0.0f, 0.0f,    16.0f / 256.0f, 16.0f / 256.0f, 16.0f / 256.0f,   200.0f, 100.0f, 50.0f,
+		};
+		for (uint32 i = 0; i < 18; ++i)
+			TEST_CHECK(t, image.Texels[i] == expected[i]);
+
+		// CRLF line ends and a missing FORMAT line are accepted too.
+		const std::string header = "#?RGBE\r\n\r\n-Y 1 +X 1\r\n";
+		std::vector<uint8> crlf(header.begin(), header.end());
+		crlf.insert(crlf.end(), { 128, 128, 128, 129 });
+		TEST_CHECK(t, Parse(crlf, image) && image.Width == 1 && IsGrey(image, 0, 0, 1.0f));
+	});
+
+	// "+Y" files store the bottom row first, so they are flipped to the top row first.
+	suite.Add("environment/hdr_flip", [](Test& t)
+	{
+		std::vector<uint8> pixels;
+		for (uint8 row = 0; row < 3; ++row)
+			for (uint32 x = 0; x < 2; ++x)
+				pixels.insert(pixels.end(), { uint8(10 + row), uint8(10 + row), uint8(10 + row), 136 });
+
+		EnvironmentMap::Image down, up;
+		TEST_CHECK(t, Parse(HdrFile("-Y 3 +X 2", pixels), down));
+		TEST_CHECK(t, Parse(HdrFile("+Y 3 +X 2", pixels), up));
+		if (!TEST_CHECK(t, down.Height == 3 && up.Height == 3))
+			return;
+		for (uint32 y = 0; y < 3; ++y)
+		{
+			for (uint32 x = 0; x < 2; ++x)
+			{
+				TEST_CHECK(t, IsGrey(down, x, y, float(10 + y)));
+				TEST_CHECK(t, IsGrey(up, x, 2 - y, float(10 + y)));
+			}
+		}
+	});
+
+	// Old-style runs repeat the previous texel, with consecutive counts as the higher
+	// bytes of one count; per-channel runs decode to the same image as flat texels.
+	suite.Add("environment/hdr_rle", [](Test& t)
+	{
+		// 2 texels, then a repeat of 3, a texel and a repeat of 1 + (1 << 8) = 257.
+		const uint32 width = 2 + 3 + 1 + 257;
+		std::vector<uint8> old = { 10, 10, 10, 136,   20, 20, 20, 136,   1, 1, 1, 3,
+			30, 30, 30, 136,   1, 1, 1, 1,   1, 1, 1, 1 };
+		EnvironmentMap::Image image;
+		std::string error;
+		if (!TEST_CHECK(t, Parse(HdrFile("-Y 1 +X " + std::to_string(width), old), image, &error)))
+			t.Fail(error, __FILE__, __LINE__);
+		else
+		{
+			TEST_CHECK(t, IsGrey(image, 0, 0, 10.0f));
+			for (uint32 x = 1; x < 5; ++x)
+				TEST_CHECK(t, IsGrey(image, x, 0, 20.0f));
+			for (uint32 x = 5; x < width; ++x)
+				TEST_CHECK(t, IsGrey(image, x, 0, 30.0f));
+		}
+
+		// Two rows of 300 texels with runs and literals, stored both ways.
+		const uint32 wide = 300;
+		std::mt19937 random(37);
+		std::vector<uint8> rgbe(size_t(wide) * 2 * 4);
+		for (uint32 x = 0; x < wide * 2; ++x)
+		{
+			const uint8 mantissa = (x / 7) % 3 == 0 ? uint8(random() % 256) : uint8(128 + (x / 40) % 4);
+			const uint8 texel[4] = { mantissa, uint8(mantissa / 2), uint8(x % 5 == 0 ? 9 : 200), uint8(130 + (x / 100) % 3) };
+			std::memcpy(&rgbe[x * 4], texel, 4);
+		}
+		std::vector<uint8> encoded;
+		for (uint32 y = 0; y < 2; ++y)
+		{
+			const std::vector<uint8> row(rgbe.begin() + y * wide * 4, rgbe.begin() + (y + 1) * wide * 4);
+			const std::vector<uint8> line = PerChannelScanline(row, wide);
+			encoded.insert(encoded.end(), line.begin(), line.end());
+		}
+		TEST_CHECK(t, encoded.size() < rgbe.size());
+
+		EnvironmentMap::Image flat, perChannel;
+		const std::string resolution = "-Y 2 +X " + std::to_string(wide);
+		TEST_CHECK(t, Parse(HdrFile(resolution, rgbe), flat));
+		if (!TEST_CHECK(t, Parse(HdrFile(resolution, encoded), perChannel, &error)))
+			t.Fail(error, __FILE__, __LINE__);
+		TEST_CHECK(t, flat.Width == wide && flat.Height == 2);
+		TEST_CHECK(t, perChannel.Texels == flat.Texels);
+	});
+
+	// Runs and repeats that overrun the scanline, data that ends early and repeats with
+	// nothing to repeat all fail rather than read or write out of bounds.
+	suite.Add("environment/hdr_bad_runs", [](Test& t)
+	{
+		struct Case
+		{
+			const char* Name;
+			std::string Resolution;
+			std::vector<uint8> Pixels;
+		};
+		const std::vector<uint8> good8 = { 2, 2, 0, 8,   136, 1,   136, 2,   136, 3,   136, 136 };
+		const Case cases[] = {
+			{ "no pixels", "-Y 1 +X 2", {} },
+			{ "truncated flat", "-Y 1 +X 2", { 1, 2, 3, 136, 4, 5 } },
+			{ "missing row", "-Y 2 +X 1", { 1, 2, 3, 136 } },
+			{ "repeat first", "-Y 1 +X 2", { 1, 1, 1, 2 } },
+			{ "repeat overrun", "-Y 1 +X 3", { 9, 9, 9, 136, 1, 1, 1, 3 } },
+			{ "repeat shift", "-Y 1 +X 2", { 9, 9, 9, 136, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1 } },
+			{ "width mismatch", "-Y 1 +X 8", { 2, 2, 0, 9, 136, 1, 136, 2, 136, 3, 136, 136 } },
+			{ "run overrun", "-Y 1 +X 8", { 2, 2, 0, 8, 137, 1, 136, 2, 136, 3, 136, 136 } },
+			{ "literal overrun", "-Y 1 +X 8", { 2, 2, 0, 8, 9, 1, 2, 3, 4, 5, 6, 7, 8, 9 } },
+			{ "zero literal", "-Y 1 +X 8", { 2, 2, 0, 8, 0, 1, 136, 1, 136, 2, 136, 3, 136, 136 } },
+			{ "truncated literal", "-Y 1 +X 8", { 2, 2, 0, 8, 8, 1, 2, 3 } },
+			{ "truncated run", "-Y 1 +X 8", { 2, 2, 0, 8, 136, 1, 136, 2, 136 } },
+			{ "truncated channel", "-Y 1 +X 8", { 2, 2, 0, 8, 136, 1, 136, 2, 136, 3 } },
+		};
+		for (const Case& c : cases)
+		{
+			EnvironmentMap::Image image;
+			std::string error;
+			if (!TEST_CHECK(t, !Parse(HdrFile(c.Resolution, c.Pixels), image, &error) && !error.empty()))
+				t.Fail(c.Name, __FILE__, __LINE__);
+			TEST_CHECK(t, image.Width == 0 && image.Texels.empty());
+		}
+
+		// The well-formed scanline the per-channel cases break.
+		EnvironmentMap::Image image;
+		if (TEST_CHECK(t, Parse(HdrFile("-Y 1 +X 8", good8), image) && image.Width == 8))
+		{
+			for (uint32 x = 0; x < 8; ++x)
+				TEST_CHECK(t, image.Texels[x * 3] == 1.0f && image.Texels[x * 3 + 1] == 2.0f && image.Texels[x * 3 + 2] == 3.0f);
+		}
+	});
+
+	// Files that are not RGBE, XYZE files and resolution lines other than -Y/+Y then +X
+	// are rejected.
+	suite.Add("environment/hdr_bad_header", [](Test& t)
+	{
+		const std::vector<uint8> texel = { 128, 128, 128, 129 };
+		std::vector<std::vector<uint8>> files = {
+			{},
+			{ 'P', '6', '\n' },
+			HdrFile("FORMAT=32-bit_rle_xyze", "-Y 1 +X 1", texel),
+			HdrFile("FORMAT=something", "-Y 1 +X 1", texel),
+			HdrFile("+X 1 -Y 1", texel),
+			HdrFile("-Y 1 -X 1", texel),
+			HdrFile("-Z 1 +X 1", texel),
+			HdrFile("-Y 0 +X 1", {}),
+			HdrFile("-Y 1 +X 0", {}),
+			HdrFile("-Y 1 +X", texel),
+			HdrFile("-Y 100000 +X 100000", texel),
+		};
+		const std::string unterminated = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n";
+		files.emplace_back(unterminated.begin(), unterminated.end());
+
+		for (const std::vector<uint8>& file : files)
+		{
+			EnvironmentMap::Image image;
+			std::string error;
+			TEST_CHECK(t, !Parse(file, image, &error) && !error.empty());
+			TEST_CHECK(t, image.Texels.empty());
+		}
+
+		EnvironmentMap::Image image;
+		std::string error;
+		Parse(HdrFile("FORMAT=32-bit_rle_xyze", "-Y 1 +X 1", texel), image, &error);
+		TEST_CHECK(t, error.find("xyze") != std::string::npos);
+	});
+
+	// Faces follow D3D: looking down the face axis, texel x grows along 'right' and y
+	// along 'down', and neighbouring faces meet along shared edges.
+	suite.Add("environment/cube_faces", [](Test& t)
+	{
+		const Axis px = { { 1, 0, 0 } }, nx = { { -1, 0, 0 } };
+		const Axis py = { { 0, 1, 0 } }, ny = { { 0, -1, 0 } };
+		const Axis pz = { { 0, 0, 1 } }, nz = { { 0, 0, -1 } };
+		const Axis faces[6][3] = {
+			// axis, right, down
+			{ px, nz, ny },
+			{ nx, pz, ny },
+			{ py, px, pz },
+			{ ny, px, nz },
+			{ pz, px, ny },
+			{ nz, nx, ny },
+		};
+
+		const uint32 size = 16;
+		for (uint32 face = 0; face < 6; ++face)
+		{
+			const float* axis = faces[face][0].V;
+			const float* right = faces[face][1].V;
+			const float* down = faces[face][2].V;
+			for (float y : { 0.0f, 3.5f, 8.0f, 16.0f })
+			{
+				for (float x : { 0.0f, 0.5f, 8.0f, 11.25f, 16.0f })
+				{
+					const float s = 2.0f * x / size - 1.0f;
+					const float u = 2.0f * y / size - 1.0f;
+					float expected[3];
+					for (uint32 i = 0; i < 3; ++i)
+						expected[i] = axis[i] + s * right[i] + u * down[i];
+					const float length = std::sqrt(expected[0] * expected[0] + expected[1] * expected[1] + expected[2] * expected[2]);
+					for (float& e : expected)
+						e /= length;
+
+					float d[3];
+					EnvironmentMap::CubeDirection(face, size, x, y, d);
+					if (!TEST_CHECK(t, SameDirection(d, expected)))
+					{
+						t.Fail("face " + std::to_string(face) + " x " + std::to_string(x) + " y " + std::to_string(y),
+							__FILE__, __LINE__);
+					}
+				}
+			}
+		}
+
+		// The right edge of +z is the left edge of +x, its top edge the bottom edge of +y,
+		// and the right edge of -x the left edge of +z.
+		for (float along : { 0.0f, 5.0f, 16.0f })
+		{
+			float a[3], b[3];
+			EnvironmentMap::CubeDirection(4, size, float(size), along, a);
+			EnvironmentMap::CubeDirection(0, size, 0.0f, along, b);
+			TEST_CHECK(t, SameDirection(a, b));
+			EnvironmentMap::CubeDirection(4, size, along, 0.0f, a);
+			EnvironmentMap::CubeDirection(2, size, along, float(size), b);
+			TEST_CHECK(t, SameDirection(a, b));
+			EnvironmentMap::CubeDirection(1, size, float(size), along, a);
+			EnvironmentMap::CubeDirection(4, size, 0.0f, along, b);
+			TEST_CHECK(t, SameDirection(a, b));
+		}
+	});
+}
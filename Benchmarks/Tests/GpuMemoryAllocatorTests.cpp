@@ -0,0 +1,521 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../../RadianceTransfer_impl/GpuMemoryAllocator.h"
+#include "../../RadianceTransfer_impl/MockGpuMemoryDevice.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	const uint64 KB = 1024;
+	const uint64 MB = 1024 * 1024;
+	const uint32 kClassCount = (uint32)GpuMemoryClass::Count;
+
+	struct Live
+	{
+		GpuMemoryAllocator::Allocation Memory;
+		uint64 Alignment = 0;
+		bool Movable = false;
+	};
+
+	struct Pending
+	{
+		GpuMemoryAllocator::Allocation Memory;
+		uint64 Fence = 0; // 0 until the frame that retired it ends
+	};
+
+	bool SameAllocation(const GpuMemoryAllocator::Allocation& a, const GpuMemoryAllocator::Allocation& b)
+	{
+		return a.Node == b.Node && a.Heap == b.Heap && a.Offset == b.Offset && a.Size == b.Size;
+	}
+
+	// What the allocator should hold, kept independently of its free lists: the live and
+	// retired allocations, which heaps are dedicated and which are being drained.
+	class Model
+	{
+	public:
+		Model(MockGpuMemoryDevice& device, GpuMemoryAllocator& allocator, uint64 heapSize)
+			: mDevice(device), mAllocator(allocator), mHeapSize(heapSize) {}
+
+		const Live& Allocate(GpuMemoryClass memoryClass, uint64 size, uint64 alignment, bool movable)
+		{
+			Live live;
+			live.Memory = mAllocator.Allocate(memoryClass, size, alignment, movable);
+			live.Alignment = alignment;
+			live.Movable = movable;
+			mAligned &= live.Memory.Size >= size && live.Memory.Offset % alignment == 0 &&
+				live.Memory.Class == memoryClass;
+
+			const uint64 granules = (size + GpuMemoryAllocator::Granularity - 1) / GpuMemoryAllocator::Granularity;
+			const uint64 alignmentGranules = (std::max)(alignment, GpuMemoryAllocator::Granularity) /
+				GpuMemoryAllocator::Granularity;
+			const uint64 heapGranules = mHeapSize / GpuMemoryAllocator::Granularity;
+			if (granules > heapGranules / 2 || granules + alignmentGranules - 1 > heapGranules)
+				mDedicated.insert(live.Memory.Heap);
+			mLive.push_back(live);
+			return mLive.back();
+		}
+
+		void Free(size_t index)
+		{
+			mAllocator.Free(mLive[index].Memory);
+			mLive[index] = mLive.back();
+			mLive.pop_back();
+		}
+
+		void Retire(size_t index)
+		{
+			mAllocator.Retire(mLive[index].Memory);
+			Pending pending;
+			pending.Memory = mLive[index].Memory;
+			mRetired.push_back(pending);
+			mLive[index] = mLive.back();
+			mLive.pop_back();
+		}
+
+		void BeginFrame(uint64 completedFence)
+		{
+			mAllocator.BeginFrame(completedFence);
+			for (size_t i = 0; i < mRetired.size();)
+			{
+				if (mRetired[i].Fence != 0 && mRetired[i].Fence <= completedFence)
+				{
+					mRetired[i] = mRetired.back();
+					mRetired.pop_back();
+				}
+				else
+					++i;
+			}
+		}
+
+		void EndFrame(uint64 fence)
+		{
+			mAllocator.EndFrame(fence);
+			for (Pending& pending : mRetired)
+			{
+				if (pending.Fence == 0)
+					pending.Fence = fence;
+			}
+		}
+
+		// Applies a defragmentation plan the way the renderer would: each moved allocation
+		// is retired at its old place and lives on at the new one.  False if a move is not
+		// to a different, non-draining heap at the alignment and size it had, or does not
+		// match a movable live allocation.
+		bool Defragment(const std::vector<GpuMemoryAllocator::Move>& moves)
+		{
+			bool valid = true;
+			for (const GpuMemoryAllocator::Move& move : moves)
+				mDraining.insert(move.From.Heap);
+			for (const GpuMemoryAllocator::Move& move : moves)
+			{
+				auto live = std::find_if(mLive.begin(), mLive.end(),
+					[&move](const Live& l) { return SameAllocation(l.Memory, move.From); });
+				if (live == mLive.end() || !live->Movable)
+				{
+					valid = false;
+					continue;
+				}
+				valid &= move.To.Heap != move.From.Heap && !mDraining.count(move.To.Heap) &&
+					!mDedicated.count(move.To.Heap) && move.To.Size == move.From.Size &&
+					move.To.Class == move.From.Class && move.To.Offset % live->Alignment == 0;
+
+				Live moved = *live;
+				moved.Memory = move.To;
+				Retire(live - mLive.begin());
+				mLive.push_back(moved);
+			}
+			return valid;
+		}
+
+		// Compares the allocator with the model: placement, the byte and allocation
+		// counts, and the free blocks, which are the gaps between allocations in the heaps
+		// that take new ones.
+		void Check(Test& t)
+		{
+			TEST_CHECK(t, mAligned);
+
+			std::vector<std::vector<std::pair<uint64, uint64>>> used(mDevice.CreatedHeaps());
+			uint64 bytes[kClassCount] = {};
+			uint64 retiredBytes[kClassCount] = {};
+			uint32 allocations[kClassCount] = {};
+			bool placed = true;
+			auto use = [&](const GpuMemoryAllocator::Allocation& memory)
+			{
+				placed &= mDevice.IsLive(memory.Heap) && mDevice.HeapClass(memory.Heap) == memory.Class &&
+					memory.Offset + memory.Size <= mDevice.HeapSize(memory.Heap);
+				if (memory.Heap < used.size())
+					used[memory.Heap].push_back(std::make_pair(memory.Offset, memory.Size));
+				bytes[(int)memory.Class] += memory.Size;
+				++allocations[(int)memory.Class];
+			};
+			for (const Live& live : mLive)
+				use(live.Memory);
+			for (const Pending& pending : mRetired)
+			{
+				use(pending.Memory);
+				retiredBytes[(int)pending.Memory.Class] += pending.Memory.Size;
+			}
+			TEST_CHECK(t, placed);
+
+			// Drained heaps are gone once their last retired allocation is freed.
+			for (auto it = mDraining.begin(); it != mDraining.end();)
+				it = mDevice.IsLive(*it) ? std::next(it) : mDraining.erase(it);
+			for (auto it = mDedicated.begin(); it != mDedicated.end();)
+				it = mDevice.IsLive(*it) ? std::next(it) : mDedicated.erase(it);
+
+			uint32 heaps[kClassCount] = {};
+			uint64 heapBytes[kClassCount] = {};
+			uint32 freeBlocks[kClassCount] = {};
+			uint64 freeBytes[kClassCount] = {};
+			uint64 largest[kClassCount] = {};
+			uint32 emptyHeaps[kClassCount] = {};
+			bool overlap = false;
+			for (uint32 heap = 0; heap < mDevice.CreatedHeaps(); ++heap)
+			{
+				if (!mDevice.IsLive(heap))
+					continue;
+				const int c = (int)mDevice.HeapClass(heap);
+				++heaps[c];
+				heapBytes[c] += mDevice.HeapSize(heap);
+				// Only empty heaps that are kept to allocate from outlive their allocations.
+				overlap |= used[heap].empty() && (mDedicated.count(heap) || mDraining.count(heap));
+
+				std::vector<std::pair<uint64, uint64>>& spans = used[heap];
+				std::sort(spans.begin(), spans.end());
+				uint64 end = 0;
+				std::vector<uint64> gaps;
+				for (const std::pair<uint64, uint64>& span : spans)
+				{
+					overlap |= span.first < end;
+					if (span.first > end)
+						gaps.push_back(span.first - end);
+					end = (std::max)(end, span.first + span.second);
+				}
+				if (end < mDevice.HeapSize(heap))
+					gaps.push_back(mDevice.HeapSize(heap) - end);
+
+				if (mDedicated.count(heap) || mDraining.count(heap))
+					continue;
+				emptyHeaps[c] += spans.empty();
+				for (uint64 gap : gaps)
+				{
+					++freeBlocks[c];
+					freeBytes[c] += gap;
+					largest[c] = (std::max)(largest[c], gap);
+				}
+			}
+			TEST_CHECK(t, !overlap);
+
+			for (uint32 c = 0; c < kClassCount; ++c)
+			{
+				const GpuMemoryAllocator::Stats stats = mAllocator.GetStats((GpuMemoryClass)c);
+				TEST_CHECK(t, stats.AllocatedBytes == bytes[c]);
+				TEST_CHECK(t, stats.Allocations == allocations[c]);
+				TEST_CHECK(t, stats.RetiredBytes == retiredBytes[c]);
+				TEST_CHECK(t, stats.Heaps == heaps[c]);
+				TEST_CHECK(t, stats.HeapBytes == heapBytes[c]);
+				TEST_CHECK(t, stats.FreeBlocks == freeBlocks[c]);
+				TEST_CHECK(t, stats.LargestFreeBlock == largest[c]);
+				const float fragmentation = freeBytes[c] == 0 ? 0.0f :
+					1.0f - (float)((double)largest[c] / freeBytes[c]);
+				TEST_CHECK_NEAR(t, stats.Fragmentation, fragmentation, 1e-6);
+				TEST_CHECK(t, emptyHeaps[c] <= 1);
+			}
+		}
+
+		std::vector<Live>& LiveAllocations() { return mLive; }
+		size_t RetiredCount()const { return mRetired.size(); }
+
+	private:
+		MockGpuMemoryDevice& mDevice;
+		GpuMemoryAllocator& mAllocator;
+		uint64 mHeapSize;
+		std::vector<Live> mLive;
+		std::vector<Pending> mRetired;
+		std::set<uint32> mDedicated;
+		std::set<uint32> mDraining;
+		bool mAligned = true;
+	};
+
+	bool Throws(GpuMemoryAllocator& allocator, const GpuMemoryAllocator::Allocation& allocation)
+	{
+		try
+		{
+			allocator.Free(allocation);
+		}
+		catch (const std::logic_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+}
+
+void AddGpuMemoryAllocatorTests(TestSuite& suite)
+{
+	// Random allocations, frees, retirements and defragmentation in every class, with
+	// the fence a few frames behind, checked against the model after each frame.
+	suite.Add("gpumemory/stress", [](Test& t)
+	{
+		for (uint32 seed : { 1u, 2u, 3u })
+		{
+			MockGpuMemoryDevice device;
+			{
+				GpuMemoryAllocator allocator(device, 64 * MB);
+				Model model(device, allocator, 64 * MB);
+				std::mt19937 random(seed);
+				uint64 fence = 0;
+				uint64 completed = 0;
+				bool validPlans = true;
+				uint32 moves = 0;
+				for (uint32 frame = 0; frame < 2000; ++frame)
+				{
+					model.BeginFrame(completed);
+					const uint32 operations = random() % 20;
+					for (uint32 i = 0; i < operations; ++i)
+					{
+						std::vector<Live>& live = model.LiveAllocations();
+						const uint32 operation = random() % 10;
+						if (operation < 5 || live.empty())
+						{
+							const GpuMemoryClass memoryClass = (GpuMemoryClass)(random() % kClassCount);
+							const uint64 size = random() % 4 == 0 ? random() % (40 * MB) + 1 : random() % (2 * MB) + 1;
+							const uint64 alignment = memoryClass == GpuMemoryClass::RenderTarget && random() % 2 ?
+								4 * MB : 64 * KB;
+							model.Allocate(memoryClass, size, alignment, random() % 2 == 0);
+						}
+						else if (operation < 8)
+							model.Free(random() % live.size());
+						else
+							model.Retire(random() % live.size());
+					}
+					if (frame % 97 == 0)
+					{
+						for (uint32 c = 0; c < kClassCount; ++c)
+						{
+							const std::vector<GpuMemoryAllocator::Move> plan =
+								allocator.PlanDefragmentation((GpuMemoryClass)c, 256 * MB);
+							validPlans &= model.Defragment(plan);
+							moves += (uint32)plan.size();
+						}
+					}
+					model.Check(t);
+					if (!t.Failures().empty())
+						return;
+
+					model.EndFrame(++fence);
+					completed = fence > 3 ? fence - random() % 4 : 0;
+				}
+				TEST_CHECK(t, validPlans);
+				TEST_CHECK(t, moves > 0);
+
+				// Freeing twice, or an allocation that is waiting on the GPU, is misuse.
+				std::vector<Live>& live = model.LiveAllocations();
+				if (TEST_CHECK(t, live.size() >= 2))
+				{
+					const GpuMemoryAllocator::Allocation freed = live.back().Memory;
+					model.Free(live.size() - 1);
+					TEST_CHECK(t, Throws(allocator, freed));
+					const GpuMemoryAllocator::Allocation retired = live.back().Memory;
+					model.Retire(live.size() - 1);
+					TEST_CHECK(t, Throws(allocator, retired));
+				}
+
+				// With everything freed each class is down to at most one whole, empty heap.
+				while (!live.empty())
+					model.Free(live.size() - 1);
+				model.EndFrame(++fence);
+				model.BeginFrame(fence);
+				TEST_CHECK(t, model.RetiredCount() == 0);
+				model.Check(t);
+				for (uint32 c = 0; c < kClassCount; ++c)
+				{
+					const GpuMemoryAllocator::Stats stats = allocator.GetStats((GpuMemoryClass)c);
+					TEST_CHECK(t, stats.Heaps <= 1);
+					TEST_CHECK(t, stats.Heaps == 0 || (stats.FreeBlocks == 1 && stats.LargestFreeBlock == 64 * MB));
+				}
+			}
+			TEST_CHECK(t, device.LiveHeaps() == 0);
+		}
+	});
+
+	// Freeing every other block of a heap leaves as many free blocks as allocations,
+	// none larger than one; freeing the rest merges them back into the whole heap.
+	suite.Add("gpumemory/fragmentation", [](Test& t)
+	{
+		MockGpuMemoryDevice device;
+		GpuMemoryAllocator allocator(device, 16 * MB);
+		Model model(device, allocator, 16 * MB);
+
+		for (uint32 i = 0; i < 16; ++i)
+			model.Allocate(GpuMemoryClass::Buffer, MB, 64 * KB, false);
+		GpuMemoryAllocator::Stats stats = allocator.GetStats(GpuMemoryClass::Buffer);
+		TEST_CHECK(t, stats.Heaps == 1 && stats.FreeBlocks == 0);
+		TEST_CHECK(t, stats.Fragmentation == 0.0f);
+
+		// Keep the allocations at even offsets.
+		std::vector<Live>& live = model.LiveAllocations();
+		for (size_t i = live.size(); i-- > 0;)
+		{
+			if ((live[i].Memory.Offset / MB) % 2 == 1)
+				model.Free(i);
+		}
+		model.Check(t);
+		stats = allocator.GetStats(GpuMemoryClass::Buffer);
+		TEST_CHECK(t, stats.FreeBlocks == 8);
+		TEST_CHECK(t, stats.LargestFreeBlock == MB);
+		TEST_CHECK_NEAR(t, stats.Fragmentation, 1.0 - 1.0 / 8.0, 1e-6);
+
+		// Two megabytes fit in none of the holes.
+		model.Allocate(GpuMemoryClass::Buffer, 2 * MB, 64 * KB, false);
+		TEST_CHECK(t, allocator.GetStats(GpuMemoryClass::Buffer).Heaps == 2);
+		model.Free(live.size() - 1);
+		TEST_CHECK(t, allocator.GetStats(GpuMemoryClass::Buffer).Heaps == 1);
+
+		// Each free merges with the holes on both sides.
+		while (!live.empty())
+		{
+			model.Free(live.size() - 1);
+			model.Check(t);
+		}
+		stats = allocator.GetStats(GpuMemoryClass::Buffer);
+		TEST_CHECK(t, stats.FreeBlocks == 1 && stats.LargestFreeBlock == 16 * MB);
+		TEST_CHECK(t, stats.Fragmentation == 0.0f);
+	});
+
+	// A plan empties the sparsest heaps into the others, moves each movable allocation
+	// once, and the drained heaps take nothing new and go when the moves are retired.
+	suite.Add("gpumemory/defragment", [](Test& t)
+	{
+		MockGpuMemoryDevice device;
+		GpuMemoryAllocator allocator(device, 16 * MB);
+		Model model(device, allocator, 16 * MB);
+
+		for (uint32 i = 0; i < 64; ++i)
+			model.Allocate(GpuMemoryClass::Texture, 4 * MB, 64 * KB, true);
+		TEST_CHECK(t, allocator.GetStats(GpuMemoryClass::Texture).Heaps == 16);
+		std::vector<Live>& live = model.LiveAllocations();
+		for (size_t i = live.size(); i-- > 0;)
+		{
+			if (i % 4 != 0)
+				model.Free(i);
+		}
+		model.Check(t);
+		TEST_CHECK(t, allocator.GetStats(GpuMemoryClass::Texture).Fragmentation > 0.0f);
+
+		// A budget of two heaps' contents moves two heaps.
+		std::vector<GpuMemoryAllocator::Move> plan = allocator.PlanDefragmentation(GpuMemoryClass::Texture, 8 * MB);
+		TEST_CHECK(t, plan.size() == 2);
+		TEST_CHECK(t, model.Defragment(plan));
+		model.Check(t);
+
+		// Nothing new lands in a draining heap.
+		std::set<uint32> drained;
+		for (const GpuMemoryAllocator::Move& move : plan)
+			drained.insert(move.From.Heap);
+		const Live extra = model.Allocate(GpuMemoryClass::Texture, 4 * MB, 64 * KB, true);
+		TEST_CHECK(t, !drained.count(extra.Memory.Heap));
+
+		plan = allocator.PlanDefragmentation(GpuMemoryClass::Texture, ~0ull);
+		TEST_CHECK(t, model.Defragment(plan));
+		model.Check(t);
+		model.EndFrame(1);
+		model.BeginFrame(1);
+		model.Check(t);
+		const GpuMemoryAllocator::Stats stats = allocator.GetStats(GpuMemoryClass::Texture);
+		TEST_CHECK(t, stats.Heaps == 5);
+		TEST_CHECK(t, stats.Moves == 2 + plan.size());
+		TEST_CHECK(t, stats.Fragmentation == 0.0f);
+		for (uint32 heap : drained)
+			TEST_CHECK(t, !device.IsLive(heap));
+	});
+
+	// A heap holding an immovable allocation stays, and so does one the others have no
+	// room for; retiring allocations are not moved.
+	suite.Add("gpumemory/defragment_refusals", [](Test& t)
+	{
+		MockGpuMemoryDevice device;
+		GpuMemoryAllocator allocator(device, 16 * MB);
+		Model model(device, allocator, 16 * MB);
+
+		// One heap pinned by a megabyte, the other three quarters full and too much for it.
+		model.Allocate(GpuMemoryClass::Buffer, 8 * MB, 64 * KB, true);
+		model.Allocate(GpuMemoryClass::Buffer, 4 * MB, 64 * KB, true);
+		model.Allocate(GpuMemoryClass::Buffer, 1 * MB, 64 * KB, false);
+		model.Allocate(GpuMemoryClass::Buffer, 8 * MB, 64 * KB, true);
+		model.Allocate(GpuMemoryClass::Buffer, 4 * MB, 64 * KB, true);
+		TEST_CHECK(t, allocator.GetStats(GpuMemoryClass::Buffer).Heaps == 2);
+
+		const GpuMemoryAllocator::Stats before = allocator.GetStats(GpuMemoryClass::Buffer);
+		TEST_CHECK(t, allocator.PlanDefragmentation(GpuMemoryClass::Buffer, ~0ull).empty());
+		model.Check(t);
+		const GpuMemoryAllocator::Stats after = allocator.GetStats(GpuMemoryClass::Buffer);
+		TEST_CHECK(t, after.FreeBlocks == before.FreeBlocks && after.Allocations == before.Allocations);
+		TEST_CHECK(t, after.Moves == 0);
+
+		// The failed plan left the fuller heap open: only it has room for four megabytes.
+		model.Allocate(GpuMemoryClass::Buffer, 4 * MB, 64 * KB, true);
+		TEST_CHECK(t, allocator.GetStats(GpuMemoryClass::Buffer).Heaps == 2);
+		model.Check(t);
+
+		// Two half full heaps, one of them with a quarter retiring.
+		MockGpuMemoryDevice retiringDevice;
+		GpuMemoryAllocator retiring(retiringDevice, 16 * MB);
+		Model retiringModel(retiringDevice, retiring, 16 * MB);
+		for (uint32 i = 0; i < 8; ++i)
+			retiringModel.Allocate(GpuMemoryClass::Texture, 4 * MB, 64 * KB, true);
+		std::vector<Live>& live = retiringModel.LiveAllocations();
+		const uint32 firstHeap = live[0].Memory.Heap;
+		uint32 freedFirst = 0;
+		uint32 freedSecond = 0;
+		bool retired = false;
+		for (size_t i = live.size(); i-- > 0;)
+		{
+			if (live[i].Memory.Heap == firstHeap)
+			{
+				if (freedFirst++ < 2)
+					retiringModel.Free(i);
+			}
+			else if (!retired)
+			{
+				retiringModel.Retire(i);
+				retired = true;
+			}
+			else if (freedSecond++ < 2)
+				retiringModel.Free(i);
+		}
+		retiringModel.Check(t);
+
+		// Defragment() rejects a move of anything but a live allocation.
+		const std::vector<GpuMemoryAllocator::Move> plan = retiring.PlanDefragmentation(GpuMemoryClass::Texture, ~0ull);
+		TEST_CHECK(t, !plan.empty());
+		TEST_CHECK(t, retiringModel.Defragment(plan));
+		retiringModel.Check(t);
+		retiringModel.EndFrame(1);
+		retiringModel.BeginFrame(1);
+		retiringModel.Check(t);
+		TEST_CHECK(t, retiring.GetStats(GpuMemoryClass::Texture).Heaps == 1);
+
+		// A heap with nothing but a retiring allocation has nothing to move and keeps
+		// taking allocations.
+		MockGpuMemoryDevice idleDevice;
+		GpuMemoryAllocator idle(idleDevice, 16 * MB);
+		Model idleModel(idleDevice, idle, 16 * MB);
+		for (uint32 i = 0; i < 5; ++i)
+			idleModel.Allocate(GpuMemoryClass::Texture, 4 * MB, 64 * KB, true);
+		idleModel.Retire(idleModel.LiveAllocations().size() - 1);
+		TEST_CHECK(t, idle.PlanDefragmentation(GpuMemoryClass::Texture, ~0ull).empty());
+		idleModel.Allocate(GpuMemoryClass::Texture, 4 * MB, 64 * KB, true);
+		TEST_CHECK(t, idle.GetStats(GpuMemoryClass::Texture).Heaps == 2);
+		idleModel.Check(t);
+	});
+}
@@ -0,0 +1,270 @@
+#include "Tests.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../../Common/InputReplay.h"
+#include "../../RadianceTransfer_impl/TransformSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// What NormalMapApp::ApplyInput does with a frame, on a camera of its own and two
+	// TransformSystem objects for the arrow and IJKL keys.
+	class Simulation
+	{
+	public:
+		Simulation()
+		{
+			mArrows = mObjects.Add(XMFLOAT3(0.5f, -2.0f, 2.5f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+			mIjkl = mObjects.Add(XMFLOAT3(0.0f, 4.0f, 2.3f), XMFLOAT3(1.5f, 1.5f, 1.5f));
+			mObjects.Update();
+		}
+
+		void Apply(const InputFrame& input, float dt)
+		{
+			// A quarter of a degree per pixel.
+			mYaw += 0.25f * (XM_PI / 180.0f) * (float)input.MouseDx;
+			mPitch += 0.25f * (XM_PI / 180.0f) * (float)input.MouseDy;
+
+			const XMFLOAT3 look(std::sin(mYaw) * std::cos(mPitch), -std::sin(mPitch), std::cos(mYaw) * std::cos(mPitch));
+			const XMFLOAT3 right(std::cos(mYaw), 0.0f, -std::sin(mYaw));
+			const float walk = 10.0f * dt * ((input.IsDown(InputKey::W) ? 1.0f : 0.0f) - (input.IsDown(InputKey::S) ? 1.0f : 0.0f));
+			const float strafe = 10.0f * dt * ((input.IsDown(InputKey::D) ? 1.0f : 0.0f) - (input.IsDown(InputKey::A) ? 1.0f : 0.0f));
+			mCamera.x += walk * look.x + strafe * right.x;
+			mCamera.y += walk * look.y + strafe * right.y;
+			mCamera.z += walk * look.z + strafe * right.z;
+
+			const bool captureDown = input.IsDown(InputKey::Capture);
+			mCaptures += captureDown && !mCaptureDown;
+			mCaptureDown = captureDown;
+
+			Move(mArrows, input, InputKey::Up, InputKey::Down, InputKey::Left, InputKey::Right, 5.0f * dt);
+			Move(mIjkl, input, InputKey::I, InputKey::K, InputKey::J, InputKey::L, 5.0f * dt);
+			mObjects.Update();
+		}
+
+		// Everything the frame depends on, to compare bit for bit.
+		std::vector<float> State()const
+		{
+			std::vector<float> state = { mCamera.x, mCamera.y, mCamera.z, mYaw, mPitch, (float)mCaptures };
+			for (uint32 id : { mArrows, mIjkl })
+			{
+				const XMFLOAT4X4& world = mObjects.World(id);
+				state.insert(state.end(), &world.m[0][0], &world.m[0][0] + 16);
+			}
+			return state;
+		}
+
+	private:
+		void Move(uint32 id, const InputFrame& input, InputKey front, InputKey back, InputKey left, InputKey right, float d)
+		{
+			const float z = (input.IsDown(front) ? d : 0.0f) - (input.IsDown(back) ? d : 0.0f);
+			const float x = (input.IsDown(right) ? d : 0.0f) - (input.IsDown(left) ? d : 0.0f);
+			if (x != 0.0f || z != 0.0f)
+				mObjects.Translate(id, XMFLOAT3(x, 0.0f, z));
+		}
+
+	private:
+		XMFLOAT3 mCamera = { 0.0f, 2.0f, -15.0f };
+		float mYaw = 0.0f;
+		float mPitch = 0.0f;
+		uint32 mCaptures = 0;
+		bool mCaptureDown = false;
+
+		TransformSystem mObjects;
+		uint32 mArrows = 0;
+		uint32 mIjkl = 0;
+	};
+
+	// Keys held for a while and released, and mouse drags, as a user would.
+	InputFrame LiveInput(std::mt19937& random, InputFrame previous)
+	{
+		InputFrame frame = previous;
+		for (uint32 key = 0; key < (uint32)InputKey::Count; ++key)
+		{
+			if (random() % 20 == 0)
+				frame.SetDown((InputKey)key, !frame.IsDown((InputKey)key));
+		}
+		const bool dragging = random() % 4 == 0;
+		frame.MouseDx = dragging ? (int)(random() % 41) - 20 : 0;
+		frame.MouseDy = dragging ? (int)(random() % 21) - 10 : 0;
+		return frame;
+	}
+
+	std::vector<std::vector<float>> Replay(const InputRecording& recording)
+	{
+		Simulation simulation;
+		InputReplayer replayer(recording);
+		std::vector<std::vector<float>> states;
+		InputFrame frame;
+		while (replayer.Next(&frame))
+		{
+			simulation.Apply(frame, recording.FixedStep());
+			states.push_back(simulation.State());
+		}
+		return states;
+	}
+
+	bool Rejected(InputRecording& recording, const std::vector<std::uint8_t>& data, const std::string& expected)
+	{
+		const uint32 frames = recording.FrameCount();
+		const float step = recording.FixedStep();
+		const uint32 seed = recording.Seed();
+		std::string error;
+		const bool parsed = recording.Parse(data.data(), data.size(), &error);
+		return !parsed && error.find(expected) != std::string::npos &&
+			recording.FrameCount() == frames && recording.FixedStep() == step && recording.Seed() == seed;
+	}
+
+	template<typename T>
+	std::vector<std::uint8_t> Patched(std::vector<std::uint8_t> data, size_t offset, T value)
+	{
+		std::memcpy(&data[offset], &value, sizeof(value));
+		return data;
+	}
+}
+
+void AddInputReplayTests(TestSuite& suite)
+{
+	// A run recorded at a fixed step and played back from its file goes through the
+	// same states, frame for frame, bit for bit, and builds its sampling state from the
+	// same seed.
+	suite.Add("input/record_replay", [](Test& t)
+	{
+		InputRecording recording(1.0f / 60.0f, 0x9e3779b9u);
+		Simulation live;
+		std::vector<std::vector<float>> liveStates;
+		std::mt19937 random(47);
+		InputFrame input;
+		for (uint32 frame = 0; frame < 600; ++frame)
+		{
+			input = LiveInput(random, input);
+			recording.Add(input);
+			live.Apply(input, recording.FixedStep());
+			liveStates.push_back(live.State());
+		}
+
+		const char* path = "InputReplayTests.input";
+		TEST_CHECK(t, recording.Save(path));
+		InputRecording loaded;
+		std::string error;
+		const bool opened = loaded.Load(path, &error);
+		std::remove(path);
+		if (!TEST_CHECK(t, opened))
+		{
+			t.Fail(error, __FILE__, __LINE__);
+			return;
+		}
+		TEST_CHECK(t, loaded.FixedStep() == recording.FixedStep());
+		TEST_CHECK(t, loaded.Seed() == 0x9e3779b9u);
+		TEST_CHECK(t, loaded.FrameCount() == 600);
+		TEST_CHECK(t, loaded.Serialize() == recording.Serialize());
+
+		TEST_CHECK(t, Replay(loaded) == liveStates);
+		TEST_CHECK(t, Replay(loaded) == Replay(recording));
+
+		// The step is part of the recording: the same input at another one ends elsewhere.
+		InputRecording faster(1.0f / 30.0f);
+		for (uint32 frame = 0; frame < loaded.FrameCount(); ++frame)
+			faster.Add(loaded.Frame(frame));
+		TEST_CHECK(t, Replay(faster).back() != liveStates.back());
+
+		InputReplayer replayer(loaded);
+		InputFrame frame;
+		uint32 played = 0;
+		while (replayer.Next(&frame))
+			++played;
+		TEST_CHECK(t, played == 600 && replayer.FramesPlayed() == 600 && replayer.Finished());
+		TEST_CHECK(t, !replayer.Next(&frame));
+	});
+
+	// Damaged or foreign files are rejected with a reason and leave the recording as it was.
+	suite.Add("input/parse_errors", [](Test& t)
+	{
+		InputRecording source(1.0f / 30.0f, 1234);
+		for (uint32 i = 0; i < 10; ++i)
+		{
+			InputFrame frame;
+			frame.SetDown(InputKey::W, i % 2 == 1);
+			frame.MouseDx = (int)i;
+			source.Add(frame);
+		}
+		const std::vector<std::uint8_t> data = source.Serialize();
+
+		InputRecording recording(1.0f / 60.0f, 5678);
+		recording.Add(InputFrame());
+		const std::vector<std::uint8_t> truncated(data.begin(), data.end() - 1);
+		std::vector<std::uint8_t> extended(data);
+		extended.push_back(0);
+
+		TEST_CHECK(t, Rejected(recording, std::vector<std::uint8_t>(data.begin(), data.begin() + 27), "too small"));
+		TEST_CHECK(t, Rejected(recording, truncated, "10 frames"));
+		TEST_CHECK(t, Rejected(recording, extended, "10 frames"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 0, std::uint32_t(0)), "not an input recording"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 4, InputRecording::Version + 1), "version"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 12, std::uint32_t(16)), "version"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 8, (std::uint32_t)InputKey::Count + 1), "keys"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 16, std::uint32_t(11)), "11 frames"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 20, 0.0f), "time step"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 20, -1.0f / 60.0f), "time step"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 20, std::numeric_limits<float>::quiet_NaN()), "time step"));
+		TEST_CHECK(t, Rejected(recording, Patched(data, 20, std::numeric_limits<float>::infinity()), "time step"));
+
+		std::string error;
+		TEST_CHECK(t, recording.Parse(data.data(), data.size(), &error));
+		TEST_CHECK(t, recording.FrameCount() == 10 && recording.FixedStep() == 1.0f / 30.0f);
+		TEST_CHECK(t, recording.Frame(3).IsDown(InputKey::W) && recording.Frame(3).MouseDx == 3);
+		TEST_CHECK(t, recording.Seed() == 1234);
+		TEST_CHECK(t, recording.Parse(Patched(data, 24, std::uint32_t(42)).data(), data.size(), &error) && recording.Seed() == 42);
+
+		const std::vector<std::uint8_t> empty = InputRecording(0.01f).Serialize();
+		TEST_CHECK(t, recording.Parse(empty.data(), empty.size(), &error));
+		TEST_CHECK(t, recording.FrameCount() == 0 && recording.FixedStep() == 0.01f && recording.Seed() == 0);
+
+		TEST_CHECK(t, !recording.Load("does_not_exist.input", &error));
+		TEST_CHECK(t, error.find("does_not_exist.input") != std::string::npos);
+	});
+
+	// The summary leaves the warm-up frames out, and the CSV has a line per frame.
+	suite.Add("input/timing_log", [](Test& t)
+	{
+		FrameTimingLog log;
+		for (uint32 i = 1; i <= 20; ++i)
+		{
+			FrameTimingLog::Timing timing;
+			timing.FrameMs = i;
+			timing.UpdateMs = 0.5 * i;
+			log.Add(timing);
+		}
+
+		const FrameTimingLog::Summary all = log.Summarize();
+		TEST_CHECK(t, all.Frames == 20);
+		TEST_CHECK_NEAR(t, all.MeanFrameMs, 10.5, 1e-12);
+		TEST_CHECK_NEAR(t, all.MedianFrameMs, 10.5, 1e-12);
+		TEST_CHECK_NEAR(t, all.P95FrameMs, 19.0, 1e-12);
+		TEST_CHECK_NEAR(t, all.MaxFrameMs, 20.0, 1e-12);
+
+		const FrameTimingLog::Summary last = log.Summarize(11);
+		TEST_CHECK(t, last.Frames == 9);
+		TEST_CHECK_NEAR(t, last.MeanFrameMs, 16.0, 1e-12);
+		TEST_CHECK_NEAR(t, last.MedianFrameMs, 16.0, 1e-12);
+		TEST_CHECK(t, log.Summarize(20).Frames == 0);
+
+		const std::string csv = log.Csv();
+		size_t lines = 0;
+		for (char c : csv)
+			lines += c == '\n';
+		TEST_CHECK(t, lines == 21);
+		TEST_CHECK(t, csv.compare(0, 41, "frame,frame_ms,update_ms,wait_ms,draw_ms\n") == 0);
+		TEST_CHECK(t, csv.find("\n3,4.0000,2.0000,0.0000,0.0000\n") != std::string::npos);
+	});
+}
@@ -0,0 +1,244 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../Common/JobSystem.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// Runs 'function' and returns the message of the std::runtime_error it throws, or
+	// an empty string if it throws nothing.
+	template<typename Function>
+	std::string RuntimeErrorOf(Function function)
+	{
+		try
+		{
+			function();
+		}
+		catch (const std::runtime_error& e)
+		{
+			return e.what();
+		}
+		return std::string();
+	}
+}
+
+void AddJobSystemTests(TestSuite& suite)
+{
+	// A parent finishes only after its children, including ones it creates while it runs
+	// and grandchildren created by those.
+	suite.Add("jobs/children", [](Test& t)
+	{
+		for (uint32 workers : { 1u, 4u })
+		{
+			JobSystem jobs(workers);
+			std::atomic<uint32> children{ 0 };
+			std::atomic<uint32> grandchildren{ 0 };
+			std::atomic<bool> parentRan{ false };
+
+			JobSystem::JobHandle parent;
+			parent = jobs.Create([&]()
+			{
+				for (uint32 i = 0; i < 16; ++i)
+				{
+					jobs.Run(jobs.CreateChild(parent, [&]()
+					{
+						children.fetch_add(1);
+						for (uint32 j = 0; j < 4; ++j)
+							jobs.Run(jobs.CreateChild(parent, [&]() { grandchildren.fetch_add(1); }));
+					}));
+				}
+				parentRan = true;
+			});
+			for (uint32 i = 0; i < 8; ++i)
+				jobs.Run(jobs.CreateChild(parent, [&]() { children.fetch_add(1); }));
+			TEST_CHECK(t, !jobs.IsFinished(parent));
+
+			jobs.Run(parent);
+			jobs.Wait(parent);
+			TEST_CHECK(t, jobs.IsFinished(parent));
+			TEST_CHECK(t, parentRan.load());
+			TEST_CHECK(t, children.load() == 24);
+			TEST_CHECK(t, grandchildren.load() == 64);
+			parent = JobSystem::JobHandle();
+		}
+	});
+
+	// A continuation runs once its job and the job's children have finished, and right
+	// away if added after that.
+	suite.Add("jobs/continuations", [](Test& t)
+	{
+		JobSystem jobs(3);
+		std::atomic<uint32> children{ 0 };
+		std::atomic<uint32> seenByContinuation{ 0 };
+
+		JobSystem::JobHandle job = jobs.Create([]() {});
+		for (uint32 i = 0; i < 32; ++i)
+			jobs.Run(jobs.CreateChild(job, [&]() { children.fetch_add(1); }));
+		JobSystem::JobHandle first = jobs.Create([&]() { seenByContinuation = children.load(); });
+		JobSystem::JobHandle second = jobs.Create([&]() { seenByContinuation.fetch_add(1000); });
+		jobs.AddContinuation(job, first);
+		jobs.AddContinuation(first, second);
+		TEST_CHECK(t, !jobs.IsFinished(first));
+
+		jobs.Run(job);
+		jobs.Wait(second);
+		TEST_CHECK(t, jobs.IsFinished(job) && jobs.IsFinished(first));
+		TEST_CHECK(t, seenByContinuation.load() == 1032);
+
+		std::atomic<bool> late{ false };
+		JobSystem::JobHandle lateJob = jobs.Create([&]() { late = true; });
+		jobs.AddContinuation(job, lateJob);
+		jobs.Wait(lateJob);
+		TEST_CHECK(t, late.load());
+	});
+
+	// What a job, a child or a ParallelFor body throws reaches whoever waits, and the
+	// other work still runs to the end first.
+	suite.Add("jobs/exceptions", [](Test& t)
+	{
+		JobSystem jobs(2);
+
+		TEST_CHECK(t, RuntimeErrorOf([&]() { jobs.Wait(jobs.Spawn([]() { throw std::runtime_error("job"); })); }) == "job");
+
+		std::atomic<uint32> siblings{ 0 };
+		JobSystem::JobHandle parent = jobs.Create([]() {});
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			jobs.Run(jobs.CreateChild(parent, [&siblings, i]()
+			{
+				if (i == 5)
+					throw std::runtime_error("child");
+				siblings.fetch_add(1);
+			}));
+		}
+		jobs.Run(parent);
+		TEST_CHECK(t, RuntimeErrorOf([&]() { jobs.Wait(parent); }) == "child");
+		TEST_CHECK(t, jobs.IsFinished(parent));
+		TEST_CHECK(t, siblings.load() == 15);
+
+		// The continuation of a failed job still runs.
+		std::atomic<bool> continued{ false };
+		JobSystem::JobHandle failing = jobs.Create([]() { throw std::runtime_error("continued"); });
+		JobSystem::JobHandle continuation = jobs.Create([&]() { continued = true; });
+		jobs.AddContinuation(failing, continuation);
+		jobs.Run(failing);
+		TEST_CHECK(t, RuntimeErrorOf([&]() { jobs.Wait(failing); }) == "continued");
+		jobs.Wait(continuation);
+		TEST_CHECK(t, continued.load());
+
+		for (uint32 grain : { 1u, 7u, 100000u })
+		{
+			std::atomic<uint32> done{ 0 };
+			const std::string error = RuntimeErrorOf([&]()
+			{
+				jobs.ParallelFor(1000, grain, [&](uint32 first, uint32 last)
+				{
+					if (first <= 500 && 500 < last)
+						throw std::runtime_error("body");
+					done.fetch_add(last - first);
+				});
+			});
+			TEST_CHECK(t, error == "body");
+			TEST_CHECK(t, done.load() <= 999);
+		}
+
+		// The system is still usable afterwards.
+		std::atomic<uint32> after{ 0 };
+		jobs.ParallelFor(100, 3, [&](uint32 first, uint32 last) { after.fetch_add(last - first); });
+		TEST_CHECK(t, after.load() == 100);
+	});
+
+	// Every index is visited exactly once, in ranges of at most the grain, for counts and
+	// grains that do not divide evenly.
+	suite.Add("jobs/parallel_for", [](Test& t)
+	{
+		for (uint32 workers : { 1u, 3u, 8u })
+		{
+			JobSystem jobs(workers);
+			for (uint32 count : { 0u, 1u, 7u, 1000u, 100003u })
+			{
+				for (uint32 grain : { 0u, 1u, 3u, 64u, 1000003u })
+				{
+					if (grain == 1 && count > 1000)
+						continue;
+					std::vector<std::atomic<uint32>> visits(count);
+					for (auto& visit : visits)
+						visit = 0;
+					std::atomic<uint32> tooLarge{ 0 };
+					jobs.ParallelFor(count, grain, [&](uint32 first, uint32 last)
+					{
+						if (first >= last || last > count || last - first > (std::max)(grain, 1u))
+							tooLarge.fetch_add(1);
+						for (uint32 i = first; i < last && i < count; ++i)
+							visits[i].fetch_add(1, std::memory_order_relaxed);
+					});
+
+					uint32 wrong = 0;
+					for (const auto& visit : visits)
+						wrong += visit.load() != 1;
+					if (!TEST_CHECK(t, wrong == 0 && tooLarge.load() == 0))
+					{
+						t.Fail("workers=" + std::to_string(workers) + " count=" + std::to_string(count) +
+							" grain=" + std::to_string(grain), __FILE__, __LINE__);
+					}
+				}
+			}
+		}
+	});
+
+	// Threads that are not workers share slot 0; each can wait, and runs jobs while it
+	// does, alongside the workers and each other.
+	suite.Add("jobs/external_wait", [](Test& t)
+	{
+		JobSystem jobs(2);
+		const uint32 threads = 3;
+		std::vector<std::atomic<uint32>> sums(threads);
+		std::vector<std::string> errors(threads);
+		std::vector<std::thread> external;
+		for (uint32 i = 0; i < threads; ++i)
+		{
+			sums[i] = 0;
+			external.emplace_back([&, i]()
+			{
+				try
+				{
+					for (uint32 round = 0; round < 20; ++round)
+					{
+						JobSystem::JobHandle parent = jobs.Create([]() {});
+						for (uint32 c = 0; c < 50; ++c)
+							jobs.Run(jobs.CreateChild(parent, [&sums, i]() { sums[i].fetch_add(1); }));
+						jobs.Run(parent);
+						jobs.Wait(parent);
+						jobs.ParallelFor(101, 4, [&sums, i](uint32 first, uint32 last) { sums[i].fetch_add(last - first); });
+					}
+				}
+				catch (const std::exception& e)
+				{
+					errors[i] = e.what();
+				}
+			});
+		}
+
+		// The main thread waits on work of its own meanwhile.
+		std::atomic<uint32> mainSum{ 0 };
+		for (uint32 round = 0; round < 20; ++round)
+			jobs.Wait(jobs.Spawn([&]() { mainSum.fetch_add(1); }));
+
+		for (auto& thread : external)
+			thread.join();
+		for (uint32 i = 0; i < threads; ++i)
+		{
+			TEST_CHECK(t, errors[i].empty());
+			TEST_CHECK(t, sums[i].load() == 20 * (50 + 101));
+		}
+		TEST_CHECK(t, mainSum.load() == 20);
+	});
+}
@@ -0,0 +1,220 @@
+#include "Tests.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../../Common/FileUtil.h"
+#include "../../Common/GeometryGenerator.h"
+#include "../../RadianceTransfer_impl/MeshCache.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint8 = std::uint8_t;
+	using MeshData = GeometryGenerator::MeshData;
+
+	// Where the submesh table starts and where BaseVertex sits in an entry; see FileHeader
+	// and FileSubmesh in MeshCache.cpp.
+	const size_t kSubmeshTableOffset = 112;
+	const size_t kSubmeshSize = 72;
+	const size_t kBaseVertexOffset = 40;
+
+	std::vector<uint8> ReadFile(const std::string& path)
+	{
+		MappedFile file(path);
+		if (!file.IsOpen())
+			return std::vector<uint8>();
+		return std::vector<uint8>(file.Data(), file.Data() + file.Size());
+	}
+
+	bool WriteBytes(const std::string& path, const std::vector<uint8>& bytes)
+	{
+		return FileUtil::WriteFileAtomic(path, bytes.data(), bytes.size());
+	}
+
+	void PutUint32(std::vector<uint8>& bytes, size_t offset, uint32 value)
+	{
+		std::memcpy(&bytes[offset], &value, sizeof(value));
+	}
+
+	// Two parts sharing one vertex buffer: a sphere, and a box whose indices start from
+	// zero at its own first vertex.
+	MeshData TwoParts(std::vector<MeshCache::Submesh>& submeshes)
+	{
+		GeometryGenerator generator;
+		MeshData mesh = generator.CreateSphere(1.0f, 12, 8);
+		const MeshData box = generator.CreateBox(1.0f, 2.0f, 3.0f, 1);
+
+		MeshCache::Submesh sphere;
+		sphere.Name = "sphere";
+		sphere.IndexCount = (uint32)mesh.Indices32.size();
+		sphere.VertexCount = (uint32)mesh.Vertices.size();
+
+		MeshCache::Submesh part;
+		part.Name = "a box with a name longer than the thirty-one characters kept";
+		part.StartIndex = (uint32)mesh.Indices32.size();
+		part.BaseVertex = (uint32)mesh.Vertices.size();
+		part.IndexCount = (uint32)box.Indices32.size();
+		part.VertexCount = (uint32)box.Vertices.size();
+
+		for (GeometryGenerator::Vertex v : box.Vertices)
+		{
+			v.Position.x += 10.0f;
+			mesh.Vertices.push_back(v);
+		}
+		mesh.Indices32.insert(mesh.Indices32.end(), box.Indices32.begin(), box.Indices32.end());
+		submeshes = { sphere, part };
+		return mesh;
+	}
+}
+
+void AddMeshCacheTests(TestSuite& suite)
+{
+	// What is written comes back byte for byte, with the submeshes, their names cut to
+	// what the file holds and the bounds of the vertices each one uses.
+	suite.Add("meshcache/round_trip", [](Test& t)
+	{
+		const std::string path = "MeshCacheTests_round_trip.mesh";
+		std::vector<MeshCache::Submesh> submeshes;
+		const MeshData mesh = TwoParts(submeshes);
+		TEST_CHECK(t, MeshCache::WriteForKey(path, "two parts 1", mesh, submeshes));
+
+		MeshCache cache;
+		TEST_CHECK(t, cache.OpenForKey(path, "two parts 1") == MeshCache::Result::Hit);
+		if (TEST_CHECK(t, cache.VertexCount() == mesh.Vertices.size() && cache.IndexCount() == mesh.Indices32.size()))
+		{
+			TEST_CHECK(t, std::memcmp(cache.Vertices(), mesh.Vertices.data(), mesh.Vertices.size() * sizeof(GeometryGenerator::Vertex)) == 0);
+			TEST_CHECK(t, std::memcmp(cache.Indices(), mesh.Indices32.data(), mesh.Indices32.size() * sizeof(uint32)) == 0);
+			const MeshData copy = cache.ToMeshData();
+			TEST_CHECK(t, copy.Indices32 == mesh.Indices32 && copy.Vertices.size() == mesh.Vertices.size());
+		}
+
+		const std::vector<MeshCache::Submesh>& read = cache.Submeshes();
+		if (TEST_CHECK(t, read.size() == 2))
+		{
+			TEST_CHECK(t, read[0].Name == "sphere");
+			TEST_CHECK(t, read[1].Name == submeshes[1].Name.substr(0, 31));
+			for (uint32 i = 0; i < 2; ++i)
+			{
+				TEST_CHECK(t, read[i].IndexCount == submeshes[i].IndexCount && read[i].StartIndex == submeshes[i].StartIndex);
+				TEST_CHECK(t, read[i].BaseVertex == submeshes[i].BaseVertex && read[i].VertexCount == submeshes[i].VertexCount);
+			}
+			TEST_CHECK_NEAR(t, read[0].Box.Min.x, -1.0, 1e-5);
+			TEST_CHECK_NEAR(t, read[0].Box.Max.y, 1.0, 1e-5);
+			TEST_CHECK_NEAR(t, read[1].Box.Min.x, 9.5, 1e-5);
+			TEST_CHECK_NEAR(t, read[1].Box.Max.x, 10.5, 1e-5);
+			TEST_CHECK_NEAR(t, read[1].Box.Min.z, -1.5, 1e-5);
+		}
+		TEST_CHECK_NEAR(t, cache.MeshBounds().Min.x, -1.0, 1e-5);
+		TEST_CHECK_NEAR(t, cache.MeshBounds().Max.x, 10.5, 1e-5);
+
+		TEST_CHECK(t, cache.OpenForKey(path, "two parts 2") == MeshCache::Result::Stale);
+		TEST_CHECK(t, cache.VertexCount() == 0 && cache.Vertices() == nullptr);
+
+		// Without submeshes the whole mesh is one.
+		TEST_CHECK(t, MeshCache::WriteForKey(path, "whole", mesh, {}));
+		TEST_CHECK(t, cache.OpenForKey(path, "whole") == MeshCache::Result::Hit);
+		TEST_CHECK(t, cache.Submeshes().size() == 1 && cache.Submeshes()[0].IndexCount == mesh.Indices32.size());
+
+		cache.Close();
+		std::remove(path.c_str());
+		TEST_CHECK(t, cache.OpenForKey(path, "whole") == MeshCache::Result::Missing);
+	});
+
+	// A cache of a file is current while the file's stamp is, or its content when only
+	// the stamp changed, and is trusted as is once the file is gone.
+	suite.Add("meshcache/source_file", [](Test& t)
+	{
+		const std::string source = "MeshCacheTests_source.obj";
+		const std::string path = "MeshCacheTests_source.mesh";
+		const std::string content = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+		TEST_CHECK(t, FileUtil::WriteFileAtomic(source, content.data(), content.size()));
+
+		const MeshData mesh = GeometryGenerator().CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+		TEST_CHECK(t, MeshCache::WriteForFile(path, source, mesh, {}));
+
+		MeshCache cache;
+		TEST_CHECK(t, cache.OpenForFile(path, source) == MeshCache::Result::Hit);
+		TEST_CHECK(t, cache.IndexCount() == mesh.Indices32.size());
+
+		// Rewritten with the same bytes: either the stamp still matches or the hash does.
+		TEST_CHECK(t, FileUtil::WriteFileAtomic(source, content.data(), content.size()));
+		const MeshCache::Result same = cache.OpenForFile(path, source);
+		TEST_CHECK(t, same == MeshCache::Result::Hit || same == MeshCache::Result::HitByHash);
+
+		std::string changed = content;
+		changed[2] = '5';
+		TEST_CHECK(t, FileUtil::WriteFileAtomic(source, changed.data(), changed.size()));
+		TEST_CHECK(t, cache.OpenForFile(path, source) == MeshCache::Result::Stale);
+		TEST_CHECK(t, cache.IndexCount() == 0);
+
+		std::remove(source.c_str());
+		TEST_CHECK(t, cache.OpenForFile(path, source) == MeshCache::Result::Hit);
+		cache.Close();
+		std::remove(path.c_str());
+	});
+
+	// Files that do not hold together are rejected rather than handed out, including
+	// indices that point past the vertices, on their own or past a submesh's base.
+	suite.Add("meshcache/invalid", [](Test& t)
+	{
+		const std::string path = "MeshCacheTests_invalid.mesh";
+		std::vector<MeshCache::Submesh> submeshes;
+		const MeshData mesh = TwoParts(submeshes);
+		TEST_CHECK(t, MeshCache::WriteForKey(path, "key", mesh, submeshes));
+		const std::vector<uint8> good = ReadFile(path);
+		if (!TEST_CHECK(t, good.size() > kSubmeshTableOffset + 2 * kSubmeshSize))
+			return;
+
+		const uint32 vertexCount = (uint32)mesh.Vertices.size();
+		const size_t firstIndex = good.size() - mesh.Indices32.size() * sizeof(uint32);
+		const size_t boxIndex = firstIndex + submeshes[1].StartIndex * sizeof(uint32);
+		const size_t boxBaseVertex = kSubmeshTableOffset + kSubmeshSize + kBaseVertexOffset;
+
+		struct Case
+		{
+			const char* Name;
+			std::vector<uint8> Bytes;
+		};
+		std::vector<Case> cases;
+		cases.push_back({ "empty", {} });
+		cases.push_back({ "truncated header", std::vector<uint8>(good.begin(), good.begin() + 50) });
+		cases.push_back({ "truncated indices", std::vector<uint8>(good.begin(), good.end() - 4) });
+		cases.push_back({ "bad magic", good });
+		cases.back().Bytes[0] ^= 0xff;
+		cases.push_back({ "old version", good });
+		PutUint32(cases.back().Bytes, 4, MeshCache::Version - 1);
+		cases.push_back({ "other vertex layout", good });
+		PutUint32(cases.back().Bytes, 8, sizeof(GeometryGenerator::Vertex) + 4);
+		cases.push_back({ "index at vertex count", good });
+		PutUint32(cases.back().Bytes, firstIndex + 12, vertexCount);
+		cases.push_back({ "huge index", good });
+		PutUint32(cases.back().Bytes, good.size() - 4, 0xffffffffu);
+		// The box's first index is within the file but not past the box's base vertex.
+		cases.push_back({ "index past base vertex", good });
+		PutUint32(cases.back().Bytes, boxIndex, vertexCount - submeshes[1].BaseVertex);
+		cases.push_back({ "base vertex past the end", good });
+		PutUint32(cases.back().Bytes, boxBaseVertex, vertexCount);
+
+		for (const Case& c : cases)
+		{
+			TEST_CHECK(t, WriteBytes(path, c.Bytes));
+			MeshCache cache;
+			if (!TEST_CHECK(t, cache.OpenForKey(path, "key") == MeshCache::Result::Invalid))
+				t.Fail(c.Name, __FILE__, __LINE__);
+			TEST_CHECK(t, cache.Vertices() == nullptr && cache.Indices() == nullptr && cache.Submeshes().empty());
+		}
+
+		// The largest index that is still in range is fine.
+		std::vector<uint8> edge = good;
+		PutUint32(edge, firstIndex, vertexCount - 1);
+		PutUint32(edge, boxIndex, vertexCount - 1 - submeshes[1].BaseVertex);
+		TEST_CHECK(t, WriteBytes(path, edge));
+		MeshCache cache;
+		TEST_CHECK(t, cache.OpenForKey(path, "key") == MeshCache::Result::Hit);
+		cache.Close();
+		std::remove(path.c_str());
+	});
+}
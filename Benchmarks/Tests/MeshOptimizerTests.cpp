@@ -0,0 +1,221 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+#include "../../Common/GeometryGenerator.h"
+#include "../../RadianceTransfer_impl/MeshOptimizer.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using MeshData = GeometryGenerator::MeshData;
+	using Triangle = std::array<uint32, 3>;
+
+	// Triangles rotated to start at their smallest index, which keeps the winding, and
+	// sorted: equal for two index buffers that draw the same triangles in any order.
+	std::vector<Triangle> TriangleSet(const uint32* indices, size_t indexCount)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			Triangle t = { { indices[i], indices[i + 1], indices[i + 2] } };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	std::vector<Triangle> TriangleSet(const std::vector<uint32>& indices)
+	{
+		return TriangleSet(indices.data(), indices.size());
+	}
+
+	// A sphere with its triangles in random order, so there is something to gain.
+	MeshData ShuffledSphere(uint32 seed)
+	{
+		MeshData sphere = GeometryGenerator().CreateSphere(1.0f, 32, 24);
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i < sphere.Indices32.size(); i += 3)
+			triangles.push_back({ { sphere.Indices32[i], sphere.Indices32[i + 1], sphere.Indices32[i + 2] } });
+		std::mt19937 random(seed);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+		sphere.Indices32.clear();
+		for (const Triangle& t : triangles)
+			sphere.Indices32.insert(sphere.Indices32.end(), t.begin(), t.end());
+		return sphere;
+	}
+
+	// Triangles by their corner positions, for comparing meshes whose vertices were
+	// renumbered.
+	std::vector<std::array<float, 9>> PositionTriangles(const MeshData& mesh, size_t first, size_t count)
+	{
+		std::vector<std::array<float, 9>> triangles;
+		for (size_t i = first; i + 2 < first + count; i += 3)
+		{
+			std::array<float, 9> t;
+			for (uint32 k = 0; k < 3; ++k)
+			{
+				const DirectX::XMFLOAT3& p = mesh.Vertices[mesh.Indices32[i + k]].Position;
+				t[k * 3 + 0] = p.x;
+				t[k * 3 + 1] = p.y;
+				t[k * 3 + 2] = p.z;
+			}
+			// Start at the smallest corner so the winding is kept.
+			uint32 smallest = 0;
+			for (uint32 k = 1; k < 3; ++k)
+			{
+				if (std::lexicographical_compare(t.begin() + k * 3, t.begin() + k * 3 + 3,
+					t.begin() + smallest * 3, t.begin() + smallest * 3 + 3))
+				{
+					smallest = k;
+				}
+			}
+			std::rotate(t.begin(), t.begin() + smallest * 3, t.end());
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+void AddMeshOptimizerTests(TestSuite& suite)
+{
+	// Each pass only reorders triangles: the same triangles, with the same winding, come
+	// out, and the cache order has fewer misses than a random one.
+	suite.Add("meshopt/same_triangles", [](Test& t)
+	{
+		const MeshData mesh = ShuffledSphere(28);
+		const size_t indexCount = mesh.Indices32.size();
+		const size_t vertexCount = mesh.Vertices.size();
+		const std::vector<Triangle> original = TriangleSet(mesh.Indices32);
+
+		std::vector<uint32> cacheOrder(indexCount);
+		std::vector<uint32> clusters;
+		MeshOptimizer::OptimizeVertexCache(cacheOrder.data(), mesh.Indices32.data(), indexCount, vertexCount,
+			MeshOptimizer::DefaultCacheSize, &clusters);
+		TEST_CHECK(t, TriangleSet(cacheOrder) == original);
+
+		// Clusters start at 0 and at increasing triangle boundaries inside the buffer.
+		TEST_CHECK(t, !clusters.empty() && clusters[0] == 0);
+		for (size_t i = 0; i < clusters.size(); ++i)
+		{
+			TEST_CHECK(t, clusters[i] % 3 == 0 && clusters[i] < indexCount);
+			TEST_CHECK(t, i == 0 || clusters[i] > clusters[i - 1]);
+		}
+
+		const MeshOptimizer::VertexCacheStats shuffled = MeshOptimizer::AnalyzeVertexCache(mesh.Indices32.data(), indexCount, vertexCount);
+		const MeshOptimizer::VertexCacheStats optimized = MeshOptimizer::AnalyzeVertexCache(cacheOrder.data(), indexCount, vertexCount);
+		TEST_CHECK(t, optimized.ACMR < 0.8f * shuffled.ACMR);
+		TEST_CHECK(t, optimized.ATVR >= 1.0f && optimized.Misses >= vertexCount - 2 * 32);
+
+		std::vector<uint32> overdrawOrder(indexCount);
+		MeshOptimizer::OptimizeOverdraw(overdrawOrder.data(), cacheOrder.data(), indexCount,
+			&mesh.Vertices[0].Position.x, sizeof(GeometryGenerator::Vertex), vertexCount, clusters);
+		TEST_CHECK(t, TriangleSet(overdrawOrder) == original);
+	});
+
+	// The fetch remap is a permutation that numbers vertices in first use order, with
+	// the unused ones after, and renaming through it keeps every triangle.
+	suite.Add("meshopt/vertex_fetch", [](Test& t)
+	{
+		MeshData mesh = ShuffledSphere(29);
+		const size_t used = mesh.Vertices.size();
+		// Vertices nothing refers to, which must stay.
+		mesh.Vertices.push_back(mesh.Vertices[0]);
+		mesh.Vertices.push_back(mesh.Vertices[1]);
+		const size_t vertexCount = mesh.Vertices.size();
+
+		const std::vector<uint32> remap = MeshOptimizer::OptimizeVertexFetch(mesh.Indices32.data(), mesh.Indices32.size(), vertexCount);
+		if (!TEST_CHECK(t, remap.size() == vertexCount))
+			return;
+		std::vector<uint32> sorted = remap;
+		std::sort(sorted.begin(), sorted.end());
+		for (uint32 i = 0; i < vertexCount; ++i)
+			TEST_CHECK(t, sorted[i] == i);
+		TEST_CHECK(t, remap[used] >= used && remap[used + 1] >= used);
+
+		std::vector<uint32> indices = mesh.Indices32;
+		MeshOptimizer::RemapIndexBuffer(indices.data(), indices.size(), remap);
+		uint32 next = 0;
+		bool firstUse = true;
+		for (uint32 index : indices)
+		{
+			if (index == next)
+				++next;
+			else if (index > next)
+				firstUse = false;
+		}
+		TEST_CHECK(t, firstUse && next == used);
+
+		std::vector<uint32> renamed;
+		for (uint32 index : mesh.Indices32)
+			renamed.push_back(remap[index]);
+		TEST_CHECK(t, TriangleSet(renamed) == TriangleSet(indices));
+	});
+
+	// The whole pipeline on a mesh in parts: the vertex count is kept, each part draws
+	// the same triangles at the same positions as before, and none cross between parts.
+	suite.Add("meshopt/optimize_mesh", [](Test& t)
+	{
+		MeshData mesh = ShuffledSphere(30);
+		const MeshData box = GeometryGenerator().CreateBox(1.0f, 1.0f, 1.0f, 2);
+		const uint32 sphereIndices = (uint32)mesh.Indices32.size();
+		const uint32 base = (uint32)mesh.Vertices.size();
+		mesh.Vertices.insert(mesh.Vertices.end(), box.Vertices.begin(), box.Vertices.end());
+		for (uint32 index : box.Indices32)
+			mesh.Indices32.push_back(base + index);
+
+		std::vector<MeshOptimizer::IndexRange> ranges(2);
+		ranges[0].IndexCount = sphereIndices;
+		ranges[1].StartIndex = sphereIndices;
+		ranges[1].IndexCount = (uint32)box.Indices32.size();
+
+		const MeshData reference = mesh;
+		MeshOptimizer::VertexCacheStats before, after;
+		const std::vector<uint32> remap = MeshOptimizer::OptimizeMesh(mesh, ranges, &before, &after);
+
+		TEST_CHECK(t, mesh.Vertices.size() == reference.Vertices.size());
+		TEST_CHECK(t, mesh.Indices32.size() == reference.Indices32.size());
+		TEST_CHECK(t, remap.size() == reference.Vertices.size());
+		TEST_CHECK(t, after.ACMR < before.ACMR);
+		for (const MeshOptimizer::IndexRange& range : ranges)
+		{
+			TEST_CHECK(t, PositionTriangles(mesh, range.StartIndex, range.IndexCount) ==
+				PositionTriangles(reference, range.StartIndex, range.IndexCount));
+		}
+
+		// Vertex i moved to remap[i] with everything it carries.
+		bool moved = true;
+		for (size_t i = 0; i < remap.size(); ++i)
+		{
+			const GeometryGenerator::Vertex& a = reference.Vertices[i];
+			const GeometryGenerator::Vertex& b = mesh.Vertices[remap[i]];
+			moved = moved && a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+				a.Normal.x == b.Normal.x && a.TexC.x == b.TexC.x && a.TexC.y == b.TexC.y;
+		}
+		TEST_CHECK(t, moved);
+
+		std::vector<uint32> renamed;
+		for (uint32 index : reference.Indices32)
+			renamed.push_back(remap[index]);
+		TEST_CHECK(t, TriangleSet(renamed.data(), sphereIndices) == TriangleSet(mesh.Indices32.data(), sphereIndices));
+
+		// Degenerate inputs: nothing, and a single triangle.
+		MeshData empty;
+		TEST_CHECK(t, MeshOptimizer::OptimizeMesh(empty, {}).empty());
+		MeshData one = GeometryGenerator().CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+		one.Indices32.resize(3);
+		const std::vector<Triangle> oneBefore = TriangleSet(one.Indices32);
+		const std::vector<uint32> oneRemap = MeshOptimizer::OptimizeMesh(one, {});
+		TEST_CHECK(t, oneRemap.size() == 4 && one.Vertices.size() == 4 && one.Indices32.size() == 3);
+		std::vector<uint32> oneRenamed;
+		for (const Triangle& tri : oneBefore)
+			for (uint32 index : tri)
+				oneRenamed.push_back(oneRemap[index]);
+		TEST_CHECK(t, TriangleSet(oneRenamed) == TriangleSet(one.Indices32));
+	});
+}
@@ -0,0 +1,200 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "../../Common/GeometryGenerator.h"
+#include "../../RadianceTransfer_impl/MeshSimplifier.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using MeshData = GeometryGenerator::MeshData;
+	using Edge = std::pair<uint32, uint32>;
+
+	// Edges used by one triangle only, smaller index first.
+	std::set<Edge> OpenEdges(const std::vector<uint32>& indices)
+	{
+		std::multiset<Edge> edges;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const uint32 a = indices[i + k];
+				const uint32 b = indices[i + (k + 1) % 3];
+				edges.insert(Edge((std::min)(a, b), (std::max)(a, b)));
+			}
+		}
+		std::set<Edge> open;
+		for (const Edge& edge : edges)
+		{
+			if (edges.count(edge) == 1)
+				open.insert(edge);
+		}
+		return open;
+	}
+
+	// Whole triangles of distinct vertices that exist.
+	bool ValidTriangles(const std::vector<uint32>& indices, size_t vertexCount)
+	{
+		if (indices.size() % 3 != 0)
+			return false;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const uint32* t = &indices[i];
+			if (t[0] >= vertexCount || t[1] >= vertexCount || t[2] >= vertexCount ||
+				t[0] == t[1] || t[1] == t[2] || t[0] == t[2])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// A grid with a bump in the middle, so collapses there have a cost.
+	MeshData BumpyGrid(uint32 n)
+	{
+		MeshData grid = GeometryGenerator().CreateGrid(2.0f, 2.0f, n, n);
+		for (GeometryGenerator::Vertex& v : grid.Vertices)
+			v.Position.y = 0.3f * std::exp(-4.0f * (v.Position.x * v.Position.x + v.Position.z * v.Position.z));
+		return grid;
+	}
+
+	// A sphere whose seam vertices are at exactly the same positions; the generator's
+	// sines and cosines leave them a rounding error apart.
+	MeshData Sphere(uint32 slices, uint32 stacks)
+	{
+		MeshData sphere = GeometryGenerator().CreateSphere(1.0f, slices, stacks);
+		for (GeometryGenerator::Vertex& v : sphere.Vertices)
+		{
+			v.Position.x = std::round(v.Position.x * 1e5f) / 1e5f;
+			v.Position.y = std::round(v.Position.y * 1e5f) / 1e5f;
+			v.Position.z = std::round(v.Position.z * 1e5f) / 1e5f;
+		}
+		return sphere;
+	}
+
+	std::vector<uint32> Simplify(const MeshData& mesh, size_t targetIndexCount, float targetError,
+		const MeshSimplifier::Options& options = MeshSimplifier::Options(), float* resultError = nullptr)
+	{
+		return MeshSimplifier::Simplify(mesh.Vertices.data(), mesh.Vertices.size(), mesh.Indices32.data(),
+			mesh.Indices32.size(), targetIndexCount, targetError, options, resultError);
+	}
+}
+
+void AddMeshSimplifierTests(TestSuite& suite)
+{
+	// Without an error limit the result gets down to the target but not far below it,
+	// and an error limit stops it early with the error it reports below the limit.
+	suite.Add("simplify/target_ratio", [](Test& t)
+	{
+		const MeshData sphere = Sphere(64, 48);
+		const size_t indexCount = sphere.Indices32.size();
+		for (double ratio : { 0.5, 0.25, 0.1 })
+		{
+			const size_t target = size_t(indexCount * ratio) / 3 * 3;
+			float error = -1.0f;
+			const std::vector<uint32> indices = Simplify(sphere, target, 1e30f, MeshSimplifier::Options(), &error);
+			TEST_CHECK(t, ValidTriangles(indices, sphere.Vertices.size()));
+			TEST_CHECK(t, indices.size() <= target);
+			TEST_CHECK(t, indices.size() >= target * 9 / 10);
+			TEST_CHECK(t, error > 0.0f);
+		}
+
+		float error = -1.0f;
+		const float limit = 0.002f;
+		const std::vector<uint32> limited = Simplify(sphere, 0, limit, MeshSimplifier::Options(), &error);
+		TEST_CHECK(t, ValidTriangles(limited, sphere.Vertices.size()));
+		TEST_CHECK(t, limited.size() < indexCount && limited.size() > indexCount / 10);
+		TEST_CHECK(t, error > 0.0f && error <= limit);
+
+		// Welded, a flat grid has no error to spend, so it goes all the way down to its
+		// locked border.
+		MeshSimplifier::Options weld;
+		weld.WeldPositions = true;
+		const MeshData flat = GeometryGenerator().CreateGrid(2.0f, 2.0f, 9, 9);
+		const std::vector<uint32> flatIndices = Simplify(flat, 0, 1e-6f, weld, &error);
+		TEST_CHECK(t, ValidTriangles(flatIndices, flat.Vertices.size()));
+		TEST_CHECK(t, flatIndices.size() <= flat.Indices32.size() / 4);
+		TEST_CHECK(t, error <= 1e-6f);
+	});
+
+	// Open borders are kept edge for edge.  So are uv seams, which are borders as far as
+	// the indices go, unless positions are welded.
+	suite.Add("simplify/boundaries", [](Test& t)
+	{
+		const MeshData grid = BumpyGrid(17);
+		const std::set<Edge> gridBorder = OpenEdges(grid.Indices32);
+		TEST_CHECK(t, gridBorder.size() == 4 * 16);
+		const std::vector<uint32> gridIndices = Simplify(grid, grid.Indices32.size() / 8, 1e30f);
+		TEST_CHECK(t, ValidTriangles(gridIndices, grid.Vertices.size()));
+		TEST_CHECK(t, gridIndices.size() < grid.Indices32.size() / 4);
+		TEST_CHECK(t, OpenEdges(gridIndices) == gridBorder);
+
+		// The sphere's seam runs along duplicated vertices from pole to pole.
+		const MeshData sphere = Sphere(24, 16);
+		const std::set<Edge> seam = OpenEdges(sphere.Indices32);
+		TEST_CHECK(t, !seam.empty());
+		const std::vector<uint32> sphereIndices = Simplify(sphere, sphere.Indices32.size() / 4, 1e30f);
+		TEST_CHECK(t, ValidTriangles(sphereIndices, sphere.Vertices.size()));
+		TEST_CHECK(t, sphereIndices.size() < sphere.Indices32.size() / 2);
+		TEST_CHECK(t, OpenEdges(sphereIndices) == seam);
+
+		// Welded, the seam is no border and the sphere closes up.
+		MeshSimplifier::Options weld;
+		weld.WeldPositions = true;
+		const std::vector<uint32> welded = Simplify(sphere, sphere.Indices32.size() / 4, 1e30f, weld);
+		TEST_CHECK(t, ValidTriangles(welded, sphere.Vertices.size()));
+		TEST_CHECK(t, welded.size() <= sphere.Indices32.size() / 4);
+		TEST_CHECK(t, OpenEdges(welded).empty());
+	});
+
+	// Nothing to simplify, nothing to go by and triangles that are not triangles: no
+	// crash, no index that was not there, and only whole triangles out.
+	suite.Add("simplify/degenerate", [](Test& t)
+	{
+		const MeshData grid = BumpyGrid(5);
+		const GeometryGenerator::Vertex* vertices = grid.Vertices.data();
+		const size_t vertexCount = grid.Vertices.size();
+
+		TEST_CHECK(t, MeshSimplifier::Simplify(vertices, vertexCount, nullptr, 0, 0, 1e30f).empty());
+		TEST_CHECK(t, MeshSimplifier::Simplify(nullptr, 0, nullptr, 0, 0, 1e30f).empty());
+		TEST_CHECK(t, Simplify(grid, grid.Indices32.size(), 1e30f) == grid.Indices32);
+
+		// A lone triangle is all border.
+		const std::vector<uint32> one = { 0, 1, 5 };
+		TEST_CHECK(t, MeshSimplifier::Simplify(vertices, vertexCount, one.data(), one.size(), 0, 1e30f) == one);
+
+		// Triangles with a repeated index are dropped, as is a trailing partial one.
+		std::vector<uint32> messy = grid.Indices32;
+		messy.insert(messy.end(), { 6, 6, 7,   8, 12, 8 });
+		messy.push_back(3);
+		const std::vector<uint32> cleaned = MeshSimplifier::Simplify(vertices, vertexCount, messy.data(), messy.size(),
+			grid.Indices32.size() / 2, 1e30f);
+		TEST_CHECK(t, ValidTriangles(cleaned, vertexCount));
+		TEST_CHECK(t, cleaned.size() <= grid.Indices32.size() / 2);
+		const std::vector<uint32> kept = MeshSimplifier::Simplify(vertices, vertexCount, messy.data(), messy.size(),
+			messy.size(), 1e30f);
+		TEST_CHECK(t, kept == grid.Indices32);
+
+		// All vertices at one point: nothing has an area, nothing has a size.
+		MeshData point = grid;
+		for (GeometryGenerator::Vertex& v : point.Vertices)
+			v.Position = DirectX::XMFLOAT3(1.0f, 2.0f, 3.0f);
+		float error = -1.0f;
+		const std::vector<uint32> collapsed = Simplify(point, 0, 1e30f, MeshSimplifier::Options(), &error);
+		TEST_CHECK(t, ValidTriangles(collapsed, vertexCount));
+		TEST_CHECK(t, error >= 0.0f && std::isfinite(error));
+
+		// A sliver of zero area in the middle of the grid, on top of two of its edges.
+		MeshData sliver = GeometryGenerator().CreateGrid(2.0f, 2.0f, 9, 9);
+		const uint32 middle = 4 * 9 + 4;
+		sliver.Indices32.insert(sliver.Indices32.end(), { middle - 1, middle, middle + 1 });
+		const std::vector<uint32> around = Simplify(sliver, 0, 1e30f);
+		TEST_CHECK(t, ValidTriangles(around, sliver.Vertices.size()));
+		TEST_CHECK(t, around.size() < sliver.Indices32.size() / 3);
+	});
+}
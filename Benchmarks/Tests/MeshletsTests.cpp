@@ -0,0 +1,200 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "../../Common/GeometryGenerator.h"
+#include "../../RadianceTransfer_impl/MeshOptimizer.h"
+#include "../../RadianceTransfer_impl/Meshlets.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using MeshData = GeometryGenerator::MeshData;
+
+	std::vector<Meshlets::Meshlet> Build(const MeshData& mesh, uint32 maxVertices = Meshlets::MaxVertices,
+		uint32 maxTriangles = Meshlets::MaxTriangles)
+	{
+		return Meshlets::BuildMeshlets(mesh.Indices32.data(), mesh.Indices32.size(), &mesh.Vertices[0].Position.x,
+			sizeof(GeometryGenerator::Vertex), mesh.Vertices.size(), maxVertices, maxTriangles);
+	}
+
+	MeshData OptimizedSphere()
+	{
+		MeshData sphere = GeometryGenerator().CreateSphere(1.0f, 48, 32);
+		MeshOptimizer::OptimizeMesh(sphere, {});
+		return sphere;
+	}
+
+	XMFLOAT3 Normal(const MeshData& mesh, const uint32* t)
+	{
+		const XMFLOAT3& p0 = mesh.Vertices[t[0]].Position;
+		const XMFLOAT3& p1 = mesh.Vertices[t[1]].Position;
+		const XMFLOAT3& p2 = mesh.Vertices[t[2]].Position;
+		const float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+		const float e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+		return XMFLOAT3(e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	// Meshlets cover the index buffer in order, keep to the limits, count their vertices
+	// right, and their spheres and cones hold what they describe.
+	void CheckMeshlets(Test& t, const MeshData& mesh, const std::vector<Meshlets::Meshlet>& meshlets,
+		uint32 maxVertices, uint32 maxTriangles, const std::string& context)
+	{
+		uint32 next = 0;
+		bool limits = true, counts = true, spheres = true, cones = true;
+		for (const Meshlets::Meshlet& m : meshlets)
+		{
+			if (!TEST_CHECK(t, m.StartIndex == next && m.IndexCount > 0 && m.IndexCount % 3 == 0))
+				t.Fail(context, __FILE__, __LINE__);
+			next = m.StartIndex + m.IndexCount;
+
+			std::set<uint32> unique(mesh.Indices32.begin() + m.StartIndex, mesh.Indices32.begin() + next);
+			limits = limits && m.VertexCount <= maxVertices && m.IndexCount / 3 <= maxTriangles;
+			counts = counts && m.VertexCount == unique.size();
+
+			for (uint32 v : unique)
+			{
+				const XMFLOAT3 d = Sub(mesh.Vertices[v].Position, m.Center);
+				spheres = spheres && std::sqrt(Dot(d, d)) <= m.Radius * 1.0001f + 1e-6f;
+			}
+
+			// Every normal is within the cone's half angle of its axis.
+			if (m.ConeCutoff < 1.0f)
+			{
+				const float cosAngle = std::sqrt(1.0f - m.ConeCutoff * m.ConeCutoff);
+				for (uint32 i = m.StartIndex; i < next; i += 3)
+				{
+					const XMFLOAT3 n = Normal(mesh, &mesh.Indices32[i]);
+					const float length = std::sqrt(Dot(n, n));
+					cones = cones && (length == 0.0f || Dot(n, m.ConeAxis) / length >= cosAngle - 1e-4f);
+				}
+			}
+		}
+		TEST_CHECK(t, next == mesh.Indices32.size() / 3 * 3);
+		if (!TEST_CHECK(t, limits && counts && spheres && cones))
+			t.Fail(context, __FILE__, __LINE__);
+	}
+}
+
+void AddMeshletsTests(TestSuite& suite)
+{
+	// The default limits and tighter ones, on an optimized sphere and on one in generator
+	// order, where the vertex limit is what cuts most meshlets.
+	suite.Add("meshlets/limits", [](Test& t)
+	{
+		const MeshData optimized = OptimizedSphere();
+		const MeshData unoptimized = GeometryGenerator().CreateSphere(1.0f, 48, 32);
+		const uint32 limits[][2] = { { Meshlets::MaxVertices, Meshlets::MaxTriangles }, { 32, 16 }, { 3, 1 }, { 8, 124 }, { 255, 2 } };
+		for (const MeshData* mesh : { &optimized, &unoptimized })
+		{
+			for (const auto& limit : limits)
+			{
+				const std::vector<Meshlets::Meshlet> meshlets = Build(*mesh, limit[0], limit[1]);
+				CheckMeshlets(t, *mesh, meshlets, limit[0], limit[1],
+					"limits " + std::to_string(limit[0]) + "/" + std::to_string(limit[1]));
+			}
+		}
+
+		// Cache order packs more triangles into each meshlet.
+		const size_t optimizedCount = Build(optimized).size();
+		const size_t unoptimizedCount = Build(unoptimized).size();
+		TEST_CHECK(t, optimizedCount < unoptimizedCount);
+		TEST_CHECK(t, optimizedCount <= optimized.Indices32.size() / 3 / 48);
+
+		// A vertex used twice in one triangle counts once.
+		MeshData repeated = optimized;
+		repeated.Indices32 = { 0, 1, 1, 2, 3, 4, 5, 6, 7 };
+		const std::vector<Meshlets::Meshlet> few = Build(repeated, 5, 10);
+		CheckMeshlets(t, repeated, few, 5, 10, "repeated");
+		TEST_CHECK(t, few.size() == 2 && few[0].VertexCount == 5);
+
+		// Nothing, and less than a triangle, make no meshlets.
+		MeshData empty = optimized;
+		empty.Indices32.clear();
+		TEST_CHECK(t, Build(empty).empty());
+		empty.Indices32 = { 0, 1 };
+		TEST_CHECK(t, Build(empty).empty());
+	});
+
+	// A culled meshlet is one whose triangles all face away from the eye or that lies
+	// entirely outside a plane; the draws cover exactly the meshlets kept.
+	suite.Add("meshlets/culling", [](Test& t)
+	{
+		const MeshData sphere = OptimizedSphere();
+		const std::vector<Meshlets::Meshlet> meshlets = Build(sphere);
+
+		const XMFLOAT3 eye(0.0f, 0.0f, -4.0f);
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixLookAtLH(XMVectorSet(eye.x, eye.y, eye.z, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+			XMMatrixPerspectiveFovLH(0.25f * XM_PI, 1.0f, 0.1f, 100.0f));
+		const Meshlets::Frustum frustum = Meshlets::ExtractFrustum(viewProj);
+
+		std::vector<Meshlets::DrawIndexedArgs> draws;
+		const Meshlets::CullStats stats = Meshlets::CullMeshlets(meshlets, frustum, eye, &draws);
+		TEST_CHECK(t, stats.Meshlets == meshlets.size());
+		TEST_CHECK(t, stats.Triangles == sphere.Indices32.size() / 3);
+		TEST_CHECK(t, stats.BackfaceCulled > 0 && stats.FrustumCulled == 0);
+		TEST_CHECK(t, stats.Draws == draws.size());
+
+		std::vector<bool> drawn(sphere.Indices32.size() / 3, false);
+		uint64_t drawnTriangles = 0;
+		for (const Meshlets::DrawIndexedArgs& draw : draws)
+		{
+			TEST_CHECK(t, draw.InstanceCount == 1 && draw.BaseVertexLocation == 0);
+			for (uint32 i = draw.StartIndexLocation; i < draw.StartIndexLocation + draw.IndexCountPerInstance; i += 3)
+				drawn[i / 3] = true;
+			drawnTriangles += draw.IndexCountPerInstance / 3;
+		}
+		TEST_CHECK(t, drawnTriangles + stats.CulledTriangles == stats.Triangles);
+
+		// The same counts without draws to fill in.
+		const Meshlets::CullStats counted = Meshlets::CullMeshlets(meshlets, frustum, eye, nullptr);
+		TEST_CHECK(t, counted.Draws == stats.Draws && counted.BackfaceCulled == stats.BackfaceCulled);
+		TEST_CHECK(t, counted.CulledTriangles == stats.CulledTriangles);
+
+		// Whatever was culled as back-facing faces away from the eye at every corner, and
+		// a merged draw never spans a culled meshlet.
+		bool backfacing = true;
+		for (const Meshlets::Meshlet& m : meshlets)
+		{
+			if (drawn[m.StartIndex / 3])
+				continue;
+			for (uint32 i = m.StartIndex; i < m.StartIndex + m.IndexCount; i += 3)
+			{
+				TEST_CHECK(t, !drawn[i / 3]);
+				const XMFLOAT3 n = Normal(sphere, &sphere.Indices32[i]);
+				for (uint32 k = 0; k < 3; ++k)
+					backfacing = backfacing && Dot(Sub(sphere.Vertices[sphere.Indices32[i + k]].Position, eye), n) >= 0.0f;
+			}
+		}
+		TEST_CHECK(t, backfacing);
+
+		// From far off to the side, everything is outside the frustum.
+		const XMFLOAT3 away(100.0f, 0.0f, 0.0f);
+		XMFLOAT4X4 awayViewProj;
+		XMStoreFloat4x4(&awayViewProj, XMMatrixTranslation(-away.x, -away.y, -away.z) *
+			XMMatrixPerspectiveFovLH(0.25f * XM_PI, 1.0f, 0.1f, 50.0f));
+		draws.clear();
+		const Meshlets::CullStats outside = Meshlets::CullMeshlets(meshlets, Meshlets::ExtractFrustum(awayViewProj), away, &draws);
+		TEST_CHECK(t, outside.FrustumCulled == meshlets.size() && draws.empty());
+		TEST_CHECK(t, outside.CulledTriangles == outside.Triangles);
+	});
+}
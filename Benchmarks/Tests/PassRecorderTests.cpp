@@ -0,0 +1,197 @@
+#include "Tests.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../Common/JobSystem.h"
+#include "../../Common/Profiler.h"
+#include "../../RadianceTransfer_impl/NullPassRecordingDevice.h"
+#include "../../RadianceTransfer_impl/PassRecorder.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	const char* const kPassNames[] = {
+		"Shadows", "GBuffer", "Rays", "Filter", "Probes", "Lighting", "Sky", "Post" };
+	const uint32 kPassCount = sizeof(kPassNames) / sizeof(kPassNames[0]);
+
+	// Each pass writes its index, its frame and a number of commands that depends on both.
+	void AddPasses(PassRecorder& recorder, NullPassRecordingDevice& device, uint32 frame)
+	{
+		for (uint32 pass = 0; pass < kPassCount; ++pass)
+		{
+			recorder.AddPass(kPassNames[pass], [&device, pass, frame](uint32 list)
+			{
+				const uint32 header[2] = { pass, frame };
+				device.Write(list, header, sizeof(header));
+				for (uint32 i = 0; i < (pass * 7 + frame) % 13; ++i)
+					device.Write(list, &i, sizeof(i));
+			});
+		}
+	}
+
+	template<typename Function>
+	bool ThrowsLogicError(Function function)
+	{
+		try
+		{
+			function();
+		}
+		catch (const std::logic_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+}
+
+void AddPassRecorderTests(TestSuite& suite)
+{
+	// Lists go out in the order the passes were added, recorded in parallel or not.
+	suite.Add("passes/order", [](Test& t)
+	{
+		JobSystem jobs(4);
+		NullPassRecordingDevice parallelDevice;
+		NullPassRecordingDevice serialDevice;
+		PassRecorder parallel(parallelDevice, jobs);
+		PassRecorder serial(serialDevice, jobs);
+
+		for (uint32 frame = 0; frame < 20; ++frame)
+		{
+			AddPasses(parallel, parallelDevice, frame);
+			parallel.Execute(true);
+			AddPasses(serial, serialDevice, frame);
+			serial.Execute(false);
+
+			const std::vector<std::vector<std::uint8_t>>& lists = parallelDevice.SubmittedLists();
+			if (!TEST_CHECK(t, lists.size() == kPassCount))
+				return;
+			bool ordered = true;
+			for (uint32 pass = 0; pass < kPassCount; ++pass)
+			{
+				uint32 header[2] = {};
+				ordered &= lists[pass].size() >= sizeof(header);
+				if (ordered)
+					std::memcpy(header, lists[pass].data(), sizeof(header));
+				ordered &= header[0] == pass && header[1] == frame;
+			}
+			TEST_CHECK(t, ordered);
+			TEST_CHECK(t, lists == serialDevice.SubmittedLists());
+		}
+		TEST_CHECK(t, parallelDevice.Frames() == 20);
+
+		const PassRecorder::Stats& stats = parallel.GetStats();
+		TEST_CHECK(t, stats.Passes == kPassCount);
+		TEST_CHECK(t, stats.PassNames.size() == kPassCount && stats.PassMilliseconds.size() == kPassCount);
+		bool named = true;
+		for (uint32 pass = 0; pass < kPassCount && named; ++pass)
+			named = std::string(stats.PassNames[pass]) == kPassNames[pass];
+		TEST_CHECK(t, named);
+	});
+
+	// With a profiler, each pass is a series of its own, sampled once per frame.
+	suite.Add("passes/profiler", [](Test& t)
+	{
+		JobSystem jobs(4);
+		NullPassRecordingDevice device;
+		PassRecorder recorder(device, jobs);
+		Profiler profiler(30);
+		recorder.SetProfiler(&profiler);
+
+		for (uint32 frame = 0; frame < 5; ++frame)
+		{
+			profiler.BeginFrame();
+			AddPasses(recorder, device, frame);
+			recorder.Execute();
+			profiler.EndFrame();
+		}
+
+		std::vector<std::string> expected(kPassNames, kPassNames + kPassCount);
+		expected.push_back("PassRecorder::Execute");
+		expected.push_back("Submit");
+		uint32 found = 0;
+		bool sampled = true;
+		for (const Profiler::SeriesStats& series : profiler.GetStats())
+		{
+			for (const std::string& name : expected)
+			{
+				if (series.Name == name)
+				{
+					++found;
+					sampled &= series.Samples == 5 && !series.Gpu;
+				}
+			}
+		}
+		TEST_CHECK(t, found == expected.size());
+		TEST_CHECK(t, sampled);
+
+		// Detached, the recorder adds no scopes.
+		recorder.SetProfiler(nullptr);
+		profiler.StartCapture(1);
+		profiler.BeginFrame();
+		AddPasses(recorder, device, 5);
+		recorder.Execute();
+		profiler.EndFrame();
+		TEST_CHECK(t, profiler.CapturedEvents().size() == 1);
+	});
+
+	// A pass that throws fails the frame with its own exception, after every list was
+	// closed, so the next frame records normally.
+	suite.Add("passes/exceptions", [](Test& t)
+	{
+		JobSystem jobs(4);
+		for (bool parallel : { true, false })
+		{
+			NullPassRecordingDevice device;
+			PassRecorder recorder(device, jobs);
+
+			AddPasses(recorder, device, 0);
+			recorder.AddPass("Broken", [](uint32) { throw std::runtime_error("broken pass"); });
+			AddPasses(recorder, device, 0);
+			bool rethrown = false;
+			try
+			{
+				recorder.Execute(parallel);
+			}
+			catch (const std::logic_error&)
+			{
+			}
+			catch (const std::runtime_error& error)
+			{
+				rethrown = std::string(error.what()) == "broken pass";
+			}
+			TEST_CHECK(t, rethrown);
+			TEST_CHECK(t, device.Frames() == 0);
+
+			AddPasses(recorder, device, 1);
+			recorder.Execute(parallel);
+			TEST_CHECK(t, device.Frames() == 1);
+			TEST_CHECK(t, device.SubmittedLists().size() == kPassCount);
+		}
+	});
+
+	// The null device reports what a debug layer would.
+	suite.Add("passes/null_device_misuse", [](Test& t)
+	{
+		NullPassRecordingDevice device;
+		device.BeginFrame(2);
+		const uint32 command = 1;
+		TEST_CHECK(t, ThrowsLogicError([&] { device.Write(0, &command, sizeof(command)); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { device.Begin(2); }));
+		device.Begin(0);
+		TEST_CHECK(t, ThrowsLogicError([&] { device.Begin(0); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { device.Submit(1); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { device.BeginFrame(2); }));
+		device.Write(0, &command, sizeof(command));
+		device.End(0);
+		TEST_CHECK(t, ThrowsLogicError([&] { device.End(0); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { device.Begin(0); }));
+		TEST_CHECK(t, ThrowsLogicError([&] { device.Submit(2); }));
+		device.Submit(1);
+		TEST_CHECK(t, device.Frames() == 1 && device.SubmittedLists().size() == 1);
+		TEST_CHECK(t, device.SubmittedLists()[0].size() == sizeof(command));
+	});
+}
@@ -0,0 +1,314 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../../Common/GeometryGenerator.h"
+#include "../../RadianceTransfer_impl/CpuRayCaster.h"
+#include "../../RadianceTransfer_impl/ProbeVolume.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	XMFLOAT3 RandomDirection(std::mt19937& random)
+	{
+		std::normal_distribution<float> normal;
+		XMFLOAT3 d(normal(random), normal(random), normal(random));
+		const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+		return XMFLOAT3(d.x / length, d.y / length, d.z / length);
+	}
+
+	bool Near(const XMFLOAT3& a, const XMFLOAT3& b, float tolerance)
+	{
+		return std::fabs(a.x - b.x) <= tolerance && std::fabs(a.y - b.y) <= tolerance && std::fabs(a.z - b.z) <= tolerance;
+	}
+
+	// Radiance 'r', 'g', 'b' from every direction, as order 3 SH.
+	std::vector<float> ConstantEnvironment(float r, float g, float b)
+	{
+		std::vector<float> sh(ProbeVolume::SHCount * 3, 0.0f);
+		const float y00 = 0.5f / std::sqrt(XM_PI);
+		sh[0] = r / y00;
+		sh[1] = g / y00;
+		sh[2] = b / y00;
+		return sh;
+	}
+
+	// Updates every probe of 'volume' 30 times under a uniform white sky, around a closed
+	// box from (0, -4, -2) to (4, 0, 2).
+	void TraceClosedBox(ProbeVolume& volume)
+	{
+		GeometryGenerator generator;
+		const GeometryGenerator::MeshData box = generator.CreateBox(4.0f, 4.0f, 4.0f, 2);
+		const XMFLOAT4X4 world(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			2.0f, -2.0f, 0.0f, 1.0f);
+		CpuRayCaster caster;
+		caster.AddMesh(box.Vertices.data(), box.Indices32.data(), box.Indices32.size(), world);
+		caster.Build();
+		const ProbeVolume::Tracer tracer = [&caster](const XMFLOAT3& origin, const XMFLOAT3& direction, float tMax, float* hit)
+		{
+			return caster.Intersect(origin, direction, 0.0f, tMax, hit);
+		};
+
+		const std::vector<float> environment = ConstantEnvironment(1.0f, 1.0f, 1.0f);
+		for (uint32 frame = 0; frame < volume.FramesPerSweep() * 30; ++frame)
+			volume.Update(frame, tracer, environment.data());
+	}
+
+	bool Throws(const ProbeVolume::Desc& desc)
+	{
+		try
+		{
+			ProbeVolume volume(desc);
+		}
+		catch (const std::logic_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+}
+
+void AddProbeVolumeTests(TestSuite& suite)
+{
+	// Directions survive the octahedral map, on the folds and at the poles too, and every
+	// point of the square decodes to a unit direction that encodes back to it.
+	suite.Add("probes/oct_round_trip", [](Test& t)
+	{
+		std::mt19937 random(50);
+		std::vector<XMFLOAT3> directions = {
+			XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f),
+			XMFLOAT3(-1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f),
+			XMFLOAT3(0.6f, -0.8f, 0.0f), XMFLOAT3(0.0f, 0.6f, -0.8f) };
+		for (uint32 i = 0; i < 10000; ++i)
+			directions.push_back(RandomDirection(random));
+
+		bool roundTrip = true;
+		bool inside = true;
+		for (const XMFLOAT3& d : directions)
+		{
+			const XMFLOAT2 p = ProbeVolume::OctEncode(d);
+			inside &= std::fabs(p.x) + std::fabs(p.y) <= 1.0f + 1e-5f || (d.z < 0.0f && std::fabs(p.x) <= 1.0f && std::fabs(p.y) <= 1.0f);
+			roundTrip &= Near(ProbeVolume::OctDecode(p), d, 1e-5f);
+		}
+		TEST_CHECK(t, roundTrip);
+		TEST_CHECK(t, inside);
+
+		bool unit = true;
+		bool back = true;
+		for (uint32 y = 0; y <= 64; ++y)
+		{
+			for (uint32 x = 0; x <= 64; ++x)
+			{
+				const XMFLOAT2 p(x / 32.0f - 1.0f, y / 32.0f - 1.0f);
+				const XMFLOAT3 d = ProbeVolume::OctDecode(p);
+				unit &= std::fabs(d.x * d.x + d.y * d.y + d.z * d.z - 1.0f) < 1e-5f;
+				// The edges of the square fold onto each other; only the inside is one to one.
+				if (std::fabs(p.x) < 1.0f && std::fabs(p.y) < 1.0f)
+				{
+					const XMFLOAT2 q = ProbeVolume::OctEncode(d);
+					back &= std::fabs(q.x - p.x) < 1e-5f && std::fabs(q.y - p.y) < 1e-5f;
+				}
+			}
+		}
+		TEST_CHECK(t, unit);
+		TEST_CHECK(t, back);
+	});
+
+	// Every probe is updated once per sweep, for the first time in the slots the
+	// constants call fresh.
+	suite.Add("probes/schedule", [](Test& t)
+	{
+		ProbeVolume::Desc desc;
+		desc.Counts[0] = 7;
+		desc.Counts[1] = 5;
+		desc.Counts[2] = 3;
+		desc.RaysPerProbe = 64;
+		desc.RayBudget = 64 * 10;
+		ProbeVolume volume(desc);
+		TEST_CHECK(t, volume.ProbeCount() == 105 && volume.ProbesPerFrame() == 10 && volume.FramesPerSweep() == 11);
+
+		std::vector<uint32> updates(volume.ProbeCount(), 0);
+		bool scheduled = true;
+		bool fresh = true;
+		for (uint32 frame = 0; frame < 2 * volume.FramesPerSweep() - 1; ++frame)
+		{
+			const ProbeVolume::Constants constants = volume.MakeConstants(frame);
+			for (uint32 slot = 0; slot < volume.ProbesPerFrame(); ++slot)
+			{
+				const uint32 probe = volume.ScheduledProbe(frame, slot);
+				scheduled &= probe == (constants.FirstProbe + slot) % constants.ProbeCount;
+				const bool first = volume.HysteresisFor(frame, slot) == 0.0f;
+				fresh &= first == (slot < constants.FreshProbes) && first == (updates[probe] == 0);
+				++updates[probe];
+			}
+		}
+		TEST_CHECK(t, scheduled);
+		TEST_CHECK(t, fresh);
+		bool twice = true;
+		for (uint32 count : updates)
+			twice &= count == 2;
+		TEST_CHECK(t, twice);
+
+		ProbeVolume::Desc small = desc;
+		small.RayBudget = 1;
+		TEST_CHECK(t, ProbeVolume(small).ProbesPerFrame() == 1);
+		small.RayBudget = 1u << 30;
+		TEST_CHECK(t, ProbeVolume(small).ProbesPerFrame() == 105);
+
+		const XMFLOAT3 position = volume.ProbePosition(volume.ProbeIndex(3, 4, 2));
+		TEST_CHECK(t, position.x == 3.0f && position.y == 4.0f && position.z == 2.0f);
+
+		ProbeVolume::Desc invalid = desc;
+		invalid.Counts[1] = 0;
+		TEST_CHECK(t, Throws(invalid));
+		invalid = desc;
+		invalid.RaysPerProbe = 0;
+		TEST_CHECK(t, Throws(invalid));
+		invalid = desc;
+		invalid.Spacing.z = 0.0f;
+		TEST_CHECK(t, Throws(invalid));
+	});
+
+	// With nothing in the way, radiance L from every direction gives pi L from every
+	// probe and everywhere between them, whatever the normal, and the rays miss at
+	// MaxDistance.
+	suite.Add("probes/constant_environment", [](Test& t)
+	{
+		ProbeVolume::Desc desc;
+		desc.Counts[0] = desc.Counts[1] = desc.Counts[2] = 4;
+		desc.Origin = XMFLOAT3(-1.5f, -1.5f, -1.5f);
+		desc.RayBudget = 64 * 16;
+		ProbeVolume volume(desc);
+		const std::vector<float> environment = ConstantEnvironment(1.0f, 0.5f, 0.25f);
+		const XMFLOAT3 expected(XM_PI, 0.5f * XM_PI, 0.25f * XM_PI);
+		const ProbeVolume::Tracer nothing = [](const XMFLOAT3&, const XMFLOAT3&, float, float*) { return false; };
+
+		std::mt19937 random(51);
+		std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+		for (uint32 sweep = 0; sweep < 3; ++sweep)
+		{
+			for (uint32 frame = 0; frame < volume.FramesPerSweep(); ++frame)
+				volume.Update(sweep * volume.FramesPerSweep() + frame, nothing, environment.data());
+
+			bool probes = true;
+			for (uint32 probe = 0; probe < volume.ProbeCount(); ++probe)
+				probes &= Near(volume.ProbeIrradiance(probe, RandomDirection(random)), expected, 0.02f * XM_PI);
+			TEST_CHECK(t, probes);
+
+			bool between = true;
+			for (uint32 i = 0; i < 200; ++i)
+			{
+				const XMFLOAT3 p(position(random), position(random), position(random));
+				between &= Near(volume.Irradiance(p, RandomDirection(random)), expected, 0.02f * XM_PI);
+			}
+			TEST_CHECK(t, between);
+		}
+
+		bool missed = true;
+		for (uint32 i = 0; i < 100; ++i)
+		{
+			const XMFLOAT2 moments = volume.DepthMoments(i % volume.ProbeCount(), RandomDirection(random));
+			missed &= std::fabs(moments.x - desc.MaxDistance) < 1e-3f &&
+				std::fabs(moments.y - desc.MaxDistance * desc.MaxDistance) < 1e-2f;
+		}
+		TEST_CHECK(t, missed);
+	});
+
+	// A closed box under a uniform sky, x from 0 to 4, with probes on both sides of its
+	// wall.  The probes inside see black; the distances they saw keep them out of the
+	// shading of the wall's outside, where trilinear weights alone would average the two.
+	suite.Add("probes/chebyshev", [](Test& t)
+	{
+		// Probes at x = -0.5, outside, and 0.5 and 1.5, inside.
+		ProbeVolume::Desc desc;
+		desc.Counts[0] = desc.Counts[1] = desc.Counts[2] = 3;
+		desc.Origin = XMFLOAT3(-0.5f, -2.5f, -1.0f);
+		desc.RayBudget = 64 * 9;
+		desc.MaxDistance = 5.0f;
+		ProbeVolume volume(desc);
+		TraceClosedBox(volume);
+
+		const XMFLOAT3 right(1.0f, 0.0f, 0.0f);
+		const XMFLOAT3 left(-1.0f, 0.0f, 0.0f);
+		const uint32 outsideProbe = volume.ProbeIndex(0, 1, 1);
+		const uint32 insideProbe = volume.ProbeIndex(1, 1, 1);
+		TEST_CHECK(t, volume.ProbeIrradiance(outsideProbe, left).x > 0.9f * XM_PI);
+		TEST_CHECK(t, volume.ProbeIrradiance(insideProbe, left).x < 0.01f * XM_PI);
+		TEST_CHECK_NEAR(t, volume.DepthMoments(outsideProbe, right).x, 0.5f, 0.1f);
+		TEST_CHECK_NEAR(t, volume.DepthMoments(insideProbe, left).x, 0.5f, 0.1f);
+
+		// Halfway between the layers, just outside the wall and facing out: the probes
+		// inside are behind the wall from there.
+		const XMFLOAT3 outside(-0.01f, -1.8f, 0.3f);
+		float trilinear = 0.0f;
+		for (uint32 y = 0; y < 2; ++y)
+		{
+			for (uint32 z = 1; z < 3; ++z)
+			{
+				const float wy = y == 0 ? 0.3f : 0.7f;
+				const float wz = z == 1 ? 0.7f : 0.3f;
+				trilinear += wy * wz * (0.51f * volume.ProbeIrradiance(volume.ProbeIndex(0, y, z), left).x +
+					0.49f * volume.ProbeIrradiance(volume.ProbeIndex(1, y, z), left).x);
+			}
+		}
+		TEST_CHECK(t, trilinear < 0.6f * XM_PI);
+		// The hidden probes weigh next to nothing.
+		TEST_CHECK_NEAR(t, volume.Irradiance(outside, left).x, XM_PI, 0.02f * XM_PI);
+	});
+
+	// The same box with probes across its corner, above the lid as well as beside the
+	// wall.  At the default depth resolution, inside faces at least NormalBias from the
+	// other walls see at most 6% of the sky: the light that gets through is what the
+	// distance moments blur across the edge.  Outside faces see all of it, and 8 texels
+	// a side let more than twice as much in.
+	suite.Add("probes/closed_box", [](Test& t)
+	{
+		ProbeVolume::Desc desc;
+		desc.Counts[0] = desc.Counts[1] = desc.Counts[2] = 3;
+		desc.Origin = XMFLOAT3(-0.5f, -1.5f, -1.0f);
+		desc.RayBudget = 64 * 9;
+		desc.MaxDistance = 5.0f;
+
+		float leak[2] = {};
+		for (uint32 coarse = 0; coarse < 2; ++coarse)
+		{
+			desc.DepthResolution = coarse ? 8 : ProbeVolume::Desc().DepthResolution;
+			ProbeVolume volume(desc);
+			TraceClosedBox(volume);
+
+			float inside = 0.0f;
+			float outside = 2.0f * XM_PI;
+			for (float a = 0.3f; a <= 1.5f; a += 0.1f)
+			{
+				for (float z = -0.7f; z <= 0.7f; z += 0.1f)
+				{
+					const XMFLOAT3 wall(0.0f, -a, z);
+					const XMFLOAT3 lid(a, 0.0f, z);
+					inside = (std::max)(inside, volume.Irradiance(wall, XMFLOAT3(1.0f, 0.0f, 0.0f)).x);
+					inside = (std::max)(inside, volume.Irradiance(lid, XMFLOAT3(0.0f, -1.0f, 0.0f)).x);
+					outside = (std::min)(outside, volume.Irradiance(wall, XMFLOAT3(-1.0f, 0.0f, 0.0f)).x);
+					outside = (std::min)(outside, volume.Irradiance(lid, XMFLOAT3(0.0f, 1.0f, 0.0f)).x);
+				}
+			}
+			leak[coarse] = inside;
+			if (!coarse)
+			{
+				TEST_CHECK(t, inside < 0.06f * XM_PI);
+				TEST_CHECK(t, outside > 0.98f * XM_PI);
+				// Away from the walls, inside, it is dark too.
+				TEST_CHECK(t, volume.Irradiance(XMFLOAT3(0.3f, -0.3f, 0.3f), XMFLOAT3(0.0f, -1.0f, 0.0f)).x < 0.02f * XM_PI);
+			}
+		}
+		TEST_CHECK(t, leak[1] > 2.0f * leak[0]);
+	});
+}
@@ -0,0 +1,196 @@
+#include "Tests.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../../Common/JobSystem.h"
+#include "../../Common/Profiler.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	const Profiler::SeriesStats* FindSeries(const std::vector<Profiler::SeriesStats>& stats, const char* name)
+	{
+		for (const Profiler::SeriesStats& series : stats)
+		{
+			if (series.Name == name)
+				return &series;
+		}
+		return nullptr;
+	}
+
+	// Brackets balance outside strings and strings close; enough to catch a broken
+	// escape or separator without a JSON parser.
+	bool WellFormed(const std::string& json)
+	{
+		std::vector<char> open;
+		bool inString = false;
+		for (size_t i = 0; i < json.size(); ++i)
+		{
+			const char c = json[i];
+			if (inString)
+			{
+				if (c == '\\')
+					++i;
+				else if (c == '"')
+					inString = false;
+				else if (c == '\n')
+					return false;
+			}
+			else if (c == '"')
+				inString = true;
+			else if (c == '{' || c == '[')
+				open.push_back(c);
+			else if (c == '}' || c == ']')
+			{
+				if (open.empty() || open.back() != (c == '}' ? '{' : '['))
+					return false;
+				open.pop_back();
+			}
+		}
+		return !inString && open.empty();
+	}
+
+	size_t Count(const std::string& text, const std::string& pattern)
+	{
+		size_t count = 0;
+		for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+			++count;
+		return count;
+	}
+
+	// 25 frames of nested scopes on the calling thread, eight job scopes and a GPU
+	// interval, capturing the last two from frame 23 on.
+	void RunFrames(Profiler& profiler, JobSystem& jobs)
+	{
+		for (uint32 frame = 0; frame < 25; ++frame)
+		{
+			if (frame == 23)
+				profiler.StartCapture(2);
+			profiler.BeginFrame();
+			{
+				Profiler::Scope update(profiler, "Update");
+				Profiler::Scope inner(&profiler, "Inner");
+			}
+			jobs.ParallelFor(8, 1, [&profiler](uint32 first, uint32 last)
+			{
+				for (uint32 i = first; i < last; ++i)
+					Profiler::Scope scope(profiler, "pass \"q\"");
+			});
+			const double now = profiler.NowUs();
+			profiler.AddGpuEvent("rays", now - 500.0, 400.0);
+			profiler.EndFrame();
+		}
+	}
+}
+
+void AddProfilerTests(TestSuite& suite)
+{
+	// Every series keeps the last 'window' frames, and its statistics are ordered.
+	suite.Add("profiler/series", [](Test& t)
+	{
+		Profiler profiler(10);
+		JobSystem jobs(3);
+		RunFrames(profiler, jobs);
+
+		const std::vector<Profiler::SeriesStats> stats = profiler.GetStats();
+		TEST_CHECK(t, stats.size() == 5);
+		for (const Profiler::SeriesStats& series : stats)
+		{
+			TEST_CHECK(t, series.Samples == 10);
+			TEST_CHECK(t, series.MeanMs >= 0.0 && series.MeanMs <= series.MaxMs && series.P95Ms <= series.MaxMs);
+		}
+		const Profiler::SeriesStats* rays = FindSeries(stats, "rays");
+		if (TEST_CHECK(t, rays != nullptr))
+		{
+			TEST_CHECK(t, rays->Gpu);
+			TEST_CHECK_NEAR(t, rays->MeanMs, 0.4, 1e-9);
+		}
+		const Profiler::SeriesStats* update = FindSeries(stats, "Update");
+		const Profiler::SeriesStats* frame = FindSeries(stats, "Frame");
+		if (TEST_CHECK(t, update != nullptr && frame != nullptr))
+			TEST_CHECK(t, !update->Gpu && update->MaxMs <= frame->MaxMs);
+	});
+
+	// A capture holds the frames asked for, with the scopes nested as they were opened.
+	suite.Add("profiler/capture", [](Test& t)
+	{
+		Profiler profiler(10);
+		JobSystem jobs(3);
+		RunFrames(profiler, jobs);
+		TEST_CHECK(t, profiler.CaptureReady());
+
+		const std::vector<Profiler::Event>& events = profiler.CapturedEvents();
+		uint32 frames = 0;
+		uint32 passes = 0;
+		uint32 gpu = 0;
+		bool nested = true;
+		for (const Profiler::Event& event : events)
+		{
+			frames += std::strcmp(event.Name, "Frame") == 0;
+			passes += std::strcmp(event.Name, "pass \"q\"") == 0;
+			gpu += event.Thread == Profiler::GpuThread;
+			if (std::strcmp(event.Name, "Inner") != 0)
+				continue;
+
+			// Inside an Update scope inside the frame, on the same thread.
+			bool enclosed = false;
+			for (const Profiler::Event& outer : events)
+			{
+				enclosed |= std::strcmp(outer.Name, "Update") == 0 && outer.Thread == event.Thread &&
+					outer.StartUs <= event.StartUs &&
+					outer.StartUs + outer.DurationUs >= event.StartUs + event.DurationUs;
+			}
+			nested &= enclosed && event.Depth == 2;
+		}
+		TEST_CHECK(t, frames == 2);
+		TEST_CHECK(t, passes == 16);
+		TEST_CHECK(t, gpu == 2);
+		TEST_CHECK(t, nested);
+
+		// Starting another capture drops this one.
+		profiler.StartCapture(1);
+		TEST_CHECK(t, profiler.IsCapturing() && !profiler.CaptureReady());
+	});
+
+	// The trace has an event per captured one and escapes the names.
+	suite.Add("profiler/chrome_trace", [](Test& t)
+	{
+		Profiler profiler(10);
+		JobSystem jobs(3);
+		RunFrames(profiler, jobs);
+
+		const std::string json = profiler.ChromeTrace();
+		TEST_CHECK(t, WellFormed(json));
+		TEST_CHECK(t, Count(json, "\"ph\":\"X\"") == profiler.CapturedEvents().size());
+		TEST_CHECK(t, Count(json, "\"name\":\"pass \\\"q\\\"\"") == 16);
+		TEST_CHECK(t, Count(json, "\"cat\":\"gpu\"") == 2);
+	});
+
+	// Disabled, scopes record nothing; a null profiler is allowed.
+	suite.Add("profiler/disabled", [](Test& t)
+	{
+		Profiler profiler(10);
+		profiler.SetEnabled(false);
+		profiler.StartCapture(1);
+		profiler.BeginFrame();
+		{
+			Profiler::Scope scope(profiler, "X");
+			Profiler::Scope none(nullptr, "Y");
+		}
+		profiler.EndFrame();
+		TEST_CHECK(t, profiler.CapturedEvents().empty());
+		TEST_CHECK(t, FindSeries(profiler.GetStats(), "X") == nullptr);
+
+		profiler.SetEnabled(true);
+		profiler.StartCapture(1);
+		profiler.BeginFrame();
+		{
+			Profiler::Scope scope(profiler, "X");
+		}
+		profiler.EndFrame();
+		TEST_CHECK(t, FindSeries(profiler.GetStats(), "X") != nullptr);
+	});
+}
@@ -0,0 +1,119 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "../../RadianceTransfer_impl/Reprojection.h"
+#include "../../RadianceTransfer_impl/TransformSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	const uint32 kWidth = 1280;
+	const uint32 kHeight = 720;
+
+	// A camera 20 units back looking down +z, as row-major and transposed for the shaders.
+	void ViewProj(XMFLOAT4X4& viewProj, XMFLOAT4X4& viewProjT)
+	{
+		const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -20.0f, 1.0f),
+			XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		const XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * XM_PI, float(kWidth) / kHeight, 1.0f, 1000.0f);
+		XMStoreFloat4x4(&viewProj, view * proj);
+		XMStoreFloat4x4(&viewProjT, XMMatrixTranspose(view * proj));
+	}
+
+	XMFLOAT3 Transform(const XMFLOAT3& p, const XMFLOAT4X4& m)
+	{
+		XMFLOAT3 r;
+		XMStoreFloat3(&r, XMVector3TransformCoord(XMLoadFloat3(&p), XMLoadFloat4x4(&m)));
+		return r;
+	}
+
+	float Distance(const XMFLOAT2& a, const XMFLOAT2& b)
+	{
+		return std::hypot(a.x - b.x, a.y - b.y);
+	}
+}
+
+void AddReprojectionTests(TestSuite& suite)
+{
+	// Thousands of objects, every third moved, reprojected through the per-object
+	// transforms the app writes: each surface point lands where it was on screen last
+	// frame, and the unmoved ones stay put.
+	suite.Add("reprojection/per_object", [](Test& t)
+	{
+		XMFLOAT4X4 viewProj, viewProjT;
+		ViewProj(viewProj, viewProjT);
+
+		std::mt19937 random(41);
+		std::uniform_real_distribution<float> position(-5.0f, 5.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+		TransformSystem transforms;
+		const uint32 count = 10000;
+		for (uint32 i = 0; i < count; ++i)
+			transforms.Add(XMFLOAT3(position(random), position(random), position(random)),
+				XMFLOAT3(scale(random), scale(random), scale(random)));
+		transforms.Update();
+		for (uint32 i = 0; i < count; i += 3)
+			transforms.Translate(i, XMFLOAT3(0.1f * position(random), 0.1f * position(random), 0.1f * position(random)));
+		transforms.Update();
+
+		float worstError = 0.0f;
+		float worstStill = 0.0f;
+		float largestMotion = 0.0f;
+		for (uint32 i = 0; i < count; ++i)
+		{
+			const XMFLOAT3 local(0.5f * position(random), 0.5f * position(random), 0.5f * position(random));
+			const XMFLOAT3 now = Transform(local, transforms.World(i));
+			const XMFLOAT3 before = Transform(local, transforms.PrevWorld(i));
+
+			const XMFLOAT2 expected = Reprojection::ProjectPixel(before, viewProj, kWidth, kHeight);
+			const XMFLOAT2 reprojected = Reprojection::ReprojectPixel(now, transforms.InvWorldTransposed(i),
+				transforms.PrevWorldTransposed(i), viewProjT, kWidth, kHeight);
+			worstError = (std::max)(worstError, Distance(reprojected, expected));
+
+			const float motion = Distance(Reprojection::ProjectPixel(now, viewProj, kWidth, kHeight), expected);
+			if (i % 3 == 0)
+				largestMotion = (std::max)(largestMotion, motion);
+			else
+				worstStill = (std::max)(worstStill, motion);
+		}
+
+		TEST_CHECK(t, worstError < 0.01f);
+		TEST_CHECK(t, worstStill < 1e-3f);
+		TEST_CHECK(t, largestMotion > 1.0f);
+	});
+
+	// The matrices go in transposed, as the shaders get them; the row-major ones give
+	// a different pixel, so a buffer written without transposing is caught.
+	suite.Add("reprojection/transposed_inputs", [](Test& t)
+	{
+		XMFLOAT4X4 viewProj, viewProjT;
+		ViewProj(viewProj, viewProjT);
+
+		TransformSystem transforms;
+		const uint32 id = transforms.Add(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(1.5f, 1.0f, 0.5f));
+		transforms.Update();
+		transforms.Translate(id, XMFLOAT3(0.5f, 0.0f, -0.25f));
+		transforms.Update();
+
+		const XMFLOAT3 p = Transform(XMFLOAT3(0.2f, -0.3f, 0.4f), transforms.World(id));
+		const XMFLOAT2 good = Reprojection::ReprojectPixel(p, transforms.InvWorldTransposed(id),
+			transforms.PrevWorldTransposed(id), viewProjT, kWidth, kHeight);
+		const XMFLOAT2 bad = Reprojection::ReprojectPixel(p, transforms.InvWorld(id),
+			transforms.PrevWorld(id), viewProj, kWidth, kHeight);
+		TEST_CHECK(t, Distance(good, bad) > 10.0f);
+
+		// The center of the screen is the point the camera looks at.
+		const XMFLOAT2 center = Reprojection::ProjectPixel(XMFLOAT3(0.0f, 0.0f, 0.0f), viewProj, kWidth, kHeight);
+		TEST_CHECK_NEAR(t, center.x, kWidth * 0.5, 1e-3);
+		TEST_CHECK_NEAR(t, center.y, kHeight * 0.5, 1e-3);
+		// Up in the world is up on screen, towards row 0.
+		TEST_CHECK(t, Reprojection::ProjectPixel(XMFLOAT3(0.0f, 1.0f, 0.0f), viewProj, kWidth, kHeight).y < center.y);
+	});
+}
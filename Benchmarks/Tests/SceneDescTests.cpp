@@ -0,0 +1,281 @@
+#include "Tests.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../../RadianceTransfer_impl/SceneDesc.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	std::string DefaultScenePath(const Test& t)
+	{
+		return t.DataDirectory() + "/RadianceTransfer_impl/Scenes/default.scene";
+	}
+
+	// The default scene's textures, materials and meshes, without its objects and probes.
+	std::string DefaultDeclarations(const Test& t)
+	{
+		std::ifstream file(DefaultScenePath(t));
+		const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		return text.substr(0, text.find("\nobject "));
+	}
+
+	// Writes 'text' to a scratch file in the working directory and loads it.
+	bool LoadText(const std::string& text, SceneDesc& scene, std::string& error)
+	{
+		const char* path = "SceneDescTests.scene";
+		{
+			std::ofstream file(path);
+			file << text;
+		}
+		const bool loaded = SceneDesc::Load(path, scene, error);
+		std::remove(path);
+		return loaded;
+	}
+
+	const char* const kSkyAndFilter =
+		"object sky  mesh=sphere material=sky scale=5000 role=sky\n"
+		"object quad mesh=quad material=bricks0 role=filter\n";
+
+	// A scene that loads: the default declarations, the sky, the filter and one packed
+	// receiver.
+	std::string ValidScene(const Test& t)
+	{
+		return DefaultDeclarations(t) + "\n" + kSkyAndFilter + "object box mesh=box material=tile0 spaces=world,screen\n";
+	}
+
+	uint32 LineCount(const std::string& text)
+	{
+		uint32 lines = 0;
+		for (char c : text)
+			lines += c == '\n';
+		return lines;
+	}
+
+	struct BadLine
+	{
+		const char* Line;
+		const char* Problem;
+	};
+
+	// Each case is added to a valid scene on its own and must fail to load there, naming
+	// its last line and the problem.
+	void CheckBadLines(Test& t, const std::vector<BadLine>& cases)
+	{
+		const std::string valid = ValidScene(t);
+		for (const BadLine& c : cases)
+		{
+			const std::string where = "(" + std::to_string(LineCount(valid + c.Line) + 1) + "): ";
+			SceneDesc scene;
+			std::string error;
+			const bool loaded = LoadText(valid + c.Line + "\n", scene, error);
+			if (!TEST_CHECK(t, !loaded && error.find(where) != std::string::npos && error.find(c.Problem) != std::string::npos))
+				t.Fail(std::string(c.Line) + " -> " + (loaded ? "loaded" : error), __FILE__, __LINE__);
+		}
+	}
+}
+
+void AddSceneDescTests(TestSuite& suite)
+{
+	suite.Add("scene/default", [](Test& t)
+	{
+		SceneDesc scene;
+		std::string error;
+		if (!TEST_CHECK(t, SceneDesc::Load(DefaultScenePath(t), scene, error)))
+			t.Fail(error, __FILE__, __LINE__);
+		TEST_CHECK(t, scene.Objects.size() == 5);
+		TEST_CHECK(t, scene.ProbeVolumes.size() == 1);
+	});
+
+	// Receivers are not capped by the shaders: the per-object buffers are sized to the
+	// scene, so a row of boxes loads like a single one.
+	suite.Add("scene/many_receivers", [](Test& t)
+	{
+		std::string text = DefaultDeclarations(t) + "\n" + kSkyAndFilter;
+		const uint32 count = 64;
+		for (uint32 i = 0; i < count; ++i)
+			text += "object box" + std::to_string(i) + " mesh=box material=tile0 position=" +
+				std::to_string(i * 2) + ",0,0 spaces=world,screen\n";
+
+		SceneDesc scene;
+		std::string error;
+		if (!TEST_CHECK(t, LoadText(text, scene, error)))
+			t.Fail(error, __FILE__, __LINE__);
+		TEST_CHECK(t, scene.Objects.size() == count + 2);
+	});
+
+	suite.Add("scene/no_receiver", [](Test& t)
+	{
+		SceneDesc scene;
+		std::string error;
+		TEST_CHECK(t, !LoadText(DefaultDeclarations(t) + "\n" + kSkyAndFilter, scene, error));
+		TEST_CHECK(t, error.find("no receiver") != std::string::npos);
+	});
+
+	// Attributes that are missing, malformed or given twice, and declarations that are
+	// not.
+	suite.Add("scene/malformed", [](Test& t)
+	{
+		SceneDesc scene;
+		std::string error;
+		TEST_CHECK(t, LoadText(ValidScene(t), scene, error));
+
+		CheckBadLines(t, {
+			{ "texture", "texture needs a name" },
+			{ "light sun direction=0,-1,0", "unknown declaration 'light'" },
+			{ "texture extra", "texture 'extra' needs file=" },
+			{ "texture extra file", "expected key=value, got 'file'" },
+			{ "texture extra =x.dds", "expected key=value, got '=x.dds'" },
+			{ "texture extra file=a.dds file=b.dds", "attribute 'file' given twice" },
+			{ "texture extra file=a.dds color=red", "unknown attribute 'color'" },
+			{ "texture extra file=a.dds cube=yes", "bad cube=yes" },
+			{ "texture extra file=sky.hdr", "only cube textures take" },
+			{ "texture extra file=sky.hdr cube=1 size=1000", "bad size=1000" },
+			{ "texture extra file=sky.hdr cube=1 size=32768", "bad size=32768" },
+			{ "texture extra file=a.dds size=64", "size= only applies" },
+			{ "material extra albedo=1,1,1", "bad albedo=1,1,1" },
+			{ "material extra albedo=1,1,1,", "bad albedo=1,1,1," },
+			{ "material extra albedo=1,,1,1", "bad albedo=1,,1,1" },
+			{ "material extra fresnel=0.1,0.2", "bad fresnel=0.1,0.2" },
+			{ "material extra roughness=rough", "bad roughness=rough" },
+			{ "material extra roughness=nan", "bad roughness=nan" },
+			{ "material extra roughness=0.5 roughness=0.6", "attribute 'roughness' given twice" },
+			{ "mesh extra", "mesh 'extra' needs exactly one shape" },
+			{ "mesh extra box=1,1,1,1 sphere=1,8,8", "mesh 'extra' needs exactly one shape" },
+			{ "mesh extra box=1,1,1", "bad box=1,1,1" },
+			{ "mesh extra adaptivegrid=10", "bad adaptivegrid=10" },
+			{ "mesh extra adaptivegrid=10,10,32,4,0.05,1", "bad adaptivegrid=10,10,32,4,0.05,1" },
+			{ "mesh extra sphere=1,8,8 lods=2", "bad lods=2" },
+			{ "object extra mesh=box material=tile0 position=1,2", "bad position=1,2" },
+			{ "object extra mesh=box material=tile0 spaces=world,screen position=0,inf,0", "bad position=0,inf,0" },
+			{ "object extra mesh=box material=tile0 spaces=world,screen position=1,2,3,", "bad position=1,2,3," },
+			{ "object extra mesh=box material=tile0 scale=1,2", "bad scale=1,2" },
+			{ "object extra mesh=box material=tile0 texscale=1", "bad texscale=1" },
+			{ "object extra mesh=box material=tile0 role=light", "bad role=light" },
+			{ "object extra mesh=box material=tile0 spaces=world,screen position=1,1,1 position=2,2,2", "attribute 'position' given twice" },
+			{ "object extra mesh=box material=tile0 spaces=world", "receiver 'extra' must list the world and screen spaces" },
+			{ "object extra mesh=box material=tile0 spaces=world,screen,probe", "unknown space 'probe'" },
+			{ "object extra mesh=box material=tile0 spaces=world,screen occluder=maybe", "bad occluder=maybe" },
+			{ "object extra mesh=box material=tile0 spaces=world,screen keys=wasd", "bad keys=wasd" },
+			{ "object extra mesh=sphere material=sky role=sky spaces=world,screen", "only receivers take spaces=" },
+			{ "object extra mesh=sphere material=sky role=sky occluder=1", "only receivers can be occluders" },
+		});
+	});
+
+	// Names are declared once, before anything refers to them, and only to things of the
+	// right kind.
+	suite.Add("scene/references", [](Test& t)
+	{
+		CheckBadLines(t, {
+			{ "texture tileNormalMap file=a.dds", "texture 'tileNormalMap' declared twice" },
+			{ "material tile0", "material 'tile0' declared twice" },
+			{ "mesh box sphere=1,8,8", "mesh 'box' declared twice" },
+			{ "object box mesh=box material=tile0 spaces=world,screen", "object 'box' declared twice" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,2,2\nprobes more origin=0,0,0 spacing=1 counts=2,2,2",
+				"only one probe volume can be declared" },
+			{ "material extra diffuse=brickDiffuseMap", "unknown texture 'brickDiffuseMap'" },
+			{ "material extra normal=skyCubeMap", "'skyCubeMap' is a cube" },
+			{ "object extra material=tile0 spaces=world,screen", "object 'extra' needs a declared mesh=" },
+			{ "object extra mesh=torus material=tile0 spaces=world,screen", "object 'extra' needs a declared mesh=" },
+			{ "object extra mesh=tile0 material=tile0 spaces=world,screen", "object 'extra' needs a declared mesh=" },
+			{ "object extra mesh=box material=box spaces=world,screen", "object 'extra' needs a declared material=" },
+			{ "object extra mesh=box spaces=world,screen", "object 'extra' needs a declared material=" },
+		});
+
+		// A mesh declared after the object that uses it does not count.
+		SceneDesc scene;
+		std::string error;
+		const std::string text = DefaultDeclarations(t) + "\n" + kSkyAndFilter +
+			"object late mesh=later material=tile0 spaces=world,screen\n"
+			"mesh later box=1,1,1,1\n";
+		TEST_CHECK(t, !LoadText(text, scene, error));
+		TEST_CHECK(t, error.find("needs a declared mesh=") != std::string::npos);
+	});
+
+	// Problems with the scene as a whole are found after the last line.
+	suite.Add("scene/validate", [](Test& t)
+	{
+		const std::string valid = ValidScene(t);
+		struct Case
+		{
+			std::string Text;
+			const char* Problem;
+		};
+		const Case cases[] = {
+			// Receivers share one input layout, so their meshes are all packed or none are.
+			{ valid + "mesh plain box=1,1,1,1\nobject other mesh=plain material=tile0 spaces=world,screen\n",
+				"pack= must be the same for every receiver mesh" },
+			{ valid + "mesh packedSphere sphere=1,8,8 pack=1\nobject moon mesh=packedSphere material=sky role=sky\n",
+				"object 'moon' is not a receiver, its mesh cannot be packed" },
+			{ valid + "object other mesh=box material=tile0 spaces=world,screen keys=ijkl\n"
+				"object third mesh=box material=tile0 spaces=world,screen keys=ijkl\n",
+				"keys=ijkl is bound to more than one object" },
+			{ valid + "object sky2 mesh=sphere material=sky role=sky\n", "exactly one sky and one filter object are needed" },
+			{ valid + "texture cube2 file=b.dds cube=1\n", "exactly one cube texture is needed for the sky" },
+		};
+		for (const Case& c : cases)
+		{
+			SceneDesc scene;
+			std::string error;
+			const bool loaded = LoadText(c.Text, scene, error);
+			if (!TEST_CHECK(t, !loaded && error.find(std::string(".scene: ") + c.Problem) != std::string::npos))
+				t.Fail(loaded ? "loaded" : error, __FILE__, __LINE__);
+		}
+
+		// The default scene has six 2D textures; the shaders bind up to ten.
+		std::string textures = valid;
+		for (uint32 i = 0; i < 4; ++i)
+			textures += "texture extra" + std::to_string(i) + " file=a.dds\n";
+		SceneDesc scene;
+		std::string error;
+		TEST_CHECK(t, LoadText(textures, scene, error));
+		TEST_CHECK(t, !LoadText(textures + "texture extra4 file=a.dds\n", scene, error));
+		TEST_CHECK(t, error.find("too many 2D textures") != std::string::npos);
+
+		TEST_CHECK(t, !SceneDesc::Load("SceneDescTests_missing.scene", scene, error));
+		TEST_CHECK(t, error.find("cannot open") != std::string::npos);
+	});
+
+	// Probe counts are whole numbers from 1 up, with at most MaxProbes probes in all.
+	suite.Add("scene/probe_counts", [](Test& t)
+	{
+		const std::string valid = ValidScene(t);
+		const uint32 maxProbes = uint32(SceneDesc::MaxProbes);
+		for (const std::string& counts : { std::string("1,1,1"), std::string("64,32,32"), std::to_string(maxProbes) + ",1,1" })
+		{
+			SceneDesc scene;
+			std::string error;
+			if (!TEST_CHECK(t, LoadText(valid + "probes volume origin=0,0,0 spacing=1 counts=" + counts + "\n", scene, error)))
+				t.Fail(error, __FILE__, __LINE__);
+			else
+				TEST_CHECK(t, scene.ProbeVolumes.size() == 1);
+		}
+
+		CheckBadLines(t, {
+			{ "probes volume spacing=1 counts=2,2,2", "probes 'volume' need origin=x,y,z" },
+			{ "probes volume origin=0,0 spacing=1 counts=2,2,2", "probes 'volume' need origin=x,y,z" },
+			{ "probes volume origin=0,0,0 counts=2,2,2", "need spacing=s or spacing=x,y,z" },
+			{ "probes volume origin=0,0,0 spacing=1,0,1 counts=2,2,2", "bad spacing=1,0,1" },
+			{ "probes volume origin=0,0,0 spacing=-1 counts=2,2,2", "bad spacing=-1" },
+			{ "probes volume origin=0,0,0 spacing=1", "need counts=x,y,z" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,2", "need counts=x,y,z" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,0,2", "need counts=x,y,z" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,-2,2", "need counts=x,y,z" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,2.5,2", "need counts=x,y,z" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=65537,1,1", "need counts=x,y,z" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=4294967296,1,1", "need counts=x,y,z" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=64,32,33", "counts=64,32,33 is more than 65536 probes" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=65536,65536,65536", "is more than 65536 probes" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,2,2 rays=0", "bad rays=0" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,2,2 rays=1025", "bad rays=1025" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,2,2 budget=0", "bad budget=0" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,2,2 hysteresis=1", "bad hysteresis=1" },
+			{ "probes volume origin=0,0,0 spacing=1 counts=2,2,2 distance=0", "bad distance=0" },
+		});
+	});
+}
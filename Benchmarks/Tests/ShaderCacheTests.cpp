@@ -0,0 +1,369 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../../Common/FileUtil.h"
+#include "../../Common/ShaderCache.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	const char* const kDirectory = "ShaderCacheTests";
+
+	// Files and directories under kDirectory, removed with the object, last first.
+	class ScratchFiles
+	{
+	public:
+		ScratchFiles() : mPaths(1, kDirectory) { FileUtil::CreateDirectories(kDirectory); }
+		ScratchFiles(const ScratchFiles& rhs) = delete;
+		ScratchFiles& operator=(const ScratchFiles& rhs) = delete;
+		~ScratchFiles()
+		{
+			for (auto it = mPaths.rbegin(); it != mPaths.rend(); ++it)
+				std::remove(it->c_str());
+		}
+
+		std::string Write(const std::string& name, const std::string& text)
+		{
+			const std::string path = std::string(kDirectory) + "/" + name;
+			const std::string directory = path.substr(0, path.find_last_of('/'));
+			if (std::find(mPaths.begin(), mPaths.end(), directory) == mPaths.end())
+				mPaths.push_back(directory);
+			FileUtil::CreateDirectories(directory);
+			FILE* file = std::fopen(path.c_str(), "wb");
+			if (file != nullptr)
+			{
+				std::fwrite(text.data(), 1, text.size(), file);
+				std::fclose(file);
+			}
+			mPaths.push_back(path);
+			return path;
+		}
+
+		void Track(const std::string& path) { mPaths.push_back(path); }
+
+	private:
+		std::vector<std::string> mPaths;
+	};
+
+	std::vector<std::string> Includes(const std::string& text)
+	{
+		return ShaderIncludeHasher::ParseIncludes(text.data(), text.size());
+	}
+
+	std::vector<std::uint8_t> ReadFile(const std::string& path)
+	{
+		std::vector<std::uint8_t> data;
+		FILE* file = std::fopen(path.c_str(), "rb");
+		if (file == nullptr)
+			return data;
+		std::uint8_t buffer[4096];
+		size_t read = 0;
+		while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + read);
+		std::fclose(file);
+		return data;
+	}
+
+	bool WriteFile(const std::string& path, const std::vector<std::uint8_t>& data)
+	{
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (file == nullptr)
+			return false;
+		const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+		return std::fclose(file) == 0 && written;
+	}
+
+	std::vector<std::uint8_t> Bytecode(uint32 size, uint32 seed)
+	{
+		std::vector<std::uint8_t> bytecode(size);
+		for (uint32 i = 0; i < size; ++i)
+			bytecode[i] = std::uint8_t(i * 31 + seed * 7 + (i >> 8));
+		return bytecode;
+	}
+
+	std::string Key(uint64 sourceHash, const std::string& entryPoint = "PS")
+	{
+		return ShaderCache::MakeKey(sourceHash, entryPoint, "ps_5_1", { { "SAMPLES", "4" } }, "fxc 10.1 /O3");
+	}
+}
+
+void AddShaderCacheTests(TestSuite& suite)
+{
+	// Only #include directives outside comments and strings count, with any spacing after
+	// the '#', quoted or in angle brackets.
+	suite.Add("shadercache/parse_includes", [](Test& t)
+	{
+		const std::string text =
+			"#include \"a.hlsl\"\n"
+			"  #  include <b.hlsl>\n"
+			"\t#include\t\"dir/c.hlsl\" // trailing\n"
+			"// #include \"line_comment.hlsl\"\n"
+			"/* #include \"block_comment.hlsl\"\n"
+			"#include \"still_in_block.hlsl\" */\n"
+			"static const char* s = \"#include \\\"string.hlsl\\\"\";\n"
+			"float x; #include \"not_at_line_start.hlsl\"\n"
+			"/* leading */ #include \"after_comment.hlsl\"\n"
+			"#define INCLUDE \"define.hlsl\"\n"
+			"#includex \"e.hlsl\"\n"
+			"#include \"unterminated.hlsl\n"
+			"#include \"last.hlsl\"";
+		const std::vector<std::string> expected = { "a.hlsl", "b.hlsl", "dir/c.hlsl", "after_comment.hlsl", "last.hlsl" };
+		TEST_CHECK(t, Includes(text) == expected);
+
+		// An unterminated comment hides the rest of the file; a string ends with its line.
+		TEST_CHECK(t, Includes("/* open\n#include \"a.hlsl\"\n").empty());
+		TEST_CHECK(t, Includes("\"open\n#include \"a.hlsl\"\n") == std::vector<std::string>(1, "a.hlsl"));
+		TEST_CHECK(t, Includes("#include").empty());
+		TEST_CHECK(t, Includes("").empty());
+	});
+
+	// Separators become '/', "." goes and ".." folds into the directory before it, or
+	// stays at the front of a relative path.
+	suite.Add("shadercache/normalize_path", [](Test& t)
+	{
+		const std::pair<const char*, const char*> cases[] = {
+			{ "Shaders\\./a/../Common.hlsl", "Shaders/Common.hlsl" },
+			{ "a/b/../../c.hlsl", "c.hlsl" },
+			{ "a//b/./c.hlsl", "a/b/c.hlsl" },
+			{ "../x/./y.hlsl", "../x/y.hlsl" },
+			{ "a/../../b.hlsl", "../b.hlsl" },
+			{ "../../a/../b.hlsl", "../../b.hlsl" },
+			{ "/../a.hlsl", "/a.hlsl" },
+			{ "\\Shaders\\a\\..\\b.hlsl", "/Shaders/b.hlsl" },
+			{ "a/..", "" },
+			{ "./", "" },
+		};
+		for (const auto& c : cases)
+		{
+			const std::string normalized = ShaderIncludeHasher::NormalizePath(c.first);
+			if (!TEST_CHECK(t, normalized == c.second))
+				t.Fail(std::string(c.first) + " -> " + normalized, __FILE__, __LINE__);
+		}
+	});
+
+	// Two paths to the same header, and a cycle, still read each file once, depth first,
+	// in include order.
+	suite.Add("shadercache/closure", [](Test& t)
+	{
+		ScratchFiles files;
+		const std::string top = files.Write("Diamond/Top.hlsl", "#include \"Left.hlsl\"\n#include \"Sub/Right.hlsl\"\n");
+		files.Write("Diamond/Left.hlsl", "#include \"Common.hlsl\"\n");
+		files.Write("Diamond/Sub/Right.hlsl", "#include \"../Common.hlsl\"\n#include \"Missing.hlsl\"\n");
+		files.Write("Diamond/Common.hlsl", "float4 Common;\n");
+
+		ShaderIncludeHasher hasher;
+		std::vector<std::string> closure;
+		std::string error;
+		TEST_CHECK(t, hasher.Closure(top, &closure, &error));
+		const std::string d = std::string(kDirectory) + "/Diamond/";
+		const std::vector<std::string> diamond = {
+			d + "Top.hlsl", d + "Left.hlsl", d + "Common.hlsl", d + "Sub/Right.hlsl", d + "Sub/Missing.hlsl" };
+		TEST_CHECK(t, closure == diamond);
+
+		const std::string a = files.Write("Cycle/A.hlsl", "#include \"B.hlsl\"\n#include \"A.hlsl\"\n");
+		files.Write("Cycle/B.hlsl", "#include \"./A.hlsl\"\n#include \"C.hlsl\"\n");
+		files.Write("Cycle/C.hlsl", "#include \"../Cycle/B.hlsl\"\n");
+		TEST_CHECK(t, hasher.Closure(a, &closure, &error));
+		const std::string c = std::string(kDirectory) + "/Cycle/";
+		TEST_CHECK(t, closure == std::vector<std::string>({ c + "A.hlsl", c + "B.hlsl", c + "C.hlsl" }));
+
+		uint64 hash = 0;
+		TEST_CHECK(t, hasher.HashClosure(a, &hash, &error));
+
+		TEST_CHECK(t, !hasher.Closure(d + "Missing.hlsl", &closure, &error));
+		TEST_CHECK(t, error.find("Missing.hlsl") != std::string::npos);
+	});
+
+	// The hash follows every file in the closure, including one that appears where a
+	// missing include was, once the hasher forgets what it read.
+	suite.Add("shadercache/hash_changes", [](Test& t)
+	{
+		ScratchFiles files;
+		const std::string top = files.Write("Hash/Top.hlsl", "#include \"Mid.hlsl\"\n");
+		files.Write("Hash/Mid.hlsl", "#include \"Leaf.hlsl\"\n#include \"Optional.hlsl\"\n");
+		files.Write("Hash/Leaf.hlsl", "float Leaf = 1.0;\n");
+		const std::string empty = files.Write("Hash/Empty.hlsl", "");
+
+		ShaderIncludeHasher hasher;
+		std::string error;
+		uint64 before = 0;
+		uint64 cached = 0;
+		TEST_CHECK(t, hasher.HashClosure(top, &before, &error));
+
+		// Read once: an edit goes unnoticed until Clear().
+		files.Write("Hash/Leaf.hlsl", "float Leaf = 2.0;\n");
+		TEST_CHECK(t, hasher.HashClosure(top, &cached, &error) && cached == before);
+		hasher.Clear();
+		uint64 edited = 0;
+		TEST_CHECK(t, hasher.HashClosure(top, &edited, &error) && edited != before);
+
+		files.Write("Hash/Optional.hlsl", "");
+		hasher.Clear();
+		uint64 added = 0;
+		TEST_CHECK(t, hasher.HashClosure(top, &added, &error) && added != edited);
+
+		// The same text under another name is another closure.
+		const std::string copy = files.Write("Hash/Copy.hlsl", "#include \"Mid.hlsl\"\n");
+		uint64 renamed = 0;
+		TEST_CHECK(t, hasher.HashClosure(copy, &renamed, &error) && renamed != added);
+
+		uint64 none = 0;
+		TEST_CHECK(t, hasher.HashClosure(empty, &none, &error));
+	});
+
+	// What is stored loads back, through another cache on the same directory too, and a
+	// miss leaves the output alone.
+	suite.Add("shadercache/store_load", [](Test& t)
+	{
+		ScratchFiles files;
+		const std::string directory = std::string(kDirectory) + "/Store";
+		files.Track(directory);
+		ShaderCache cache(directory);
+		const std::string key = Key(1);
+		const std::vector<std::uint8_t> bytecode = Bytecode(5000, 1);
+		std::vector<std::uint8_t> loaded(3, 0xcd);
+
+		TEST_CHECK(t, !cache.Load(key, &loaded));
+		TEST_CHECK(t, loaded.size() == 3);
+		TEST_CHECK(t, cache.Store(key, bytecode.data(), bytecode.size()));
+		files.Track(cache.PathForKey(key));
+
+		TEST_CHECK(t, cache.Load(key, &loaded) && loaded == bytecode);
+		ShaderCache other(directory);
+		loaded.clear();
+		TEST_CHECK(t, other.Load(key, &loaded) && loaded == bytecode);
+
+		// Storing again replaces the file.
+		const std::vector<std::uint8_t> rebuilt = Bytecode(700, 2);
+		TEST_CHECK(t, cache.Store(key, rebuilt.data(), rebuilt.size()));
+		TEST_CHECK(t, other.Load(key, &loaded) && loaded == rebuilt);
+
+		const std::string emptyKey = Key(2);
+		TEST_CHECK(t, cache.Store(emptyKey, nullptr, 0));
+		files.Track(cache.PathForKey(emptyKey));
+		loaded.assign(1, 0);
+		TEST_CHECK(t, cache.Load(emptyKey, &loaded) && loaded.empty());
+
+		const ShaderCache::Stats stats = cache.GetStats();
+		TEST_CHECK(t, stats.Hits == 2 && stats.Misses == 1 && stats.Stores == 3);
+		TEST_CHECK(t, stats.BytesStored == 5700 && stats.BytesLoaded == 5000);
+		TEST_CHECK(t, other.GetStats().Hits == 2 && other.GetStats().Stores == 0);
+	});
+
+	// A damaged file, one for another key or one from another version is a miss, never
+	// wrong bytecode.
+	suite.Add("shadercache/damaged", [](Test& t)
+	{
+		ScratchFiles files;
+		files.Track(std::string(kDirectory) + "/Damaged");
+		ShaderCache cache(std::string(kDirectory) + "/Damaged");
+		const std::string key = Key(3);
+		const std::string path = cache.PathForKey(key);
+		files.Track(path);
+		const std::vector<std::uint8_t> bytecode = Bytecode(1000, 3);
+		TEST_CHECK(t, cache.Store(key, bytecode.data(), bytecode.size()));
+		const std::vector<std::uint8_t> good = ReadFile(path);
+		if (!TEST_CHECK(t, good.size() == 32 + key.size() + bytecode.size()))
+			return;
+
+		std::vector<std::vector<std::uint8_t>> damaged;
+		std::vector<std::uint8_t> file = good;
+		file.back() ^= 1; // bytecode
+		damaged.push_back(file);
+		file = good;
+		file[32 + key.size() / 2] ^= 1; // key
+		damaged.push_back(file);
+		file = good;
+		file[4] += 1; // version
+		damaged.push_back(file);
+		file = good;
+		file[0] ^= 1; // magic
+		damaged.push_back(file);
+		file = good;
+		file[16] += 1; // bytecode size
+		damaged.push_back(file);
+		damaged.push_back(std::vector<std::uint8_t>(good.begin(), good.end() - 1));
+		damaged.push_back(std::vector<std::uint8_t>(good.begin(), good.begin() + 20));
+		damaged.push_back(std::vector<std::uint8_t>());
+		file = good;
+		file.push_back(0);
+		damaged.push_back(file);
+
+		uint32 misses = 0;
+		for (const std::vector<std::uint8_t>& data : damaged)
+		{
+			std::vector<std::uint8_t> loaded(1, 0xcd);
+			TEST_CHECK(t, WriteFile(path, data));
+			TEST_CHECK(t, !cache.Load(key, &loaded));
+			TEST_CHECK(t, loaded.size() == 1);
+			++misses;
+		}
+		TEST_CHECK(t, cache.GetStats().Misses == misses && cache.GetStats().Hits == 0);
+
+		// Keys whose file names collide: the file of one is a miss for the others, whether
+		// their keys are as long or not.
+		TEST_CHECK(t, WriteFile(path, good));
+		std::vector<std::uint8_t> loaded;
+		for (const std::string& other : { Key(4), Key(3, "VS"), Key(3, "MainPS") })
+		{
+			TEST_CHECK(t, other != key);
+			const std::string otherPath = cache.PathForKey(other);
+			files.Track(otherPath);
+			TEST_CHECK(t, WriteFile(otherPath, good));
+			TEST_CHECK(t, !cache.Load(other, &loaded));
+		}
+		TEST_CHECK(t, Key(4).size() == key.size());
+		TEST_CHECK(t, cache.Load(key, &loaded) && loaded == bytecode);
+	});
+
+	// Threads storing the same key while others load it: once a store finished, every
+	// load hits with whole bytecode, as it would for separate processes.
+	suite.Add("shadercache/concurrent", [](Test& t)
+	{
+		ScratchFiles files;
+		files.Track(std::string(kDirectory) + "/Concurrent");
+		ShaderCache cache(std::string(kDirectory) + "/Concurrent");
+		const std::string key = Key(5);
+		files.Track(cache.PathForKey(key));
+		const std::vector<std::uint8_t> bytecode = Bytecode(64 * 1024, 5);
+		TEST_CHECK(t, cache.Store(key, bytecode.data(), bytecode.size()));
+
+		std::atomic<uint32> failedStores(0);
+		std::atomic<uint32> misses(0);
+		std::atomic<uint32> wrong(0);
+		std::vector<std::thread> threads;
+		for (uint32 i = 0; i < 8; ++i)
+		{
+			threads.emplace_back([&, i]
+			{
+				std::vector<std::uint8_t> loaded;
+				for (uint32 n = 0; n < 50; ++n)
+				{
+					if (i % 2 == 0)
+						failedStores += !cache.Store(key, bytecode.data(), bytecode.size());
+					else if (!cache.Load(key, &loaded))
+						++misses;
+					else
+						wrong += loaded != bytecode;
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		TEST_CHECK(t, failedStores == 0);
+		TEST_CHECK(t, misses == 0);
+		TEST_CHECK(t, wrong == 0);
+		TEST_CHECK(t, cache.GetStats().Stores == 201 && cache.GetStats().Hits == 200);
+	});
+}
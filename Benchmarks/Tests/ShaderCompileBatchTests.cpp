@@ -0,0 +1,174 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../Common/JobSystem.h"
+#include "../../Common/ShaderCompileBatch.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	template<typename Function>
+	bool ThrowsLogicError(Function function)
+	{
+		try
+		{
+			function();
+		}
+		catch (const std::logic_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	// A stand-in for the compiler: "bytecode" derived from the name, after a short sleep
+	// so compiles overlap, or an error for names starting with "bad".
+	std::string FakeCompile(const std::string& name, std::atomic<uint32>& calls)
+	{
+		calls.fetch_add(1);
+		std::this_thread::sleep_for(std::chrono::microseconds(200 * (name.size() % 4)));
+		if (name.compare(0, 3, "bad") == 0)
+			throw std::runtime_error("error X3000: syntax error in " + name);
+		return "dxbc:" + name;
+	}
+
+	void AddFakeShaders(ShaderCompileBatch& batch, std::map<std::string, std::string>& blobs,
+		const std::vector<std::string>& names, std::atomic<uint32>& calls)
+	{
+		for (const std::string& name : names)
+			batch.Add<std::string>(name, &blobs, [name, &calls]() { return FakeCompile(name, calls); });
+	}
+}
+
+void AddShaderCompileBatchTests(TestSuite& suite)
+{
+	// Every compile runs even when others fail, and each failure is reported with its
+	// name, in the order added.
+	suite.Add("shaderbatch/failures", [](Test& t)
+	{
+		JobSystem jobs(3);
+		ShaderCompileBatch batch;
+		std::map<std::string, std::string> blobs;
+		std::atomic<uint32> calls{ 0 };
+		AddFakeShaders(batch, blobs, { "sky.vs", "bad_sky.ps", "probe.cs", "bad_trace.cs", "blur.cs" }, calls);
+		batch.Add<std::string>("thrower.ps", &blobs, []() -> std::string { throw 7; });
+
+		TEST_CHECK(t, batch.Count() == 6);
+		TEST_CHECK(t, !batch.Run(jobs));
+		TEST_CHECK(t, calls.load() == 5);
+		TEST_CHECK(t, batch.FailedCount() == 3);
+
+		const std::vector<ShaderCompileBatch::Result>& results = batch.Results();
+		if (!TEST_CHECK(t, results.size() == 6))
+			return;
+		const char* const names[] = { "sky.vs", "bad_sky.ps", "probe.cs", "bad_trace.cs", "blur.cs", "thrower.ps" };
+		for (uint32 i = 0; i < 6; ++i)
+		{
+			TEST_CHECK(t, results[i].Name == names[i]);
+			TEST_CHECK(t, results[i].Ms >= 0.0);
+		}
+		TEST_CHECK(t, !results[0].Failed && results[1].Failed && !results[2].Failed && results[3].Failed);
+		TEST_CHECK(t, results[5].Failed && results[5].Error == "unknown error");
+		TEST_CHECK(t, results[1].Error == "error X3000: syntax error in bad_sky.ps");
+
+		TEST_CHECK(t, batch.ErrorReport() ==
+			"bad_sky.ps: error X3000: syntax error in bad_sky.ps\n"
+			"bad_trace.cs: error X3000: syntax error in bad_trace.cs\n"
+			"thrower.ps: unknown error\n");
+		TEST_CHECK(t, blobs["sky.vs"] == "dxbc:sky.vs" && blobs["blur.cs"] == "dxbc:blur.cs");
+		TEST_CHECK(t, blobs["bad_sky.ps"].empty());
+
+		// One line per compile, slowest first.
+		const std::string timing = batch.TimingReport();
+		TEST_CHECK(t, std::count(timing.begin(), timing.end(), '\n') == 6);
+		TEST_CHECK(t, timing.find("bad_trace.cs (failed)\n") != std::string::npos);
+		TEST_CHECK(t, batch.SerialMs() >= 0.0 && batch.WallMs() > 0.0);
+	});
+
+	// A name may be added only once per batch.
+	suite.Add("shaderbatch/duplicate_names", [](Test& t)
+	{
+		ShaderCompileBatch batch;
+		std::map<std::string, std::string> blobs;
+		std::atomic<uint32> calls{ 0 };
+		AddFakeShaders(batch, blobs, { "a.ps", "b.ps" }, calls);
+		TEST_CHECK(t, ThrowsLogicError([&]() { AddFakeShaders(batch, blobs, { "a.ps" }, calls); }));
+		TEST_CHECK(t, batch.Count() == 2);
+
+		JobSystem jobs(2);
+		TEST_CHECK(t, batch.Run(jobs));
+		TEST_CHECK(t, calls.load() == 2);
+	});
+
+	// Running again compiles everything again and replaces the results, including what
+	// was added in between.
+	suite.Add("shaderbatch/run_again", [](Test& t)
+	{
+		JobSystem jobs(2);
+		ShaderCompileBatch batch;
+		std::map<std::string, std::string> blobs;
+		std::atomic<uint32> calls{ 0 };
+		bool broken = true;
+		batch.Add<std::string>("edited.ps", &blobs, [&broken]() -> std::string
+		{
+			if (broken)
+				throw std::runtime_error("missing semicolon");
+			return "fixed";
+		});
+		AddFakeShaders(batch, blobs, { "same.vs" }, calls);
+
+		TEST_CHECK(t, !batch.Run(jobs));
+		TEST_CHECK(t, batch.FailedCount() == 1 && calls.load() == 1);
+
+		broken = false;
+		AddFakeShaders(batch, blobs, { "new.cs" }, calls);
+		TEST_CHECK(t, batch.Run(jobs));
+		TEST_CHECK(t, batch.FailedCount() == 0 && batch.ErrorReport().empty());
+		TEST_CHECK(t, batch.Results().size() == 3 && batch.Results()[2].Name == "new.cs");
+		TEST_CHECK(t, calls.load() == 3);
+		TEST_CHECK(t, blobs["edited.ps"] == "fixed" && blobs["new.cs"] == "dxbc:new.cs");
+	});
+
+	// Blobs, failures and the reports but for timings are the same for any number of
+	// workers.
+	suite.Add("shaderbatch/any_workers", [](Test& t)
+	{
+		std::vector<std::string> names;
+		for (uint32 i = 0; i < 40; ++i)
+			names.push_back((i % 7 == 3 ? "bad" : "shader") + std::to_string(i) + ".hlsl");
+
+		std::map<std::string, std::string> expectedBlobs;
+		std::string expectedErrors;
+		for (uint32 workers : { 1u, 2u, 5u, 16u })
+		{
+			JobSystem jobs(workers);
+			ShaderCompileBatch batch;
+			std::map<std::string, std::string> blobs;
+			std::atomic<uint32> calls{ 0 };
+			AddFakeShaders(batch, blobs, names, calls);
+			TEST_CHECK(t, !batch.Run(jobs));
+			TEST_CHECK(t, calls.load() == 40 && batch.FailedCount() == 6);
+			for (uint32 i = 0; i < 40; ++i)
+				TEST_CHECK(t, batch.Results()[i].Name == names[i]);
+
+			if (workers == 1)
+			{
+				expectedBlobs = blobs;
+				expectedErrors = batch.ErrorReport();
+				continue;
+			}
+			TEST_CHECK(t, blobs == expectedBlobs);
+			TEST_CHECK(t, batch.ErrorReport() == expectedErrors);
+		}
+		TEST_CHECK(t, expectedBlobs.size() == 40 && expectedBlobs["shader0.hlsl"] == "dxbc:shader0.hlsl");
+	});
+}
@@ -0,0 +1,92 @@
+#include "Test.h"
+
+#include <cmath>
+#include <exception>
+
+Test::Test(const std::string& dataDirectory)
+	: mDataDirectory(dataDirectory)
+{
+}
+
+bool Test::Check(bool condition, const char* expression, const char* file, int line)
+{
+	++mChecks;
+	if (!condition)
+		Fail(std::string("check failed: ") + expression, file, line);
+	return condition;
+}
+
+bool Test::CheckNear(double actual, double expected, double tolerance,
+	const char* expression, const char* file, int line)
+{
+	++mChecks;
+	const bool near = std::fabs(actual - expected) <= tolerance;
+	if (!near)
+	{
+		char values[96];
+		snprintf(values, sizeof(values), " (%.9g vs %.9g, tolerance %.3g)", actual, expected, tolerance);
+		Fail(std::string("check failed: ") + expression + values, file, line);
+	}
+	return near;
+}
+
+void Test::Fail(const std::string& message, const char* file, int line)
+{
+	mFailures.push_back(std::string(file) + ":" + std::to_string(line) + ": " + message);
+}
+
+void TestSuite::Add(const std::string& name, Function function)
+{
+	Entry entry;
+	entry.Name = name;
+	entry.Run = std::move(function);
+	mEntries.push_back(std::move(entry));
+}
+
+std::vector<std::string> TestSuite::Names()const
+{
+	std::vector<std::string> names;
+	for (const Entry& entry : mEntries)
+		names.push_back(entry.Name);
+	return names;
+}
+
+TestSuite::uint32 TestSuite::Run(const std::string& filter, const std::string& dataDirectory, std::FILE* log)const
+{
+	uint32 failed = 0;
+	uint32 run = 0;
+	for (const Entry& entry : mEntries)
+	{
+		if (!filter.empty() && entry.Name.find(filter) == std::string::npos)
+			continue;
+		++run;
+
+		Test test(dataDirectory);
+		std::string error;
+		try
+		{
+			entry.Run(test);
+		}
+		catch (const std::exception& e)
+		{
+			error = e.what();
+		}
+
+		const bool passed = error.empty() && test.Failures().empty();
+		if (!passed)
+			++failed;
+
+		if (log != nullptr)
+		{
+			fprintf(log, "%-48s %s (%u checks)\n", entry.Name.c_str(), passed ? "ok" : "FAILED", test.Checks());
+			for (const std::string& failure : test.Failures())
+				fprintf(log, "    %s\n", failure.c_str());
+			if (!error.empty())
+				fprintf(log, "    threw: %s\n", error.c_str());
+		}
+	}
+
+	if (log != nullptr)
+		fprintf(log, "%u of %u tests passed\n", run - failed, run);
+	return failed;
+}
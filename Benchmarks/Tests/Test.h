@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// One test while it runs.  A failed check is recorded and the test carries on, so one
+// run reports every check that failed; a test that throws stops there and fails.
+class Test
+{
+public:
+	using uint32 = std::uint32_t;
+
+	explicit Test(const std::string& dataDirectory);
+	Test(const Test& rhs) = delete;
+	Test& operator=(const Test& rhs) = delete;
+
+	// The repository root, for the textures and models the tests read.
+	const std::string& DataDirectory()const { return mDataDirectory; }
+
+	// Use TEST_CHECK and TEST_CHECK_NEAR, which fill in the expression and location.
+	bool Check(bool condition, const char* expression, const char* file, int line);
+	bool CheckNear(double actual, double expected, double tolerance,
+		const char* expression, const char* file, int line);
+	void Fail(const std::string& message, const char* file, int line);
+
+	uint32 Checks()const { return mChecks; }
+	const std::vector<std::string>& Failures()const { return mFailures; }
+
+private:
+	std::string mDataDirectory;
+	uint32 mChecks = 0;
+	std::vector<std::string> mFailures;
+};
+
+#define TEST_CHECK(test, condition) \
+	(test).Check(!!(condition), #condition, __FILE__, __LINE__)
+#define TEST_CHECK_NEAR(test, actual, expected, tolerance) \
+	(test).CheckNear((actual), (expected), (tolerance), #actual " ~ " #expected, __FILE__, __LINE__)
+
+// Named tests, run in the order they were added.  Names are "group/name", so a filter
+// can pick a group or a single test; CMake registers each group with CTest.
+class TestSuite
+{
+public:
+	using uint32 = std::uint32_t;
+
+	using Function = std::function<void(Test&)>;
+
+	void Add(const std::string& name, Function function);
+	std::vector<std::string> Names()const;
+
+	// Runs the tests whose names contain 'filter' (all if empty), a line each to 'log'
+	// if not null, and returns how many failed.  A test that throws has failed.
+	uint32 Run(const std::string& filter, const std::string& dataDirectory, std::FILE* log)const;
+
+private:
+	struct Entry
+	{
+		std::string Name;
+		Function Run;
+	};
+
+	std::vector<Entry> mEntries;
+};
@@ -0,0 +1,90 @@
+//***************************************************************************************
+// TestMain.cpp
+//
+// Runs the tests of the renderer's portable code and exits non-zero if any failed.
+//
+//   RadianceTransferTests [--filter=<text>] [--data=<dir>] [--list]
+//***************************************************************************************
+
+#include <cstdio>
+#include <string>
+
+#include "Tests.h"
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "."
+#endif
+
+namespace
+{
+	bool StartsWith(const std::string& s, const char* prefix, std::string* rest)
+	{
+		const std::string p(prefix);
+		if (s.compare(0, p.size(), p) != 0)
+			return false;
+		*rest = s.substr(p.size());
+		return true;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: RadianceTransferTests [--filter=<text>] [--data=<dir>] [--list]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	TestSuite suite;
+	AddVertexPackingTests(suite);
+	AddTextureStreamerTests(suite);
+	AddDDSReaderTests(suite);
+	AddBCDecoderTests(suite);
+	AddEnvironmentMapTests(suite);
+	AddReprojectionTests(suite);
+	AddSceneDescTests(suite);
+	AddUploadAllocatorTests(suite);
+	AddGpuMemoryAllocatorTests(suite);
+	AddProfilerTests(suite);
+	AddPassRecorderTests(suite);
+	AddInputReplayTests(suite);
+	AddShaderCacheTests(suite);
+	AddProbeVolumeTests(suite);
+	AddDescriptorAllocatorTests(suite);
+	AddJobSystemTests(suite);
+	AddShaderCompileBatchTests(suite);
+	AddTransformSystemTests(suite);
+	AddMeshSimplifierTests(suite);
+	AddMeshCacheTests(suite);
+	AddMeshOptimizerTests(suite);
+	AddMeshletsTests(suite);
+	AddAdaptiveGridTests(suite);
+
+	std::string filter;
+	std::string dataDirectory = TEST_DATA_DIR;
+	bool list = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		std::string value;
+		if (StartsWith(arg, "--filter=", &value))
+			filter = value;
+		else if (StartsWith(arg, "--data=", &value))
+			dataDirectory = value;
+		else if (arg == "--list")
+			list = true;
+		else
+		{
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	if (list)
+	{
+		for (const std::string& name : suite.Names())
+			std::printf("%s\n", name.c_str());
+		return 0;
+	}
+
+	return suite.Run(filter, dataDirectory, stdout) == 0 ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Test.h"
+
+// The tests of each area; main() adds them all.
+void AddVertexPackingTests(TestSuite& suite);
+void AddTextureStreamerTests(TestSuite& suite);
+void AddDDSReaderTests(TestSuite& suite);
+void AddBCDecoderTests(TestSuite& suite);
+void AddEnvironmentMapTests(TestSuite& suite);
+void AddReprojectionTests(TestSuite& suite);
+void AddSceneDescTests(TestSuite& suite);
+void AddUploadAllocatorTests(TestSuite& suite);
+void AddGpuMemoryAllocatorTests(TestSuite& suite);
+void AddProfilerTests(TestSuite& suite);
+void AddPassRecorderTests(TestSuite& suite);
+void AddInputReplayTests(TestSuite& suite);
+void AddShaderCacheTests(TestSuite& suite);
+void AddProbeVolumeTests(TestSuite& suite);
+void AddDescriptorAllocatorTests(TestSuite& suite);
+void AddJobSystemTests(TestSuite& suite);
+void AddShaderCompileBatchTests(TestSuite& suite);
+void AddTransformSystemTests(TestSuite& suite);
+void AddMeshSimplifierTests(TestSuite& suite);
+void AddMeshCacheTests(TestSuite& suite);
+void AddMeshOptimizerTests(TestSuite& suite);
+void AddMeshletsTests(TestSuite& suite);
+void AddAdaptiveGridTests(TestSuite& suite);
@@ -0,0 +1,184 @@
+#include "Tests.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../../Common/FileUtil.h"
+#include "../../RadianceTransfer_impl/MockTextureUploadDevice.h"
+#include "../../RadianceTransfer_impl/TextureStreamer.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// 2D, normal maps, a 1x1 and texture arrays, in several BC formats.
+	const char* const kTextures[] = {
+		"bricks2.dds", "bricks2_nmap.dds", "tile.dds", "tile_nmap.dds", "white1x1.dds",
+		"default_nmap.dds", "treearray.dds", "water1.dds", "bricks_nmap.dds" };
+	const uint32 kTextureCount = sizeof(kTextures) / sizeof(kTextures[0]);
+
+	std::string TexturePath(const Test& t, const char* name)
+	{
+		return t.DataDirectory() + "/Textures/" + name;
+	}
+
+	// Every subresource the device ended up with is the file's data for it, in the DDS
+	// order of slices, then mips.
+	bool MatchesFile(Test& t, const MockTextureUploadDevice& device, const TextureStreamer::Status& status,
+		const std::string& path)
+	{
+		MappedFile file(path);
+		if (!TEST_CHECK(t, file.IsOpen()))
+			return false;
+
+		size_t offset = 128;
+		if (file.Size() >= 88 && std::memcmp(file.Data() + 84, "DX10", 4) == 0)
+			offset += 20;
+
+		bool same = true;
+		for (uint32 slice = 0; slice < status.Desc.ArraySize; ++slice)
+		{
+			for (uint32 mip = 0; mip < status.Desc.MipCount; ++mip)
+			{
+				const std::vector<std::uint8_t>& data =
+					device.SubresourceData(status.DeviceTexture, mip + slice * status.Desc.MipCount);
+				same &= offset + data.size() <= file.Size() &&
+					std::memcmp(data.data(), file.Data() + offset, data.size()) == 0;
+				offset += data.size();
+			}
+		}
+		return same && offset == file.Size();
+	}
+
+	// Runs Update() until the streamer is idle; false if it never gets there.
+	bool UpdateUntilIdle(TextureStreamer& streamer, uint32* frames)
+	{
+		*frames = 0;
+		while (!streamer.Idle())
+		{
+			if (++*frames > 100000)
+				return false;
+			streamer.Update();
+		}
+		return true;
+	}
+}
+
+void AddTextureStreamerTests(TestSuite& suite)
+{
+	// Every texture arrives texel for texel, whatever the copy latency and however small
+	// the ring; the mock throws if ring memory is reused before its copy ran or a mip is
+	// exposed before it was copied.
+	suite.Add("streamer/contents", [](Test& t)
+	{
+		for (uint32 latency : { 0u, 1u, 3u })
+		{
+			for (uint64 ringBytes : { 64ull * 1024, 1ull << 20, 16ull << 20 })
+			{
+				MockTextureUploadDevice device(ringBytes, latency);
+				TextureStreamer::Options options;
+				options.BytesPerUpdate = 256 * 1024;
+				TextureStreamer streamer(device, options);
+
+				std::vector<uint32> ids;
+				for (uint32 i = 0; i < kTextureCount; ++i)
+					ids.push_back(streamer.Request(TexturePath(t, kTextures[i]), i == 3 ? 5 : 0));
+				streamer.WaitForTails();
+
+				uint32 frames = 0;
+				if (!TEST_CHECK(t, UpdateUntilIdle(streamer, &frames)))
+					return;
+
+				for (uint32 i = 0; i < kTextureCount; ++i)
+				{
+					const TextureStreamer::Status& status = streamer.GetStatus(ids[i]);
+					if (!TEST_CHECK(t, status.TextureState == TextureStreamer::State::Resident))
+					{
+						t.Fail(std::string(kTextures[i]) + ": " + status.Error, __FILE__, __LINE__);
+						continue;
+					}
+					TEST_CHECK(t, status.ResidentMip == 0);
+					TEST_CHECK(t, device.ResidentMip(status.DeviceTexture) == 0);
+					TEST_CHECK(t, MatchesFile(t, device, status, TexturePath(t, kTextures[i])));
+				}
+
+				// A 64 KB ring cannot hold the larger mips at once.
+				if (ringBytes == 64 * 1024)
+					TEST_CHECK(t, streamer.GetStats().RingStalls > 0);
+			}
+		}
+	});
+
+	// After WaitForTails every texture can be sampled down to its tail, and no further.
+	suite.Add("streamer/tails_first", [](Test& t)
+	{
+		MockTextureUploadDevice device(1 << 20, 2);
+		TextureStreamer::Options options;
+		options.BytesPerUpdate = 64 * 1024;
+		TextureStreamer streamer(device, options);
+
+		std::vector<uint32> ids;
+		for (uint32 i = 0; i < kTextureCount; ++i)
+			ids.push_back(streamer.Request(TexturePath(t, kTextures[i])));
+		streamer.WaitForTails();
+
+		for (uint32 id : ids)
+		{
+			const TextureStreamer::Status& status = streamer.GetStatus(id);
+			if (!TEST_CHECK(t, status.TextureState != TextureStreamer::State::Failed))
+				continue;
+			TEST_CHECK(t, status.ResidentMip <= status.TailMip);
+			TEST_CHECK(t, device.ResidentMip(status.DeviceTexture) == status.ResidentMip);
+			TEST_CHECK(t, status.TailMip == 0 || status.ResidentMip > 0);
+		}
+	});
+
+	// A higher priority texture is fully resident no later than any lower priority one.
+	suite.Add("streamer/priority", [](Test& t)
+	{
+		MockTextureUploadDevice device(1 << 20, 1);
+		TextureStreamer::Options options;
+		options.BytesPerUpdate = 32 * 1024;
+		TextureStreamer streamer(device, options);
+
+		const uint32 low = streamer.Request(TexturePath(t, "bricks2.dds"), 0);
+		const uint32 high = streamer.Request(TexturePath(t, "water1.dds"), 10);
+		streamer.WaitForTails();
+
+		uint32 frame = 0;
+		uint32 lowFrame = 0;
+		uint32 highFrame = 0;
+		while (!streamer.Idle() && frame < 100000)
+		{
+			streamer.Update();
+			++frame;
+			if (highFrame == 0 && streamer.GetStatus(high).TextureState == TextureStreamer::State::Resident)
+				highFrame = frame;
+			if (lowFrame == 0 && streamer.GetStatus(low).TextureState == TextureStreamer::State::Resident)
+				lowFrame = frame;
+		}
+		TEST_CHECK(t, highFrame > 0 && lowFrame > 0);
+		TEST_CHECK(t, highFrame <= lowFrame);
+	});
+
+	// A missing or malformed file fails on its own and does not hold up the rest.
+	suite.Add("streamer/failures", [](Test& t)
+	{
+		MockTextureUploadDevice device(1 << 20, 1);
+		TextureStreamer streamer(device, TextureStreamer::Options());
+
+		const uint32 missing = streamer.Request(TexturePath(t, "does_not_exist.dds"));
+		const uint32 bitmap = streamer.Request(TexturePath(t, "tree0.bmp"));
+		const uint32 good = streamer.Request(TexturePath(t, "tile.dds"));
+		streamer.WaitForTails();
+
+		uint32 frames = 0;
+		TEST_CHECK(t, UpdateUntilIdle(streamer, &frames));
+		TEST_CHECK(t, streamer.GetStatus(missing).TextureState == TextureStreamer::State::Failed);
+		TEST_CHECK(t, !streamer.GetStatus(missing).Error.empty());
+		TEST_CHECK(t, streamer.GetStatus(bitmap).TextureState == TextureStreamer::State::Failed);
+		TEST_CHECK(t, streamer.GetStatus(good).TextureState == TextureStreamer::State::Resident);
+	});
+}
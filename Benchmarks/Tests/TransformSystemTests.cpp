@@ -0,0 +1,196 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "../../Common/JobSystem.h"
+#include "../../RadianceTransfer_impl/TransformSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// What an object's matrices should be, from its position and scale as of the last
+	// Update() and the one before.
+	struct Expected
+	{
+		XMFLOAT3 Position;
+		XMFLOAT3 Scale;
+		XMFLOAT3 PrevPosition;
+		XMFLOAT3 PrevScale;
+	};
+
+	XMMATRIX World(const XMFLOAT3& position, const XMFLOAT3& scale)
+	{
+		return XMMatrixScaling(scale.x, scale.y, scale.z) * XMMatrixTranslation(position.x, position.y, position.z);
+	}
+
+	// Element by element, relative to the larger of 1 and the expected element.
+	bool SameMatrix(const XMFLOAT4X4& actual, FXMMATRIX expected)
+	{
+		XMFLOAT4X4 e;
+		XMStoreFloat4x4(&e, expected);
+		for (uint32 r = 0; r < 4; ++r)
+		{
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				if (std::fabs(actual.m[r][c] - e.m[r][c]) > 1e-5f * (std::max)(1.0f, std::fabs(e.m[r][c])))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Checks all six matrices of every object and reports the first one that differs.
+	void CheckMatrices(Test& t, const TransformSystem& transforms, const std::vector<Expected>& expected, const std::string& context)
+	{
+		for (uint32 id = 0; id < transforms.Count(); ++id)
+		{
+			const Expected& e = expected[id];
+			const XMMATRIX world = World(e.Position, e.Scale);
+			const XMMATRIX invWorld = XMMatrixInverse(nullptr, world);
+			const XMMATRIX prevWorld = World(e.PrevPosition, e.PrevScale);
+			const bool same =
+				SameMatrix(transforms.World(id), world) &&
+				SameMatrix(transforms.InvWorld(id), invWorld) &&
+				SameMatrix(transforms.PrevWorld(id), prevWorld) &&
+				SameMatrix(transforms.WorldTransposed(id), XMMatrixTranspose(world)) &&
+				SameMatrix(transforms.InvWorldTransposed(id), XMMatrixTranspose(invWorld)) &&
+				SameMatrix(transforms.PrevWorldTransposed(id), XMMatrixTranspose(prevWorld));
+			if (!TEST_CHECK(t, same))
+			{
+				t.Fail(context + ", object " + std::to_string(id), __FILE__, __LINE__);
+				return;
+			}
+		}
+	}
+}
+
+void AddTransformSystemTests(TestSuite& suite)
+{
+	// Random moves and rescales over several updates, for counts that leave the last
+	// batch and the last bitset word partly filled, with and without the job system.
+	suite.Add("transforms/match_directxmath", [](Test& t)
+	{
+		JobSystem jobs(3);
+		for (uint32 count : { 1u, 7u, 8u, 13u, 69u, 1000u, 2051u })
+		{
+			for (bool useJobs : { false, true })
+			{
+				std::mt19937 random(count);
+				std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+				std::uniform_real_distribution<float> scale(0.25f, 4.0f);
+				std::uniform_int_distribution<uint32> pick(0, count - 1);
+
+				TransformSystem transforms;
+				std::vector<Expected> expected(count);
+				for (uint32 id = 0; id < count; ++id)
+				{
+					const XMFLOAT3 p(position(random), position(random), position(random));
+					const XMFLOAT3 s(scale(random), -scale(random), scale(random));
+					TEST_CHECK(t, transforms.Add(p, s) == id);
+					expected[id] = { p, s, p, s };
+				}
+				const std::string name = "count " + std::to_string(count) + (useJobs ? " jobs" : " serial");
+				CheckMatrices(t, transforms, expected, name + " after Add");
+
+				for (uint32 frame = 0; frame < 4; ++frame)
+				{
+					std::vector<Expected> before = expected;
+					for (uint32 move = 0; move < count / 3 + 1; ++move)
+					{
+						const uint32 id = pick(random);
+						if (move % 2)
+							transforms.SetScale(id, XMFLOAT3(scale(random), scale(random), -scale(random)));
+						else
+							transforms.Translate(id, XMFLOAT3(position(random), 0.0f, position(random)));
+						before[id].Position = transforms.Position(id);
+						before[id].Scale = transforms.Scale(id);
+					}
+
+					transforms.Update(useJobs ? &jobs : nullptr);
+					for (uint32 id = 0; id < count; ++id)
+					{
+						expected[id].PrevPosition = expected[id].Position;
+						expected[id].PrevScale = expected[id].Scale;
+						expected[id].Position = before[id].Position;
+						expected[id].Scale = before[id].Scale;
+					}
+					CheckMatrices(t, transforms, expected, name + " frame " + std::to_string(frame));
+					TEST_CHECK(t, transforms.GetStats().Objects == count);
+				}
+			}
+		}
+	});
+
+	// An object moved before one Update() has its previous world there, and the one
+	// after brings the previous world up to the current one and stops updating it.
+	suite.Add("transforms/prev_world", [](Test& t)
+	{
+		const uint32 count = 21; // two full batches and a partial one
+		TransformSystem transforms;
+		for (uint32 id = 0; id < count; ++id)
+			transforms.Add(XMFLOAT3(float(id), 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+
+		// Everything added counts as moved: updated, caught up, then left alone.
+		transforms.Update();
+		TEST_CHECK(t, transforms.GetStats().Updated == count);
+		transforms.Update();
+		TEST_CHECK(t, transforms.GetStats().Updated == count && transforms.GetStats().Batches == 3);
+		transforms.Update();
+		TEST_CHECK(t, transforms.GetStats().Updated == 0 && transforms.GetStats().Batches == 0);
+
+		const uint32 moved = 17;
+		const XMMATRIX start = World(XMFLOAT3(17.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+		const XMMATRIX end = World(XMFLOAT3(17.0f, 2.0f, 0.0f), XMFLOAT3(2.0f, 2.0f, 2.0f));
+		transforms.Translate(moved, XMFLOAT3(0.0f, 2.0f, 0.0f));
+		transforms.SetScale(moved, XMFLOAT3(2.0f, 2.0f, 2.0f));
+		// Not until Update().
+		TEST_CHECK(t, SameMatrix(transforms.World(moved), start));
+
+		// Dirty: the new world, the old one as previous.
+		transforms.Update();
+		TEST_CHECK(t, transforms.WasUpdated(moved));
+		TEST_CHECK(t, transforms.GetStats().Updated == 1 && transforms.GetStats().Batches == 1);
+		TEST_CHECK(t, SameMatrix(transforms.World(moved), end));
+		TEST_CHECK(t, SameMatrix(transforms.PrevWorld(moved), start));
+		TEST_CHECK(t, SameMatrix(transforms.PrevWorldTransposed(moved), XMMatrixTranspose(start)));
+		for (uint32 id = 0; id < count; ++id)
+			TEST_CHECK(t, id == moved || !transforms.WasUpdated(id));
+		// Its batch neighbours are recomputed to what they were.
+		TEST_CHECK(t, SameMatrix(transforms.PrevWorld(16), World(XMFLOAT3(16.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+		// Moved in the last Update(): the previous world catches up.
+		transforms.Update();
+		TEST_CHECK(t, transforms.WasUpdated(moved));
+		TEST_CHECK(t, transforms.GetStats().Updated == 1);
+		TEST_CHECK(t, SameMatrix(transforms.World(moved), end));
+		TEST_CHECK(t, SameMatrix(transforms.PrevWorld(moved), end));
+		TEST_CHECK(t, SameMatrix(transforms.PrevWorldTransposed(moved), XMMatrixTranspose(end)));
+
+		// Caught up: nothing left to do.
+		transforms.Update();
+		TEST_CHECK(t, !transforms.WasUpdated(moved));
+		TEST_CHECK(t, transforms.GetStats().Updated == 0);
+		TEST_CHECK(t, SameMatrix(transforms.PrevWorld(moved), end));
+
+		// Moving again in the catch-up Update() keeps it going.
+		transforms.Translate(moved, XMFLOAT3(1.0f, 0.0f, 0.0f));
+		transforms.Update();
+		transforms.Translate(moved, XMFLOAT3(1.0f, 0.0f, 0.0f));
+		transforms.Update();
+		TEST_CHECK(t, SameMatrix(transforms.PrevWorld(moved), World(XMFLOAT3(18.0f, 2.0f, 0.0f), XMFLOAT3(2.0f, 2.0f, 2.0f))));
+		TEST_CHECK(t, SameMatrix(transforms.World(moved), World(XMFLOAT3(19.0f, 2.0f, 0.0f), XMFLOAT3(2.0f, 2.0f, 2.0f))));
+		transforms.Update();
+		TEST_CHECK(t, transforms.WasUpdated(moved));
+		transforms.Update();
+		TEST_CHECK(t, !transforms.WasUpdated(moved));
+	});
+}
@@ -0,0 +1,304 @@
+#include "Tests.h"
+
+#include <cstring>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../../RadianceTransfer_impl/MockUploadMemoryDevice.h"
+#include "../../RadianceTransfer_impl/UploadAllocator.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// An allocation filled with one byte value, to find out whether it was written over.
+	struct Written
+	{
+		UploadAllocator::Allocation Allocation;
+		std::uint8_t Value = 0;
+	};
+
+	Written Write(const UploadAllocator::Allocation& allocation, std::uint8_t value)
+	{
+		std::memset(allocation.CpuAddress, value, (size_t)allocation.Size);
+		Written written;
+		written.Allocation = allocation;
+		written.Value = value;
+		return written;
+	}
+
+	bool Intact(const Written& written)
+	{
+		for (uint64 i = 0; i < written.Allocation.Size; ++i)
+		{
+			if (written.Allocation.CpuAddress[i] != written.Value)
+				return false;
+		}
+		return true;
+	}
+
+	bool Overlap(const UploadAllocator::Allocation& a, const UploadAllocator::Allocation& b)
+	{
+		return a.GpuAddress < b.GpuAddress + b.Size && b.GpuAddress < a.GpuAddress + a.Size;
+	}
+
+	struct Frame
+	{
+		uint64 Fence = 0;
+		std::vector<Written> Allocations;
+	};
+
+	// Frames whose data the GPU has not read yet.  Complete() checks each frame is intact
+	// as the fake fence passes it.
+	class FakeGpu
+	{
+	public:
+		explicit FakeGpu(uint32 latency) : mLatency(latency) {}
+
+		uint64 Complete(Test& t)
+		{
+			while (!mFrames.empty() && mFrames.front().Fence + mLatency <= mFence)
+			{
+				bool intact = true;
+				for (const Written& written : mFrames.front().Allocations)
+					intact &= Intact(written);
+				TEST_CHECK(t, intact);
+				mCompleted = mFrames.front().Fence;
+				mFrames.pop_front();
+			}
+			return mCompleted;
+		}
+
+		// Whether 'allocation' aliases anything still in flight.
+		bool Aliases(const UploadAllocator::Allocation& allocation, const Frame& current)const
+		{
+			for (const Frame& frame : mFrames)
+			{
+				for (const Written& written : frame.Allocations)
+				{
+					if (Overlap(allocation, written.Allocation))
+						return true;
+				}
+			}
+			for (const Written& written : current.Allocations)
+			{
+				if (Overlap(allocation, written.Allocation))
+					return true;
+			}
+			return false;
+		}
+
+		uint64 NextFence() { return ++mFence; }
+		void Submit(Frame&& frame) { mFrames.push_back(std::move(frame)); }
+
+	private:
+		uint32 mLatency;
+		uint64 mFence = 0;
+		uint64 mCompleted = 0;
+		std::deque<Frame> mFrames;
+	};
+}
+
+void AddUploadAllocatorTests(TestSuite& suite)
+{
+	// Random frames against a fence that completes 'latency' frames late: nothing in
+	// flight is aliased or written over, and every block is destroyed in the end.
+	suite.Add("upload/fake_fence", [](Test& t)
+	{
+		for (uint32 latency : { 0u, 1u, 2u, 5u })
+		{
+			for (uint64 capacity : { 256ull, 4096ull, 1ull << 20 })
+			{
+				for (uint32 seed : { 1u, 2u })
+				{
+					MockUploadMemoryDevice device;
+					{
+						UploadAllocator allocator(device, capacity);
+						FakeGpu gpu(latency);
+						std::mt19937 random(seed);
+						const uint32 maxSize = seed == 2 ? 20000 : 2000;
+						bool aligned = true;
+						bool aliased = false;
+						for (uint32 f = 0; f < 1000; ++f)
+						{
+							allocator.BeginFrame(gpu.Complete(t));
+							Frame frame;
+							frame.Fence = gpu.NextFence();
+							// A lighter load in the second half lets the ring wrap.
+							const uint32 count = f < 500 ? random() % 20 : random() % 4;
+							for (uint32 i = 0; i < count; ++i)
+							{
+								const uint64 size = random() % maxSize;
+								const uint64 alignment = random() % 3 == 0 ? 64 : 256;
+								const UploadAllocator::Allocation allocation = allocator.Allocate(size, alignment);
+								aligned &= allocation.GpuAddress % alignment == 0 && allocation.Size >= size &&
+									allocation.Size % alignment == 0;
+								aliased |= gpu.Aliases(allocation, frame);
+								frame.Allocations.push_back(Write(allocation, std::uint8_t(frame.Fence * 7 + i)));
+							}
+							allocator.EndFrame(frame.Fence);
+							gpu.Submit(std::move(frame));
+						}
+						TEST_CHECK(t, aligned);
+						TEST_CHECK(t, !aliased);
+						if (latency > 0 && capacity == 1ull << 20)
+							TEST_CHECK(t, allocator.GetStats().Wraps > 0);
+					}
+					TEST_CHECK(t, device.LiveBlocks() == 0);
+				}
+			}
+		}
+	});
+
+	// At the end of the block the head wraps to the front only if the allocation ends
+	// short of the tail; one that would end exactly on it grows the ring instead, since
+	// a head equal to the tail reads as an empty ring.
+	suite.Add("upload/exact_wrap", [](Test& t)
+	{
+		for (bool exact : { false, true })
+		{
+			MockUploadMemoryDevice device;
+			UploadAllocator allocator(device, 1024);
+
+			allocator.BeginFrame(0);
+			const Written first = Write(allocator.Allocate(512), 1);
+			allocator.EndFrame(1);
+			allocator.BeginFrame(0);
+			const Written second = Write(allocator.Allocate(256), 2);
+			allocator.EndFrame(2);
+
+			// Frame 1 is done: the tail is at 512 and [768, 1024) is free at the end.
+			allocator.BeginFrame(1);
+			const Written end = Write(allocator.Allocate(256), 3);
+			TEST_CHECK(t, end.Allocation.GpuAddress == first.Allocation.GpuAddress + 768);
+
+			const Written wrapped = Write(allocator.Allocate(exact ? 512 : 256), 4);
+			if (exact)
+			{
+				TEST_CHECK(t, allocator.GetStats().Wraps == 0);
+				TEST_CHECK(t, allocator.GetStats().Growths == 1);
+				TEST_CHECK(t, allocator.GetStats().Capacity == 2048);
+				TEST_CHECK(t, !Overlap(wrapped.Allocation, first.Allocation));
+				TEST_CHECK(t, wrapped.Allocation.GpuAddress >= first.Allocation.GpuAddress + 1024);
+			}
+			else
+			{
+				TEST_CHECK(t, allocator.GetStats().Wraps == 1);
+				TEST_CHECK(t, allocator.GetStats().Growths == 0);
+				TEST_CHECK(t, wrapped.Allocation.GpuAddress == first.Allocation.GpuAddress);
+
+				// [256, 512) is free, but taking all of it would meet the tail.
+				const Written full = Write(allocator.Allocate(256), 5);
+				TEST_CHECK(t, allocator.GetStats().Growths == 1);
+				TEST_CHECK(t, !Overlap(full.Allocation, first.Allocation));
+				TEST_CHECK(t, Intact(wrapped));
+			}
+			TEST_CHECK(t, Intact(second));
+			TEST_CHECK(t, Intact(end));
+			allocator.EndFrame(3);
+		}
+	});
+
+	// Growing halfway through a frame leaves that frame's earlier allocations and the
+	// frames in flight in the old block, which lives until the growing frame completes.
+	suite.Add("upload/growth_mid_frame", [](Test& t)
+	{
+		MockUploadMemoryDevice device;
+		UploadAllocator allocator(device, 1024);
+
+		allocator.BeginFrame(0);
+		const Written frame1 = Write(allocator.Allocate(512), 1);
+		allocator.EndFrame(1);
+
+		allocator.BeginFrame(0);
+		const Written before = Write(allocator.Allocate(256), 2);
+		const Written grown = Write(allocator.Allocate(1000), 3);
+		const Written after = Write(allocator.Allocate(256), 4);
+		allocator.EndFrame(2);
+
+		TEST_CHECK(t, allocator.GetStats().Growths == 1);
+		TEST_CHECK(t, allocator.GetStats().Blocks == 2);
+		TEST_CHECK(t, device.CreatedBlocks() == 2);
+		TEST_CHECK(t, !Overlap(grown.Allocation, frame1.Allocation) && !Overlap(grown.Allocation, before.Allocation));
+		TEST_CHECK(t, after.Allocation.GpuAddress == grown.Allocation.GpuAddress + 1024);
+
+		// Frame 1 completing is not enough: frame 2 still reads the old block.
+		allocator.BeginFrame(1);
+		TEST_CHECK(t, device.IsLive(0));
+		const Written frame3 = Write(allocator.Allocate(256), 5);
+		allocator.EndFrame(3);
+		TEST_CHECK(t, Intact(before) && Intact(grown) && Intact(after));
+		TEST_CHECK(t, !Overlap(frame3.Allocation, grown.Allocation) && !Overlap(frame3.Allocation, after.Allocation));
+
+		allocator.BeginFrame(2);
+		TEST_CHECK(t, !device.IsLive(0));
+		TEST_CHECK(t, device.IsLive(1));
+		TEST_CHECK(t, allocator.GetStats().Blocks == 1);
+		TEST_CHECK(t, Intact(frame3));
+		allocator.EndFrame(4);
+	});
+
+	// Each retired block is destroyed with the first fence that covers the frame that
+	// retired it, oldest first, whatever the number of frames in flight; the destructor
+	// takes the rest.
+	suite.Add("upload/retired_order", [](Test& t)
+	{
+		MockUploadMemoryDevice device;
+		{
+			UploadAllocator allocator(device, 256);
+
+			// Frames 1 to 3 each outgrow the block; frame 3 does so twice.
+			uint64 size = 512;
+			for (uint64 fence = 1; fence <= 3; ++fence)
+			{
+				allocator.BeginFrame(0);
+				allocator.Allocate(size);
+				size *= 2;
+				if (fence == 3)
+				{
+					allocator.Allocate(size);
+					size *= 2;
+				}
+				allocator.EndFrame(fence);
+			}
+			TEST_CHECK(t, device.CreatedBlocks() == 5);
+			TEST_CHECK(t, device.LiveBlocks() == 5);
+			TEST_CHECK(t, allocator.GetStats().Blocks == 5);
+
+			const bool liveAfter[3][5] = {
+				{ false, true, true, true, true },
+				{ false, false, true, true, true },
+				{ false, false, false, false, true } };
+			for (uint64 completed = 1; completed <= 3; ++completed)
+			{
+				allocator.BeginFrame(completed);
+				bool expected = true;
+				for (uint32 block = 0; block < 5; ++block)
+					expected &= device.IsLive(block) == liveAfter[completed - 1][block];
+				TEST_CHECK(t, expected);
+				allocator.EndFrame(3 + completed);
+			}
+
+			// A growth in the last frame before shutdown is not waited for.
+			allocator.BeginFrame(5);
+			allocator.Allocate(size);
+			allocator.EndFrame(7);
+			TEST_CHECK(t, device.LiveBlocks() == 2);
+		}
+		TEST_CHECK(t, device.LiveBlocks() == 0);
+
+		bool threw = false;
+		try
+		{
+			device.DestroyBlock(0);
+		}
+		catch (const std::logic_error&)
+		{
+			threw = true;
+		}
+		TEST_CHECK(t, threw);
+	});
+}
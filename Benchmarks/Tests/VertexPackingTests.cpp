@@ -0,0 +1,288 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "../../Common/FileUtil.h"
+#include "../../Common/GeometryGenerator.h"
+#include "../../RadianceTransfer_impl/VertexPacking.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	XMFLOAT3 RandomUnit(std::mt19937& random)
+	{
+		std::normal_distribution<float> normal;
+		for (;;)
+		{
+			const XMFLOAT3 v(normal(random), normal(random), normal(random));
+			const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+			if (length > 1e-3f)
+				return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+		}
+	}
+
+	std::vector<GeometryGenerator::Vertex> RandomVertices(uint32 count, uint32 seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> position(-20.0f, 35.0f);
+		std::uniform_real_distribution<float> texC(0.0f, 1.0f);
+		std::vector<GeometryGenerator::Vertex> vertices(count);
+		for (GeometryGenerator::Vertex& v : vertices)
+		{
+			v.Position = XMFLOAT3(position(random), 0.25f * position(random), position(random) + 100.0f);
+			v.Normal = RandomUnit(random);
+			v.TangentU = RandomUnit(random);
+			v.TexC = XMFLOAT2(texC(random), texC(random));
+		}
+		return vertices;
+	}
+
+	// UnpackSnorm2x16 in Shaders/VertexFormat.hlsl: low half first, -32768 clamps to -1.
+	void UnpackSnorm2x16(uint32 word, float out[2])
+	{
+		const std::int16_t lo = std::int16_t(word & 0xffffu);
+		const std::int16_t hi = std::int16_t(word >> 16);
+		out[0] = (std::max)(float(lo) / 32767.0f, -1.0f);
+		out[1] = (std::max)(float(hi) / 32767.0f, -1.0f);
+	}
+
+	// UnpackVertex(PackedVertex, ...) as the shaders run it: the packed vertex read as the
+	// five words of the HLSL struct, the scale and bias as the float4s of cbPerObject.
+	XMFLOAT3 ShaderDequantize(const VertexPacking::PackedVertex& p, const XMFLOAT4& scale, const XMFLOAT4& bias)
+	{
+		uint32 words[5];
+		static_assert(sizeof(words) == sizeof(p), "PackedVertex is five words in HLSL.");
+		std::memcpy(words, &p, sizeof(words));
+
+		float xy[2];
+		float zw[2];
+		UnpackSnorm2x16(words[0], xy);
+		UnpackSnorm2x16(words[1], zw);
+		return XMFLOAT3(xy[0] * scale.x + bias.x, xy[1] * scale.y + bias.y, zw[0] * scale.z + bias.z);
+	}
+
+	std::string ReadText(const std::string& path)
+	{
+		MappedFile file(path);
+		return file.IsOpen() ? std::string((const char*)file.Data(), file.Size()) : std::string();
+	}
+
+	// Byte offset of every member of a cbuffer under the HLSL packing rules, for the
+	// scalar, vector and float4x4 members cbPerObject uses.  A member may not straddle
+	// a 16-byte register and a matrix starts one.  Returns false on anything else.
+	bool CBufferOffsets(const std::string& source, const std::string& name,
+		std::vector<std::pair<std::string, uint32>>& offsets, uint32* size)
+	{
+		const size_t open = source.find('{', source.find("cbuffer " + name));
+		const size_t close = source.find('}', open);
+		if (open == std::string::npos || close == std::string::npos)
+			return false;
+
+		uint32 offset = 0;
+		size_t line = open + 1;
+		while (line < close)
+		{
+			size_t end = source.find(';', line);
+			if (end == std::string::npos || end > close)
+				break;
+			std::string declaration = source.substr(line, end - line);
+			line = end + 1;
+
+			// Drop the comment ending the previous member's line.
+			const size_t comment = declaration.find("//");
+			if (comment != std::string::npos)
+				declaration = declaration.substr(declaration.find('\n', comment) + 1);
+
+			char type[32] = {};
+			char member[64] = {};
+			if (sscanf(declaration.c_str(), " %31s %63s", type, member) != 2)
+				return false;
+
+			const std::string t = type;
+			uint32 bytes = 0;
+			bool matrix = false;
+			if (t == "float4x4")
+			{
+				bytes = 64;
+				matrix = true;
+			}
+			else if (t == "float" || t == "uint" || t == "int")
+				bytes = 4;
+			else if (t.size() == 6 && (t.compare(0, 5, "float") == 0) && t[5] >= '2' && t[5] <= '4')
+				bytes = 4 * (t[5] - '0');
+			else if (t.size() == 5 && (t.compare(0, 4, "uint") == 0) && t[4] >= '2' && t[4] <= '4')
+				bytes = 4 * (t[4] - '0');
+			else
+				return false;
+
+			if (matrix || offset / 16 != (offset + bytes - 1) / 16)
+				offset = (offset + 15) / 16 * 16;
+			offsets.push_back(std::make_pair(std::string(member), offset));
+			offset += bytes;
+		}
+		*size = (offset + 15) / 16 * 16;
+		return !offsets.empty();
+	}
+}
+
+void AddVertexPackingTests(TestSuite& suite)
+{
+	// cbPerObject is declared once, in the layout of ObjectConstants in FrameResource.h,
+	// so the dequantization constants the app writes are where the shaders read them.
+	suite.Add("vertex/object_constants", [](Test& t)
+	{
+		const std::string shaders = t.DataDirectory() + "/RadianceTransfer_impl/Shaders/";
+		const std::string source = ReadText(shaders + "ObjectConstants.hlsl");
+		std::vector<std::pair<std::string, uint32>> offsets;
+		uint32 size = 0;
+		if (!TEST_CHECK(t, CBufferOffsets(source, "cbPerObject", offsets, &size)))
+			return;
+
+		// offsetof and sizeof ObjectConstants, which FrameResource.h asserts.
+		const std::pair<std::string, uint32> expected[] = {
+			{ "gWorld", 0 }, { "gInvWorld", 64 }, { "gTexTransform", 128 }, { "gLastFrameWorld", 192 },
+			{ "gMaterialIndex", 256 }, { "gVertexOffset", 260 }, { "gObjId", 264 }, { "gObjPad", 268 },
+			{ "gPosDequantScale", 272 }, { "gPosDequantBias", 288 } };
+		TEST_CHECK(t, offsets.size() == sizeof(expected) / sizeof(expected[0]));
+		for (size_t i = 0; i < (std::min)(offsets.size(), sizeof(expected) / sizeof(expected[0])); ++i)
+			TEST_CHECK(t, offsets[i] == expected[i]);
+		TEST_CHECK(t, size == 304);
+
+		for (const char* shader : { "Common.hlsl", "RayGen.hlsl", "TextureSpaceRayGen.hlsl" })
+		{
+			const std::string text = ReadText(shaders + shader);
+			TEST_CHECK(t, text.find("#include \"ObjectConstants.hlsl\"") != std::string::npos);
+			TEST_CHECK(t, text.find("cbPerObject") == std::string::npos);
+		}
+	});
+
+	// Pack, then dequantize the way the shaders do with the constants the app uploads:
+	// every position lands within half a quantization step of where it started.
+	suite.Add("vertex/shader_dequantization", [](Test& t)
+	{
+		const std::vector<GeometryGenerator::Vertex> vertices = RandomVertices(4096, 29);
+		const VertexPacking::PositionDequantization dq =
+			VertexPacking::ComputeDequantization(vertices.data(), vertices.size());
+		const XMFLOAT4 scale(dq.Scale.x, dq.Scale.y, dq.Scale.z, 0.0f);
+		const XMFLOAT4 bias(dq.Bias.x, dq.Bias.y, dq.Bias.z, 0.0f);
+
+		float worst[3] = {};
+		bool matchesUnpack = true;
+		for (const GeometryGenerator::Vertex& v : vertices)
+		{
+			const VertexPacking::PackedVertex p = VertexPacking::Pack(v, dq);
+			const XMFLOAT3 shader = ShaderDequantize(p, scale, bias);
+			const XMFLOAT3 cpu = VertexPacking::Unpack(p, dq).Position;
+			matchesUnpack &= shader.x == cpu.x && shader.y == cpu.y && shader.z == cpu.z;
+
+			worst[0] = (std::max)(worst[0], std::fabs(shader.x - v.Position.x));
+			worst[1] = (std::max)(worst[1], std::fabs(shader.y - v.Position.y));
+			worst[2] = (std::max)(worst[2], std::fabs(shader.z - v.Position.z));
+		}
+
+		TEST_CHECK(t, matchesUnpack);
+		// Half a step, plus a little for the float arithmetic around the bias.
+		const float step[3] = { dq.Scale.x / 32767.0f, dq.Scale.y / 32767.0f, dq.Scale.z / 32767.0f };
+		const float biasUlp[3] = { std::fabs(dq.Bias.x) * 1e-6f, std::fabs(dq.Bias.y) * 1e-6f, std::fabs(dq.Bias.z) * 1e-6f };
+		for (uint32 axis = 0; axis < 3; ++axis)
+			TEST_CHECK(t, worst[axis] <= 0.5f * step[axis] + biasUlp[axis] + 1e-6f);
+	});
+
+	// The bounds corners are the extremes of the snorm range and come back exactly.
+	suite.Add("vertex/bounds_corners", [](Test& t)
+	{
+		const XMFLOAT3 center(3.0f, -1.0f, 0.5f);
+		const XMFLOAT3 extents(2.0f, 4.0f, 8.0f);
+		const VertexPacking::PositionDequantization dq = VertexPacking::MakeDequantization(center, extents);
+		for (uint32 corner = 0; corner < 8; ++corner)
+		{
+			GeometryGenerator::Vertex v;
+			v.Position = XMFLOAT3(
+				center.x + (corner & 1 ? extents.x : -extents.x),
+				center.y + (corner & 2 ? extents.y : -extents.y),
+				center.z + (corner & 4 ? extents.z : -extents.z));
+			v.Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			v.TexC = XMFLOAT2(0.0f, 0.0f);
+
+			const VertexPacking::PackedVertex p = VertexPacking::Pack(v, dq);
+			TEST_CHECK(t, std::abs(p.Position[0]) == 32767 && std::abs(p.Position[1]) == 32767 && std::abs(p.Position[2]) == 32767);
+			const XMFLOAT3 q = VertexPacking::Unpack(p, dq).Position;
+			TEST_CHECK(t, q.x == v.Position.x && q.y == v.Position.y && q.z == v.Position.z);
+		}
+	});
+
+	// A flat axis keeps a usable scale and the positions on it survive.
+	suite.Add("vertex/flat_axis", [](Test& t)
+	{
+		GeometryGenerator geometry;
+		const GeometryGenerator::MeshData grid = geometry.CreateGrid(10.0f, 6.0f, 8, 8);
+		const VertexPacking::PositionDequantization dq =
+			VertexPacking::ComputeDequantization(grid.Vertices.data(), grid.Vertices.size());
+		TEST_CHECK(t, dq.Scale.y > 0.0f);
+		const VertexPacking::RoundTripError error =
+			VertexPacking::MeasureRoundTripError(grid.Vertices.data(), grid.Vertices.size(), dq);
+		TEST_CHECK(t, error.Position <= 5.0f / 32767.0f);
+	});
+
+	// Octahedral normals and tangents to within a twentieth of a degree, over every octant
+	// and the fold at z = 0.  The angles come from a float acos, which resolves no finer.
+	suite.Add("vertex/octahedral", [](Test& t)
+	{
+		std::vector<GeometryGenerator::Vertex> vertices = RandomVertices(8192, 7);
+		const XMFLOAT3 axes[] = {
+			{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+			{ 0.70710678f, 0.70710678f, 0 }, { -0.70710678f, 0, -0.70710678f } };
+		for (const XMFLOAT3& axis : axes)
+		{
+			GeometryGenerator::Vertex v = vertices.front();
+			v.Normal = axis;
+			v.TangentU = axis;
+			vertices.push_back(v);
+		}
+
+		const VertexPacking::PositionDequantization dq =
+			VertexPacking::ComputeDequantization(vertices.data(), vertices.size());
+		const VertexPacking::RoundTripError error =
+			VertexPacking::MeasureRoundTripError(vertices.data(), vertices.size(), dq);
+		TEST_CHECK(t, error.NormalDegrees < 0.05f);
+		TEST_CHECK(t, error.TangentDegrees < 0.05f);
+
+		for (const XMFLOAT3& axis : axes)
+		{
+			std::int16_t oct[2];
+			VertexPacking::EncodeOctahedral(axis, oct);
+			const XMFLOAT3 n = VertexPacking::DecodeOctahedral(oct);
+			TEST_CHECK_NEAR(t, n.x * axis.x + n.y * axis.y + n.z * axis.z, 1.0, 1e-6);
+		}
+	});
+
+	// Texture coordinates go through half precision: exact where a half can hold the
+	// value, round to nearest even otherwise, infinity past the range.
+	suite.Add("vertex/half", [](Test& t)
+	{
+		const float exact[] = { 0.0f, 1.0f, -2.0f, 0.5f, 0.25f, 65504.0f, 1.0f / 1024.0f, 6.103515625e-05f };
+		for (float f : exact)
+			TEST_CHECK(t, VertexPacking::HalfToFloat(VertexPacking::FloatToHalf(f)) == f);
+
+		// 1 + 2^-11 is halfway between 1 and the next half, 1 + 2^-10: ties go to even.
+		TEST_CHECK(t, VertexPacking::FloatToHalf(1.0f + 1.0f / 2048.0f) == 0x3c00);
+		TEST_CHECK(t, VertexPacking::FloatToHalf(1.0f + 3.0f / 2048.0f) == 0x3c02);
+		TEST_CHECK(t, VertexPacking::FloatToHalf(1e6f) == 0x7c00);
+		TEST_CHECK(t, VertexPacking::FloatToHalf(-1e6f) == 0xfc00);
+
+		const std::vector<GeometryGenerator::Vertex> vertices = RandomVertices(1024, 11);
+		const VertexPacking::PositionDequantization dq =
+			VertexPacking::ComputeDequantization(vertices.data(), vertices.size());
+		const VertexPacking::RoundTripError error =
+			VertexPacking::MeasureRoundTripError(vertices.data(), vertices.size(), dq);
+		TEST_CHECK(t, error.TexC <= 1.0f / 2048.0f);
+	});
+}
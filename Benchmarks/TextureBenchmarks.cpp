@@ -0,0 +1,136 @@
+#include "Benchmarks.h"
+
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#include "../Common/BCDecoder.h"
+#include "../Common/DDSReader.h"
+#include "../Common/FileUtil.h"
+#include "../Common/JobSystem.h"
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	struct BlockFormat
+	{
+		const char* Name;
+		DXGI_FORMAT Format;
+		uint32 BlockBytes;
+	};
+
+	const BlockFormat kBlockFormats[] =
+	{
+		{ "bc1", DXGI_FORMAT_BC1_UNORM, 8 },
+		{ "bc2", DXGI_FORMAT_BC2_UNORM, 16 },
+		{ "bc3", DXGI_FORMAT_BC3_UNORM, 16 },
+		{ "bc4", DXGI_FORMAT_BC4_UNORM, 8 },
+		{ "bc5", DXGI_FORMAT_BC5_SNORM, 16 },
+		{ "bc6h_uf16", DXGI_FORMAT_BC6H_UF16, 16 },
+		{ "bc6h_sf16", DXGI_FORMAT_BC6H_SF16, 16 },
+		{ "bc7", DXGI_FORMAT_BC7_UNORM, 16 },
+	};
+
+	// Files covering the kinds of header the scenes use: legacy BC with mips, legacy
+	// uncompressed, and a DX10 array.
+	const char* kDdsFiles[] = { "bricks2.dds", "tile_nmap.dds", "treearray.dds" };
+
+	void AddDecode(BenchmarkSuite& suite, const BlockFormat& format, bool toFloat, uint32 threads)
+	{
+		const std::string name = std::string("bc/decode_") + (toFloat ? "float" : "rgba8") + "/" + format.Name +
+			"/1024x1024/threads=" + (threads == 0 ? std::string("all") : std::to_string(threads));
+		suite.Add(name, [format, toFloat, threads](Benchmark& b)
+		{
+			const uint32 size = 1024;
+			const size_t rowBytes = (size / 4) * format.BlockBytes;
+
+			// Random blocks exercise every mode and partition of the formats that have them.
+			std::mt19937 random(42);
+			std::vector<std::uint8_t> blocks(rowBytes * (size / 4));
+			for (std::uint8_t& byte : blocks)
+				byte = (std::uint8_t)random();
+
+			std::vector<std::uint8_t> rgba8(toFloat ? 0 : (size_t)size * size * 4);
+			std::vector<float> rgba32(toFloat ? (size_t)size * size * 4 : 0);
+			// threads=all decodes on a JobSystem of the default size.
+			std::unique_ptr<JobSystem> jobs(threads == 0 ? new JobSystem() : nullptr);
+
+			b.SetItems((double)size * size, "texels");
+			b.SetBytes((double)blocks.size());
+			b.Measure([&]()
+			{
+				if (toFloat)
+				{
+					BCDecoder::Decode(format.Format, blocks.data(), rowBytes, size, size, rgba32.data(), size * 16, jobs.get());
+					Benchmark::DoNotOptimize(rgba32.data());
+				}
+				else
+				{
+					BCDecoder::Decode(format.Format, blocks.data(), rowBytes, size, size, rgba8.data(), size * 4, jobs.get());
+					Benchmark::DoNotOptimize(rgba8.data());
+				}
+			});
+		});
+	}
+}
+
+void AddTextureBenchmarks(BenchmarkSuite& suite)
+{
+	// Header validation and the subresource table, from memory so only parsing is timed,
+	// then the same through a file mapping as the loader does it.
+	for (const char* file : kDdsFiles)
+	{
+		const std::string fileName = file;
+		suite.Add("dds/parse/" + fileName, [fileName](Benchmark& b)
+		{
+			const std::string path = b.DataDirectory() + "/Textures/" + fileName;
+			MappedFile mapped;
+			if (!mapped.Open(path))
+			{
+				b.Skip(path + " not found");
+				return;
+			}
+			const std::vector<std::uint8_t> data(mapped.Data(), mapped.Data() + mapped.Size());
+
+			std::string error;
+			DDSReader probe;
+			if (!probe.Parse(data.data(), data.size(), &error))
+				throw std::runtime_error(path + ": " + error);
+			b.SetItems((double)probe.SubresourceCount(), "subresources");
+
+			b.Measure([&]()
+			{
+				DDSReader reader;
+				reader.Parse(data.data(), data.size());
+				Benchmark::DoNotOptimize(&reader.GetSubresource(0));
+			});
+		});
+
+		suite.Add("dds/open/" + fileName, [fileName](Benchmark& b)
+		{
+			const std::string path = b.DataDirectory() + "/Textures/" + fileName;
+			if (!FileUtil::FileExists(path))
+			{
+				b.Skip(path + " not found");
+				return;
+			}
+
+			b.Measure([&]()
+			{
+				DDSReader reader;
+				if (!reader.Open(path))
+					throw std::runtime_error("cannot open " + path);
+				Benchmark::DoNotOptimize(reader.BitData());
+			});
+		});
+	}
+
+	for (const BlockFormat& format : kBlockFormats)
+		AddDecode(suite, format, false, 1);
+	for (const BlockFormat& format : kBlockFormats)
+		AddDecode(suite, format, true, 1);
+	// The two slowest formats again over every hardware thread, for the scaling.
+	AddDecode(suite, kBlockFormats[6], true, 0);
+	AddDecode(suite, kBlockFormats[7], false, 0);
+}
@@ -0,0 +1,135 @@
+#include "Benchmarks.h"
+
+#include <cstring>
+#include <memory>
+#include <random>
+
+#include <DirectXMath.h>
+
+#include "../Common/JobSystem.h"
+#include "../RadianceTransfer_impl/TransformSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// ObjectConstants (FrameResource.h) field for field; that header needs the Windows SDK.
+	struct ObjectConstants
+	{
+		XMFLOAT4X4 World;
+		XMFLOAT4X4 InvWorld;
+		XMFLOAT4X4 TexTransform;
+		XMFLOAT4X4 LastFrameWorld;
+		uint32 MaterialIndex;
+		uint32 vertexOffset;
+		uint32 objId;
+		uint32 ObjPad;
+		XMFLOAT4 PosDequantScale;
+		XMFLOAT4 PosDequantBias;
+	};
+
+	const uint32 kObjectCBByteSize = (sizeof(ObjectConstants) + 255) & ~255u;
+
+	void FillTransforms(TransformSystem& transforms, uint32 count)
+	{
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+		transforms.Reserve(count);
+		for (uint32 i = 0; i < count; ++i)
+			transforms.Add(XMFLOAT3(position(random), position(random), position(random)), XMFLOAT3(scale(random), scale(random), scale(random)));
+		transforms.Update();
+	}
+
+	// Moves every 'stride'th object a little.
+	void MoveObjects(TransformSystem& transforms, uint32 stride)
+	{
+		for (uint32 i = 0; i < transforms.Count(); i += stride)
+			transforms.Translate(i, XMFLOAT3(0.01f, 0.0f, -0.01f));
+	}
+}
+
+void AddTransformBenchmarks(BenchmarkSuite& suite)
+{
+	struct Case
+	{
+		uint32 Objects;
+		uint32 Stride; // every Stride'th object moves each frame
+		bool Jobs;
+	};
+	const Case cases[] =
+	{
+		{ 1000, 1, false },
+		{ 100000, 1, false },
+		{ 100000, 10, false },
+		{ 100000, 1, true },
+	};
+
+	for (const Case& c : cases)
+	{
+		const std::string name = "transforms/update/objects=" + std::to_string(c.Objects) +
+			"/moved=" + std::to_string(100 / c.Stride) + "%" + (c.Jobs ? "/jobs" : "");
+		suite.Add(name, [c](Benchmark& b)
+		{
+			TransformSystem transforms;
+			FillTransforms(transforms, c.Objects);
+			std::unique_ptr<JobSystem> jobs(c.Jobs ? new JobSystem() : nullptr);
+
+			// Moving is part of the frame; it is what sets the dirty bits Update() reads.
+			b.SetItems(c.Objects, "objects");
+			b.Measure([&]()
+			{
+				MoveObjects(transforms, c.Stride);
+				transforms.Update(jobs.get());
+			});
+			b.AddCounter("updated", transforms.GetStats().Updated);
+		});
+	}
+
+	// UpdateObjectCBs: the constants of every moved object rebuilt from the transform
+	// store, then every object's constants copied into 256-byte slices of the upload ring.
+	for (uint32 count : { 1000u, 100000u })
+	{
+		suite.Add("transforms/object_constants/objects=" + std::to_string(count), [count](Benchmark& b)
+		{
+			TransformSystem transforms;
+			FillTransforms(transforms, count);
+			MoveObjects(transforms, 1);
+			transforms.Update();
+
+			std::vector<ObjectConstants> constants(count);
+			std::vector<XMFLOAT4X4> texTransforms(count);
+			for (XMFLOAT4X4& texTransform : texTransforms)
+				XMStoreFloat4x4(&texTransform, XMMatrixScaling(8.0f, 8.0f, 1.0f));
+			std::vector<std::uint8_t> ring((size_t)kObjectCBByteSize * count);
+
+			b.SetItems(count, "objects");
+			b.SetBytes((double)ring.size());
+			b.Measure([&]()
+			{
+				for (uint32 i = 0; i < count; ++i)
+				{
+					if (!transforms.WasUpdated(i))
+						continue;
+
+					ObjectConstants& objConstants = constants[i];
+					objConstants.LastFrameWorld = transforms.PrevWorld(i);
+					objConstants.World = transforms.WorldTransposed(i);
+					objConstants.InvWorld = transforms.InvWorldTransposed(i);
+					XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&texTransforms[i])));
+					objConstants.MaterialIndex = i % 4;
+					objConstants.vertexOffset = i * 24;
+					objConstants.objId = i;
+					objConstants.PosDequantScale = XMFLOAT4(1.0f, 1.0f, 1.0f, 0.0f);
+					objConstants.PosDequantBias = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+				}
+
+				for (uint32 i = 0; i < count; ++i)
+					std::memcpy(ring.data() + (size_t)i * kObjectCBByteSize, &constants[i], sizeof(ObjectConstants));
+				Benchmark::DoNotOptimize(ring.data());
+			});
+		});
+	}
+}
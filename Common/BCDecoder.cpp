@@ -0,0 +1,1159 @@
+//***************************************************************************************
+// BCDecoder.cpp
+//***************************************************************************************
+
+#include "BCDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "JobSystem.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BC_DECODER_SSE2 1
+#include <emmintrin.h>
+#else
+#define BC_DECODER_SSE2 0
+#endif
+
+namespace BCDecoder
+{
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint16 = std::uint16_t;
+	using uint64 = std::uint64_t;
+	using int32 = std::int32_t;
+
+	enum class Family { BC1, BC2, BC3, BC4, BC5, BC6H, BC7 };
+
+	struct FormatInfo
+	{
+		Family Kind = Family::BC1;
+		bool Signed = false;
+		bool Srgb = false;
+	};
+
+	bool GetFormatInfo(DXGI_FORMAT format, FormatInfo& info)
+	{
+		info = FormatInfo();
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB: info.Kind = Family::BC1; break;
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB: info.Kind = Family::BC2; break;
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB: info.Kind = Family::BC3; break;
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:      info.Kind = Family::BC4; break;
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:      info.Kind = Family::BC5; break;
+		case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:      info.Kind = Family::BC6H; break;
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB: info.Kind = Family::BC7; break;
+		default:                         return false;
+		}
+
+		info.Signed = format == DXGI_FORMAT_BC4_SNORM || format == DXGI_FORMAT_BC5_SNORM ||
+			format == DXGI_FORMAT_BC6H_SF16;
+		info.Srgb = format == DXGI_FORMAT_BC1_UNORM_SRGB || format == DXGI_FORMAT_BC2_UNORM_SRGB ||
+			format == DXGI_FORMAT_BC3_UNORM_SRGB || format == DXGI_FORMAT_BC7_UNORM_SRGB;
+		return true;
+	}
+
+	std::size_t BlockBytes(Family kind)
+	{
+		return (kind == Family::BC1 || kind == Family::BC4) ? 8 : 16;
+	}
+
+	// BC1/2/3/7 decode to bytes; BC4/5 and BC6H to floats, which is what they hold.
+	bool DecodesToBytes(Family kind)
+	{
+		return kind == Family::BC1 || kind == Family::BC2 || kind == Family::BC3 || kind == Family::BC7;
+	}
+
+	uint32 Load16(const uint8* p) { return p[0] | (uint32(p[1]) << 8); }
+	uint32 Load32(const uint8* p) { uint32 v; std::memcpy(&v, p, 4); return v; }
+	uint64 Load48(const uint8* p) { uint64 v = 0; std::memcpy(&v, p, 6); return v; }
+
+	// Reads fields from a 128 bit block, least significant bit first.
+	class BitReader
+	{
+	public:
+		explicit BitReader(const uint8* block)
+		{
+			std::memcpy(&mLow, block, 8);
+			std::memcpy(&mHigh, block + 8, 8);
+		}
+
+		uint32 Read(uint32 count)
+		{
+			uint64 bits;
+			if (mPosition >= 64)
+				bits = mHigh >> (mPosition - 64);
+			else if (mPosition + count <= 64)
+				bits = mLow >> mPosition;
+			else
+				bits = (mLow >> mPosition) | (mHigh << (64 - mPosition));
+			mPosition += count;
+			return uint32(bits) & ((1u << count) - 1);
+		}
+
+		// Everything after the current position, which must be past bit 64.
+		uint64 ReadRest()
+		{
+			const uint64 bits = mHigh >> (mPosition - 64);
+			mPosition = 128;
+			return bits;
+		}
+
+	private:
+		uint64 mLow = 0;
+		uint64 mHigh = 0;
+		uint32 mPosition = 0;
+	};
+
+	//-----------------------------------------------------------------------------------
+	// Tables shared by BC6H and BC7
+	//-----------------------------------------------------------------------------------
+
+	const uint8 Weights2[4] = { 0, 21, 43, 64 };
+	const uint8 Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const uint8 Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	const uint8* WeightTable(uint32 indexBits)
+	{
+		return indexBits == 2 ? Weights2 : indexBits == 3 ? Weights3 : Weights4;
+	}
+
+	// Two subset partitions, bit i set when texel i is in subset 1.
+	const uint16 Partitions2[64] =
+	{
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+		0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+		0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+		0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+		0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+
+	const uint8 Partitions3[64][16] =
+	{
+		{ 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+		{ 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+		{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+		{ 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+		{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+		{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+		{ 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 }, { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+		{ 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+		{ 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 }, { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+		{ 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+		{ 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+		{ 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 }, { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+		{ 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 }, { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+		{ 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 }, { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+		{ 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 }, { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+		{ 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 }, { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+		{ 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+		{ 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 }, { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+		{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 }, { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+		{ 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 }, { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+		{ 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+		{ 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 }, { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+		{ 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 }, { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+		{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 }, { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+		{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 }, { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+		{ 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 }, { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+		{ 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 }, { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+		{ 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+		{ 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+		{ 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+		{ 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 }, { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+		{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 }
+	};
+
+	// Texels whose index is stored with one bit less: that of subset 1 in two subset
+	// partitions, and those of subsets 1 and 2 in three subset ones.  Texel 0 is always
+	// the anchor of subset 0.
+	const uint8 Anchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+	};
+
+	const uint8 Anchors3First[64] =
+	{
+		 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+		 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+		 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+		 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+	};
+
+	const uint8 Anchors3Second[64] =
+	{
+		15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+		15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+		15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+		15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+	};
+
+	//-----------------------------------------------------------------------------------
+	// Vector helpers.  Each has a scalar version computing exactly the same values.
+	//-----------------------------------------------------------------------------------
+
+	// BC1 colours as RGBA8 packed red first, the way they sit in memory.
+	uint32 Expand565(uint32 c)
+	{
+		const uint32 r = (c >> 11) & 31;
+		const uint32 g = (c >> 5) & 63;
+		const uint32 b = c & 31;
+		return ((r << 3) | (r >> 2)) | (((g << 2) | (g >> 4)) << 8) | (((b << 3) | (b >> 2)) << 16) | 0xFF000000u;
+	}
+
+	// The four BC1 colours.  Thirds are rounded; in three colour mode the last entry is
+	// transparent black.
+	void ColorPalette(uint32 c0, uint32 c1, bool fourColor, uint32* palette)
+	{
+#if BC_DECODER_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi16(1);
+		const __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)c0), zero);
+		const __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)c1), zero);
+		const __m128i ab = _mm_unpacklo_epi64(a, b);
+		__m128i mixed;
+		if (fourColor)
+		{
+			// (2a + b + 1) / 3 and (a + 2b + 1) / 3; x * 21846 >> 16 is x / 3 for x < 768.
+			const __m128i ba = _mm_unpacklo_epi64(b, a);
+			const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(ab, ab), ba), one);
+			mixed = _mm_mulhi_epu16(sum, _mm_set1_epi16(21846));
+		}
+		else
+		{
+			mixed = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(a, b), one), 1);
+			mixed = _mm_unpacklo_epi64(mixed, zero);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(palette), _mm_packus_epi16(ab, mixed));
+#else
+		palette[0] = c0;
+		palette[1] = c1;
+		palette[2] = 0;
+		palette[3] = 0;
+		for (uint32 shift = 0; shift < 32; shift += 8)
+		{
+			const uint32 a = (c0 >> shift) & 0xFF;
+			const uint32 b = (c1 >> shift) & 0xFF;
+			if (fourColor)
+			{
+				palette[2] |= ((2 * a + b + 1) / 3) << shift;
+				palette[3] |= ((a + 2 * b + 1) / 3) << shift;
+			}
+			else
+				palette[2] |= ((a + b + 1) >> 1) << shift;
+		}
+#endif
+	}
+
+	// The eight BC3 alpha values, rounded.  Weights are on a scale of 7 in the six value
+	// mode and of 5 in the four value one, whose last two entries are 0 and 255.
+	void AlphaPalette(uint32 a0, uint32 a1, uint8* palette)
+	{
+		const bool sixValues = a0 > a1;
+#if BC_DECODER_SSE2
+		__m128i weighted;
+		if (sixValues)
+		{
+			weighted = _mm_add_epi16(
+				_mm_mullo_epi16(_mm_set1_epi16((short)a0), _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+				_mm_mullo_epi16(_mm_set1_epi16((short)a1), _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+			// x * 9363 >> 16 is x / 7 for x < 1792.
+			weighted = _mm_mulhi_epu16(_mm_add_epi16(weighted, _mm_set1_epi16(3)), _mm_set1_epi16(9363));
+		}
+		else
+		{
+			weighted = _mm_add_epi16(
+				_mm_mullo_epi16(_mm_set1_epi16((short)a0), _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+				_mm_mullo_epi16(_mm_set1_epi16((short)a1), _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+			// x * 13108 >> 16 is x / 5 for x < 1280.
+			weighted = _mm_mulhi_epu16(_mm_add_epi16(weighted, _mm_set1_epi16(2)), _mm_set1_epi16(13108));
+			weighted = _mm_or_si128(weighted, _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+		}
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(palette), _mm_packus_epi16(weighted, weighted));
+#else
+		palette[0] = (uint8)a0;
+		palette[1] = (uint8)a1;
+		if (sixValues)
+		{
+			for (uint32 i = 1; i < 7; ++i)
+				palette[i + 1] = (uint8)(((7 - i) * a0 + i * a1 + 3) / 7);
+		}
+		else
+		{
+			for (uint32 i = 1; i < 5; ++i)
+				palette[i + 1] = (uint8)(((5 - i) * a0 + i * a1 + 2) / 5);
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+#endif
+	}
+
+	// The eight BC4 values of one channel as floats.  SNORM endpoints are -127..127 with
+	// -128 read as -127.
+	void ChannelPalette(int32 a0, int32 a1, bool isSigned, float* palette)
+	{
+		// Endpoint weights and the fixed last two entries, six value mode then four value.
+		static const float Weights0[2][8] = { { 7, 0, 6, 5, 4, 3, 2, 1 }, { 5, 0, 4, 3, 2, 1, 0, 0 } };
+		static const float Weights1[2][8] = { { 0, 7, 1, 2, 3, 4, 5, 6 }, { 0, 5, 1, 2, 3, 4, 0, 0 } };
+
+		const uint32 table = a0 > a1 ? 0 : 1;
+		const float scale = (isSigned ? 1.0f / 127.0f : 1.0f / 255.0f) / (table == 0 ? 7.0f : 5.0f);
+		const float low = isSigned ? -1.0f : 0.0f;
+		const float fixed[8] = { 0, 0, 0, 0, 0, 0, table == 0 ? 0.0f : low, table == 0 ? 0.0f : 1.0f };
+#if BC_DECODER_SSE2
+		const __m128 e0 = _mm_set1_ps((float)a0);
+		const __m128 e1 = _mm_set1_ps((float)a1);
+		const __m128 s = _mm_set1_ps(scale);
+		for (uint32 i = 0; i < 8; i += 4)
+		{
+			const __m128 sum = _mm_add_ps(_mm_mul_ps(e0, _mm_loadu_ps(Weights0[table] + i)), _mm_mul_ps(e1, _mm_loadu_ps(Weights1[table] + i)));
+			_mm_storeu_ps(palette + i, _mm_add_ps(_mm_mul_ps(sum, s), _mm_loadu_ps(fixed + i)));
+		}
+#else
+		for (uint32 i = 0; i < 8; ++i)
+			palette[i] = (a0 * Weights0[table][i] + a1 * Weights1[table][i]) * scale + fixed[i];
+#endif
+	}
+
+	// BC7 palette of 'count' (4, 8 or 16) RGBA8 entries: ((64 - w) e0 + w e1 + 32) >> 6
+	// per channel.
+	void InterpolatePalette(uint32 e0, uint32 e1, const uint8* weights, uint32 count, uint32* palette)
+	{
+#if BC_DECODER_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i a = _mm_unpacklo_epi8(_mm_set1_epi32((int)e0), zero);
+		const __m128i b = _mm_unpacklo_epi8(_mm_set1_epi32((int)e1), zero);
+		const __m128i sixtyFour = _mm_set1_epi16(64);
+		const __m128i round = _mm_set1_epi16(32);
+		for (uint32 i = 0; i < count; i += 4)
+		{
+			__m128i mixed[2];
+			for (uint32 j = 0; j < 2; ++j)
+			{
+				const short w0 = weights[i + 2 * j];
+				const short w1 = weights[i + 2 * j + 1];
+				const __m128i w = _mm_setr_epi16(w0, w0, w0, w0, w1, w1, w1, w1);
+				const __m128i sum = _mm_add_epi16(_mm_add_epi16(
+					_mm_mullo_epi16(a, _mm_sub_epi16(sixtyFour, w)), _mm_mullo_epi16(b, w)), round);
+				mixed[j] = _mm_srli_epi16(sum, 6);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(palette + i), _mm_packus_epi16(mixed[0], mixed[1]));
+		}
+#else
+		for (uint32 i = 0; i < count; ++i)
+		{
+			const uint32 w = weights[i];
+			uint32 entry = 0;
+			for (uint32 shift = 0; shift < 32; shift += 8)
+			{
+				const uint32 a = (e0 >> shift) & 0xFF;
+				const uint32 b = (e1 >> shift) & 0xFF;
+				entry |= (((64 - w) * a + w * b + 32) >> 6) << shift;
+			}
+			palette[i] = entry;
+		}
+#endif
+	}
+
+	const float* SrgbToLinearTable()
+	{
+		struct Table
+		{
+			float Values[256];
+			Table()
+			{
+				for (int i = 0; i < 256; ++i)
+				{
+					const float c = i / 255.0f;
+					Values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				}
+			}
+		};
+		static const Table table;
+		return table.Values;
+	}
+
+	void BytesToFloats(const uint8* texels, bool srgb, float* out)
+	{
+		if (srgb)
+		{
+			const float* linear = SrgbToLinearTable();
+			for (uint32 i = 0; i < 64; i += 4)
+			{
+				out[i + 0] = linear[texels[i + 0]];
+				out[i + 1] = linear[texels[i + 1]];
+				out[i + 2] = linear[texels[i + 2]];
+				out[i + 3] = texels[i + 3] * (1.0f / 255.0f);
+			}
+			return;
+		}
+#if BC_DECODER_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+		for (uint32 i = 0; i < 64; i += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(texels + i));
+			const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+			const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_ps(out + i + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+			_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+			_mm_storeu_ps(out + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+			_mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+		}
+#else
+		for (uint32 i = 0; i < 64; ++i)
+			out[i] = texels[i] * (1.0f / 255.0f);
+#endif
+	}
+
+	// saturate(texel * scale + bias) * 255, rounded, with a scale and bias per channel.
+	void FloatsToBytes(const float* texels, const float* scale, const float* bias, uint8* out)
+	{
+#if BC_DECODER_SSE2
+		const __m128 s = _mm_mul_ps(_mm_loadu_ps(scale), _mm_set1_ps(255.0f));
+		const __m128 b = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(bias), _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+		const __m128 low = _mm_setzero_ps();
+		const __m128 high = _mm_set1_ps(255.5f);
+		for (uint32 i = 0; i < 64; i += 16)
+		{
+			__m128i texel[4];
+			for (uint32 j = 0; j < 4; ++j)
+			{
+				const __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(texels + i + 4 * j), s), b);
+				texel[j] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, low), high));
+			}
+			const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(texel[0], texel[1]), _mm_packs_epi32(texel[2], texel[3]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+		}
+#else
+		for (uint32 i = 0; i < 64; ++i)
+		{
+			const float v = texels[i] * (scale[i & 3] * 255.0f) + (bias[i & 3] * 255.0f + 0.5f);
+			out[i] = (uint8)(std::min)((std::max)(v, 0.0f), 255.5f);
+		}
+#endif
+	}
+
+	//-----------------------------------------------------------------------------------
+	// BC1 - BC5
+	//-----------------------------------------------------------------------------------
+
+	void DecodeColorBlock(const uint8* block, bool alwaysFourColor, uint8* texels)
+	{
+		const uint32 c0 = Load16(block);
+		const uint32 c1 = Load16(block + 2);
+		uint32 palette[4];
+		ColorPalette(Expand565(c0), Expand565(c1), alwaysFourColor || c0 > c1, palette);
+
+		const uint32 indices = Load32(block + 4);
+		for (uint32 y = 0; y < 4; ++y)
+		{
+			uint32 row[4];
+			for (uint32 x = 0; x < 4; ++x)
+				row[x] = palette[(indices >> (2 * (4 * y + x))) & 3];
+			std::memcpy(texels + 16 * y, row, 16);
+		}
+	}
+
+	void DecodeBC2(const uint8* block, uint8* texels)
+	{
+		DecodeColorBlock(block + 8, true, texels);
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			const uint32 alpha = (block[i / 2] >> (4 * (i & 1))) & 15;
+			texels[4 * i + 3] = (uint8)(alpha * 17);
+		}
+	}
+
+	void DecodeBC3(const uint8* block, uint8* texels)
+	{
+		DecodeColorBlock(block + 8, true, texels);
+		uint8 palette[8];
+		AlphaPalette(block[0], block[1], palette);
+		const uint64 indices = Load48(block + 2);
+		for (uint32 i = 0; i < 16; ++i)
+			texels[4 * i + 3] = palette[(indices >> (3 * i)) & 7];
+	}
+
+	// One BC4 channel into 'channel' of float RGBA texels.
+	void DecodeChannelBlock(const uint8* block, bool isSigned, uint32 channel, float* texels)
+	{
+		int32 a0 = block[0];
+		int32 a1 = block[1];
+		if (isSigned)
+		{
+			a0 = (std::max)((int32)(std::int8_t)block[0], -127);
+			a1 = (std::max)((int32)(std::int8_t)block[1], -127);
+		}
+		float palette[8];
+		ChannelPalette(a0, a1, isSigned, palette);
+		const uint64 indices = Load48(block + 2);
+		for (uint32 i = 0; i < 16; ++i)
+			texels[4 * i + channel] = palette[(indices >> (3 * i)) & 7];
+	}
+
+	void DecodeBC4(const uint8* block, bool isSigned, float* texels)
+	{
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			texels[4 * i + 1] = 0.0f;
+			texels[4 * i + 2] = 0.0f;
+			texels[4 * i + 3] = 1.0f;
+		}
+		DecodeChannelBlock(block, isSigned, 0, texels);
+	}
+
+	void DecodeBC5(const uint8* block, bool isSigned, float* texels)
+	{
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			texels[4 * i + 2] = 0.0f;
+			texels[4 * i + 3] = 1.0f;
+		}
+		DecodeChannelBlock(block, isSigned, 0, texels);
+		DecodeChannelBlock(block + 8, isSigned, 1, texels);
+	}
+
+	//-----------------------------------------------------------------------------------
+	// BC7
+	//-----------------------------------------------------------------------------------
+
+	struct Bc7Mode
+	{
+		uint8 Subsets;
+		uint8 PartitionBits;
+		uint8 RotationBits;
+		uint8 IndexSelectionBits;
+		uint8 ColorBits;
+		uint8 AlphaBits;
+		uint8 EndpointPBits;
+		uint8 SharedPBits;
+		uint8 IndexBits;
+		uint8 SecondaryIndexBits;
+	};
+
+	const Bc7Mode Bc7Modes[8] =
+	{
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+
+	void DecodeBC7(const uint8* block, uint8* texels)
+	{
+		BitReader bits(block);
+		uint32 modeIndex = 0;
+		while (modeIndex < 8 && bits.Read(1) == 0)
+			++modeIndex;
+		if (modeIndex == 8)
+		{
+			// Reserved: transparent black.
+			std::memset(texels, 0, 64);
+			return;
+		}
+		const Bc7Mode& mode = Bc7Modes[modeIndex];
+
+		const uint32 partition = bits.Read(mode.PartitionBits);
+		const uint32 rotation = bits.Read(mode.RotationBits);
+		const uint32 indexSelection = bits.Read(mode.IndexSelectionBits);
+
+		// Endpoints are stored a channel at a time, then their p-bits.
+		const uint32 endpointCount = 2u * mode.Subsets;
+		uint32 endpoints[6][4];
+		for (uint32 c = 0; c < 3; ++c)
+			for (uint32 e = 0; e < endpointCount; ++e)
+				endpoints[e][c] = bits.Read(mode.ColorBits);
+		for (uint32 e = 0; e < endpointCount; ++e)
+			endpoints[e][3] = mode.AlphaBits ? bits.Read(mode.AlphaBits) : 255;
+
+		uint32 colorBits = mode.ColorBits;
+		uint32 alphaBits = mode.AlphaBits;
+		if (mode.EndpointPBits || mode.SharedPBits)
+		{
+			uint32 pBits[6];
+			if (mode.EndpointPBits)
+			{
+				for (uint32 e = 0; e < endpointCount; ++e)
+					pBits[e] = bits.Read(1);
+			}
+			else
+			{
+				for (uint32 s = 0; s < mode.Subsets; ++s)
+					pBits[2 * s] = pBits[2 * s + 1] = bits.Read(1);
+			}
+			for (uint32 e = 0; e < endpointCount; ++e)
+			{
+				for (uint32 c = 0; c < 3; ++c)
+					endpoints[e][c] = (endpoints[e][c] << 1) | pBits[e];
+				if (mode.AlphaBits)
+					endpoints[e][3] = (endpoints[e][3] << 1) | pBits[e];
+			}
+			++colorBits;
+			if (mode.AlphaBits)
+				++alphaBits;
+		}
+
+		// Widen to 8 bits by replicating the high bits.
+		uint32 packed[6];
+		for (uint32 e = 0; e < endpointCount; ++e)
+		{
+			for (uint32 c = 0; c < 3; ++c)
+				endpoints[e][c] = (endpoints[e][c] << (8 - colorBits)) | (endpoints[e][c] >> (2 * colorBits - 8));
+			if (mode.AlphaBits)
+				endpoints[e][3] = (endpoints[e][3] << (8 - alphaBits)) | (endpoints[e][3] >> (2 * alphaBits - 8));
+			packed[e] = endpoints[e][0] | (endpoints[e][1] << 8) | (endpoints[e][2] << 16) | (endpoints[e][3] << 24);
+		}
+
+		uint8 subsetOf[16] = {};
+		uint32 anchors[3] = { 0, 0, 0 };
+		if (mode.Subsets == 2)
+		{
+			for (uint32 i = 0; i < 16; ++i)
+				subsetOf[i] = (Partitions2[partition] >> i) & 1;
+			anchors[1] = Anchors2[partition];
+		}
+		else if (mode.Subsets == 3)
+		{
+			std::memcpy(subsetOf, Partitions3[partition], 16);
+			anchors[1] = Anchors3First[partition];
+			anchors[2] = Anchors3Second[partition];
+		}
+
+		uint8 indices[16];
+		for (uint32 i = 0; i < 16; ++i)
+			indices[i] = (uint8)bits.Read(mode.IndexBits - (i == anchors[subsetOf[i]] ? 1 : 0));
+
+		uint32 palette[3][16];
+		if (mode.SecondaryIndexBits == 0)
+		{
+			const uint32 count = 1u << mode.IndexBits;
+			for (uint32 s = 0; s < mode.Subsets; ++s)
+				InterpolatePalette(packed[2 * s], packed[2 * s + 1], WeightTable(mode.IndexBits), count, palette[s]);
+
+			for (uint32 i = 0; i < 16; ++i)
+				std::memcpy(texels + 4 * i, &palette[subsetOf[i]][indices[i]], 4);
+			return;
+		}
+
+		// Modes 4 and 5: colour and alpha have their own indices, and the index selection
+		// bit swaps which set each one uses.
+		uint8 secondary[16];
+		for (uint32 i = 0; i < 16; ++i)
+			secondary[i] = (uint8)bits.Read(mode.SecondaryIndexBits - (i == 0 ? 1 : 0));
+
+		const uint8* colorIndices = indexSelection ? secondary : indices;
+		const uint8* alphaIndices = indexSelection ? indices : secondary;
+		const uint32 colorIndexBits = indexSelection ? mode.SecondaryIndexBits : mode.IndexBits;
+		const uint32 alphaIndexBits = indexSelection ? mode.IndexBits : mode.SecondaryIndexBits;
+		InterpolatePalette(packed[0], packed[1], WeightTable(colorIndexBits), 1u << colorIndexBits, palette[0]);
+		InterpolatePalette(packed[0], packed[1], WeightTable(alphaIndexBits), 1u << alphaIndexBits, palette[1]);
+
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			const uint32 texel = (palette[0][colorIndices[i]] & 0x00FFFFFFu) | (palette[1][alphaIndices[i]] & 0xFF000000u);
+			std::memcpy(texels + 4 * i, &texel, 4);
+			if (rotation != 0)
+				std::swap(texels[4 * i + 3], texels[4 * i + rotation - 1]);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	// BC6H
+	//-----------------------------------------------------------------------------------
+
+	// Endpoint fields of the BC6H header; endpoint = field / 3, channel = field % 3.
+	enum Bc6Field : uint8 { R0, G0, B0, R1, G1, B1, R2, G2, B2, R3, G3, B3, D };
+
+	// Consecutive header bits go into one field, the first into bit 'From' and the rest
+	// towards bit 'To'.  A few modes store the high bits of the base endpoint reversed.
+	struct Bc6Segment
+	{
+		Bc6Field Field;
+		uint8 From;
+		uint8 To;
+	};
+
+	struct Bc6Mode
+	{
+		uint32 Code;
+		uint32 Regions;
+		bool Transformed;
+		uint32 EndpointBits;
+		uint32 DeltaBits[3];
+		const Bc6Segment* Layout;
+		uint32 LayoutSize;
+	};
+
+	const Bc6Segment Bc6Layout1[] =
+	{
+		{ G2, 4, 4 }, { B2, 4, 4 }, { B3, 4, 4 }, { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 4 },
+		{ G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 },
+		{ B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 }, { D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout2[] =
+	{
+		{ G2, 5, 5 }, { G3, 4, 4 }, { G3, 5, 5 }, { R0, 0, 6 }, { B3, 0, 0 }, { B3, 1, 1 }, { B2, 4, 4 },
+		{ G0, 0, 6 }, { B2, 5, 5 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 6 }, { B3, 3, 3 }, { B3, 5, 5 },
+		{ B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 5 }, { G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 },
+		{ R2, 0, 5 }, { R3, 0, 5 }, { D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout3[] =
+	{
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 4 }, { R0, 10, 10 }, { G2, 0, 3 }, { G1, 0, 3 },
+		{ G0, 10, 10 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 3 }, { B0, 10, 10 }, { B3, 1, 1 }, { B2, 0, 3 },
+		{ R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 }, { D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout4[] =
+	{
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 10, 10 }, { G3, 4, 4 }, { G2, 0, 3 },
+		{ G1, 0, 4 }, { G0, 10, 10 }, { G3, 0, 3 }, { B1, 0, 3 }, { B0, 10, 10 }, { B3, 1, 1 }, { B2, 0, 3 },
+		{ R2, 0, 3 }, { B3, 0, 0 }, { B3, 2, 2 }, { R3, 0, 3 }, { G2, 4, 4 }, { B3, 3, 3 }, { D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout5[] =
+	{
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 10, 10 }, { B2, 4, 4 }, { G2, 0, 3 },
+		{ G1, 0, 3 }, { G0, 10, 10 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B0, 10, 10 }, { B2, 0, 3 },
+		{ R2, 0, 3 }, { B3, 1, 1 }, { B3, 2, 2 }, { R3, 0, 3 }, { B3, 4, 4 }, { B3, 3, 3 }, { D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout6[] =
+	{
+		{ R0, 0, 8 }, { B2, 4, 4 }, { G0, 0, 8 }, { G2, 4, 4 }, { B0, 0, 8 }, { B3, 4, 4 }, { R1, 0, 4 },
+		{ G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 },
+		{ B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 }, { D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout7[] =
+	{
+		{ R0, 0, 7 }, { G3, 4, 4 }, { B2, 4, 4 }, { G0, 0, 7 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 7 },
+		{ B3, 3, 3 }, { B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 },
+		{ B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 }, { D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout8[] =
+	{
+		{ R0, 0, 7 }, { B3, 0, 0 }, { B2, 4, 4 }, { G0, 0, 7 }, { G2, 5, 5 }, { G2, 4, 4 }, { B0, 0, 7 },
+		{ G3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 5 }, { G3, 0, 3 },
+		{ B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 },
+		{ D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout9[] =
+	{
+		{ R0, 0, 7 }, { B3, 1, 1 }, { B2, 4, 4 }, { G0, 0, 7 }, { B2, 5, 5 }, { G2, 4, 4 }, { B0, 0, 7 },
+		{ B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 },
+		{ G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 },
+		{ D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout10[] =
+	{
+		{ R0, 0, 5 }, { G3, 4, 4 }, { B3, 0, 0 }, { B3, 1, 1 }, { B2, 4, 4 }, { G0, 0, 5 }, { G2, 5, 5 },
+		{ B2, 5, 5 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 5 }, { G3, 5, 5 }, { B3, 3, 3 }, { B3, 5, 5 },
+		{ B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 5 }, { G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 },
+		{ R2, 0, 5 }, { R3, 0, 5 }, { D, 0, 4 }
+	};
+	const Bc6Segment Bc6Layout11[] =
+	{
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 9 }, { G1, 0, 9 }, { B1, 0, 9 }
+	};
+	const Bc6Segment Bc6Layout12[] =
+	{
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 8 }, { R0, 10, 10 }, { G1, 0, 8 }, { G0, 10, 10 },
+		{ B1, 0, 8 }, { B0, 10, 10 }
+	};
+	const Bc6Segment Bc6Layout13[] =
+	{
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 7 }, { R0, 11, 10 }, { G1, 0, 7 }, { G0, 11, 10 },
+		{ B1, 0, 7 }, { B0, 11, 10 }
+	};
+	const Bc6Segment Bc6Layout14[] =
+	{
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 15, 10 }, { G1, 0, 3 }, { G0, 15, 10 },
+		{ B1, 0, 3 }, { B0, 15, 10 }
+	};
+
+#define BC6_LAYOUT(layout) layout, sizeof(layout) / sizeof(layout[0])
+	const Bc6Mode Bc6Modes[14] =
+	{
+		{ 0x00, 2, true, 10, { 5, 5, 5 }, BC6_LAYOUT(Bc6Layout1) },
+		{ 0x01, 2, true, 7, { 6, 6, 6 }, BC6_LAYOUT(Bc6Layout2) },
+		{ 0x02, 2, true, 11, { 5, 4, 4 }, BC6_LAYOUT(Bc6Layout3) },
+		{ 0x06, 2, true, 11, { 4, 5, 4 }, BC6_LAYOUT(Bc6Layout4) },
+		{ 0x0A, 2, true, 11, { 4, 4, 5 }, BC6_LAYOUT(Bc6Layout5) },
+		{ 0x0E, 2, true, 9, { 5, 5, 5 }, BC6_LAYOUT(Bc6Layout6) },
+		{ 0x12, 2, true, 8, { 6, 5, 5 }, BC6_LAYOUT(Bc6Layout7) },
+		{ 0x16, 2, true, 8, { 5, 6, 5 }, BC6_LAYOUT(Bc6Layout8) },
+		{ 0x1A, 2, true, 8, { 5, 5, 6 }, BC6_LAYOUT(Bc6Layout9) },
+		{ 0x1E, 2, false, 6, { 6, 6, 6 }, BC6_LAYOUT(Bc6Layout10) },
+		{ 0x03, 1, false, 10, { 10, 10, 10 }, BC6_LAYOUT(Bc6Layout11) },
+		{ 0x07, 1, true, 11, { 9, 9, 9 }, BC6_LAYOUT(Bc6Layout12) },
+		{ 0x0B, 1, true, 12, { 8, 8, 8 }, BC6_LAYOUT(Bc6Layout13) },
+		{ 0x0F, 1, true, 16, { 4, 4, 4 }, BC6_LAYOUT(Bc6Layout14) }
+	};
+#undef BC6_LAYOUT
+
+	int32 SignExtend(uint32 value, uint32 bits)
+	{
+		const uint32 sign = 1u << (bits - 1);
+		value &= (1u << bits) - 1;
+		return (int32)(value ^ sign) - (int32)sign;
+	}
+
+	// Endpoint to the 16 bit range interpolation works in.
+	int32 Unquantize(int32 value, uint32 bits, bool isSigned)
+	{
+		if (!isSigned)
+		{
+			if (bits >= 15 || value == 0)
+				return value;
+			if (value == (1 << bits) - 1)
+				return 0xFFFF;
+			return ((value << 16) + 0x8000) >> bits;
+		}
+
+		if (bits >= 16)
+			return value;
+		const bool negative = value < 0;
+		if (negative)
+			value = -value;
+		int32 result;
+		if (value == 0)
+			result = 0;
+		else if (value >= (1 << (bits - 1)) - 1)
+			result = 0x7FFF;
+		else
+			result = ((value << 15) + 0x4000) >> (bits - 1);
+		return negative ? -result : result;
+	}
+
+	// Half float bit patterns to floats.  Shifting the exponent and mantissa into place and
+	// scaling by 2^112 rebiases the exponent, and handles denormals exactly; BC6H never
+	// produces infinities or NaNs, which this would get wrong.
+	void HalvesToFloats(const uint32* halves, float* out)
+	{
+		const float rebias = 5.192296858534828e+33f; // 2^112
+#if BC_DECODER_SSE2
+		const __m128i magnitude = _mm_set1_epi32(0x7FFF);
+		const __m128i sign = _mm_set1_epi32(0x8000);
+		const __m128 scale = _mm_set1_ps(rebias);
+		for (uint32 i = 0; i < 64; i += 4)
+		{
+			const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i));
+			const __m128 value = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, magnitude), 13)), scale);
+			const __m128 signBit = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, sign), 16));
+			_mm_storeu_ps(out + i, _mm_or_ps(value, signBit));
+		}
+#else
+		for (uint32 i = 0; i < 64; ++i)
+		{
+			const uint32 bits = (halves[i] & 0x7FFF) << 13;
+			float value;
+			std::memcpy(&value, &bits, 4);
+			value *= rebias;
+			out[i] = (halves[i] & 0x8000) ? -value : value;
+		}
+#endif
+	}
+
+	void DecodeBC6H(const uint8* block, bool isSigned, float* texels)
+	{
+		BitReader bits(block);
+		uint32 code = bits.Read(2);
+		if (code > 1)
+			code |= bits.Read(3) << 2;
+
+		const Bc6Mode* mode = nullptr;
+		for (const Bc6Mode& m : Bc6Modes)
+		{
+			if (m.Code == code)
+			{
+				mode = &m;
+				break;
+			}
+		}
+		if (mode == nullptr)
+		{
+			// Reserved: black.
+			for (uint32 i = 0; i < 64; ++i)
+				texels[i] = (i & 3) == 3 ? 1.0f : 0.0f;
+			return;
+		}
+
+		uint32 fields[13] = {};
+		for (uint32 s = 0; s < mode->LayoutSize; ++s)
+		{
+			const Bc6Segment& segment = mode->Layout[s];
+			if (segment.From <= segment.To)
+				fields[segment.Field] |= bits.Read(segment.To - segment.From + 1u) << segment.From;
+			else
+			{
+				for (int32 bit = segment.From; bit >= segment.To; --bit)
+					fields[segment.Field] |= bits.Read(1) << bit;
+			}
+		}
+
+		const uint32 endpointCount = mode->Regions * 2;
+		const uint32 mask = (1u << mode->EndpointBits) - 1;
+		int32 endpoints[4][3];
+		for (uint32 c = 0; c < 3; ++c)
+		{
+			const uint32 base = fields[c];
+			endpoints[0][c] = isSigned ? SignExtend(base, mode->EndpointBits) : (int32)base;
+			for (uint32 e = 1; e < endpointCount; ++e)
+			{
+				uint32 value = fields[3 * e + c];
+				if (mode->Transformed)
+					value = (base + (uint32)SignExtend(value, mode->DeltaBits[c])) & mask;
+				endpoints[e][c] = isSigned ? SignExtend(value, mode->EndpointBits) : (int32)value;
+			}
+		}
+		for (uint32 e = 0; e < endpointCount; ++e)
+			for (uint32 c = 0; c < 3; ++c)
+				endpoints[e][c] = Unquantize(endpoints[e][c], mode->EndpointBits, isSigned);
+
+		// Palette of half float bit patterns per region.  Interpolated endpoints are scaled
+		// by 31/32 (31/64 unsigned) into half floats.
+		const uint32 indexBits = mode->Regions == 2 ? 3 : 4;
+		const uint32 entries = 1u << indexBits;
+		const uint8* weights = WeightTable(indexBits);
+		uint32 palette[2][16][3];
+		for (uint32 r = 0; r < mode->Regions; ++r)
+		{
+			const int32* e0 = endpoints[2 * r];
+			const int32* e1 = endpoints[2 * r + 1];
+			for (uint32 k = 0; k < entries; ++k)
+			{
+				const int32 w = weights[k];
+				for (uint32 c = 0; c < 3; ++c)
+				{
+					const int32 value = ((64 - w) * e0[c] + w * e1[c] + 32) >> 6;
+					if (!isSigned)
+						palette[r][k][c] = (uint32)((value * 31) >> 6);
+					else if (value < 0)
+						palette[r][k][c] = 0x8000u | (uint32)(((-value) * 31) >> 5);
+					else
+						palette[r][k][c] = (uint32)((value * 31) >> 5);
+				}
+			}
+		}
+
+		// The indices fill the rest of the block, past bit 64 in every mode.
+		const uint32 partition = fields[D];
+		const uint32 regions = mode->Regions == 2 ? Partitions2[partition] : 0;
+		const uint32 anchor = mode->Regions == 2 ? Anchors2[partition] : 0;
+		uint64 indices = bits.ReadRest();
+		uint32 halves[64];
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			const uint32 count = indexBits - ((i == 0 || i == anchor) ? 1 : 0);
+			const uint32* entry = palette[(regions >> i) & 1][indices & ((1u << count) - 1)];
+			indices >>= count;
+			halves[4 * i + 0] = entry[0];
+			halves[4 * i + 1] = entry[1];
+			halves[4 * i + 2] = entry[2];
+			halves[4 * i + 3] = 0x3C00; // 1.0
+		}
+		HalvesToFloats(halves, texels);
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Blocks and surfaces
+	//-----------------------------------------------------------------------------------
+
+	void DecodeNative(const FormatInfo& info, const uint8* block, uint8* texels)
+	{
+		switch (info.Kind)
+		{
+		case Family::BC1: DecodeColorBlock(block, false, texels); break;
+		case Family::BC2: DecodeBC2(block, texels); break;
+		case Family::BC3: DecodeBC3(block, texels); break;
+		default:          DecodeBC7(block, texels); break;
+		}
+	}
+
+	void DecodeNative(const FormatInfo& info, const uint8* block, float* texels)
+	{
+		switch (info.Kind)
+		{
+		case Family::BC4: DecodeBC4(block, info.Signed, texels); break;
+		case Family::BC5: DecodeBC5(block, info.Signed, texels); break;
+		default:          DecodeBC6H(block, info.Signed, texels); break;
+		}
+	}
+
+	void DecodeAs(const FormatInfo& info, const uint8* block, uint8* texels)
+	{
+		if (DecodesToBytes(info.Kind))
+		{
+			DecodeNative(info, block, texels);
+			return;
+		}
+
+		// Channels BC4 and BC5 lack become 0 and 255; SNORM ones map [-1, 1] to [0, 255].
+		static const float Scale[3][4] = { { 1, 1, 1, 1 }, { 0.5f, 0, 0, 0 }, { 0.5f, 0.5f, 0, 0 } };
+		static const float Bias[3][4] = { { 0, 0, 0, 0 }, { 0.5f, 0, 0, 1 }, { 0.5f, 0.5f, 0, 1 } };
+		const uint32 mapping = !info.Signed || info.Kind == Family::BC6H ? 0 : info.Kind == Family::BC4 ? 1 : 2;
+
+		float decoded[64];
+		DecodeNative(info, block, decoded);
+		FloatsToBytes(decoded, Scale[mapping], Bias[mapping], texels);
+	}
+
+	void DecodeAs(const FormatInfo& info, const uint8* block, float* texels)
+	{
+		if (!DecodesToBytes(info.Kind))
+		{
+			DecodeNative(info, block, texels);
+			return;
+		}
+
+		uint8 decoded[64];
+		DecodeNative(info, block, decoded);
+		BytesToFloats(decoded, info.Srgb, texels);
+	}
+
+	// Calls rowRange(first, last) over [0, blockRows), on 'jobs' when given, a few rows
+	// at a time so threads that finish early take more.
+	template<typename Function>
+	void ForEachBlockRow(uint32 blockRows, JobSystem* jobs, const Function& rowRange)
+	{
+		if (jobs == nullptr)
+		{
+			rowRange(0u, blockRows);
+			return;
+		}
+
+		const uint32 rowsPerJob = (std::max)(1u, blockRows / ((jobs->WorkerCount() + 1) * 8));
+		jobs->ParallelFor(blockRows, rowsPerJob, rowRange);
+	}
+
+	template<typename Texel>
+	bool DecodeSurface(DXGI_FORMAT format, const uint8* blocks, std::size_t rowBytes, uint32 width, uint32 height,
+		Texel* output, std::size_t outputPitch, JobSystem* jobs)
+	{
+		FormatInfo info;
+		if (!GetFormatInfo(format, info))
+			return false;
+
+		const std::size_t blockBytes = BlockBytes(info.Kind);
+		const uint32 blocksWide = (width + 3) / 4;
+		const uint32 blockRows = (height + 3) / 4;
+		ForEachBlockRow(blockRows, jobs, [&](uint32 first, uint32 last)
+		{
+			Texel texels[64];
+			for (uint32 by = first; by < last; ++by)
+			{
+				const uint8* row = blocks + by * rowBytes;
+				const uint32 rows = (std::min)(4u, height - by * 4);
+				for (uint32 bx = 0; bx < blocksWide; ++bx)
+				{
+					DecodeAs(info, row + bx * blockBytes, texels);
+
+					// Partial blocks at the right and bottom edges are clipped.
+					const uint32 columns = (std::min)(4u, width - bx * 4);
+					for (uint32 y = 0; y < rows; ++y)
+					{
+						uint8* dst = reinterpret_cast<uint8*>(output) + (by * 4 + y) * outputPitch;
+						std::memcpy(reinterpret_cast<Texel*>(dst) + bx * 16, texels + y * 16, columns * 4 * sizeof(Texel));
+					}
+				}
+			}
+		});
+		return true;
+	}
+
+	template<typename Texel>
+	bool DecodeSubresource(DXGI_FORMAT format, const DDSReader::Subresource& subresource,
+		std::vector<Texel>& output, JobSystem* jobs)
+	{
+		if (!IsSupported(format))
+			return false;
+
+		// Volume slices are stacked one after another.
+		const std::size_t pitch = subresource.Width * 4 * sizeof(Texel);
+		const std::size_t sliceTexels = subresource.Width * subresource.Height * 4;
+		output.resize(sliceTexels * subresource.Depth);
+		for (std::size_t z = 0; z < subresource.Depth; ++z)
+		{
+			DecodeSurface(format, subresource.Data + z * subresource.SliceBytes, subresource.RowBytes,
+				(uint32)subresource.Width, (uint32)subresource.Height, output.data() + z * sliceTexels, pitch, jobs);
+		}
+		return true;
+	}
+}
+
+bool IsSupported(DXGI_FORMAT format)
+{
+	FormatInfo info;
+	return GetFormatInfo(format, info);
+}
+
+void DecodeBlock(DXGI_FORMAT format, const std::uint8_t* block, std::uint8_t* texels)
+{
+	FormatInfo info;
+	if (GetFormatInfo(format, info))
+		DecodeAs(info, block, texels);
+	else
+		std::memset(texels, 0, 64);
+}
+
+void DecodeBlock(DXGI_FORMAT format, const std::uint8_t* block, float* texels)
+{
+	FormatInfo info;
+	if (GetFormatInfo(format, info))
+		DecodeAs(info, block, texels);
+	else
+		std::fill(texels, texels + 64, 0.0f);
+}
+
+bool Decode(DXGI_FORMAT format, const std::uint8_t* blocks, std::size_t rowBytes, uint32 width, uint32 height,
+	std::uint8_t* output, std::size_t outputPitch, JobSystem* jobs)
+{
+	return DecodeSurface(format, blocks, rowBytes, width, height, output, outputPitch, jobs);
+}
+
+bool Decode(DXGI_FORMAT format, const std::uint8_t* blocks, std::size_t rowBytes, uint32 width, uint32 height,
+	float* output, std::size_t outputPitch, JobSystem* jobs)
+{
+	return DecodeSurface(format, blocks, rowBytes, width, height, output, outputPitch, jobs);
+}
+
+bool Decode(DXGI_FORMAT format, const DDSReader::Subresource& subresource,
+	std::vector<std::uint8_t>& output, JobSystem* jobs)
+{
+	return DecodeSubresource(format, subresource, output, jobs);
+}
+
+bool Decode(DXGI_FORMAT format, const DDSReader::Subresource& subresource,
+	std::vector<float>& output, JobSystem* jobs)
+{
+	return DecodeSubresource(format, subresource, output, jobs);
+}
+
+}
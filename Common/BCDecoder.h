@@ -0,0 +1,54 @@
+//***************************************************************************************
+// BCDecoder.h
+//
+// CPU decoding of block compressed textures (BC1 - BC7, including BC6H) for code that
+// needs texels on the CPU: environment projection, bakers, previews.  Works on the
+// subresource spans DDSReader hands out.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "DDSReader.h"
+
+class JobSystem;
+
+// Output is RGBA, four channels per texel, in either of two forms:
+//   RGBA8  - BC1/2/3/7 as stored, so sRGB formats stay sRGB encoded.  BC4 and BC5 fill
+//            red (and green) with blue 0 and alpha 255, as they sample on the GPU;
+//            SNORM channels are mapped from [-1, 1] to [0, 255].  BC6H is clamped to
+//            [0, 1].
+//   Float  - linear: sRGB formats are converted to linear (alpha is not), UNORM is in
+//            [0, 1], SNORM in [-1, 1] and BC6H keeps its full half float range.
+//
+// Palettes, interpolation and the conversions between the two forms use SSE2 when the
+// target has it.  Surfaces are split among the jobs of a JobSystem by rows of blocks.
+namespace BCDecoder
+{
+	using uint32 = std::uint32_t;
+
+	// All BC1 - BC7 DXGI formats, TYPELESS ones decoded as UNORM (UF16 for BC6H).
+	bool IsSupported(DXGI_FORMAT format);
+
+	// Decodes one 4x4 block into 16 texels in row order: 64 bytes or 64 floats.
+	// Unsupported formats give transparent black.
+	void DecodeBlock(DXGI_FORMAT format, const std::uint8_t* block, std::uint8_t* texels);
+	void DecodeBlock(DXGI_FORMAT format, const std::uint8_t* block, float* texels);
+
+	// Decodes a 'width' x 'height' surface whose block rows are 'rowBytes' apart into
+	// 'output', 'outputPitch' bytes between texel rows, spread over 'jobs' when given and
+	// on the calling thread otherwise.  Returns false if the format is not supported.
+	bool Decode(DXGI_FORMAT format, const std::uint8_t* blocks, std::size_t rowBytes, uint32 width, uint32 height,
+		std::uint8_t* output, std::size_t outputPitch, JobSystem* jobs = nullptr);
+	bool Decode(DXGI_FORMAT format, const std::uint8_t* blocks, std::size_t rowBytes, uint32 width, uint32 height,
+		float* output, std::size_t outputPitch, JobSystem* jobs = nullptr);
+
+	// Decodes a whole subresource into tightly packed texels.
+	bool Decode(DXGI_FORMAT format, const DDSReader::Subresource& subresource,
+		std::vector<std::uint8_t>& output, JobSystem* jobs = nullptr);
+	bool Decode(DXGI_FORMAT format, const DDSReader::Subresource& subresource,
+		std::vector<float>& output, JobSystem* jobs = nullptr);
+}
@@ -0,0 +1,768 @@
+//***************************************************************************************
+// DDSReader.cpp
+//
+// BitsPerPixel, GetSurfaceInfo and GetDXGIFormat come from DDSTextureLoader.cpp.
+//***************************************************************************************
+
+#include "DDSReader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	// For security purposes DDS metadata larger than the D3D12 hardware requirements is
+	// not trusted (D3D12_REQ_*).
+	const std::uint32_t MaxMipLevels = 15;
+	const std::uint32_t MaxTexture1DDimension = 16384;
+	const std::uint32_t MaxTexture2DDimension = 16384;
+	const std::uint32_t MaxTextureCubeDimension = 16384;
+	const std::uint32_t MaxTexture3DDimension = 2048;
+	const std::uint32_t MaxArraySize = 2048;
+}
+
+//--------------------------------------------------------------------------------------
+// Return the BPP for a particular format
+//--------------------------------------------------------------------------------------
+size_t DDS::BitsPerPixel( DXGI_FORMAT fmt )
+{
+    switch( fmt )
+    {
+    case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32A32_UINT:
+    case DXGI_FORMAT_R32G32B32A32_SINT:
+        return 128;
+
+    case DXGI_FORMAT_R32G32B32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+    case DXGI_FORMAT_R32G32B32_UINT:
+    case DXGI_FORMAT_R32G32B32_SINT:
+        return 96;
+
+    case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R16G16B16A16_UINT:
+    case DXGI_FORMAT_R16G16B16A16_SNORM:
+    case DXGI_FORMAT_R16G16B16A16_SINT:
+    case DXGI_FORMAT_R32G32_TYPELESS:
+    case DXGI_FORMAT_R32G32_FLOAT:
+    case DXGI_FORMAT_R32G32_UINT:
+    case DXGI_FORMAT_R32G32_SINT:
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+    case DXGI_FORMAT_Y416:
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        return 64;
+
+    case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UINT:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_R8G8B8A8_UINT:
+    case DXGI_FORMAT_R8G8B8A8_SNORM:
+    case DXGI_FORMAT_R8G8B8A8_SINT:
+    case DXGI_FORMAT_R16G16_TYPELESS:
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R16G16_UINT:
+    case DXGI_FORMAT_R16G16_SNORM:
+    case DXGI_FORMAT_R16G16_SINT:
+    case DXGI_FORMAT_R32_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_R32_SINT:
+    case DXGI_FORMAT_R24G8_TYPELESS:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+    case DXGI_FORMAT_AYUV:
+    case DXGI_FORMAT_Y410:
+    case DXGI_FORMAT_YUY2:
+        return 32;
+
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+        return 24;
+
+    case DXGI_FORMAT_R8G8_TYPELESS:
+    case DXGI_FORMAT_R8G8_UNORM:
+    case DXGI_FORMAT_R8G8_UINT:
+    case DXGI_FORMAT_R8G8_SNORM:
+    case DXGI_FORMAT_R8G8_SINT:
+    case DXGI_FORMAT_R16_TYPELESS:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_D16_UNORM:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_R16_UINT:
+    case DXGI_FORMAT_R16_SNORM:
+    case DXGI_FORMAT_R16_SINT:
+    case DXGI_FORMAT_B5G6R5_UNORM:
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+    case DXGI_FORMAT_A8P8:
+    case DXGI_FORMAT_B4G4R4A4_UNORM:
+        return 16;
+
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+    case DXGI_FORMAT_NV11:
+        return 12;
+
+    case DXGI_FORMAT_R8_TYPELESS:
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_R8_UINT:
+    case DXGI_FORMAT_R8_SNORM:
+    case DXGI_FORMAT_R8_SINT:
+    case DXGI_FORMAT_A8_UNORM:
+    case DXGI_FORMAT_AI44:
+    case DXGI_FORMAT_IA44:
+    case DXGI_FORMAT_P8:
+        return 8;
+
+    case DXGI_FORMAT_R1_UNORM:
+        return 1;
+
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return 4;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Get surface information for a particular format
+//--------------------------------------------------------------------------------------
+void DDS::GetSurfaceInfo( size_t width,
+                          size_t height,
+                          DXGI_FORMAT fmt,
+                          size_t* outNumBytes,
+                          size_t* outRowBytes,
+                          size_t* outNumRows )
+{
+    size_t numBytes = 0;
+    size_t rowBytes = 0;
+    size_t numRows = 0;
+
+    bool bc = false;
+    bool packed = false;
+    bool planar = false;
+    size_t bpe = 0;
+    switch (fmt)
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        bc=true;
+        bpe = 8;
+        break;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        bc = true;
+        bpe = 16;
+        break;
+
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_YUY2:
+        packed = true;
+        bpe = 4;
+        break;
+
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        packed = true;
+        bpe = 8;
+        break;
+
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+        planar = true;
+        bpe = 2;
+        break;
+
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+        planar = true;
+        bpe = 4;
+        break;
+
+    default:
+        break;
+    }
+
+    if (bc)
+    {
+        size_t numBlocksWide = 0;
+        if (width > 0)
+        {
+            numBlocksWide = std::max<size_t>( 1, (width + 3) / 4 );
+        }
+        size_t numBlocksHigh = 0;
+        if (height > 0)
+        {
+            numBlocksHigh = std::max<size_t>( 1, (height + 3) / 4 );
+        }
+        rowBytes = numBlocksWide * bpe;
+        numRows = numBlocksHigh;
+        numBytes = rowBytes * numBlocksHigh;
+    }
+    else if (packed)
+    {
+        rowBytes = ( ( width + 1 ) >> 1 ) * bpe;
+        numRows = height;
+        numBytes = rowBytes * height;
+    }
+    else if ( fmt == DXGI_FORMAT_NV11 )
+    {
+        rowBytes = ( ( width + 3 ) >> 2 ) * 4;
+        numRows = height * 2; // Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data
+        numBytes = rowBytes * numRows;
+    }
+    else if (planar)
+    {
+        rowBytes = ( ( width + 1 ) >> 1 ) * bpe;
+        numBytes = ( rowBytes * height ) + ( ( rowBytes * height + 1 ) >> 1 );
+        numRows = height + ( ( height + 1 ) >> 1 );
+    }
+    else
+    {
+        size_t bpp = BitsPerPixel( fmt );
+        rowBytes = ( width * bpp + 7 ) / 8; // round up to nearest byte
+        numRows = height;
+        numBytes = rowBytes * height;
+    }
+
+    if (outNumBytes)
+    {
+        *outNumBytes = numBytes;
+    }
+    if (outRowBytes)
+    {
+        *outRowBytes = rowBytes;
+    }
+    if (outNumRows)
+    {
+        *outNumRows = numRows;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+#define ISBITMASK( r,g,b,a ) ( ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a )
+
+DXGI_FORMAT DDS::GetDXGIFormat( const DDS_PIXELFORMAT& ddpf )
+{
+    if (ddpf.flags & DDS_RGB)
+    {
+        // Note that sRGB formats are written using the "DX10" extended header
+
+        switch (ddpf.RGBBitCount)
+        {
+        case 32:
+            if (ISBITMASK(0x000000ff,0x0000ff00,0x00ff0000,0xff000000))
+            {
+                return DXGI_FORMAT_R8G8B8A8_UNORM;
+            }
+
+            if (ISBITMASK(0x00ff0000,0x0000ff00,0x000000ff,0xff000000))
+            {
+                return DXGI_FORMAT_B8G8R8A8_UNORM;
+            }
+
+            if (ISBITMASK(0x00ff0000,0x0000ff00,0x000000ff,0x00000000))
+            {
+                return DXGI_FORMAT_B8G8R8X8_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x000000ff,0x0000ff00,0x00ff0000,0x00000000) aka D3DFMT_X8B8G8R8
+
+            // Note that many common DDS reader/writers (including D3DX) swap the
+            // the RED/BLUE masks for 10:10:10:2 formats. We assume
+            // below that the 'backwards' header mask is being used since it is most
+            // likely written by D3DX. The more robust solution is to use the 'DX10'
+            // header extension and specify the DXGI_FORMAT_R10G10B10A2_UNORM format directly
+
+            // For 'correct' writers, this should be 0x000003ff,0x000ffc00,0x3ff00000 for RGB data
+            if (ISBITMASK(0x3ff00000,0x000ffc00,0x000003ff,0xc0000000))
+            {
+                return DXGI_FORMAT_R10G10B10A2_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x000003ff,0x000ffc00,0x3ff00000,0xc0000000) aka D3DFMT_A2R10G10B10
+
+            if (ISBITMASK(0x0000ffff,0xffff0000,0x00000000,0x00000000))
+            {
+                return DXGI_FORMAT_R16G16_UNORM;
+            }
+
+            if (ISBITMASK(0xffffffff,0x00000000,0x00000000,0x00000000))
+            {
+                // Only 32-bit color channel format in D3D9 was R32F
+                return DXGI_FORMAT_R32_FLOAT; // D3DX writes this out as a FourCC of 114
+            }
+            break;
+
+        case 24:
+            // No 24bpp DXGI formats aka D3DFMT_R8G8B8
+            break;
+
+        case 16:
+            if (ISBITMASK(0x7c00,0x03e0,0x001f,0x8000))
+            {
+                return DXGI_FORMAT_B5G5R5A1_UNORM;
+            }
+            if (ISBITMASK(0xf800,0x07e0,0x001f,0x0000))
+            {
+                return DXGI_FORMAT_B5G6R5_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x7c00,0x03e0,0x001f,0x0000) aka D3DFMT_X1R5G5B5
+
+            if (ISBITMASK(0x0f00,0x00f0,0x000f,0xf000))
+            {
+                return DXGI_FORMAT_B4G4R4A4_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x0f00,0x00f0,0x000f,0x0000) aka D3DFMT_X4R4G4B4
+
+            // No 3:3:2, 3:3:2:8, or paletted DXGI formats aka D3DFMT_A8R3G3B2, D3DFMT_R3G3B2, D3DFMT_P8, D3DFMT_A8P8, etc.
+            break;
+        }
+    }
+    else if (ddpf.flags & DDS_LUMINANCE)
+    {
+        if (8 == ddpf.RGBBitCount)
+        {
+            if (ISBITMASK(0x000000ff,0x00000000,0x00000000,0x00000000))
+            {
+                return DXGI_FORMAT_R8_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+
+            // No DXGI format maps to ISBITMASK(0x0f,0x00,0x00,0xf0) aka D3DFMT_A4L4
+        }
+
+        if (16 == ddpf.RGBBitCount)
+        {
+            if (ISBITMASK(0x0000ffff,0x00000000,0x00000000,0x00000000))
+            {
+                return DXGI_FORMAT_R16_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+            if (ISBITMASK(0x000000ff,0x00000000,0x00000000,0x0000ff00))
+            {
+                return DXGI_FORMAT_R8G8_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+        }
+    }
+    else if (ddpf.flags & DDS_ALPHA)
+    {
+        if (8 == ddpf.RGBBitCount)
+        {
+            return DXGI_FORMAT_A8_UNORM;
+        }
+    }
+    else if (ddpf.flags & DDS_FOURCC)
+    {
+        if (MAKEFOURCC( 'D', 'X', 'T', '1' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC1_UNORM;
+        }
+        if (MAKEFOURCC( 'D', 'X', 'T', '3' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC2_UNORM;
+        }
+        if (MAKEFOURCC( 'D', 'X', 'T', '5' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC3_UNORM;
+        }
+
+        // While pre-multiplied alpha isn't directly supported by the DXGI formats,
+        // they are basically the same as these BC formats so they can be mapped
+        if (MAKEFOURCC( 'D', 'X', 'T', '2' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC2_UNORM;
+        }
+        if (MAKEFOURCC( 'D', 'X', 'T', '4' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC3_UNORM;
+        }
+
+        if (MAKEFOURCC( 'A', 'T', 'I', '1' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_UNORM;
+        }
+        if (MAKEFOURCC( 'B', 'C', '4', 'U' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_UNORM;
+        }
+        if (MAKEFOURCC( 'B', 'C', '4', 'S' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_SNORM;
+        }
+
+        if (MAKEFOURCC( 'A', 'T', 'I', '2' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_UNORM;
+        }
+        if (MAKEFOURCC( 'B', 'C', '5', 'U' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_UNORM;
+        }
+        if (MAKEFOURCC( 'B', 'C', '5', 'S' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_SNORM;
+        }
+
+        // BC6H and BC7 are written using the "DX10" extended header
+
+        if (MAKEFOURCC( 'R', 'G', 'B', 'G' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_R8G8_B8G8_UNORM;
+        }
+        if (MAKEFOURCC( 'G', 'R', 'G', 'B' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_G8R8_G8B8_UNORM;
+        }
+
+        if (MAKEFOURCC('Y','U','Y','2') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_YUY2;
+        }
+
+        // Check for D3DFORMAT enums being set here
+        switch( ddpf.fourCC )
+        {
+        case 36: // D3DFMT_A16B16G16R16
+            return DXGI_FORMAT_R16G16B16A16_UNORM;
+
+        case 110: // D3DFMT_Q16W16V16U16
+            return DXGI_FORMAT_R16G16B16A16_SNORM;
+
+        case 111: // D3DFMT_R16F
+            return DXGI_FORMAT_R16_FLOAT;
+
+        case 112: // D3DFMT_G16R16F
+            return DXGI_FORMAT_R16G16_FLOAT;
+
+        case 113: // D3DFMT_A16B16G16R16F
+            return DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+        case 114: // D3DFMT_R32F
+            return DXGI_FORMAT_R32_FLOAT;
+
+        case 115: // D3DFMT_G32R32F
+            return DXGI_FORMAT_R32G32_FLOAT;
+
+        case 116: // D3DFMT_A32B32G32R32F
+            return DXGI_FORMAT_R32G32B32A32_FLOAT;
+        }
+    }
+
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+bool DDS::IsBlockCompressed(DXGI_FORMAT fmt)
+{
+	return (fmt >= DXGI_FORMAT_BC1_TYPELESS && fmt <= DXGI_FORMAT_BC5_SNORM) ||
+		(fmt >= DXGI_FORMAT_BC6H_TYPELESS && fmt <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+bool DDS::IsPackedOrPlanar(DXGI_FORMAT fmt)
+{
+	switch (fmt)
+	{
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_YUY2:
+	case DXGI_FORMAT_Y210:
+	case DXGI_FORMAT_Y216:
+	case DXGI_FORMAT_NV12:
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016:
+	case DXGI_FORMAT_420_OPAQUE:
+	case DXGI_FORMAT_NV11:
+	case DXGI_FORMAT_P208:
+	case DXGI_FORMAT_V208:
+	case DXGI_FORMAT_V408:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool DDSReader::Open(const std::string& path, std::string* error)
+{
+	Close();
+	if (!mFile.Open(path))
+		return Fail(error, "cannot map the file");
+	return Validate(mFile.Data(), mFile.Size(), error);
+}
+
+bool DDSReader::Parse(const void* data, std::size_t size, std::string* error)
+{
+	Close();
+	return Validate(static_cast<const std::uint8_t*>(data), size, error);
+}
+
+void DDSReader::Close()
+{
+	mFile.Close();
+	mHeader = nullptr;
+	mBitData = nullptr;
+	mBitSize = 0;
+	mDimension = Dimension::Texture2D;
+	mFormat = DXGI_FORMAT_UNKNOWN;
+	mWidth = mHeight = mDepth = 0;
+	mMipCount = mArraySize = 0;
+	mCube = false;
+	mSubresources.clear();
+}
+
+bool DDSReader::Fail(std::string* error, const char* reason)
+{
+	if (error)
+		*error = reason;
+	Close();
+	return false;
+}
+
+bool DDSReader::Validate(const std::uint8_t* data, std::size_t size, std::string* error)
+{
+	if (data == nullptr || size < sizeof(std::uint32_t) + sizeof(DDS_HEADER))
+		return Fail(error, "too small for a DDS header");
+
+	std::uint32_t magic = 0;
+	std::memcpy(&magic, data, sizeof(magic));
+	if (magic != DDS_MAGIC)
+		return Fail(error, "not a DDS file");
+
+	auto header = reinterpret_cast<const DDS_HEADER*>(data + sizeof(std::uint32_t));
+	if (header->size != sizeof(DDS_HEADER) || header->ddspf.size != sizeof(DDS_PIXELFORMAT))
+		return Fail(error, "bad header size");
+
+	std::size_t offset = sizeof(std::uint32_t) + sizeof(DDS_HEADER);
+	std::uint32_t width = header->width;
+	std::uint32_t height = header->height;
+	std::uint32_t depth = 1;
+	std::uint32_t mipCount = (std::max)(header->mipMapCount, 1u);
+	std::uint32_t arraySize = 1;
+	Dimension dimension = Dimension::Texture2D;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	bool cube = false;
+
+	if ((header->ddspf.flags & DDS_FOURCC) && MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC)
+	{
+		if (size - offset < sizeof(DDS_HEADER_DXT10))
+			return Fail(error, "truncated DX10 header");
+		auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>(data + offset);
+		offset += sizeof(DDS_HEADER_DXT10);
+
+		format = d3d10ext->dxgiFormat;
+		arraySize = d3d10ext->arraySize;
+		if (arraySize == 0)
+			return Fail(error, "array size of 0");
+
+		switch (d3d10ext->resourceDimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:
+			if ((header->flags & DDS_HEIGHT) && height != 1)
+				return Fail(error, "1D texture with a height");
+			dimension = Dimension::Texture1D;
+			height = 1;
+			break;
+
+		case DDS_DIMENSION_TEXTURE2D:
+			cube = (d3d10ext->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+			break;
+
+		case DDS_DIMENSION_TEXTURE3D:
+			if (!(header->flags & DDS_HEADER_FLAGS_VOLUME))
+				return Fail(error, "3D texture without the volume flag");
+			if (arraySize > 1)
+				return Fail(error, "3D texture arrays are not supported");
+			dimension = Dimension::Texture3D;
+			depth = header->depth;
+			break;
+
+		default:
+			return Fail(error, "unknown resource dimension");
+		}
+	}
+	else
+	{
+		format = DDS::GetDXGIFormat(header->ddspf);
+
+		if (header->flags & DDS_HEADER_FLAGS_VOLUME)
+		{
+			dimension = Dimension::Texture3D;
+			depth = header->depth;
+		}
+		else if (header->caps2 & DDS_CUBEMAP)
+		{
+			if ((header->caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+				return Fail(error, "partial cube maps are not supported");
+			cube = true;
+		}
+	}
+
+	switch (format)
+	{
+	case DXGI_FORMAT_AI44:
+	case DXGI_FORMAT_IA44:
+	case DXGI_FORMAT_P8:
+	case DXGI_FORMAT_A8P8:
+		return Fail(error, "palettized formats are not supported");
+
+	default:
+		if (DDS::BitsPerPixel(format) == 0)
+			return Fail(error, "unsupported format");
+	}
+
+	if (width == 0 || height == 0 || depth == 0)
+		return Fail(error, "zero dimension");
+	if (mipCount > MaxMipLevels)
+		return Fail(error, "too many mips");
+
+	switch (dimension)
+	{
+	case Dimension::Texture1D:
+		if (width > MaxTexture1DDimension || arraySize > MaxArraySize)
+			return Fail(error, "dimensions over the D3D12 limits");
+		break;
+
+	case Dimension::Texture2D:
+		if (cube)
+		{
+			// The limit is on the faces of all cubes together.
+			if (width != height)
+				return Fail(error, "cube map faces are not square");
+			if (width > MaxTextureCubeDimension || arraySize > MaxArraySize / 6)
+				return Fail(error, "dimensions over the D3D12 limits");
+			arraySize *= 6;
+		}
+		else if (width > MaxTexture2DDimension || height > MaxTexture2DDimension || arraySize > MaxArraySize)
+		{
+			return Fail(error, "dimensions over the D3D12 limits");
+		}
+		break;
+
+	case Dimension::Texture3D:
+		if (width > MaxTexture3DDimension || height > MaxTexture3DDimension || depth > MaxTexture3DDimension)
+			return Fail(error, "dimensions over the D3D12 limits");
+		break;
+	}
+
+	if (((std::max)((std::max)(width, height), depth) >> (mipCount - 1)) == 0)
+		return Fail(error, "more mips than the full chain");
+
+	// Items one after another, each with all of its mips.
+	mSubresources.resize((std::size_t)mipCount * arraySize);
+	const std::uint8_t* bits = data + offset;
+	std::size_t remaining = size - offset;
+	for (std::uint32_t item = 0; item < arraySize; ++item)
+	{
+		std::size_t w = width;
+		std::size_t h = height;
+		std::size_t d = depth;
+		for (std::uint32_t mip = 0; mip < mipCount; ++mip)
+		{
+			std::size_t numBytes = 0;
+			std::size_t rowBytes = 0;
+			std::size_t numRows = 0;
+			DDS::GetSurfaceInfo(w, h, format, &numBytes, &rowBytes, &numRows);
+
+			// rowBytes * numRows bounds numBytes; where size_t is 32 bits numBytes may
+			// have wrapped unless that fits.
+			if ((std::uint64_t)rowBytes * numRows > SIZE_MAX || (std::uint64_t)numBytes * d > remaining)
+				return Fail(error, "truncated pixel data");
+			const std::size_t bytes = numBytes * d;
+
+			Subresource& subresource = mSubresources[mip + (std::size_t)item * mipCount];
+			subresource.Data = bits;
+			subresource.Width = w;
+			subresource.Height = h;
+			subresource.Depth = d;
+			subresource.RowBytes = rowBytes;
+			subresource.RowCount = numRows;
+			subresource.SliceBytes = numBytes;
+
+			bits += bytes;
+			remaining -= bytes;
+			w = (std::max)(w / 2, (std::size_t)1);
+			h = (std::max)(h / 2, (std::size_t)1);
+			d = (std::max)(d / 2, (std::size_t)1);
+		}
+	}
+
+	mHeader = header;
+	mBitData = data + offset;
+	mBitSize = size - offset;
+	mDimension = dimension;
+	mFormat = format;
+	mWidth = width;
+	mHeight = height;
+	mDepth = depth;
+	mMipCount = mipCount;
+	mArraySize = arraySize;
+	mCube = cube;
+	return true;
+}
@@ -0,0 +1,220 @@
+//***************************************************************************************
+// DDSReader.h
+//
+// Portable DDS file reading: the file structure definitions, format helpers shared with
+// DDSTextureLoader, and a reader that maps a file and validates its headers without
+// copying any pixel data.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DxgiFormat.h"
+#include "FileUtil.h"
+
+//--------------------------------------------------------------------------------------
+// Macros
+//--------------------------------------------------------------------------------------
+#ifndef MAKEFOURCC
+    #define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#endif /* defined(MAKEFOURCC) */
+
+//--------------------------------------------------------------------------------------
+// DDS file structure definitions
+//
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
+//--------------------------------------------------------------------------------------
+#pragma pack(push,1)
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+struct DDS_PIXELFORMAT
+{
+    uint32_t    size;
+    uint32_t    flags;
+    uint32_t    fourCC;
+    uint32_t    RGBBitCount;
+    uint32_t    RBitMask;
+    uint32_t    GBitMask;
+    uint32_t    BBitMask;
+    uint32_t    ABitMask;
+};
+
+#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+#define DDS_RGB         0x00000040  // DDPF_RGB
+#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+
+#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+
+#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
+
+#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+#define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                               DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                               DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
+
+#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+// Values of DDS_HEADER_DXT10::resourceDimension and miscFlag; the same as
+// D3D11_RESOURCE_DIMENSION and D3D11_RESOURCE_MISC_TEXTURECUBE.
+#define DDS_DIMENSION_TEXTURE1D 2
+#define DDS_DIMENSION_TEXTURE2D 3
+#define DDS_DIMENSION_TEXTURE3D 4
+
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+
+enum DDS_MISC_FLAGS2
+{
+    DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
+};
+
+struct DDS_HEADER
+{
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitchOrLinearSize;
+    uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+    uint32_t        mipMapCount;
+    uint32_t        reserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    uint32_t        caps;
+    uint32_t        caps2;
+    uint32_t        caps3;
+    uint32_t        caps4;
+    uint32_t        reserved2;
+};
+
+struct DDS_HEADER_DXT10
+{
+    DXGI_FORMAT     dxgiFormat;
+    uint32_t        resourceDimension;
+    uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+    uint32_t        arraySize;
+    uint32_t        miscFlags2;
+};
+
+#pragma pack(pop)
+
+namespace DDS
+{
+	// Bits per pixel of a format; 0 for formats a DDS file cannot hold.  Block
+	// compressed formats report their average, 4 or 8.
+	std::size_t BitsPerPixel(DXGI_FORMAT fmt);
+
+	// Size of one 2D surface: total bytes, bytes per row and number of rows.  Rows are
+	// 4 texels high in block compressed formats.
+	void GetSurfaceInfo(std::size_t width, std::size_t height, DXGI_FORMAT fmt,
+		std::size_t* outNumBytes, std::size_t* outRowBytes, std::size_t* outNumRows);
+
+	// Format of a file without the DX10 header; DXGI_FORMAT_UNKNOWN if there is none.
+	DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf);
+
+	bool IsBlockCompressed(DXGI_FORMAT fmt);
+
+	// Video formats whose texels are not laid out one per element in a single plane.
+	bool IsPackedOrPlanar(DXGI_FORMAT fmt);
+}
+
+// A validated DDS file.  The file is mapped read-only and every subresource is a span
+// into the mapping, so large cube maps and arrays are never held twice in memory.
+// Everything in the headers is checked before it is used: sizes and flags, the format,
+// dimensions against the D3D12 limits, the mip chain, cube faces, and that the pixel
+// data of every subresource lies inside the file.
+class DDSReader
+{
+public:
+	enum class Dimension
+	{
+		Texture1D = DDS_DIMENSION_TEXTURE1D,
+		Texture2D = DDS_DIMENSION_TEXTURE2D,
+		Texture3D = DDS_DIMENSION_TEXTURE3D
+	};
+
+	// One mip of one array item.  Volume mips hold 'Depth' slices of 'SliceBytes' each.
+	struct Subresource
+	{
+		const std::uint8_t* Data = nullptr;
+		std::size_t Width = 0;
+		std::size_t Height = 0;
+		std::size_t Depth = 1;
+		std::size_t RowBytes = 0;
+		std::size_t RowCount = 0;
+		std::size_t SliceBytes = 0;
+	};
+
+	DDSReader() = default;
+	DDSReader(const DDSReader& rhs) = delete;
+	DDSReader& operator=(const DDSReader& rhs) = delete;
+
+	// Maps and validates a file.  On failure the reader is left closed and 'error', if
+	// given, says why.
+	bool Open(const std::string& path, std::string* error = nullptr);
+
+	// Validates a DDS file already in memory, which must outlive the reader.
+	bool Parse(const void* data, std::size_t size, std::string* error = nullptr);
+
+	void Close();
+
+	bool IsOpen()const { return mHeader != nullptr; }
+
+	const DDS_HEADER* Header()const { return mHeader; }
+	// Pixel data after the headers, as DDSTextureLoader consumes it.
+	const std::uint8_t* BitData()const { return mBitData; }
+	std::size_t BitSize()const { return mBitSize; }
+
+	Dimension GetDimension()const { return mDimension; }
+	DXGI_FORMAT Format()const { return mFormat; }
+	std::uint32_t Width()const { return mWidth; }
+	std::uint32_t Height()const { return mHeight; }
+	std::uint32_t Depth()const { return mDepth; }
+	std::uint32_t MipCount()const { return mMipCount; }
+	// Array items; six per cube.
+	std::uint32_t ArraySize()const { return mArraySize; }
+	bool IsCube()const { return mCube; }
+
+	// Index as in D3D12: mip + item * MipCount().
+	std::size_t SubresourceCount()const { return mSubresources.size(); }
+	const Subresource& GetSubresource(std::size_t index)const { return mSubresources[index]; }
+	const Subresource& GetSubresource(std::uint32_t mip, std::uint32_t item)const
+	{
+		return mSubresources[mip + (std::size_t)item * mMipCount];
+	}
+
+private:
+	bool Validate(const std::uint8_t* data, std::size_t size, std::string* error);
+	bool Fail(std::string* error, const char* reason);
+
+private:
+	MappedFile mFile;
+
+	const DDS_HEADER* mHeader = nullptr;
+	const std::uint8_t* mBitData = nullptr;
+	std::size_t mBitSize = 0;
+
+	Dimension mDimension = Dimension::Texture2D;
+	DXGI_FORMAT mFormat = DXGI_FORMAT_UNKNOWN;
+	std::uint32_t mWidth = 0;
+	std::uint32_t mHeight = 0;
+	std::uint32_t mDepth = 0;
+	std::uint32_t mMipCount = 0;
+	std::uint32_t mArraySize = 0;
+	bool mCube = false;
+
+	std::vector<Subresource> mSubresources;
+};
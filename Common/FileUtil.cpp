@@ -0,0 +1,253 @@
+//***************************************************************************************
+// FileUtil.cpp
+//***************************************************************************************
+
+#include "FileUtil.h"
+
+#include <atomic>
+#include <cstdio>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FileUtil
+{
+
+bool GetFileStamp(const std::string& path, FileStamp& stamp)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attr))
+		return false;
+
+	stamp.Size = (std::uint64_t(attr.nFileSizeHigh) << 32) | attr.nFileSizeLow;
+	stamp.WriteTime = (std::uint64_t(attr.ftLastWriteTime.dwHighDateTime) << 32) | attr.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+
+	stamp.Size = std::uint64_t(st.st_size);
+	stamp.WriteTime = std::uint64_t(st.st_mtim.tv_sec) * 1000000000ull + std::uint64_t(st.st_mtim.tv_nsec);
+#endif
+	return true;
+}
+
+bool FileExists(const std::string& path)
+{
+	FileStamp stamp;
+	return GetFileStamp(path, stamp);
+}
+
+bool CreateDirectories(const std::string& path)
+{
+	std::string partial;
+	partial.reserve(path.size());
+
+	for (std::size_t i = 0; i <= path.size(); ++i)
+	{
+		const bool end = i == path.size();
+		const char c = end ? '/' : path[i];
+		if ((c == '/' || c == '\\') && !partial.empty() && partial.back() != ':')
+		{
+#ifdef _WIN32
+			if (!CreateDirectoryA(partial.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+				return false;
+#else
+			if (mkdir(partial.c_str(), 0755) != 0 && errno != EEXIST)
+				return false;
+#endif
+		}
+		if (!end)
+			partial.push_back(c);
+	}
+
+	return true;
+}
+
+bool WriteFileAtomic(const std::string& path, const void* data, std::size_t size)
+{
+	// A name of its own per write, so writers of the same file, in this process or
+	// another, do not truncate each other's temporary file.
+	static std::atomic<std::uint32_t> sWrites(0);
+#ifdef _WIN32
+	const unsigned long process = GetCurrentProcessId();
+#else
+	const unsigned long process = (unsigned long)getpid();
+#endif
+	const std::string tmpPath = path + "." + std::to_string(process) + "." + std::to_string(sWrites++) + ".tmp";
+
+	FILE* file = std::fopen(tmpPath.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	const bool written = std::fwrite(data, 1, size, file) == size;
+	const bool closed = std::fclose(file) == 0;
+	if (!written || !closed)
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	if (!MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+#endif
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	std::uint64_t hash = seed;
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::uint64_t HashString(const std::string& s, std::uint64_t seed)
+{
+	return HashBytes(s.data(), s.size(), seed);
+}
+
+} // namespace FileUtil
+
+MappedFile::MappedFile(const std::string& path)
+{
+	Open(path);
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept
+{
+	Swap(rhs);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		Close();
+		Swap(rhs);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mData = static_cast<const std::uint8_t*>(view);
+	mSize = std::size_t(size.QuadPart);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	mFd = fd;
+	mData = static_cast<const std::uint8_t*>(view);
+	mSize = std::size_t(st.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+	if (mFile != nullptr)
+		CloseHandle(mFile);
+	mMapping = nullptr;
+	mFile = nullptr;
+#else
+	if (mData != nullptr)
+		munmap(const_cast<std::uint8_t*>(mData), mSize);
+	if (mFd >= 0)
+		close(mFd);
+	mFd = -1;
+#endif
+
+	mData = nullptr;
+	mSize = 0;
+}
+
+void MappedFile::Swap(MappedFile& rhs) noexcept
+{
+	std::swap(mData, rhs.mData);
+	std::swap(mSize, rhs.mSize);
+#ifdef _WIN32
+	std::swap(mFile, rhs.mFile);
+	std::swap(mMapping, rhs.mMapping);
+#else
+	std::swap(mFd, rhs.mFd);
+#endif
+}
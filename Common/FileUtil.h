@@ -0,0 +1,75 @@
+//***************************************************************************************
+// FileUtil.h
+//
+// Small portable file helpers: read-only memory mapping, file stamps for cache
+// invalidation, atomic writes and content hashing.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace FileUtil
+{
+	// Size and last write time of a file.  WriteTime is in platform units and is
+	// only meant to be compared for equality.
+	struct FileStamp
+	{
+		std::uint64_t Size = 0;
+		std::uint64_t WriteTime = 0;
+	};
+
+	// Returns false if the file does not exist.
+	bool GetFileStamp(const std::string& path, FileStamp& stamp);
+
+	bool FileExists(const std::string& path);
+
+	// Creates every missing directory along 'path'.  Accepts '/' and '\' separators.
+	bool CreateDirectories(const std::string& path);
+
+	// Writes to "<path>.<process>.<n>.tmp" and renames over 'path', so a reader never
+	// maps a half-written file and concurrent writers of 'path' all succeed.
+	bool WriteFileAtomic(const std::string& path, const void* data, std::size_t size);
+
+	// 64-bit FNV-1a.  Pass the previous result as 'seed' to hash in pieces.
+	const std::uint64_t HashSeed = 14695981039346656037ull;
+	std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed = HashSeed);
+	std::uint64_t HashString(const std::string& s, std::uint64_t seed = HashSeed);
+}
+
+// Read-only view of a whole file.  The mapping stays valid until Close() or
+// destruction, so pointers into Data() can be handed to upload code without copying.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& path);
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	MappedFile(MappedFile&& rhs) noexcept;
+	MappedFile& operator=(MappedFile&& rhs) noexcept;
+	~MappedFile();
+
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen()const { return mData != nullptr; }
+	const std::uint8_t* Data()const { return mData; }
+	std::size_t Size()const { return mSize; }
+
+private:
+	void Swap(MappedFile& rhs) noexcept;
+
+private:
+	const std::uint8_t* mData = nullptr;
+	std::size_t mSize = 0;
+
+#ifdef _WIN32
+	void* mFile = nullptr;    // HANDLE
+	void* mMapping = nullptr; // HANDLE
+#else
+	int mFd = -1;
+#endif
+};
@@ -18,6 +18,10 @@ public:
 	void Stop();  // Call when paused.
 	void Tick();  // Call every frame.
 
+	// Makes each Tick() advance by exactly 'seconds', whatever the clock says, so runs
+	// are repeatable; 0 goes back to the clock.
+	void SetFixedStep(double seconds);
+
 private:
 	double mSecondsPerCount;
 	double mDeltaTime;
@@ -29,6 +33,9 @@ private:
 	__int64 mCurrTime;
 
 	bool mStopped;
+
+	double mFixedStep;
+	double mFixedTotalTime;
 };
 
 #endif // GAMETIMER_H
\ No newline at end of file
@@ -0,0 +1,170 @@
+//***************************************************************************************
+// InputReplay.cpp
+//***************************************************************************************
+
+#include "InputReplay.h"
+#include "FileUtil.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+const InputRecording::uint32 InputRecording::Version;
+
+namespace
+{
+	const std::uint32_t kMagic = 0x52495452; // "RTIR"
+
+	struct FileHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint32_t KeyCount;
+		std::uint32_t FrameSize;
+		std::uint32_t FrameCount;
+		float FixedStep;
+		std::uint32_t Seed;
+	};
+
+	static_assert(sizeof(FileHeader) == 28, "Input recording header layout changed, bump InputRecording::Version");
+	static_assert(sizeof(InputFrame) == 12, "Input frame layout changed, bump InputRecording::Version");
+}
+
+InputRecording::InputRecording(float fixedStep, uint32 seed)
+	: mFixedStep(fixedStep), mSeed(seed)
+{
+}
+
+std::vector<std::uint8_t> InputRecording::Serialize()const
+{
+	FileHeader header = {};
+	header.Magic = kMagic;
+	header.Version = Version;
+	header.KeyCount = (uint32)InputKey::Count;
+	header.FrameSize = sizeof(InputFrame);
+	header.FrameCount = FrameCount();
+	header.FixedStep = mFixedStep;
+	header.Seed = mSeed;
+
+	std::vector<std::uint8_t> data(sizeof(header) + mFrames.size() * sizeof(InputFrame));
+	std::memcpy(data.data(), &header, sizeof(header));
+	if (!mFrames.empty())
+		std::memcpy(data.data() + sizeof(header), mFrames.data(), mFrames.size() * sizeof(InputFrame));
+	return data;
+}
+
+bool InputRecording::Parse(const void* data, std::size_t size, std::string* error)
+{
+	FileHeader header = {};
+	if (size < sizeof(header))
+	{
+		*error = "file is too small for the header";
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+
+	if (header.Magic != kMagic)
+	{
+		*error = "not an input recording";
+		return false;
+	}
+	if (header.Version != Version || header.FrameSize != sizeof(InputFrame))
+	{
+		*error = "recorded with version " + std::to_string(header.Version) + ", expected " + std::to_string(Version);
+		return false;
+	}
+	if (header.KeyCount != (uint32)InputKey::Count)
+	{
+		*error = "recorded with " + std::to_string(header.KeyCount) + " keys, expected " + std::to_string((uint32)InputKey::Count);
+		return false;
+	}
+	if (!(header.FixedStep > 0.0f) || !std::isfinite(header.FixedStep))
+	{
+		*error = "bad time step";
+		return false;
+	}
+	if ((size - sizeof(header)) / sizeof(InputFrame) != header.FrameCount ||
+		(size - sizeof(header)) % sizeof(InputFrame) != 0)
+	{
+		*error = "file size does not match its " + std::to_string(header.FrameCount) + " frames";
+		return false;
+	}
+
+	mFixedStep = header.FixedStep;
+	mSeed = header.Seed;
+	mFrames.resize(header.FrameCount);
+	if (header.FrameCount != 0)
+		std::memcpy(mFrames.data(), static_cast<const std::uint8_t*>(data) + sizeof(header), mFrames.size() * sizeof(InputFrame));
+	return true;
+}
+
+bool InputRecording::Save(const std::string& path)const
+{
+	const std::vector<std::uint8_t> data = Serialize();
+	return FileUtil::WriteFileAtomic(path, data.data(), data.size());
+}
+
+bool InputRecording::Load(const std::string& path, std::string* error)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		*error = "cannot open " + path;
+		return false;
+	}
+	return Parse(file.Data(), file.Size(), error);
+}
+
+bool InputReplayer::Next(InputFrame* frame)
+{
+	if (Finished())
+		return false;
+	*frame = mRecording.Frame(mNext++);
+	return true;
+}
+
+FrameTimingLog::Summary FrameTimingLog::Summarize(uint32 skip)const
+{
+	Summary summary;
+	if (skip >= mFrames.size())
+		return summary;
+
+	std::vector<double> sorted;
+	sorted.reserve(mFrames.size() - skip);
+	double sum = 0.0;
+	for (size_t i = skip; i < mFrames.size(); ++i)
+	{
+		sorted.push_back(mFrames[i].FrameMs);
+		sum += mFrames[i].FrameMs;
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	summary.Frames = (uint32)sorted.size();
+	summary.MeanFrameMs = sum / sorted.size();
+	summary.MedianFrameMs = sorted.size() % 2 ? sorted[sorted.size() / 2] :
+		0.5 * (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]);
+	// Nearest rank, as Profiler::GetStats.
+	summary.P95FrameMs = sorted[(sorted.size() * 95 + 99) / 100 - 1];
+	summary.MaxFrameMs = sorted.back();
+	return summary;
+}
+
+std::string FrameTimingLog::Csv()const
+{
+	std::string csv = "frame,frame_ms,update_ms,wait_ms,draw_ms\n";
+	char line[128];
+	for (size_t i = 0; i < mFrames.size(); ++i)
+	{
+		const Timing& t = mFrames[i];
+		snprintf(line, sizeof(line), "%u,%.4f,%.4f,%.4f,%.4f\n", (unsigned)i, t.FrameMs, t.UpdateMs, t.WaitMs, t.DrawMs);
+		csv += line;
+	}
+	return csv;
+}
+
+bool FrameTimingLog::SaveCsv(const std::string& path)const
+{
+	const std::string csv = Csv();
+	return FileUtil::WriteFileAtomic(path, csv.data(), csv.size());
+}
@@ -0,0 +1,134 @@
+//***************************************************************************************
+// InputReplay.h
+//
+// Deterministic runs for performance comparisons: the input of every frame recorded
+// with the fixed time step the frames were simulated at and the seed of the sampling
+// state, played back in place of the keyboard and mouse, and the timing of each
+// replayed frame.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The keys the app reacts to, as bits of InputFrame::Keys.  New keys go at the end;
+// recordings store the key count and are rejected when it differs.
+enum class InputKey : std::uint32_t
+{
+	W, A, S, D,
+	Up, Down, Left, Right,
+	I, J, K, L,
+	Capture, // 'P'
+	Count
+};
+
+// What Update reads in one frame: the keys held and how far the mouse was dragged, in
+// pixels, since the last frame.
+struct InputFrame
+{
+	std::uint32_t Keys = 0;
+	std::int32_t MouseDx = 0;
+	std::int32_t MouseDy = 0;
+
+	bool IsDown(InputKey key)const { return (Keys & (1u << (std::uint32_t)key)) != 0; }
+	void SetDown(InputKey key, bool down)
+	{
+		if (down)
+			Keys |= 1u << (std::uint32_t)key;
+		else
+			Keys &= ~(1u << (std::uint32_t)key);
+	}
+};
+
+// The frames of a run, the time step they were simulated at and the seed the per-pixel
+// random state was built from.  Stored as a small header and the frames as they are in
+// memory, like the mesh cache.
+class InputRecording
+{
+public:
+	using uint32 = std::uint32_t;
+
+	static const uint32 Version = 2;
+
+	explicit InputRecording(float fixedStep = 1.0f / 60.0f, uint32 seed = 0);
+
+	float FixedStep()const { return mFixedStep; }
+	uint32 Seed()const { return mSeed; }
+	uint32 FrameCount()const { return (uint32)mFrames.size(); }
+	const InputFrame& Frame(uint32 index)const { return mFrames[index]; }
+
+	void Add(const InputFrame& frame) { mFrames.push_back(frame); }
+
+	std::vector<std::uint8_t> Serialize()const;
+	// Replaces the recording with 'data'; on failure leaves it unchanged and says why.
+	bool Parse(const void* data, std::size_t size, std::string* error);
+
+	bool Save(const std::string& path)const;
+	bool Load(const std::string& path, std::string* error);
+
+private:
+	float mFixedStep = 0.0f;
+	uint32 mSeed = 0;
+	std::vector<InputFrame> mFrames;
+};
+
+// Hands out the frames of a recording in order.  The recording must outlive it.
+class InputReplayer
+{
+public:
+	using uint32 = std::uint32_t;
+
+	explicit InputReplayer(const InputRecording& recording) : mRecording(recording) {}
+
+	// The next frame's input; false once every frame was played.
+	bool Next(InputFrame* frame);
+
+	bool Finished()const { return mNext >= mRecording.FrameCount(); }
+	uint32 FramesPlayed()const { return mNext; }
+
+private:
+	const InputRecording& mRecording;
+	uint32 mNext = 0;
+};
+
+// CPU times of each frame of a run, written as CSV for diffing between builds.
+class FrameTimingLog
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct Timing
+	{
+		double FrameMs = 0.0;   // since the previous frame started
+		double UpdateMs = 0.0;  // including WaitMs
+		double WaitMs = 0.0;    // blocked on the GPU in Update
+		double DrawMs = 0.0;    // recording, submission and present
+	};
+
+	struct Summary
+	{
+		uint32 Frames = 0;
+		double MeanFrameMs = 0.0;
+		double MedianFrameMs = 0.0;
+		double P95FrameMs = 0.0;
+		double MaxFrameMs = 0.0;
+	};
+
+	void Add(const Timing& timing) { mFrames.push_back(timing); }
+	uint32 FrameCount()const { return (uint32)mFrames.size(); }
+	const Timing& Frame(uint32 index)const { return mFrames[index]; }
+
+	// Of frames [skip, FrameCount()), so the first frames, which warm caches up, can be
+	// left out.
+	Summary Summarize(uint32 skip = 0)const;
+
+	// A header line, then "frame,frame_ms,update_ms,wait_ms,draw_ms" per frame.
+	std::string Csv()const;
+	bool SaveCsv(const std::string& path)const;
+
+private:
+	std::vector<Timing> mFrames;
+};
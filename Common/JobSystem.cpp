@@ -0,0 +1,431 @@
+//***************************************************************************************
+// JobSystem.cpp
+//***************************************************************************************
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <exception>
+
+class JobSystem::Job
+{
+public:
+	explicit Job(std::function<void()> function) : Function(std::move(function)) {}
+
+	std::function<void()> Function;
+	Job* Parent = nullptr;
+
+	// The job itself plus its unfinished children.
+	std::atomic<uint32> Unfinished{ 1 };
+	// Handles, the queue holding it, children and jobs it continues.
+	std::atomic<uint32> References{ 1 };
+
+	// Guards the continuations and the exception.
+	std::mutex Lock;
+	std::vector<Job*> Continuations;
+	std::exception_ptr Exception;
+};
+
+namespace
+{
+	// The system and slot of the calling thread, set on workers only.
+	thread_local const JobSystem* tSystem = nullptr;
+	thread_local std::uint32_t tSlot = 0;
+
+	std::uint32_t NextRandom(std::uint32_t& state)
+	{
+		// xorshift32
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+}
+
+//
+// JobHandle
+//
+
+JobSystem::JobHandle::JobHandle(const JobHandle& rhs) : mJob(rhs.mJob)
+{
+	if (mJob)
+		Retain(mJob);
+}
+
+JobSystem::JobHandle::JobHandle(JobHandle&& rhs) noexcept : mJob(rhs.mJob)
+{
+	rhs.mJob = nullptr;
+}
+
+JobSystem::JobHandle& JobSystem::JobHandle::operator=(JobHandle rhs) noexcept
+{
+	std::swap(mJob, rhs.mJob);
+	return *this;
+}
+
+JobSystem::JobHandle::~JobHandle()
+{
+	if (mJob)
+		Release(mJob);
+}
+
+//
+// JobSystem
+//
+
+JobSystem::JobSystem(uint32 workerCount)
+{
+	if (workerCount == 0)
+		workerCount = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+
+	for (uint32 i = 0; i <= workerCount; ++i)
+	{
+		mSlots.push_back(std::make_unique<Slot>());
+		mSlots.back()->Random = 0x9e3779b9u * (i + 1);
+	}
+
+	for (uint32 i = 0; i < workerCount; ++i)
+		mWorkers.emplace_back(&JobSystem::WorkerMain, this, i + 1);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+		mStop = true;
+	}
+	mWake.notify_all();
+
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+JobSystem::JobHandle JobSystem::Create(std::function<void()> function)
+{
+	return JobHandle(new Job(std::move(function)));
+}
+
+JobSystem::JobHandle JobSystem::CreateChild(const JobHandle& parent, std::function<void()> function)
+{
+	Job* job = new Job(std::move(function));
+	job->Parent = parent.mJob;
+	parent.mJob->Unfinished.fetch_add(1, std::memory_order_relaxed);
+	Retain(parent.mJob);
+	return JobHandle(job);
+}
+
+void JobSystem::AddContinuation(const JobHandle& job, const JobHandle& continuation)
+{
+	Retain(continuation.mJob);
+	{
+		std::lock_guard<std::mutex> lock(job.mJob->Lock);
+		if (job.mJob->Unfinished.load(std::memory_order_acquire) != 0)
+		{
+			job.mJob->Continuations.push_back(continuation.mJob);
+			return;
+		}
+	}
+	Submit(continuation.mJob);
+}
+
+void JobSystem::Run(const JobHandle& job)
+{
+	Retain(job.mJob);
+	Submit(job.mJob);
+}
+
+JobSystem::JobHandle JobSystem::Spawn(std::function<void()> function)
+{
+	JobHandle job = Create(std::move(function));
+	Run(job);
+	return job;
+}
+
+bool JobSystem::IsFinished(const JobHandle& job)const
+{
+	return job.mJob->Unfinished.load(std::memory_order_acquire) == 0;
+}
+
+void JobSystem::Wait(const JobHandle& job)
+{
+	Slot& slot = CurrentSlot();
+	while (!IsFinished(job))
+	{
+		Job* next = Pop(slot);
+		if (!next)
+			next = Steal(slot);
+		if (next)
+			Execute(next, slot);
+		else
+			std::this_thread::yield();
+	}
+
+	std::exception_ptr exception;
+	{
+		std::lock_guard<std::mutex> lock(job.mJob->Lock);
+		exception = job.mJob->Exception;
+	}
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+void JobSystem::ParallelFor(uint32 count, uint32 grain, const std::function<void(uint32, uint32)>& body)
+{
+	grain = (std::max)(grain, 1u);
+	if (count <= grain)
+	{
+		if (count > 0)
+			body(0, count);
+		return;
+	}
+
+	// Every range is a child of one root, which the calling thread runs once it has
+	// handed out the halves of its own share.
+	JobHandle root = Create(nullptr);
+	try
+	{
+		Split(root.mJob, 0, count, grain, body);
+	}
+	catch (...)
+	{
+		// The other ranges are already queued and refer to 'body', so wait for them too.
+		std::lock_guard<std::mutex> lock(root.mJob->Lock);
+		if (!root.mJob->Exception)
+			root.mJob->Exception = std::current_exception();
+	}
+	Retain(root.mJob);
+	Execute(root.mJob, CurrentSlot());
+	Wait(root);
+}
+
+JobSystem::Stats JobSystem::GetStats()const
+{
+	Stats stats;
+	for (const auto& slot : mSlots)
+	{
+		stats.JobsRun += slot->JobsRun.load(std::memory_order_relaxed);
+		stats.Steals += slot->Steals.load(std::memory_order_relaxed);
+		stats.FailedSteals += slot->FailedSteals.load(std::memory_order_relaxed);
+		stats.LockContentions += slot->LockContentions.load(std::memory_order_relaxed);
+		stats.Sleeps += slot->Sleeps.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+void JobSystem::ResetStats()
+{
+	for (const auto& slot : mSlots)
+	{
+		slot->JobsRun = 0;
+		slot->Steals = 0;
+		slot->FailedSteals = 0;
+		slot->LockContentions = 0;
+		slot->Sleeps = 0;
+	}
+}
+
+void JobSystem::Retain(Job* job)
+{
+	job->References.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JobSystem::Release(Job* job)
+{
+	if (job->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		delete job;
+}
+
+JobSystem::Slot& JobSystem::CurrentSlot()
+{
+	return *mSlots[tSystem == this ? tSlot : 0];
+}
+
+void JobSystem::Submit(Job* job)
+{
+	Slot& slot = CurrentSlot();
+	{
+		std::unique_lock<std::mutex> lock(slot.Lock, std::try_to_lock);
+		if (!lock.owns_lock())
+		{
+			slot.LockContentions.fetch_add(1, std::memory_order_relaxed);
+			lock.lock();
+		}
+		slot.Jobs.push_back(job);
+	}
+
+	// Paired with the sleeper count and the check of mQueued under mSleepLock in
+	// WorkerMain, so that either the worker sees the job or this sees the worker.
+	mQueued.fetch_add(1);
+	if (mSleepers.load() != 0)
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+		mWake.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::Pop(Slot& slot)
+{
+	std::unique_lock<std::mutex> lock(slot.Lock, std::try_to_lock);
+	if (!lock.owns_lock())
+	{
+		slot.LockContentions.fetch_add(1, std::memory_order_relaxed);
+		lock.lock();
+	}
+	if (slot.Head == slot.Jobs.size())
+		return nullptr;
+
+	Job* job = slot.Jobs.back();
+	slot.Jobs.pop_back();
+	if (slot.Head == slot.Jobs.size())
+	{
+		slot.Jobs.clear();
+		slot.Head = 0;
+	}
+	mQueued.fetch_sub(1, std::memory_order_relaxed);
+	return job;
+}
+
+JobSystem::Job* JobSystem::Steal(Slot& thief)
+{
+	// Start at a random victim so thieves spread out; a queue whose lock is held is
+	// skipped rather than waited for.
+	const uint32 count = uint32(mSlots.size());
+	const uint32 start = NextRandom(thief.Random) % count;
+	for (uint32 i = 0; i < count; ++i)
+	{
+		Slot& victim = *mSlots[(start + i) % count];
+		if (&victim == &thief)
+			continue;
+
+		std::unique_lock<std::mutex> lock(victim.Lock, std::try_to_lock);
+		if (!lock.owns_lock())
+		{
+			thief.LockContentions.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		if (victim.Head == victim.Jobs.size())
+			continue;
+
+		Job* job = victim.Jobs[victim.Head++];
+		if (victim.Head == victim.Jobs.size())
+		{
+			victim.Jobs.clear();
+			victim.Head = 0;
+		}
+		else if (victim.Head >= 64 && victim.Head * 2 >= victim.Jobs.size())
+		{
+			victim.Jobs.erase(victim.Jobs.begin(), victim.Jobs.begin() + victim.Head);
+			victim.Head = 0;
+		}
+		mQueued.fetch_sub(1, std::memory_order_relaxed);
+		thief.Steals.fetch_add(1, std::memory_order_relaxed);
+		return job;
+	}
+
+	thief.FailedSteals.fetch_add(1, std::memory_order_relaxed);
+	return nullptr;
+}
+
+void JobSystem::Execute(Job* job, Slot& slot)
+{
+	if (job->Function)
+	{
+		try
+		{
+			job->Function();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(job->Lock);
+			if (!job->Exception)
+				job->Exception = std::current_exception();
+		}
+		// Whatever the function captured goes now rather than with the last handle.
+		job->Function = nullptr;
+	}
+	slot.JobsRun.fetch_add(1, std::memory_order_relaxed);
+
+	Finish(job);
+	Release(job); // the queue's reference
+}
+
+void JobSystem::Finish(Job* job)
+{
+	if (job->Unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	std::vector<Job*> continuations;
+	std::exception_ptr exception;
+	{
+		std::lock_guard<std::mutex> lock(job->Lock);
+		continuations.swap(job->Continuations);
+		exception = job->Exception;
+	}
+	for (Job* continuation : continuations)
+		Submit(continuation);
+
+	Job* parent = job->Parent;
+	if (parent)
+	{
+		if (exception)
+		{
+			std::lock_guard<std::mutex> lock(parent->Lock);
+			if (!parent->Exception)
+				parent->Exception = exception;
+		}
+		Finish(parent);
+		Release(parent);
+	}
+}
+
+void JobSystem::Split(Job* root, uint32 first, uint32 last, uint32 grain, const std::function<void(uint32, uint32)>& body)
+{
+	while (last - first > grain)
+	{
+		const uint32 middle = first + (last - first) / 2;
+		const uint32 end = last;
+		Job* child = new Job([this, root, middle, end, grain, &body]()
+		{
+			Split(root, middle, end, grain, body);
+		});
+		child->Parent = root;
+		root->Unfinished.fetch_add(1, std::memory_order_relaxed);
+		Retain(root);
+		Submit(child); // the queue takes over the creation reference
+		last = middle;
+	}
+	body(first, last);
+}
+
+void JobSystem::WorkerMain(uint32 index)
+{
+	tSystem = this;
+	tSlot = index;
+	Slot& slot = *mSlots[index];
+
+	while (true)
+	{
+		Job* job = Pop(slot);
+		if (!job)
+			job = Steal(slot);
+		if (job)
+		{
+			Execute(job, slot);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mSleepLock);
+		if (mStop && mQueued.load() == 0)
+			break;
+
+		mSleepers.fetch_add(1);
+		if (mQueued.load() == 0 && !mStop)
+		{
+			slot.Sleeps.fetch_add(1, std::memory_order_relaxed);
+			mWake.wait(lock, [this]() { return mQueued.load() != 0 || mStop; });
+		}
+		mSleepers.fetch_sub(1);
+	}
+
+	tSystem = nullptr;
+}
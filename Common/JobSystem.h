@@ -0,0 +1,138 @@
+//***************************************************************************************
+// JobSystem.h
+//
+// Work-stealing job scheduler for CPU work that loading, the bake tools and per-frame
+// updates share, instead of each starting threads of its own.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Every worker thread owns a deque of jobs: it pushes and pops at the back, so it keeps
+// working on what it touched last, and idle workers steal from the front of the others',
+// taking the oldest and usually largest pieces of work.  Threads that are not workers,
+// such as the main thread, submit into a queue of their own and run jobs like a worker
+// while they Wait().
+//
+// A job finishes once its function and all of its children have; then its continuations
+// are submitted and its parent, if any, is told.  An exception thrown by a job or one of
+// its children is rethrown by Wait() on it.
+class JobSystem
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	class Job;
+
+	// Counted reference to a job.  A job is freed once it has finished and nothing
+	// refers to it any more.
+	class JobHandle
+	{
+	public:
+		JobHandle() = default;
+		JobHandle(const JobHandle& rhs);
+		JobHandle(JobHandle&& rhs) noexcept;
+		JobHandle& operator=(JobHandle rhs) noexcept;
+		~JobHandle();
+
+		bool IsValid()const { return mJob != nullptr; }
+
+	private:
+		friend class JobSystem;
+		explicit JobHandle(Job* job) : mJob(job) {} // adopts a reference
+
+		Job* mJob = nullptr;
+	};
+
+	// Totals over all threads since construction or the last ResetStats().
+	struct Stats
+	{
+		uint64 JobsRun = 0;
+		uint64 Steals = 0;          // jobs taken from another thread's queue
+		uint64 FailedSteals = 0;    // looks through every other queue that found nothing
+		uint64 LockContentions = 0; // queue locks found held by another thread
+		uint64 Sleeps = 0;          // times a worker ran out of work and slept
+	};
+
+	// 'workerCount' 0 starts one worker per hardware thread but one, which is left to the
+	// thread that waits.  There is always at least one worker.
+	explicit JobSystem(uint32 workerCount = 0);
+	JobSystem(const JobSystem& rhs) = delete;
+	JobSystem& operator=(const JobSystem& rhs) = delete;
+	// Runs whatever is still queued, then joins the workers.
+	~JobSystem();
+
+	uint32 WorkerCount()const { return uint32(mWorkers.size()); }
+
+	JobHandle Create(std::function<void()> function);
+	// A job 'parent' does not finish before.  Must be called while 'parent' has not
+	// finished: from its function or a child's, or before it is run.
+	JobHandle CreateChild(const JobHandle& parent, std::function<void()> function);
+	// Submits 'continuation' once 'job' has finished, or right away if it already has.
+	// 'continuation' must not also be run directly.
+	void AddContinuation(const JobHandle& job, const JobHandle& continuation);
+
+	// Queues a job created by Create or CreateChild.  Each job is run once.
+	void Run(const JobHandle& job);
+	JobHandle Spawn(std::function<void()> function);
+
+	bool IsFinished(const JobHandle& job)const;
+	// Runs queued jobs until 'job' has finished.
+	void Wait(const JobHandle& job);
+
+	// Calls body(first, last) on ranges of at most 'grain' covering [0, count), spread
+	// over the workers and the calling thread, and returns once all have been done.
+	// Ranges are split in halves, so a thief takes half of what is left.
+	void ParallelFor(uint32 count, uint32 grain, const std::function<void(uint32, uint32)>& body);
+
+	Stats GetStats()const;
+	void ResetStats();
+
+private:
+	// A queue and the counters of the thread(s) using it, on cache lines of their own.
+	struct alignas(64) Slot
+	{
+		std::mutex Lock;
+		std::vector<Job*> Jobs; // front at Head; the owner pops from the back
+		std::size_t Head = 0;
+		uint32 Random = 0;
+
+		std::atomic<uint64> JobsRun{ 0 };
+		std::atomic<uint64> Steals{ 0 };
+		std::atomic<uint64> FailedSteals{ 0 };
+		std::atomic<uint64> LockContentions{ 0 };
+		std::atomic<uint64> Sleeps{ 0 };
+	};
+
+	static void Retain(Job* job);
+	static void Release(Job* job);
+
+	Slot& CurrentSlot();
+	void Submit(Job* job);
+	Job* Pop(Slot& slot);
+	Job* Steal(Slot& thief);
+	void Execute(Job* job, Slot& slot);
+	void Finish(Job* job);
+	void Split(Job* root, uint32 first, uint32 last, uint32 grain, const std::function<void(uint32, uint32)>& body);
+	void WorkerMain(uint32 index);
+
+private:
+	// Slot 0 takes jobs submitted from threads that are not workers; worker i uses slot i + 1.
+	std::vector<std::unique_ptr<Slot>> mSlots;
+	std::vector<std::thread> mWorkers;
+
+	std::atomic<uint32> mQueued{ 0 };
+	std::atomic<uint32> mSleepers{ 0 };
+	std::mutex mSleepLock;
+	std::condition_variable mWake;
+	bool mStop = false;
+};
@@ -0,0 +1,61 @@
+//***************************************************************************************
+// PlatformUtil.cpp
+//***************************************************************************************
+
+#include "PlatformUtil.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace PlatformUtil
+{
+
+std::uint64_t PeakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return std::uint64_t(usage.ru_maxrss);
+#else
+	return std::uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+std::uint64_t CurrentResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+#else
+	FILE* statm = std::fopen("/proc/self/statm", "r");
+	if (statm == nullptr)
+		return 0;
+
+	unsigned long long pages = 0, resident = 0;
+	const int read = std::fscanf(statm, "%llu %llu", &pages, &resident);
+	std::fclose(statm);
+	if (read != 2)
+		return 0;
+
+	return std::uint64_t(resident) * std::uint64_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+} // namespace PlatformUtil
@@ -0,0 +1,19 @@
+//***************************************************************************************
+// PlatformUtil.h
+//
+// Process-level queries that differ between Win32 and POSIX.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+
+namespace PlatformUtil
+{
+	// Peak working set (Win32) or maximum resident set size (POSIX) of this
+	// process so far, in bytes.  Returns 0 if the platform cannot report it.
+	std::uint64_t PeakResidentBytes();
+
+	// Current working set / resident set size in bytes, 0 if unavailable.
+	std::uint64_t CurrentResidentBytes();
+}
@@ -0,0 +1,289 @@
+//***************************************************************************************
+// Profiler.cpp
+//***************************************************************************************
+
+#include "Profiler.h"
+#include "FileUtil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+const Profiler::uint32 Profiler::GpuThread;
+
+namespace
+{
+	std::atomic<std::uint32_t> gNextProfilerId{ 1 };
+
+	// The buffer of the profiler the calling thread used last, so the common case of
+	// one profiler takes no lock.
+	thread_local std::uint32_t tProfilerId = 0;
+	thread_local void* tThreadBuffer = nullptr;
+
+	void AppendEscaped(std::string& json, const char* text)
+	{
+		for (const char* c = text; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				json += '\\';
+				json += *c;
+			}
+			else if ((unsigned char)*c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)(unsigned char)*c);
+				json += escaped;
+			}
+			else
+				json += *c;
+		}
+	}
+}
+
+Profiler::Profiler(uint32 window)
+	: mId(gNextProfilerId.fetch_add(1)), mWindow((std::max)(window, 1u)),
+	mStart(std::chrono::high_resolution_clock::now())
+{
+	mGpu.Thread = GpuThread;
+}
+
+double Profiler::NowUs()const
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - mStart).count();
+}
+
+void Profiler::BeginFrame()
+{
+	if (!IsEnabled())
+		return;
+
+	mInFrame = true;
+	BeginScope("Frame");
+}
+
+void Profiler::EndFrame()
+{
+	if (!mInFrame)
+		return;
+	mInFrame = false;
+	EndScope();
+
+	mGathered.clear();
+	{
+		std::lock_guard<std::mutex> threadsLock(mThreadsLock);
+		for (const auto& thread : mThreads)
+		{
+			std::lock_guard<std::mutex> lock(thread->Lock);
+			mGathered.insert(mGathered.end(), thread->Events.begin(), thread->Events.end());
+			thread->Events.clear();
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(mGpu.Lock);
+		mGathered.insert(mGathered.end(), mGpu.Events.begin(), mGpu.Events.end());
+		mGpu.Events.clear();
+	}
+
+	for (const Event& event : mGathered)
+		AddSample(event, event.Thread == GpuThread);
+
+	// A name seen several times in the frame counts once, with its total.
+	for (uint32 index : mFrameSeries)
+	{
+		Series& series = mSeries[index];
+		if (series.SamplesUs.size() < mWindow)
+			series.SamplesUs.push_back(series.FrameUs);
+		else
+			series.SamplesUs[series.Next] = series.FrameUs;
+		series.Next = (series.Next + 1) % mWindow;
+		series.FrameUs = 0.0;
+		series.InFrame = false;
+	}
+	mFrameSeries.clear();
+
+	if (mCaptureFramesLeft > 0)
+	{
+		mCapture.insert(mCapture.end(), mGathered.begin(), mGathered.end());
+		--mCaptureFramesLeft;
+	}
+}
+
+void Profiler::BeginScope(const char* name)
+{
+	ThreadBuffer& thread = CallingThreadBuffer();
+
+	OpenScope open;
+	open.Name = name;
+	open.StartUs = NowUs();
+	thread.Open.push_back(open);
+}
+
+void Profiler::EndScope()
+{
+	const double endUs = NowUs();
+	ThreadBuffer& thread = CallingThreadBuffer();
+	if (thread.Open.empty())
+		throw std::logic_error("Profiler: ending a scope that was not begun on this thread");
+
+	const OpenScope open = thread.Open.back();
+	thread.Open.pop_back();
+
+	Event event;
+	event.Name = open.Name;
+	event.Thread = thread.Thread;
+	event.Depth = (uint32)thread.Open.size();
+	event.StartUs = open.StartUs;
+	event.DurationUs = endUs - open.StartUs;
+
+	std::lock_guard<std::mutex> lock(thread.Lock);
+	thread.Events.push_back(event);
+}
+
+void Profiler::AddGpuEvent(const char* name, double startUs, double durationUs)
+{
+	if (!IsEnabled())
+		return;
+
+	Event event;
+	event.Name = name;
+	event.Thread = GpuThread;
+	event.StartUs = startUs;
+	event.DurationUs = durationUs;
+
+	std::lock_guard<std::mutex> lock(mGpu.Lock);
+	mGpu.Events.push_back(event);
+}
+
+void Profiler::StartCapture(uint32 frames)
+{
+	mCapture.clear();
+	mCaptureFramesLeft = frames;
+}
+
+std::string Profiler::ChromeTrace()const
+{
+	// Complete ("X") events in microseconds; the CPU threads in one process, the GPU
+	// queue in another.
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+	char line[256];
+	std::vector<bool> namedThreads;
+	for (const Event& event : mCapture)
+	{
+		if (event.Thread == GpuThread || (event.Thread < namedThreads.size() && namedThreads[event.Thread]))
+			continue;
+		if (event.Thread >= namedThreads.size())
+			namedThreads.resize(event.Thread + 1, false);
+		namedThreads[event.Thread] = true;
+
+		snprintf(line, sizeof(line),
+			",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+			event.Thread, event.Thread);
+		json += line;
+	}
+
+	for (const Event& event : mCapture)
+	{
+		const bool gpu = event.Thread == GpuThread;
+		json += ",\n{\"name\":\"";
+		AppendEscaped(json, event.Name);
+		snprintf(line, sizeof(line), "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			gpu ? "gpu" : "cpu", gpu ? 1 : 0, gpu ? 0 : event.Thread, event.StartUs, event.DurationUs);
+		json += line;
+	}
+
+	json += "\n]}\n";
+	return json;
+}
+
+bool Profiler::SaveChromeTrace(const std::string& path)const
+{
+	const std::string json = ChromeTrace();
+	return FileUtil::WriteFileAtomic(path, json.data(), json.size());
+}
+
+std::vector<Profiler::SeriesStats> Profiler::GetStats()const
+{
+	std::vector<SeriesStats> stats;
+	std::vector<double> sorted;
+	for (const Series& series : mSeries)
+	{
+		if (series.SamplesUs.empty())
+			continue;
+
+		sorted = series.SamplesUs;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (double sample : sorted)
+			sum += sample;
+
+		SeriesStats entry;
+		entry.Name = series.Name;
+		entry.Gpu = series.Gpu;
+		entry.Samples = (uint32)sorted.size();
+		entry.MeanMs = sum / sorted.size() / 1000.0;
+		// Nearest rank.
+		const size_t p95 = (sorted.size() * 95 + 99) / 100 - 1;
+		entry.P95Ms = sorted[p95] / 1000.0;
+		entry.MaxMs = sorted.back() / 1000.0;
+		stats.push_back(entry);
+	}
+	return stats;
+}
+
+Profiler::ThreadBuffer& Profiler::CallingThreadBuffer()
+{
+	if (tProfilerId == mId)
+		return *static_cast<ThreadBuffer*>(tThreadBuffer);
+
+	std::lock_guard<std::mutex> lock(mThreadsLock);
+	const std::thread::id id = std::this_thread::get_id();
+	ThreadBuffer* buffer = nullptr;
+	for (const auto& thread : mThreads)
+	{
+		if (thread->Id == id)
+			buffer = thread.get();
+	}
+	if (buffer == nullptr)
+	{
+		mThreads.push_back(std::make_unique<ThreadBuffer>());
+		buffer = mThreads.back().get();
+		buffer->Id = id;
+		buffer->Thread = (uint32)mThreads.size() - 1;
+	}
+
+	tProfilerId = mId;
+	tThreadBuffer = buffer;
+	return *buffer;
+}
+
+void Profiler::AddSample(const Event& event, bool gpu)
+{
+	std::string key = gpu ? "g:" : "c:";
+	key += event.Name;
+
+	auto found = mSeriesIndex.find(key);
+	uint32 index = 0;
+	if (found != mSeriesIndex.end())
+		index = found->second;
+	else
+	{
+		index = (uint32)mSeries.size();
+		mSeriesIndex.emplace(key, index);
+		Series series;
+		series.Name = event.Name;
+		series.Gpu = gpu;
+		mSeries.push_back(std::move(series));
+	}
+
+	Series& series = mSeries[index];
+	series.FrameUs += event.DurationUs;
+	if (!series.InFrame)
+	{
+		series.InFrame = true;
+		mFrameSeries.push_back(index);
+	}
+}
@@ -0,0 +1,169 @@
+//***************************************************************************************
+// Profiler.h
+//
+// Frame profiler: nested CPU scopes on any thread, GPU intervals fed in once their
+// timestamps are read back, rolling per-scope statistics and Chrome trace captures.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Scopes are timed on the thread that opens them and kept in a buffer per thread until
+// EndFrame(), which gathers every thread's events, adds each scope's total for the frame
+// to a window of the last frames, and keeps the events if a capture is running.  Scopes
+// must be closed on the thread that opened them, and none may be open on other threads
+// during EndFrame().
+//
+// GPU intervals come from whoever reads the timestamps back, converted to the profiler's
+// clock, and are handled like the scopes of a separate thread.
+//
+// Disabled, a Scope costs a relaxed load and a branch.  Names are kept by pointer, so
+// string literals are expected.
+class Profiler
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Event
+	{
+		const char* Name = nullptr;
+		uint32 Thread = 0;      // in order of first use; GPU events have GpuThread
+		uint32 Depth = 0;       // scopes open around it on its thread
+		double StartUs = 0.0;   // since the profiler was created
+		double DurationUs = 0.0;
+	};
+
+	static const uint32 GpuThread = 0xFFFFFFFF;
+
+	// Of one name on the CPU or the GPU, over the frames of the window it appeared in.
+	struct SeriesStats
+	{
+		std::string Name;
+		bool Gpu = false;
+		uint32 Samples = 0;
+		double MeanMs = 0.0;
+		double P95Ms = 0.0;
+		double MaxMs = 0.0;
+	};
+
+	// Every CPU scope; 'profiler' may be null.
+	class Scope
+	{
+	public:
+		Scope(Profiler* profiler, const char* name)
+		{
+			if (profiler != nullptr && profiler->mEnabled.load(std::memory_order_relaxed))
+			{
+				mProfiler = profiler;
+				mProfiler->BeginScope(name);
+			}
+		}
+		Scope(Profiler& profiler, const char* name) : Scope(&profiler, name) {}
+		Scope(const Scope& rhs) = delete;
+		Scope& operator=(const Scope& rhs) = delete;
+		~Scope()
+		{
+			if (mProfiler != nullptr)
+				mProfiler->EndScope();
+		}
+
+	private:
+		Profiler* mProfiler = nullptr;
+	};
+
+	explicit Profiler(uint32 window = 120);
+	Profiler(const Profiler& rhs) = delete;
+	Profiler& operator=(const Profiler& rhs) = delete;
+
+	// Only between frames.
+	void SetEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+	bool IsEnabled()const { return mEnabled.load(std::memory_order_relaxed); }
+
+	// Microseconds since the profiler was created.
+	double NowUs()const;
+
+	// The frame is timed as a scope named "Frame" on the thread calling these.
+	void BeginFrame();
+	void EndFrame();
+
+	// What Scope calls.
+	void BeginScope(const char* name);
+	void EndScope();
+
+	void AddGpuEvent(const char* name, double startUs, double durationUs);
+
+	// Keeps the events of the next 'frames' frames, dropping an earlier capture.
+	void StartCapture(uint32 frames);
+	bool IsCapturing()const { return mCaptureFramesLeft > 0; }
+	// Whether a capture has finished since it started; cleared by the next one.
+	bool CaptureReady()const { return mCaptureFramesLeft == 0 && !mCapture.empty(); }
+	const std::vector<Event>& CapturedEvents()const { return mCapture; }
+
+	// The captured events in the Chrome trace event format, for chrome://tracing or
+	// Perfetto.
+	std::string ChromeTrace()const;
+	bool SaveChromeTrace(const std::string& path)const;
+
+	// In the order the series first appeared.
+	std::vector<SeriesStats> GetStats()const;
+
+private:
+	struct OpenScope
+	{
+		const char* Name = nullptr;
+		double StartUs = 0.0;
+	};
+
+	struct ThreadBuffer
+	{
+		std::thread::id Id;
+		uint32 Thread = 0;
+		std::vector<OpenScope> Open;
+		std::mutex Lock; // the events, which EndFrame() takes
+		std::vector<Event> Events;
+	};
+
+	// The last frames' totals of one name, in a ring.
+	struct Series
+	{
+		std::string Name;
+		bool Gpu = false;
+		std::vector<double> SamplesUs;
+		uint32 Next = 0;
+		double FrameUs = 0.0; // this frame's total so far
+		bool InFrame = false;
+	};
+
+	ThreadBuffer& CallingThreadBuffer();
+	void AddSample(const Event& event, bool gpu);
+
+private:
+	std::atomic<bool> mEnabled{ true };
+	const uint32 mId;
+	const uint32 mWindow;
+	const std::chrono::high_resolution_clock::time_point mStart;
+
+	std::mutex mThreadsLock;
+	std::vector<std::unique_ptr<ThreadBuffer>> mThreads;
+	ThreadBuffer mGpu;
+
+	std::vector<Series> mSeries;
+	std::unordered_map<std::string, uint32> mSeriesIndex; // "c:" or "g:" and the name
+	std::vector<uint32> mFrameSeries; // that got a sample this frame
+
+	bool mInFrame = false; // BeginFrame() opened the frame scope
+
+	uint32 mCaptureFramesLeft = 0;
+	std::vector<Event> mCapture;
+	std::vector<Event> mGathered; // scratch for EndFrame
+};
@@ -0,0 +1,351 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include "FileUtil.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+
+const ShaderCache::uint32 ShaderCache::Version;
+
+namespace
+{
+	const std::uint32_t kMagic = 0x43535452; // "RTSC"
+
+	struct FileHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint32_t KeySize;
+		std::uint32_t Pad;
+		std::uint64_t BytecodeSize;
+		std::uint64_t BytecodeHash;
+	};
+
+	static_assert(sizeof(FileHeader) == 32, "Shader cache header layout changed, bump ShaderCache::Version");
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+	}
+
+	std::string DirectoryOf(const std::string& path)
+	{
+		const size_t slash = path.find_last_of('/');
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	// Appends 'text' with its length, so neighbouring fields cannot run into each other.
+	void AppendField(std::string& key, const std::string& text)
+	{
+		key += std::to_string(text.size());
+		key += ':';
+		key += text;
+		key += ';';
+	}
+}
+
+std::vector<std::string> ShaderIncludeHasher::ParseIncludes(const char* text, std::size_t size)
+{
+	std::vector<std::string> includes;
+	const char* const end = text + size;
+	const char* p = text;
+	bool lineStart = true; // only whitespace since the last newline
+	while (p < end)
+	{
+		const char c = *p;
+		if (c == '/' && p + 1 < end && p[1] == '/')
+		{
+			while (p < end && *p != '\n')
+				++p;
+		}
+		else if (c == '/' && p + 1 < end && p[1] == '*')
+		{
+			p += 2;
+			while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+				++p;
+			p = p + 1 < end ? p + 2 : end;
+		}
+		else if (c == '"')
+		{
+			// A string literal, which may hold anything.
+			++p;
+			while (p < end && *p != '"' && *p != '\n')
+				p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+			if (p < end && *p == '"')
+				++p;
+		}
+		else if (c == '#' && lineStart)
+		{
+			++p;
+			while (p < end && IsSpace(*p))
+				++p;
+			const char kInclude[] = "include";
+			const size_t length = sizeof(kInclude) - 1;
+			if ((size_t)(end - p) > length && std::memcmp(p, kInclude, length) == 0)
+			{
+				p += length;
+				while (p < end && IsSpace(*p))
+					++p;
+				if (p < end && (*p == '"' || *p == '<'))
+				{
+					const char close = *p == '"' ? '"' : '>';
+					const char* name = ++p;
+					while (p < end && *p != close && *p != '\n')
+						++p;
+					if (p < end && *p == close)
+						includes.emplace_back(name, p);
+				}
+			}
+			// The rest of the directive.
+			while (p < end && *p != '\n')
+				++p;
+			lineStart = false;
+		}
+		else
+		{
+			if (c == '\n')
+				lineStart = true;
+			else if (!IsSpace(c))
+				lineStart = false;
+			++p;
+		}
+	}
+	return includes;
+}
+
+std::string ShaderIncludeHasher::NormalizePath(const std::string& path)
+{
+	std::vector<std::string> segments;
+	std::string segment;
+	const bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+	for (size_t i = 0; i <= path.size(); ++i)
+	{
+		const char c = i < path.size() ? path[i] : '/';
+		if (c != '/' && c != '\\')
+		{
+			segment += c;
+			continue;
+		}
+
+		if (segment == "..")
+		{
+			if (!segments.empty() && segments.back() != "..")
+				segments.pop_back();
+			else if (!absolute)
+				segments.push_back(segment);
+		}
+		else if (!segment.empty() && segment != ".")
+			segments.push_back(segment);
+		segment.clear();
+	}
+
+	std::string normalized = absolute ? "/" : "";
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		if (i != 0)
+			normalized += '/';
+		normalized += segments[i];
+	}
+	return normalized;
+}
+
+const ShaderIncludeHasher::File& ShaderIncludeHasher::GetFile(const std::string& path)
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		auto it = mFiles.find(path);
+		if (it != mFiles.end())
+			return it->second;
+	}
+
+	// Read outside the lock; two threads reading the same file both get the same result.
+	File file;
+	MappedFile mapped;
+	if (mapped.Open(path))
+	{
+		file.Found = true;
+		file.ContentHash = FileUtil::HashBytes(mapped.Data(), mapped.Size());
+		const std::string directory = DirectoryOf(path);
+		for (const std::string& name : ParseIncludes(reinterpret_cast<const char*>(mapped.Data()), mapped.Size()))
+			file.Includes.push_back(NormalizePath(directory + name));
+	}
+	else if (FileUtil::FileExists(path))
+	{
+		// Empty files cannot be mapped.
+		file.Found = true;
+		file.ContentHash = FileUtil::HashBytes(nullptr, 0);
+	}
+
+	std::lock_guard<std::mutex> lock(mLock);
+	// References into an unordered_map stay valid as it grows.
+	return mFiles.emplace(path, std::move(file)).first->second;
+}
+
+bool ShaderIncludeHasher::Closure(const std::string& path, std::vector<std::string>* files, std::string* error)
+{
+	files->clear();
+	const std::string root = NormalizePath(path);
+	if (!GetFile(root).Found)
+	{
+		*error = "cannot read " + path;
+		return false;
+	}
+
+	// Depth first, each file once, children in the order they are included.
+	std::unordered_set<std::string> visited;
+	std::vector<std::string> stack(1, root);
+	while (!stack.empty())
+	{
+		const std::string current = stack.back();
+		stack.pop_back();
+		if (!visited.insert(current).second)
+			continue;
+		files->push_back(current);
+
+		const File& file = GetFile(current);
+		for (auto it = file.Includes.rbegin(); it != file.Includes.rend(); ++it)
+		{
+			if (visited.count(*it) == 0)
+				stack.push_back(*it);
+		}
+	}
+	return true;
+}
+
+bool ShaderIncludeHasher::HashClosure(const std::string& path, uint64* hash, std::string* error)
+{
+	std::vector<std::string> files;
+	if (!Closure(path, &files, error))
+		return false;
+
+	uint64 h = FileUtil::HashSeed;
+	for (const std::string& name : files)
+	{
+		const File& file = GetFile(name);
+		h = FileUtil::HashString(name, h);
+		const std::uint8_t found = file.Found ? 1 : 0;
+		h = FileUtil::HashBytes(&found, sizeof(found), h);
+		h = FileUtil::HashBytes(&file.ContentHash, sizeof(file.ContentHash), h);
+	}
+	*hash = h;
+	return true;
+}
+
+void ShaderIncludeHasher::Clear()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFiles.clear();
+}
+
+ShaderCache::ShaderCache(const std::string& directory)
+	: mDirectory(directory)
+{
+}
+
+std::string ShaderCache::MakeKey(uint64 sourceHash, const std::string& entryPoint, const std::string& target,
+	const std::vector<std::pair<std::string, std::string>>& defines, const std::string& compiler)
+{
+	char hash[32];
+	snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)sourceHash);
+
+	std::string key;
+	AppendField(key, hash);
+	AppendField(key, entryPoint);
+	AppendField(key, target);
+	for (const auto& define : defines)
+	{
+		AppendField(key, define.first);
+		AppendField(key, define.second);
+	}
+	AppendField(key, compiler);
+	return key;
+}
+
+bool ShaderCache::KeyForFile(const std::string& path, const std::string& entryPoint, const std::string& target,
+	const std::vector<std::pair<std::string, std::string>>& defines, const std::string& compiler,
+	std::string* key)
+{
+	uint64 sourceHash = 0;
+	std::string error;
+	if (!mIncludes.HashClosure(path, &sourceHash, &error))
+		return false;
+	*key = MakeKey(sourceHash, entryPoint, target, defines, compiler);
+	return true;
+}
+
+std::string ShaderCache::PathForKey(const std::string& key)const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.shader", (unsigned long long)FileUtil::HashString(key));
+	return mDirectory.empty() ? std::string(name) : mDirectory + "/" + name;
+}
+
+bool ShaderCache::Load(const std::string& key, std::vector<std::uint8_t>* bytecode)
+{
+	MappedFile file;
+	bool hit = file.Open(PathForKey(key));
+
+	FileHeader header = {};
+	if (hit && file.Size() >= sizeof(header))
+		std::memcpy(&header, file.Data(), sizeof(header));
+	hit = hit &&
+		file.Size() >= sizeof(header) &&
+		header.Magic == kMagic &&
+		header.Version == Version &&
+		header.KeySize == key.size() &&
+		file.Size() == sizeof(header) + header.KeySize + header.BytecodeSize &&
+		std::memcmp(file.Data() + sizeof(header), key.data(), key.size()) == 0;
+
+	const std::uint8_t* data = hit ? file.Data() + sizeof(header) + header.KeySize : nullptr;
+	hit = hit && FileUtil::HashBytes(data, (size_t)header.BytecodeSize) == header.BytecodeHash;
+
+	if (hit)
+		bytecode->assign(data, data + header.BytecodeSize);
+
+	std::lock_guard<std::mutex> lock(mStatsLock);
+	if (hit)
+	{
+		++mStats.Hits;
+		mStats.BytesLoaded += header.BytecodeSize;
+	}
+	else
+		++mStats.Misses;
+	return hit;
+}
+
+bool ShaderCache::Store(const std::string& key, const void* bytecode, std::size_t size)
+{
+	if (!mDirectory.empty() && !FileUtil::CreateDirectories(mDirectory))
+		return false;
+
+	FileHeader header = {};
+	header.Magic = kMagic;
+	header.Version = Version;
+	header.KeySize = (uint32)key.size();
+	header.BytecodeSize = size;
+	header.BytecodeHash = FileUtil::HashBytes(bytecode, size);
+
+	std::vector<std::uint8_t> data(sizeof(header) + key.size() + size);
+	std::memcpy(data.data(), &header, sizeof(header));
+	std::memcpy(data.data() + sizeof(header), key.data(), key.size());
+	if (size != 0)
+		std::memcpy(data.data() + sizeof(header) + key.size(), bytecode, size);
+
+	if (!FileUtil::WriteFileAtomic(PathForKey(key), data.data(), data.size()))
+		return false;
+
+	std::lock_guard<std::mutex> lock(mStatsLock);
+	++mStats.Stores;
+	mStats.BytesStored += size;
+	return true;
+}
+
+ShaderCache::Stats ShaderCache::GetStats()const
+{
+	std::lock_guard<std::mutex> lock(mStatsLock);
+	return mStats;
+}
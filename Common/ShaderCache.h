@@ -0,0 +1,114 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Persistent cache of compiled shaders: bytecode stored on disk under a key made of
+// everything the compile depends on, so an unchanged shader is loaded instead of
+// compiled on the next launch.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Hashes a shader source together with every file it #includes, directly or not.  Each
+// file is read once per hasher, so the headers shared by most shaders are hashed once.
+// Every #include line counts, including ones the preprocessor would skip; that can only
+// cause a needless recompile.  Included files are looked for next to the file including
+// them, as D3D_COMPILE_STANDARD_FILE_INCLUDE and DXC's default handler do.  Thread safe.
+class ShaderIncludeHasher
+{
+public:
+	using uint64 = std::uint64_t;
+
+	// False, with the reason, only if 'path' itself cannot be read; an include that
+	// cannot be found is hashed as missing and left for the compiler to report.
+	bool HashClosure(const std::string& path, uint64* hash, std::string* error);
+
+	// The files HashClosure reads for 'path', 'path' first, in the order it hashes them.
+	bool Closure(const std::string& path, std::vector<std::string>* files, std::string* error);
+
+	// Forgets the files read, so edited shaders are read again.
+	void Clear();
+
+	// The names in the #include lines of 'text', outside comments, in order.
+	static std::vector<std::string> ParseIncludes(const char* text, std::size_t size);
+
+	// '/' separators, no "." segments, ".." folded into the directory before it.
+	static std::string NormalizePath(const std::string& path);
+
+private:
+	struct File
+	{
+		bool Found = false;
+		uint64 ContentHash = 0;
+		std::vector<std::string> Includes; // normalized paths
+	};
+
+	// The file at normalized 'path', read on first use.
+	const File& GetFile(const std::string& path);
+
+private:
+	std::mutex mLock;
+	std::unordered_map<std::string, File> mFiles;
+};
+
+// Compiled shaders in a directory, one file each, named by a hash of the key.  The file
+// repeats the key and a hash of the bytecode, so a collision of key hashes or a damaged
+// file is a miss rather than wrong code.  Files are written atomically, so several
+// processes can share the directory.  Thread safe.
+class ShaderCache
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint32 Version = 1;
+
+	struct Stats
+	{
+		uint32 Hits = 0;
+		uint32 Misses = 0;
+		uint32 Stores = 0;
+		uint64 BytesLoaded = 0;
+		uint64 BytesStored = 0;
+	};
+
+	// The directory is created on the first store.
+	explicit ShaderCache(const std::string& directory);
+	ShaderCache(const ShaderCache& rhs) = delete;
+	ShaderCache& operator=(const ShaderCache& rhs) = delete;
+
+	ShaderIncludeHasher& Includes() { return mIncludes; }
+
+	// Everything a compile depends on: the hash of the source and its includes, the
+	// entry point (empty for libraries), target profile, the defines in order, and the
+	// compiler, its version and flags.
+	static std::string MakeKey(uint64 sourceHash, const std::string& entryPoint, const std::string& target,
+		const std::vector<std::pair<std::string, std::string>>& defines, const std::string& compiler);
+
+	// The source hash of 'path' and the key, in one step; false if 'path' cannot be read,
+	// in which case there is nothing to cache.
+	bool KeyForFile(const std::string& path, const std::string& entryPoint, const std::string& target,
+		const std::vector<std::pair<std::string, std::string>>& defines, const std::string& compiler,
+		std::string* key);
+
+	bool Load(const std::string& key, std::vector<std::uint8_t>* bytecode);
+	bool Store(const std::string& key, const void* bytecode, std::size_t size);
+
+	std::string PathForKey(const std::string& key)const;
+
+	Stats GetStats()const;
+
+private:
+	const std::string mDirectory;
+	ShaderIncludeHasher mIncludes;
+
+	mutable std::mutex mStatsLock;
+	Stats mStats;
+};
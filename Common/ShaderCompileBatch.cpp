@@ -0,0 +1,107 @@
+//***************************************************************************************
+// ShaderCompileBatch.cpp
+//***************************************************************************************
+
+#include "ShaderCompileBatch.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+void ShaderCompileBatch::Add(const std::string& name, std::function<void()> compile)
+{
+	for (const Entry& entry : mEntries)
+	{
+		if (entry.Name == name)
+			throw std::logic_error("ShaderCompileBatch: " + name + " added twice");
+	}
+
+	Entry entry;
+	entry.Name = name;
+	entry.Compile = std::move(compile);
+	mEntries.push_back(std::move(entry));
+}
+
+bool ShaderCompileBatch::Run(JobSystem& jobs)
+{
+	mResults.assign(mEntries.size(), Result());
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<JobSystem::JobHandle> handles;
+	handles.reserve(mEntries.size());
+	for (size_t i = 0; i < mEntries.size(); ++i)
+	{
+		handles.push_back(jobs.Spawn([this, i]()
+		{
+			Result& result = mResults[i];
+			result.Name = mEntries[i].Name;
+			const auto compileStart = std::chrono::high_resolution_clock::now();
+			try
+			{
+				mEntries[i].Compile();
+			}
+			catch (const std::exception& e)
+			{
+				result.Failed = true;
+				result.Error = e.what();
+			}
+			catch (...)
+			{
+				result.Failed = true;
+				result.Error = "unknown error";
+			}
+			result.Ms = std::chrono::duration<double, std::milli>(
+				std::chrono::high_resolution_clock::now() - compileStart).count();
+		}));
+	}
+	for (const JobSystem::JobHandle& handle : handles)
+		jobs.Wait(handle);
+
+	mWallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return FailedCount() == 0;
+}
+
+ShaderCompileBatch::uint32 ShaderCompileBatch::FailedCount()const
+{
+	uint32 failed = 0;
+	for (const Result& result : mResults)
+		failed += result.Failed ? 1 : 0;
+	return failed;
+}
+
+double ShaderCompileBatch::SerialMs()const
+{
+	double sum = 0.0;
+	for (const Result& result : mResults)
+		sum += result.Ms;
+	return sum;
+}
+
+std::string ShaderCompileBatch::ErrorReport()const
+{
+	std::string report;
+	for (const Result& result : mResults)
+	{
+		if (result.Failed)
+			report += result.Name + ": " + result.Error + "\n";
+	}
+	return report;
+}
+
+std::string ShaderCompileBatch::TimingReport()const
+{
+	std::vector<const Result*> sorted;
+	for (const Result& result : mResults)
+		sorted.push_back(&result);
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Result* a, const Result* b) { return a->Ms > b->Ms; });
+
+	std::string report;
+	char line[32];
+	for (const Result* result : sorted)
+	{
+		snprintf(line, sizeof(line), "%10.2f ms  ", result->Ms);
+		report += line + result->Name + (result->Failed ? " (failed)\n" : "\n");
+	}
+	return report;
+}
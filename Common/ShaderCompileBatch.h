@@ -0,0 +1,83 @@
+//***************************************************************************************
+// ShaderCompileBatch.h
+//
+// Independent shader compiles run side by side on the job system at startup, with the
+// time each took and every failure reported together.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// A compile is a function that returns the bytecode or throws.  Run() spawns one job per
+// compile and waits for all of them, so a failure does not stop the others; its message
+// is kept and Run() returns false.  Results go into a map by name, written by the job of
+// that name only, so what comes out does not depend on which thread ran what or when.
+class ShaderCompileBatch
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct Result
+	{
+		std::string Name;
+		double Ms = 0.0;
+		bool Failed = false;
+		std::string Error;
+	};
+
+	ShaderCompileBatch() = default;
+	ShaderCompileBatch(const ShaderCompileBatch& rhs) = delete;
+	ShaderCompileBatch& operator=(const ShaderCompileBatch& rhs) = delete;
+
+	// Stores what 'compile' returns in (*blobs)[name].  Names must be unique within the
+	// batch; throws std::logic_error otherwise.  'blobs' must outlive the last Run().
+	template <typename Blob>
+	void Add(const std::string& name, std::map<std::string, Blob>* blobs, std::function<Blob()> compile)
+	{
+		// std::map does not move its elements, so each job writes to its own.
+		Blob* blob = &(*blobs)[name];
+		Add(name, [blob, compile]() { *blob = compile(); });
+	}
+
+	// Compiles in the order added, which is the order jobs are queued in: add the
+	// slowest first.  Another Run() compiles every shader again, for instance after
+	// the sources changed, and replaces the results of the one before.
+	bool Run(JobSystem& jobs);
+
+	uint32 Count()const { return (uint32)mEntries.size(); }
+	// In the order added.
+	const std::vector<Result>& Results()const { return mResults; }
+	uint32 FailedCount()const;
+
+	// From Run() starting to the last compile finishing, and the compile times added up:
+	// roughly what compiling one after another would have taken.
+	double WallMs()const { return mWallMs; }
+	double SerialMs()const;
+
+	// "<name>: <error>" per failure, in the order added.
+	std::string ErrorReport()const;
+	// "<ms> <name>" per compile, slowest first.
+	std::string TimingReport()const;
+
+private:
+	struct Entry
+	{
+		std::string Name;
+		std::function<void()> Compile;
+	};
+
+	void Add(const std::string& name, std::function<void()> compile);
+
+private:
+	std::vector<Entry> mEntries;
+	std::vector<Result> mResults;
+	double mWallMs = 0.0;
+};
@@ -243,6 +243,10 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	// We pause the game when the window is deactivated and unpause it 
 	// when it becomes active.  
 	case WM_ACTIVATE:
+		if( mRunWhenInactive )
+		{
+			return 0;
+		}
 		if( LOWORD(wParam) == WA_INACTIVE )
 		{
 			mAppPaused = true;
@@ -82,6 +82,7 @@ protected:
 	bool      mMinimized = false;  // is the application minimized?
 	bool      mMaximized = false;  // is the application maximized?
 	bool      mResizing = false;   // are the resize bars being dragged?
+	bool      mRunWhenInactive = false; // keep going without focus, e.g. for replays
     bool      mFullscreenState = false;// fullscreen enabled
 
 	// Set true to use 4X MSAA (?.1.8).  The default is false.
@@ -2,6 +2,7 @@
 #include "d3dUtil.h"
 #include <comdef.h>
 #include <fstream>
+#include <stdexcept>
 
 using Microsoft::WRL::ComPtr;
 
@@ -91,7 +92,8 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::wstring& filename,
 	const D3D_SHADER_MACRO* defines,
 	const std::string& entrypoint,
-	const std::string& target)
+	const std::string& target,
+	ShaderCache* cache)
 {
 	UINT compileFlags = 0;
 #if defined(DEBUG) || defined(_DEBUG)  
@@ -101,6 +103,26 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	HRESULT hr = S_OK;
 
 	ComPtr<ID3DBlob> byteCode = nullptr;
+
+	std::string key;
+	if(cache != nullptr)
+	{
+		std::vector<std::pair<std::string, std::string>> defineList;
+		for(const D3D_SHADER_MACRO* define = defines; define != nullptr && define->Name != nullptr; ++define)
+			defineList.emplace_back(define->Name, define->Definition != nullptr ? define->Definition : "");
+		const std::string compiler = "fxc " + std::to_string(D3D_COMPILER_VERSION) + " flags " + std::to_string(compileFlags);
+
+		std::vector<std::uint8_t> cached;
+		if(cache->KeyForFile(WStringToAnsi(filename), entrypoint, target, defineList, compiler, &key) &&
+			cache->Load(key, &cached))
+		{
+			ThrowIfFailed(D3DCreateBlob(cached.size(), &byteCode));
+			if(!cached.empty())
+				memcpy(byteCode->GetBufferPointer(), cached.data(), cached.size());
+			return byteCode;
+		}
+	}
+
 	ComPtr<ID3DBlob> errors;
 	hr = D3DCompileFromFile(filename.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		entrypoint.c_str(), target.c_str(), compileFlags, 0, &byteCode, &errors);
@@ -108,8 +130,15 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	if(errors != nullptr)
 		OutputDebugStringA((char*)errors->GetBufferPointer());
 
+	// With the compiler's messages, so they can be shown with those of other shaders.
+	if(FAILED(hr) && errors != nullptr)
+		throw std::runtime_error(WStringToAnsi(filename) + " " + entrypoint + ":\n" + (char*)errors->GetBufferPointer());
 	ThrowIfFailed(hr);
 
+	// An empty key means the source could not be hashed; the compile reports why.
+	if(cache != nullptr && !key.empty())
+		cache->Store(key, byteCode->GetBufferPointer(), byteCode->GetBufferSize());
+
 	return byteCode;
 }
 
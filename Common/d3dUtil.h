@@ -28,6 +28,7 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "ShaderCache.h"
 
 extern const int gNumFrameResources;
 
@@ -60,6 +61,13 @@ inline std::wstring AnsiToWString(const std::string& str)
     return std::wstring(buffer);
 }
 
+inline std::string WStringToAnsi(const std::wstring& str)
+{
+    char buffer[512];
+    WideCharToMultiByte(CP_ACP, 0, str.c_str(), -1, buffer, 512, nullptr, nullptr);
+    return std::string(buffer);
+}
+
 /*
 #if defined(_DEBUG)
     #ifndef Assert
@@ -121,11 +129,14 @@ public:
         UINT64 byteSize,
         Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
 
+	// With a cache, bytecode compiled earlier from the same sources, defines and
+	// compiler is loaded instead of compiled, and what is compiled is stored.
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
-		const std::string& target);
+		const std::string& target,
+		ShaderCache* cache = nullptr);
 };
 
 class DxException
@@ -182,6 +193,12 @@ struct MeshGeometry
     uint32_t VertexCount = 0;
     uint32_t IndexCount = 0;
 
+    // Set when the vertices use the packed format; positions then dequantize
+    // as PosL = q * PositionScale + PositionBias.
+    bool PackedVertices = false;
+    DirectX::XMFLOAT3 PositionScale = { 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT3 PositionBias = { 0.0f, 0.0f, 0.0f };
+
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
 	// the Submeshes individually.
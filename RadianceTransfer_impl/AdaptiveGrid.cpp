@@ -0,0 +1,343 @@
+#include "AdaptiveGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace DirectX;
+
+namespace AdaptiveGrid
+{
+
+namespace
+{
+	// Cells are (level, row, column) with level 0 the coarse grid; lattice points are
+	// (row, column) on the finest level, so a cell at level L spans 1 << (MaxLevels - L).
+	std::uint64_t CellKey(uint32 level, uint32 row, uint32 column)
+	{
+		return (std::uint64_t(level) << 56) | (std::uint64_t(row) << 28) | column;
+	}
+
+	uint32 CellLevel(std::uint64_t key) { return uint32(key >> 56); }
+	uint32 CellRow(std::uint64_t key) { return uint32(key >> 28) & 0x0fffffffu; }
+	uint32 CellColumn(std::uint64_t key) { return uint32(key) & 0x0fffffffu; }
+
+	std::uint64_t PointKey(uint32 row, uint32 column)
+	{
+		return (std::uint64_t(row) << 32) | column;
+	}
+
+	class Quadtree
+	{
+	public:
+		Quadtree(const Options& options, const Estimator& estimate)
+			: mOptions(options), mEstimate(estimate), mLattice(options.BaseCells << options.MaxLevels)
+		{
+		}
+
+		void Refine(Stats& stats)
+		{
+			for (uint32 row = 0; row < mOptions.BaseCells; ++row)
+			{
+				for (uint32 column = 0; column < mOptions.BaseCells; ++column)
+					Refine(0, row, column);
+			}
+			stats.Evaluations = uint32(mEstimates.size());
+		}
+
+		// Splits leaves until no two neighbours are more than one level apart.
+		void Balance(Stats& stats)
+		{
+			bool changed = true;
+			std::vector<std::uint64_t> leaves;
+			while (changed)
+			{
+				changed = false;
+				leaves.assign(mLeaves.begin(), mLeaves.end());
+				for (std::uint64_t key : leaves)
+				{
+					const uint32 level = CellLevel(key);
+					if (level < 2 || mLeaves.count(key) == 0)
+						continue;
+
+					const uint32 row = CellRow(key);
+					const uint32 column = CellColumn(key);
+					const int neighbours[4][2] = { { -1, 0 }, { 0, 1 }, { 1, 0 }, { 0, -1 } };
+					for (const auto& offset : neighbours)
+					{
+						if (!InDomain(level, int(row) + offset[0], int(column) + offset[1]))
+							continue;
+
+						const uint32 nRow = row + offset[0];
+						const uint32 nColumn = column + offset[1];
+						const int leafLevel = LeafLevel(level, nRow, nColumn);
+						if (leafLevel < 0 || uint32(leafLevel) + 1 >= level)
+							continue;
+
+						const uint32 shift = level - uint32(leafLevel);
+						Split(uint32(leafLevel), nRow >> shift, nColumn >> shift);
+						++stats.BalanceSplits;
+						changed = true;
+					}
+				}
+			}
+			stats.Leaves = uint32(mLeaves.size());
+		}
+
+		GeometryGenerator::MeshData Triangulate()
+		{
+			GeometryGenerator::MeshData mesh;
+
+			std::vector<std::uint64_t> leaves(mLeaves.begin(), mLeaves.end());
+			std::sort(leaves.begin(), leaves.end());
+
+			std::unordered_map<std::uint64_t, uint32> vertexIndices;
+			auto vertex = [&](uint32 row, uint32 column)
+			{
+				auto inserted = vertexIndices.insert(std::make_pair(PointKey(row, column), uint32(mesh.Vertices.size())));
+				if (inserted.second)
+				{
+					GeometryGenerator::Vertex v;
+					v.Position = Position(row, column);
+					v.Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+					v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+					v.TexC = XMFLOAT2(float(column) / mLattice, float(row) / mLattice);
+					mesh.Vertices.push_back(v);
+				}
+				return inserted.first->second;
+			};
+
+			for (std::uint64_t key : leaves)
+			{
+				const uint32 level = CellLevel(key);
+				const uint32 row = CellRow(key);
+				const uint32 column = CellColumn(key);
+				const uint32 size = CellSize(level);
+				const uint32 r0 = row * size, r1 = r0 + size;
+				const uint32 c0 = column * size, c1 = c0 + size;
+
+				// Edges in perimeter order, each with the neighbour across it.  A finer
+				// neighbour puts a vertex on the midpoint, which this cell must share.
+				const uint32 corners[4][2] = { { r0, c0 }, { r0, c1 }, { r1, c1 }, { r1, c0 } };
+				const int neighbours[4][2] = { { -1, 0 }, { 0, 1 }, { 1, 0 }, { 0, -1 } };
+
+				bool split[4];
+				bool anySplit = false;
+				for (int e = 0; e < 4; ++e)
+				{
+					const int nRow = int(row) + neighbours[e][0];
+					const int nColumn = int(column) + neighbours[e][1];
+					split[e] = InDomain(level, nRow, nColumn) && LeafLevel(level, uint32(nRow), uint32(nColumn)) < 0;
+					anySplit = anySplit || split[e];
+				}
+
+				if (!anySplit)
+				{
+					// Same two triangles as GeometryGenerator::CreateGrid.
+					const uint32 v00 = vertex(r0, c0), v01 = vertex(r0, c1);
+					const uint32 v10 = vertex(r1, c0), v11 = vertex(r1, c1);
+					const uint32 indices[6] = { v00, v01, v10, v10, v01, v11 };
+					mesh.Indices32.insert(mesh.Indices32.end(), indices, indices + 6);
+					continue;
+				}
+
+				std::vector<uint32> perimeter;
+				for (int e = 0; e < 4; ++e)
+				{
+					const uint32* a = corners[e];
+					const uint32* b = corners[(e + 1) % 4];
+					perimeter.push_back(vertex(a[0], a[1]));
+					if (split[e])
+						perimeter.push_back(vertex((a[0] + b[0]) / 2, (a[1] + b[1]) / 2));
+				}
+
+				const uint32 center = vertex(r0 + size / 2, c0 + size / 2);
+				for (size_t k = 0; k < perimeter.size(); ++k)
+				{
+					mesh.Indices32.push_back(center);
+					mesh.Indices32.push_back(perimeter[k]);
+					mesh.Indices32.push_back(perimeter[(k + 1) % perimeter.size()]);
+				}
+			}
+
+			return mesh;
+		}
+
+	private:
+		uint32 CellSize(uint32 level) const { return 1u << (mOptions.MaxLevels - level); }
+
+		bool InDomain(uint32 level, int row, int column) const
+		{
+			const int cells = int(mOptions.BaseCells << level);
+			return row >= 0 && column >= 0 && row < cells && column < cells;
+		}
+
+		XMFLOAT3 Position(uint32 row, uint32 column) const
+		{
+			return XMFLOAT3(-0.5f * mOptions.Width + mOptions.Width * column / mLattice, 0.0f,
+				0.5f * mOptions.Depth - mOptions.Depth * row / mLattice);
+		}
+
+		float Estimate(uint32 row, uint32 column)
+		{
+			auto found = mEstimates.find(PointKey(row, column));
+			if (found != mEstimates.end())
+				return found->second;
+
+			const float value = mEstimate(Position(row, column));
+			mEstimates[PointKey(row, column)] = value;
+			return value;
+		}
+
+		void Refine(uint32 level, uint32 row, uint32 column)
+		{
+			if (level < mOptions.MaxLevels)
+			{
+				// Corners, edge midpoints and center; the children reuse all of them.
+				const uint32 size = CellSize(level);
+				float lo = 1e30f, hi = -1e30f;
+				for (uint32 r = 0; r <= 2; ++r)
+				{
+					for (uint32 c = 0; c <= 2; ++c)
+					{
+						const float value = Estimate(row * size + r * size / 2, column * size + c * size / 2);
+						lo = (std::min)(lo, value);
+						hi = (std::max)(hi, value);
+					}
+				}
+
+				if (hi - lo > mOptions.Threshold)
+				{
+					for (uint32 child = 0; child < 4; ++child)
+						Refine(level + 1, 2 * row + child / 2, 2 * column + child % 2);
+					return;
+				}
+			}
+
+			mLeaves.insert(CellKey(level, row, column));
+		}
+
+		void Split(uint32 level, uint32 row, uint32 column)
+		{
+			mLeaves.erase(CellKey(level, row, column));
+			for (uint32 child = 0; child < 4; ++child)
+				mLeaves.insert(CellKey(level + 1, 2 * row + child / 2, 2 * column + child % 2));
+		}
+
+		// Level of the leaf covering cell (level, row, column), or -1 when that cell is
+		// split into finer leaves.
+		int LeafLevel(uint32 level, uint32 row, uint32 column) const
+		{
+			for (int k = int(level); k >= 0; --k)
+			{
+				const uint32 shift = level - uint32(k);
+				if (mLeaves.count(CellKey(uint32(k), row >> shift, column >> shift)) != 0)
+					return k;
+			}
+			return -1;
+		}
+
+	private:
+		const Options& mOptions;
+		const Estimator& mEstimate;
+		const uint32 mLattice;
+
+		std::unordered_set<std::uint64_t> mLeaves;
+		std::unordered_map<std::uint64_t, float> mEstimates;
+	};
+}
+
+GeometryGenerator::MeshData CreateGrid(const Options& options, const Estimator& estimate, Stats* stats)
+{
+	Stats localStats;
+	Quadtree tree(options, estimate);
+	tree.Refine(localStats);
+	tree.Balance(localStats);
+	if (stats != nullptr)
+		*stats = localStats;
+	return tree.Triangulate();
+}
+
+Reference SampleReference(float width, float depth, uint32 samples, const Estimator& estimate)
+{
+	Reference reference;
+	reference.Width = width;
+	reference.Depth = depth;
+	reference.Samples = samples;
+	reference.Values.resize(size_t(samples) * samples);
+	for (uint32 row = 0; row < samples; ++row)
+	{
+		for (uint32 column = 0; column < samples; ++column)
+		{
+			const XMFLOAT3 p(-0.5f * width + width * (column + 0.5f) / samples, 0.0f,
+				0.5f * depth - depth * (row + 0.5f) / samples);
+			reference.Values[size_t(row) * samples + column] = estimate(p);
+		}
+	}
+	return reference;
+}
+
+Error MeasureError(const GeometryGenerator::MeshData& mesh, const std::vector<float>& vertexValues,
+	const Reference& reference)
+{
+	const uint32 samples = reference.Samples;
+	std::vector<char> covered(size_t(samples) * samples, 0);
+
+	// Lattice coordinates of a grid-space position.
+	auto column = [&](float x) { return (x + 0.5f * reference.Width) / reference.Width * samples - 0.5f; };
+	auto row = [&](float z) { return (0.5f * reference.Depth - z) / reference.Depth * samples - 0.5f; };
+
+	double sumSq = 0.0;
+	double count = 0.0;
+	float maxError = 0.0f;
+	for (size_t t = 0; t + 2 < mesh.Indices32.size(); t += 3)
+	{
+		float px[3], py[3], value[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32 v = mesh.Indices32[t + k];
+			px[k] = column(mesh.Vertices[v].Position.x);
+			py[k] = row(mesh.Vertices[v].Position.z);
+			value[k] = vertexValues[v];
+		}
+
+		const float area = (px[1] - px[0]) * (py[2] - py[0]) - (px[2] - px[0]) * (py[1] - py[0]);
+		if (area == 0.0f)
+			continue;
+
+		const int x0 = (std::max)(int(std::ceil((std::min)({ px[0], px[1], px[2] }))), 0);
+		const int x1 = (std::min)(int(std::floor((std::max)({ px[0], px[1], px[2] }))), int(samples) - 1);
+		const int y0 = (std::max)(int(std::ceil((std::min)({ py[0], py[1], py[2] }))), 0);
+		const int y1 = (std::min)(int(std::floor((std::max)({ py[0], py[1], py[2] }))), int(samples) - 1);
+		for (int y = y0; y <= y1; ++y)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				const size_t sample = size_t(y) * samples + x;
+				if (covered[sample])
+					continue;
+
+				// Barycentrics of the sample, positive inside for either winding.
+				const float b0 = ((px[1] - x) * (py[2] - y) - (px[2] - x) * (py[1] - y)) / area;
+				const float b1 = ((px[2] - x) * (py[0] - y) - (px[0] - x) * (py[2] - y)) / area;
+				const float b2 = 1.0f - b0 - b1;
+				if (b0 < -1e-5f || b1 < -1e-5f || b2 < -1e-5f)
+					continue;
+
+				covered[sample] = 1;
+				const float error = std::fabs(b0 * value[0] + b1 * value[1] + b2 * value[2] - reference.Values[sample]);
+				sumSq += double(error) * error;
+				count += 1.0;
+				maxError = (std::max)(maxError, error);
+			}
+		}
+	}
+
+	Error result;
+	result.Rms = count > 0.0 ? float(std::sqrt(sumSq / count)) : 0.0f;
+	result.Max = maxError;
+	return result;
+}
+
+} // namespace AdaptiveGrid
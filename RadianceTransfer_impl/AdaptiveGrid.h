@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "../Common/GeometryGenerator.h"
+
+// Receiver grid refined where the transfer changes, instead of uniformly.
+//
+// A coarse grid of cells is refined as a quadtree: a cell splits while the transfer
+// estimate at its corners, edge midpoints and center spans more than a threshold.
+// The tree is then balanced so neighbouring leaves differ by at most one level, and
+// every leaf with a finer neighbour is fanned around its center through the shared
+// edge midpoints, so the mesh has no T-junctions and no cracks.
+//
+// Vertices use the GeometryGenerator::CreateGrid conventions (y = 0, +y normal, +x
+// tangent, uv stretched over the grid, same winding), so the grid render item and its
+// shaders do not change.
+namespace AdaptiveGrid
+{
+	using uint32 = std::uint32_t;
+
+	// Transfer estimate at a position in grid space, e.g. the unoccluded fraction of a
+	// fixed set of directions.  Called once per distinct lattice point.
+	using Estimator = std::function<float(const DirectX::XMFLOAT3& position)>;
+
+	struct Options
+	{
+		float Width = 10.0f;
+		float Depth = 10.0f;
+
+		// Coarse cells along each side, and splits allowed below them; the finest cell is
+		// (BaseCells << MaxLevels) across.
+		uint32 BaseCells = 32;
+		uint32 MaxLevels = 4;
+
+		// Largest spread of the estimate tolerated inside one cell.
+		float Threshold = 0.05f;
+	};
+
+	struct Stats
+	{
+		uint32 Leaves = 0;
+		uint32 BalanceSplits = 0;
+		uint32 Evaluations = 0;
+	};
+
+	GeometryGenerator::MeshData CreateGrid(const Options& options, const Estimator& estimate, Stats* stats = nullptr);
+
+	// Dense samples of the estimate at the centers of a samples x samples lattice over the grid.
+	struct Reference
+	{
+		float Width = 0.0f;
+		float Depth = 0.0f;
+		uint32 Samples = 0;
+		std::vector<float> Values;
+	};
+
+	Reference SampleReference(float width, float depth, uint32 samples, const Estimator& estimate);
+
+	// Error of per-vertex values interpolated across the triangles, which is how the
+	// rasterizer reconstructs per-vertex transfer, against the reference samples.
+	struct Error
+	{
+		float Rms = 0.0f;
+		float Max = 0.0f;
+	};
+
+	Error MeasureError(const GeometryGenerator::MeshData& mesh, const std::vector<float>& vertexValues,
+		const Reference& reference);
+}
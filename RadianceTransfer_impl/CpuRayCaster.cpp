@@ -0,0 +1,210 @@
+#include "CpuRayCaster.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const std::uint32_t kLeafSize = 4;
+
+	XMFLOAT3 Transform(const XMFLOAT3& p, const XMFLOAT4X4& m)
+	{
+		return XMFLOAT3(
+			p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+			p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+			p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2]);
+	}
+
+	XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	float Axis(const XMFLOAT3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	void Grow(XMFLOAT3& lo, XMFLOAT3& hi, const XMFLOAT3& p)
+	{
+		lo = XMFLOAT3((std::min)(lo.x, p.x), (std::min)(lo.y, p.y), (std::min)(lo.z, p.z));
+		hi = XMFLOAT3((std::max)(hi.x, p.x), (std::max)(hi.y, p.y), (std::max)(hi.z, p.z));
+	}
+}
+
+void CpuRayCaster::AddMesh(const GeometryGenerator::Vertex* vertices, const std::uint32_t* indices, size_t indexCount,
+	const XMFLOAT4X4& world)
+{
+	mTriangles.reserve(mTriangles.size() + indexCount / 3);
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const XMFLOAT3 p0 = Transform(vertices[indices[i + 0]].Position, world);
+		const XMFLOAT3 p1 = Transform(vertices[indices[i + 1]].Position, world);
+		const XMFLOAT3 p2 = Transform(vertices[indices[i + 2]].Position, world);
+		mTriangles.push_back({ p0, Sub(p1, p0), Sub(p2, p0) });
+	}
+}
+
+void CpuRayCaster::Build()
+{
+	mNodes.clear();
+	if (mTriangles.empty())
+		return;
+
+	std::vector<XMFLOAT3> centroids(mTriangles.size());
+	std::vector<std::uint32_t> order(mTriangles.size());
+	for (size_t i = 0; i < mTriangles.size(); ++i)
+	{
+		const Triangle& t = mTriangles[i];
+		centroids[i] = XMFLOAT3(t.P0.x + (t.E1.x + t.E2.x) / 3.0f, t.P0.y + (t.E1.y + t.E2.y) / 3.0f,
+			t.P0.z + (t.E1.z + t.E2.z) / 3.0f);
+		order[i] = std::uint32_t(i);
+	}
+
+	mNodes.reserve(2 * mTriangles.size() / kLeafSize + 1);
+	BuildNode(order, 0, std::uint32_t(order.size()), centroids);
+
+	// Leaves index the triangles directly.
+	std::vector<Triangle> sorted(mTriangles.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		sorted[i] = mTriangles[order[i]];
+	mTriangles.swap(sorted);
+}
+
+std::uint32_t CpuRayCaster::BuildNode(std::vector<std::uint32_t>& order, std::uint32_t first, std::uint32_t count,
+	const std::vector<XMFLOAT3>& centroids)
+{
+	const std::uint32_t index = std::uint32_t(mNodes.size());
+	mNodes.push_back(Node());
+
+	Node node;
+	node.Lo = node.Hi = mTriangles[order[first]].P0;
+	XMFLOAT3 centroidLo = centroids[order[first]];
+	XMFLOAT3 centroidHi = centroidLo;
+	for (std::uint32_t i = first; i < first + count; ++i)
+	{
+		const Triangle& t = mTriangles[order[i]];
+		Grow(node.Lo, node.Hi, t.P0);
+		Grow(node.Lo, node.Hi, XMFLOAT3(t.P0.x + t.E1.x, t.P0.y + t.E1.y, t.P0.z + t.E1.z));
+		Grow(node.Lo, node.Hi, XMFLOAT3(t.P0.x + t.E2.x, t.P0.y + t.E2.y, t.P0.z + t.E2.z));
+		Grow(centroidLo, centroidHi, centroids[order[i]]);
+	}
+
+	const XMFLOAT3 extent = Sub(centroidHi, centroidLo);
+	const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	if (count <= kLeafSize || Axis(extent, axis) == 0.0f)
+	{
+		node.First = first;
+		node.Count = count;
+		mNodes[index] = node;
+		return index;
+	}
+
+	// Median split along the longest centroid axis.
+	const std::uint32_t half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+		[&](std::uint32_t a, std::uint32_t b) { return Axis(centroids[a], axis) < Axis(centroids[b], axis); });
+
+	BuildNode(order, first, half, centroids);
+	node.First = BuildNode(order, first + half, count - half, centroids);
+	node.Count = 0;
+	mNodes[index] = node;
+	return index;
+}
+
+bool CpuRayCaster::Occluded(const XMFLOAT3& origin, const XMFLOAT3& direction, float tMin, float tMax) const
+{
+	return Trace(origin, direction, tMin, tMax, nullptr);
+}
+
+bool CpuRayCaster::Intersect(const XMFLOAT3& origin, const XMFLOAT3& direction, float tMin, float tMax, float* t) const
+{
+	return Trace(origin, direction, tMin, tMax, t);
+}
+
+bool CpuRayCaster::Trace(const XMFLOAT3& origin, const XMFLOAT3& direction, float tMin, float tMax, float* closest) const
+{
+	if (mNodes.empty())
+		return false;
+
+	const XMFLOAT3 invDir(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	bool found = false;
+	std::uint32_t stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = mNodes[stack[--top]];
+
+		// Slab test.
+		float t0 = tMin;
+		float t1 = tMax;
+		for (int k = 0; k < 3; ++k)
+		{
+			const float o = Axis(origin, k);
+			const float inv = Axis(invDir, k);
+			float tNear = (Axis(node.Lo, k) - o) * inv;
+			float tFar = (Axis(node.Hi, k) - o) * inv;
+			if (tNear > tFar)
+				std::swap(tNear, tFar);
+			t0 = tNear > t0 ? tNear : t0;
+			t1 = tFar < t1 ? tFar : t1;
+		}
+		if (t0 > t1)
+			continue;
+
+		if (node.Count == 0)
+		{
+			stack[top++] = std::uint32_t(&node - mNodes.data()) + 1;
+			stack[top++] = node.First;
+			continue;
+		}
+
+		// Moller-Trumbore, both faces.
+		for (std::uint32_t i = node.First; i < node.First + node.Count; ++i)
+		{
+			const Triangle& t = mTriangles[i];
+			const XMFLOAT3 p = Cross(direction, t.E2);
+			const float det = Dot(t.E1, p);
+			if (std::fabs(det) < 1e-12f)
+				continue;
+
+			const float invDet = 1.0f / det;
+			const XMFLOAT3 s = Sub(origin, t.P0);
+			const float u = Dot(s, p) * invDet;
+			if (u < 0.0f || u > 1.0f)
+				continue;
+
+			const XMFLOAT3 q = Cross(s, t.E1);
+			const float v = Dot(direction, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f)
+				continue;
+
+			const float hit = Dot(t.E2, q) * invDet;
+			if (hit >= tMin && hit <= tMax)
+			{
+				if (closest == nullptr)
+					return true;
+				// Later nodes only need to beat this hit.
+				found = true;
+				tMax = hit;
+				*closest = hit;
+			}
+		}
+	}
+
+	return found;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../Common/GeometryGenerator.h"
+
+// Any-hit ray caster over world space triangles, for comparing what a proxy mesh
+// occludes against the full mesh on the CPU.  Mirrors the visibility rays of the ray
+// generation shaders: any hit counts, from either side of a triangle.  Intersect finds
+// the closest one instead, for the probe volume's CPU reference.
+class CpuRayCaster
+{
+public:
+	// Bakes the triangles into world space with the row-vector matrix 'world'.
+	void AddMesh(const GeometryGenerator::Vertex* vertices, const std::uint32_t* indices, size_t indexCount,
+		const DirectX::XMFLOAT4X4& world);
+
+	// Builds the BVH; call after the last AddMesh.
+	void Build();
+
+	bool Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float tMin, float tMax) const;
+
+	// The closest hit in [tMin, tMax], as the probe rays find it; false on a miss.
+	bool Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float tMin, float tMax,
+		float* t) const;
+
+	size_t TriangleCount() const { return mTriangles.size(); }
+
+private:
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 P0;
+		DirectX::XMFLOAT3 E1;
+		DirectX::XMFLOAT3 E2;
+	};
+
+	struct Node
+	{
+		DirectX::XMFLOAT3 Lo;
+		DirectX::XMFLOAT3 Hi;
+		// Leaves: triangles [First, First + Count).  Inner nodes: Count == 0, children
+		// at this node + 1 and at First.
+		std::uint32_t First;
+		std::uint32_t Count;
+	};
+
+	// Any hit if 'closest' is null, otherwise the closest one, written there.
+	bool Trace(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float tMin, float tMax,
+		float* closest) const;
+
+	std::uint32_t BuildNode(std::vector<std::uint32_t>& order, std::uint32_t first, std::uint32_t count,
+		const std::vector<DirectX::XMFLOAT3>& centroids);
+
+	std::vector<Triangle> mTriangles;
+	std::vector<Node> mNodes;
+};
@@ -0,0 +1,68 @@
+#include "D3D12DescriptorHeap.h"
+
+D3D12DescriptorHeap::D3D12DescriptorHeap(ID3D12Device* device, uint32 capacity, uint32 transientCapacity)
+	: md3dDevice(device), mAllocator(capacity, transientCapacity)
+{
+	mDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = capacity;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mStaging)));
+
+	heapDesc.NumDescriptors = capacity + transientCapacity;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mShaderVisible)));
+
+	mStagingStart = mStaging->GetCPUDescriptorHandleForHeapStart();
+	mShaderVisibleCpuStart = mShaderVisible->GetCPUDescriptorHandleForHeapStart();
+	mShaderVisibleGpuStart = mShaderVisible->GetGPUDescriptorHandleForHeapStart();
+}
+
+void D3D12DescriptorHeap::CopyDirty()
+{
+	mRuns.clear();
+	mAllocator.TakeDirtyRuns(&mRuns);
+	if (mRuns.empty())
+		return;
+
+	// Runs land on the same slots, so the one list of starts and sizes serves for both
+	// heaps; the source starts are in the staging heap, the destinations computed after.
+	mCopyStarts.resize(mRuns.size() * 2);
+	mCopySizes.resize(mRuns.size());
+	for (size_t i = 0; i < mRuns.size(); ++i)
+	{
+		mCopyStarts[i] = CD3DX12_CPU_DESCRIPTOR_HANDLE(mShaderVisibleCpuStart, mRuns[i].First, mDescriptorSize);
+		mCopyStarts[mRuns.size() + i] = CD3DX12_CPU_DESCRIPTOR_HANDLE(mStagingStart, mRuns[i].First, mDescriptorSize);
+		mCopySizes[i] = mRuns[i].Count;
+	}
+
+	md3dDevice->CopyDescriptors(
+		(UINT)mRuns.size(), mCopyStarts.data(), mCopySizes.data(),
+		(UINT)mRuns.size(), mCopyStarts.data() + mRuns.size(), mCopySizes.data(),
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE D3D12DescriptorHeap::BuildTable(std::initializer_list<TableEntry> ranges)
+{
+	uint32 count = 0;
+	mCopyStarts.clear();
+	mCopySizes.clear();
+	for (const TableEntry& range : ranges)
+	{
+		mCopyStarts.push_back(CD3DX12_CPU_DESCRIPTOR_HANDLE(mStagingStart, range.First, mDescriptorSize));
+		mCopySizes.push_back(range.Count);
+		count += range.Count;
+	}
+
+	const DescriptorAllocator::Range table = mAllocator.AllocateTransient(count);
+	const D3D12_CPU_DESCRIPTOR_HANDLE destStart =
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(mShaderVisibleCpuStart, table.First, mDescriptorSize);
+
+	md3dDevice->CopyDescriptors(1, &destStart, &count,
+		(UINT)mCopySizes.size(), mCopyStarts.data(), mCopySizes.data(),
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(mShaderVisibleGpuStart, table.First, mDescriptorSize);
+}
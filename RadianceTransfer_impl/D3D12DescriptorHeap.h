@@ -0,0 +1,111 @@
+#pragma once
+
+#include <initializer_list>
+#include <vector>
+
+#include "../Common/d3dUtil.h"
+#include "DescriptorAllocator.h"
+
+// The app's CBV/SRV/UAV descriptors, in two heaps with the same slots: views are written
+// into a CPU-only staging heap, and copied into the shader-visible heap by CopyDirty().
+// The staging heap doubles as the CPU-side descriptor UAV clears need.  The
+// shader-visible heap has a ring of per-frame tables after the persistent slots, for
+// tables gathered from descriptors that are not adjacent.
+class D3D12DescriptorHeap
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	D3D12DescriptorHeap(ID3D12Device* device, uint32 capacity, uint32 transientCapacity);
+	D3D12DescriptorHeap(const D3D12DescriptorHeap& rhs) = delete;
+	D3D12DescriptorHeap& operator=(const D3D12DescriptorHeap& rhs) = delete;
+
+	SrvRange AllocateSrv(uint32 count) { return Typed<DescriptorKind::Srv>(mAllocator.Allocate(count)); }
+	UavRange AllocateUav(uint32 count) { return Typed<DescriptorKind::Uav>(mAllocator.Allocate(count)); }
+	template<DescriptorKind Kind>
+	void Free(const DescriptorRange<Kind>& range) { mAllocator.Free(Untyped(range)); }
+
+	// Where to write descriptor 'index' of 'range'; it reaches the shaders with the next
+	// CopyDirty().
+	template<DescriptorKind Kind>
+	D3D12_CPU_DESCRIPTOR_HANDLE WriteHandle(const DescriptorRange<Kind>& range, uint32 index = 0)
+	{
+		mAllocator.MarkDirty(Untyped(range.Sub(index)));
+		return StagingHandle(range, index);
+	}
+
+	// For views rewritten in place by whoever was given their WriteHandle.
+	template<DescriptorKind Kind>
+	void MarkDirty(const DescriptorRange<Kind>& range) { mAllocator.MarkDirty(Untyped(range)); }
+
+	template<DescriptorKind Kind>
+	D3D12_CPU_DESCRIPTOR_HANDLE StagingHandle(const DescriptorRange<Kind>& range, uint32 index = 0)const
+	{
+		return CD3DX12_CPU_DESCRIPTOR_HANDLE(mStagingStart, range.First + index, mDescriptorSize);
+	}
+
+	template<DescriptorKind Kind>
+	D3D12_GPU_DESCRIPTOR_HANDLE GpuHandle(const DescriptorRange<Kind>& range, uint32 index = 0)const
+	{
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(mShaderVisibleGpuStart, range.First + index, mDescriptorSize);
+	}
+
+	// Copies the descriptors written since the last call into the shader-visible heap, a
+	// copy per run of adjacent slots.  Only while the GPU is not reading them.
+	void CopyDirty();
+
+	// Frees the tables of the frames the GPU has finished, and tags this frame's.
+	void BeginFrame(uint64 completedFence) { mAllocator.BeginFrame(completedFence); }
+	void EndFrame(uint64 fence) { mAllocator.EndFrame(fence); }
+
+	// A table of this frame holding 'ranges' back to back, copied in one call.
+	struct TableEntry
+	{
+		uint32 First;
+		uint32 Count;
+
+		template<DescriptorKind Kind>
+		TableEntry(const DescriptorRange<Kind>& range) : First(range.First), Count(range.Count) {}
+	};
+	D3D12_GPU_DESCRIPTOR_HANDLE BuildTable(std::initializer_list<TableEntry> ranges);
+
+	ID3D12DescriptorHeap* ShaderVisibleHeap()const { return mShaderVisible.Get(); }
+	const DescriptorAllocator::Stats& GetStats()const { return mAllocator.GetStats(); }
+
+private:
+	template<DescriptorKind Kind>
+	static DescriptorRange<Kind> Typed(const DescriptorAllocator::Range& range)
+	{
+		DescriptorRange<Kind> typed;
+		typed.First = range.First;
+		typed.Count = range.Count;
+		return typed;
+	}
+
+	template<DescriptorKind Kind>
+	static DescriptorAllocator::Range Untyped(const DescriptorRange<Kind>& range)
+	{
+		DescriptorAllocator::Range untyped;
+		untyped.First = range.First;
+		untyped.Count = range.Count;
+		return untyped;
+	}
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	UINT mDescriptorSize = 0;
+
+	DescriptorAllocator mAllocator;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mStaging;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mShaderVisible;
+	D3D12_CPU_DESCRIPTOR_HANDLE mStagingStart = {};
+	D3D12_CPU_DESCRIPTOR_HANDLE mShaderVisibleCpuStart = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE mShaderVisibleGpuStart = {};
+
+	// Scratch for the copy calls.
+	std::vector<DescriptorAllocator::Range> mRuns;
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCopyStarts;
+	std::vector<UINT> mCopySizes;
+};
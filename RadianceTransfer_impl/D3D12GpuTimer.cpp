@@ -0,0 +1,119 @@
+#include "D3D12GpuTimer.h"
+
+#include <algorithm>
+
+D3D12GpuTimer::D3D12GpuTimer(ID3D12Device* device, ID3D12CommandQueue* queue, uint32 maxPasses)
+	: mQueue(queue), mMaxPasses(maxPasses)
+{
+	ThrowIfFailed(mQueue->GetTimestampFrequency(&mFrequency));
+
+	D3D12_QUERY_HEAP_DESC queryDesc = {};
+	queryDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryDesc.Count = FrameCount * mMaxPasses * 2;
+	ThrowIfFailed(device->CreateQueryHeap(&queryDesc, IID_PPV_ARGS(&mQueries)));
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(queryDesc.Count * sizeof(uint64)),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&mReadback)));
+
+	for (Frame& frame : mFrames)
+	{
+		ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(frame.Allocator.GetAddressOf())));
+		ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			frame.Allocator.Get(), nullptr, IID_PPV_ARGS(frame.List.GetAddressOf())));
+		ThrowIfFailed(frame.List->Close());
+	}
+}
+
+void D3D12GpuTimer::BeginFrame(uint32 passCount)
+{
+	mCurrent = (mCurrent + 1) % FrameCount;
+	Frame& frame = mFrames[mCurrent];
+	mTiming = !frame.Pending;
+	if (!mTiming)
+		return;
+
+	frame.PassCount = (std::min)(passCount, mMaxPasses);
+	frame.Names.clear();
+	frame.Fence = 0;
+}
+
+void D3D12GpuTimer::Begin(ID3D12GraphicsCommandList* cmdList, uint32 pass)
+{
+	if (mTiming && pass < mFrames[mCurrent].PassCount)
+		cmdList->EndQuery(mQueries.Get(), D3D12_QUERY_TYPE_TIMESTAMP, FirstQuery(mCurrent) + pass * 2);
+}
+
+void D3D12GpuTimer::End(ID3D12GraphicsCommandList* cmdList, uint32 pass)
+{
+	if (mTiming && pass < mFrames[mCurrent].PassCount)
+		cmdList->EndQuery(mQueries.Get(), D3D12_QUERY_TYPE_TIMESTAMP, FirstQuery(mCurrent) + pass * 2 + 1);
+}
+
+ID3D12CommandList* D3D12GpuTimer::ResolveList()
+{
+	Frame& frame = mFrames[mCurrent];
+	if (!mTiming || frame.PassCount == 0)
+		return nullptr;
+
+	// Not pending, so the GPU is done with the allocator.
+	ThrowIfFailed(frame.Allocator->Reset());
+	ThrowIfFailed(frame.List->Reset(frame.Allocator.Get(), nullptr));
+	frame.List->ResolveQueryData(mQueries.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		FirstQuery(mCurrent), frame.PassCount * 2, mReadback.Get(), FirstQuery(mCurrent) * sizeof(uint64));
+	ThrowIfFailed(frame.List->Close());
+	return frame.List.Get();
+}
+
+void D3D12GpuTimer::EndFrame(uint64 fence, const std::vector<const char*>& passNames)
+{
+	Frame& frame = mFrames[mCurrent];
+	if (!mTiming || frame.PassCount == 0)
+		return;
+
+	frame.Names.assign(passNames.begin(), passNames.begin() + (std::min)((uint32)passNames.size(), frame.PassCount));
+	frame.PassCount = (uint32)frame.Names.size();
+	frame.Fence = fence;
+	frame.Pending = true;
+	mTiming = false;
+}
+
+void D3D12GpuTimer::Collect(uint64 completedFence, Profiler& profiler)
+{
+	// Where the queue's clock is now on the profiler's, to place the passes on it.
+	uint64 gpuNow = 0;
+	uint64 cpuNow = 0;
+	ThrowIfFailed(mQueue->GetClockCalibration(&gpuNow, &cpuNow));
+	const double nowUs = profiler.NowUs();
+	const double usPerTick = 1e6 / (double)mFrequency;
+
+	for (uint32 i = 0; i < FrameCount; ++i)
+	{
+		Frame& frame = mFrames[i];
+		if (!frame.Pending || frame.Fence > completedFence)
+			continue;
+
+		const D3D12_RANGE read = { FirstQuery(i) * sizeof(uint64), (FirstQuery(i) + frame.PassCount * 2) * sizeof(uint64) };
+		const D3D12_RANGE written = { 0, 0 };
+		std::uint8_t* data = nullptr;
+		ThrowIfFailed(mReadback->Map(0, &read, reinterpret_cast<void**>(&data)));
+		const uint64* ticks = reinterpret_cast<const uint64*>(data + read.Begin);
+		for (uint32 pass = 0; pass < frame.PassCount; ++pass)
+		{
+			const uint64 begin = ticks[pass * 2];
+			const uint64 end = ticks[pass * 2 + 1];
+			if (end < begin)
+				continue;
+			profiler.AddGpuEvent(frame.Names[pass],
+				nowUs - (double)(gpuNow - begin) * usPerTick, (double)(end - begin) * usPerTick);
+		}
+		mReadback->Unmap(0, &written);
+
+		frame.Pending = false;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "../Common/d3dUtil.h"
+#include "../Common/Profiler.h"
+
+// Timestamps at the start and end of each pass list of a frame, resolved by a list of
+// its own submitted after the passes and read back once the frame's fence completes.
+// Queries are kept for FrameCount frames; a frame begun while its slot is still waiting
+// to be collected goes untimed rather than stall.
+class D3D12GpuTimer
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint32 FrameCount = 4;
+
+	D3D12GpuTimer(ID3D12Device* device, ID3D12CommandQueue* queue, uint32 maxPasses);
+	D3D12GpuTimer(const D3D12GpuTimer& rhs) = delete;
+	D3D12GpuTimer& operator=(const D3D12GpuTimer& rhs) = delete;
+
+	// Passes beyond the maximum go untimed.
+	void BeginFrame(uint32 passCount);
+	// The first and last commands of pass list 'pass'.
+	void Begin(ID3D12GraphicsCommandList* cmdList, uint32 pass);
+	void End(ID3D12GraphicsCommandList* cmdList, uint32 pass);
+	// The list copying this frame's timestamps out, or null if the frame goes untimed.
+	ID3D12CommandList* ResolveList();
+	// Names the passes, in list order, and tags the frame with the fence signalled after
+	// it.
+	void EndFrame(uint64 fence, const std::vector<const char*>& passNames);
+
+	// Gives the passes of the frames whose fence is at most 'completedFence' to
+	// 'profiler', on its clock.
+	void Collect(uint64 completedFence, Profiler& profiler);
+
+private:
+	struct Frame
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> List;
+		uint32 PassCount = 0;
+		std::vector<const char*> Names;
+		uint64 Fence = 0;
+		bool Pending = false; // resolved and not collected yet
+	};
+
+	uint32 FirstQuery(uint32 frame)const { return frame * mMaxPasses * 2; }
+
+private:
+	ID3D12CommandQueue* mQueue = nullptr;
+	uint32 mMaxPasses = 0;
+	uint64 mFrequency = 0; // ticks per second
+
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> mQueries;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mReadback;
+
+	Frame mFrames[FrameCount];
+	uint32 mCurrent = 0;
+	bool mTiming = false; // the current frame has a slot
+};
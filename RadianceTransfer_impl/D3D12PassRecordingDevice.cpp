@@ -0,0 +1,58 @@
+#include "D3D12PassRecordingDevice.h"
+
+D3D12PassRecordingDevice::D3D12PassRecordingDevice(ID3D12Device* device, ID3D12CommandQueue* queue)
+	: md3dDevice(device), mQueue(queue)
+{
+}
+
+void D3D12PassRecordingDevice::BeginFrame(uint32 listCount)
+{
+	while (mLists.size() < listCount)
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList5> list;
+		ThrowIfFailed(md3dDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(allocator.GetAddressOf())));
+		ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			allocator.Get(), nullptr, IID_PPV_ARGS(list.GetAddressOf())));
+		ThrowIfFailed(list->Close());
+
+		mAllocators.push_back(allocator);
+		mLists.push_back(list);
+	}
+
+	for (uint32 i = 0; i < listCount; ++i)
+		ThrowIfFailed(mAllocators[i]->Reset());
+
+	if (mTimer != nullptr)
+		mTimer->BeginFrame(listCount);
+}
+
+void D3D12PassRecordingDevice::Begin(uint32 index)
+{
+	ThrowIfFailed(mLists[index]->Reset(mAllocators[index].Get(), nullptr));
+	if (mTimer != nullptr)
+		mTimer->Begin(mLists[index].Get(), index);
+}
+
+void D3D12PassRecordingDevice::End(uint32 index)
+{
+	if (mTimer != nullptr)
+		mTimer->End(mLists[index].Get(), index);
+	ThrowIfFailed(mLists[index]->Close());
+}
+
+void D3D12PassRecordingDevice::Submit(uint32 listCount)
+{
+	mSubmission.resize(listCount);
+	for (uint32 i = 0; i < listCount; ++i)
+		mSubmission[i] = mLists[i].Get();
+	if (mTimer != nullptr)
+	{
+		if (ID3D12CommandList* resolve = mTimer->ResolveList())
+			mSubmission.push_back(resolve);
+	}
+
+	// One call, so the lists run back to back in this order.
+	mQueue->ExecuteCommandLists((UINT)mSubmission.size(), mSubmission.data());
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "../Common/d3dUtil.h"
+#include "D3D12GpuTimer.h"
+#include "PassRecorder.h"
+
+// PassRecordingDevice on the direct queue, with an allocator per command list.  The
+// app waits for its frame fence before recording, which is what BeginFrame relies on to
+// reset the allocators.  With a timer, each list is timed on the GPU and the timer's
+// resolve list goes out after the passes.
+class D3D12PassRecordingDevice : public PassRecordingDevice
+{
+public:
+	D3D12PassRecordingDevice(ID3D12Device* device, ID3D12CommandQueue* queue);
+	D3D12PassRecordingDevice(const D3D12PassRecordingDevice& rhs) = delete;
+	D3D12PassRecordingDevice& operator=(const D3D12PassRecordingDevice& rhs) = delete;
+
+	virtual void BeginFrame(uint32 listCount)override;
+	virtual void Begin(uint32 index)override;
+	virtual void End(uint32 index)override;
+	virtual void Submit(uint32 listCount)override;
+
+	// Null to stop timing; only between frames.
+	void SetTimer(D3D12GpuTimer* timer) { mTimer = timer; }
+
+	// The list a pass records into; open between Begin and End.
+	ID3D12GraphicsCommandList5* List(uint32 index)const { return mLists[index].Get(); }
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	ID3D12CommandQueue* mQueue = nullptr;
+	D3D12GpuTimer* mTimer = nullptr;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> mAllocators;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList5>> mLists;
+	std::vector<ID3D12CommandList*> mSubmission;
+};
@@ -0,0 +1,174 @@
+#include "D3D12ResourceHeaps.h"
+
+#include <stdexcept>
+
+D3D12ResourceHeaps::D3D12ResourceHeaps(ID3D12Device* device, uint64 heapSize)
+	: md3dDevice(device), mAllocator(*this, heapSize)
+{
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> D3D12ResourceHeaps::CreateResource(const D3D12_RESOURCE_DESC& desc,
+	D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, bool movable)
+{
+	const D3D12_RESOURCE_ALLOCATION_INFO info = md3dDevice->GetResourceAllocationInfo(0, 1, &desc);
+
+	Placed placed;
+	placed.Memory = mAllocator.Allocate(ClassOf(desc), info.SizeInBytes, info.Alignment, movable);
+	placed.Desc = desc;
+	placed.State = initialState;
+	if (clearValue != nullptr)
+	{
+		placed.HasClearValue = true;
+		placed.ClearValue = *clearValue;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+	try
+	{
+		resource = Place(placed, initialState);
+	}
+	catch (...)
+	{
+		mAllocator.Free(placed.Memory);
+		throw;
+	}
+
+	mPlaced[resource.Get()] = placed;
+	return resource;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> D3D12ResourceHeaps::CreateBuffer(uint64 size, D3D12_RESOURCE_FLAGS flags,
+	D3D12_RESOURCE_STATES initialState)
+{
+	return CreateResource(CD3DX12_RESOURCE_DESC::Buffer(size, flags), initialState);
+}
+
+void D3D12ResourceHeaps::Release(ID3D12Resource* resource)
+{
+	auto placed = mPlaced.find(resource);
+	if (placed == mPlaced.end())
+		throw std::logic_error("D3D12ResourceHeaps: releasing a resource that was not placed here");
+
+	mAllocator.Retire(placed->second.Memory);
+	mPlaced.erase(placed);
+
+	// Held until the memory is free, so the resource cannot outlive it.
+	Retired retired;
+	retired.Resource = resource;
+	mRetired.push_back(retired);
+}
+
+void D3D12ResourceHeaps::BeginFrame(uint64 completedFence)
+{
+	while (!mRetired.empty() && mRetired.front().Fence != 0 && mRetired.front().Fence <= completedFence)
+		mRetired.pop_front();
+	mAllocator.BeginFrame(completedFence);
+}
+
+void D3D12ResourceHeaps::EndFrame(uint64 fence)
+{
+	for (auto it = mRetired.rbegin(); it != mRetired.rend() && it->Fence == 0; ++it)
+		it->Fence = fence;
+	mAllocator.EndFrame(fence);
+}
+
+D3D12ResourceHeaps::uint32 D3D12ResourceHeaps::Defragment(ID3D12GraphicsCommandList* cmdList,
+	GpuMemoryClass memoryClass, uint64 maxBytes, const RelocatedCallback& relocated)
+{
+	const std::vector<GpuMemoryAllocator::Move> moves = mAllocator.PlanDefragmentation(memoryClass, maxBytes);
+	if (moves.empty())
+		return 0;
+
+	// Which resource sits in which allocation.
+	std::unordered_map<uint32, ID3D12Resource*> byNode;
+	for (const auto& placed : mPlaced)
+		byNode[placed.second.Memory.Node] = placed.first;
+
+	for (const GpuMemoryAllocator::Move& move : moves)
+	{
+		ID3D12Resource* from = byNode[move.From.Node];
+		Placed placed = mPlaced[from];
+		placed.Memory = move.To;
+		Microsoft::WRL::ComPtr<ID3D12Resource> to = Place(placed, D3D12_RESOURCE_STATE_COPY_DEST);
+
+		// The new resource takes over memory another may have used, and the copy
+		// initializes all of it.
+		D3D12_RESOURCE_BARRIER before[2] = { CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, to.Get()) };
+		UINT barrierCount = 1;
+		if (placed.State != D3D12_RESOURCE_STATE_COPY_SOURCE)
+			before[barrierCount++] = CD3DX12_RESOURCE_BARRIER::Transition(from, placed.State, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		cmdList->ResourceBarrier(barrierCount, before);
+		cmdList->CopyResource(to.Get(), from);
+		if (placed.State != D3D12_RESOURCE_STATE_COPY_DEST)
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(to.Get(), D3D12_RESOURCE_STATE_COPY_DEST, placed.State));
+
+		// Released first, so the original lives on whatever the callee drops.
+		Release(from);
+		mPlaced[to.Get()] = placed;
+		relocated(from, to.Get());
+	}
+
+	return (uint32)moves.size();
+}
+
+GpuMemoryClass D3D12ResourceHeaps::ClassOf(const D3D12_RESOURCE_DESC& desc)
+{
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		return GpuMemoryClass::Buffer;
+	if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		return GpuMemoryClass::RenderTarget;
+	return GpuMemoryClass::Texture;
+}
+
+D3D12ResourceHeaps::uint32 D3D12ResourceHeaps::CreateHeap(GpuMemoryClass memoryClass, uint64 size)
+{
+	// The classes tier 1 hardware keeps apart; render targets may be multisampled.
+	D3D12_HEAP_DESC heapDesc = {};
+	heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	switch (memoryClass)
+	{
+	case GpuMemoryClass::Buffer:
+		heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+		break;
+	case GpuMemoryClass::Texture:
+		heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+		break;
+	default:
+		heapDesc.Alignment = D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		break;
+	}
+	heapDesc.SizeInBytes = (size + heapDesc.Alignment - 1) & ~(heapDesc.Alignment - 1);
+
+	Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+	ThrowIfFailed(md3dDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap)));
+
+	uint32 id = 0;
+	while (id < mHeaps.size() && mHeaps[id] != nullptr)
+		++id;
+	if (id == mHeaps.size())
+		mHeaps.push_back(heap);
+	else
+		mHeaps[id] = heap;
+	return id;
+}
+
+void D3D12ResourceHeaps::DestroyHeap(uint32 id)
+{
+	mHeaps[id] = nullptr;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> D3D12ResourceHeaps::Place(const Placed& placed, D3D12_RESOURCE_STATES state)
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(md3dDevice->CreatePlacedResource(
+		mHeaps[placed.Memory.Heap].Get(),
+		placed.Memory.Offset,
+		&placed.Desc,
+		state,
+		placed.HasClearValue ? &placed.ClearValue : nullptr,
+		IID_PPV_ARGS(&resource)));
+	return resource;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "../Common/d3dUtil.h"
+#include "GpuMemoryAllocator.h"
+
+// Default-heap buffers and textures placed in large ID3D12Heaps, a set per memory class,
+// instead of each getting the implicit heap of a committed resource.  Release() frees a
+// resource's memory once the frame has completed on the GPU; a resource dropped without
+// it keeps its memory until the heaps go.  Placed resources must not outlive the heaps.
+class D3D12ResourceHeaps : private GpuMemoryDevice
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	D3D12ResourceHeaps(ID3D12Device* device, uint64 heapSize);
+	D3D12ResourceHeaps(const D3D12ResourceHeaps& rhs) = delete;
+	D3D12ResourceHeaps& operator=(const D3D12ResourceHeaps& rhs) = delete;
+
+	// Movable resources may be moved by Defragment(), and must be in 'initialState'
+	// whenever it is called.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateResource(const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue = nullptr, bool movable = false);
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(uint64 size, D3D12_RESOURCE_FLAGS flags,
+		D3D12_RESOURCE_STATES initialState);
+
+	// Throws std::logic_error for a resource that was not created here.
+	void Release(ID3D12Resource* resource);
+
+	// Frees what the frames whose fence is at most 'completedFence' released.
+	void BeginFrame(uint64 completedFence);
+	void EndFrame(uint64 fence);
+
+	// Told of each resource Defragment() moves and the copy replacing it, to swap its
+	// references and rewrite the views of the old one.
+	using RelocatedCallback = std::function<void(ID3D12Resource* from, ID3D12Resource* to)>;
+
+	// Records into 'cmdList' the copies that empty the sparsest heaps of 'memoryClass',
+	// at most 'maxBytes' of them, and releases the originals.  The list must run before
+	// anything that uses the copies.  Returns how many resources moved.
+	uint32 Defragment(ID3D12GraphicsCommandList* cmdList, GpuMemoryClass memoryClass, uint64 maxBytes,
+		const RelocatedCallback& relocated);
+
+	GpuMemoryAllocator::Stats GetStats(GpuMemoryClass memoryClass)const { return mAllocator.GetStats(memoryClass); }
+
+	static GpuMemoryClass ClassOf(const D3D12_RESOURCE_DESC& desc);
+
+private:
+	struct Placed
+	{
+		GpuMemoryAllocator::Allocation Memory;
+		D3D12_RESOURCE_DESC Desc = {};
+		D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;
+		bool HasClearValue = false;
+		D3D12_CLEAR_VALUE ClearValue = {};
+	};
+
+	struct Retired
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		uint64 Fence = 0; // 0 until the frame that released it ends
+	};
+
+	virtual uint32 CreateHeap(GpuMemoryClass memoryClass, uint64 size)override;
+	virtual void DestroyHeap(uint32 id)override;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> Place(const Placed& placed, D3D12_RESOURCE_STATES state);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	// Indexed by heap id; destroyed heaps leave a null the next heap takes.  Declared
+	// before the allocator, whose destructor destroys them.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>> mHeaps;
+	GpuMemoryAllocator mAllocator;
+
+	std::unordered_map<ID3D12Resource*, Placed> mPlaced;
+	std::deque<Retired> mRetired;
+};
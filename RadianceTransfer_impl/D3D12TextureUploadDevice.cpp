@@ -0,0 +1,188 @@
+#include "D3D12TextureUploadDevice.h"
+
+#include <stdexcept>
+
+using Microsoft::WRL::ComPtr;
+
+D3D12TextureUploadDevice::D3D12TextureUploadDevice(ID3D12Device* device, UINT64 uploadBytes)
+	: md3dDevice(device), mUploadBytes(uploadBytes)
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCopyQueue)));
+
+	mAllocators.resize(1);
+	ThrowIfFailed(md3dDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+		IID_PPV_ARGS(mAllocators[0].first.GetAddressOf())));
+	ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY,
+		mAllocators[0].first.Get(), nullptr, IID_PPV_ARGS(mCommandList.GetAddressOf())));
+	ThrowIfFailed(mCommandList->Close());
+
+	ThrowIfFailed(md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(mUploadBytes),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mUploadBuffer)));
+
+	// Stays mapped; the streamer only writes ranges the copy queue is done with.
+	ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mUploadMemory)));
+}
+
+D3D12TextureUploadDevice::~D3D12TextureUploadDevice()
+{
+	if (mFence != nullptr)
+		WaitForFence(mFenceValue);
+	if (mUploadBuffer != nullptr)
+		mUploadBuffer->Unmap(0, nullptr);
+}
+
+D3D12TextureUploadDevice::uint32 D3D12TextureUploadDevice::CreateTexture(const TextureDesc& desc)
+{
+	Texture texture;
+	texture.Desc = desc;
+	texture.ResidentMip = desc.MipCount;
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)desc.Format, desc.Width, desc.Height,
+			(UINT16)desc.ArraySize, (UINT16)desc.MipCount, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(&texture.Resource)));
+
+	mTextures.push_back(texture);
+	return (uint32)mTextures.size() - 1;
+}
+
+void D3D12TextureUploadDevice::RecordCopy(uint32 texture, uint32 subresource, uint32 firstRow, uint32 rowCount,
+	uint64 offset, uint32 rowPitch, uint32 rowBytes)
+{
+	if (!mRecording)
+	{
+		// Reuse an allocator whose last submission has completed, or add one.
+		const UINT64 completed = mFence->GetCompletedValue();
+		mCurrentAllocator = mAllocators.size();
+		for (size_t i = 0; i < mAllocators.size(); ++i)
+		{
+			if (mAllocators[i].second <= completed)
+			{
+				mCurrentAllocator = i;
+				break;
+			}
+		}
+		if (mCurrentAllocator == mAllocators.size())
+		{
+			mAllocators.emplace_back();
+			ThrowIfFailed(md3dDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+				IID_PPV_ARGS(mAllocators.back().first.GetAddressOf())));
+		}
+
+		ID3D12CommandAllocator* allocator = mAllocators[mCurrentAllocator].first.Get();
+		ThrowIfFailed(allocator->Reset());
+		ThrowIfFailed(mCommandList->Reset(allocator, nullptr));
+		mRecording = true;
+	}
+
+	ID3D12Resource* resource = mTextures[texture].Resource.Get();
+	const D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	UINT numRows = 0;
+	UINT64 rowSize = 0;
+	UINT64 totalBytes = 0;
+	md3dDevice->GetCopyableFootprints(&desc, subresource, 1, offset, &footprint, &numRows, &rowSize, &totalBytes);
+	if (footprint.Footprint.RowPitch != rowPitch || rowSize != rowBytes || firstRow + rowCount > numRows)
+		throw std::runtime_error("D3D12TextureUploadDevice: copy does not match the texture layout");
+
+	// Rows are 4 texels high in block compressed formats.
+	const UINT blockHeight = (footprint.Footprint.Height + numRows - 1) / numRows;
+	footprint.Footprint.Height = (std::min)(rowCount * blockHeight, footprint.Footprint.Height - firstRow * blockHeight);
+
+	CD3DX12_TEXTURE_COPY_LOCATION dst(resource, subresource);
+	CD3DX12_TEXTURE_COPY_LOCATION src(mUploadBuffer.Get(), footprint);
+	mCommandList->CopyTextureRegion(&dst, 0, firstRow * blockHeight, 0, &src, nullptr);
+}
+
+D3D12TextureUploadDevice::uint64 D3D12TextureUploadDevice::Submit()
+{
+	if (mRecording)
+	{
+		ThrowIfFailed(mCommandList->Close());
+		ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+		mCopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+		mRecording = false;
+	}
+
+	ThrowIfFailed(mCopyQueue->Signal(mFence.Get(), ++mFenceValue));
+	mAllocators[mCurrentAllocator].second = mFenceValue;
+	return mFenceValue;
+}
+
+D3D12TextureUploadDevice::uint64 D3D12TextureUploadDevice::CompletedFence()
+{
+	return mFence->GetCompletedValue();
+}
+
+void D3D12TextureUploadDevice::WaitForFence(uint64 fence)
+{
+	if (mFence->GetCompletedValue() >= fence)
+		return;
+
+	HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+	ThrowIfFailed(mFence->SetEventOnCompletion(fence, eventHandle));
+	WaitForSingleObject(eventHandle, INFINITE);
+	CloseHandle(eventHandle);
+}
+
+void D3D12TextureUploadDevice::SetResidentMip(uint32 texture, uint32 mostDetailedMip)
+{
+	mTextures[texture].ResidentMip = mostDetailedMip;
+	if (mTextures[texture].HasView)
+		WriteView(mTextures[texture]);
+}
+
+void D3D12TextureUploadDevice::CreateShaderResourceView(uint32 texture, D3D12_CPU_DESCRIPTOR_HANDLE descriptor)
+{
+	mTextures[texture].View = descriptor;
+	mTextures[texture].HasView = true;
+	WriteView(mTextures[texture]);
+}
+
+void D3D12TextureUploadDevice::WriteView(const Texture& texture)
+{
+	// All mips stay in the view; the clamp keeps sampling off those still being copied.
+	const float minLod = (float)texture.ResidentMip;
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = (DXGI_FORMAT)texture.Desc.Format;
+	if (texture.Desc.Cube)
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		srvDesc.TextureCube.MipLevels = texture.Desc.MipCount;
+		srvDesc.TextureCube.ResourceMinLODClamp = minLod;
+	}
+	else if (texture.Desc.ArraySize > 1)
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = texture.Desc.MipCount;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = texture.Desc.ArraySize;
+		srvDesc.Texture2DArray.ResourceMinLODClamp = minLod;
+	}
+	else
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = texture.Desc.MipCount;
+		srvDesc.Texture2D.ResourceMinLODClamp = minLod;
+	}
+	md3dDevice->CreateShaderResourceView(texture.Resource.Get(), &srvDesc, texture.View);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include "../Common/d3dUtil.h"
+#include "TextureStreamer.h"
+
+// TextureUploadDevice on a copy queue of its own.  Textures are created in the common
+// state with simultaneous access, so the copy queue can fill mips while the direct
+// queue samples the others.  Their views clamp sampling to the resident mips with
+// ResourceMinLODClamp and are rewritten in place as more mips become resident.
+class D3D12TextureUploadDevice : public TextureUploadDevice
+{
+public:
+	D3D12TextureUploadDevice(ID3D12Device* device, UINT64 uploadBytes);
+	D3D12TextureUploadDevice(const D3D12TextureUploadDevice& rhs) = delete;
+	D3D12TextureUploadDevice& operator=(const D3D12TextureUploadDevice& rhs) = delete;
+	// Waits for the copy queue.
+	~D3D12TextureUploadDevice();
+
+	virtual uint32 CreateTexture(const TextureDesc& desc)override;
+
+	virtual std::uint8_t* UploadMemory()override { return mUploadMemory; }
+	virtual uint64 UploadMemorySize()const override { return mUploadBytes; }
+	virtual uint64 PlacementAlignment()const override { return D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT; }
+	virtual uint32 RowPitchAlignment()const override { return D3D12_TEXTURE_DATA_PITCH_ALIGNMENT; }
+
+	virtual void RecordCopy(uint32 texture, uint32 subresource, uint32 firstRow, uint32 rowCount,
+		uint64 offset, uint32 rowPitch, uint32 rowBytes)override;
+
+	virtual uint64 Submit()override;
+	virtual uint64 CompletedFence()override;
+	virtual void WaitForFence(uint64 fence)override;
+
+	// Rewrites the view made by CreateShaderResourceView, if there is one.  Call it only
+	// while the GPU is not reading that descriptor.
+	virtual void SetResidentMip(uint32 texture, uint32 mostDetailedMip)override;
+
+	ID3D12Resource* Resource(uint32 texture)const { return mTextures[texture].Resource.Get(); }
+
+	// Writes the view of 'texture' to 'descriptor' and keeps it up to date from then on.
+	void CreateShaderResourceView(uint32 texture, D3D12_CPU_DESCRIPTOR_HANDLE descriptor);
+
+private:
+	struct Texture
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		TextureDesc Desc;
+		uint32 ResidentMip = 0;
+		D3D12_CPU_DESCRIPTOR_HANDLE View = {};
+		bool HasView = false;
+	};
+
+	void WriteView(const Texture& texture);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCopyQueue;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCommandList;
+	// Allocators with the fence of the last submission recorded with them.
+	std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>, UINT64>> mAllocators;
+	size_t mCurrentAllocator = 0;
+	bool mRecording = false;
+
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+	UINT64 mFenceValue = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
+	std::uint8_t* mUploadMemory = nullptr;
+	UINT64 mUploadBytes = 0;
+
+	std::vector<Texture> mTextures;
+};
@@ -0,0 +1,37 @@
+#include "D3D12UploadMemoryDevice.h"
+
+D3D12UploadMemoryDevice::D3D12UploadMemoryDevice(ID3D12Device* device)
+	: md3dDevice(device)
+{
+}
+
+D3D12UploadMemoryDevice::uint32 D3D12UploadMemoryDevice::CreateBlock(uint64 size, Block* block)
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer)));
+
+	// Stays mapped; the allocator only writes memory the GPU is done with.
+	ThrowIfFailed(buffer->Map(0, nullptr, reinterpret_cast<void**>(&block->CpuAddress)));
+	block->GpuAddress = buffer->GetGPUVirtualAddress();
+
+	uint32 id = 0;
+	while (id < mBlocks.size() && mBlocks[id] != nullptr)
+		++id;
+	if (id == mBlocks.size())
+		mBlocks.push_back(buffer);
+	else
+		mBlocks[id] = buffer;
+	return id;
+}
+
+void D3D12UploadMemoryDevice::DestroyBlock(uint32 id)
+{
+	mBlocks[id]->Unmap(0, nullptr);
+	mBlocks[id] = nullptr;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+#include "../Common/d3dUtil.h"
+#include "UploadAllocator.h"
+
+// UploadMemoryDevice over committed buffers on the upload heap, mapped from creation to
+// destruction.
+class D3D12UploadMemoryDevice : public UploadMemoryDevice
+{
+public:
+	explicit D3D12UploadMemoryDevice(ID3D12Device* device);
+	D3D12UploadMemoryDevice(const D3D12UploadMemoryDevice& rhs) = delete;
+	D3D12UploadMemoryDevice& operator=(const D3D12UploadMemoryDevice& rhs) = delete;
+
+	virtual uint32 CreateBlock(uint64 size, Block* block)override;
+	virtual void DestroyBlock(uint32 id)override;
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	// Indexed by block id; destroyed blocks leave a null the next block takes.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mBlocks;
+};
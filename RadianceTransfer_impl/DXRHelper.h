@@ -10,6 +10,7 @@
 #include <d3d12.h>
 #include "DXSampleHelper.h"
 #include <dxcapi.h>
+#include "../Common/ShaderCache.h"
 
 #include <vector>
 
@@ -57,23 +58,70 @@ static const D3D12_HEAP_PROPERTIES kDefaultHeapProps = {
     D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 0, 0};
 
 //--------------------------------------------------------------------------------------------------
-// Compile a HLSL file into a DXIL library
+// Convert a short wide string, such as a file name or a define, to the ANSI code page
 //
-IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
+inline std::string NarrowString(const wchar_t* str)
 {
-  static IDxcCompiler* pCompiler = nullptr;
-  static IDxcLibrary* pLibrary = nullptr;
-  static IDxcIncludeHandler* dxcIncludeHandler;
+  char buffer[512];
+  WideCharToMultiByte(CP_ACP, 0, str, -1, buffer, 512, nullptr, nullptr);
+  return std::string(buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compile a HLSL file into a DXIL library, optionally with preprocessor defines. With a
+// cache, a library compiled earlier from the same sources, defines and compiler version
+// is loaded instead, and a compiled one is stored. Each thread compiles with its own DXC
+// instances, so libraries can be compiled on several threads at once. A failed compile
+// throws with the compiler's messages.
+//
+IDxcBlob* CompileShaderLibrary(LPCWSTR fileName, const DxcDefine* defines = nullptr, UINT32 defineCount = 0,
+                               ShaderCache* cache = nullptr)
+{
+  thread_local Microsoft::WRL::ComPtr<IDxcCompiler> pCompiler;
+  thread_local Microsoft::WRL::ComPtr<IDxcLibrary> pLibrary;
+  thread_local Microsoft::WRL::ComPtr<IDxcIncludeHandler> dxcIncludeHandler;
 
   HRESULT hr;
 
   // Initialize the DXC compiler and compiler helper
   if (!pCompiler)
   {
-    ThrowIfFailed(DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler), (void **)&pCompiler));
-    ThrowIfFailed(DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), (void **)&pLibrary));
-    ThrowIfFailed(pLibrary->CreateIncludeHandler(&dxcIncludeHandler));
+    ThrowIfFailed(DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler), (void **)pCompiler.GetAddressOf()));
+    ThrowIfFailed(DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), (void **)pLibrary.GetAddressOf()));
+    ThrowIfFailed(pLibrary->CreateIncludeHandler(dxcIncludeHandler.GetAddressOf()));
   }
+
+  std::string key;
+  if (cache)
+  {
+    thread_local std::string compiler;
+    if (compiler.empty())
+    {
+      UINT32 major = 0, minor = 0;
+      IDxcVersionInfo* pVersion = nullptr;
+      if (SUCCEEDED(pCompiler->QueryInterface(__uuidof(IDxcVersionInfo), (void**)&pVersion)))
+      {
+        pVersion->GetVersion(&major, &minor);
+        pVersion->Release();
+      }
+      compiler = "dxc " + std::to_string(major) + "." + std::to_string(minor);
+    }
+
+    std::vector<std::pair<std::string, std::string>> defineList;
+    for (UINT32 i = 0; i < defineCount; i++)
+      defineList.emplace_back(NarrowString(defines[i].Name),
+                              defines[i].Value ? NarrowString(defines[i].Value) : std::string());
+
+    std::vector<std::uint8_t> cached;
+    if (cache->KeyForFile(NarrowString(fileName), "", "lib_6_3", defineList, compiler, &key) &&
+        cache->Load(key, &cached))
+    {
+      IDxcBlobEncoding* pCached;
+      ThrowIfFailed(pLibrary->CreateBlobWithEncodingOnHeapCopy(cached.data(), (UINT32)cached.size(), 0, &pCached));
+      return pCached;
+    }
+  }
+
   // Open and read the file
   std::ifstream shaderFile(fileName);
   if (shaderFile.good() == false)
@@ -91,8 +139,8 @@ IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
 
   // Compile
   IDxcOperationResult* pResult;
-  ThrowIfFailed(pCompiler->Compile(pTextBlob, fileName, L"", L"lib_6_3", nullptr, 0, nullptr, 0,
-                                   dxcIncludeHandler, &pResult));
+  ThrowIfFailed(pCompiler->Compile(pTextBlob, fileName, L"", L"lib_6_3", nullptr, 0, defines, defineCount,
+                                   dxcIncludeHandler.Get(), &pResult));
 
   // Verify the result
   HRESULT resultCode;
@@ -114,12 +162,13 @@ IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
     std::string errorMsg = "Shader Compiler Error:\n";
     errorMsg.append(infoLog.data());
 
-    MessageBoxA(nullptr, errorMsg.c_str(), "Error!", MB_OK);
-    throw std::logic_error("Failed compile shader");
+    throw std::logic_error(errorMsg);
   }
 
   IDxcBlob* pBlob;
   ThrowIfFailed(pResult->GetResult(&pBlob));
+  if (cache && !key.empty())
+    cache->Store(key, pBlob->GetBufferPointer(), pBlob->GetBufferSize());
   return pBlob;
 }
 
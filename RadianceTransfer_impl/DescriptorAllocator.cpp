@@ -0,0 +1,207 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+DescriptorAllocator::DescriptorAllocator(uint32 capacity, uint32 transientCapacity)
+	: mCapacity(capacity), mTransientCapacity(transientCapacity)
+{
+	if (capacity > 0)
+	{
+		Range all;
+		all.Count = capacity;
+		mFree.push_back(all);
+	}
+	mDirty.resize((capacity + 63) / 64, 0);
+
+	mStats.Capacity = capacity;
+	mStats.TransientCapacity = transientCapacity;
+	UpdateFreeStats();
+}
+
+DescriptorAllocator::Range DescriptorAllocator::Allocate(uint32 count)
+{
+	if (count == 0)
+		throw std::logic_error("DescriptorAllocator: allocating no descriptors");
+
+	for (size_t i = 0; i < mFree.size(); ++i)
+	{
+		if (mFree[i].Count < count)
+			continue;
+
+		Range range;
+		range.First = mFree[i].First;
+		range.Count = count;
+
+		mFree[i].First += count;
+		mFree[i].Count -= count;
+		if (mFree[i].Count == 0)
+			mFree.erase(mFree.begin() + i);
+
+		mAllocations.emplace(range.First, count);
+		mStats.Allocated += count;
+		mStats.PeakAllocated = (std::max)(mStats.PeakAllocated, mStats.Allocated);
+		++mStats.Allocations;
+		UpdateFreeStats();
+		return range;
+	}
+
+	throw std::runtime_error("DescriptorAllocator: no free range of " + std::to_string(count) +
+		" descriptors, " + std::to_string(mCapacity - mStats.Allocated) + " free in " +
+		std::to_string(mFree.size()) + " ranges");
+}
+
+void DescriptorAllocator::Free(const Range& range)
+{
+	if (range.Count == 0 || range.First >= mCapacity || range.Count > mCapacity - range.First)
+		throw std::logic_error("DescriptorAllocator: freeing a range outside the heap");
+
+	// Only whole allocations go back, so a range is never half free.
+	auto allocation = mAllocations.find(range.First);
+	if (allocation == mAllocations.end())
+		throw std::logic_error("DescriptorAllocator: freeing descriptors that are not allocated");
+	if (allocation->second != range.Count)
+		throw std::logic_error("DescriptorAllocator: freeing " + std::to_string(range.Count) +
+			" descriptors of an allocation of " + std::to_string(allocation->second));
+	mAllocations.erase(allocation);
+
+	// The first free range after the one being freed, and the one before it.
+	auto next = std::lower_bound(mFree.begin(), mFree.end(), range,
+		[](const Range& a, const Range& b) { return a.First < b.First; });
+	const bool touchesNext = next != mFree.end() && range.First + range.Count == next->First;
+	const bool touchesPrev = next != mFree.begin() && (next - 1)->First + (next - 1)->Count == range.First;
+
+	if (touchesPrev && touchesNext)
+	{
+		(next - 1)->Count += range.Count + next->Count;
+		mFree.erase(next);
+	}
+	else if (touchesPrev)
+		(next - 1)->Count += range.Count;
+	else if (touchesNext)
+	{
+		next->First = range.First;
+		next->Count += range.Count;
+	}
+	else
+		mFree.insert(next, range);
+
+	mStats.Allocated -= range.Count;
+	--mStats.Allocations;
+	UpdateFreeStats();
+}
+
+void DescriptorAllocator::MarkDirty(const Range& range)
+{
+	if (range.First >= mCapacity || range.Count > mCapacity - range.First)
+		throw std::logic_error("DescriptorAllocator: marking descriptors outside the persistent slots dirty");
+	for (uint32 slot = range.First; slot < range.First + range.Count; ++slot)
+		mDirty[slot / 64] |= uint64(1) << (slot % 64);
+}
+
+void DescriptorAllocator::TakeDirtyRuns(std::vector<Range>* runs)
+{
+	mStats.CopiedDescriptors = 0;
+	mStats.CopyRuns = 0;
+
+	Range run;
+	for (uint32 w = 0; w < (uint32)mDirty.size(); ++w)
+	{
+		// Whole clean words only end the run in progress.
+		if (mDirty[w] == 0 && run.Count == 0)
+			continue;
+
+		for (uint32 bit = 0; bit < 64; ++bit)
+		{
+			const uint32 slot = w * 64 + bit;
+			if ((mDirty[w] >> bit) & 1)
+			{
+				if (run.Count == 0)
+					run.First = slot;
+				++run.Count;
+			}
+			else if (run.Count > 0)
+			{
+				runs->push_back(run);
+				mStats.CopiedDescriptors += run.Count;
+				++mStats.CopyRuns;
+				run.Count = 0;
+			}
+		}
+		mDirty[w] = 0;
+	}
+	if (run.Count > 0)
+	{
+		runs->push_back(run);
+		mStats.CopiedDescriptors += run.Count;
+		++mStats.CopyRuns;
+	}
+}
+
+void DescriptorAllocator::BeginFrame(uint64 completedFence)
+{
+	while (!mFrames.empty() && mFrames.front().Fence <= completedFence)
+	{
+		// The tail only goes back when it follows the head around the end.
+		if (mFrames.front().End < mTail)
+			mWrapped = false;
+		mTail = mFrames.front().End;
+		mFrames.pop_front();
+	}
+
+	if (mFrames.empty())
+	{
+		mHead = 0;
+		mTail = 0;
+		mWrapped = false;
+	}
+
+	mStats.TransientFrameSlots = 0;
+}
+
+DescriptorAllocator::Range DescriptorAllocator::AllocateTransient(uint32 count)
+{
+	uint32 first = mHead;
+	if (!mWrapped && mHead + count > mTransientCapacity)
+	{
+		// The head must stay behind the tail, or a full ring would look empty.
+		if (count >= mTail)
+			throw std::runtime_error("DescriptorAllocator: transient ring full");
+		mStats.TransientFrameSlots += mTransientCapacity - mHead;
+		mHead = 0;
+		first = 0;
+		mWrapped = true;
+	}
+	else if (mWrapped && mHead + count >= mTail)
+		throw std::runtime_error("DescriptorAllocator: transient ring full");
+
+	mStats.TransientFrameSlots += first + count - mHead;
+	mStats.PeakTransientFrameSlots = (std::max)(mStats.PeakTransientFrameSlots, mStats.TransientFrameSlots);
+	mHead = first + count;
+
+	Range range;
+	range.First = mCapacity + first;
+	range.Count = count;
+	return range;
+}
+
+void DescriptorAllocator::EndFrame(uint64 fence)
+{
+	Frame frame;
+	frame.Fence = fence;
+	frame.End = mHead;
+	mFrames.push_back(frame);
+}
+
+void DescriptorAllocator::UpdateFreeStats()
+{
+	uint32 largest = 0;
+	for (const Range& range : mFree)
+		largest = (std::max)(largest, range.Count);
+
+	const uint32 free = mCapacity - mStats.Allocated;
+	mStats.FreeRanges = (uint32)mFree.size();
+	mStats.LargestFreeRange = largest;
+	mStats.Fragmentation = free == 0 ? 0.0f : 1.0f - (float)largest / free;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// What a range of descriptors holds, so a range of UAVs cannot be passed where SRVs are
+// expected.  Both live in the same CBV/SRV/UAV heap.
+enum class DescriptorKind
+{
+	Srv,
+	Uav
+};
+
+// Descriptors [First, First + Count) of a heap.  Indices stay valid until the range is
+// freed; nothing is ever moved.
+template<DescriptorKind Kind>
+struct DescriptorRange
+{
+	std::uint32_t First = 0;
+	std::uint32_t Count = 0;
+
+	// Descriptors [First + first, First + first + count).
+	DescriptorRange Sub(std::uint32_t first, std::uint32_t count = 1)const
+	{
+		DescriptorRange range;
+		range.First = First + first;
+		range.Count = count;
+		return range;
+	}
+};
+
+using SrvRange = DescriptorRange<DescriptorKind::Srv>;
+using UavRange = DescriptorRange<DescriptorKind::Uav>;
+
+// Slot bookkeeping for a descriptor heap, without the heap.  The front of the heap holds
+// the persistent descriptors: contiguous ranges from a free list kept sorted and
+// coalesced, placed first fit.  The back is a ring of tables rebuilt every frame, which
+// are released by fence like UploadAllocator's frames; unlike upload memory a bound heap
+// cannot grow, so a frame that overruns the ring throws.
+//
+// Persistent descriptors are written on the CPU and copied to the shader-visible heap
+// later.  MarkDirty() records what was written, and TakeDirtyRuns() hands it out merged
+// into runs of adjacent slots, a copy each.
+class DescriptorAllocator
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Range
+	{
+		uint32 First = 0;
+		uint32 Count = 0;
+	};
+
+	struct Stats
+	{
+		uint32 Capacity = 0;          // persistent slots
+		uint32 Allocated = 0;
+		uint32 PeakAllocated = 0;
+		uint32 Allocations = 0;       // ranges alive
+		uint32 FreeRanges = 0;
+		uint32 LargestFreeRange = 0;
+		float Fragmentation = 0.0f;   // 1 - largest free range / free slots
+
+		uint32 TransientCapacity = 0;
+		uint32 TransientFrameSlots = 0; // allocated since BeginFrame
+		uint32 PeakTransientFrameSlots = 0;
+
+		uint32 CopiedDescriptors = 0; // by the last TakeDirtyRuns()
+		uint32 CopyRuns = 0;
+	};
+
+	DescriptorAllocator(uint32 capacity, uint32 transientCapacity);
+
+	// Throws std::runtime_error when no free range is large enough.
+	Range Allocate(uint32 count);
+	// Throws std::logic_error for a range that is not exactly one Allocate() returned.
+	void Free(const Range& range);
+
+	// Throws std::logic_error for a range outside the persistent slots; tables are
+	// written straight into the shader-visible heap.
+	void MarkDirty(const Range& range);
+	// Clears the dirty slots and appends their runs to 'runs', in slot order.
+	void TakeDirtyRuns(std::vector<Range>* runs);
+
+	// Releases the tables of the frames whose fence is at most 'completedFence'.
+	void BeginFrame(uint64 completedFence);
+	// A table of this frame, in slots [capacity, capacity + transientCapacity).
+	Range AllocateTransient(uint32 count);
+	void EndFrame(uint64 fence);
+
+	const Stats& GetStats()const { return mStats; }
+
+private:
+	struct Frame
+	{
+		uint64 Fence = 0;
+		uint32 End = 0;
+	};
+
+	void UpdateFreeStats();
+
+private:
+	uint32 mCapacity = 0;
+
+	// Sorted by First; neighbours never touch.
+	std::vector<Range> mFree;
+	// First slot to count of the ranges allocated.
+	std::unordered_map<uint32, uint32> mAllocations;
+
+	// A bit per persistent slot.
+	std::vector<uint64> mDirty;
+
+	// Ring offsets, relative to mCapacity.  Free slots are [mHead, end) and [0, mTail), or
+	// [mHead, mTail) once the head has wrapped behind the tail.
+	uint32 mTransientCapacity = 0;
+	uint32 mHead = 0;
+	uint32 mTail = 0;
+	bool mWrapped = false;
+	std::deque<Frame> mFrames;
+
+	Stats mStats;
+};
@@ -0,0 +1,713 @@
+#include "EnvironmentMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../Common/DDSReader.h"
+#include "../Common/FileUtil.h"
+#include "../Common/JobSystem.h"
+#include "SHBasis.h"
+
+namespace EnvironmentMap
+{
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint16 = std::uint16_t;
+
+	const double kPi = 3.14159265358979323846;
+
+	// Bump when the cube or SH produced from the same image change.
+	const uint32 kKeyVersion = 1;
+
+	// Fixed so that the SH sums are the same whatever the thread count.
+	const uint32 kBandRows = 16;
+	const uint32 kTileSize = 32;
+	const uint32 kMaxSupersample = 8;
+
+	// The largest image accepted: 32k x 16k texels.
+	const std::size_t kMaxTexels = std::size_t(1) << 29;
+
+	bool Fail(std::string* error, const std::string& reason)
+	{
+		if (error)
+			*error = reason;
+		return false;
+	}
+
+	// Runs 'item' on every index in [0, count), one index per job on 'jobs' when given and
+	// in order on the calling thread otherwise.
+	template<typename Function>
+	void ParallelFor(uint32 count, JobSystem* jobs, const Function& item)
+	{
+		auto range = [&item](uint32 first, uint32 last)
+		{
+			for (uint32 i = first; i < last; ++i)
+				item(i);
+		};
+		if (jobs == nullptr)
+			range(0, count);
+		else
+			jobs->ParallelFor(count, 1, range);
+	}
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//
+	// Radiance HDR
+	//
+
+	class HdrReader
+	{
+	public:
+		HdrReader(const uint8* data, std::size_t size) : mData(data), mSize(size) {}
+
+		bool ReadLine(std::string& line)
+		{
+			if (mPos >= mSize)
+				return false;
+			const uint8* end = static_cast<const uint8*>(std::memchr(mData + mPos, '\n', mSize - mPos));
+			const std::size_t last = end ? std::size_t(end - mData) : mSize;
+			line.assign(reinterpret_cast<const char*>(mData + mPos), last - mPos);
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			mPos = end ? last + 1 : last;
+			return true;
+		}
+
+		std::size_t Remaining()const { return mSize - mPos; }
+		const uint8* Current()const { return mData + mPos; }
+		uint8 Next() { return mData[mPos++]; }
+
+	private:
+		const uint8* mData;
+		std::size_t mSize;
+		std::size_t mPos = 0;
+	};
+
+	// Reads one scanline of 'width' RGBE texels.
+	bool ReadScanline(HdrReader& reader, uint32 width, uint8* rgbe, std::string* error)
+	{
+		if (reader.Remaining() < 4)
+			return Fail(error, "truncated pixel data");
+
+		const uint8* head = reader.Current();
+		const bool perChannel = width >= 8 && width <= 0x7fff &&
+			head[0] == 2 && head[1] == 2 && (head[2] & 0x80) == 0;
+		if (perChannel)
+		{
+			if (((uint32(head[2]) << 8) | head[3]) != width)
+				return Fail(error, "scanline width does not match the image");
+			for (int i = 0; i < 4; ++i)
+				reader.Next();
+
+			// Each channel in turn, as runs (count > 128) and literals.
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				for (uint32 x = 0; x < width;)
+				{
+					if (reader.Remaining() < 2)
+						return Fail(error, "truncated pixel data");
+					uint32 count = reader.Next();
+					if (count > 128)
+					{
+						count -= 128;
+						if (count > width - x)
+							return Fail(error, "run overruns the scanline");
+						const uint8 value = reader.Next();
+						for (; count > 0; --count, ++x)
+							rgbe[x * 4 + c] = value;
+					}
+					else
+					{
+						if (count == 0 || count > width - x)
+							return Fail(error, "bad literal length");
+						if (reader.Remaining() < count)
+							return Fail(error, "truncated pixel data");
+						for (; count > 0; --count, ++x)
+							rgbe[x * 4 + c] = reader.Next();
+					}
+				}
+			}
+			return true;
+		}
+
+		// Flat texels, where 1 1 1 n repeats the previous one n times, shifted up by 8
+		// bits for every repeat in a row.
+		uint32 shift = 0;
+		for (uint32 x = 0; x < width;)
+		{
+			if (reader.Remaining() < 4)
+				return Fail(error, "truncated pixel data");
+			uint8 texel[4];
+			for (int i = 0; i < 4; ++i)
+				texel[i] = reader.Next();
+
+			if (texel[0] == 1 && texel[1] == 1 && texel[2] == 1)
+			{
+				if (x == 0 || shift > 24)
+					return Fail(error, "bad repeat");
+				const std::uint64_t count = std::uint64_t(texel[3]) << shift;
+				if (count > width - x)
+					return Fail(error, "repeat overruns the scanline");
+				for (std::uint64_t i = 0; i < count; ++i, ++x)
+					std::memcpy(rgbe + x * 4, rgbe + (x - 1) * 4, 4);
+				shift += 8;
+			}
+			else
+			{
+				std::memcpy(rgbe + x * 4, texel, 4);
+				++x;
+				shift = 0;
+			}
+		}
+		return true;
+	}
+
+	//
+	// Cube maps
+	//
+
+	// Bilinear sample of the image, wrapping around horizontally and clamped at the poles.
+	void SampleLatLong(const Image& image, const float d[3], float rgb[3])
+	{
+		float u, v;
+		DirectionLatLong(d, u, v);
+
+		const float px = u * image.Width - 0.5f;
+		const float py = v * image.Height - 0.5f;
+		const float fx = std::floor(px);
+		const float fy = std::floor(py);
+		const float wx = px - fx;
+		const float wy = py - fy;
+
+		const int w = int(image.Width);
+		const int h = int(image.Height);
+		int x0 = int(fx) % w;
+		if (x0 < 0)
+			x0 += w;
+		const int x1 = x0 + 1 == w ? 0 : x0 + 1;
+		const int y0 = (std::min)((std::max)(int(fy), 0), h - 1);
+		const int y1 = (std::min)((std::max)(int(fy) + 1, 0), h - 1);
+
+		const float* r0 = &image.Texels[std::size_t(y0) * w * 3];
+		const float* r1 = &image.Texels[std::size_t(y1) * w * 3];
+		for (int c = 0; c < 3; ++c)
+		{
+			const float top = r0[x0 * 3 + c] + (r0[x1 * 3 + c] - r0[x0 * 3 + c]) * wx;
+			const float bottom = r1[x0 * 3 + c] + (r1[x1 * 3 + c] - r1[x0 * 3 + c]) * wx;
+			rgb[c] = top + (bottom - top) * wy;
+		}
+	}
+
+	uint32 DefaultCubeSize(uint32 width)
+	{
+		uint32 size = 1;
+		while (size * 2 <= width / 4)
+			size *= 2;
+		return size;
+	}
+
+	uint32 FullMipCount(uint32 size)
+	{
+		uint32 count = 1;
+		while (size > 1)
+		{
+			size /= 2;
+			++count;
+		}
+		return count;
+	}
+
+	uint32 TileCount(uint32 size)
+	{
+		const uint32 tiles = (size + kTileSize - 1) / kTileSize;
+		return 6 * tiles * tiles;
+	}
+
+	uint32 BandCount(uint32 height)
+	{
+		return (height + kBandRows - 1) / kBandRows;
+	}
+
+	// Round to nearest even; beyond the half range clamps to the largest finite half.
+	uint16 FloatToHalf(float value)
+	{
+		uint32 bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		const uint32 sign = (bits >> 16) & 0x8000;
+		const uint32 magnitude = bits & 0x7fffffff;
+
+		if (magnitude > 0x7f800000)
+			return uint16(sign | 0x7e00);
+		if (magnitude >= 0x477ff000)
+			return uint16(sign | 0x7bff);
+		if (magnitude < 0x33000000)
+			return uint16(sign);
+
+		if (magnitude < 0x38800000)
+		{
+			// Denormal half: the mantissa with its implicit bit, shifted into place.
+			const uint32 mantissa = (magnitude & 0x7fffff) | 0x800000;
+			const uint32 shift = 126 - (magnitude >> 23);
+			const uint32 half = 1u << (shift - 1);
+			const uint32 rest = mantissa & ((1u << shift) - 1);
+			uint32 result = mantissa >> shift;
+			if (rest > half || (rest == half && (result & 1)))
+				++result;
+			return uint16(sign | result);
+		}
+
+		uint32 result = (magnitude - 0x38000000) >> 13;
+		const uint32 rest = magnitude & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (result & 1)))
+			++result;
+		return uint16(sign | result);
+	}
+
+	//
+	// Import cache key
+	//
+
+	std::string MakeKey(const FileUtil::FileStamp& stamp, uint32 size)
+	{
+		char key[128];
+		std::snprintf(key, sizeof(key), "environment %u %llu %llu %u", kKeyVersion,
+			(unsigned long long)stamp.Size, (unsigned long long)stamp.WriteTime, size);
+		return key;
+	}
+
+	// The key on the first line, the 27 SH values on the second.
+	bool ReadKey(const std::string& keyPath, const std::string& key, SH9& sh)
+	{
+		MappedFile file;
+		if (!file.Open(keyPath))
+			return false;
+
+		const std::string text(reinterpret_cast<const char*>(file.Data()), file.Size());
+		const std::size_t newline = text.find('\n');
+		if (newline == std::string::npos || text.compare(0, newline, key) != 0)
+			return false;
+
+		SH9 stored;
+		const char* cursor = text.c_str() + newline + 1;
+		for (uint32 i = 0; i < 27; ++i)
+		{
+			char* end = nullptr;
+			stored.Coeffs[i / 3][i % 3] = std::strtof(cursor, &end);
+			if (end == cursor)
+				return false;
+			cursor = end;
+		}
+
+		sh = stored;
+		return true;
+	}
+
+	bool WriteKey(const std::string& keyPath, const std::string& key, const SH9& sh)
+	{
+		std::string text = key + "\n";
+		for (uint32 i = 0; i < 27; ++i)
+		{
+			char value[32];
+			std::snprintf(value, sizeof(value), i == 0 ? "%.9g" : " %.9g", sh.Coeffs[i / 3][i % 3]);
+			text += value;
+		}
+		text += "\n";
+		return FileUtil::WriteFileAtomic(keyPath, text.data(), text.size());
+	}
+}
+
+bool ParseHdr(const void* data, std::size_t size, Image& image, std::string* error)
+{
+	image = Image();
+	HdrReader reader(static_cast<const uint8*>(data), size);
+
+	std::string line;
+	if (!reader.ReadLine(line) || line.compare(0, 2, "#?") != 0)
+		return Fail(error, "not a Radiance HDR file");
+
+	// Header variables up to the first empty line.
+	while (true)
+	{
+		if (!reader.ReadLine(line))
+			return Fail(error, "truncated header");
+		if (line.empty())
+			break;
+		if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+			return Fail(error, "unsupported format " + line.substr(7));
+	}
+
+	char ySign = 0, yAxis = 0, xSign = 0, xAxis = 0;
+	unsigned height = 0, width = 0;
+	if (!reader.ReadLine(line) ||
+		std::sscanf(line.c_str(), "%c%c %u %c%c %u", &ySign, &yAxis, &height, &xSign, &xAxis, &width) != 6 ||
+		yAxis != 'Y' || (ySign != '-' && ySign != '+') || xAxis != 'X' || xSign != '+')
+	{
+		return Fail(error, "unsupported resolution line '" + line + "'");
+	}
+	if (width == 0 || height == 0 || std::size_t(width) * height > kMaxTexels)
+		return Fail(error, "bad image size");
+
+	// 2^(e - 128) / 256 per exponent, so mantissa * scale is the value.
+	float scale[256];
+	scale[0] = 0.0f;
+	for (int e = 1; e < 256; ++e)
+		scale[e] = std::ldexp(1.0f, e - 136);
+
+	image.Width = width;
+	image.Height = height;
+	image.Texels.resize(std::size_t(width) * height * 3);
+
+	std::vector<uint8> rgbe(std::size_t(width) * 4);
+	for (uint32 y = 0; y < height; ++y)
+	{
+		if (!ReadScanline(reader, width, rgbe.data(), error))
+		{
+			image = Image();
+			return false;
+		}
+
+		// "+Y" images are stored bottom row first.
+		const uint32 row = ySign == '-' ? y : height - 1 - y;
+		float* dst = &image.Texels[std::size_t(row) * width * 3];
+		for (uint32 x = 0; x < width; ++x)
+		{
+			const uint8* src = &rgbe[x * 4];
+			const float s = scale[src[3]];
+			dst[x * 3 + 0] = src[0] * s;
+			dst[x * 3 + 1] = src[1] * s;
+			dst[x * 3 + 2] = src[2] * s;
+		}
+	}
+	return true;
+}
+
+bool LoadHdr(const std::string& path, Image& image, std::string* error)
+{
+	MappedFile file;
+	if (!file.Open(path))
+		return Fail(error, "cannot open " + path);
+	return ParseHdr(file.Data(), file.Size(), image, error);
+}
+
+void EvalBasis(const float d[3], float basis[9])
+{
+	SHBasis::Eval(3, d, basis);
+}
+
+void LatLongDirection(float u, float v, float d[3])
+{
+	const float phi = float(2.0 * kPi) * (u - 0.5f);
+	const float theta = float(kPi) * v;
+	const float sinTheta = std::sin(theta);
+	d[0] = sinTheta * std::sin(phi);
+	d[1] = std::cos(theta);
+	d[2] = sinTheta * std::cos(phi);
+}
+
+void DirectionLatLong(const float d[3], float& u, float& v)
+{
+	u = 0.5f + std::atan2(d[0], d[2]) * float(0.5 / kPi);
+	v = std::acos((std::min)((std::max)(d[1], -1.0f), 1.0f)) * float(1.0 / kPi);
+}
+
+SH9 ProjectSH(const Image& image, JobSystem* jobs)
+{
+	SH9 sh;
+	if (image.Width == 0 || image.Height == 0)
+		return sh;
+
+	const uint32 width = image.Width;
+	const uint32 height = image.Height;
+
+	std::vector<float> sinPhi(width), cosPhi(width);
+	for (uint32 x = 0; x < width; ++x)
+	{
+		const double phi = 2.0 * kPi * ((x + 0.5) / width - 0.5);
+		sinPhi[x] = float(std::sin(phi));
+		cosPhi[x] = float(std::cos(phi));
+	}
+
+	struct Sums
+	{
+		double Coeffs[9][3];
+	};
+
+	const uint32 bandCount = BandCount(height);
+	std::vector<Sums> bands(bandCount);
+	ParallelFor(bandCount, jobs, [&](uint32 band)
+	{
+		Sums& sums = bands[band];
+		std::memset(&sums, 0, sizeof(sums));
+
+		const uint32 last = (std::min)(height, (band + 1) * kBandRows);
+		for (uint32 y = band * kBandRows; y < last; ++y)
+		{
+			const double theta = kPi * (y + 0.5) / height;
+			const float sinTheta = float(std::sin(theta));
+			const float cosTheta = float(std::cos(theta));
+			const double solidAngle = 2.0 * kPi / width *
+				(std::cos(kPi * y / height) - std::cos(kPi * (y + 1) / height));
+
+			double row[9][3] = {};
+			const float* texel = &image.Texels[std::size_t(y) * width * 3];
+			for (uint32 x = 0; x < width; ++x, texel += 3)
+			{
+				const float d[3] = { sinTheta * sinPhi[x], cosTheta, sinTheta * cosPhi[x] };
+				float basis[9];
+				EvalBasis(d, basis);
+				for (uint32 i = 0; i < 9; ++i)
+				{
+					row[i][0] += basis[i] * texel[0];
+					row[i][1] += basis[i] * texel[1];
+					row[i][2] += basis[i] * texel[2];
+				}
+			}
+
+			for (uint32 i = 0; i < 9; ++i)
+			{
+				for (uint32 c = 0; c < 3; ++c)
+					sums.Coeffs[i][c] += row[i][c] * solidAngle;
+			}
+		}
+	});
+
+	double total[9][3] = {};
+	for (const Sums& sums : bands)
+	{
+		for (uint32 i = 0; i < 9; ++i)
+		{
+			for (uint32 c = 0; c < 3; ++c)
+				total[i][c] += sums.Coeffs[i][c];
+		}
+	}
+	for (uint32 i = 0; i < 9; ++i)
+	{
+		for (uint32 c = 0; c < 3; ++c)
+			sh.Coeffs[i][c] = float(total[i][c]);
+	}
+	return sh;
+}
+
+void CubeDirection(uint32 face, uint32 size, float x, float y, float d[3])
+{
+	const float s = 2.0f * x / size - 1.0f;
+	const float t = 2.0f * y / size - 1.0f;
+	switch (face)
+	{
+	case 0:  d[0] = 1.0f;  d[1] = -t;    d[2] = -s;    break;
+	case 1:  d[0] = -1.0f; d[1] = -t;    d[2] = s;     break;
+	case 2:  d[0] = s;     d[1] = 1.0f;  d[2] = t;     break;
+	case 3:  d[0] = s;     d[1] = -1.0f; d[2] = -t;    break;
+	case 4:  d[0] = s;     d[1] = -t;    d[2] = 1.0f;  break;
+	default: d[0] = -s;    d[1] = -t;    d[2] = -1.0f; break;
+	}
+
+	const float invLength = 1.0f / std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	d[0] *= invLength;
+	d[1] *= invLength;
+	d[2] *= invLength;
+}
+
+Cubemap ResampleCube(const Image& image, uint32 size, uint32 mipCount, JobSystem* jobs)
+{
+	Cubemap cube;
+	if (image.Width == 0 || image.Height == 0)
+		return cube;
+
+	if (size == 0)
+		size = DefaultCubeSize(image.Width);
+	const uint32 fullMips = FullMipCount(size);
+	mipCount = mipCount == 0 ? fullMips : (std::min)(mipCount, fullMips);
+
+	cube.Size = size;
+	cube.MipCount = mipCount;
+	cube.Surfaces.resize(6 * mipCount);
+	for (uint32 face = 0; face < 6; ++face)
+	{
+		uint32 mipSize = size;
+		for (uint32 mip = 0; mip < mipCount; ++mip, mipSize = (std::max)(1u, mipSize / 2))
+			cube.Surfaces[mip + face * mipCount].resize(std::size_t(mipSize) * mipSize * 4);
+	}
+
+	// Enough samples per axis that every image texel under a face texel is seen.
+	const uint32 samples = (std::min)(kMaxSupersample,
+		(std::max)(1u, (image.Width + 4 * size - 1) / (4 * size)));
+	const float weight = 1.0f / float(samples * samples);
+
+	const uint32 tilesPerSide = (size + kTileSize - 1) / kTileSize;
+	const uint32 tilesPerFace = tilesPerSide * tilesPerSide;
+	ParallelFor(6 * tilesPerFace, jobs, [&](uint32 tile)
+	{
+		const uint32 face = tile / tilesPerFace;
+		const uint32 tileX = (tile % tilesPerFace) % tilesPerSide * kTileSize;
+		const uint32 tileY = (tile % tilesPerFace) / tilesPerSide * kTileSize;
+		float* surface = cube.Surfaces[face * mipCount].data();
+
+		for (uint32 y = tileY; y < (std::min)(size, tileY + kTileSize); ++y)
+		{
+			for (uint32 x = tileX; x < (std::min)(size, tileX + kTileSize); ++x)
+			{
+				float sum[3] = {};
+				for (uint32 sy = 0; sy < samples; ++sy)
+				{
+					for (uint32 sx = 0; sx < samples; ++sx)
+					{
+						float d[3], rgb[3];
+						CubeDirection(face, size, x + (sx + 0.5f) / samples, y + (sy + 0.5f) / samples, d);
+						SampleLatLong(image, d, rgb);
+						sum[0] += rgb[0];
+						sum[1] += rgb[1];
+						sum[2] += rgb[2];
+					}
+				}
+
+				float* dst = surface + (std::size_t(y) * size + x) * 4;
+				dst[0] = sum[0] * weight;
+				dst[1] = sum[1] * weight;
+				dst[2] = sum[2] * weight;
+				dst[3] = 1.0f;
+			}
+		}
+	});
+
+	ParallelFor(6, jobs, [&](uint32 face)
+	{
+		uint32 srcSize = size;
+		for (uint32 mip = 1; mip < mipCount; ++mip)
+		{
+			const uint32 dstSize = (std::max)(1u, srcSize / 2);
+			const float* src = cube.Surfaces[mip - 1 + face * mipCount].data();
+			float* dst = cube.Surfaces[mip + face * mipCount].data();
+			for (uint32 y = 0; y < dstSize; ++y)
+			{
+				const uint32 y0 = (std::min)(2 * y, srcSize - 1);
+				const uint32 y1 = (std::min)(2 * y + 1, srcSize - 1);
+				for (uint32 x = 0; x < dstSize; ++x)
+				{
+					const uint32 x0 = (std::min)(2 * x, srcSize - 1);
+					const uint32 x1 = (std::min)(2 * x + 1, srcSize - 1);
+					for (uint32 c = 0; c < 4; ++c)
+					{
+						dst[(y * dstSize + x) * 4 + c] = 0.25f *
+							(src[(y0 * srcSize + x0) * 4 + c] + src[(y0 * srcSize + x1) * 4 + c] +
+							 src[(y1 * srcSize + x0) * 4 + c] + src[(y1 * srcSize + x1) * 4 + c]);
+					}
+				}
+			}
+			srcSize = dstSize;
+		}
+	});
+
+	return cube;
+}
+
+bool WriteDds(const std::string& path, const Cubemap& cube)
+{
+	if (cube.Size == 0 || cube.MipCount == 0 || cube.Surfaces.size() != 6 * cube.MipCount)
+		return false;
+
+	DDS_HEADER header = {};
+	header.size = sizeof(DDS_HEADER);
+	header.flags = 0x0002100f; // CAPS | HEIGHT | WIDTH | PITCH | PIXELFORMAT | MIPMAPCOUNT
+	header.height = cube.Size;
+	header.width = cube.Size;
+	header.pitchOrLinearSize = cube.Size * 8;
+	header.mipMapCount = cube.MipCount;
+	header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+	header.ddspf.flags = DDS_FOURCC;
+	header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+	header.caps = 0x00401008; // COMPLEX | TEXTURE | MIPMAP
+	header.caps2 = DDS_CUBEMAP_ALLFACES;
+
+	DDS_HEADER_DXT10 extended = {};
+	extended.dxgiFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	extended.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	extended.miscFlag = DDS_RESOURCE_MISC_TEXTURECUBE;
+	extended.arraySize = 1;
+
+	std::size_t texels = 0;
+	for (const auto& surface : cube.Surfaces)
+		texels += surface.size();
+
+	const std::size_t headerBytes = sizeof(DDS_MAGIC) + sizeof(header) + sizeof(extended);
+	std::vector<uint8> file(headerBytes + texels * sizeof(uint16));
+	uint8* cursor = file.data();
+	std::memcpy(cursor, &DDS_MAGIC, sizeof(DDS_MAGIC));
+	cursor += sizeof(DDS_MAGIC);
+	std::memcpy(cursor, &header, sizeof(header));
+	cursor += sizeof(header);
+	std::memcpy(cursor, &extended, sizeof(extended));
+	cursor += sizeof(extended);
+
+	// Surfaces are already in file order: every mip of +x, then of -x, and so on.
+	for (const auto& surface : cube.Surfaces)
+	{
+		for (float value : surface)
+		{
+			const uint16 half = FloatToHalf(value);
+			std::memcpy(cursor, &half, sizeof(half));
+			cursor += sizeof(half);
+		}
+	}
+
+	const std::size_t slash = path.find_last_of("/\\");
+	if (slash != std::string::npos && !FileUtil::CreateDirectories(path.substr(0, slash)))
+		return false;
+	return FileUtil::WriteFileAtomic(path, file.data(), file.size());
+}
+
+bool Import(const std::string& hdrPath, const std::string& ddsPath, uint32 size, SH9& sh,
+	bool& rebuilt, Stats* stats, std::string* error, JobSystem* jobs)
+{
+	rebuilt = false;
+
+	FileUtil::FileStamp stamp;
+	if (!FileUtil::GetFileStamp(hdrPath, stamp))
+		return Fail(error, "cannot find " + hdrPath);
+
+	const std::string key = MakeKey(stamp, size);
+	const std::string keyPath = ddsPath + ".key";
+	if (FileUtil::FileExists(ddsPath) && ReadKey(keyPath, key, sh))
+		return true;
+
+	rebuilt = true;
+	Stats local;
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Image image;
+	if (!LoadHdr(hdrPath, image, error))
+		return false;
+	local.ParseMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	sh = ProjectSH(image, jobs);
+	local.ProjectMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	const Cubemap cube = ResampleCube(image, size, 0, jobs);
+	local.ResampleMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	// The key goes last, so it only ever describes a complete cube.
+	if (!WriteDds(ddsPath, cube) || !WriteKey(keyPath, key, sh))
+		return Fail(error, "cannot write " + ddsPath);
+	local.WriteMilliseconds = MillisecondsSince(start);
+
+	local.Tiles = BandCount(image.Height) + TileCount(cube.Size);
+	local.Threads = jobs ? (std::min)(jobs->WorkerCount() + 1, local.Tiles) : 1;
+	if (stats)
+		*stats = local;
+	return true;
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Environment lighting from lat-long (equirectangular) Radiance HDR images, without
+// going through an 8-bit cube map.
+//
+// The image is either projected straight onto SH9, weighting every texel by the exact
+// solid angle of its row, or resampled into cube faces with a mip chain for drawing the
+// sky.  Both are split into tiles, spread over the jobs of a JobSystem when one is
+// given: bands of rows for the SH, whose partial sums are added in band order so the
+// result does not depend on the thread count, and square blocks of the faces for the
+// cube.
+//
+// Directions are in world space, y up: the center of the image looks down +z, u grows
+// towards +x and v = 0 is straight up.  Cube faces follow the D3D order and
+// orientation (+x, -x, +y, -y, +z, -z), as the sky shader samples them.
+namespace EnvironmentMap
+{
+	using uint32 = std::uint32_t;
+
+	// Linear RGB, row-major, top row first.
+	struct Image
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+		std::vector<float> Texels;
+	};
+
+	// Reads a Radiance RGBE file: flat, old-style run-length or per-channel run-length
+	// scanlines, in the standard -Y H +X W orientation or flipped vertically.  XYZE files
+	// are rejected.  On failure 'error', if given, says why.
+	bool LoadHdr(const std::string& path, Image& image, std::string* error = nullptr);
+	bool ParseHdr(const void* data, std::size_t size, Image& image, std::string* error = nullptr);
+
+	// Coefficients in the order of sh_eval_basis_2 (SHUtil.hlsl) and the SHCoeff struct.
+	struct SH9
+	{
+		float Coeffs[9][3] = {};
+	};
+
+	// Evaluates the nine basis functions of sh_eval_basis_2 at unit direction 'd'.
+	void EvalBasis(const float d[3], float basis[9]);
+
+	// Direction at lat-long coordinates (u, v) in [0, 1], and back.  Texel (x, y) of a
+	// width x height image is centered at ((x + 0.5) / width, (y + 0.5) / height).
+	void LatLongDirection(float u, float v, float d[3]);
+	void DirectionLatLong(const float d[3], float& u, float& v);
+
+	// Projects the image onto SH9.  Texels of row y cover
+	// (2 pi / width) * (cos(pi y / height) - cos(pi (y + 1) / height)) steradians.
+	SH9 ProjectSH(const Image& image, JobSystem* jobs = nullptr);
+
+	struct Cubemap
+	{
+		uint32 Size = 0;
+		uint32 MipCount = 0;
+		// RGBA, alpha 1, one surface per face and mip, indexed mip + face * MipCount as
+		// D3D12 subresources are.
+		std::vector<std::vector<float>> Surfaces;
+	};
+
+	// 'size' 0 picks the largest power of two no bigger than width / 4.  'mipCount' 0
+	// makes the full chain.  Each face texel averages bilinear samples of the image,
+	// more of them when the image is denser than the face; each mip is the 2x2 box
+	// filter of the one above.
+	Cubemap ResampleCube(const Image& image, uint32 size = 0, uint32 mipCount = 0, JobSystem* jobs = nullptr);
+
+	// Direction through point (x, y) of a 'size' texel face, measured in texels from its
+	// top left corner, so texel i is centered at i + 0.5.
+	void CubeDirection(uint32 face, uint32 size, float x, float y, float d[3]);
+
+	// Writes a DDS cube in R16G16B16A16_FLOAT, which DDSReader and the texture streamer
+	// read like any other cube.  Values beyond the half float range are clamped.
+	bool WriteDds(const std::string& path, const Cubemap& cube);
+
+	struct Stats
+	{
+		double ParseMilliseconds = 0.0;
+		double ProjectMilliseconds = 0.0;
+		double ResampleMilliseconds = 0.0;
+		double WriteMilliseconds = 0.0;
+		// Row bands projected plus face tiles resampled.
+		uint32 Tiles = 0;
+		uint32 Threads = 0;
+	};
+
+	// Imports 'hdrPath' into the cube 'ddsPath' and the SH in 'sh'.  Both are only
+	// rebuilt when 'ddsPath' is missing or was made from a different version of the image
+	// or with a different size; "<ddsPath>.key" next to it records which, along with the
+	// SH, so an up to date import does not read the image at all.
+	bool Import(const std::string& hdrPath, const std::string& ddsPath, uint32 size, SH9& sh,
+		bool& rebuilt, Stats* stats = nullptr, std::string* error = nullptr, JobSystem* jobs = nullptr);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 #include "../Common/d3dUtil.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
@@ -14,6 +16,20 @@ struct ObjectConstants
     UINT     vertexOffset; // Vertex offset for visibility buffer.
     UINT     objId; // object id for temporal clamping.
     UINT     ObjPad;
+    DirectX::XMFLOAT4 PosDequantScale = { 1.0f, 1.0f, 1.0f, 0.0f }; // packed vertex positions: PosL = q * scale + bias
+    DirectX::XMFLOAT4 PosDequantBias = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+// Shaders/ObjectConstants.hlsl is cbPerObject, this layout field for field.
+static_assert(sizeof(ObjectConstants) == 304 && offsetof(ObjectConstants, PosDequantScale) == 272,
+    "ObjectConstants must match cbPerObject in Shaders/ObjectConstants.hlsl");
+
+// Per-object transforms for temporal reprojection, indexed by object id, transposed
+// like the constants.
+struct ObjectTransform
+{
+    DirectX::XMFLOAT4X4 InvWorld = MathHelper::Identity4x4();
+    DirectX::XMFLOAT4X4 LastFrameWorld = MathHelper::Identity4x4();
 };
 
 struct PassConstants
@@ -33,12 +49,6 @@ struct PassConstants
     float FarZ = 0.0f;
     float TotalTime = 0.0f;
     float DeltaTime = 0.0f;
-    DirectX::XMFLOAT4X4 InvWorld1 = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 LastFrameWorld1 = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvWorld2 = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 LastFrameWorld2 = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 InvWorld3 = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 LastFrameWorld3 = MathHelper::Identity4x4();
 };
 
 struct MaterialData
@@ -70,7 +80,7 @@ struct FrameResource
 {
 public:
 
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, UINT objectCount, UINT indirectArgCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -79,12 +89,12 @@ public:
     // So each frame needs their own allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
-    // We cannot update a cbuffer until the GPU is done processing the commands
-    // that reference it.  So each frame needs their own cbuffers.
-    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+    // Pass and object constants and material data are rewritten every frame, so they come
+    // from the app's upload ring.  These buffers are only written for what changed.
+    std::unique_ptr<UploadBuffer<ObjectTransform>> ObjectTransforms = nullptr;
 
-    std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
+    // Indirect draw arguments of the meshlets that survived CPU culling this frame.
+    std::unique_ptr<UploadBuffer<D3D12_DRAW_INDEXED_ARGUMENTS>> IndirectArgs = nullptr;
 
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
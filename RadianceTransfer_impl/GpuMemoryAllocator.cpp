@@ -0,0 +1,563 @@
+#include "GpuMemoryAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+const GpuMemoryAllocator::uint64 GpuMemoryAllocator::Granularity;
+
+namespace
+{
+	using uint32 = GpuMemoryAllocator::uint32;
+	using uint64 = GpuMemoryAllocator::uint64;
+
+	// 'mask' must not be 0.
+	uint32 LowestBit(uint64 mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return (uint32)index;
+#else
+		return (uint32)__builtin_ctzll(mask);
+#endif
+	}
+
+	uint32 HighestBit(uint64 mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse64(&index, mask);
+		return (uint32)index;
+#else
+		return 63 - (uint32)__builtin_clzll(mask);
+#endif
+	}
+
+	uint64 AlignUp(uint64 value, uint64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+GpuMemoryAllocator::FreeIndex::FreeIndex()
+{
+	for (uint32 fl = 0; fl < FirstLevelCount; ++fl)
+	{
+		for (uint32 sl = 0; sl < SecondLevelCount; ++sl)
+			Heads[fl][sl] = Invalid;
+	}
+}
+
+GpuMemoryAllocator::GpuMemoryAllocator(GpuMemoryDevice& device, uint64 heapSize)
+	: mDevice(device)
+{
+	mHeapSize = (std::max)(AlignUp(heapSize, Granularity) / Granularity, uint64(1));
+}
+
+GpuMemoryAllocator::~GpuMemoryAllocator()
+{
+	for (const Heap& heap : mHeaps)
+	{
+		if (heap.Live)
+			mDevice.DestroyHeap(heap.DeviceId);
+	}
+}
+
+GpuMemoryAllocator::Allocation GpuMemoryAllocator::Allocate(GpuMemoryClass memoryClass, uint64 size,
+	uint64 alignment, bool movable)
+{
+	if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0)
+		throw std::logic_error("GpuMemoryAllocator: allocating no memory, or at an alignment that is not a power of two");
+
+	const uint64 granules = AlignUp(size, Granularity) / Granularity;
+	const uint64 alignmentGranules = (std::max)(alignment, Granularity) / Granularity;
+
+	uint32 node = Invalid;
+	if (granules > mHeapSize / 2 || granules + alignmentGranules - 1 > mHeapSize)
+	{
+		// Heaps start at offset 0, which every alignment divides.
+		const uint32 heap = CreateHeap(memoryClass, granules, true);
+		node = mHeaps[heap].FirstNode;
+		mNodes[node].Free = false;
+		mNodes[node].Alignment = alignmentGranules;
+		mNodes[node].Movable = movable;
+		mHeaps[heap].Allocated = granules;
+	}
+	else
+	{
+		node = TryAllocate(memoryClass, granules, alignmentGranules, movable);
+		if (node == Invalid)
+		{
+			const uint32 heap = CreateHeap(memoryClass, mHeapSize, false);
+			InsertFree(mHeaps[heap].FirstNode);
+			node = TryAllocate(memoryClass, granules, alignmentGranules, movable);
+		}
+	}
+
+	Stats& stats = mStats[(int)memoryClass];
+	stats.AllocatedBytes += granules * Granularity;
+	stats.PeakAllocatedBytes = (std::max)(stats.PeakAllocatedBytes, stats.AllocatedBytes);
+	++stats.Allocations;
+	return MakeAllocation(node);
+}
+
+void GpuMemoryAllocator::Free(const Allocation& allocation)
+{
+	uint32 node = CheckedNode(allocation);
+	const uint32 heap = mNodes[node].Heap;
+	Heap& owner = mHeaps[heap];
+
+	Stats& stats = mStats[(int)owner.Class];
+	stats.AllocatedBytes -= mNodes[node].Size * Granularity;
+	--stats.Allocations;
+	owner.Allocated -= mNodes[node].Size;
+
+	mNodes[node].Free = true;
+	mNodes[node].Movable = false;
+
+	const uint32 prev = mNodes[node].PrevInHeap;
+	if (prev != Invalid && mNodes[prev].Free)
+	{
+		RemoveFree(prev);
+		Merge(prev, node);
+		node = prev;
+	}
+	const uint32 next = mNodes[node].NextInHeap;
+	if (next != Invalid && mNodes[next].Free)
+	{
+		RemoveFree(next);
+		Merge(node, next);
+	}
+
+	// An empty heap goes, unless it is the last one of its class to allocate from.
+	if (mNodes[node].Size == owner.Size)
+	{
+		bool last = !owner.Dedicated && !owner.Draining;
+		for (uint32 i = 0; i < (uint32)mHeaps.size() && last; ++i)
+		{
+			const Heap& other = mHeaps[i];
+			if (i != heap && other.Live && other.Class == owner.Class && !other.Dedicated && !other.Draining)
+				last = false;
+		}
+		if (!last)
+		{
+			DestroyHeap(heap);
+			return;
+		}
+	}
+
+	InsertFree(node);
+}
+
+void GpuMemoryAllocator::Retire(const Allocation& allocation)
+{
+	mNodes[CheckedNode(allocation)].Retiring = true;
+
+	Retired retired;
+	retired.Memory = allocation;
+	mRetired.push_back(retired);
+	mStats[(int)allocation.Class].RetiredBytes += allocation.Size;
+}
+
+void GpuMemoryAllocator::BeginFrame(uint64 completedFence)
+{
+	// Fences only grow, so what can be freed is at the front.
+	while (!mRetired.empty() && mRetired.front().Fence != 0 && mRetired.front().Fence <= completedFence)
+	{
+		const Allocation allocation = mRetired.front().Memory;
+		mRetired.pop_front();
+		mStats[(int)allocation.Class].RetiredBytes -= allocation.Size;
+		mNodes[allocation.Node].Retiring = false;
+		Free(allocation);
+	}
+}
+
+void GpuMemoryAllocator::EndFrame(uint64 fence)
+{
+	for (auto it = mRetired.rbegin(); it != mRetired.rend() && it->Fence == 0; ++it)
+		it->Fence = fence;
+}
+
+std::vector<GpuMemoryAllocator::Move> GpuMemoryAllocator::PlanDefragmentation(GpuMemoryClass memoryClass, uint64 maxBytes)
+{
+	std::vector<uint32> candidates;
+	for (uint32 heap = 0; heap < (uint32)mHeaps.size(); ++heap)
+	{
+		const Heap& candidate = mHeaps[heap];
+		if (!candidate.Live || candidate.Class != memoryClass || candidate.Dedicated ||
+			candidate.Draining || candidate.Allocated == 0)
+			continue;
+
+		bool movable = true;
+		for (uint32 node = candidate.FirstNode; node != Invalid && movable; node = mNodes[node].NextInHeap)
+			movable = mNodes[node].Free || mNodes[node].Movable;
+		if (movable)
+			candidates.push_back(heap);
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[this](uint32 a, uint32 b) { return mHeaps[a].Allocated < mHeaps[b].Allocated; });
+
+	std::vector<Move> moves;
+	std::vector<bool> received(mHeaps.size(), false);
+	uint64 movedBytes = 0;
+	for (uint32 source : candidates)
+	{
+		// Moving what was just moved in would only copy it twice.
+		if (received[source])
+			continue;
+
+		// Retiring allocations stay where they are; a heap with nothing else is left to
+		// take new allocations once they are freed.
+		std::vector<uint32> allocated;
+		uint64 allocatedSize = 0;
+		for (uint32 node = mHeaps[source].FirstNode; node != Invalid; node = mNodes[node].NextInHeap)
+		{
+			if (!mNodes[node].Free && !mNodes[node].Retiring)
+			{
+				allocated.push_back(node);
+				allocatedSize += mNodes[node].Size;
+			}
+		}
+		if (allocated.empty())
+			continue;
+		if (movedBytes + allocatedSize * Granularity > maxBytes)
+			break;
+
+		// Nothing new goes into the heap from here on, so it empties as the moves finish.
+		mHeaps[source].Draining = true;
+		for (uint32 node = mHeaps[source].FirstNode; node != Invalid; node = mNodes[node].NextInHeap)
+		{
+			if (mNodes[node].Free)
+				RemoveFree(node);
+		}
+
+		const size_t firstMove = moves.size();
+		bool placed = true;
+		for (uint32 node : allocated)
+		{
+			const uint32 to = TryAllocate(memoryClass, mNodes[node].Size, mNodes[node].Alignment, true);
+			if (to == Invalid)
+			{
+				placed = false;
+				break;
+			}
+			received[mNodes[to].Heap] = true;
+
+			Move move;
+			move.From = MakeAllocation(node);
+			move.To = MakeAllocation(to);
+			moves.push_back(move);
+
+			Stats& stats = mStats[(int)memoryClass];
+			stats.AllocatedBytes += move.To.Size;
+			stats.PeakAllocatedBytes = (std::max)(stats.PeakAllocatedBytes, stats.AllocatedBytes);
+			++stats.Allocations;
+		}
+
+		if (!placed)
+		{
+			// The other heaps are too full to empty this one; leave it as it was.
+			for (size_t i = firstMove; i < moves.size(); ++i)
+				Free(moves[i].To);
+			moves.resize(firstMove);
+			mHeaps[source].Draining = false;
+			for (uint32 node = mHeaps[source].FirstNode; node != Invalid; node = mNodes[node].NextInHeap)
+			{
+				if (mNodes[node].Free)
+					InsertFree(node);
+			}
+			break;
+		}
+
+		movedBytes += allocatedSize * Granularity;
+		mStats[(int)memoryClass].Moves += (uint32)(moves.size() - firstMove);
+	}
+
+	return moves;
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetStats(GpuMemoryClass memoryClass)const
+{
+	Stats stats = mStats[(int)memoryClass];
+
+	// The largest free block is in the last non-empty list.
+	const FreeIndex& index = mIndex[(int)memoryClass];
+	if (index.FirstLevel != 0)
+	{
+		const uint32 fl = HighestBit(index.FirstLevel);
+		const uint32 sl = HighestBit(index.SecondLevel[fl]);
+		for (uint32 node = index.Heads[fl][sl]; node != Invalid; node = mNodes[node].NextFree)
+			stats.LargestFreeBlock = (std::max)(stats.LargestFreeBlock, mNodes[node].Size * Granularity);
+	}
+
+	const uint64 freeBytes = mFreeBytes[(int)memoryClass] * Granularity;
+	stats.Fragmentation = freeBytes == 0 ? 0.0f : 1.0f - (float)((double)stats.LargestFreeBlock / freeBytes);
+	return stats;
+}
+
+void GpuMemoryAllocator::ListOf(uint64 size, uint32* firstLevel, uint32* secondLevel)
+{
+	// Sizes below the second level count each get a list; above, every power of two is
+	// split into as many lists.
+	if (size < SecondLevelCount)
+	{
+		*firstLevel = 0;
+		*secondLevel = (uint32)size;
+		return;
+	}
+
+	const uint32 high = HighestBit(size);
+	*firstLevel = high - SecondLevelBits + 1;
+	*secondLevel = (uint32)(size >> (high - SecondLevelBits)) - SecondLevelCount;
+}
+
+GpuMemoryAllocator::uint32 GpuMemoryAllocator::CreateHeap(GpuMemoryClass memoryClass, uint64 size, bool dedicated)
+{
+	const uint32 deviceId = mDevice.CreateHeap(memoryClass, size * Granularity);
+
+	uint32 heap = 0;
+	if (!mFreeHeaps.empty())
+	{
+		heap = mFreeHeaps.back();
+		mFreeHeaps.pop_back();
+	}
+	else
+	{
+		heap = (uint32)mHeaps.size();
+		mHeaps.push_back(Heap());
+	}
+
+	const uint32 node = NewNode();
+	mNodes[node].Heap = heap;
+	mNodes[node].Size = size;
+	mNodes[node].Free = true;
+
+	Heap& created = mHeaps[heap];
+	created = Heap();
+	created.Class = memoryClass;
+	created.DeviceId = deviceId;
+	created.Size = size;
+	created.FirstNode = node;
+	created.Live = true;
+	created.Dedicated = dedicated;
+
+	Stats& stats = mStats[(int)memoryClass];
+	++stats.Heaps;
+	stats.HeapBytes += size * Granularity;
+	++stats.HeapsCreated;
+	return heap;
+}
+
+void GpuMemoryAllocator::DestroyHeap(uint32 heap)
+{
+	Heap& destroyed = mHeaps[heap];
+	RemoveFree(destroyed.FirstNode);
+	ReleaseNode(destroyed.FirstNode);
+	mDevice.DestroyHeap(destroyed.DeviceId);
+
+	Stats& stats = mStats[(int)destroyed.Class];
+	--stats.Heaps;
+	stats.HeapBytes -= destroyed.Size * Granularity;
+	++stats.HeapsDestroyed;
+
+	destroyed = Heap();
+	mFreeHeaps.push_back(heap);
+}
+
+GpuMemoryAllocator::uint32 GpuMemoryAllocator::FindFree(GpuMemoryClass memoryClass, uint64 size)const
+{
+	// Round up to the next list, so whatever heads the list found is large enough.
+	uint64 rounded = size;
+	if (size >= SecondLevelCount)
+		rounded += (uint64(1) << (HighestBit(size) - SecondLevelBits)) - 1;
+
+	uint32 fl = 0;
+	uint32 sl = 0;
+	ListOf(rounded, &fl, &sl);
+
+	const FreeIndex& index = mIndex[(int)memoryClass];
+	uint32 secondLevelMap = index.SecondLevel[fl] & (~0u << sl);
+	if (secondLevelMap == 0)
+	{
+		if (fl + 1 >= FirstLevelCount)
+			return Invalid;
+		const uint64 firstLevelMap = index.FirstLevel & (~uint64(0) << (fl + 1));
+		if (firstLevelMap == 0)
+			return Invalid;
+		fl = LowestBit(firstLevelMap);
+		secondLevelMap = index.SecondLevel[fl];
+	}
+	sl = LowestBit(secondLevelMap);
+	return index.Heads[fl][sl];
+}
+
+void GpuMemoryAllocator::InsertFree(uint32 node)
+{
+	Node& inserted = mNodes[node];
+	inserted.Free = true;
+	const Heap& heap = mHeaps[inserted.Heap];
+	if (heap.Draining)
+		return;
+
+	uint32 fl = 0;
+	uint32 sl = 0;
+	ListOf(inserted.Size, &fl, &sl);
+
+	FreeIndex& index = mIndex[(int)heap.Class];
+	inserted.PrevFree = Invalid;
+	inserted.NextFree = index.Heads[fl][sl];
+	if (inserted.NextFree != Invalid)
+		mNodes[inserted.NextFree].PrevFree = node;
+	index.Heads[fl][sl] = node;
+	index.FirstLevel |= uint64(1) << fl;
+	index.SecondLevel[fl] |= 1u << sl;
+	inserted.Listed = true;
+
+	++mStats[(int)heap.Class].FreeBlocks;
+	mFreeBytes[(int)heap.Class] += inserted.Size;
+}
+
+void GpuMemoryAllocator::RemoveFree(uint32 node)
+{
+	Node& removed = mNodes[node];
+	if (!removed.Listed)
+		return;
+
+	uint32 fl = 0;
+	uint32 sl = 0;
+	ListOf(removed.Size, &fl, &sl);
+
+	const GpuMemoryClass memoryClass = mHeaps[removed.Heap].Class;
+	FreeIndex& index = mIndex[(int)memoryClass];
+	if (removed.PrevFree != Invalid)
+		mNodes[removed.PrevFree].NextFree = removed.NextFree;
+	else
+		index.Heads[fl][sl] = removed.NextFree;
+	if (removed.NextFree != Invalid)
+		mNodes[removed.NextFree].PrevFree = removed.PrevFree;
+
+	if (index.Heads[fl][sl] == Invalid)
+	{
+		index.SecondLevel[fl] &= ~(1u << sl);
+		if (index.SecondLevel[fl] == 0)
+			index.FirstLevel &= ~(uint64(1) << fl);
+	}
+
+	removed.PrevFree = Invalid;
+	removed.NextFree = Invalid;
+	removed.Listed = false;
+
+	--mStats[(int)memoryClass].FreeBlocks;
+	mFreeBytes[(int)memoryClass] -= removed.Size;
+}
+
+GpuMemoryAllocator::uint32 GpuMemoryAllocator::TryAllocate(GpuMemoryClass memoryClass, uint64 size,
+	uint64 alignment, bool movable)
+{
+	// Large enough for the size wherever in the block the aligned offset lands.
+	uint32 node = FindFree(memoryClass, size + alignment - 1);
+	if (node == Invalid)
+		return Invalid;
+	RemoveFree(node);
+
+	const uint64 aligned = AlignUp(mNodes[node].Offset, alignment);
+	if (aligned > mNodes[node].Offset)
+		InsertFree(SplitFront(node, aligned - mNodes[node].Offset));
+	if (mNodes[node].Size > size)
+	{
+		const uint32 allocated = SplitFront(node, size);
+		InsertFree(node);
+		node = allocated;
+	}
+
+	Node& allocated = mNodes[node];
+	allocated.Free = false;
+	allocated.Alignment = alignment;
+	allocated.Movable = movable;
+	mHeaps[allocated.Heap].Allocated += size;
+	return node;
+}
+
+GpuMemoryAllocator::uint32 GpuMemoryAllocator::SplitFront(uint32 node, uint64 size)
+{
+	const uint32 front = NewNode();
+	Node& rest = mNodes[node];
+	Node& split = mNodes[front];
+
+	split.Heap = rest.Heap;
+	split.Offset = rest.Offset;
+	split.Size = size;
+	split.PrevInHeap = rest.PrevInHeap;
+	split.NextInHeap = node;
+	if (rest.PrevInHeap != Invalid)
+		mNodes[rest.PrevInHeap].NextInHeap = front;
+	else
+		mHeaps[rest.Heap].FirstNode = front;
+
+	rest.PrevInHeap = front;
+	rest.Offset += size;
+	rest.Size -= size;
+	return front;
+}
+
+void GpuMemoryAllocator::Merge(uint32 node, uint32 next)
+{
+	Node& merged = mNodes[node];
+	merged.Size += mNodes[next].Size;
+	merged.NextInHeap = mNodes[next].NextInHeap;
+	if (merged.NextInHeap != Invalid)
+		mNodes[merged.NextInHeap].PrevInHeap = node;
+	ReleaseNode(next);
+}
+
+GpuMemoryAllocator::uint32 GpuMemoryAllocator::NewNode()
+{
+	uint32 node = 0;
+	if (!mFreeNodes.empty())
+	{
+		node = mFreeNodes.back();
+		mFreeNodes.pop_back();
+		mNodes[node] = Node();
+	}
+	else
+	{
+		node = (uint32)mNodes.size();
+		mNodes.push_back(Node());
+	}
+	return node;
+}
+
+void GpuMemoryAllocator::ReleaseNode(uint32 node)
+{
+	mNodes[node] = Node();
+	mFreeNodes.push_back(node);
+}
+
+GpuMemoryAllocator::uint32 GpuMemoryAllocator::CheckedNode(const Allocation& allocation)const
+{
+	const uint32 node = allocation.Node;
+	if (node >= mNodes.size() || mNodes[node].Heap == Invalid || mNodes[node].Free ||
+		mHeaps[mNodes[node].Heap].DeviceId != allocation.Heap ||
+		mNodes[node].Offset * Granularity != allocation.Offset ||
+		mNodes[node].Size * Granularity != allocation.Size || mNodes[node].Retiring)
+		throw std::logic_error("GpuMemoryAllocator: freeing memory that is not allocated");
+	return node;
+}
+
+GpuMemoryAllocator::Allocation GpuMemoryAllocator::MakeAllocation(uint32 node)const
+{
+	const Node& allocated = mNodes[node];
+	const Heap& heap = mHeaps[allocated.Heap];
+
+	Allocation allocation;
+	allocation.Class = heap.Class;
+	allocation.Heap = heap.DeviceId;
+	allocation.Offset = allocated.Offset * Granularity;
+	allocation.Size = allocated.Size * Granularity;
+	allocation.Node = node;
+	return allocation;
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// The kinds of resource D3D12 keeps in separate heaps on resource heap tier 1 hardware.
+// Each class has heaps of its own, and its own placement alignment.
+enum class GpuMemoryClass
+{
+	Buffer,       // 64 KB
+	Texture,      // 64 KB; neither render target nor depth stencil
+	RenderTarget, // render targets and depth stencils, 4 MB when multisampled
+	Count
+};
+
+// What the allocator needs from the graphics API: heaps of device memory that resources
+// are placed in at an offset.  D3D12ResourceHeaps makes them ID3D12Heaps,
+// MockGpuMemoryDevice only numbers them.
+class GpuMemoryDevice
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	virtual ~GpuMemoryDevice() = default;
+
+	// Returns the id DestroyHeap takes.
+	virtual uint32 CreateHeap(GpuMemoryClass memoryClass, uint64 size) = 0;
+
+	// Only called once nothing placed in the heap is in use.
+	virtual void DestroyHeap(uint32 id) = 0;
+};
+
+// Offsets in device heaps for placed resources, without the heaps.  Each memory class
+// has heaps of a fixed size, carved up with TLSF (two-level segregated fit): free blocks
+// sit in lists by size, 16 lists per power of two, and two levels of bitmaps find the
+// first non-empty list large enough in constant time.  Freed blocks merge with their free
+// neighbours in the heap.  Resources larger than half a heap get a heap to themselves.
+//
+// Sizes and offsets are in multiples of 64 KB, the smallest placement alignment used.
+// Memory the GPU may still be using is retired rather than freed, and freed once the
+// fence of the frame that retired it completes, as UploadAllocator does with its blocks.
+//
+// For defragmentation, PlanDefragmentation() picks the emptiest heaps of a class and
+// allocates new places for what they hold in the others.  The caller copies the
+// resources over and retires the old places, after which the heaps are destroyed.  Only
+// allocations made movable are moved.
+class GpuMemoryAllocator
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint64 Granularity = 64 * 1024;
+
+	struct Allocation
+	{
+		GpuMemoryClass Class = GpuMemoryClass::Buffer;
+		uint32 Heap = 0;     // device heap id
+		uint64 Offset = 0;
+		uint64 Size = 0;
+		uint32 Node = 0;
+	};
+
+	struct Move
+	{
+		Allocation From;
+		Allocation To;
+	};
+
+	struct Stats
+	{
+		uint32 Heaps = 0;
+		uint64 HeapBytes = 0;
+		uint64 AllocatedBytes = 0;
+		uint64 PeakAllocatedBytes = 0;
+		uint32 Allocations = 0;
+		uint32 FreeBlocks = 0;
+		uint64 LargestFreeBlock = 0;
+		float Fragmentation = 0.0f; // 1 - largest free block / free bytes
+		uint64 RetiredBytes = 0;    // waiting on the GPU
+		uint32 HeapsCreated = 0;
+		uint32 HeapsDestroyed = 0;
+		uint32 Moves = 0;
+	};
+
+	GpuMemoryAllocator(GpuMemoryDevice& device, uint64 heapSize);
+	GpuMemoryAllocator(const GpuMemoryAllocator& rhs) = delete;
+	GpuMemoryAllocator& operator=(const GpuMemoryAllocator& rhs) = delete;
+	// Destroys every heap; the GPU must be done with all of them.
+	~GpuMemoryAllocator();
+
+	// 'alignment' must be a power of two.  Creates a heap when none has room.
+	Allocation Allocate(GpuMemoryClass memoryClass, uint64 size, uint64 alignment, bool movable = false);
+	// Only for memory the GPU is done with.  Throws std::logic_error for an allocation
+	// that is not alive.
+	void Free(const Allocation& allocation);
+	// Frees 'allocation' once the frame that retires it has completed on the GPU.
+	void Retire(const Allocation& allocation);
+
+	// Frees what the frames whose fence is at most 'completedFence' retired.
+	void BeginFrame(uint64 completedFence);
+	void EndFrame(uint64 fence);
+
+	// New places for the movable allocations of the emptiest heaps of 'memoryClass', a
+	// heap at a time while the bytes moved stay within 'maxBytes'.  Only heaps with
+	// something to move that can be emptied entirely into the other heaps are chosen;
+	// they take no allocations from then on.
+	std::vector<Move> PlanDefragmentation(GpuMemoryClass memoryClass, uint64 maxBytes);
+
+	Stats GetStats(GpuMemoryClass memoryClass)const;
+
+private:
+	static const uint32 SecondLevelBits = 4;
+	static const uint32 SecondLevelCount = 1 << SecondLevelBits;
+	static const uint32 FirstLevelCount = 64 - SecondLevelBits + 1;
+	static const uint32 Invalid = 0xFFFFFFFF;
+
+	// A run of a heap, allocated or free.  Runs of a heap are linked in address order.
+	struct Node
+	{
+		uint32 Heap = Invalid;
+		uint64 Offset = 0; // in granules, as are sizes here
+		uint64 Size = 0;
+		uint64 Alignment = 1;
+		uint32 PrevInHeap = Invalid;
+		uint32 NextInHeap = Invalid;
+		uint32 PrevFree = Invalid;
+		uint32 NextFree = Invalid;
+		bool Free = false;
+		bool Listed = false; // in a free list; draining heaps keep theirs out
+		bool Movable = false;
+		bool Retiring = false; // freed once its frame completes, so never moved
+	};
+
+	struct Heap
+	{
+		GpuMemoryClass Class = GpuMemoryClass::Buffer;
+		uint32 DeviceId = 0;
+		uint64 Size = 0;
+		uint64 Allocated = 0;
+		uint32 FirstNode = Invalid;
+		bool Live = false;
+		bool Dedicated = false;
+		bool Draining = false;
+	};
+
+	// The free lists of a class.
+	struct FreeIndex
+	{
+		uint64 FirstLevel = 0;
+		uint32 SecondLevel[FirstLevelCount] = {};
+		uint32 Heads[FirstLevelCount][SecondLevelCount];
+
+		FreeIndex();
+	};
+
+	struct Retired
+	{
+		Allocation Memory;
+		uint64 Fence = 0; // 0 until the frame that retired it ends
+	};
+
+	static void ListOf(uint64 size, uint32* firstLevel, uint32* secondLevel);
+
+	uint32 CreateHeap(GpuMemoryClass memoryClass, uint64 size, bool dedicated);
+	void DestroyHeap(uint32 heap);
+
+	// A free node of at least 'size' granules, or Invalid.
+	uint32 FindFree(GpuMemoryClass memoryClass, uint64 size)const;
+	void InsertFree(uint32 node);
+	void RemoveFree(uint32 node);
+
+	// Allocates from the free lists only; returns Invalid when nothing fits.
+	uint32 TryAllocate(GpuMemoryClass memoryClass, uint64 size, uint64 alignment, bool movable);
+	// Splits the first 'size' granules off 'node', as a new node before it.
+	uint32 SplitFront(uint32 node, uint64 size);
+	void Merge(uint32 node, uint32 next);
+
+	uint32 NewNode();
+	void ReleaseNode(uint32 node);
+	// Throws std::logic_error unless 'allocation' is alive and not retired.
+	uint32 CheckedNode(const Allocation& allocation)const;
+	Allocation MakeAllocation(uint32 node)const;
+
+private:
+	GpuMemoryDevice& mDevice;
+	uint64 mHeapSize = 0; // in granules
+
+	std::vector<Node> mNodes;
+	std::vector<uint32> mFreeNodes;
+	std::vector<Heap> mHeaps;
+	std::vector<uint32> mFreeHeaps;
+
+	FreeIndex mIndex[(int)GpuMemoryClass::Count];
+	Stats mStats[(int)GpuMemoryClass::Count];
+	uint64 mFreeBytes[(int)GpuMemoryClass::Count] = {}; // in the free lists
+
+	std::deque<Retired> mRetired;
+};
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <vector>
-#include "../../Common/GeometryGenerator.h"
+#include "../Common/GeometryGenerator.h"
 
 using namespace std;
 
@@ -13,13 +13,13 @@ class Mesh
     using Vertex = GeometryGenerator::Vertex;
 
 public:
+    // takes the vectors by value so callers can move their data in without a copy.
     Mesh(vector<Vertex> vertices, vector<uint32> indices)
+        : vertices(std::move(vertices)), indices(std::move(indices))
     {
-        this->vertices = vertices;
-        this->indices = indices;
     }
 
-    MeshData CreateMesh()
+    MeshData CreateMesh() const &
     {
         MeshData mesh;
         mesh.Vertices = vertices;
@@ -27,6 +27,14 @@ public:
         return mesh;
     }
 
+    MeshData CreateMesh() &&
+    {
+        MeshData mesh;
+        mesh.Vertices = std::move(vertices);
+        mesh.Indices32 = std::move(indices);
+        return mesh;
+    }
+
 public:
     // mesh Data
     vector<Vertex> vertices;
@@ -0,0 +1,339 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+namespace
+{
+	const std::uint32_t kMagic = 0x434D5452; // "RTMC"
+	const std::uint64_t kAlignment = 16;
+
+	struct FileHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint32_t VertexStride;
+		std::uint32_t SubmeshCount;
+
+		std::uint64_t SourceSize;
+		std::uint64_t SourceWriteTime;
+		std::uint64_t SourceHash;
+
+		std::uint32_t VertexCount;
+		std::uint32_t IndexCount;
+
+		std::uint64_t SubmeshOffset;
+		std::uint64_t VertexOffset;
+		std::uint64_t IndexOffset;
+		std::uint64_t FileSize;
+
+		float BoundsMin[3];
+		float BoundsMax[3];
+	};
+
+	struct FileSubmesh
+	{
+		char Name[32];
+		std::uint32_t IndexCount;
+		std::uint32_t StartIndex;
+		std::uint32_t BaseVertex;
+		std::uint32_t VertexCount;
+		float BoundsMin[3];
+		float BoundsMax[3];
+	};
+
+	static_assert(sizeof(FileHeader) == 104, "Mesh cache header layout changed, bump MeshCache::Version");
+	static_assert(sizeof(FileSubmesh) == 72, "Mesh cache submesh layout changed, bump MeshCache::Version");
+
+	std::uint64_t AlignUp(std::uint64_t v)
+	{
+		return (v + kAlignment - 1) & ~(kAlignment - 1);
+	}
+
+	void ExtendBounds(MeshCache::Bounds& b, const DirectX::XMFLOAT3& p)
+	{
+		b.Min.x = std::min(b.Min.x, p.x); b.Max.x = std::max(b.Max.x, p.x);
+		b.Min.y = std::min(b.Min.y, p.y); b.Max.y = std::max(b.Max.y, p.y);
+		b.Min.z = std::min(b.Min.z, p.z); b.Max.z = std::max(b.Max.z, p.z);
+	}
+
+	MeshCache::Bounds EmptyBounds()
+	{
+		MeshCache::Bounds b;
+		b.Min = DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		b.Max = DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		return b;
+	}
+
+	void StoreBounds(const MeshCache::Bounds& b, float outMin[3], float outMax[3])
+	{
+		outMin[0] = b.Min.x; outMin[1] = b.Min.y; outMin[2] = b.Min.z;
+		outMax[0] = b.Max.x; outMax[1] = b.Max.y; outMax[2] = b.Max.z;
+	}
+
+	MeshCache::Bounds LoadBounds(const float inMin[3], const float inMax[3])
+	{
+		MeshCache::Bounds b;
+		b.Min = DirectX::XMFLOAT3(inMin[0], inMin[1], inMin[2]);
+		b.Max = DirectX::XMFLOAT3(inMax[0], inMax[1], inMax[2]);
+		return b;
+	}
+}
+
+const char* MeshCache::ResultName(Result result)
+{
+	switch (result)
+	{
+	case Result::Hit:       return "hit";
+	case Result::HitByHash: return "hit (content hash)";
+	case Result::Missing:   return "missing";
+	case Result::Invalid:   return "invalid";
+	case Result::Stale:     return "stale";
+	}
+	return "unknown";
+}
+
+MeshCache::Result MeshCache::OpenForFile(const std::string& cachePath, const std::string& sourcePath)
+{
+	Result result = Open(cachePath);
+	if (result != Result::Hit)
+		return result;
+
+	FileUtil::FileStamp stamp;
+	if (!FileUtil::GetFileStamp(sourcePath, stamp))
+		return Result::Hit;
+
+	if (stamp.Size == mSourceSize && stamp.WriteTime == mSourceWriteTime)
+		return Result::Hit;
+
+	// Touched or copied: only rebuild if the bytes actually changed.
+	if (stamp.Size == mSourceSize)
+	{
+		MappedFile source(sourcePath);
+		if (source.IsOpen() && FileUtil::HashBytes(source.Data(), source.Size()) == mSourceHash)
+			return Result::HitByHash;
+	}
+
+	Close();
+	return Result::Stale;
+}
+
+MeshCache::Result MeshCache::OpenForKey(const std::string& cachePath, const std::string& key)
+{
+	Result result = Open(cachePath);
+	if (result != Result::Hit)
+		return result;
+
+	if (mSourceHash != FileUtil::HashString(key))
+	{
+		Close();
+		return Result::Stale;
+	}
+
+	return Result::Hit;
+}
+
+MeshCache::Result MeshCache::Open(const std::string& cachePath)
+{
+	Close();
+
+	if (!mFile.Open(cachePath))
+		return FileUtil::FileExists(cachePath) ? Result::Invalid : Result::Missing;
+
+	const std::uint8_t* base = mFile.Data();
+	const std::uint64_t size = mFile.Size();
+
+	FileHeader header;
+	if (size < sizeof(header))
+	{
+		Close();
+		return Result::Invalid;
+	}
+	std::memcpy(&header, base, sizeof(header));
+
+	const std::uint64_t vertexBytes = std::uint64_t(header.VertexCount) * sizeof(Vertex);
+	const std::uint64_t indexBytes = std::uint64_t(header.IndexCount) * sizeof(uint32);
+	const std::uint64_t submeshBytes = std::uint64_t(header.SubmeshCount) * sizeof(FileSubmesh);
+
+	const bool valid =
+		header.Magic == kMagic &&
+		header.Version == Version &&
+		header.VertexStride == sizeof(Vertex) &&
+		header.FileSize == size &&
+		header.SubmeshOffset % kAlignment == 0 && header.SubmeshOffset + submeshBytes <= size &&
+		header.VertexOffset % kAlignment == 0 && header.VertexOffset + vertexBytes <= size &&
+		header.IndexOffset % kAlignment == 0 && header.IndexOffset + indexBytes <= size;
+	if (!valid)
+	{
+		Close();
+		return Result::Invalid;
+	}
+
+	// Every index, and every index of a submesh past its base vertex, must name a vertex
+	// of the file; whatever reads them next indexes an array or a GPU buffer with them.
+	const uint32* indices = reinterpret_cast<const uint32*>(base + header.IndexOffset);
+	for (uint32 i = 0; i < header.IndexCount; ++i)
+	{
+		if (indices[i] >= header.VertexCount)
+		{
+			Close();
+			return Result::Invalid;
+		}
+	}
+
+	const FileSubmesh* submeshes = reinterpret_cast<const FileSubmesh*>(base + header.SubmeshOffset);
+	mSubmeshes.resize(header.SubmeshCount);
+	for (uint32 i = 0; i < header.SubmeshCount; ++i)
+	{
+		const FileSubmesh& src = submeshes[i];
+		if (std::uint64_t(src.StartIndex) + src.IndexCount > header.IndexCount ||
+			std::uint64_t(src.BaseVertex) + src.VertexCount > header.VertexCount)
+		{
+			Close();
+			return Result::Invalid;
+		}
+		if (src.BaseVertex > 0)
+		{
+			const uint32 limit = header.VertexCount - src.BaseVertex;
+			for (uint32 j = src.StartIndex; j < src.StartIndex + src.IndexCount; ++j)
+			{
+				if (indices[j] >= limit)
+				{
+					Close();
+					return Result::Invalid;
+				}
+			}
+		}
+
+		Submesh& dst = mSubmeshes[i];
+		dst.Name.assign(src.Name, strnlen(src.Name, sizeof(src.Name)));
+		dst.IndexCount = src.IndexCount;
+		dst.StartIndex = src.StartIndex;
+		dst.BaseVertex = src.BaseVertex;
+		dst.VertexCount = src.VertexCount;
+		dst.Box = LoadBounds(src.BoundsMin, src.BoundsMax);
+	}
+
+	mSourceSize = header.SourceSize;
+	mSourceWriteTime = header.SourceWriteTime;
+	mSourceHash = header.SourceHash;
+
+	mVertices = reinterpret_cast<const Vertex*>(base + header.VertexOffset);
+	mIndices = reinterpret_cast<const uint32*>(base + header.IndexOffset);
+	mVertexCount = header.VertexCount;
+	mIndexCount = header.IndexCount;
+	mBounds = LoadBounds(header.BoundsMin, header.BoundsMax);
+
+	return Result::Hit;
+}
+
+void MeshCache::Close()
+{
+	mFile.Close();
+	mSourceSize = 0;
+	mSourceWriteTime = 0;
+	mSourceHash = 0;
+	mVertices = nullptr;
+	mIndices = nullptr;
+	mVertexCount = 0;
+	mIndexCount = 0;
+	mBounds = Bounds();
+	mSubmeshes.clear();
+}
+
+MeshCache::MeshData MeshCache::ToMeshData()const
+{
+	MeshData data;
+	data.Vertices.assign(mVertices, mVertices + mVertexCount);
+	data.Indices32.assign(mIndices, mIndices + mIndexCount);
+	return data;
+}
+
+bool MeshCache::WriteForFile(const std::string& cachePath, const std::string& sourcePath,
+	const MeshData& mesh, std::vector<Submesh> submeshes)
+{
+	MappedFile source(sourcePath);
+	FileUtil::FileStamp stamp;
+	if (!source.IsOpen() || !FileUtil::GetFileStamp(sourcePath, stamp))
+		return false;
+
+	return Write(cachePath, stamp.Size, stamp.WriteTime,
+		FileUtil::HashBytes(source.Data(), source.Size()), mesh, submeshes);
+}
+
+bool MeshCache::WriteForKey(const std::string& cachePath, const std::string& key,
+	const MeshData& mesh, std::vector<Submesh> submeshes)
+{
+	return Write(cachePath, 0, 0, FileUtil::HashString(key), mesh, submeshes);
+}
+
+bool MeshCache::Write(const std::string& cachePath, std::uint64_t sourceSize, std::uint64_t sourceWriteTime,
+	std::uint64_t sourceHash, const MeshData& mesh, std::vector<Submesh>& submeshes)
+{
+	const std::uint64_t vertexCount = mesh.Vertices.size();
+	const std::uint64_t indexCount = mesh.Indices32.size();
+
+	// A mesh without explicit parts is one submesh spanning everything.
+	if (submeshes.empty())
+	{
+		Submesh all;
+		all.Name = "all";
+		all.IndexCount = uint32(indexCount);
+		all.VertexCount = uint32(vertexCount);
+		submeshes.push_back(all);
+	}
+
+	FileHeader header = {};
+	header.Magic = kMagic;
+	header.Version = Version;
+	header.VertexStride = sizeof(Vertex);
+	header.SubmeshCount = uint32(submeshes.size());
+	header.SourceSize = sourceSize;
+	header.SourceWriteTime = sourceWriteTime;
+	header.SourceHash = sourceHash;
+	header.VertexCount = uint32(vertexCount);
+	header.IndexCount = uint32(indexCount);
+	header.SubmeshOffset = AlignUp(sizeof(FileHeader));
+	header.VertexOffset = AlignUp(header.SubmeshOffset + submeshes.size() * sizeof(FileSubmesh));
+	header.IndexOffset = AlignUp(header.VertexOffset + vertexCount * sizeof(Vertex));
+	header.FileSize = header.IndexOffset + indexCount * sizeof(uint32);
+
+	Bounds meshBounds = EmptyBounds();
+	for (const Vertex& v : mesh.Vertices)
+		ExtendBounds(meshBounds, v.Position);
+	StoreBounds(meshBounds, header.BoundsMin, header.BoundsMax);
+
+	std::vector<std::uint8_t> blob(size_t(header.FileSize), 0);
+	std::memcpy(blob.data(), &header, sizeof(header));
+
+	FileSubmesh* fileSubmeshes = reinterpret_cast<FileSubmesh*>(blob.data() + header.SubmeshOffset);
+	for (size_t i = 0; i < submeshes.size(); ++i)
+	{
+		Submesh& sm = submeshes[i];
+
+		// Bounds of the vertices the submesh actually references.
+		sm.Box = EmptyBounds();
+		for (uint32 j = 0; j < sm.IndexCount; ++j)
+			ExtendBounds(sm.Box, mesh.Vertices[sm.BaseVertex + mesh.Indices32[sm.StartIndex + j]].Position);
+
+		FileSubmesh& dst = fileSubmeshes[i];
+		std::strncpy(dst.Name, sm.Name.c_str(), sizeof(dst.Name) - 1);
+		dst.IndexCount = sm.IndexCount;
+		dst.StartIndex = sm.StartIndex;
+		dst.BaseVertex = sm.BaseVertex;
+		dst.VertexCount = sm.VertexCount;
+		StoreBounds(sm.Box, dst.BoundsMin, dst.BoundsMax);
+	}
+
+	if (vertexCount > 0)
+		std::memcpy(blob.data() + header.VertexOffset, mesh.Vertices.data(), size_t(vertexCount * sizeof(Vertex)));
+	if (indexCount > 0)
+		std::memcpy(blob.data() + header.IndexOffset, mesh.Indices32.data(), size_t(indexCount * sizeof(uint32)));
+
+	const size_t slash = cachePath.find_last_of("/\\");
+	if (slash != std::string::npos)
+		FileUtil::CreateDirectories(cachePath.substr(0, slash));
+
+	return FileUtil::WriteFileAtomic(cachePath, blob.data(), blob.size());
+}
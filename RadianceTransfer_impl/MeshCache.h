@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../Common/FileUtil.h"
+#include "../Common/GeometryGenerator.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Versioned binary mesh cache.  A cache file is mapped read-only and its vertex
+// and index sections are handed out as raw pointers, so they can be copied into
+// an upload buffer straight from the page cache without building a MeshData.
+//
+// On-disk layout (little endian, every section 16-byte aligned):
+//   header | submesh table | vertices (GeometryGenerator::Vertex) | uint32 indices
+//
+// A cache built from a file remembers the source size, write time and FNV-1a
+// content hash.  Size and time are checked first; if they differ the source is
+// hashed and the cache is still accepted when the content is unchanged.  Caches
+// of generated meshes are keyed by a hash of the generator parameters instead.
+class MeshCache
+{
+public:
+	using uint32 = GeometryGenerator::uint32;
+	using Vertex = GeometryGenerator::Vertex;
+	using MeshData = GeometryGenerator::MeshData;
+
+	// Bump whenever the file layout or the data written into it changes.
+	static const uint32 Version = 4;
+
+	struct Bounds
+	{
+		DirectX::XMFLOAT3 Min = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 Max = { 0.0f, 0.0f, 0.0f };
+	};
+
+	struct Submesh
+	{
+		std::string Name;
+		uint32 IndexCount = 0;
+		uint32 StartIndex = 0;
+		uint32 BaseVertex = 0;
+		uint32 VertexCount = 0;
+		Bounds Box; // filled in by Write()
+	};
+
+	enum class Result
+	{
+		Hit,        // stamp matched
+		HitByHash,  // stamp differed but the source content did not
+		Missing,
+		Invalid,    // truncated, wrong magic, version or vertex layout, or an index past the vertices
+		Stale
+	};
+
+	static const char* ResultName(Result result);
+
+	// Maps 'cachePath' and validates it against the file it was built from.  If the
+	// source no longer exists the cache is trusted as is.
+	Result OpenForFile(const std::string& cachePath, const std::string& sourcePath);
+
+	// Maps 'cachePath' and validates it against a description of a generated mesh,
+	// e.g. "grid 10 10 300 300".
+	Result OpenForKey(const std::string& cachePath, const std::string& key);
+
+	void Close();
+
+	static bool WriteForFile(const std::string& cachePath, const std::string& sourcePath,
+		const MeshData& mesh, std::vector<Submesh> submeshes);
+	static bool WriteForKey(const std::string& cachePath, const std::string& key,
+		const MeshData& mesh, std::vector<Submesh> submeshes);
+
+	// Valid while the cache stays open.
+	const Vertex* Vertices()const { return mVertices; }
+	const uint32* Indices()const { return mIndices; }
+	uint32 VertexCount()const { return mVertexCount; }
+	uint32 IndexCount()const { return mIndexCount; }
+	const Bounds& MeshBounds()const { return mBounds; }
+	const std::vector<Submesh>& Submeshes()const { return mSubmeshes; }
+
+	// Copies the mapped data out, for code that needs to own or modify it.
+	MeshData ToMeshData()const;
+
+private:
+	Result Open(const std::string& cachePath);
+
+	static bool Write(const std::string& cachePath, std::uint64_t sourceSize, std::uint64_t sourceWriteTime,
+		std::uint64_t sourceHash, const MeshData& mesh, std::vector<Submesh>& submeshes);
+
+private:
+	MappedFile mFile;
+
+	std::uint64_t mSourceSize = 0;
+	std::uint64_t mSourceWriteTime = 0;
+	std::uint64_t mSourceHash = 0;
+
+	const Vertex* mVertices = nullptr;
+	const uint32* mIndices = nullptr;
+	uint32 mVertexCount = 0;
+	uint32 mIndexCount = 0;
+	Bounds mBounds;
+	std::vector<Submesh> mSubmeshes;
+};
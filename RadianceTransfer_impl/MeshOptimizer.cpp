@@ -0,0 +1,347 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace MeshOptimizer
+{
+
+namespace
+{
+	const uint32 kInvalid = ~0u;
+
+	// Triangles adjacent to each vertex, in CSR form.
+	struct Adjacency
+	{
+		std::vector<uint32> Offsets;   // vertexCount + 1
+		std::vector<uint32> Triangles;
+	};
+
+	void BuildAdjacency(Adjacency& adj, const uint32* indices, size_t indexCount, size_t vertexCount)
+	{
+		adj.Offsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+			adj.Offsets[indices[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; ++v)
+			adj.Offsets[v + 1] += adj.Offsets[v];
+
+		adj.Triangles.resize(indexCount);
+		std::vector<uint32> fill(adj.Offsets.begin(), adj.Offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; ++i)
+			adj.Triangles[fill[indices[i]]++] = uint32(i / 3);
+	}
+
+	const float* Position(const float* positions, size_t stride, uint32 v)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + size_t(v) * stride);
+	}
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32* indices, size_t indexCount, size_t vertexCount, uint32 cacheSize)
+{
+	VertexCacheStats stats;
+	if (indexCount == 0)
+		return stats;
+
+	// A vertex is in the FIFO if it entered less than cacheSize misses ago.
+	std::vector<uint32> entered(vertexCount, kInvalid);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32 misses = 0;
+	uint32 unique = 0;
+
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		const uint32 v = indices[i];
+		if (entered[v] == kInvalid || misses - entered[v] >= cacheSize)
+		{
+			entered[v] = misses;
+			++misses;
+		}
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			++unique;
+		}
+	}
+
+	stats.Misses = misses;
+	stats.ACMR = float(misses) / float(indexCount / 3);
+	stats.ATVR = unique > 0 ? float(misses) / float(unique) : 0.0f;
+	return stats;
+}
+
+void OptimizeVertexCache(uint32* destination, const uint32* indices, size_t indexCount, size_t vertexCount,
+	uint32 cacheSize, std::vector<uint32>* clusters)
+{
+	if (clusters != nullptr)
+		clusters->clear();
+	if (indexCount == 0)
+		return;
+
+	const size_t triangleCount = indexCount / 3;
+
+	Adjacency adj;
+	BuildAdjacency(adj, indices, indexCount, vertexCount);
+
+	std::vector<uint32> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		liveTriangles[v] = adj.Offsets[v + 1] - adj.Offsets[v];
+
+	std::vector<uint32> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32> deadEnd;
+	std::vector<uint32> candidates;
+	deadEnd.reserve(indexCount);
+
+	uint32 timestamp = cacheSize + 1;
+	uint32 cursor = 0;
+	size_t written = 0;
+
+	// Start with the first referenced vertex.
+	uint32 fan = kInvalid;
+	while (cursor < vertexCount && liveTriangles[cursor] == 0)
+		++cursor;
+	if (cursor < vertexCount)
+		fan = cursor;
+
+	if (clusters != nullptr)
+		clusters->push_back(0);
+
+	while (fan != kInvalid)
+	{
+		candidates.clear();
+
+		// Emit every remaining triangle around the fanning vertex.
+		for (uint32 a = adj.Offsets[fan]; a < adj.Offsets[fan + 1]; ++a)
+		{
+			const uint32 t = adj.Triangles[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32 v = indices[t * 3 + k];
+				destination[written++] = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+
+				if (timestamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timestamp++;
+			}
+		}
+
+		// Prefer the candidate that will still be in the cache after its remaining fan is emitted.
+		uint32 next = kInvalid;
+		int best = -1;
+		for (uint32 v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			int priority = 0;
+			if (timestamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = int(timestamp - cacheTime[v]);
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next == kInvalid)
+		{
+			// Dead end: try recently used vertices first, then scan forward.
+			while (!deadEnd.empty() && next == kInvalid)
+			{
+				const uint32 d = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[d] > 0)
+					next = d;
+			}
+			while (next == kInvalid && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+					next = cursor;
+				else
+					++cursor;
+			}
+
+			if (next != kInvalid && clusters != nullptr && written < indexCount)
+				clusters->push_back(uint32(written));
+		}
+
+		fan = next;
+	}
+}
+
+void OptimizeOverdraw(uint32* destination, const uint32* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount, const std::vector<uint32>& clusters)
+{
+	(void)vertexCount;
+
+	if (indexCount == 0 || clusters.size() < 2)
+	{
+		if (destination != indices)
+			std::memmove(destination, indices, indexCount * sizeof(uint32));
+		return;
+	}
+
+	struct Cluster
+	{
+		uint32 Start;
+		uint32 Count;
+		float Centroid[3];
+		float Normal[3];
+		float Area;
+		float SortKey;
+	};
+
+	std::vector<Cluster> sorted(clusters.size());
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		Cluster& cluster = sorted[c];
+		cluster.Start = clusters[c];
+		cluster.Count = (c + 1 < clusters.size() ? clusters[c + 1] : uint32(indexCount)) - cluster.Start;
+		cluster.Area = 0.0f;
+		for (int k = 0; k < 3; ++k)
+			cluster.Centroid[k] = cluster.Normal[k] = 0.0f;
+
+		// Area weighted centroid and normal of the cluster.
+		for (uint32 i = cluster.Start; i < cluster.Start + cluster.Count; i += 3)
+		{
+			const float* p0 = Position(positions, positionStride, indices[i + 0]);
+			const float* p1 = Position(positions, positionStride, indices[i + 1]);
+			const float* p2 = Position(positions, positionStride, indices[i + 2]);
+
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float area = 0.5f * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int k = 0; k < 3; ++k)
+			{
+				cluster.Centroid[k] += area * (p0[k] + p1[k] + p2[k]) / 3.0f;
+				cluster.Normal[k] += n[k];
+			}
+			cluster.Area += area;
+		}
+
+		for (int k = 0; k < 3; ++k)
+			meshCentroid[k] += cluster.Centroid[k];
+		meshArea += cluster.Area;
+
+		if (cluster.Area > 0.0f)
+		{
+			for (int k = 0; k < 3; ++k)
+				cluster.Centroid[k] /= cluster.Area;
+		}
+	}
+
+	if (meshArea > 0.0f)
+	{
+		for (int k = 0; k < 3; ++k)
+			meshCentroid[k] /= meshArea;
+	}
+
+	// Clusters that face away from the center are likely to occlude the rest.
+	for (Cluster& cluster : sorted)
+	{
+		float key = 0.0f;
+		for (int k = 0; k < 3; ++k)
+			key += (cluster.Centroid[k] - meshCentroid[k]) * cluster.Normal[k];
+		const float length = std::sqrt(cluster.Normal[0] * cluster.Normal[0] +
+			cluster.Normal[1] * cluster.Normal[1] + cluster.Normal[2] * cluster.Normal[2]);
+		cluster.SortKey = length > 0.0f ? key / length : 0.0f;
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const Cluster& a, const Cluster& b) { return a.SortKey > b.SortKey; });
+
+	// Gather into a scratch buffer so 'destination' may alias 'indices'.
+	std::vector<uint32> result;
+	result.reserve(indexCount);
+	for (const Cluster& cluster : sorted)
+		result.insert(result.end(), indices + cluster.Start, indices + cluster.Start + cluster.Count);
+
+	std::memcpy(destination, result.data(), indexCount * sizeof(uint32));
+}
+
+std::vector<uint32> OptimizeVertexFetch(const uint32* indices, size_t indexCount, size_t vertexCount)
+{
+	std::vector<uint32> remap(vertexCount, kInvalid);
+	uint32 next = 0;
+
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		if (remap[indices[i]] == kInvalid)
+			remap[indices[i]] = next++;
+	}
+
+	// Keep unreferenced vertices so per-vertex buffer sizes do not change.
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		if (remap[v] == kInvalid)
+			remap[v] = next++;
+	}
+
+	return remap;
+}
+
+void RemapIndexBuffer(uint32* indices, size_t indexCount, const std::vector<uint32>& remap)
+{
+	for (size_t i = 0; i < indexCount; ++i)
+		indices[i] = remap[indices[i]];
+}
+
+std::vector<uint32> OptimizeMesh(GeometryGenerator::MeshData& mesh, const std::vector<IndexRange>& ranges,
+	VertexCacheStats* before, VertexCacheStats* after)
+{
+	const size_t vertexCount = mesh.Vertices.size();
+	const size_t indexCount = mesh.Indices32.size();
+
+	if (before != nullptr)
+		*before = AnalyzeVertexCache(mesh.Indices32.data(), indexCount, vertexCount);
+	if (vertexCount == 0)
+	{
+		if (after != nullptr)
+			*after = VertexCacheStats();
+		return std::vector<uint32>();
+	}
+
+	std::vector<IndexRange> parts = ranges;
+	if (parts.empty())
+	{
+		IndexRange all;
+		all.IndexCount = uint32(indexCount);
+		parts.push_back(all);
+	}
+
+	std::vector<uint32> scratch;
+	std::vector<uint32> clusters;
+	for (const IndexRange& part : parts)
+	{
+		uint32* partIndices = mesh.Indices32.data() + part.StartIndex;
+
+		scratch.resize(part.IndexCount);
+		OptimizeVertexCache(scratch.data(), partIndices, part.IndexCount, vertexCount, DefaultCacheSize, &clusters);
+		OptimizeOverdraw(partIndices, scratch.data(), part.IndexCount,
+			&mesh.Vertices[0].Position.x, sizeof(GeometryGenerator::Vertex), vertexCount, clusters);
+	}
+
+	std::vector<uint32> remap = OptimizeVertexFetch(mesh.Indices32.data(), indexCount, vertexCount);
+	RemapIndexBuffer(mesh.Indices32.data(), indexCount, remap);
+	RemapVertexBuffer(mesh.Vertices, remap);
+
+	if (after != nullptr)
+		*after = AnalyzeVertexCache(mesh.Indices32.data(), indexCount, vertexCount);
+
+	return remap;
+}
+
+} // namespace MeshOptimizer
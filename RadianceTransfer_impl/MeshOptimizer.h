@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../Common/GeometryGenerator.h"
+
+// Index and vertex reordering for the post-transform vertex cache, overdraw and
+// vertex fetch.  The passes are meant to run in this order:
+//   1. OptimizeVertexCache  - Tipsify (Sander et al. 2007), also reports where it had to jump
+//   2. OptimizeOverdraw     - sorts those clusters so outward facing ones draw first
+//   3. OptimizeVertexFetch  - renumbers vertices in first-use order
+//
+// The fetch remap never drops vertices: unreferenced ones are kept at the end, so the
+// vertex count of a mesh, and every per-vertex buffer offset derived from it, is unchanged.
+namespace MeshOptimizer
+{
+	using uint32 = std::uint32_t;
+
+	const uint32 DefaultCacheSize = 16;
+
+	struct VertexCacheStats
+	{
+		float ACMR = 0.0f; // cache misses per triangle, 0.5 is ideal for a regular grid, 3 is worst
+		float ATVR = 0.0f; // cache misses per referenced vertex, 1 is ideal
+		uint32 Misses = 0;
+	};
+
+	// Simulates a FIFO post-transform cache of 'cacheSize' entries.
+	VertexCacheStats AnalyzeVertexCache(const uint32* indices, size_t indexCount, size_t vertexCount,
+		uint32 cacheSize = DefaultCacheSize);
+
+	// Reorders triangles for vertex cache locality.  'destination' must not alias 'indices'.
+	// If 'clusters' is not null it receives the start (in indices) of every run that began
+	// after a dead end; the first entry is always 0.
+	void OptimizeVertexCache(uint32* destination, const uint32* indices, size_t indexCount, size_t vertexCount,
+		uint32 cacheSize = DefaultCacheSize, std::vector<uint32>* clusters = nullptr);
+
+	// Reorders the clusters found by OptimizeVertexCache, front to back from the outside
+	// of the mesh in, which cuts overdraw without breaking the cache order inside a cluster.
+	// 'positions' points at the first float3 position; 'positionStride' is in bytes.
+	void OptimizeOverdraw(uint32* destination, const uint32* indices, size_t indexCount,
+		const float* positions, size_t positionStride, size_t vertexCount, const std::vector<uint32>& clusters);
+
+	// Returns remap[oldIndex] = newIndex, numbering vertices in the order the index buffer
+	// first touches them.
+	std::vector<uint32> OptimizeVertexFetch(const uint32* indices, size_t indexCount, size_t vertexCount);
+
+	void RemapIndexBuffer(uint32* indices, size_t indexCount, const std::vector<uint32>& remap);
+
+	// Applies a remap from OptimizeVertexFetch to any per-vertex array.
+	template<typename T>
+	void RemapVertexBuffer(std::vector<T>& vertices, const std::vector<uint32>& remap)
+	{
+		std::vector<T> remapped(vertices.size());
+		for (size_t i = 0; i < vertices.size(); ++i)
+			remapped[remap[i]] = vertices[i];
+		vertices.swap(remapped);
+	}
+
+	struct IndexRange
+	{
+		uint32 StartIndex = 0;
+		uint32 IndexCount = 0;
+	};
+
+	// Runs all three passes on a mesh.  Triangles never move between 'ranges' (for example
+	// the parts of an imported model), only within them; an empty list means the whole mesh.
+	// Returns the fetch remap that was applied to the vertices.
+	std::vector<uint32> OptimizeMesh(GeometryGenerator::MeshData& mesh, const std::vector<IndexRange>& ranges,
+		VertexCacheStats* before = nullptr, VertexCacheStats* after = nullptr);
+}
@@ -0,0 +1,344 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace MeshSimplifier
+{
+
+namespace
+{
+	// Symmetric 4x4 quadric: Q(p) = p'Ap + 2b'p + c, accumulated with area weights.
+	struct Quadric
+	{
+		double A00 = 0.0, A01 = 0.0, A02 = 0.0, A11 = 0.0, A12 = 0.0, A22 = 0.0;
+		double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+		double C = 0.0;
+		double Weight = 0.0;
+	};
+
+	void AddPlane(Quadric& q, const double n[3], double d, double w)
+	{
+		q.A00 += w * n[0] * n[0]; q.A01 += w * n[0] * n[1]; q.A02 += w * n[0] * n[2];
+		q.A11 += w * n[1] * n[1]; q.A12 += w * n[1] * n[2];
+		q.A22 += w * n[2] * n[2];
+		q.B0 += w * d * n[0]; q.B1 += w * d * n[1]; q.B2 += w * d * n[2];
+		q.C += w * d * d;
+		q.Weight += w;
+	}
+
+	void Add(Quadric& q, const Quadric& r)
+	{
+		q.A00 += r.A00; q.A01 += r.A01; q.A02 += r.A02;
+		q.A11 += r.A11; q.A12 += r.A12;
+		q.A22 += r.A22;
+		q.B0 += r.B0; q.B1 += r.B1; q.B2 += r.B2;
+		q.C += r.C;
+		q.Weight += r.Weight;
+	}
+
+	double Evaluate(const Quadric& q, const XMFLOAT3& p)
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		return q.A00 * x * x + 2.0 * q.A01 * x * y + 2.0 * q.A02 * x * z +
+			q.A11 * y * y + 2.0 * q.A12 * y * z + q.A22 * z * z +
+			2.0 * (q.B0 * x + q.B1 * y + q.B2 * z) + q.C;
+	}
+
+	void Cross(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, double n[3])
+	{
+		const double e1[3] = { double(p1.x) - p0.x, double(p1.y) - p0.y, double(p1.z) - p0.z };
+		const double e2[3] = { double(p2.x) - p0.x, double(p2.y) - p0.y, double(p2.z) - p0.z };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	struct PositionHash
+	{
+		size_t operator()(const XMFLOAT3& p) const
+		{
+			std::uint32_t bits[3];
+			std::memcpy(bits, &p, sizeof(bits));
+			return size_t(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const XMFLOAT3& a, const XMFLOAT3& b) const
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+
+	// canonical[v] is the first vertex with the same position as v.
+	std::vector<uint32> FindCanonicalVertices(const GeometryGenerator::Vertex* vertices, size_t vertexCount)
+	{
+		std::vector<uint32> canonical(vertexCount);
+		std::unordered_map<XMFLOAT3, uint32, PositionHash, PositionEqual> first;
+		first.reserve(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			canonical[v] = first.insert(std::make_pair(vertices[v].Position, uint32(v))).first->second;
+		return canonical;
+	}
+
+	struct Collapse
+	{
+		uint32 From;
+		uint32 To;
+		float Cost;
+	};
+}
+
+std::vector<uint32> Simplify(const GeometryGenerator::Vertex* vertices, size_t vertexCount,
+	const uint32* indices, size_t indexCount, size_t targetIndexCount, float targetError,
+	const Options& options, float* resultError)
+{
+	if (resultError != nullptr)
+		*resultError = 0.0f;
+
+	// Whole triangles of three different vertices only; the rest covers nothing.
+	std::vector<uint32> result;
+	result.reserve(indexCount);
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const uint32* t = indices + i;
+		if (t[0] != t[1] && t[1] != t[2] && t[0] != t[2])
+			result.insert(result.end(), t, t + 3);
+	}
+	if (result.size() <= targetIndexCount || vertexCount == 0)
+		return result;
+
+	// Errors are relative to the mesh radius.
+	XMFLOAT3 lo = vertices[0].Position;
+	XMFLOAT3 hi = vertices[0].Position;
+	for (size_t v = 1; v < vertexCount; ++v)
+	{
+		const XMFLOAT3& p = vertices[v].Position;
+		lo = XMFLOAT3((std::min)(lo.x, p.x), (std::min)(lo.y, p.y), (std::min)(lo.z, p.z));
+		hi = XMFLOAT3((std::max)(hi.x, p.x), (std::max)(hi.y, p.y), (std::max)(hi.z, p.z));
+	}
+	double radius = 0.5 * std::sqrt(double(hi.x - lo.x) * (hi.x - lo.x) + double(hi.y - lo.y) * (hi.y - lo.y) +
+		double(hi.z - lo.z) * (hi.z - lo.z));
+	if (radius <= 0.0)
+		radius = 1.0;
+
+	std::vector<bool> locked(vertexCount, false);
+	const std::vector<uint32> canonical = FindCanonicalVertices(vertices, vertexCount);
+	if (options.WeldPositions)
+	{
+		for (uint32& index : result)
+			index = canonical[index];
+	}
+	else
+	{
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			if (canonical[v] != v)
+				locked[v] = locked[canonical[v]] = true;
+		}
+	}
+
+	// Lock open borders: edges used by a single triangle, in either direction.
+	{
+		std::vector<std::uint64_t> edges;
+		edges.reserve(result.size());
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const uint32 a = result[i + k];
+				const uint32 b = result[i + (k + 1) % 3];
+				edges.push_back((std::uint64_t((std::min)(a, b)) << 32) | (std::max)(a, b));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j] == edges[i])
+				++j;
+			if (j - i == 1)
+				locked[uint32(edges[i] >> 32)] = locked[uint32(edges[i] & 0xffffffffu)] = true;
+			i = j;
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i + 2 < result.size(); i += 3)
+	{
+		const uint32* t = &result[i];
+		const XMFLOAT3& p0 = vertices[t[0]].Position;
+
+		double n[3];
+		Cross(p0, vertices[t[1]].Position, vertices[t[2]].Position, n);
+		const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0)
+			continue;
+
+		for (int k = 0; k < 3; ++k)
+			n[k] /= length;
+		const double d = -(n[0] * p0.x + n[1] * p0.y + n[2] * p0.z);
+		for (int k = 0; k < 3; ++k)
+			AddPlane(quadrics[t[k]], n, d, 0.5 * length);
+	}
+
+	auto cost = [&](uint32 from, uint32 to)
+	{
+		Quadric q = quadrics[from];
+		Add(q, quadrics[to]);
+		const double error = q.Weight > 0.0 ? (std::max)(Evaluate(q, vertices[to].Position) / q.Weight, 0.0) : 0.0;
+
+		float attributes = 0.0f;
+		if (!options.WeldPositions)
+		{
+			const GeometryGenerator::Vertex& a = vertices[from];
+			const GeometryGenerator::Vertex& b = vertices[to];
+			const float dn[3] = { a.Normal.x - b.Normal.x, a.Normal.y - b.Normal.y, a.Normal.z - b.Normal.z };
+			const float duv[2] = { a.TexC.x - b.TexC.x, a.TexC.y - b.TexC.y };
+			attributes = std::sqrt(dn[0] * dn[0] + dn[1] * dn[1] + dn[2] * dn[2] + duv[0] * duv[0] + duv[1] * duv[1]);
+		}
+
+		return float(std::sqrt(error) / radius) + options.AttributeWeight * attributes;
+	};
+
+	std::vector<uint32> offsets;
+	std::vector<uint32> adjacent;
+
+	// Moving 'from' onto 'to' must not turn any remaining triangle around 'from' over.
+	auto flips = [&](uint32 from, uint32 to)
+	{
+		for (uint32 a = offsets[from]; a < offsets[from + 1]; ++a)
+		{
+			const uint32* t = &result[size_t(adjacent[a]) * 3];
+			if (t[0] == to || t[1] == to || t[2] == to)
+				continue;
+
+			XMFLOAT3 p[3];
+			for (int k = 0; k < 3; ++k)
+				p[k] = vertices[t[k]].Position;
+
+			double before[3];
+			Cross(p[0], p[1], p[2], before);
+			for (int k = 0; k < 3; ++k)
+			{
+				if (t[k] == from)
+					p[k] = vertices[to].Position;
+			}
+			double after[3];
+			Cross(p[0], p[1], p[2], after);
+
+			const double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+			const double lengths = std::sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+				std::sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+			if (dot <= 0.25 * lengths)
+				return true;
+		}
+		return false;
+	};
+
+	std::vector<uint32> remap(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		remap[v] = uint32(v);
+
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> collapses;
+	float maxError = 0.0f;
+
+	while (result.size() > targetIndexCount)
+	{
+		// Triangles around each vertex, in CSR form.
+		const size_t triangleCount = result.size() / 3;
+		offsets.assign(vertexCount + 1, 0);
+		for (uint32 index : result)
+			offsets[index + 1]++;
+		for (size_t v = 0; v < vertexCount; ++v)
+			offsets[v + 1] += offsets[v];
+		adjacent.resize(result.size());
+		{
+			std::vector<uint32> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i)
+				adjacent[fill[result[i]]++] = uint32(i / 3);
+		}
+
+		// The cheaper direction of every edge that has an unlocked end.
+		collapses.clear();
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const uint32 a = result[t * 3 + k];
+				const uint32 b = result[t * 3 + (k + 1) % 3];
+				if (a >= b || (locked[a] && locked[b]))
+					continue;
+
+				const float costA = locked[a] ? std::numeric_limits<float>::max() : cost(a, b);
+				const float costB = locked[b] ? std::numeric_limits<float>::max() : cost(b, a);
+				collapses.push_back(costA <= costB ? Collapse{ a, b, costA } : Collapse{ b, a, costB });
+			}
+		}
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& x, const Collapse& y) { return x.Cost < y.Cost; });
+
+		// Apply the cheapest independent collapses: once a triangle changes, none of its
+		// vertices take part in another collapse this pass, so the adjacency stays valid.
+		const size_t toRemove = (std::max)((result.size() - targetIndexCount) / 3, size_t(1));
+		size_t removed = 0;
+		bool collapsed = false;
+		std::fill(touched.begin(), touched.end(), false);
+
+		for (const Collapse& c : collapses)
+		{
+			if (c.Cost > targetError || removed >= toRemove)
+				break;
+			if (touched[c.From] || touched[c.To] || flips(c.From, c.To))
+				continue;
+
+			remap[c.From] = c.To;
+			Add(quadrics[c.To], quadrics[c.From]);
+			for (uint32 a = offsets[c.From]; a < offsets[c.From + 1]; ++a)
+			{
+				const uint32* t = &result[size_t(adjacent[a]) * 3];
+				if (t[0] == c.To || t[1] == c.To || t[2] == c.To)
+					++removed;
+				for (int k = 0; k < 3; ++k)
+					touched[t[k]] = true;
+			}
+
+			maxError = (std::max)(maxError, c.Cost);
+			collapsed = true;
+		}
+		if (!collapsed)
+			break;
+
+		// Rewrite the indices and drop the triangles that collapsed.
+		size_t write = 0;
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			const uint32 a = remap[result[i + 0]];
+			const uint32 b = remap[result[i + 1]];
+			const uint32 c = remap[result[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	if (resultError != nullptr)
+		*resultError = maxError;
+	return result;
+}
+
+} // namespace MeshSimplifier
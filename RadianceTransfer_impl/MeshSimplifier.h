@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../Common/GeometryGenerator.h"
+
+// Quadric error metric simplification (Garland and Heckbert 1997) by half-edge collapse.
+//
+// A collapse moves one vertex onto a neighbour, so no vertex is ever created or moved:
+// the simplified index buffer indexes the original vertex buffer, and every per-vertex
+// buffer (SH coefficients, visibility) stays valid for all LODs of a mesh.
+//
+// Errors are relative to the mesh radius (half the bounding box diagonal), so one
+// threshold works for the grid and the model alike.
+namespace MeshSimplifier
+{
+	using uint32 = std::uint32_t;
+
+	struct Options
+	{
+		// Weight of the normal and uv change of a collapse against its geometric error.
+		// Only breaks ties between geometrically similar collapses at the default.
+		float AttributeWeight = 0.01f;
+
+		// Treats vertices at the same position as one, so uv and normal seams collapse
+		// like any other edge.  Meant for occluder proxies, where only positions matter;
+		// otherwise seam vertices are locked so the LOD does not crack along them.
+		bool WeldPositions = false;
+	};
+
+	// Collapses edges in order of increasing error until at most 'targetIndexCount'
+	// indices remain or the next collapse would cost more than 'targetError'.
+	// Open borders are always kept.  'resultError' receives the largest error accepted.
+	// Triangles that repeat a vertex, and indices past the last whole triangle, are
+	// dropped first, even when nothing is left to collapse.
+	std::vector<uint32> Simplify(const GeometryGenerator::Vertex* vertices, size_t vertexCount,
+		const uint32* indices, size_t indexCount, size_t targetIndexCount, float targetError,
+		const Options& options = Options(), float* resultError = nullptr);
+}
@@ -0,0 +1,265 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace Meshlets
+{
+
+namespace
+{
+	const uint32 kInvalid = ~0u;
+
+	const float* Position(const float* positions, size_t stride, uint32 v)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + size_t(v) * stride);
+	}
+
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void ComputeBounds(Meshlet& meshlet, const uint32* indices, const float* positions, size_t stride)
+	{
+		const uint32* first = indices + meshlet.StartIndex;
+
+		// Sphere around the center of the box; not minimal, but cheap and stable.
+		float lo[3] = { 0.0f, 0.0f, 0.0f };
+		float hi[3] = { 0.0f, 0.0f, 0.0f };
+		for (uint32 i = 0; i < meshlet.IndexCount; ++i)
+		{
+			const float* p = Position(positions, stride, first[i]);
+			for (int k = 0; k < 3; ++k)
+			{
+				lo[k] = i == 0 ? p[k] : (std::min)(lo[k], p[k]);
+				hi[k] = i == 0 ? p[k] : (std::max)(hi[k], p[k]);
+			}
+		}
+
+		const float center[3] = { 0.5f * (lo[0] + hi[0]), 0.5f * (lo[1] + hi[1]), 0.5f * (lo[2] + hi[2]) };
+		float radiusSq = 0.0f;
+		for (uint32 i = 0; i < meshlet.IndexCount; ++i)
+		{
+			const float* p = Position(positions, stride, first[i]);
+			const float d[3] = { p[0] - center[0], p[1] - center[1], p[2] - center[2] };
+			radiusSq = (std::max)(radiusSq, Dot(d, d));
+		}
+
+		meshlet.Center = XMFLOAT3(center[0], center[1], center[2]);
+		meshlet.Radius = std::sqrt(radiusSq);
+
+		// Normal cone from the unit triangle normals.
+		std::vector<float> normals;
+		normals.reserve(meshlet.IndexCount);
+		float axis[3] = { 0.0f, 0.0f, 0.0f };
+		for (uint32 i = 0; i < meshlet.IndexCount; i += 3)
+		{
+			const float* p0 = Position(positions, stride, first[i + 0]);
+			const float* p1 = Position(positions, stride, first[i + 1]);
+			const float* p2 = Position(positions, stride, first[i + 2]);
+
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float length = std::sqrt(Dot(n, n));
+			if (length == 0.0f)
+				continue; // degenerate triangles are never rasterized
+
+			for (int k = 0; k < 3; ++k)
+			{
+				n[k] /= length;
+				axis[k] += n[k];
+				normals.push_back(n[k]);
+			}
+		}
+
+		meshlet.ConeAxis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		meshlet.ConeCutoff = 1.0f;
+
+		const float axisLength = std::sqrt(Dot(axis, axis));
+		if (normals.empty() || axisLength == 0.0f)
+			return;
+
+		for (int k = 0; k < 3; ++k)
+			axis[k] /= axisLength;
+
+		float minDot = 1.0f;
+		for (size_t i = 0; i < normals.size(); i += 3)
+			minDot = (std::min)(minDot, Dot(&normals[i], axis));
+
+		// A cone wider than a hemisphere always has some front-facing triangle.
+		if (minDot <= 0.0f)
+			return;
+
+		meshlet.ConeAxis = XMFLOAT3(axis[0], axis[1], axis[2]);
+		meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+std::vector<Meshlet> BuildMeshlets(const uint32* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount,
+	uint32 maxVertices, uint32 maxTriangles)
+{
+	std::vector<Meshlet> meshlets;
+	if (indexCount < 3)
+		return meshlets;
+
+	// owner[v] is the meshlet that last referenced v, so a vertex is counted once per meshlet.
+	std::vector<uint32> owner(vertexCount, kInvalid);
+	auto newVertices = [&](size_t i, uint32 id)
+	{
+		uint32 count = 0;
+		for (size_t k = 0; k < 3; ++k)
+		{
+			const uint32 v = indices[i + k];
+			const bool repeated = (k > 0 && v == indices[i]) || (k > 1 && v == indices[i + 1]);
+			if (!repeated && owner[v] != id)
+				++count;
+		}
+		return count;
+	};
+
+	Meshlet current;
+	uint32 id = 0;
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		uint32 added = newVertices(i, id);
+		if (current.IndexCount > 0 &&
+			(current.VertexCount + added > maxVertices || current.IndexCount / 3 + 1 > maxTriangles))
+		{
+			meshlets.push_back(current);
+			current = Meshlet();
+			current.StartIndex = uint32(i);
+			added = newVertices(i, ++id);
+		}
+
+		for (size_t k = 0; k < 3; ++k)
+			owner[indices[i + k]] = id;
+
+		current.VertexCount += added;
+		current.IndexCount += 3;
+	}
+	meshlets.push_back(current);
+
+	for (Meshlet& meshlet : meshlets)
+		ComputeBounds(meshlet, indices, positions, positionStride);
+
+	return meshlets;
+}
+
+Frustum ExtractFrustum(const XMFLOAT4X4& m)
+{
+	// clip = p * M, so each clip coordinate is p dotted with a column of M.
+	auto column = [&m](int c) { return XMFLOAT4(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]); };
+	const XMFLOAT4 x = column(0);
+	const XMFLOAT4 y = column(1);
+	const XMFLOAT4 z = column(2);
+	const XMFLOAT4 w = column(3);
+
+	Frustum frustum;
+	frustum.Planes[0] = XMFLOAT4(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w); // left
+	frustum.Planes[1] = XMFLOAT4(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w); // right
+	frustum.Planes[2] = XMFLOAT4(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w); // bottom
+	frustum.Planes[3] = XMFLOAT4(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w); // top
+	frustum.Planes[4] = z;                                                    // near, z >= 0
+	frustum.Planes[5] = XMFLOAT4(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w); // far
+
+	for (XMFLOAT4& plane : frustum.Planes)
+	{
+		const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f)
+			plane = XMFLOAT4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+	}
+
+	return frustum;
+}
+
+CullStats& CullStats::operator+=(const CullStats& rhs)
+{
+	Meshlets += rhs.Meshlets;
+	FrustumCulled += rhs.FrustumCulled;
+	BackfaceCulled += rhs.BackfaceCulled;
+	Draws += rhs.Draws;
+	Triangles += rhs.Triangles;
+	CulledTriangles += rhs.CulledTriangles;
+	return *this;
+}
+
+CullStats CullMeshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum,
+	const XMFLOAT3& eye, std::vector<DrawIndexedArgs>* draws)
+{
+	CullStats stats;
+	stats.Meshlets = uint32(meshlets.size());
+
+	// End of the last visible meshlet, while the one before this was visible.
+	uint32 drawEnd = kInvalid;
+	for (const Meshlet& meshlet : meshlets)
+	{
+		const uint32 triangles = meshlet.IndexCount / 3;
+		stats.Triangles += triangles;
+
+		bool visible = true;
+		for (const XMFLOAT4& plane : frustum.Planes)
+		{
+			const float distance = plane.x * meshlet.Center.x + plane.y * meshlet.Center.y + plane.z * meshlet.Center.z + plane.w;
+			if (distance < -meshlet.Radius)
+			{
+				visible = false;
+				++stats.FrustumCulled;
+				break;
+			}
+		}
+
+		// Every point p of the sphere must see the cone from behind:
+		// dot(p - eye, axis) >= cutoff * |p - eye|.  Bounding both sides over the sphere
+		// gives dot(c - eye, axis) >= cutoff * |c - eye| + radius * (1 + cutoff).
+		if (visible && meshlet.ConeCutoff < 1.0f)
+		{
+			const float v[3] = { meshlet.Center.x - eye.x, meshlet.Center.y - eye.y, meshlet.Center.z - eye.z };
+			const float distance = std::sqrt(Dot(v, v));
+			const float along = v[0] * meshlet.ConeAxis.x + v[1] * meshlet.ConeAxis.y + v[2] * meshlet.ConeAxis.z;
+			if (along >= meshlet.ConeCutoff * distance + meshlet.Radius * (1.0f + meshlet.ConeCutoff))
+			{
+				visible = false;
+				++stats.BackfaceCulled;
+			}
+		}
+
+		if (!visible)
+		{
+			stats.CulledTriangles += triangles;
+			drawEnd = kInvalid;
+			continue;
+		}
+
+		// Merged into the previous draw when that ends where this starts.  Draws are
+		// counted whether or not 'draws' is given.
+		if (drawEnd == meshlet.StartIndex)
+		{
+			if (draws != nullptr)
+				draws->back().IndexCountPerInstance += meshlet.IndexCount;
+		}
+		else
+		{
+			if (draws != nullptr)
+			{
+				DrawIndexedArgs args;
+				args.IndexCountPerInstance = meshlet.IndexCount;
+				args.InstanceCount = 1;
+				args.StartIndexLocation = meshlet.StartIndex;
+				args.BaseVertexLocation = 0;
+				args.StartInstanceLocation = 0;
+				draws->push_back(args);
+			}
+			++stats.Draws;
+		}
+		drawEnd = meshlet.StartIndex + meshlet.IndexCount;
+	}
+
+	return stats;
+}
+
+} // namespace Meshlets
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../Common/GeometryGenerator.h"
+
+// Splits an index buffer into meshlets of at most MaxVertices unique vertices and
+// MaxTriangles triangles, each with a bounding sphere and a normal cone, and culls
+// them on the CPU against a frustum and the eye position.
+//
+// Meshlets are cut greedily along the index buffer, so every meshlet is a contiguous
+// index range.  Run MeshOptimizer first: its cache order is what keeps meshlets compact,
+// and the visible ones can then be drawn straight from the existing index buffer.
+namespace Meshlets
+{
+	using uint32 = std::uint32_t;
+
+	const uint32 MaxVertices = 64;
+	const uint32 MaxTriangles = 124;
+
+	struct Meshlet
+	{
+		uint32 StartIndex = 0;
+		uint32 IndexCount = 0;
+		uint32 VertexCount = 0;
+
+		// Bounding sphere, object space.
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		float Radius = 0.0f;
+
+		// Every triangle normal is within the cone of half angle a around ConeAxis;
+		// ConeCutoff is sin(a), or 1 when the normals spread too far to ever cull.
+		DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 1.0f };
+		float ConeCutoff = 1.0f;
+	};
+
+	// 'positions' points at the first float3 position; 'positionStride' is in bytes.
+	std::vector<Meshlet> BuildMeshlets(const uint32* indices, size_t indexCount,
+		const float* positions, size_t positionStride, size_t vertexCount,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles);
+
+	// Planes as (normal, d), normalized, with dot(normal, p) + d >= 0 inside.
+	struct Frustum
+	{
+		DirectX::XMFLOAT4 Planes[6];
+	};
+
+	// Extracts the planes from a row-vector object-to-clip matrix (world * view * proj)
+	// with D3D clip depth in [0, w], so the result is in that object's space.
+	Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& objectToClip);
+
+	// Same layout as D3D12_DRAW_INDEXED_ARGUMENTS.
+	struct DrawIndexedArgs
+	{
+		uint32 IndexCountPerInstance;
+		uint32 InstanceCount;
+		uint32 StartIndexLocation;
+		std::int32_t BaseVertexLocation;
+		uint32 StartInstanceLocation;
+	};
+
+	static_assert(sizeof(DrawIndexedArgs) == 20, "DrawIndexedArgs must match D3D12_DRAW_INDEXED_ARGUMENTS.");
+
+	struct CullStats
+	{
+		uint32 Meshlets = 0;
+		uint32 FrustumCulled = 0;
+		uint32 BackfaceCulled = 0;
+		uint32 Draws = 0;
+		std::uint64_t Triangles = 0;
+		std::uint64_t CulledTriangles = 0;
+
+		CullStats& operator+=(const CullStats& rhs);
+	};
+
+	// Culls meshlets against a frustum and, when the whole meshlet faces away from 'eye',
+	// against its normal cone.  Both are in the meshlets' object space; back-facing is
+	// preserved by any transform with a positive determinant.  Visible meshlets that are
+	// adjacent in the index buffer are merged into one draw appended to 'draws'.
+	CullStats CullMeshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum,
+		const DirectX::XMFLOAT3& eye, std::vector<DrawIndexedArgs>* draws);
+}
@@ -0,0 +1,52 @@
+#include "MockDescriptorHeap.h"
+
+#include <stdexcept>
+
+MockDescriptorHeap::MockDescriptorHeap(uint32 capacity, uint32 transientCapacity)
+	: mAllocator(capacity, transientCapacity), mStaging(capacity, 0), mShaderVisible(capacity + transientCapacity, 0)
+{
+}
+
+void MockDescriptorHeap::Write(const Range& range, uint32 index, uint64 descriptor)
+{
+	if (index >= range.Count)
+		throw std::logic_error("MockDescriptorHeap: writing past the end of a range");
+
+	Range slot;
+	slot.First = range.First + index;
+	slot.Count = 1;
+	mAllocator.MarkDirty(slot);
+	mStaging[slot.First] = descriptor;
+}
+
+void MockDescriptorHeap::CopyDirty()
+{
+	mRuns.clear();
+	mAllocator.TakeDirtyRuns(&mRuns);
+	if (mRuns.empty())
+		return;
+
+	for (const Range& run : mRuns)
+	{
+		for (uint32 slot = run.First; slot < run.First + run.Count; ++slot)
+			mShaderVisible[slot] = mStaging[slot];
+	}
+	++mCopyCalls;
+}
+
+MockDescriptorHeap::Range MockDescriptorHeap::BuildTable(std::initializer_list<Range> ranges)
+{
+	uint32 count = 0;
+	for (const Range& range : ranges)
+		count += range.Count;
+
+	const Range table = mAllocator.AllocateTransient(count);
+	uint32 slot = table.First;
+	for (const Range& range : ranges)
+	{
+		for (uint32 i = 0; i < range.Count; ++i)
+			mShaderVisible[slot++] = mStaging[range.First + i];
+	}
+	++mCopyCalls;
+	return table;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <initializer_list>
+#include <vector>
+
+#include "DescriptorAllocator.h"
+
+// CPU stand-in for D3D12DescriptorHeap, for running DescriptorAllocator against a fake
+// fence without a device.  A descriptor is a 64-bit value and the two heaps are arrays of
+// them; CopyDirty() and BuildTable() make the copies D3D12DescriptorHeap makes, so what
+// the shaders would read can be compared with what was written.
+class MockDescriptorHeap
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+	using Range = DescriptorAllocator::Range;
+
+	MockDescriptorHeap(uint32 capacity, uint32 transientCapacity);
+
+	Range Allocate(uint32 count) { return mAllocator.Allocate(count); }
+	void Free(const Range& range) { mAllocator.Free(range); }
+
+	// Writes descriptor 'index' of 'range' into the staging heap, as a view created
+	// through WriteHandle would be.
+	void Write(const Range& range, uint32 index, uint64 descriptor);
+
+	void CopyDirty();
+
+	void BeginFrame(uint64 completedFence) { mAllocator.BeginFrame(completedFence); }
+	void EndFrame(uint64 fence) { mAllocator.EndFrame(fence); }
+	// The table, in shader-visible slots.
+	Range BuildTable(std::initializer_list<Range> ranges);
+
+	uint64 Staging(uint32 slot)const { return mStaging[slot]; }
+	uint64 ShaderVisible(uint32 slot)const { return mShaderVisible[slot]; }
+	// CopyDescriptors calls made so far.
+	uint32 CopyCalls()const { return mCopyCalls; }
+
+	const DescriptorAllocator& Allocator()const { return mAllocator; }
+
+private:
+	DescriptorAllocator mAllocator;
+	std::vector<uint64> mStaging;
+	std::vector<uint64> mShaderVisible;
+	std::vector<Range> mRuns;
+	uint32 mCopyCalls = 0;
+};
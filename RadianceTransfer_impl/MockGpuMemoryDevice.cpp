@@ -0,0 +1,23 @@
+#include "MockGpuMemoryDevice.h"
+
+#include <stdexcept>
+
+MockGpuMemoryDevice::uint32 MockGpuMemoryDevice::CreateHeap(GpuMemoryClass memoryClass, uint64 size)
+{
+	MockHeap heap;
+	heap.Class = memoryClass;
+	heap.Size = size;
+	heap.Live = true;
+	mHeaps.push_back(heap);
+	++mLiveHeaps;
+	return (uint32)mHeaps.size() - 1;
+}
+
+void MockGpuMemoryDevice::DestroyHeap(uint32 id)
+{
+	if (!IsLive(id))
+		throw std::logic_error("MockGpuMemoryDevice: destroying a heap that is not alive");
+
+	mHeaps[id].Live = false;
+	--mLiveHeaps;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "GpuMemoryAllocator.h"
+
+// CPU stand-in for the device heaps of GpuMemoryAllocator, for running the allocator
+// without a device.  Heaps are only sizes and classes, kept so allocations can be
+// checked against the heap they were placed in.  Destroying a heap twice or one that does
+// not exist throws std::logic_error.
+class MockGpuMemoryDevice : public GpuMemoryDevice
+{
+public:
+	virtual uint32 CreateHeap(GpuMemoryClass memoryClass, uint64 size)override;
+	virtual void DestroyHeap(uint32 id)override;
+
+	uint32 LiveHeaps()const { return mLiveHeaps; }
+	uint32 CreatedHeaps()const { return (uint32)mHeaps.size(); }
+	// Whether 'id' is still alive.
+	bool IsLive(uint32 id)const { return id < mHeaps.size() && mHeaps[id].Live; }
+	uint64 HeapSize(uint32 id)const { return mHeaps[id].Size; }
+	GpuMemoryClass HeapClass(uint32 id)const { return mHeaps[id].Class; }
+
+private:
+	struct MockHeap
+	{
+		GpuMemoryClass Class = GpuMemoryClass::Buffer;
+		uint64 Size = 0;
+		bool Live = false;
+	};
+
+private:
+	std::vector<MockHeap> mHeaps;
+	uint32 mLiveHeaps = 0;
+};
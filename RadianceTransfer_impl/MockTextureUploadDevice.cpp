@@ -0,0 +1,141 @@
+#include "MockTextureUploadDevice.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "../Common/DDSReader.h"
+
+MockTextureUploadDevice::MockTextureUploadDevice(uint64 uploadBytes, uint32 latency)
+	: mUploadMemory((size_t)uploadBytes), mLatency(latency)
+{
+}
+
+MockTextureUploadDevice::uint32 MockTextureUploadDevice::CreateTexture(const TextureDesc& desc)
+{
+	Texture texture;
+	texture.Desc = desc;
+	texture.ResidentMip = desc.MipCount;
+	texture.Subresources.resize((size_t)desc.MipCount * desc.ArraySize);
+	for (uint32 slice = 0; slice < desc.ArraySize; ++slice)
+	{
+		for (uint32 mip = 0; mip < desc.MipCount; ++mip)
+		{
+			const uint32 height = (std::max)(desc.Height >> mip, 1u);
+			texture.Subresources[mip + slice * desc.MipCount].RowCount =
+				DDS::IsBlockCompressed((DXGI_FORMAT)desc.Format) ? (height + 3) / 4 : height;
+		}
+	}
+	mTextures.push_back(texture);
+	return (uint32)mTextures.size() - 1;
+}
+
+void MockTextureUploadDevice::RecordCopy(uint32 texture, uint32 subresource, uint32 firstRow, uint32 rowCount,
+	uint64 offset, uint32 rowPitch, uint32 rowBytes)
+{
+	if (texture >= mTextures.size() || subresource >= mTextures[texture].Subresources.size())
+		throw std::logic_error("RecordCopy: no such subresource");
+	if (offset % PlacementAlignment() != 0 || rowPitch % RowPitchAlignment() != 0 || rowBytes > rowPitch)
+		throw std::logic_error("RecordCopy: misaligned source");
+	if (firstRow + rowCount > mTextures[texture].Subresources[subresource].RowCount)
+		throw std::logic_error("RecordCopy: rows out of range");
+
+	const uint64 end = offset + (uint64)rowPitch * rowCount;
+	if (end > mUploadMemory.size())
+		throw std::logic_error("RecordCopy: source outside the upload memory");
+
+	// The streamer may only reuse ring memory whose copies have executed.
+	auto overlaps = [offset, end](const Copy& copy)
+	{
+		return offset < copy.Offset + (uint64)copy.RowPitch * copy.RowCount && copy.Offset < end;
+	};
+	for (const Submission& submission : mInFlight)
+	{
+		for (const Copy& copy : submission.Copies)
+		{
+			if (overlaps(copy))
+				throw std::logic_error("RecordCopy: upload memory of an in-flight copy reused");
+		}
+	}
+	for (const Copy& copy : mRecorded)
+	{
+		if (overlaps(copy))
+			throw std::logic_error("RecordCopy: upload memory recorded twice in one submission");
+	}
+
+	Copy copy;
+	copy.Texture = texture;
+	copy.Subresource = subresource;
+	copy.FirstRow = firstRow;
+	copy.RowCount = rowCount;
+	copy.Offset = offset;
+	copy.RowPitch = rowPitch;
+	copy.RowBytes = rowBytes;
+	mRecorded.push_back(copy);
+}
+
+MockTextureUploadDevice::uint64 MockTextureUploadDevice::Submit()
+{
+	Submission submission;
+	submission.Fence = ++mSubmittedFence;
+	submission.PollsLeft = mLatency;
+	submission.Copies.swap(mRecorded);
+	mInFlight.push_back(submission);
+	if (mLatency == 0)
+		Complete(submission.Fence);
+	return mSubmittedFence;
+}
+
+MockTextureUploadDevice::uint64 MockTextureUploadDevice::CompletedFence()
+{
+	// Submissions complete in order, so only the oldest one counts down.
+	if (!mInFlight.empty() && mInFlight.front().PollsLeft > 0 && --mInFlight.front().PollsLeft == 0)
+		Complete(mInFlight.front().Fence);
+	return mCompletedFence;
+}
+
+void MockTextureUploadDevice::WaitForFence(uint64 fence)
+{
+	if (fence > mSubmittedFence)
+		throw std::logic_error("WaitForFence: fence " + std::to_string(fence) + " was never submitted");
+	Complete(fence);
+}
+
+void MockTextureUploadDevice::Complete(uint64 fence)
+{
+	while (!mInFlight.empty() && mInFlight.front().Fence <= fence)
+	{
+		for (const Copy& copy : mInFlight.front().Copies)
+		{
+			Subresource& subresource = mTextures[copy.Texture].Subresources[copy.Subresource];
+			subresource.Data.resize((size_t)subresource.RowCount * copy.RowBytes);
+			for (uint32 row = 0; row < copy.RowCount; ++row)
+			{
+				std::memcpy(subresource.Data.data() + (size_t)(copy.FirstRow + row) * copy.RowBytes,
+					mUploadMemory.data() + copy.Offset + (uint64)row * copy.RowPitch, copy.RowBytes);
+			}
+			subresource.RowsCopied += copy.RowCount;
+		}
+		mCompletedFence = mInFlight.front().Fence;
+		mInFlight.erase(mInFlight.begin());
+	}
+}
+
+void MockTextureUploadDevice::SetResidentMip(uint32 texture, uint32 mostDetailedMip)
+{
+	Texture& t = mTextures[texture];
+	if (mostDetailedMip >= t.Desc.MipCount || mostDetailedMip >= t.ResidentMip)
+		throw std::logic_error("SetResidentMip: residency can only grow");
+
+	for (uint32 slice = 0; slice < t.Desc.ArraySize; ++slice)
+	{
+		for (uint32 mip = mostDetailedMip; mip < t.Desc.MipCount; ++mip)
+		{
+			const Subresource& subresource = t.Subresources[mip + slice * t.Desc.MipCount];
+			if (subresource.RowsCopied != subresource.RowCount)
+				throw std::logic_error("SetResidentMip: mip " + std::to_string(mip) + " is not fully copied");
+		}
+	}
+	t.ResidentMip = mostDetailedMip;
+}
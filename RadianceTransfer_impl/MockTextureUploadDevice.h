@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+
+#include "TextureStreamer.h"
+
+// CPU stand-in for the GPU side of TextureStreamer, for running the streamer without
+// a device.  Submitted copies are executed only when their fence completes, 'latency'
+// CompletedFence() polls after Submit(), reading the upload ring at that point like
+// the copy queue would, so a streamer that reuses ring memory too early ends up with
+// wrong texels.  Misuse the GPU would not report (overlapping in-flight ring ranges,
+// exposing mips that are not fully copied) throws std::logic_error.
+class MockTextureUploadDevice : public TextureUploadDevice
+{
+public:
+	explicit MockTextureUploadDevice(uint64 uploadBytes, uint32 latency = 0);
+
+	virtual uint32 CreateTexture(const TextureDesc& desc)override;
+
+	virtual std::uint8_t* UploadMemory()override { return mUploadMemory.data(); }
+	virtual uint64 UploadMemorySize()const override { return mUploadMemory.size(); }
+	virtual uint64 PlacementAlignment()const override { return 512; }
+	virtual uint32 RowPitchAlignment()const override { return 256; }
+
+	virtual void RecordCopy(uint32 texture, uint32 subresource, uint32 firstRow, uint32 rowCount,
+		uint64 offset, uint32 rowPitch, uint32 rowBytes)override;
+
+	virtual uint64 Submit()override;
+	virtual uint64 CompletedFence()override;
+	virtual void WaitForFence(uint64 fence)override;
+
+	virtual void SetResidentMip(uint32 texture, uint32 mostDetailedMip)override;
+
+	// Texels copied so far, rows packed without padding.
+	const std::vector<std::uint8_t>& SubresourceData(uint32 texture, uint32 subresource)const
+	{
+		return mTextures[texture].Subresources[subresource].Data;
+	}
+	uint32 ResidentMip(uint32 texture)const { return mTextures[texture].ResidentMip; }
+	uint64 SubmittedFence()const { return mSubmittedFence; }
+
+private:
+	struct Copy
+	{
+		uint32 Texture = 0;
+		uint32 Subresource = 0;
+		uint32 FirstRow = 0;
+		uint32 RowCount = 0;
+		uint64 Offset = 0;
+		uint32 RowPitch = 0;
+		uint32 RowBytes = 0;
+	};
+
+	struct Submission
+	{
+		uint64 Fence = 0;
+		uint32 PollsLeft = 0;
+		std::vector<Copy> Copies;
+	};
+
+	struct Subresource
+	{
+		uint32 RowCount = 0; // expected, from the texture size and format
+		uint32 RowsCopied = 0;
+		std::vector<std::uint8_t> Data;
+	};
+
+	struct Texture
+	{
+		TextureDesc Desc;
+		uint32 ResidentMip = 0;
+		std::vector<Subresource> Subresources;
+	};
+
+	void Complete(uint64 fence);
+
+private:
+	std::vector<std::uint8_t> mUploadMemory;
+	uint32 mLatency = 0;
+
+	std::vector<Texture> mTextures;
+	std::vector<Copy> mRecorded;
+	std::vector<Submission> mInFlight;
+	uint64 mSubmittedFence = 0;
+	uint64 mCompletedFence = 0;
+};
@@ -0,0 +1,31 @@
+#include "MockUploadMemoryDevice.h"
+
+#include <stdexcept>
+
+MockUploadMemoryDevice::uint32 MockUploadMemoryDevice::CreateBlock(uint64 size, Block* block)
+{
+	MockBlock mockBlock;
+	mockBlock.Memory.reset(new std::uint8_t[(size_t)size]);
+	mockBlock.GpuAddress = mNextGpuAddress;
+	mockBlock.Size = size;
+
+	// Keep a gap between blocks, like separate resources would.
+	mNextGpuAddress += (size + 0xFFFF) & ~uint64(0xFFFF);
+	mNextGpuAddress += 0x10000;
+
+	block->CpuAddress = mockBlock.Memory.get();
+	block->GpuAddress = mockBlock.GpuAddress;
+
+	mBlocks.push_back(std::move(mockBlock));
+	++mLiveBlocks;
+	return (uint32)mBlocks.size() - 1;
+}
+
+void MockUploadMemoryDevice::DestroyBlock(uint32 id)
+{
+	if (!IsLive(id))
+		throw std::logic_error("MockUploadMemoryDevice: destroying a block that is not alive");
+
+	mBlocks[id].Memory.reset();
+	--mLiveBlocks;
+}
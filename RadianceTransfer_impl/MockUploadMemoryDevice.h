@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "UploadAllocator.h"
+
+// CPU stand-in for the upload heap of UploadAllocator, for running the allocator against
+// a fake fence without a device.  Blocks are plain memory; their GPU addresses are made
+// up but never overlap, so two allocations alias exactly when their addresses do.
+// Destroying a block twice or one that does not exist throws std::logic_error.
+class MockUploadMemoryDevice : public UploadMemoryDevice
+{
+public:
+	virtual uint32 CreateBlock(uint64 size, Block* block)override;
+	virtual void DestroyBlock(uint32 id)override;
+
+	uint32 LiveBlocks()const { return mLiveBlocks; }
+	uint32 CreatedBlocks()const { return (uint32)mBlocks.size(); }
+	// Whether 'id' is still alive.
+	bool IsLive(uint32 id)const { return id < mBlocks.size() && mBlocks[id].Memory != nullptr; }
+
+private:
+	struct MockBlock
+	{
+		std::unique_ptr<std::uint8_t[]> Memory;
+		uint64 GpuAddress = 0;
+		uint64 Size = 0;
+	};
+
+private:
+	std::vector<MockBlock> mBlocks;
+	uint64 mNextGpuAddress = 0x10000;
+	uint32 mLiveBlocks = 0;
+};
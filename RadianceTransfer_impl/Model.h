@@ -2,10 +2,13 @@
 
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <algorithm>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
-#include "Mesh.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/JobSystem.h"
 
 using namespace std;
 
@@ -17,140 +20,153 @@ public:
     using MeshData = GeometryGenerator::MeshData;
     using Vertex = GeometryGenerator::Vertex;
 
-    // model data 
-    vector<Mesh> meshes;
+    // where one assimp mesh lives inside the merged vertex and index arrays.
+    // indices are already offset by BaseVertex, so the whole model draws with base vertex 0.
+    struct MeshRange
+    {
+        uint32 BaseVertex = 0;
+        uint32 VertexCount = 0;
+        uint32 StartIndex = 0;
+        uint32 IndexCount = 0;
+    };
+
+    // model data
+    vector<MeshRange> meshes;
     string directory;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const& path)
+    // import timings in milliseconds
+    double readMilliseconds = 0.0;  // assimp ReadFile, including post processing
+    double fillMilliseconds = 0.0;  // sizing and filling the merged MeshData
+
+    // constructor, expects a filepath to a 3D model.  the meshes are filled in on 'jobs'
+    // when given, otherwise one after another.
+    Model(string const& path, JobSystem* jobs = nullptr)
     {
-        loadModel(path);
+        loadModel(path, jobs);
     }
 
+    // moves the merged mesh out of the model; the model is empty afterwards.
     MeshData CreateModel()
     {
-        if (!meshes.empty())
-        {
-            MeshData data;
-            int offset = 0; // index offset
-
-            for (int i = 0; i < meshes.size(); ++i) // for every mesh...
-            {
-                data.Vertices.insert(data.Vertices.end(), meshes[i].vertices.cbegin(), meshes[i].vertices.cend());
-                for_each(meshes[i].indices.begin(), meshes[i].indices.end(),
-                    [&offset](uint32& index) {
-                        index += offset;
-                    });
-                data.Indices32.insert(data.Indices32.end(), meshes[i].indices.cbegin(), meshes[i].indices.cend());
-                offset += meshes[i].indices.size();
-            }
-
-            return data;
-        }
-        else
+        if (meshes.empty())
             throw std::logic_error("0 Mesh");
+
+        return std::move(data);
     }
 
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const& path)
+    MeshData data;
+
+    // loads a model with supported ASSIMP extensions from file and fills the merged MeshData.
+    void loadModel(string const& path, JobSystem* jobs)
     {
+        auto startTime = chrono::high_resolution_clock::now();
+
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_GenUVCoords | aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_FixInfacingNormals);
         // check for errors
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
-            throw std::logic_error(importer.GetErrorString());
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            throw std::logic_error(importer.GetErrorString());
         }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
-    }
+        auto readTime = chrono::high_resolution_clock::now();
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
-    {
-        // process each mesh located at the current node
-        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        // first pass: collect meshes in node order and size every range, so the
+        // merged arrays are allocated exactly once.
+        vector<const aiMesh*> sceneMeshes;
+        collectMeshes(scene->mRootNode, scene, sceneMeshes);
+
+        uint32 vertexCount = 0;
+        uint32 indexCount = 0;
+        meshes.resize(sceneMeshes.size());
+        for (size_t i = 0; i < sceneMeshes.size(); ++i)
         {
-            // the node object only contains indices to index the actual objects in the scene. 
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            const aiMesh* mesh = sceneMeshes[i];
+
+            MeshRange& range = meshes[i];
+            range.BaseVertex = vertexCount;
+            range.VertexCount = mesh->mNumVertices;
+            range.StartIndex = indexCount;
+            for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+                range.IndexCount += mesh->mFaces[f].mNumIndices;
+
+            vertexCount += range.VertexCount;
+            indexCount += range.IndexCount;
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++)
+
+        data.Vertices.resize(vertexCount);
+        data.Indices32.resize(indexCount);
+
+        // second pass: every mesh writes its own disjoint range, one job per mesh.
+        auto fillMeshes = [&](uint32 first, uint32 last)
         {
-            processNode(node->mChildren[i], scene);
-        }
+            for (uint32 i = first; i < last; ++i)
+                processMesh(sceneMeshes[i], meshes[i]);
+        };
+        if (jobs != nullptr)
+            jobs->ParallelFor(uint32(sceneMeshes.size()), 1, fillMeshes);
+        else
+            fillMeshes(0, uint32(sceneMeshes.size()));
 
+        auto fillTime = chrono::high_resolution_clock::now();
+        readMilliseconds = chrono::duration<double, milli>(readTime - startTime).count();
+        fillMilliseconds = chrono::duration<double, milli>(fillTime - readTime).count();
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    // collects the meshes of a node and, recursively, of its children.
+    void collectMeshes(const aiNode* node, const aiScene* scene, vector<const aiMesh*>& out)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector <uint32> indices;
+        // the node object only contains indices to index the actual objects in the scene.
+        // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+            out.push_back(scene->mMeshes[node->mMeshes[i]]);
+
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            collectMeshes(node->mChildren[i], scene, out);
+    }
+
+    // converts one assimp mesh into its pre-sized range of the merged arrays.
+    void processMesh(const aiMesh* mesh, const MeshRange& range)
+    {
+        Vertex* vertices = data.Vertices.data() + range.BaseVertex;
+        uint32* indices = data.Indices32.data() + range.StartIndex;
+
+        const bool hasNormals = mesh->HasNormals();
+        // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
+        // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+        const bool hasTexCoords = mesh->mTextureCoords[0] != nullptr;
+        const bool hasTangents = hasTexCoords && mesh->mTangents != nullptr;
 
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
-            DirectX::XMFLOAT3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
-            // texture coordinates
-            if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-            {
-                DirectX::XMFLOAT2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexC = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.TangentU = vector;
-                // bitangent
-                //vector.x = mesh->mBitangents[i].x;
-                //vector.y = mesh->mBitangents[i].y;
-                //vector.z = mesh->mBitangents[i].z;
-                //vertex.Bitangent = vector;
-            }
-            else
-                vertex.TexC = DirectX::XMFLOAT2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
+            Vertex& vertex = vertices[i];
+            vertex.Position = DirectX::XMFLOAT3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            vertex.Normal = hasNormals ?
+                DirectX::XMFLOAT3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) :
+                DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+            vertex.TexC = hasTexCoords ?
+                DirectX::XMFLOAT2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) :
+                DirectX::XMFLOAT2(0.0f, 0.0f);
+            vertex.TangentU = hasTangents ?
+                DirectX::XMFLOAT3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z) :
+                DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
         }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+
+        // now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the
+        // corresponding vertex indices, offset to where this mesh's vertices live in the merged array.
+        uint32 n = 0;
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
+            const aiFace& face = mesh->mFaces[i];
             for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+                indices[n++] = range.BaseVertex + face.mIndices[j];
         }
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices);
     }
 };
 
@@ -0,0 +1,71 @@
+#include "NullPassRecordingDevice.h"
+
+#include <cstring>
+#include <stdexcept>
+
+void NullPassRecordingDevice::BeginFrame(uint32 listCount)
+{
+	for (const List& list : mLists)
+	{
+		if (list.Open)
+			throw std::logic_error("BeginFrame: a list is still open");
+	}
+
+	if (mLists.size() < listCount)
+		mLists.resize(listCount);
+	for (List& list : mLists)
+		list.Recorded = false;
+	mFrameListCount = listCount;
+}
+
+void NullPassRecordingDevice::Begin(uint32 index)
+{
+	if (index >= mFrameListCount)
+		throw std::logic_error("Begin: list not prepared by BeginFrame");
+	List& list = mLists[index];
+	if (list.Open || list.Recorded)
+		throw std::logic_error("Begin: list already recorded this frame");
+
+	list.Open = true;
+	list.Commands.clear();
+}
+
+void NullPassRecordingDevice::End(uint32 index)
+{
+	if (index >= mFrameListCount || !mLists[index].Open)
+		throw std::logic_error("End: list is not open");
+
+	mLists[index].Open = false;
+	mLists[index].Recorded = true;
+}
+
+void NullPassRecordingDevice::Write(uint32 index, const void* command, std::size_t size)
+{
+	if (index >= mFrameListCount || !mLists[index].Open)
+		throw std::logic_error("Write: list is not open");
+
+	std::vector<std::uint8_t>& commands = mLists[index].Commands;
+	const std::size_t offset = commands.size();
+	commands.resize(offset + size);
+	std::memcpy(commands.data() + offset, command, size);
+}
+
+void NullPassRecordingDevice::Submit(uint32 listCount)
+{
+	if (listCount > mFrameListCount)
+		throw std::logic_error("Submit: list not prepared by BeginFrame");
+	for (uint32 i = 0; i < listCount; ++i)
+	{
+		if (!mLists[i].Recorded)
+			throw std::logic_error("Submit: list open or not recorded");
+	}
+
+	// Swapped rather than copied, so the next frame records into the older buffers.
+	mSubmitted.resize(listCount);
+	for (uint32 i = 0; i < listCount; ++i)
+	{
+		mSubmitted[i].swap(mLists[i].Commands);
+		mLists[i].Recorded = false;
+	}
+	++mFrames;
+}
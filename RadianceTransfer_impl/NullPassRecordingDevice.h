@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "PassRecorder.h"
+
+// CPU stand-in for the command lists of PassRecorder, for measuring recording cost and
+// its scaling over threads without a device.  Passes write their commands as bytes into
+// the list they record; Submit() keeps the order the lists went out in.  Misuse a
+// debug layer would report (recording into a closed list, submitting an open one,
+// opening a list twice) throws std::logic_error.
+class NullPassRecordingDevice : public PassRecordingDevice
+{
+public:
+	virtual void BeginFrame(uint32 listCount)override;
+	virtual void Begin(uint32 index)override;
+	virtual void End(uint32 index)override;
+	virtual void Submit(uint32 listCount)override;
+
+	// Appends a command to list 'index', which must be open.
+	void Write(uint32 index, const void* command, std::size_t size);
+
+	// The commands of every list of the last submission, in submission order.
+	const std::vector<std::vector<std::uint8_t>>& SubmittedLists()const { return mSubmitted; }
+	uint32 Frames()const { return mFrames; }
+
+private:
+	struct List
+	{
+		bool Open = false;
+		bool Recorded = false;
+		std::vector<std::uint8_t> Commands;
+	};
+
+private:
+	std::vector<List> mLists;
+	uint32 mFrameListCount = 0;
+
+	std::vector<std::vector<std::uint8_t>> mSubmitted;
+	uint32 mFrames = 0;
+};
@@ -0,0 +1,83 @@
+#include "PassRecorder.h"
+
+#include <chrono>
+
+PassRecorder::PassRecorder(PassRecordingDevice& device, JobSystem& jobs)
+	: mDevice(device), mJobs(jobs)
+{
+}
+
+void PassRecorder::AddPass(const char* name, RecordFunction record)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Record = std::move(record);
+	mPasses.push_back(std::move(pass));
+}
+
+void PassRecorder::Execute(bool parallel)
+{
+	const uint32 count = (uint32)mPasses.size();
+	mStats.Passes = count;
+	mStats.PassMilliseconds.assign(count, 0.0);
+	mStats.PassNames.resize(count);
+	for (uint32 i = 0; i < count; ++i)
+		mStats.PassNames[i] = mPasses[i].Name;
+
+	Profiler::Scope scope(mProfiler, "PassRecorder::Execute");
+	mDevice.BeginFrame(count);
+
+	auto recordStart = std::chrono::high_resolution_clock::now();
+	try
+	{
+		if (parallel)
+			mJobs.ParallelFor(count, 1, [this](uint32 first, uint32 last)
+			{
+				for (uint32 i = first; i < last; ++i)
+					RecordPass(i);
+			});
+		else
+		{
+			for (uint32 i = 0; i < count; ++i)
+				RecordPass(i);
+		}
+	}
+	catch (...)
+	{
+		mPasses.clear();
+		throw;
+	}
+	auto recordEnd = std::chrono::high_resolution_clock::now();
+	mStats.RecordMilliseconds = std::chrono::duration<double, std::milli>(recordEnd - recordStart).count();
+
+	// Lists go out in the order the passes were added, not the order they were done in.
+	{
+		Profiler::Scope submitScope(mProfiler, "Submit");
+		mDevice.Submit(count);
+	}
+	auto submitEnd = std::chrono::high_resolution_clock::now();
+	mStats.SubmitMilliseconds = std::chrono::duration<double, std::milli>(submitEnd - recordEnd).count();
+
+	mPasses.clear();
+}
+
+void PassRecorder::RecordPass(uint32 index)
+{
+	Profiler::Scope scope(mProfiler, mPasses[index].Name);
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mDevice.Begin(index);
+	try
+	{
+		mPasses[index].Record(index);
+	}
+	catch (...)
+	{
+		mDevice.End(index);
+		throw;
+	}
+	mDevice.End(index);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.PassMilliseconds[index] = std::chrono::duration<double, std::milli>(end - start).count();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "../Common/JobSystem.h"
+#include "../Common/Profiler.h"
+
+// What the recorder needs from the graphics API: a set of command lists that can be
+// recorded on different threads at once, and a queue that runs them in a given order.
+// D3D12PassRecordingDevice implements it with direct command lists,
+// NullPassRecordingDevice on the CPU.
+class PassRecordingDevice
+{
+public:
+	using uint32 = std::uint32_t;
+
+	virtual ~PassRecordingDevice() = default;
+
+	// Makes 'listCount' lists ready for recording.  Only called once the GPU has finished
+	// with what was submitted from them last.
+	virtual void BeginFrame(uint32 listCount) = 0;
+
+	// Opens and closes list 'index'.  Lists are recorded on whichever thread runs their
+	// pass, several at a time, but each by one thread only.
+	virtual void Begin(uint32 index) = 0;
+	virtual void End(uint32 index) = 0;
+
+	// Submits lists [0, listCount) to run in that order.
+	virtual void Submit(uint32 listCount) = 0;
+};
+
+// Records the passes of a frame into a command list each, in parallel on the job
+// system, and submits the lists in the order the passes were added, so the GPU sees the
+// same frame whatever thread recorded what.  A pass must set all the state it relies
+// on, since nothing carries over between command lists.
+class PassRecorder
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// Records into list 'list' of the device.
+	using RecordFunction = std::function<void(uint32 list)>;
+
+	struct Stats
+	{
+		uint32 Passes = 0;
+		double RecordMilliseconds = 0.0;   // wall clock, first Begin to last End
+		double SubmitMilliseconds = 0.0;
+		std::vector<double> PassMilliseconds; // per pass, in submission order
+		std::vector<const char*> PassNames;
+	};
+
+	PassRecorder(PassRecordingDevice& device, JobSystem& jobs);
+	PassRecorder(const PassRecorder& rhs) = delete;
+	PassRecorder& operator=(const PassRecorder& rhs) = delete;
+
+	// 'name' must outlive the frame; string literals are expected.
+	void AddPass(const char* name, RecordFunction record);
+
+	// Records the passes added since the last call and submits them.  With 'parallel'
+	// false they are recorded one after the other on the calling thread, to compare.
+	// Rethrows what a pass threw, after every list was closed.
+	void Execute(bool parallel = true);
+
+	const Stats& GetStats()const { return mStats; }
+
+	// Times each pass as a scope of its name on the thread recording it; null to stop.
+	void SetProfiler(Profiler* profiler) { mProfiler = profiler; }
+
+private:
+	struct Pass
+	{
+		const char* Name = nullptr;
+		RecordFunction Record;
+	};
+
+	void RecordPass(uint32 index);
+
+private:
+	PassRecordingDevice& mDevice;
+	JobSystem& mJobs;
+	Profiler* mProfiler = nullptr;
+
+	std::vector<Pass> mPasses;
+	Stats mStats;
+};
@@ -0,0 +1,386 @@
+#include "ProbeVolume.h"
+#include "SHBasis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace DirectX;
+
+const ProbeVolume::uint32 ProbeVolume::SHCount;
+
+namespace
+{
+	const float kPi = 3.14159265358979f;
+
+	// Cosine lobe convolution per band, for irradiance from radiance SH.
+	const float kBandScale[ProbeVolume::SHCount] = {
+		kPi,
+		2.0f * kPi / 3.0f, 2.0f * kPi / 3.0f, 2.0f * kPi / 3.0f,
+		kPi / 4.0f, kPi / 4.0f, kPi / 4.0f, kPi / 4.0f, kPi / 4.0f };
+
+	const ProbeVolume::Desc& Validate(const ProbeVolume::Desc& desc)
+	{
+		if (desc.Counts[0] == 0 || desc.Counts[1] == 0 || desc.Counts[2] == 0)
+			throw std::logic_error("ProbeVolume: no probes");
+		if (!(desc.Spacing.x > 0.0f && desc.Spacing.y > 0.0f && desc.Spacing.z > 0.0f))
+			throw std::logic_error("ProbeVolume: spacing must be positive");
+		if (desc.RaysPerProbe == 0 || desc.DepthResolution == 0)
+			throw std::logic_error("ProbeVolume: no rays or no distance texels");
+		if (!(desc.MaxDistance > 0.0f))
+			throw std::logic_error("ProbeVolume: max distance must be positive");
+		return desc;
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	float SignNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	float Saturate(float v)
+	{
+		return (std::min)((std::max)(v, 0.0f), 1.0f);
+	}
+
+	std::uint64_t SplitMix64(std::uint64_t& state)
+	{
+		std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	float UnitFloat(std::uint64_t& state)
+	{
+		return (float)(SplitMix64(state) >> 40) / (float)(1ull << 24);
+	}
+}
+
+ProbeVolume::ProbeVolume(const Desc& desc)
+	: mDesc(Validate(desc)),
+	mProbeCount(desc.Counts[0] * desc.Counts[1] * desc.Counts[2]),
+	mProbesPerFrame((std::max)(1u, (std::min)(desc.RayBudget / desc.RaysPerProbe, mProbeCount)))
+{
+	mRadiance.assign((size_t)mProbeCount * SHCount * 3, 0.0f);
+	mDepth.assign((size_t)mProbeCount * desc.DepthResolution * desc.DepthResolution,
+		XMFLOAT2(desc.MaxDistance, desc.MaxDistance * desc.MaxDistance));
+}
+
+ProbeVolume::uint32 ProbeVolume::ProbeIndex(uint32 x, uint32 y, uint32 z)const
+{
+	return x + mDesc.Counts[0] * (y + mDesc.Counts[1] * z);
+}
+
+XMFLOAT3 ProbeVolume::ProbePosition(uint32 probe)const
+{
+	const uint32 x = probe % mDesc.Counts[0];
+	const uint32 y = probe / mDesc.Counts[0] % mDesc.Counts[1];
+	const uint32 z = probe / (mDesc.Counts[0] * mDesc.Counts[1]);
+	return XMFLOAT3(mDesc.Origin.x + x * mDesc.Spacing.x, mDesc.Origin.y + y * mDesc.Spacing.y,
+		mDesc.Origin.z + z * mDesc.Spacing.z);
+}
+
+ProbeVolume::uint32 ProbeVolume::FirstProbe(uint64 frame)const
+{
+	return (uint32)(frame * mProbesPerFrame % mProbeCount);
+}
+
+ProbeVolume::uint32 ProbeVolume::ScheduledProbe(uint64 frame, uint32 slot)const
+{
+	return (FirstProbe(frame) + slot) % mProbeCount;
+}
+
+float ProbeVolume::HysteresisFor(uint64 frame, uint32 slot)const
+{
+	return frame * mProbesPerFrame + slot < mProbeCount ? 0.0f : mDesc.Hysteresis;
+}
+
+void ProbeVolume::RayRotation(uint64 frame, XMFLOAT4 rows[3])
+{
+	// A uniformly random rotation (Shoemake) from a hash of the frame number.
+	std::uint64_t state = frame;
+	const float u1 = UnitFloat(state);
+	const float u2 = UnitFloat(state);
+	const float u3 = UnitFloat(state);
+	const float a = std::sqrt(1.0f - u1);
+	const float b = std::sqrt(u1);
+	const float x = a * std::sin(2.0f * kPi * u2);
+	const float y = a * std::cos(2.0f * kPi * u2);
+	const float z = b * std::sin(2.0f * kPi * u3);
+	const float w = b * std::cos(2.0f * kPi * u3);
+
+	rows[0] = XMFLOAT4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f);
+	rows[1] = XMFLOAT4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f);
+	rows[2] = XMFLOAT4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f);
+}
+
+XMFLOAT3 ProbeVolume::RayDirection(uint32 ray, uint32 count, const XMFLOAT4 rows[3])
+{
+	const float goldenFraction = 0.618033988749895f;
+	const float turns = ray * goldenFraction;
+	const float phi = 2.0f * kPi * (turns - std::floor(turns));
+	const float cosTheta = 1.0f - (2.0f * ray + 1.0f) / count;
+	const float sinTheta = std::sqrt(Saturate(1.0f - cosTheta * cosTheta));
+	const XMFLOAT3 d(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+
+	return XMFLOAT3(
+		d.x * rows[0].x + d.y * rows[1].x + d.z * rows[2].x,
+		d.x * rows[0].y + d.y * rows[1].y + d.z * rows[2].y,
+		d.x * rows[0].z + d.y * rows[1].z + d.z * rows[2].z);
+}
+
+ProbeVolume::Constants ProbeVolume::MakeConstants(uint64 frame)const
+{
+	Constants constants = {};
+	RayRotation(frame, constants.RayRotation);
+	constants.Origin = mDesc.Origin;
+	constants.RaysPerProbe = mDesc.RaysPerProbe;
+	constants.Spacing = mDesc.Spacing;
+	constants.FirstProbe = FirstProbe(frame);
+	for (int i = 0; i < 3; ++i)
+		constants.Counts[i] = mDesc.Counts[i];
+	constants.ProbesThisFrame = mProbesPerFrame;
+	constants.Hysteresis = mDesc.Hysteresis;
+	constants.MaxDistance = mDesc.MaxDistance;
+	constants.NormalBias = mDesc.NormalBias;
+	constants.DepthResolution = mDesc.DepthResolution;
+	constants.DepthSharpness = mDesc.DepthSharpness;
+	constants.ProbeCount = mProbeCount;
+
+	const uint64 updated = frame * mProbesPerFrame;
+	constants.FreshProbes = updated < mProbeCount ? (uint32)(std::min)((uint64)mProbesPerFrame, mProbeCount - updated) : 0;
+	return constants;
+}
+
+void ProbeVolume::Update(uint64 frame, const Tracer& tracer, const float* environmentSH)
+{
+	XMFLOAT4 rows[3];
+	RayRotation(frame, rows);
+	for (uint32 slot = 0; slot < mProbesPerFrame; ++slot)
+		UpdateProbe(ScheduledProbe(frame, slot), rows, HysteresisFor(frame, slot), tracer, environmentSH);
+}
+
+void ProbeVolume::UpdateProbe(uint32 probe, const XMFLOAT4 rows[3], float hysteresis, const Tracer& tracer,
+	const float* environmentSH)
+{
+	const uint32 rayCount = mDesc.RaysPerProbe;
+	const XMFLOAT3 origin = ProbePosition(probe);
+
+	// What ProbeRayGen.hlsl writes per ray: radiance and distance.
+	std::vector<XMFLOAT3> directions(rayCount);
+	std::vector<XMFLOAT4> rays(rayCount);
+	for (uint32 i = 0; i < rayCount; ++i)
+	{
+		directions[i] = RayDirection(i, rayCount, rows);
+
+		float t = mDesc.MaxDistance;
+		const bool hit = tracer(origin, directions[i], mDesc.MaxDistance, &t);
+
+		float basis[SHCount];
+		SHBasis::Eval(3, &directions[i].x, basis);
+		float incoming[3] = { 0.0f, 0.0f, 0.0f };
+		for (uint32 c = 0; c < SHCount && !hit; ++c)
+		{
+			for (int k = 0; k < 3; ++k)
+				incoming[k] += environmentSH[c * 3 + k] * basis[c];
+		}
+		rays[i] = XMFLOAT4((std::max)(incoming[0], 0.0f), (std::max)(incoming[1], 0.0f), (std::max)(incoming[2], 0.0f),
+			hit ? (std::min)(t, mDesc.MaxDistance) : mDesc.MaxDistance);
+	}
+
+	// Radiance SH: the Monte Carlo projection over the uniform directions.
+	float projected[SHCount * 3] = {};
+	for (uint32 i = 0; i < rayCount; ++i)
+	{
+		float basis[SHCount];
+		SHBasis::Eval(3, &directions[i].x, basis);
+		for (uint32 c = 0; c < SHCount; ++c)
+		{
+			projected[c * 3 + 0] += rays[i].x * basis[c];
+			projected[c * 3 + 1] += rays[i].y * basis[c];
+			projected[c * 3 + 2] += rays[i].z * basis[c];
+		}
+	}
+	float* radiance = &mRadiance[(size_t)probe * SHCount * 3];
+	const float scale = 4.0f * kPi / rayCount;
+	for (uint32 c = 0; c < SHCount * 3; ++c)
+		radiance[c] = hysteresis * radiance[c] + (1.0f - hysteresis) * projected[c] * scale;
+
+	// Distance moments: each texel averages the rays near its direction.
+	const uint32 resolution = mDesc.DepthResolution;
+	XMFLOAT2* depth = &mDepth[(size_t)probe * resolution * resolution];
+	for (uint32 y = 0; y < resolution; ++y)
+	{
+		for (uint32 x = 0; x < resolution; ++x)
+		{
+			const XMFLOAT3 texelDirection = OctDecode(XMFLOAT2(
+				(x + 0.5f) / resolution * 2.0f - 1.0f, (y + 0.5f) / resolution * 2.0f - 1.0f));
+
+			float weightSum = 0.0f;
+			float mean = 0.0f;
+			float meanSquare = 0.0f;
+			for (uint32 i = 0; i < rayCount; ++i)
+			{
+				const float weight = std::pow((std::max)(Dot(texelDirection, directions[i]), 0.0f), mDesc.DepthSharpness);
+				weightSum += weight;
+				mean += weight * rays[i].w;
+				meanSquare += weight * rays[i].w * rays[i].w;
+			}
+
+			XMFLOAT2& texel = depth[y * resolution + x];
+			if (weightSum > 0.0f)
+			{
+				texel.x = hysteresis * texel.x + (1.0f - hysteresis) * mean / weightSum;
+				texel.y = hysteresis * texel.y + (1.0f - hysteresis) * meanSquare / weightSum;
+			}
+			else if (hysteresis == 0.0f)
+				texel = XMFLOAT2(mDesc.MaxDistance, mDesc.MaxDistance * mDesc.MaxDistance);
+		}
+	}
+}
+
+const XMFLOAT2* ProbeVolume::Depth(uint32 probe)const
+{
+	return &mDepth[(size_t)probe * mDesc.DepthResolution * mDesc.DepthResolution];
+}
+
+XMFLOAT3 ProbeVolume::ProbeIrradiance(uint32 probe, const XMFLOAT3& n)const
+{
+	float basis[SHCount];
+	SHBasis::Eval(3, &n.x, basis);
+	const float* radiance = Radiance(probe);
+
+	XMFLOAT3 e(0.0f, 0.0f, 0.0f);
+	for (uint32 c = 0; c < SHCount; ++c)
+	{
+		const float w = kBandScale[c] * basis[c];
+		e.x += w * radiance[c * 3 + 0];
+		e.y += w * radiance[c * 3 + 1];
+		e.z += w * radiance[c * 3 + 2];
+	}
+	return XMFLOAT3((std::max)(e.x, 0.0f), (std::max)(e.y, 0.0f), (std::max)(e.z, 0.0f));
+}
+
+XMFLOAT2 ProbeVolume::DepthMoments(uint32 probe, const XMFLOAT3& direction)const
+{
+	const uint32 resolution = mDesc.DepthResolution;
+	const XMFLOAT2 p = OctEncode(direction);
+	const float last = (float)(resolution - 1);
+	const float u = (std::min)((std::max)((p.x * 0.5f + 0.5f) * resolution - 0.5f, 0.0f), last);
+	const float v = (std::min)((std::max)((p.y * 0.5f + 0.5f) * resolution - 0.5f, 0.0f), last);
+	const uint32 x0 = (uint32)u;
+	const uint32 y0 = (uint32)v;
+	const uint32 x1 = (std::min)(x0 + 1, resolution - 1);
+	const uint32 y1 = (std::min)(y0 + 1, resolution - 1);
+	const float fx = u - x0;
+	const float fy = v - y0;
+
+	const XMFLOAT2* depth = Depth(probe);
+	const XMFLOAT2& d00 = depth[y0 * resolution + x0];
+	const XMFLOAT2& d10 = depth[y0 * resolution + x1];
+	const XMFLOAT2& d01 = depth[y1 * resolution + x0];
+	const XMFLOAT2& d11 = depth[y1 * resolution + x1];
+	return XMFLOAT2(
+		(d00.x * (1.0f - fx) + d10.x * fx) * (1.0f - fy) + (d01.x * (1.0f - fx) + d11.x * fx) * fy,
+		(d00.y * (1.0f - fx) + d10.y * fx) * (1.0f - fy) + (d01.y * (1.0f - fx) + d11.y * fx) * fy);
+}
+
+XMFLOAT3 ProbeVolume::Irradiance(const XMFLOAT3& p, const XMFLOAT3& n)const
+{
+	// The cell and its weights are those of the biased point, as in the Chebyshev test,
+	// so a point just inside a wall leans on the probes on its side.
+	const XMFLOAT3 biased(p.x + n.x * mDesc.NormalBias, p.y + n.y * mDesc.NormalBias, p.z + n.z * mDesc.NormalBias);
+	const float relative[3] = {
+		(biased.x - mDesc.Origin.x) / mDesc.Spacing.x,
+		(biased.y - mDesc.Origin.y) / mDesc.Spacing.y,
+		(biased.z - mDesc.Origin.z) / mDesc.Spacing.z };
+	int base[3];
+	float alpha[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		const int highest = (std::max)((int)mDesc.Counts[k] - 2, 0);
+		base[k] = (std::min)((std::max)((int)std::floor(relative[k]), 0), highest);
+		alpha[k] = Saturate(relative[k] - base[k]);
+	}
+
+	XMFLOAT3 sum(0.0f, 0.0f, 0.0f);
+	float weightSum = 0.0f;
+	for (uint32 corner = 0; corner < 8; ++corner)
+	{
+		uint32 index[3];
+		float trilinear = 1.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32 offset = (corner >> k) & 1;
+			index[k] = (std::min)((uint32)base[k] + offset, mDesc.Counts[k] - 1);
+			trilinear *= offset ? alpha[k] : 1.0f - alpha[k];
+		}
+		const uint32 probe = ProbeIndex(index[0], index[1], index[2]);
+		const XMFLOAT3 probePosition = ProbePosition(probe);
+
+		// Probes behind the surface count less, but not nothing, so a point with every
+		// probe behind it is still lit.
+		const XMFLOAT3 toProbe(probePosition.x - p.x, probePosition.y - p.y, probePosition.z - p.z);
+		const float toProbeLength = std::sqrt(Dot(toProbe, toProbe));
+		const float facing = toProbeLength > 1e-6f ? Dot(toProbe, n) / toProbeLength : 1.0f;
+		const float wrap = (facing + 1.0f) * 0.5f;
+		float weight = wrap * wrap + 0.2f;
+
+		// Chebyshev: how likely the probe sees the point, from the distances it saw that way.
+		const XMFLOAT3 fromProbe(biased.x - probePosition.x, biased.y - probePosition.y, biased.z - probePosition.z);
+		const float distance = std::sqrt(Dot(fromProbe, fromProbe));
+		if (distance > 1e-6f)
+		{
+			const XMFLOAT3 direction(fromProbe.x / distance, fromProbe.y / distance, fromProbe.z / distance);
+			const XMFLOAT2 moments = DepthMoments(probe, direction);
+			if (distance > moments.x)
+			{
+				const float variance = std::fabs(moments.y - moments.x * moments.x);
+				const float d = distance - moments.x;
+				const float chebyshev = variance / (variance + d * d);
+				weight *= (std::max)(chebyshev * chebyshev * chebyshev, 0.05f);
+			}
+		}
+
+		// Crush small weights, so light leaking through a barely visible probe fades out.
+		weight = (std::max)(weight, 1e-6f);
+		const float crushThreshold = 0.2f;
+		if (weight < crushThreshold)
+			weight *= weight * weight / (crushThreshold * crushThreshold);
+
+		weight *= trilinear;
+		const XMFLOAT3 e = ProbeIrradiance(probe, n);
+		sum.x += weight * e.x;
+		sum.y += weight * e.y;
+		sum.z += weight * e.z;
+		weightSum += weight;
+	}
+
+	return weightSum > 0.0f ? XMFLOAT3(sum.x / weightSum, sum.y / weightSum, sum.z / weightSum) : XMFLOAT3(0.0f, 0.0f, 0.0f);
+}
+
+XMFLOAT2 ProbeVolume::OctEncode(const XMFLOAT3& direction)
+{
+	const float l1 = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+	XMFLOAT2 p(direction.x / l1, direction.y / l1);
+	if (direction.z < 0.0f)
+		p = XMFLOAT2((1.0f - std::fabs(p.y)) * SignNotZero(p.x), (1.0f - std::fabs(p.x)) * SignNotZero(p.y));
+	return p;
+}
+
+XMFLOAT3 ProbeVolume::OctDecode(const XMFLOAT2& p)
+{
+	XMFLOAT3 d(p.x, p.y, 1.0f - std::fabs(p.x) - std::fabs(p.y));
+	if (d.z < 0.0f)
+	{
+		d.x = (1.0f - std::fabs(p.y)) * SignNotZero(p.x);
+		d.y = (1.0f - std::fabs(p.x)) * SignNotZero(p.y);
+	}
+	const float length = std::sqrt(Dot(d, d));
+	return XMFLOAT3(d.x / length, d.y / length, d.z / length);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <DirectXMath.h>
+
+// Grid of irradiance probes for the probe volume space, in the manner of DDGI: each
+// probe keeps the radiance arriving at it as order 3 SH and, per octahedral texel, the
+// mean and mean square distance to the surfaces around it.  A fixed budget of rays is
+// traced each frame, round robin over the probes, and blended into what they held.
+// Shading interpolates the eight probes around a point trilinearly, weighted against
+// probes behind the surface and, through the distance moments (Chebyshev), probes the
+// point is hidden from.  The cost is that of the probes, not of the receivers.
+//
+// This is the CPU reference for ProbeRayGen.hlsl, ProbeUpdate.hlsl and
+// ProbeVolumeUtil.hlsl: the same ray directions, schedule, blending and weights.
+class ProbeVolume
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint32 SHCount = 9;
+
+	struct Desc
+	{
+		// The first probe, the distance between neighbours and the probes along x, y, z.
+		DirectX::XMFLOAT3 Origin = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 Spacing = { 1.0f, 1.0f, 1.0f };
+		uint32 Counts[3] = { 8, 8, 8 };
+
+		uint32 RaysPerProbe = 64;
+		// Rays traced per frame; at least one probe is updated.
+		uint32 RayBudget = 16384;
+		// Weight of what a probe held against the rays just traced.
+		float Hysteresis = 0.9f;
+		// Octahedral texels along each side of a probe's distance moments.  Coarser maps
+		// blur rays that just miss a wall's edge into the texels that see the wall, and
+		// the variance that adds lets light through it; 8 leaks about four times as much.
+		uint32 DepthResolution = 16;
+		// Rays go this far; misses count as hits at this distance.
+		float MaxDistance = 10.0f;
+		// Shading points are pushed this far along the normal before the probes around
+		// them are picked and weighted.
+		float NormalBias = 0.25f;
+		// Exponent of the cosine spreading a ray over the distance texels around it.
+		float DepthSharpness = 50.0f;
+	};
+
+	// The cbuffer cbProbeVolume of ProbeVolumeUtil.hlsl, field for field.
+	struct Constants
+	{
+		DirectX::XMFLOAT4 RayRotation[3]; // rows
+		DirectX::XMFLOAT3 Origin;
+		uint32 RaysPerProbe;
+		DirectX::XMFLOAT3 Spacing;
+		uint32 FirstProbe;
+		uint32 Counts[3];
+		uint32 ProbesThisFrame;
+		float Hysteresis;
+		float MaxDistance;
+		float NormalBias;
+		uint32 DepthResolution;
+		float DepthSharpness;
+		uint32 ProbeCount;
+		// Slots [0, FreshProbes) of this frame update probes for the first time.
+		uint32 FreshProbes;
+		uint32 Pad;
+	};
+
+	static_assert(sizeof(Constants) == 128, "Constants must match cbProbeVolume in ProbeVolumeUtil.hlsl");
+
+	// Whether 'direction', of length 'tMax' at most, hits anything from 'origin', and at
+	// what distance.
+	using Tracer = std::function<bool(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction,
+		float tMax, float* t)>;
+
+	// Throws std::logic_error for an empty grid, spacing that is not positive or no rays.
+	explicit ProbeVolume(const Desc& desc);
+
+	const Desc& GetDesc()const { return mDesc; }
+	uint32 ProbeCount()const { return mProbeCount; }
+	uint32 ProbesPerFrame()const { return mProbesPerFrame; }
+	// Frames between two updates of the same probe.
+	uint32 FramesPerSweep()const { return (mProbeCount + mProbesPerFrame - 1) / mProbesPerFrame; }
+
+	// Probe x, y, z is number x + cx * (y + cy * z).
+	uint32 ProbeIndex(uint32 x, uint32 y, uint32 z)const;
+	DirectX::XMFLOAT3 ProbePosition(uint32 probe)const;
+
+	// The probes 'frame' updates, in slot order: ProbesPerFrame() of them from
+	// FirstProbe(frame) on, wrapping around.
+	uint32 FirstProbe(uint64 frame)const;
+	uint32 ScheduledProbe(uint64 frame, uint32 slot)const;
+	// Blend weight of slot 'slot' in 'frame': 0 the first time a probe is updated.
+	float HysteresisFor(uint64 frame, uint32 slot)const;
+
+	// The rotation applied to every probe's ray directions in 'frame', rows of a
+	// row-vector matrix, so successive updates of a probe sample different directions.
+	static void RayRotation(uint64 frame, DirectX::XMFLOAT4 rows[3]);
+	// Ray 'ray' of 'count' on the spherical Fibonacci spiral, rotated by 'rows'.
+	static DirectX::XMFLOAT3 RayDirection(uint32 ray, uint32 count, const DirectX::XMFLOAT4 rows[3]);
+
+	// What the shaders get for 'frame'.
+	Constants MakeConstants(uint64 frame)const;
+
+	// Traces and blends the probes 'frame' is scheduled to update.  'environmentSH' is
+	// the order 3 radiance SH of the sky, 3 floats per coefficient as in SHCoeff; rays
+	// that miss see it, rays that hit see black, as in the visibility rays.
+	void Update(uint64 frame, const Tracer& tracer, const float* environmentSH);
+	// One probe's update, given its ray rotation and blend weight.
+	void UpdateProbe(uint32 probe, const DirectX::XMFLOAT4 rows[3], float hysteresis, const Tracer& tracer,
+		const float* environmentSH);
+
+	// Irradiance at world position 'p' with unit normal 'n', from the probes around it.
+	DirectX::XMFLOAT3 Irradiance(const DirectX::XMFLOAT3& p, const DirectX::XMFLOAT3& n)const;
+	// Irradiance from one probe's SH alone, for a surface facing 'n'.
+	DirectX::XMFLOAT3 ProbeIrradiance(uint32 probe, const DirectX::XMFLOAT3& n)const;
+	// Mean and mean square distance seen by 'probe' in unit direction 'direction',
+	// bilinear between texels, clamped at the edges of the octahedral map.
+	DirectX::XMFLOAT2 DepthMoments(uint32 probe, const DirectX::XMFLOAT3& direction)const;
+
+	// Probe 'probe's SH, SHCount float3 as in SHCoeff, and its DepthResolution^2 moments
+	// row by row; the layouts of gProbeRadiance and gProbeDepth.
+	const float* Radiance(uint32 probe)const { return &mRadiance[(size_t)probe * SHCount * 3]; }
+	const DirectX::XMFLOAT2* Depth(uint32 probe)const;
+
+	// Octahedral mapping between unit directions and [-1, 1]^2.
+	static DirectX::XMFLOAT2 OctEncode(const DirectX::XMFLOAT3& direction);
+	static DirectX::XMFLOAT3 OctDecode(const DirectX::XMFLOAT2& p);
+
+private:
+	const Desc mDesc;
+	const uint32 mProbeCount;
+	const uint32 mProbesPerFrame;
+
+	std::vector<float> mRadiance;
+	std::vector<DirectX::XMFLOAT2> mDepth;
+};
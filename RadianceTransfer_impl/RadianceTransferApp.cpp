@@ -7,6 +7,11 @@
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
 #include "../Common/Camera.h"
+#include "../Common/PlatformUtil.h"
+#include "../Common/JobSystem.h"
+#include "../Common/Profiler.h"
+#include "../Common/InputReplay.h"
+#include "../Common/ShaderCompileBatch.h"
 #include "FrameResource.h"
 #include "DXRHelper.h"
 #include "nv_helpers_dx12/ShaderBindingTableGenerator.h"
@@ -15,7 +20,28 @@
 #include "nv_helpers_dx12/RaytracingPipelineGenerator.h"
 #include "nv_helpers_dx12/RootSignatureGenerator.h"
 #include "Model.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+#include "CpuRayCaster.h"
+#include "AdaptiveGrid.h"
+#include "EnvironmentMap.h"
+#include "SceneDesc.h"
+#include "TextureStreamer.h"
+#include "D3D12TextureUploadDevice.h"
+#include "PassRecorder.h"
+#include "D3D12PassRecordingDevice.h"
+#include "D3D12GpuTimer.h"
+#include "UploadAllocator.h"
+#include "D3D12UploadMemoryDevice.h"
+#include "D3D12DescriptorHeap.h"
+#include "D3D12ResourceHeaps.h"
+#include "VertexPacking.h"
+#include "TransformSystem.h"
+#include "Reprojection.h"
 #include "ShadowMap.h"
+#include "ProbeVolume.h"
 
 #include <mutex>
 #include <dxcapi.h>
@@ -24,6 +50,8 @@
 #include <exception>
 #include <random>
 #include <limits>
+#include <chrono>
+#include <functional>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -64,52 +92,26 @@ struct RenderItem
 {
 	RenderItem() = default;
 	RenderItem(const RenderItem& rhs) = delete;
-	void strafe(float d) {
-		// Position += d*Right
-		XMVECTOR s = XMVectorReplicate(d);
-		XMVECTOR r = XMLoadFloat3(&Right);
-		XMVECTOR p = XMLoadFloat3(&Position);
-		XMStoreFloat3(&Position, XMVectorMultiplyAdd(s, r, p));
-
-		NumFramesDirty = gNumFrameResources;
-	}
-
-	void walk(float d) {
-		// Position += d*Front
-		XMVECTOR s = XMVectorReplicate(d);
-		XMVECTOR r = XMLoadFloat3(&Front);
-		XMVECTOR p = XMLoadFloat3(&Position);
-		XMStoreFloat3(&Position, XMVectorMultiplyAdd(s, r, p));
-
-		NumFramesDirty = gNumFrameResources;
-	}
-
-	void fluctuate(float d) {
-		// Position += d*Up
-		XMVECTOR s = XMVectorReplicate(d);
-		XMVECTOR l = XMLoadFloat3(&Up);
-		XMVECTOR p = XMLoadFloat3(&Position);
-		XMStoreFloat3(&Position, XMVectorMultiplyAdd(s, l, p));
-
-		NumFramesDirty = gNumFrameResources;
-	}
-
 	std::string GeoName;
 
-	// World matrix of the shape that describes the object's local space
-	// relative to the world space, which defines the position, orientation,
-	// and scale of the object in the world.
+	// Directions the item is moved in, in world space.
 	constexpr static DirectX::XMFLOAT3 Right = { 1.0f, 0.0f, 0.0f };
 	constexpr static DirectX::XMFLOAT3 Front = { 0.0f, 0.0f, 1.0f };
 	constexpr static DirectX::XMFLOAT3 Up = { 0.0f, 1.0f, 0.0f };
 
-	XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
-	XMFLOAT3 Scale = { 1.0f, 1.0f, 1.0f };
-	XMMATRIX WorldMat = XMMatrixIdentity();
+	// The item's position and scale in NormalMapApp::mTransforms, which also holds the
+	// world matrix that describes the object's local space relative to the world space.
+	UINT TransformId = 0;
 
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
-	UINT vertexOffset = 0; // Vertex offset for visibility buffer.(model -> box -> grid)
+	UINT vertexOffset = 0; // Vertex offset for visibility buffer.(receivers in scene order)
+
+	// Slots of this item's meshlet draws in the frame's IndirectArgs buffer; zero
+	// capacity means the item is always drawn whole.
+	UINT IndirectArgsOffset = 0;
+	UINT IndirectArgsCapacity = 0;
+	UINT IndirectDrawCount = 0;
 
 	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
 	// Because we have an object cbuffer for each FrameResource, we have to apply the
@@ -148,7 +150,64 @@ enum class Space : int
 {
 	WorldSpace = 0,
 	ScreenSpace,
-	TextureSpace
+	TextureSpace,
+	ProbeVolume
+};
+
+// Start of the LOD submeshes GenerateLods appended to the index buffer of 'name', i.e. the
+// index count of LOD0; 'indexCount' if there are none.
+static UINT Lod0IndexCount(const std::string& name, const std::vector<MeshCache::Submesh>& submeshes, UINT indexCount)
+{
+	const std::string lodPrefix = name + "_";
+	for (const MeshCache::Submesh& submesh : submeshes)
+	{
+		if (submesh.Name.compare(0, lodPrefix.size(), lodPrefix) == 0)
+			indexCount = (std::min)(indexCount, (UINT)submesh.StartIndex);
+	}
+	return indexCount;
+}
+
+static XMFLOAT4X4 SceneObjectWorld(const SceneDesc::Object& object)
+{
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixScaling(object.Scale.x, object.Scale.y, object.Scale.z) *
+		XMMatrixTranslation(object.Position.x, object.Position.y, object.Position.z));
+	return world;
+}
+
+// Scene mesh built or mapped on the job system, uploaded later on the main thread.
+struct PreparedMesh
+{
+	std::string Name;
+	bool Pack = false;
+
+	// Mapped when the mesh cache was valid, otherwise the mesh was built into Mesh.
+	bool FromCache = false;
+	MeshCache Cache;
+	GeometryGenerator::MeshData Mesh;
+	std::vector<MeshCache::Submesh> Submeshes;
+
+	double Milliseconds = 0.0;
+
+	const GeometryGenerator::Vertex* Vertices()const { return FromCache ? Cache.Vertices() : Mesh.Vertices.data(); }
+	UINT VertexCount()const { return FromCache ? Cache.VertexCount() : (UINT)Mesh.Vertices.size(); }
+	const std::uint32_t* Indices()const { return FromCache ? Cache.Indices() : Mesh.Indices32.data(); }
+	UINT IndexCount()const { return FromCache ? Cache.IndexCount() : (UINT)Mesh.Indices32.size(); }
+	const std::vector<MeshCache::Submesh>& MeshSubmeshes()const { return FromCache ? Cache.Submeshes() : Submeshes; }
+};
+
+// A mesh being prepared; Mesh is set once Job has finished.
+struct MeshJob
+{
+	JobSystem::JobHandle Job;
+	std::shared_ptr<PreparedMesh> Mesh;
+};
+
+// An occluder the adaptive grid is refined against, at its startup placement.
+struct PlacedMesh
+{
+	const MeshJob* Mesh;
+	XMFLOAT4X4 World;
 };
 
 class NormalMapApp : public D3DApp
@@ -159,6 +218,12 @@ public:
 	NormalMapApp& operator=(const NormalMapApp& rhs) = delete;
 	~NormalMapApp();
 
+	// -record <file> saves the input of the run on exit; -replay <file> plays one back
+	// and writes the time of each frame to -timings <file>, or <file>.timings.csv.
+	// -space world|screen|texture|probes picks the projection space.  Returns false for
+	// arguments it does not know.
+	bool ParseCommandLine(const std::string& cmdLine);
+
 	virtual bool Initialize()override;
 
 private:
@@ -170,20 +235,37 @@ private:
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
 
-	void OnKeyboardInput(const GameTimer& gt);
+	// The keys held and the mouse dragged since the last frame.
+	InputFrame PollInput();
+	void ApplyInput(const InputFrame& input, const GameTimer& gt);
+	void FinishReplay();
+	void MoveItem(RenderItem* ritem, const XMFLOAT3& direction, float d);
 	void UpdateObjectCBs(const GameTimer& gt);
+	// The first time an item moves, compares the reprojection of its bounds through the
+	// transforms written for TemporalFilter.hlsl against projecting where they were, and
+	// logs the pixel motion and the error.
+	void CheckReprojection(const RenderItem* ri, const ObjectTransform& transform);
+	void UpdateMeshletCulling(const GameTimer& gt);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
-
-	void LoadTextures();
+	// Builds this frame's shader tables, one per receiver dispatched.
+	void UpdateShaderBindingTables();
+	// Uploads the next mips, and logs once every texture is resident.
+	void UpdateTextureStreaming();
+
+	// Reads mSceneFile, then builds or maps the meshes on mJobs while the main
+	// thread records their uploads in file order.  Textures go to mTextureStreamer; only
+	// their smallest mips are resident when it returns.
+	void LoadScene();
 	void BuildRootSignature();
 	void BuildDescriptorHeaps();
 
 	void BuildShadersAndInputLayout();
-	void BuildShapeGeometry();
 	void BuildSHCoeffsBuffer();
 	void BuildVisibilityTermBuffer();
 	void BuildRandomStateBuffer(); // random number state for generating sampleVec
+	// In the probe volume space only: the probe buffers, from the scene's probes.
+	void BuildProbeVolume();
 	void BuildGBuffer();
 	void BuildPSOs();
 	void BuildFrameResources();
@@ -191,7 +273,56 @@ private:
 	void BuildRenderItems();
 	void DrawRenderItemsIndexedInstanced(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
 	void DrawRenderItemsInstanced(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
-	void DrawSceneToDepthMap();
+	// Draws only the meshlets that survived UpdateMeshletCulling, through ExecuteIndirect.
+	// Only for passes without per-vertex side effects.
+	void DrawRenderItemsCulled(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void BuildDrawIndirectSignature();
+	void DrawSceneToDepthMap(ID3D12GraphicsCommandList* cmdList);
+
+	// Everything a pass of Draw expects bound when it starts, since each records into a
+	// command list of its own: heaps, root signature and arguments, viewport and targets.
+	void BindPassState(ID3D12GraphicsCommandList* cmdList);
+	// Zeroes the resource of the first UAV of 'uav'.
+	void ClearUav(ID3D12GraphicsCommandList* cmdList, const UavRange& uav, ID3D12Resource* resource);
+	// Zeroes the SH and G-buffer targets of the current space for the next frame.
+	void ClearFrameTargets(ID3D12GraphicsCommandList* cmdList);
+
+	// With 'pack' set the vertices are uploaded in the 20-byte VertexPacking format,
+	// quantized against 'bounds'.  Submeshes named "<name>_<lod>" are LODs appended after
+	// LOD0 by GenerateLods; they become DrawArgs of their own, the rest is ignored.
+	std::unique_ptr<MeshGeometry> CreateMeshGeometry(const std::string& name,
+		const GeometryGenerator::Vertex* vertices, UINT vertexCount,
+		const std::uint32_t* indices, UINT indexCount, const DirectX::BoundingBox& bounds, bool pack = false,
+		const std::vector<MeshCache::Submesh>& submeshes = {});
+	std::unique_ptr<MeshGeometry> CreateMeshGeometry(const PreparedMesh& prepared);
+
+	// Reorders for the vertex cache, overdraw and fetch locality and logs ACMR/ATVR.
+	void OptimizeMesh(const std::string& name, GeometryGenerator::MeshData& mesh,
+		const std::vector<MeshCache::Submesh>& submeshes = {});
+
+	// Appends "<name>_lod1", "<name>_lod2" and "<name>_occluder" to the index buffer and
+	// to 'submeshes'.  LODs share the vertex buffer, so per-vertex SH state covers all of them.
+	void GenerateLods(const std::string& name, GeometryGenerator::MeshData& mesh,
+		std::vector<MeshCache::Submesh>& submeshes);
+
+	// Generated shapes are built directly, models and grids go through the mesh cache.
+	// Only touches the CPU, so it runs on the job system.
+	std::shared_ptr<PreparedMesh> PrepareMesh(const SceneDesc::Mesh& desc);
+
+	// Receiver grid refined where the occluders change the transfer (see AdaptiveGrid.h),
+	// cached like the uniform grid.  Waits for the occluder meshes on a cache miss.
+	std::shared_ptr<PreparedMesh> PrepareAdaptiveGrid(const SceneDesc::Mesh& desc, const XMFLOAT4X4& gridWorld,
+		const std::vector<PlacedMesh>& occluders);
+
+	// Traces the same random shadow rays against the full meshes and the occluder proxies
+	// on the CPU and logs how often the two disagree.
+	void ReportOccluderError();
+
+	// Maps Cache/<name>.mesh into 'prepared' if it is still valid for 'source', otherwise
+	// calls 'build' and rewrites the cache.  'source' is the asset path when sourceIsFile is
+	// set, or a description of the generator parameters for procedural meshes.
+	void PrepareCachedMesh(PreparedMesh& prepared, const std::string& source, bool sourceIsFile, bool lods,
+		const std::function<GeometryGenerator::MeshData(std::vector<MeshCache::Submesh>&)>& build);
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
@@ -203,14 +334,21 @@ private:
 	FrameResource* mCurrFrameResource = nullptr;
 	int mCurrFrameResourceIndex = 0;
 
-	UINT mCbvSrvDescriptorSize = 0;
-
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 
-	ComPtr<ID3D12DescriptorHeap> mDescriptorHeap = nullptr;
-	ComPtr<ID3D12DescriptorHeap> mClearDescriptorHeap = nullptr; // descriptor heap for clearing UAV resources.
+	// Every CBV/SRV/UAV descriptor; the ranges below are where the views live in it.
+	std::unique_ptr<D3D12DescriptorHeap> mDescriptors;
+
+	// The heaps the default-heap buffers and textures below are placed in, declared first
+	// so they outlive them.
+	std::unique_ptr<D3D12ResourceHeaps> mResourceHeaps;
 
 	ComPtr<ID3D12Resource> mEnvCoeffs = nullptr;
+	// Environment SH projected on the CPU from a lat-long .hdr sky, copied into mEnvCoeffs
+	// during initialization instead of projecting the cube on the GPU.
+	bool mEnvironmentFromImage = false;
+	EnvironmentMap::SH9 mEnvironmentSH;
+	std::unique_ptr<UploadBuffer<SHCoeff>> mEnvCoeffsUpload;
 
 	// Per-vertex
 	ComPtr<ID3D12Resource> mTemporalObjCoeffs = nullptr;
@@ -233,42 +371,152 @@ private:
 	std::unique_ptr<ShadowMap> mDepthMap = nullptr; // deptp map for screen space RT 
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+	std::unordered_map<std::string, std::vector<Meshlets::Meshlet>> mMeshlets;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mPackedInputLayout;
 
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
-	RenderItem* mGridRitem = nullptr;
-	RenderItem* mBoxRitem = nullptr;
+	// Positions and scales of the render items, and the matrices derived from them.
+	TransformSystem mTransforms;
+	// Objects moved with the arrow keys and with I/J/K/L, chosen by keys= in the scene.
+	RenderItem* mArrowKeysRitem = nullptr;
+	RenderItem* mIJKLKeysRitem = nullptr;
+
+	std::string mSceneFile = "Scenes/default.scene";
+	SceneDesc mScene;
+
+	// Length of the per-vertex SH and visibility buffers, all receivers back to back.
+	UINT mReceiverVertexCount = 0;
+
+	// CPU work outside the modules' own loops: mesh preparation, initial buffers.
+	std::unique_ptr<JobSystem> mJobs;
+
+	// Compiled shaders and DXIL libraries under Cache/Shaders, keyed by their sources,
+	// includes, defines and compiler, so a launch only compiles what changed.
+	std::unique_ptr<ShaderCache> mShaderCache;
+
+	// Draw records its passes into a command list each, in parallel on mJobs.
+	std::unique_ptr<D3D12PassRecordingDevice> mPassDevice;
+	std::unique_ptr<PassRecorder> mPassRecorder;
+
+	// CPU scopes of Update and the passes, and each pass list on the GPU.  'P' captures
+	// the next frames to profile.json for chrome://tracing.
+	std::unique_ptr<Profiler> mProfiler;
+	std::unique_ptr<D3D12GpuTimer> mGpuTimer;
+	bool mCaptureKeyDown = false;
+
+	// Recording and replaying both run at the recording's fixed time step and sampling
+	// seed, so the same input moves the camera and objects the same way whatever the
+	// frame rate, and the traced samples match.  A replay times each frame and quits
+	// after the last one.
+	std::string mRecordPath;
+	std::string mReplayPath;
+	std::string mTimingsPath;
+	std::unique_ptr<InputRecording> mInputRecording;
+	std::unique_ptr<InputReplayer> mInputReplayer;
+	FrameTimingLog mFrameTimings;
+	FrameTimingLog::Timing mFrameTiming; // of the frame in progress
+	std::chrono::high_resolution_clock::time_point mFrameStart;
+	bool mFrameStarted = false;
+	int mMouseDx = 0; // dragged since the last frame, in pixels
+	int mMouseDy = 0;
+
+	// Pass and object constants, material data and shader tables, written anew each frame
+	// into one upload ring.  The allocator must go before the device.
+	std::unique_ptr<D3D12UploadMemoryDevice> mUploadDevice;
+	std::unique_ptr<UploadAllocator> mUploads;
+	D3D12_GPU_VIRTUAL_ADDRESS mPassCBAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mObjectCBAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mMaterialBufferAddress = 0;
+	std::vector<UploadAllocator::Allocation> mShaderBindingTables;
+
+	// The object constants and material data as of their last change, indexed like the
+	// buffers; the whole arrays go to the ring every frame.
+	std::vector<ObjectConstants> mObjectConstants;
+	std::vector<MaterialData> mMaterialData;
+
+	// Scene textures, smallest mips first: the tails are uploaded before the first frame,
+	// the other mips over the frames after it.  The streamer must go before the device.
+	std::unique_ptr<D3D12TextureUploadDevice> mTextureUploadDevice;
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+	std::vector<std::uint32_t> mStreamedTextures; // streamer id of each mScene.Textures entry
+	bool mTexturesResidentLogged = false;
+
+	// Project the sky onto SH in the next Draw: on the first frame, and again whenever
+	// more of the cube map has become resident.
+	bool mProjectEnvironment = true;
+	std::uint32_t mSkyResidentMip = 0;
+
+	std::chrono::high_resolution_clock::time_point mStartTime;
+	bool mFirstFrameLogged = false;
 
 	// Projecting light transport in which space?
 	Space mProjLTSpace = Space::ScreenSpace;
 
-	UINT mSkyTexHeapIndex = 0;
-	UINT mAccelerationStructureHeapIndex = 0;
-	UINT mScreenSpaceIntermediateSHCoeffsHeapIndex = 0;
-	UINT mScreenSpaceThisFrameSHCoeffsHeapIndex = 0;
-	UINT mScreenSpaceLastFrameSHCoeffsHeapIndex = 0;
-	UINT mFilteredHorzSHCoeffsHeapIndex = 0;
-	UINT mFilteredVertSHCoeffsHeapIndex = 0;
-	UINT mGBufferHeapIndex = 0;
-	UINT mDepthMapHeapIndex = 0;
-	UINT mTextureSpaceVisibility4SRVHeapIndex = 0;
-	UINT mTextureSpaceVisibility4UAVHeapIndex = 0;
-
-	// heap index for clearing UAV
-	UINT mIntermediateClearHeapIndex = 0;
-	UINT mThisFrameClearHeapIndex = 0;
-	UINT mFilteredHorzClearHeapIndex = 0;
-	UINT mFilteredVertClearHeapIndex = 0;
-	UINT mGBufferClearHeapIndex = 0;
+	// Probe volume space: the scene's probes, the rays traced for them this frame (a
+	// float4 of radiance and distance each), their SH and their distance moments.
+	std::unique_ptr<ProbeVolume> mProbeVolume;
+	ComPtr<ID3D12Resource> mProbeRays = nullptr;
+	ComPtr<ID3D12Resource> mProbeRadiance = nullptr;
+	ComPtr<ID3D12Resource> mProbeDepth = nullptr;
+	std::unique_ptr<UploadBuffer<SHCoeff>> mProbeRadianceUpload;
+	std::unique_ptr<UploadBuffer<XMFLOAT2>> mProbeDepthUpload;
+	D3D12_GPU_VIRTUAL_ADDRESS mProbeCBAddress = 0;
+	std::uint64_t mProbeFrame = 0;
+
+	// Store the receiver meshes marked pack=1 in the scene in the packed 20-byte vertex
+	// format.  The sky sphere and the full-screen quad always keep the full layout.
+	bool mUsePackedVertices = false;
+
+	// Cull meshlets of the receivers on the CPU and draw the rest with ExecuteIndirect
+	// in the rasterization-only passes (opaque, writeGBuffer, draw_depth).
+	bool mUseMeshletCulling = true;
+	Meshlets::CullStats mMeshletStats;
+	float mMeshletStatsTime = 0.0f;
+	bool mReprojectionChecked = false;
+	ComPtr<ID3D12CommandSignature> mDrawIndexedSignature;
+
+	// Build the BLAS of the receivers from their "_occluder" LOD.  Visibility rays only
+	// ask whether something was hit, so a coarse proxy traces faster, but a receiver's
+	// rays then also hit the proxy of its own mesh and its self-shadowing coarsens with
+	// it; hence off unless the trace time matters more.
+	bool mUseOccluderProxies = false;
+
+	// With the benchmark set, a cache miss of an adaptive grid also logs vertex count
+	// against interpolation error for it and for uniform grids.
+	bool mBenchmarkAdaptiveGrid = false;
+#if defined(DEBUG) || defined(_DEBUG)
+	bool mReportOccluderError = true;
+#else
+	bool mReportOccluderError = false;
+#endif
+
+	// The 2D textures in scene order, padded to the 10 the table declares.
+	SrvRange mTextureSrvs;
+	// The sky cube map, the depth map and the texture space visibility4 buffer, the table
+	// the sky is bound with.
+	SrvRange mSkySrvs;
+	SrvRange mAccelerationStructureSrv;
+	UavRange mScreenSpaceIntermediateSHCoeffsUavs;
+	UavRange mScreenSpaceThisFrameSHCoeffsUavs;
+	UavRange mScreenSpaceLastFrameSHCoeffsUavs;
+	UavRange mFilteredHorzSHCoeffsUavs;
+	UavRange mFilteredVertSHCoeffsUavs;
+	UavRange mGBufferUavs;
+	UavRange mTextureSpaceVisibility4Uav;
+
+	// This frame's descriptor table of the ray generation shader, gathered by
+	// UpdateShaderBindingTables in the order CreateRayGenSignature declares.
+	D3D12_GPU_DESCRIPTOR_HANDLE mRayGenTable = {};
 
 	PassConstants mMainPassCB;
 
@@ -293,11 +541,25 @@ private:
 	/// Create the acceleration structure of an instance
 	///
 	/// \param     vVertexBuffers : pair of buffer and vertex count
+	/// \param     vertexStride, vertexFormat : layout of the position in each vertex
+	/// \param     transformBuffer : optional 3x4 transform applied to the positions,
+	///                               used to dequantize packed vertices
+	/// \param     startIndex : first index used in every index buffer, to build from a LOD
 	/// \return    AccelerationStructureBuffers for TLAS
 	AccelerationStructureBuffers CreateBottomLevelAS(
 		std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers,
 		std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vIndexBuffers =
-		{});
+		{},
+		UINT vertexStride = sizeof(Vertex),
+		DXGI_FORMAT vertexFormat = DXGI_FORMAT_R32G32B32_FLOAT,
+		ID3D12Resource* transformBuffer = nullptr,
+		UINT64 transformOffset = 0,
+		UINT startIndex = 0);
+
+	// Dequantization transforms of the packed BLAS geometries, read during the build.
+	ComPtr<ID3D12Resource> m_blasTransforms;
+	// Scratch of the BLAS builds, released once initialization has run.
+	std::vector<ComPtr<ID3D12Resource>> mBuildScratch;
 
 	/// Create the main acceleration structure that holds
 	/// all instances of the scene
@@ -305,6 +567,7 @@ private:
 	// #DXR Extra - Refitting
 	/// \param     updateOnly: if true, perform a refit instead of a full build
 	void CreateTopLevelAS(
+		ID3D12GraphicsCommandList4* cmdList,
 		const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>
 		& instances,
 		bool updateOnly = false);
@@ -319,6 +582,7 @@ private:
 
 	ComPtr<IDxcBlob> m_rayGenLibrary;
 	ComPtr<IDxcBlob> m_textureSpaceRayGenLibrary;
+	ComPtr<IDxcBlob> m_probeRayGenLibrary;
 	ComPtr<IDxcBlob> m_hitLibrary;
 	ComPtr<IDxcBlob> m_missLibrary;
 
@@ -332,11 +596,10 @@ private:
 	// to use in the Shader Binding Table
 	ComPtr<ID3D12StateObjectProperties> m_rtStateObjectProps;
 
-	void CreateShaderBindingTable(int diffuseRTIndex);
+	UploadAllocator::Allocation CreateShaderBindingTable(int diffuseRTIndex);
 	nv_helpers_dx12::ShaderBindingTableGenerator m_sbtHelper;
-	ComPtr<ID3D12Resource> m_sbtStorage;
 
-	void CalcVisibilityTerm();
+	void CalcVisibilityTerm(ID3D12GraphicsCommandList4* cmdList);
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
@@ -350,7 +613,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	try
 	{
 		NormalMapApp theApp(hInstance);
-		if (!theApp.Initialize())
+		if (!theApp.ParseCommandLine(cmdLine) || !theApp.Initialize())
 			return 0;
 
 		return theApp.Run();
@@ -360,6 +623,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 		MessageBox(nullptr, e.ToString().c_str(), L"HR Failed", MB_OK);
 		return 0;
 	}
+	catch (std::exception& e)
+	{
+		MessageBoxA(nullptr, e.what(), "Error", MB_OK);
+		return 0;
+	}
 }
 
 NormalMapApp::NormalMapApp(HINSTANCE hInstance)
@@ -372,13 +640,123 @@ NormalMapApp::~NormalMapApp()
 {
 	if (md3dDevice != nullptr)
 		FlushCommandQueue();
+
+	if (mInputRecording != nullptr)
+	{
+		const std::string msg = mInputRecording->Save(mRecordPath) ?
+			"Recorded " + std::to_string(mInputRecording->FrameCount()) + " frames of input to " + mRecordPath + "\n" :
+			"Could not write the input recording " + mRecordPath + "\n";
+		::OutputDebugStringA(msg.c_str());
+	}
+}
+
+bool NormalMapApp::ParseCommandLine(const std::string& cmdLine)
+{
+	// Words separated by spaces; quotes keep paths with spaces together.
+	std::vector<std::string> args;
+	std::string arg;
+	bool quoted = false;
+	bool inArg = false;
+	for (char c : cmdLine)
+	{
+		if (c == '"')
+		{
+			quoted = !quoted;
+			inArg = true;
+		}
+		else if ((c == ' ' || c == '\t') && !quoted)
+		{
+			if (inArg)
+				args.push_back(arg);
+			arg.clear();
+			inArg = false;
+		}
+		else
+		{
+			arg += c;
+			inArg = true;
+		}
+	}
+	if (inArg)
+		args.push_back(arg);
+
+	std::string space;
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		std::string* value = nullptr;
+		if (args[i] == "-record")
+			value = &mRecordPath;
+		else if (args[i] == "-replay")
+			value = &mReplayPath;
+		else if (args[i] == "-timings")
+			value = &mTimingsPath;
+		else if (args[i] == "-space")
+			value = &space;
+
+		if (value == nullptr || i + 1 == args.size())
+		{
+			const std::string msg = "Unknown or incomplete argument " + args[i] +
+				"; expected -record <file>, -replay <file>, -timings <file> or -space <space>\n";
+			::OutputDebugStringA(msg.c_str());
+			return false;
+		}
+		*value = args[++i];
+	}
+
+	if (space == "world")
+		mProjLTSpace = Space::WorldSpace;
+	else if (space == "screen")
+		mProjLTSpace = Space::ScreenSpace;
+	else if (space == "texture")
+		mProjLTSpace = Space::TextureSpace;
+	else if (space == "probes")
+		mProjLTSpace = Space::ProbeVolume;
+	else if (!space.empty())
+	{
+		const std::string msg = "Unknown space " + space + "; expected world, screen, texture or probes\n";
+		::OutputDebugStringA(msg.c_str());
+		return false;
+	}
+
+	if (!mRecordPath.empty() && !mReplayPath.empty())
+	{
+		::OutputDebugStringA("-record and -replay cannot be used together\n");
+		return false;
+	}
+	if (!mReplayPath.empty() && mTimingsPath.empty())
+		mTimingsPath = mReplayPath + ".timings.csv";
+	return true;
 }
 
 bool NormalMapApp::Initialize()
 {
+	mStartTime = std::chrono::high_resolution_clock::now();
+
 	if (!D3DApp::Initialize())
 		return false;
 
+	if (!mReplayPath.empty())
+	{
+		mInputRecording = std::make_unique<InputRecording>();
+		std::string error;
+		if (!mInputRecording->Load(mReplayPath, &error))
+		{
+			const std::string msg = "Cannot replay " + mReplayPath + ": " + error + "\n";
+			::OutputDebugStringA(msg.c_str());
+			return false;
+		}
+		mInputReplayer = std::make_unique<InputReplayer>(*mInputRecording);
+		mTimer.SetFixedStep(mInputRecording->FixedStep());
+		// The replay is timed, and would otherwise stop while another window has focus.
+		mRunWhenInactive = true;
+	}
+	else if (!mRecordPath.empty())
+	{
+		// A fresh seed, kept with the input so the replay samples the same way.
+		mInputRecording = std::make_unique<InputRecording>(1.0f / 60.0f, std::random_device()());
+		mTimer.SetFixedStep(mInputRecording->FixedStep());
+	}
+
 	// Reset the command list to prep for initialization commands.
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
@@ -386,7 +764,6 @@ bool NormalMapApp::Initialize()
 
 	// Get the increment size of a descriptor in this heap type.  This is hardware specific, 
 	// so we have to query this information.
-	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
 	mCamera.SetPosition(7.5f, 4.5f, 1.0f);
 	mCamera.Pitch(XMConvertToRadians(25.0f));
@@ -394,20 +771,33 @@ bool NormalMapApp::Initialize()
 
 	mDepthMap = std::make_unique<ShadowMap>(md3dDevice.Get(), mClientWidth, mClientHeight);
 
-	LoadTextures();
+	mJobs = std::make_unique<JobSystem>();
+	mPassDevice = std::make_unique<D3D12PassRecordingDevice>(md3dDevice.Get(), mCommandQueue.Get());
+	mPassRecorder = std::make_unique<PassRecorder>(*mPassDevice, *mJobs);
+	mProfiler = std::make_unique<Profiler>();
+	mGpuTimer = std::make_unique<D3D12GpuTimer>(md3dDevice.Get(), mCommandQueue.Get(), 16);
+	mPassRecorder->SetProfiler(mProfiler.get());
+	mPassDevice->SetTimer(mGpuTimer.get());
+	mUploadDevice = std::make_unique<D3D12UploadMemoryDevice>(md3dDevice.Get());
+	mUploads = std::make_unique<UploadAllocator>(*mUploadDevice, 1 << 20);
+	mResourceHeaps = std::make_unique<D3D12ResourceHeaps>(md3dDevice.Get(), 64 << 20);
+	mShaderCache = std::make_unique<ShaderCache>("Cache/Shaders");
+
+	LoadScene();
 	BuildRootSignature();
 	BuildShadersAndInputLayout();
-	BuildShapeGeometry();
+	BuildMaterials();
+	BuildRenderItems();
 	BuildRandomStateBuffer();
 	BuildSHCoeffsBuffer();
 	BuildVisibilityTermBuffer();
+	BuildProbeVolume();
 	BuildGBuffer();
-	BuildMaterials();
-	BuildRenderItems();
 	BuildFrameResources();
 	BuildAccelerationStructure();
 	BuildDescriptorHeaps();
 	BuildPSOs();
+	BuildDrawIndirectSignature();
 	CreateRaytracingPipeline();
 
 	// Execute the initialization commands.
@@ -421,6 +811,16 @@ bool NormalMapApp::Initialize()
 	copySource->Release();
 	uploader->Release();
 
+	// The BLAS builds are done; their scratch goes back to the heaps with the first frame.
+	for (const auto& scratch : mBuildScratch)
+		mResourceHeaps->Release(scratch.Get());
+	mBuildScratch.clear();
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::string msg = "Initialize: " +
+		std::to_string(std::chrono::duration<double, std::milli>(endTime - mStartTime).count()) + " ms\n";
+	::OutputDebugStringA(msg.c_str());
+
 	return true;
 }
 
@@ -433,7 +833,26 @@ void NormalMapApp::OnResize()
 
 void NormalMapApp::Update(const GameTimer& gt)
 {
-	OnKeyboardInput(gt);
+	const auto frameStart = std::chrono::high_resolution_clock::now();
+	mFrameTiming = FrameTimingLog::Timing();
+	if (mFrameStarted)
+		mFrameTiming.FrameMs = std::chrono::duration<double, std::milli>(frameStart - mFrameStart).count();
+	mFrameStart = frameStart;
+	mFrameStarted = true;
+
+	mProfiler->BeginFrame();
+
+	// Draw quits after the last frame of a replay, so there always is a next one here.
+	InputFrame input;
+	if (mInputReplayer != nullptr)
+		mInputReplayer->Next(&input);
+	else
+	{
+		input = PollInput();
+		if (mInputRecording != nullptr)
+			mInputRecording->Add(input);
+	}
+	ApplyInput(input, gt);
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = 0;
@@ -443,308 +862,398 @@ void NormalMapApp::Update(const GameTimer& gt)
 	// If not, wait until the GPU has completed commands up to this fence point.
 	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
 	{
+		Profiler::Scope scope(*mProfiler, "Wait for GPU");
+		const auto waitStart = std::chrono::high_resolution_clock::now();
 		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
 		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
 		WaitForSingleObject(eventHandle, INFINITE);
 		CloseHandle(eventHandle);
+		mFrameTiming.WaitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+	}
+
+	// Frees the upload memory and descriptor tables of the frames the GPU has finished.
+	mUploads->BeginFrame(mFence->GetCompletedValue());
+	mDescriptors->BeginFrame(mFence->GetCompletedValue());
+	mResourceHeaps->BeginFrame(mFence->GetCompletedValue());
+	mGpuTimer->Collect(mFence->GetCompletedValue(), *mProfiler);
+
+	// Matrices of the items moved since the last frame, read by everything below.
+	{
+		Profiler::Scope scope(*mProfiler, "Transforms");
+		mTransforms.Update(mJobs.get());
 	}
 
-	UpdateMaterialBuffer(gt);
-	UpdateMainPassCB(gt);
-	UpdateObjectCBs(gt);
+	// The GPU is idle here, so the texture views can be rewritten, and copied to the
+	// shader-visible heap with whatever else was written.
+	{
+		Profiler::Scope scope(*mProfiler, "Texture streaming");
+		UpdateTextureStreaming();
+		mDescriptors->CopyDirty();
+	}
+	{
+		Profiler::Scope scope(*mProfiler, "Constants");
+		UpdateMaterialBuffer(gt);
+		UpdateMainPassCB(gt);
+		UpdateObjectCBs(gt);
+		// Before the shader tables: the probe ray generation record points at them.
+		if (mProbeVolume != nullptr)
+			mProbeCBAddress = mUploads->Push(mProbeVolume->MakeConstants(mProbeFrame++)).GpuAddress;
+		UpdateShaderBindingTables();
+	}
+	{
+		Profiler::Scope scope(*mProfiler, "Meshlet culling");
+		UpdateMeshletCulling(gt);
+	}
 
 	// Update object's world matrix for refitting the BVH.
 	for (int i = 0; i < m_instances.size(); ++i)
-		m_instances[i].second = mRitemLayer[(int)RenderLayer::BVH][i]->WorldMat;
+		m_instances[i].second = XMLoadFloat4x4(&mTransforms.World(mRitemLayer[(int)RenderLayer::BVH][i]->TransformId));
+
+	mFrameTiming.UpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
 }
 
 void NormalMapApp::Draw(const GameTimer& gt)
 {
+	const auto drawStart = std::chrono::high_resolution_clock::now();
 
-	auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
-
-	// Reuse the memory associated with command recording.
-	// We can only reset when the associated command lists have finished execution on the GPU.
-	ThrowIfFailed(cmdListAlloc->Reset());
+	// Update waited for the frame fence, so the lists and allocators of the last frame are
+	// free again.  The passes below are recorded in parallel, each into a list of its own,
+	// and go to the queue in the order they are added; whatever a pass reads from the
+	// app must not be changed until Execute returns.
+	const bool projectEnvironment = mProjectEnvironment;
+	mProjectEnvironment = false;
 
-	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
-	// Reusing the command list reuses memory.
-	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
-
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
+	mPassRecorder->AddPass("depth", [this, projectEnvironment](std::uint32_t list)
+	{
+		ID3D12GraphicsCommandList5* cmdList = mPassDevice->List(list);
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+		// Indicate a state transition on the resource usage.
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+			D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
 
-	// Clear the back buffer and depth buffer.
-	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
-	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+		// Clear the back buffer and depth buffer.
+		cmdList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
+		cmdList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+		BindPassState(cmdList);
 
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-	mCommandList->SetGraphicsRootUnorderedAccessView(5, mEnvCoeffs->GetGPUVirtualAddress());
-	mCommandList->SetGraphicsRootUnorderedAccessView(6, mTemporalObjCoeffs->GetGPUVirtualAddress());
-	mCommandList->SetGraphicsRootUnorderedAccessView(7, mVisibilityBuffer->GetGPUVirtualAddress());
-	mCommandList->SetGraphicsRootUnorderedAccessView(8, mRandomStateBuffer->GetGPUVirtualAddress());
-	mCommandList->SetGraphicsRootUnorderedAccessView(9, mThisFrameObjCoeffs->GetGPUVirtualAddress());
+		// Draw depth map.
+		DrawSceneToDepthMap(cmdList);
 
-	// Draw depth map.
-	DrawSceneToDepthMap();
+		// precompute environment light
+		if (projectEnvironment)
+		{
+			cmdList->SetPipelineState(mPSOs.at("proj_env").Get());
+			cmdList->IASetVertexBuffers(0, 0, nullptr);
+			cmdList->IASetIndexBuffer(nullptr);
+			cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
+			cmdList->DrawInstanced(1, 1, 0, 0);
+		}
+	});
 
-	// Bind the sky cube map.  For our demos, we just use one "world" cube map representing the environment
-	// from far away, so all objects will use the same cube map and we only need to set it once per-frame.  
-	// If we wanted to use "local" cube maps, we would have to change them per-object, or dynamically
-	// index into an array of cube maps.
+	if (mProjLTSpace == Space::ScreenSpace)
+	{
+		mPassRecorder->AddPass("gbuffer", [this](std::uint32_t list)
+		{
+			ID3D12GraphicsCommandList5* cmdList = mPassDevice->List(list);
+			BindPassState(cmdList);
 
-	CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(mDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	skyTexDescriptor.Offset(mSkyTexHeapIndex, mCbvSrvDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(3, skyTexDescriptor);
-
-	static std::once_flag flag;
-	// precompute environment light
-	std::call_once(flag,
-		[&]() {
-			mCommandList->SetPipelineState(mPSOs["proj_env"].Get());
-			mCommandList->IASetVertexBuffers(0, 0, nullptr);
-			mCommandList->IASetIndexBuffer(nullptr);
-			mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
-			mCommandList->DrawInstanced(1, 1, 0, 0);
-			mCommandList->SetPipelineState(mPSOs["opaque"].Get());
+			cmdList->SetPipelineState(mPSOs.at("writeGBuffer").Get());
+			DrawRenderItemsCulled(cmdList, mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
 		});
+	}
 
-	// Specify the buffers we are going to render to.
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+	mPassRecorder->AddPass("rays", [this](std::uint32_t list)
+	{
+		ID3D12GraphicsCommandList5* cmdList = mPassDevice->List(list);
+		BindPassState(cmdList);
 
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+		// Sample visibility.
+		CalcVisibilityTerm(cmdList);
+	});
 
-	// Bind all the materials used in this scene.  For structured buffers, we can bypass the heap and 
-	// set as a root descriptor.
-	auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-	mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
+	mPassRecorder->AddPass("filter", [this](std::uint32_t list)
+	{
+		ID3D12GraphicsCommandList5* cmdList = mPassDevice->List(list);
+		BindPassState(cmdList);
 
-	// Bind all the textures used in this scene.  Observe
-	// that we only have to specify the first descriptor in the table.  
-	// The root signature knows how many descriptors are expected in the table.
-	mCommandList->SetGraphicsRootDescriptorTable(4, mDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+		if (mProjLTSpace == Space::WorldSpace)
+		{
+			cmdList->SetPipelineState(mPSOs.at("projLT").Get());
+			DrawRenderItemsInstanced(cmdList, mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
 
-	CD3DX12_GPU_DESCRIPTOR_HANDLE screenSHCoeffsDescriptor(mDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	screenSHCoeffsDescriptor.Offset(mScreenSpaceIntermediateSHCoeffsHeapIndex, mCbvSrvDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(10, screenSHCoeffsDescriptor);
+			cmdList->SetPipelineState(mPSOs.at("reconstruct").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
 
-	mCommandList->SetGraphicsRootDescriptorTable(11, CD3DX12_GPU_DESCRIPTOR_HANDLE(
-		mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mScreenSpaceThisFrameSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize));
+			cmdList->SetPipelineState(mPSOs.at("filter_horz_world").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
 
-	mCommandList->SetGraphicsRootDescriptorTable(12, CD3DX12_GPU_DESCRIPTOR_HANDLE(
-		mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mScreenSpaceLastFrameSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize));
+			cmdList->SetPipelineState(mPSOs.at("filter_vert_world").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
 
-	mCommandList->SetGraphicsRootDescriptorTable(13, CD3DX12_GPU_DESCRIPTOR_HANDLE(
-		mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mFilteredHorzSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize));
+			ClearFrameTargets(cmdList);
+		}
 
-	mCommandList->SetGraphicsRootDescriptorTable(14, CD3DX12_GPU_DESCRIPTOR_HANDLE(
-		mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mGBufferHeapIndex, mCbvSrvUavDescriptorSize));
+		else if (mProjLTSpace == Space::TextureSpace)
+		{
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mTextureSpaceVisibilityBuffer.Get(),
+				D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_GENERIC_READ));
 
-	mCommandList->SetGraphicsRootDescriptorTable(15, CD3DX12_GPU_DESCRIPTOR_HANDLE(
-		mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mFilteredVertSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize));
+			cmdList->SetPipelineState(mPSOs.at("projLTTextureSpace").Get());
+			DrawRenderItemsInstanced(cmdList, mRitemLayer[(int)RenderLayer::DiffuseRT]);
 
-	if (mProjLTSpace == Space::WorldSpace)
-	{
-		// Sample visibility.
-		CalcVisibilityTerm();
+			cmdList->SetPipelineState(mPSOs.at("reconstruct").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::DiffuseRT]);
 
-		mCommandList->SetPipelineState(mPSOs["projLT"].Get());
-		DrawRenderItemsInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
+			cmdList->SetPipelineState(mPSOs.at("filter_horz_world").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
 
-		mCommandList->SetPipelineState(mPSOs["reconstruct"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
+			cmdList->SetPipelineState(mPSOs.at("filter_vert_world").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
 
-		mCommandList->SetPipelineState(mPSOs["filter_horz_world"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+			ClearFrameTargets(cmdList);
 
-		mCommandList->SetPipelineState(mPSOs["filter_vert_world"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mTextureSpaceVisibilityBuffer.Get(),
+				D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 
-		// zero out buffer
-		static constexpr FLOAT clearValues[4] = { 0, 0, 0, 0 };
-		mCommandList->ClearUnorderedAccessViewFloat(
-			CD3DX12_GPU_DESCRIPTOR_HANDLE(
-				mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mScreenSpaceThisFrameSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize),
-			CD3DX12_CPU_DESCRIPTOR_HANDLE(
-				mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mThisFrameClearHeapIndex, mCbvSrvUavDescriptorSize),
-			mThisFrameScreenSpaceSHCoeffsBuffer[0].Get(), clearValues, 0, nullptr);
+			cmdList->SetPipelineState(mPSOs.at("opaque").Get());
+			DrawRenderItemsCulled(cmdList, mRitemLayer[(int)RenderLayer::Opaque]);
+		}
 
-		mCommandList->ClearUnorderedAccessViewFloat(
-			CD3DX12_GPU_DESCRIPTOR_HANDLE(
-				mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mFilteredHorzSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize),
-			CD3DX12_CPU_DESCRIPTOR_HANDLE(
-				mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mFilteredHorzClearHeapIndex, mCbvSrvUavDescriptorSize),
-			mFilteredHorzSHCoeffsBuffer[0].Get(), clearValues, 0, nullptr);
+		else if (mProjLTSpace == Space::ProbeVolume)
+		{
+			// Blend the rays traced this frame into their probes, then light the receivers
+			// from all of them.
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(mProbeRays.Get()));
+			cmdList->SetPipelineState(mPSOs.at("probeUpdate").Get());
+			cmdList->IASetVertexBuffers(0, 0, nullptr);
+			cmdList->IASetIndexBuffer(nullptr);
+			cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
+			cmdList->DrawInstanced(mProbeVolume->ProbesPerFrame(), 1, 0, 0);
+
+			D3D12_RESOURCE_BARRIER probeBarriers[] =
+			{
+				CD3DX12_RESOURCE_BARRIER::UAV(mProbeRadiance.Get()),
+				CD3DX12_RESOURCE_BARRIER::UAV(mProbeDepth.Get())
+			};
+			cmdList->ResourceBarrier(_countof(probeBarriers), probeBarriers);
+			cmdList->SetPipelineState(mPSOs.at("probeShade").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
+		}
 
-		for (int i = 0; i < 2; ++i)
+		else if (mProjLTSpace == Space::ScreenSpace)
 		{
-			mCommandList->ClearUnorderedAccessViewFloat(
-				CD3DX12_GPU_DESCRIPTOR_HANDLE(
-					mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mGBufferHeapIndex + i, mCbvSrvUavDescriptorSize),
-				CD3DX12_CPU_DESCRIPTOR_HANDLE(
-					mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mGBufferClearHeapIndex + i, mCbvSrvUavDescriptorSize),
-				mGBuffer[i].Get(), clearValues, 0, nullptr);
+			cmdList->SetPipelineState(mPSOs.at("screenSpaceProjLT").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
+
+			//cmdList->SetPipelineState(mPSOs.at("outlier_removal").Get());
+			//DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
+
+			cmdList->SetPipelineState(mPSOs.at("filter_horz").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
+
+			cmdList->SetPipelineState(mPSOs.at("filter_vert").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
+
+			cmdList->SetPipelineState(mPSOs.at("temporal_filter").Get());
+			DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Filter]);
+
+			// Copy color
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mIntermediateScreenSpaceSHCoeffsBuffer[0].Get(),
+				D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mLastFrameScreenSpaceSHCoeffsBuffer[0].Get(),
+				D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
+			cmdList->CopyResource(mLastFrameScreenSpaceSHCoeffsBuffer[0].Get(), mIntermediateScreenSpaceSHCoeffsBuffer[0].Get());
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mLastFrameScreenSpaceSHCoeffsBuffer[0].Get(),
+				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mIntermediateScreenSpaceSHCoeffsBuffer[0].Get(),
+				D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+			ClearFrameTargets(cmdList);
 		}
-	}
+	});
 
-	else if (mProjLTSpace == Space::TextureSpace)
+	mPassRecorder->AddPass("sky", [this](std::uint32_t list)
 	{
-		// Sample visibility.
-		CalcVisibilityTerm();
+		ID3D12GraphicsCommandList5* cmdList = mPassDevice->List(list);
+		BindPassState(cmdList);
 
-		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mTextureSpaceVisibilityBuffer.Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_GENERIC_READ));
+		cmdList->SetPipelineState(mPSOs.at("sky").Get());
+		DrawRenderItemsIndexedInstanced(cmdList, mRitemLayer[(int)RenderLayer::Sky]);
 
-		mCommandList->SetPipelineState(mPSOs["projLTTextureSpace"].Get());
-		DrawRenderItemsInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::DiffuseRT]);
+		// Indicate a state transition on the resource usage.
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	});
 
-		mCommandList->SetPipelineState(mPSOs["reconstruct"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::DiffuseRT]);
+	// Records the passes and adds their lists to the queue for execution.
+	mPassRecorder->Execute();
 
-		mCommandList->SetPipelineState(mPSOs["filter_horz_world"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+	// Swap the back and front buffers
+	{
+		Profiler::Scope scope(*mProfiler, "Present");
+		ThrowIfFailed(mSwapChain->Present(0, 0));
+	}
+	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
-		mCommandList->SetPipelineState(mPSOs["filter_vert_world"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+	// Advance the fence value to mark commands up to this fence point.
+	mCurrFrameResource->Fence = ++mCurrentFence;
 
-		// zero out buffer
-		static constexpr FLOAT clearValues[4] = { 0, 0, 0, 0 };
-		mCommandList->ClearUnorderedAccessViewFloat(
-			CD3DX12_GPU_DESCRIPTOR_HANDLE(
-				mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mScreenSpaceThisFrameSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize),
-			CD3DX12_CPU_DESCRIPTOR_HANDLE(
-				mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mThisFrameClearHeapIndex, mCbvSrvUavDescriptorSize),
-			mThisFrameScreenSpaceSHCoeffsBuffer[0].Get(), clearValues, 0, nullptr);
+	// Add an instruction to the command queue to set a new fence point. 
+	// Because we are on the GPU timeline, the new fence point won't be 
+	// set until the GPU finishes processing all the commands prior to this Signal().
+	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+	mUploads->EndFrame(mCurrentFence);
+	mDescriptors->EndFrame(mCurrentFence);
+	mResourceHeaps->EndFrame(mCurrentFence);
+	mGpuTimer->EndFrame(mCurrentFence, mPassRecorder->GetStats().PassNames);
 
-		mCommandList->ClearUnorderedAccessViewFloat(
-			CD3DX12_GPU_DESCRIPTOR_HANDLE(
-				mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mFilteredHorzSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize),
-			CD3DX12_CPU_DESCRIPTOR_HANDLE(
-				mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mFilteredHorzClearHeapIndex, mCbvSrvUavDescriptorSize),
-			mFilteredHorzSHCoeffsBuffer[0].Get(), clearValues, 0, nullptr);
+	mProfiler->EndFrame();
+	if (mProfiler->CaptureReady())
+	{
+		mProfiler->SaveChromeTrace("profile.json");
 
-		for (int i = 0; i < 2; ++i)
+		char line[128];
+		::OutputDebugStringA("Profile capture written to profile.json\n");
+		for (const Profiler::SeriesStats& series : mProfiler->GetStats())
 		{
-			mCommandList->ClearUnorderedAccessViewFloat(
-				CD3DX12_GPU_DESCRIPTOR_HANDLE(
-					mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mGBufferHeapIndex + i, mCbvSrvUavDescriptorSize),
-				CD3DX12_CPU_DESCRIPTOR_HANDLE(
-					mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mGBufferClearHeapIndex + i, mCbvSrvUavDescriptorSize),
-				mGBuffer[i].Get(), clearValues, 0, nullptr);
+			snprintf(line, sizeof(line), "  %s %-20s mean %.3f ms, p95 %.3f ms, max %.3f ms\n",
+				series.Gpu ? "GPU" : "CPU", series.Name.c_str(), series.MeanMs, series.P95Ms, series.MaxMs);
+			::OutputDebugStringA(line);
 		}
+		mProfiler->StartCapture(0);
+	}
 
-		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mTextureSpaceVisibilityBuffer.Get(),
-			D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-
-		mCommandList->SetPipelineState(mPSOs["opaque"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+	mFrameTiming.DrawMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - drawStart).count();
+	if (mInputReplayer != nullptr)
+	{
+		mFrameTimings.Add(mFrameTiming);
+		if (mInputReplayer->Finished())
+			FinishReplay();
 	}
 
-	else if (mProjLTSpace == Space::ScreenSpace)
+	if (!mFirstFrameLogged)
 	{
-		mCommandList->SetPipelineState(mPSOs["writeGBuffer"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
+		mFirstFrameLogged = true;
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		std::string msg = "Time to first frame: " +
+			std::to_string(std::chrono::duration<double, std::milli>(endTime - mStartTime).count()) + " ms\n";
+		::OutputDebugStringA(msg.c_str());
+
+		const PassRecorder::Stats& stats = mPassRecorder->GetStats();
+		char line[128];
+		snprintf(line, sizeof(line), "Pass recording: %u lists in %.3f ms, submitted in %.3f ms\n",
+			stats.Passes, stats.RecordMilliseconds, stats.SubmitMilliseconds);
+		::OutputDebugStringA(line);
+		for (std::uint32_t i = 0; i < stats.Passes; ++i)
+		{
+			snprintf(line, sizeof(line), "  %-8s %.3f ms\n", stats.PassNames[i], stats.PassMilliseconds[i]);
+			::OutputDebugStringA(line);
+		}
 
-		// Sample visibility.
-		CalcVisibilityTerm();
+		const UploadAllocator::Stats& uploadStats = mUploads->GetStats();
+		snprintf(line, sizeof(line), "Upload ring: %llu KB this frame of %llu KB\n",
+			(unsigned long long)uploadStats.FrameBytes / 1024, (unsigned long long)uploadStats.Capacity / 1024);
+		::OutputDebugStringA(line);
 
-		mCommandList->SetPipelineState(mPSOs["screenSpaceProjLT"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+		const char* classNames[] = { "buffers", "textures", "targets" };
+		for (int i = 0; i < (int)GpuMemoryClass::Count; ++i)
+		{
+			const GpuMemoryAllocator::Stats heapStats = mResourceHeaps->GetStats((GpuMemoryClass)i);
+			snprintf(line, sizeof(line), "Heaps, %-8s %u MB in %u resources, %u heaps of %u MB, fragmentation %.2f\n",
+				classNames[i], (unsigned)(heapStats.AllocatedBytes >> 20), heapStats.Allocations, heapStats.Heaps,
+				(unsigned)(heapStats.HeapBytes >> 20), heapStats.Fragmentation);
+			::OutputDebugStringA(line);
+		}
+	}
+}
 
-		//mCommandList->SetPipelineState(mPSOs["outlier_removal"].Get());
-		//DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+void NormalMapApp::BindPassState(ID3D12GraphicsCommandList* cmdList)
+{
+	cmdList->RSSetViewports(1, &mScreenViewport);
+	cmdList->RSSetScissorRects(1, &mScissorRect);
 
-		mCommandList->SetPipelineState(mPSOs["filter_horz"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mDescriptors->ShaderVisibleHeap() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-		mCommandList->SetPipelineState(mPSOs["filter_vert"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+	cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+	cmdList->SetGraphicsRootUnorderedAccessView(5, mEnvCoeffs->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootUnorderedAccessView(6, mTemporalObjCoeffs->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootUnorderedAccessView(7, mVisibilityBuffer->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootUnorderedAccessView(8, mRandomStateBuffer->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootUnorderedAccessView(9, mThisFrameObjCoeffs->GetGPUVirtualAddress());
 
-		mCommandList->SetPipelineState(mPSOs["temporal_filter"].Get());
-		DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Filter]);
+	// Bind the sky cube map.  For our demos, we just use one "world" cube map representing the environment
+	// from far away, so all objects will use the same cube map and we only need to set it once per-frame.  
+	// If we wanted to use "local" cube maps, we would have to change them per-object, or dynamically
+	// index into an array of cube maps.
 
-		static constexpr FLOAT clearValues[4] = { 0, 0, 0, 0 };
+	cmdList->SetGraphicsRootDescriptorTable(3, mDescriptors->GpuHandle(mSkySrvs));
 
-		// Copy color
-		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mIntermediateScreenSpaceSHCoeffsBuffer[0].Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
-		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mLastFrameScreenSpaceSHCoeffsBuffer[0].Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
-		mCommandList->CopyResource(mLastFrameScreenSpaceSHCoeffsBuffer[0].Get(), mIntermediateScreenSpaceSHCoeffsBuffer[0].Get());
-			mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mLastFrameScreenSpaceSHCoeffsBuffer[0].Get(),
-		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mIntermediateScreenSpaceSHCoeffsBuffer[0].Get(),
-			D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+	// Specify the buffers we are going to render to.
+	D3D12_CPU_DESCRIPTOR_HANDLE backBufferView = CurrentBackBufferView();
+	D3D12_CPU_DESCRIPTOR_HANDLE depthStencilView = DepthStencilView();
+	cmdList->OMSetRenderTargets(1, &backBufferView, true, &depthStencilView);
 
-		// zero out buffer
-		for (int i = 0; i < 2; ++i) 
-		{
-			mCommandList->ClearUnorderedAccessViewFloat(
-				CD3DX12_GPU_DESCRIPTOR_HANDLE(
-					mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mScreenSpaceIntermediateSHCoeffsHeapIndex+i, mCbvSrvUavDescriptorSize),
-				CD3DX12_CPU_DESCRIPTOR_HANDLE(
-					mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mIntermediateClearHeapIndex+i, mCbvSrvUavDescriptorSize),
-				mIntermediateScreenSpaceSHCoeffsBuffer[i].Get(), clearValues, 0, nullptr);
-
-			mCommandList->ClearUnorderedAccessViewFloat(
-				CD3DX12_GPU_DESCRIPTOR_HANDLE(
-					mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mScreenSpaceThisFrameSHCoeffsHeapIndex+i, mCbvSrvUavDescriptorSize),
-				CD3DX12_CPU_DESCRIPTOR_HANDLE(
-					mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mThisFrameClearHeapIndex+i, mCbvSrvUavDescriptorSize),
-				mThisFrameScreenSpaceSHCoeffsBuffer[i].Get(), clearValues, 0, nullptr);
-		}
+	cmdList->SetGraphicsRootConstantBufferView(1, mPassCBAddress);
 
-		mCommandList->ClearUnorderedAccessViewFloat(
-			CD3DX12_GPU_DESCRIPTOR_HANDLE(
-				mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mFilteredHorzSHCoeffsHeapIndex, mCbvSrvUavDescriptorSize),
-			CD3DX12_CPU_DESCRIPTOR_HANDLE(
-				mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mFilteredHorzClearHeapIndex, mCbvSrvUavDescriptorSize),
-			mFilteredHorzSHCoeffsBuffer[0].Get(), clearValues, 0, nullptr);
+	// Bind all the materials used in this scene.  For structured buffers, we can bypass the heap and 
+	// set as a root descriptor.
+	cmdList->SetGraphicsRootShaderResourceView(2, mMaterialBufferAddress);
 
-		for (int i = 0; i < 2; ++i)
-		{
-			mCommandList->ClearUnorderedAccessViewFloat(
-				CD3DX12_GPU_DESCRIPTOR_HANDLE(
-					mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mGBufferHeapIndex + i, mCbvSrvUavDescriptorSize),
-				CD3DX12_CPU_DESCRIPTOR_HANDLE(
-					mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mGBufferClearHeapIndex + i, mCbvSrvUavDescriptorSize),
-				mGBuffer[i].Get(), clearValues, 0, nullptr);
-		}
-	}
+	// Transforms of every object for temporal reprojection, indexed by object id.
+	cmdList->SetGraphicsRootShaderResourceView(16, mCurrFrameResource->ObjectTransforms->Resource()->GetGPUVirtualAddress());
 
-	mCommandList->SetPipelineState(mPSOs["sky"].Get());
-	DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Sky]);
+	// Bind all the textures used in this scene.  Observe
+	// that we only have to specify the first descriptor in the table.  
+	// The root signature knows how many descriptors are expected in the table.
+	cmdList->SetGraphicsRootDescriptorTable(4, mDescriptors->GpuHandle(mTextureSrvs));
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	cmdList->SetGraphicsRootDescriptorTable(10, mDescriptors->GpuHandle(mScreenSpaceIntermediateSHCoeffsUavs));
+	cmdList->SetGraphicsRootDescriptorTable(11, mDescriptors->GpuHandle(mScreenSpaceThisFrameSHCoeffsUavs));
+	cmdList->SetGraphicsRootDescriptorTable(12, mDescriptors->GpuHandle(mScreenSpaceLastFrameSHCoeffsUavs));
+	cmdList->SetGraphicsRootDescriptorTable(13, mDescriptors->GpuHandle(mFilteredHorzSHCoeffsUavs));
+	cmdList->SetGraphicsRootDescriptorTable(14, mDescriptors->GpuHandle(mGBufferUavs));
+	cmdList->SetGraphicsRootDescriptorTable(15, mDescriptors->GpuHandle(mFilteredVertSHCoeffsUavs));
 
-	// Done recording commands.
-	ThrowIfFailed(mCommandList->Close());
+	if (mProbeVolume != nullptr)
+	{
+		cmdList->SetGraphicsRootConstantBufferView(17, mProbeCBAddress);
+		cmdList->SetGraphicsRootUnorderedAccessView(18, mProbeRays->GetGPUVirtualAddress());
+		cmdList->SetGraphicsRootUnorderedAccessView(19, mProbeRadiance->GetGPUVirtualAddress());
+		cmdList->SetGraphicsRootUnorderedAccessView(20, mProbeDepth->GetGPUVirtualAddress());
+	}
 
-	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	cmdList->SetPipelineState(mPSOs.at("opaque").Get());
+}
 
-	// Swap the back and front buffers
-	ThrowIfFailed(mSwapChain->Present(0, 0));
-	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
+void NormalMapApp::ClearUav(ID3D12GraphicsCommandList* cmdList, const UavRange& uav, ID3D12Resource* resource)
+{
+	// The clear wants the view twice: in the bound heap, and in a CPU-only one.
+	static constexpr FLOAT clearValues[4] = { 0, 0, 0, 0 };
+	cmdList->ClearUnorderedAccessViewFloat(mDescriptors->GpuHandle(uav), mDescriptors->StagingHandle(uav),
+		resource, clearValues, 0, nullptr);
+}
 
-	// Advance the fence value to mark commands up to this fence point.
-	mCurrFrameResource->Fence = ++mCurrentFence;
+void NormalMapApp::ClearFrameTargets(ID3D12GraphicsCommandList* cmdList)
+{
+	// zero out buffer
+	if (mProjLTSpace == Space::ScreenSpace)
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			ClearUav(cmdList, mScreenSpaceIntermediateSHCoeffsUavs.Sub(i), mIntermediateScreenSpaceSHCoeffsBuffer[i].Get());
+			ClearUav(cmdList, mScreenSpaceThisFrameSHCoeffsUavs.Sub(i), mThisFrameScreenSpaceSHCoeffsBuffer[i].Get());
+		}
+	}
+	else
+		ClearUav(cmdList, mScreenSpaceThisFrameSHCoeffsUavs, mThisFrameScreenSpaceSHCoeffsBuffer[0].Get());
 
-	// Add an instruction to the command queue to set a new fence point. 
-	// Because we are on the GPU timeline, the new fence point won't be 
-	// set until the GPU finishes processing all the commands prior to this Signal().
-	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+	ClearUav(cmdList, mFilteredHorzSHCoeffsUavs, mFilteredHorzSHCoeffsBuffer[0].Get());
+
+	for (int i = 0; i < 2; ++i)
+		ClearUav(cmdList, mGBufferUavs.Sub(i), mGBuffer[i].Get());
 }
 
 void NormalMapApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -762,97 +1271,275 @@ void NormalMapApp::OnMouseUp(WPARAM btnState, int x, int y)
 
 void NormalMapApp::OnMouseMove(WPARAM btnState, int x, int y)
 {
+	// Turns the camera in the next Update, so the drag can be recorded with the frame.
 	if ((btnState & MK_LBUTTON) != 0)
 	{
-		// Make each pixel correspond to a quarter of a degree.
-		float dx = XMConvertToRadians(0.25f * static_cast<float>(x - mLastMousePos.x));
-		float dy = XMConvertToRadians(0.25f * static_cast<float>(y - mLastMousePos.y));
-
-		mCamera.Pitch(dy);
-		mCamera.RotateY(dx);
+		mMouseDx += x - mLastMousePos.x;
+		mMouseDy += y - mLastMousePos.y;
 	}
 
 	mLastMousePos.x = x;
 	mLastMousePos.y = y;
 }
 
-void NormalMapApp::OnKeyboardInput(const GameTimer& gt)
+InputFrame NormalMapApp::PollInput()
+{
+	InputFrame input;
+	input.SetDown(InputKey::W, (GetAsyncKeyState('W') & 0x8000) != 0);
+	input.SetDown(InputKey::A, (GetAsyncKeyState('A') & 0x8000) != 0);
+	input.SetDown(InputKey::S, (GetAsyncKeyState('S') & 0x8000) != 0);
+	input.SetDown(InputKey::D, (GetAsyncKeyState('D') & 0x8000) != 0);
+	input.SetDown(InputKey::Up, GetAsyncKeyState(VK_UP) != 0);
+	input.SetDown(InputKey::Down, GetAsyncKeyState(VK_DOWN) != 0);
+	input.SetDown(InputKey::Left, GetAsyncKeyState(VK_LEFT) != 0);
+	input.SetDown(InputKey::Right, GetAsyncKeyState(VK_RIGHT) != 0);
+	input.SetDown(InputKey::I, (GetAsyncKeyState('I') & 0x8000) != 0);
+	input.SetDown(InputKey::J, (GetAsyncKeyState('J') & 0x8000) != 0);
+	input.SetDown(InputKey::K, (GetAsyncKeyState('K') & 0x8000) != 0);
+	input.SetDown(InputKey::L, (GetAsyncKeyState('L') & 0x8000) != 0);
+	input.SetDown(InputKey::Capture, (GetAsyncKeyState('P') & 0x8000) != 0);
+
+	input.MouseDx = mMouseDx;
+	input.MouseDy = mMouseDy;
+	mMouseDx = 0;
+	mMouseDy = 0;
+	return input;
+}
+
+void NormalMapApp::ApplyInput(const InputFrame& input, const GameTimer& gt)
 {
 	const float dt = gt.DeltaTime();
 
-	if (GetAsyncKeyState('W') & 0x8000)
+	if (input.MouseDx != 0 || input.MouseDy != 0)
+	{
+		// Make each pixel correspond to a quarter of a degree.
+		float dx = XMConvertToRadians(0.25f * static_cast<float>(input.MouseDx));
+		float dy = XMConvertToRadians(0.25f * static_cast<float>(input.MouseDy));
+
+		mCamera.Pitch(dy);
+		mCamera.RotateY(dx);
+	}
+
+	if (input.IsDown(InputKey::W))
 		mCamera.Walk(10.0f * dt);
 
-	if (GetAsyncKeyState('S') & 0x8000)
+	if (input.IsDown(InputKey::S))
 		mCamera.Walk(-10.0f * dt);
 
-	if (GetAsyncKeyState('A') & 0x8000)
+	if (input.IsDown(InputKey::A))
 		mCamera.Strafe(-10.0f * dt);
 
-	if (GetAsyncKeyState('D') & 0x8000)
+	if (input.IsDown(InputKey::D))
 		mCamera.Strafe(10.0f * dt);
 
 	mCamera.UpdateViewMatrix();
 
-	if (GetAsyncKeyState(VK_UP))
-		mGridRitem->walk(5.0f * dt);
+	// Captures the next 60 frames, once per press.
+	const bool captureKeyDown = input.IsDown(InputKey::Capture);
+	if (captureKeyDown && !mCaptureKeyDown && !mProfiler->IsCapturing())
+		mProfiler->StartCapture(60);
+	mCaptureKeyDown = captureKeyDown;
+
+	if (mArrowKeysRitem != nullptr)
+	{
+		if (input.IsDown(InputKey::Up))
+			MoveItem(mArrowKeysRitem, RenderItem::Front, 5.0f * dt);
+
+		if (input.IsDown(InputKey::Down))
+			MoveItem(mArrowKeysRitem, RenderItem::Front, -5.0f * dt);
 
-	if (GetAsyncKeyState(VK_DOWN))
-		mGridRitem->walk(-5.0f * dt);
+		if (input.IsDown(InputKey::Left))
+			MoveItem(mArrowKeysRitem, RenderItem::Right, -5.0f * dt);
 
-	if (GetAsyncKeyState(VK_LEFT))
-		mGridRitem->strafe(-5.0f * dt);
+		if (input.IsDown(InputKey::Right))
+			MoveItem(mArrowKeysRitem, RenderItem::Right, 5.0f * dt);
+	}
+
+	if (mIJKLKeysRitem != nullptr)
+	{
+		if (input.IsDown(InputKey::I))
+			MoveItem(mIJKLKeysRitem, RenderItem::Front, 5.0f * dt);
 
-	if (GetAsyncKeyState(VK_RIGHT))
-		mGridRitem->strafe(5.0f * dt);
+		if (input.IsDown(InputKey::K))
+			MoveItem(mIJKLKeysRitem, RenderItem::Front, -5.0f * dt);
 
-	if (GetAsyncKeyState('I') & 0x8000)
-		mBoxRitem->walk(5.0f * dt);
+		if (input.IsDown(InputKey::J))
+			MoveItem(mIJKLKeysRitem, RenderItem::Right, -5.0f * dt);
 
-	if (GetAsyncKeyState('K') & 0x8000)
-		mBoxRitem->walk(-5.0f * dt);
+		if (input.IsDown(InputKey::L))
+			MoveItem(mIJKLKeysRitem, RenderItem::Right, 5.0f * dt);
+	}
+}
 
-	if (GetAsyncKeyState('J') & 0x8000)
-		mBoxRitem->strafe(-5.0f * dt);
+void NormalMapApp::FinishReplay()
+{
+	const bool saved = mFrameTimings.SaveCsv(mTimingsPath);
+
+	// The first frames stream textures in and warm caches up, so they are left out.
+	const FrameTimingLog::Summary summary = mFrameTimings.Summarize((std::min)(mFrameTimings.FrameCount() / 10, 60u));
+	char line[256];
+	snprintf(line, sizeof(line), "Replayed %u frames of %s: mean %.3f ms, median %.3f ms, p95 %.3f ms, max %.3f ms over the last %u\n",
+		mFrameTimings.FrameCount(), mReplayPath.c_str(), summary.MeanFrameMs, summary.MedianFrameMs,
+		summary.P95FrameMs, summary.MaxFrameMs, summary.Frames);
+	::OutputDebugStringA(line);
+	const std::string msg = saved ? "Frame timings written to " + mTimingsPath + "\n" :
+		"Could not write the frame timings " + mTimingsPath + "\n";
+	::OutputDebugStringA(msg.c_str());
+
+	PostQuitMessage(0);
+}
 
-	if (GetAsyncKeyState('L') & 0x8000)
-		mBoxRitem->strafe(5.0f * dt);
+void NormalMapApp::MoveItem(RenderItem* ritem, const XMFLOAT3& direction, float d)
+{
+	mTransforms.Translate(ritem->TransformId, XMFLOAT3(direction.x * d, direction.y * d, direction.z * d));
 }
 
 void NormalMapApp::UpdateObjectCBs(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+	auto currObjectTransforms = mCurrFrameResource->ObjectTransforms.get();
 	for (auto& e : mAllRitems)
 	{
+		if (mTransforms.WasUpdated(e->TransformId))
+			e->NumFramesDirty = gNumFrameResources;
+
 		if (e->NumFramesDirty > 0)
 		{
-			XMMATRIX world = XMMatrixScaling(e->Scale.x, e->Scale.y, e->Scale.z) * XMMatrixTranslation(e->Position.x, e->Position.y, e->Position.z);
-			XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
 			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
 
 			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.LastFrameWorld, e->WorldMat);
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.InvWorld, XMMatrixTranspose(invWorld));
+			objConstants.LastFrameWorld = mTransforms.PrevWorld(e->TransformId);
+			objConstants.World = mTransforms.WorldTransposed(e->TransformId);
+			objConstants.InvWorld = mTransforms.InvWorldTransposed(e->TransformId);
 			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
 			objConstants.MaterialIndex = e->Mat->MatCBIndex;
 			objConstants.vertexOffset = e->vertexOffset;
 			objConstants.objId = e->ObjCBIndex;
+			if (e->Geo != nullptr && e->Geo->PackedVertices)
+			{
+				objConstants.PosDequantScale = XMFLOAT4(e->Geo->PositionScale.x, e->Geo->PositionScale.y, e->Geo->PositionScale.z, 0.0f);
+				objConstants.PosDequantBias = XMFLOAT4(e->Geo->PositionBias.x, e->Geo->PositionBias.y, e->Geo->PositionBias.z, 0.0f);
+			}
+
+			mObjectConstants[e->ObjCBIndex] = objConstants;
 
-			// Update Object's world matrix.
-			e->WorldMat = world;
+			ObjectTransform transform;
+			transform.InvWorld = mTransforms.InvWorldTransposed(e->TransformId);
+			transform.LastFrameWorld = mTransforms.PrevWorldTransposed(e->TransformId);
+			currObjectTransforms->CopyData(e->ObjCBIndex, transform);
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+			if (!mReprojectionChecked)
+				CheckReprojection(e.get(), transform);
 
 			// Next FrameResource need to be updated too.
 			e->NumFramesDirty--;
 		}
 	}
+
+	// Every object, in constant buffer slices, at the offsets the draws bind.
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	UploadAllocator::Allocation objectCB = mUploads->Allocate((UINT64)objCBByteSize * mObjectConstants.size());
+	for (size_t i = 0; i < mObjectConstants.size(); ++i)
+		memcpy(objectCB.CpuAddress + i * objCBByteSize, &mObjectConstants[i], sizeof(ObjectConstants));
+	mObjectCBAddress = objectCB.GpuAddress;
+}
+
+void NormalMapApp::CheckReprojection(const RenderItem* ri, const ObjectTransform& transform)
+{
+	XMMATRIX world = XMLoadFloat4x4(&mTransforms.World(ri->TransformId));
+	XMMATRIX lastFrameWorld = XMLoadFloat4x4(&mTransforms.PrevWorld(ri->TransformId));
+	if (XMVector4Equal(world.r[3], lastFrameWorld.r[3]) && XMVector4Equal(world.r[0], lastFrameWorld.r[0]) &&
+		XMVector4Equal(world.r[1], lastFrameWorld.r[1]) && XMVector4Equal(world.r[2], lastFrameWorld.r[2]))
+		return;
+	mReprojectionChecked = true;
+
+	// UpdateMainPassCB ran already, so this is the view-projection the filter will use.
+	XMFLOAT4X4 lastFrameViewProj;
+	XMStoreFloat4x4(&lastFrameViewProj, XMMatrixTranspose(XMLoadFloat4x4(&mMainPassCB.LastFrameViewProj)));
+
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	ri->Geo->DrawArgs[ri->GeoName].Bounds.GetCorners(corners);
+
+	float motion = 0.0f;
+	float error = 0.0f;
+	for (const XMFLOAT3& corner : corners)
+	{
+		XMFLOAT3 positionW;
+		XMFLOAT3 lastFramePositionW;
+		XMStoreFloat3(&positionW, XMVector3TransformCoord(XMLoadFloat3(&corner), world));
+		XMStoreFloat3(&lastFramePositionW, XMVector3TransformCoord(XMLoadFloat3(&corner), lastFrameWorld));
+
+		XMFLOAT2 expected = Reprojection::ProjectPixel(lastFramePositionW, lastFrameViewProj, mClientWidth, mClientHeight);
+		XMFLOAT2 reprojected = Reprojection::ReprojectPixel(positionW, transform.InvWorld, transform.LastFrameWorld,
+			mMainPassCB.LastFrameViewProj, mClientWidth, mClientHeight);
+		XMFLOAT2 current = Reprojection::ProjectPixel(positionW, lastFrameViewProj, mClientWidth, mClientHeight);
+
+		motion = (std::max)(motion, std::hypot(current.x - expected.x, current.y - expected.y));
+		error = (std::max)(error, std::hypot(reprojected.x - expected.x, reprojected.y - expected.y));
+	}
+
+	char msg[256];
+	snprintf(msg, sizeof(msg), "Reprojection check: %s moved up to %.2f px, CPU reference off by %.4f px\n",
+		ri->GeoName.c_str(), motion, error);
+	::OutputDebugStringA(msg);
+}
+
+void NormalMapApp::UpdateMeshletCulling(const GameTimer& gt)
+{
+	auto indirectArgs = mCurrFrameResource->IndirectArgs.get();
+
+	XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+	XMVECTOR eyeW = mCamera.GetPosition();
+
+	Meshlets::CullStats stats;
+	std::vector<Meshlets::DrawIndexedArgs> draws;
+	for (auto ri : mRitemLayer[(int)RenderLayer::DiffuseRTTest])
+	{
+		ri->IndirectDrawCount = 0;
+		if (ri->IndirectArgsCapacity == 0)
+			continue;
+
+		// Cull in object space: the planes come from the object-to-clip matrix and the
+		// eye is moved into the object's frame.
+		XMMATRIX world = XMLoadFloat4x4(&mTransforms.World(ri->TransformId));
+		XMMATRIX invWorld = XMLoadFloat4x4(&mTransforms.InvWorld(ri->TransformId));
+
+		XMFLOAT4X4 objectToClip;
+		XMStoreFloat4x4(&objectToClip, XMMatrixMultiply(world, viewProj));
+		XMFLOAT3 eye;
+		XMStoreFloat3(&eye, XMVector3TransformCoord(eyeW, invWorld));
+
+		draws.clear();
+		stats += Meshlets::CullMeshlets(mMeshlets[ri->GeoName], Meshlets::ExtractFrustum(objectToClip), eye, &draws);
+
+		for (size_t i = 0; i < draws.size(); ++i)
+		{
+			D3D12_DRAW_INDEXED_ARGUMENTS args;
+			args.IndexCountPerInstance = draws[i].IndexCountPerInstance;
+			args.InstanceCount = draws[i].InstanceCount;
+			args.StartIndexLocation = draws[i].StartIndexLocation;
+			args.BaseVertexLocation = draws[i].BaseVertexLocation;
+			args.StartInstanceLocation = draws[i].StartInstanceLocation;
+			indirectArgs->CopyData(ri->IndirectArgsOffset + (int)i, args);
+		}
+		ri->IndirectDrawCount = (UINT)draws.size();
+	}
+	mMeshletStats = stats;
+
+	// Once a second is enough to follow the numbers without flooding the output.
+	if (gt.TotalTime() - mMeshletStatsTime >= 1.0f)
+	{
+		mMeshletStatsTime = gt.TotalTime();
+
+		char msg[256];
+		snprintf(msg, sizeof(msg), "Meshlet culling: %u meshlets, %u frustum culled, %u backface culled, %llu of %llu triangles culled, %u draws\n",
+			stats.Meshlets, stats.FrustumCulled, stats.BackfaceCulled,
+			(unsigned long long)stats.CulledTriangles, (unsigned long long)stats.Triangles, stats.Draws);
+		::OutputDebugStringA(msg);
+	}
 }
 
 void NormalMapApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
-	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
 	for (auto& e : mMaterials)
 	{
 		// Only update the cbuffer data if the constants have changed.  If the cbuffer
@@ -870,39 +1557,20 @@ void NormalMapApp::UpdateMaterialBuffer(const GameTimer& gt)
 			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
 			matData.NormalMapIndex = mat->NormalSrvHeapIndex;
 
-			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
+			mMaterialData[mat->MatCBIndex] = matData;
 
 			// Next FrameResource need to be updated too.
 			mat->NumFramesDirty--;
 		}
 	}
+
+	UploadAllocator::Allocation matBuffer = mUploads->Allocate(sizeof(MaterialData) * mMaterialData.size());
+	memcpy(matBuffer.CpuAddress, mMaterialData.data(), sizeof(MaterialData) * mMaterialData.size());
+	mMaterialBufferAddress = matBuffer.GpuAddress;
 }
 
 void NormalMapApp::UpdateMainPassCB(const GameTimer& gt)
 {
-	for (auto& e : mRitemLayer[(int)RenderLayer::DiffuseRTTest])
-	{
-		XMMATRIX world = XMMatrixScaling(e->Scale.x, e->Scale.y, e->Scale.z) * XMMatrixTranslation(e->Position.x, e->Position.y, e->Position.z);
-		XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
-
-		// Update matrices for temporal filtering.
-		if (e->GeoName == "model")
-		{
-			XMStoreFloat4x4(&mMainPassCB.LastFrameWorld1, XMMatrixTranspose(e->WorldMat));
-			XMStoreFloat4x4(&mMainPassCB.InvWorld1, XMMatrixTranspose(invWorld));
-		}
-		else if (e->GeoName == "box")
-		{
-			XMStoreFloat4x4(&mMainPassCB.LastFrameWorld2, XMMatrixTranspose(e->WorldMat));
-			XMStoreFloat4x4(&mMainPassCB.InvWorld2, XMMatrixTranspose(invWorld));
-		}
-		else if (e->GeoName == "grid")
-		{
-			XMStoreFloat4x4(&mMainPassCB.LastFrameWorld3, XMMatrixTranspose(e->WorldMat));
-			XMStoreFloat4x4(&mMainPassCB.InvWorld3, XMMatrixTranspose(invWorld));
-		}
-	}
-
 	XMMATRIX view = mCamera.GetView();
 	XMMATRIX proj = mCamera.GetProj();
 
@@ -931,45 +1599,254 @@ void NormalMapApp::UpdateMainPassCB(const GameTimer& gt)
 	mMainPassCB.TotalTime = gt.TotalTime();
 	mMainPassCB.DeltaTime = gt.DeltaTime();
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
+	mPassCBAddress = mUploads->Push(mMainPassCB).GpuAddress;
+}
+
+void NormalMapApp::UpdateShaderBindingTables()
+{
+	// The descriptors the ray generation shader reads, at the table slots of
+	// CreateRayGenSignature.  Screen space writes visibility into the last of this frame's
+	// SH textures.
+	if (mProjLTSpace == Space::ScreenSpace)
+		mRayGenTable = mDescriptors->BuildTable({ mScreenSpaceThisFrameSHCoeffsUavs.Sub(8), mGBufferUavs, mAccelerationStructureSrv });
+	else if (mProjLTSpace == Space::ProbeVolume)
+		mRayGenTable = mDescriptors->BuildTable({ mAccelerationStructureSrv });
+	else
+		mRayGenTable = mDescriptors->BuildTable({ mTextureSpaceVisibility4Uav, mAccelerationStructureSrv });
+
+	// Screen space traces the whole screen in a single dispatch, the probe volume this
+	// frame's probes in one.
+	const std::vector<RenderItem*>& receivers = mRitemLayer[(int)RenderLayer::DiffuseRTTest];
+	const bool singleDispatch = mProjLTSpace == Space::ScreenSpace || mProjLTSpace == Space::ProbeVolume;
+	const int tableCount = singleDispatch ? (std::min)(1, (int)receivers.size()) : (int)receivers.size();
+
+	mShaderBindingTables.resize(tableCount);
+	for (int i = 0; i < tableCount; ++i)
+		mShaderBindingTables[i] = CreateShaderBindingTable(i);
 }
 
-void NormalMapApp::LoadTextures()
+void NormalMapApp::UpdateTextureStreaming()
 {
-	std::vector<std::string> texNames =
+	if (mTexturesResidentLogged)
+		return;
+
+	mTextureStreamer->Update();
+	mDescriptors->MarkDirty(mTextureSrvs);
+	mDescriptors->MarkDirty(mSkySrvs.Sub(0));
+
+	// The environment SH came from the mips that were resident, project it again.  SH
+	// from an .hdr sky were projected from the full image already.
+	for (size_t i = 0; i < mScene.Textures.size() && !mEnvironmentFromImage; ++i)
 	{
-		"bricksDiffuseMap",
-		"bricksNormalMap",
-		"tileDiffuseMap",
-		"tileNormalMap",
-		"defaultDiffuseMap",
-		"defaultNormalMap",
-		"skyCubeMap"
-	};
+		const TextureStreamer::Status& status = mTextureStreamer->GetStatus(mStreamedTextures[i]);
+		if (mScene.Textures[i].Cube && status.ResidentMip != mSkyResidentMip)
+		{
+			mSkyResidentMip = status.ResidentMip;
+			mProjectEnvironment = true;
+		}
+	}
+
+	if (!mTextureStreamer->Idle())
+		return;
+	mTexturesResidentLogged = true;
 
-	std::vector<std::wstring> texFilenames =
+	for (size_t i = 0; i < mScene.Textures.size(); ++i)
 	{
-		L"../Textures/bricks2.dds",
-		L"../Textures/bricks2_nmap.dds",
-		L"../Textures/tile.dds",
-		L"../Textures/tile_nmap.dds",
-		L"../Textures/white1x1.dds",
-		L"../Textures/default_nmap.dds",
-		L"../Textures/snowcube1024.dds"
-	};
+		const TextureStreamer::Status& status = mTextureStreamer->GetStatus(mStreamedTextures[i]);
+		char msg[256];
+		snprintf(msg, sizeof(msg), "Texture streaming: %s resident %.2f ms after its request\n",
+			mScene.Textures[i].Name.c_str(), status.ResidentMilliseconds);
+		::OutputDebugStringA(msg);
+	}
+
+	const TextureStreamer::Stats& stats = mTextureStreamer->GetStats();
+	auto endTime = std::chrono::high_resolution_clock::now();
+	char msg[256];
+	snprintf(msg, sizeof(msg), "Texture streaming: all resident %.2f ms after start, %.2f MB in %u copies, "
+		"%u submissions, %u ring stalls\n",
+		std::chrono::duration<double, std::milli>(endTime - mStartTime).count(),
+		stats.BytesUploaded / (1024.0 * 1024.0), stats.Copies, stats.Submissions, stats.RingStalls);
+	::OutputDebugStringA(msg);
+}
 
-	for (int i = 0; i < (int)texNames.size(); ++i)
+void NormalMapApp::LoadScene()
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	std::string error;
+	if (!SceneDesc::Load(mSceneFile, mScene, error))
 	{
-		auto texMap = std::make_unique<Texture>();
-		texMap->Name = texNames[i];
-		texMap->Filename = texFilenames[i];
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-			mCommandList.Get(), texMap->Filename.c_str(),
-			texMap->Resource, texMap->UploadHeap));
+		::OutputDebugStringA(("Scene: " + error + "\n").c_str());
+		throw std::runtime_error(error);
+	}
+
+	// The receiver passes share one input layout, so every receiver must be packed to use it.
+	for (const SceneDesc::Object& object : mScene.Objects)
+	{
+		if (object.ObjectRole == SceneDesc::Role::Receiver && !mScene.FindMesh(object.Mesh)->Pack)
+			mUsePackedVertices = false;
+	}
+
+	// A lat-long .hdr sky is resampled into a DDS cube under Cache/, which is streamed
+	// like any other, and projected onto the environment SH from the full image.
+	std::vector<std::string> textureFiles;
+	for (const SceneDesc::Texture& desc : mScene.Textures)
+	{
+		textureFiles.push_back(desc.File);
+		if (!desc.LatLong)
+			continue;
+
+		textureFiles.back() = "Cache/" + desc.Name + ".cube.dds";
+		EnvironmentMap::Stats stats;
+		bool rebuilt = false;
+		if (!EnvironmentMap::Import(desc.File, textureFiles.back(), desc.CubeSize, mEnvironmentSH, rebuilt, &stats, &error,
+			mJobs.get()))
+		{
+			::OutputDebugStringA(("Scene: " + desc.File + ": " + error + "\n").c_str());
+			throw std::runtime_error(error);
+		}
+		mEnvironmentFromImage = true;
+
+		char msg[256];
+		if (rebuilt)
+		{
+			snprintf(msg, sizeof(msg), "Environment %s: parsed in %.2f ms, SH in %.2f ms, cube in %.2f ms, written in %.2f ms "
+				"(%u tiles on %u threads)\n", desc.Name.c_str(), stats.ParseMilliseconds, stats.ProjectMilliseconds,
+				stats.ResampleMilliseconds, stats.WriteMilliseconds, stats.Tiles, stats.Threads);
+		}
+		else
+		{
+			snprintf(msg, sizeof(msg), "Environment %s: cube and SH up to date in %s\n", desc.Name.c_str(), textureFiles.back().c_str());
+		}
+		::OutputDebugStringA(msg);
+	}
+
+	// Textures are read on the streamer's I/O threads and copied on its own queue.  The
+	// sky goes first, it lights the whole scene.
+	mTextureUploadDevice = std::make_unique<D3D12TextureUploadDevice>(md3dDevice.Get(), 16 * 1024 * 1024);
+	mTextureStreamer = std::make_unique<TextureStreamer>(*mTextureUploadDevice, TextureStreamer::Options());
+	for (size_t i = 0; i < mScene.Textures.size(); ++i)
+		mStreamedTextures.push_back(mTextureStreamer->Request(textureFiles[i], mScene.Textures[i].Cube ? 1 : 0));
+
+	std::unordered_map<std::string, size_t> meshIndices;
+	for (size_t i = 0; i < mScene.Meshes.size(); ++i)
+		meshIndices[mScene.Meshes[i].Name] = i;
+
+	// Every mesh is a job; the device and the command list are only used on this thread,
+	// below.
+	std::vector<MeshJob> meshes(mScene.Meshes.size());
+	for (size_t i = 0; i < mScene.Meshes.size(); ++i)
+	{
+		const SceneDesc::Mesh& desc = mScene.Meshes[i];
+		MeshJob& job = meshes[i];
+		if (desc.Type != SceneDesc::Shape::AdaptiveGrid)
+			job.Job = mJobs->Spawn([this, &desc, &job]() { job.Mesh = PrepareMesh(desc); });
+	}
+
+	// Adaptive grids are refined for the first object placed on them, against the other
+	// occluders of the scene, so they start once those have been launched.
+	for (size_t i = 0; i < mScene.Meshes.size(); ++i)
+	{
+		const SceneDesc::Mesh& desc = mScene.Meshes[i];
+		if (desc.Type != SceneDesc::Shape::AdaptiveGrid)
+			continue;
+
+		XMFLOAT4X4 gridWorld = MathHelper::Identity4x4();
+		bool placed = false;
+		std::vector<PlacedMesh> occluders;
+		for (const SceneDesc::Object& object : mScene.Objects)
+		{
+			if (object.Mesh == desc.Name)
+			{
+				if (!placed)
+					gridWorld = SceneObjectWorld(object);
+				placed = true;
+				continue;
+			}
+
+			const size_t meshIndex = meshIndices[object.Mesh];
+			if (object.Occluder && mScene.Meshes[meshIndex].Type != SceneDesc::Shape::AdaptiveGrid)
+				occluders.push_back({ &meshes[meshIndex], SceneObjectWorld(object) });
+		}
+
+		MeshJob& job = meshes[i];
+		job.Job = mJobs->Spawn([this, &desc, &job, gridWorld, occluders]()
+			{
+				job.Mesh = PrepareAdaptiveGrid(desc, gridWorld, occluders);
+			});
+	}
+
+	// The texture resources only need the headers; their views are made in
+	// BuildDescriptorHeaps.
+	double assetMilliseconds = 0.0;
+	mTextureStreamer->WaitForHeaders();
+	for (size_t i = 0; i < mScene.Textures.size(); ++i)
+	{
+		const SceneDesc::Texture& desc = mScene.Textures[i];
+		const TextureStreamer::Status& status = mTextureStreamer->GetStatus(mStreamedTextures[i]);
+		if (status.TextureState == TextureStreamer::State::Failed)
+		{
+			::OutputDebugStringA(("Scene: " + status.Error + "\n").c_str());
+			throw std::runtime_error(status.Error);
+		}
 
+		auto texMap = std::make_unique<Texture>();
+		texMap->Name = desc.Name;
+		texMap->Filename = AnsiToWString(textureFiles[i]);
+		texMap->Resource = mTextureUploadDevice->Resource(status.DeviceTexture);
 		mTextures[texMap->Name] = std::move(texMap);
 	}
+
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		const SceneDesc::Mesh& desc = mScene.Meshes[i];
+		mJobs->Wait(meshes[i].Job);
+		std::shared_ptr<PreparedMesh> prepared = meshes[i].Mesh;
+
+		auto uploadStart = std::chrono::high_resolution_clock::now();
+
+		mGeometries[desc.Name] = CreateMeshGeometry(*prepared);
+
+		auto uploadEnd = std::chrono::high_resolution_clock::now();
+		const double uploadMilliseconds = std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count();
+		assetMilliseconds += prepared->Milliseconds + uploadMilliseconds;
+
+		char msg[256];
+		snprintf(msg, sizeof(msg), "Scene: mesh %s, %u vertices, %s %.2f ms, upload %.2f ms\n",
+			desc.Name.c_str(), prepared->VertexCount(), prepared->FromCache ? "mapped" : "built",
+			prepared->Milliseconds, uploadMilliseconds);
+		::OutputDebugStringA(msg);
+	}
+
+	// Everything can be sampled once the tails are in; the rest follows in Update.
+	auto tailStart = std::chrono::high_resolution_clock::now();
+	mTextureStreamer->WaitForTails();
+	auto tailEnd = std::chrono::high_resolution_clock::now();
+	const double tailMilliseconds = std::chrono::duration<double, std::milli>(tailEnd - tailStart).count();
+
+	for (size_t i = 0; i < mScene.Textures.size(); ++i)
+	{
+		const TextureStreamer::Status& status = mTextureStreamer->GetStatus(mStreamedTextures[i]);
+		assetMilliseconds += status.ReadMilliseconds;
+		if (mScene.Textures[i].Cube)
+			mSkyResidentMip = status.ResidentMip;
+
+		char msg[256];
+		snprintf(msg, sizeof(msg), "Scene: texture %s, %ux%u, %u mips, read %.2f ms, mips %u-%u resident\n",
+			mScene.Textures[i].Name.c_str(), status.Desc.Width, status.Desc.Height, status.Desc.MipCount,
+			status.ReadMilliseconds, status.ResidentMip, status.Desc.MipCount - 1);
+		::OutputDebugStringA(msg);
+	}
+	assetMilliseconds += tailMilliseconds;
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	char msg[256];
+	snprintf(msg, sizeof(msg), "Scene: texture tails uploaded in %.2f ms\n", tailMilliseconds);
+	::OutputDebugStringA(msg);
+	snprintf(msg, sizeof(msg), "Scene: %s, %zu textures and %zu meshes in %.2f ms, %.2f ms summed over the assets\n",
+		mSceneFile.c_str(), mScene.Textures.size(), meshes.size(),
+		std::chrono::duration<double, std::milli>(endTime - startTime).count(), assetMilliseconds);
+	::OutputDebugStringA(msg);
 }
 
 void NormalMapApp::BuildRootSignature()
@@ -1005,7 +1882,7 @@ void NormalMapApp::BuildRootSignature()
 	texTable7.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 9, 0, 6);
 
 	// Root parameter can be a table, root descriptor or root constants.
-	constexpr int parameterNum = 16;
+	constexpr int parameterNum = 21;
 	CD3DX12_ROOT_PARAMETER slotRootParameter[parameterNum];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
@@ -1025,6 +1902,12 @@ void NormalMapApp::BuildRootSignature()
 	slotRootParameter[13].InitAsDescriptorTable(1, &texTable5, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[14].InitAsDescriptorTable(1, &texTable6, D3D12_SHADER_VISIBILITY_PIXEL); // G-Buffer 
 	slotRootParameter[15].InitAsDescriptorTable(1, &texTable7, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[16].InitAsShaderResourceView(1, 1); // object transforms for reprojection
+	// Probe volume space: constants, this frame's rays, probe SH and distance moments.
+	slotRootParameter[17].InitAsConstantBufferView(2);
+	slotRootParameter[18].InitAsUnorderedAccessView(6);
+	slotRootParameter[19].InitAsUnorderedAccessView(7);
+	slotRootParameter[20].InitAsUnorderedAccessView(8);
 
 	auto staticSamplers = GetStaticSamplers();
 
@@ -1043,410 +1926,739 @@ void NormalMapApp::BuildRootSignature()
 	{
 		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 	}
-	ThrowIfFailed(hr);
+	ThrowIfFailed(hr);
+
+	ThrowIfFailed(md3dDevice->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+}
+
+void NormalMapApp::BuildDescriptorHeaps()
+{
+	// The 2D textures of the scene in file order, then its cube map.
+	std::vector<std::uint32_t> tex2DList;
+	std::uint32_t skyCubeMap = 0;
+	for (size_t i = 0; i < mScene.Textures.size(); ++i)
+	{
+		const std::uint32_t texture = mTextureStreamer->GetStatus(mStreamedTextures[i]).DeviceTexture;
+		if (mScene.Textures[i].Cube)
+			skyCubeMap = texture;
+		else
+			tex2DList.push_back(texture);
+	}
+
+	// Room for the textures and the passes' views with plenty to spare; the ring only
+	// holds the ray generation table of the frames in flight.
+	mDescriptors = std::make_unique<D3D12DescriptorHeap>(md3dDevice.Get(), (UINT)tex2DList.size() + 128, 64);
+
+	// The streaming device owns these views and raises their min LOD clamp as mips arrive;
+	// UpdateTextureStreaming copies them over.  The table declares 10 textures, the
+	// slots no scene texture takes get null views.
+	mTextureSrvs = mDescriptors->AllocateSrv((std::max)((UINT)tex2DList.size(), 10u));
+	for (UINT i = 0; i < (UINT)tex2DList.size(); ++i)
+		mTextureUploadDevice->CreateShaderResourceView(tex2DList[i], mDescriptors->WriteHandle(mTextureSrvs, i));
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC nullSrvDesc = {};
+	nullSrvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	nullSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	nullSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	nullSrvDesc.Texture2D.MipLevels = 1;
+	for (UINT i = (UINT)tex2DList.size(); i < mTextureSrvs.Count; ++i)
+		md3dDevice->CreateShaderResourceView(nullptr, &nullSrvDesc, mDescriptors->WriteHandle(mTextureSrvs, i));
+
+	mSkySrvs = mDescriptors->AllocateSrv(3);
+	mTextureUploadDevice->CreateShaderResourceView(skyCubeMap, mDescriptors->WriteHandle(mSkySrvs, 0));
+
+	// depth map
+	mDepthMap->BuildDescriptors(
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(mDescriptors->WriteHandle(mSkySrvs, 1)),
+		CD3DX12_GPU_DESCRIPTOR_HANDLE(mDescriptors->GpuHandle(mSkySrvs, 1)),
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(mDsvHeap->GetCPUDescriptorHandleForHeapStart(), 1, mDsvDescriptorSize));
+
+	// Texture space visibility4 buffer.
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = mTextureSpaceVisibilityBuffer->GetDesc().MipLevels;
+	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	srvDesc.Format = mTextureSpaceVisibilityBuffer->GetDesc().Format;
+	md3dDevice->CreateShaderResourceView(mTextureSpaceVisibilityBuffer.Get(), &srvDesc, mDescriptors->WriteHandle(mSkySrvs, 2));
+
+	// Acceleration structure.
+	D3D12_SHADER_RESOURCE_VIEW_DESC ASSrvDesc;
+	ASSrvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	ASSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
+	ASSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	ASSrvDesc.RaytracingAccelerationStructure.Location =
+		m_topLevelASBuffers.pResult->GetGPUVirtualAddress();
+	// Write the acceleration structure view in the heap
+	mAccelerationStructureSrv = mDescriptors->AllocateSrv(1);
+	md3dDevice->CreateShaderResourceView(nullptr, &ASSrvDesc, mDescriptors->WriteHandle(mAccelerationStructureSrv));
+
+	// RWTexture2D for screen space coeffs
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = mIntermediateScreenSpaceSHCoeffsBuffer[0]->GetDesc().Format;
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+	uavDesc.Texture2D.MipSlice = 0;
+
+	auto buildUavs = [this, &uavDesc](const ComPtr<ID3D12Resource>* resources, UINT count)
+	{
+		UavRange uavs = mDescriptors->AllocateUav(count);
+		for (UINT i = 0; i < count; ++i)
+			md3dDevice->CreateUnorderedAccessView(resources[i].Get(), nullptr, &uavDesc, mDescriptors->WriteHandle(uavs, i));
+		return uavs;
+	};
+	mScreenSpaceIntermediateSHCoeffsUavs = buildUavs(mIntermediateScreenSpaceSHCoeffsBuffer.data(), 9);
+	mScreenSpaceThisFrameSHCoeffsUavs = buildUavs(mThisFrameScreenSpaceSHCoeffsBuffer.data(), 9);
+	mScreenSpaceLastFrameSHCoeffsUavs = buildUavs(mLastFrameScreenSpaceSHCoeffsBuffer.data(), 9);
+	mFilteredHorzSHCoeffsUavs = buildUavs(mFilteredHorzSHCoeffsBuffer.data(), 9);
+	mGBufferUavs = buildUavs(mGBuffer.data(), 2);
+	mFilteredVertSHCoeffsUavs = buildUavs(mFilteredVertSHCoeffsBuffer.data(), 9);
+
+	// Texture space visibility4 buffer.
+	uavDesc = {};
+	uavDesc.Format = mTextureSpaceVisibilityBuffer->GetDesc().Format;
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+	uavDesc.Texture2D.MipSlice = 0;
+	mTextureSpaceVisibility4Uav = buildUavs(&mTextureSpaceVisibilityBuffer, 1);
+
+	mDescriptors->CopyDirty();
+
+	const DescriptorAllocator::Stats& stats = mDescriptors->GetStats();
+	char msg[160];
+	snprintf(msg, sizeof(msg), "Descriptors: %u of %u in %u ranges, %u copied in %u runs\n",
+		stats.Allocated, stats.Capacity, stats.Allocations, stats.CopiedDescriptors, stats.CopyRuns);
+	::OutputDebugStringA(msg);
+}
+
+void NormalMapApp::BuildShadersAndInputLayout()
+{
+	const D3D_SHADER_MACRO alphaTestDefines[] =
+	{
+		"ALPHA_TEST", "1",
+		NULL, NULL
+	};
+
+	// Shaders that draw the receivers read whichever vertex format they were uploaded in.
+	const D3D_SHADER_MACRO packedVertexDefines[] =
+	{
+		"PACKED_VERTEX", "1",
+		NULL, NULL
+	};
+	const D3D_SHADER_MACRO* geometryDefines = mUsePackedVertices ? packedVertexDefines : nullptr;
+
+	// Every stage and DXIL library is compiled at once on mJobs.  fxc is thread safe and
+	// CompileShaderLibrary keeps a DXC compiler per thread.  Blobs land in maps by name, so
+	// the result does not depend on which thread compiled what.
+	ShaderCompileBatch batch;
+	std::map<std::string, ComPtr<ID3DBlob>> stages;
+	std::map<std::string, ComPtr<IDxcBlob>> libraries;
+	auto compileStage = [&](const char* name, const wchar_t* file, const D3D_SHADER_MACRO* defines,
+		const char* entryPoint, const char* target)
+	{
+		batch.Add<ComPtr<ID3DBlob>>(name, &stages, [this, file, defines, entryPoint, target]()
+		{
+			try
+			{
+				return d3dUtil::CompileShader(file, defines, entryPoint, target, mShaderCache.get());
+			}
+			catch (DxException& e)
+			{
+				throw std::runtime_error(WStringToAnsi(e.ToString()));
+			}
+		});
+	};
+	auto compileLibrary = [&](const char* name, const wchar_t* file, const DxcDefine* defines, UINT32 defineCount)
+	{
+		batch.Add<ComPtr<IDxcBlob>>(name, &libraries, [this, file, defines, defineCount]()
+		{
+			try
+			{
+				ComPtr<IDxcBlob> library;
+				library.Attach(nv_helpers_dx12::CompileShaderLibrary(file, defines, defineCount, mShaderCache.get()));
+				return library;
+			}
+			catch (DxException& e)
+			{
+				throw std::runtime_error(WStringToAnsi(e.ToString()));
+			}
+		});
+	};
+
+	// The libraries take longest, so they are queued first.  The per-vertex ray
+	// generation shaders read the receivers' vertex buffers directly.
+	const DxcDefine packedVertexDefine = { L"PACKED_VERTEX", L"1" };
+	const UINT32 vertexDefineCount = mUsePackedVertices ? 1 : 0;
+	if (mProjLTSpace == Space::ScreenSpace)
+		compileLibrary("RayGen", L"Shaders\\RayGenPerPixel.hlsl", nullptr, 0);
+	else
+		compileLibrary("RayGen", L"Shaders\\RayGen.hlsl", &packedVertexDefine, vertexDefineCount);
+	compileLibrary("TextureSpaceRayGen", L"Shaders\\TextureSpaceRayGen.hlsl", &packedVertexDefine, vertexDefineCount);
+	compileLibrary("ProbeRayGen", L"Shaders\\ProbeRayGen.hlsl", nullptr, 0);
+	compileLibrary("Miss", L"Shaders\\Miss.hlsl", nullptr, 0);
+	compileLibrary("Hit", L"Shaders\\Hit.hlsl", nullptr, 0);
+
+	compileStage("standardVS", L"Shaders\\Default.hlsl", geometryDefines, "VS", "vs_5_1");
+	compileStage("opaquePS", L"Shaders\\Default.hlsl", geometryDefines, "PS", "ps_5_1");
+
+	compileStage("skyVS", L"Shaders\\Sky.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("skyPS", L"Shaders\\Sky.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("ProjEnvVS", L"Shaders\\ProjEnv.hlsl", nullptr, "VS", "vs_5_1");
+
+	compileStage("ProbeUpdateVS", L"Shaders\\ProbeUpdate.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("ProbeShadeVS", L"Shaders\\ProbeShade.hlsl", geometryDefines, "VS", "vs_5_1");
+	compileStage("ProbeShadePS", L"Shaders\\ProbeShade.hlsl", geometryDefines, "PS", "ps_5_1");
+
+	compileStage("ProjLTVS", L"Shaders\\ProjLTPerVertex.hlsl", geometryDefines, "VS", "vs_5_1");
+
+	compileStage("ProjLTTextureVS", L"Shaders\\ProjLTPerVertexTextureSpace.hlsl", geometryDefines, "VS", "vs_5_1");
+
+	compileStage("ReconstructLightVS", L"Shaders\\ReconstructLight.hlsl", geometryDefines, "VS", "vs_5_1");
+	compileStage("ReconstructLightPS", L"Shaders\\ReconstructLight.hlsl", geometryDefines, "PS", "ps_5_1");
+
+	compileStage("ProjLTPixellVS", L"Shaders\\ProjLTPerPixelNew.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("ProjLTPixellPS", L"Shaders\\ProjLTPerPixelNew.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("FilterVS", L"Shaders\\Filter.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("FilterPS", L"Shaders\\Filter.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("OutlierRemovalVS", L"Shaders\\Outlier_removal.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("OutlierRemovalPS", L"Shaders\\Outlier_removal.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("FilterHorzVS", L"Shaders\\FilterHorizontal.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("FilterHorzPS", L"Shaders\\FilterHorizontal.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("FilterVertVS", L"Shaders\\FilterVertical.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("FilterVertPS", L"Shaders\\FilterVertical.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("TemporalFilterVS", L"Shaders\\TemporalFilter.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("TemporalFilterPS", L"Shaders\\TemporalFilter.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("FilterHorzWorldVS", L"Shaders\\FilterHorizontalWorld.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("FilterHorzWorldPS", L"Shaders\\FilterHorizontalWorld.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("FilterVertWorldVS", L"Shaders\\FilterVerticalWorld.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("FilterVertWorldPS", L"Shaders\\FilterVerticalWorld.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("ReconLightPixelVS", L"Shaders\\FilterAndReconstructPerPixel.hlsl", nullptr, "VS", "vs_5_1");
+	compileStage("ReconLightPixelPS", L"Shaders\\FilterAndReconstructPerPixel.hlsl", nullptr, "PS", "ps_5_1");
+
+	compileStage("DepthVS", L"Shaders\\Depth.hlsl", geometryDefines, "VS", "vs_5_1");
+	compileStage("DepthPS", L"Shaders\\Depth.hlsl", geometryDefines, "PS", "ps_5_1");
+
+	compileStage("WriteGBufferVS", L"Shaders\\WriteGBuffer.hlsl", geometryDefines, "VS", "vs_5_1");
+	compileStage("WriteGBufferPS", L"Shaders\\WriteGBuffer.hlsl", geometryDefines, "PS", "ps_5_1");
+
+	if (!batch.Run(*mJobs))
+		throw std::runtime_error("Shader compilation failed:\n" + batch.ErrorReport());
+
+	mShaders.insert(stages.begin(), stages.end());
+	m_rayGenLibrary = libraries["RayGen"];
+	m_textureSpaceRayGenLibrary = libraries["TextureSpaceRayGen"];
+	m_probeRayGenLibrary = libraries["ProbeRayGen"];
+	m_missLibrary = libraries["Miss"];
+	m_hitLibrary = libraries["Hit"];
+
+	// Cold when nothing came from the cache, as on the first launch or a new compiler.
+	// Added up, the compile times are what compiling one after another would take.
+	const ShaderCache::Stats cacheStats = mShaderCache->GetStats();
+	char msg[256];
+	snprintf(msg, sizeof(msg), "Shaders: %u compiled, %u loaded from cache (%s) in %.1f ms on %u threads, %.1f ms one after another\n",
+		cacheStats.Misses, cacheStats.Hits, cacheStats.Hits == 0 ? "cold" : "warm", batch.WallMs(),
+		mJobs->WorkerCount() + 1, batch.SerialMs());
+	::OutputDebugStringA(msg);
+	::OutputDebugStringA(batch.TimingReport().c_str());
+
+	mInputLayout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+
+	// VertexPacking::PackedVertex
+	mPackedInputLayout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+}
+
+std::shared_ptr<PreparedMesh> NormalMapApp::PrepareMesh(const SceneDesc::Mesh& desc)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	auto prepared = std::make_shared<PreparedMesh>();
+	prepared->Name = desc.Name;
+	prepared->Pack = desc.Pack && mUsePackedVertices;
+
+	const std::vector<float>& p = desc.Params;
+	GeometryGenerator geoGen;
+	switch (desc.Type)
+	{
+	// Imported models and grids dominate startup, so they go through the mesh cache.
+	case SceneDesc::Shape::Model:
+		PrepareCachedMesh(*prepared, desc.File, true, desc.Lods,
+			[this, &desc](std::vector<MeshCache::Submesh>& submeshes)
+			{
+				Model model(desc.File, mJobs.get());
+
+				for (size_t i = 0; i < model.meshes.size(); ++i)
+				{
+					// Indices are already rebased, so every part draws with base vertex 0.
+					MeshCache::Submesh submesh;
+					submesh.Name = desc.Name + std::to_string(i);
+					submesh.IndexCount = model.meshes[i].IndexCount;
+					submesh.StartIndex = model.meshes[i].StartIndex;
+					submesh.VertexCount = model.meshes[i].VertexCount;
+					submeshes.push_back(submesh);
+				}
+
+				GeometryGenerator::MeshData mesh = model.CreateModel();
+
+				char msg[256];
+				snprintf(msg, sizeof(msg), "Model import: %zu meshes, %zu vertices, %zu indices, read %.2f ms, fill %.2f ms, peak RSS %.1f MB\n",
+					model.meshes.size(), mesh.Vertices.size(), mesh.Indices32.size(), model.readMilliseconds, model.fillMilliseconds,
+					PlatformUtil::PeakResidentBytes() / (1024.0 * 1024.0));
+				::OutputDebugStringA(msg);
+
+				return mesh;
+			});
+		break;
+	case SceneDesc::Shape::Grid:
+	{
+		char key[128];
+		snprintf(key, sizeof(key), "grid %g %g %u %u", p[0], p[1], (UINT)p[2], (UINT)p[3]);
+		PrepareCachedMesh(*prepared, key, false, desc.Lods,
+			[&geoGen, &p](std::vector<MeshCache::Submesh>&)
+			{
+				return geoGen.CreateGrid(p[0], p[1], (UINT)p[2], (UINT)p[3]);
+			});
+		break;
+	}
+	case SceneDesc::Shape::AdaptiveGrid:
+		throw std::logic_error("adaptive grids are built by PrepareAdaptiveGrid");
+	default:
+		if (desc.Type == SceneDesc::Shape::Box)
+			prepared->Mesh = geoGen.CreateBox(p[0], p[1], p[2], (UINT)p[3]);
+		else if (desc.Type == SceneDesc::Shape::Sphere)
+			prepared->Mesh = geoGen.CreateSphere(p[0], (UINT)p[1], (UINT)p[2]);
+		else if (desc.Type == SceneDesc::Shape::Cylinder)
+			prepared->Mesh = geoGen.CreateCylinder(p[0], p[1], p[2], (UINT)p[3], (UINT)p[4]);
+		else
+			prepared->Mesh = geoGen.CreateQuad(p[0], p[1], p[2], p[3], p[4]);
+
+		OptimizeMesh(desc.Name, prepared->Mesh);
+		if (desc.Lods)
+			GenerateLods(desc.Name, prepared->Mesh, prepared->Submeshes);
+		break;
+	}
 
-	ThrowIfFailed(md3dDevice->CreateRootSignature(
-		0,
-		serializedRootSig->GetBufferPointer(),
-		serializedRootSig->GetBufferSize(),
-		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+	auto endTime = std::chrono::high_resolution_clock::now();
+	prepared->Milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	return prepared;
 }
 
-void NormalMapApp::BuildDescriptorHeaps()
+std::unique_ptr<MeshGeometry> NormalMapApp::CreateMeshGeometry(const std::string& name,
+	const GeometryGenerator::Vertex* vertices, UINT vertexCount,
+	const std::uint32_t* indices, UINT indexCount, const BoundingBox& bounds, bool pack,
+	const std::vector<MeshCache::Submesh>& submeshes)
 {
-	//
-	// Create the clear descriptor heap.
-	//
-	D3D12_DESCRIPTOR_HEAP_DESC clearHeapDesc = {};
-	clearHeapDesc.NumDescriptors = 39;
-	clearHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	clearHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&clearHeapDesc, IID_PPV_ARGS(&mClearDescriptorHeap)));
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+
+	// The whole index buffer is uploaded, but the geometry itself is LOD0, which ends
+	// where the first LOD starts.
+	const std::string lodPrefix = name + "_";
+	std::vector<const MeshCache::Submesh*> lods;
+	for (const MeshCache::Submesh& submesh : submeshes)
+	{
+		if (submesh.Name.compare(0, lodPrefix.size(), lodPrefix) == 0)
+			lods.push_back(&submesh);
+	}
+	const UINT lod0IndexCount = Lod0IndexCount(name, submeshes, indexCount);
 
-	//
-	// Fill out the heap with actual descriptors.
-	//
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mClearDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	geo->VertexCount = vertexCount;
+	geo->IndexCount = lod0IndexCount;
+	geo->VertexByteStride = pack ? sizeof(VertexPacking::PackedVertex) : sizeof(Vertex);
+	geo->VertexBufferByteSize = vertexCount * geo->VertexByteStride;
+	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+	geo->IndexBufferByteSize = indexCount * sizeof(std::uint32_t);
 
-	// RWTexture2D for screen space coeffs
-	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-	uavDesc.Format = mIntermediateScreenSpaceSHCoeffsBuffer[0]->GetDesc().Format;
-	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-	uavDesc.Texture2D.MipSlice = 0;
+	SubmeshGeometry submesh;
+	submesh.BaseVertexLocation = 0;
+	submesh.StartIndexLocation = 0;
+	submesh.IndexCount = lod0IndexCount;
+	submesh.VertexCount = vertexCount;
+	submesh.Bounds = bounds;
+	geo->DrawArgs[name] = submesh;
 
-	mIntermediateClearHeapIndex = 0;
-	for (int i = 0; i < 9; ++i)
+	for (const MeshCache::Submesh* lod : lods)
 	{
-		md3dDevice->CreateUnorderedAccessView(mIntermediateScreenSpaceSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+		submesh.StartIndexLocation = lod->StartIndex;
+		submesh.IndexCount = lod->IndexCount;
+		geo->DrawArgs[lod->Name] = submesh;
 	}
 
-	mThisFrameClearHeapIndex = mIntermediateClearHeapIndex + 9;
-	for (int i = 0; i < 9; ++i)
+	// Kept for the CPU ray caster that measures the occluder proxies.
+	if (mReportOccluderError && !lods.empty())
 	{
-		md3dDevice->CreateUnorderedAccessView(mThisFrameScreenSpaceSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+		ThrowIfFailed(D3DCreateBlob(vertexCount * sizeof(Vertex), &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices, vertexCount * sizeof(Vertex));
+		ThrowIfFailed(D3DCreateBlob(geo->IndexBufferByteSize, &geo->IndexBufferCPU));
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices, geo->IndexBufferByteSize);
 	}
 
-	mFilteredHorzClearHeapIndex = mThisFrameClearHeapIndex + 9;
-	for (int i = 0; i < 9; ++i)
+	if (pack)
 	{
-		md3dDevice->CreateUnorderedAccessView(mFilteredHorzSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+		VertexPacking::PositionDequantization dq = VertexPacking::MakeDequantization(bounds.Center, bounds.Extents);
+		std::vector<VertexPacking::PackedVertex> packed = VertexPacking::PackVertices(vertices, vertexCount, dq);
+
+		geo->PackedVertices = true;
+		geo->PositionScale = dq.Scale;
+		geo->PositionBias = dq.Bias;
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), packed.data(), geo->VertexBufferByteSize, geo->VertexBufferUploader);
+
+		VertexPacking::RoundTripError error = VertexPacking::MeasureRoundTripError(vertices, vertexCount, dq);
+		char msg[256];
+		snprintf(msg, sizeof(msg), "Vertex packing: %s %u -> %u bytes, max error position %g, normal %.3f deg, tangent %.3f deg, uv %g\n",
+			name.c_str(), vertexCount * (UINT)sizeof(Vertex), geo->VertexBufferByteSize,
+			error.Position, error.NormalDegrees, error.TangentDegrees, error.TexC);
+		::OutputDebugStringA(msg);
 	}
-
-	mGBufferClearHeapIndex = mFilteredHorzClearHeapIndex + 9;
-	for (int i = 0; i < 2; ++i)
+	else
 	{
-		md3dDevice->CreateUnorderedAccessView(mGBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), vertices, geo->VertexBufferByteSize, geo->VertexBufferUploader);
 	}
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), indices, geo->IndexBufferByteSize, geo->IndexBufferUploader);
 
-	mFilteredVertClearHeapIndex = mGBufferClearHeapIndex + 2;
-	for (int i = 0; i < 9; ++i)
-	{
-		md3dDevice->CreateUnorderedAccessView(mFilteredVertSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-	}
+	// Meshlets follow the (already optimized) index order, so they index this same buffer.
+	std::vector<Meshlets::Meshlet>& meshlets = mMeshlets[name];
+	meshlets = Meshlets::BuildMeshlets(indices, lod0IndexCount, &vertices[0].Position.x, sizeof(GeometryGenerator::Vertex), vertexCount);
 
-	//
-	// Create the SRV/UAV descriptor heap.
-	//
-	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-	heapDesc.NumDescriptors = 58;
-	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mDescriptorHeap)));
-
-	hDescriptor = mDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
-
-	std::vector<ComPtr<ID3D12Resource>> tex2DList =
-	{
-		mTextures["bricksDiffuseMap"]->Resource,
-		mTextures["bricksNormalMap"]->Resource,
-		mTextures["tileDiffuseMap"]->Resource,
-		mTextures["tileNormalMap"]->Resource,
-		mTextures["defaultDiffuseMap"]->Resource,
-		mTextures["defaultNormalMap"]->Resource
-	};
+	double meshletVertices = 0.0;
+	for (const Meshlets::Meshlet& meshlet : meshlets)
+		meshletVertices += meshlet.VertexCount;
+	const double meshletCount = (double)(std::max)(meshlets.size(), size_t(1));
 
-	auto skyCubeMap = mTextures["skyCubeMap"]->Resource;
+	char msg[256];
+	snprintf(msg, sizeof(msg), "Meshlets: %s %zu meshlets, %.1f triangles and %.1f vertices on average\n",
+		name.c_str(), meshlets.size(), lod0IndexCount / 3.0 / meshletCount, meshletVertices / meshletCount);
+	::OutputDebugStringA(msg);
 
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	return geo;
+}
 
-	for (UINT i = 0; i < (UINT)tex2DList.size(); ++i)
+std::unique_ptr<MeshGeometry> NormalMapApp::CreateMeshGeometry(const PreparedMesh& prepared)
+{
+	BoundingBox bounds;
+	if (prepared.FromCache)
+	{
+		const MeshCache::Bounds& cached = prepared.Cache.MeshBounds();
+		BoundingBox::CreateFromPoints(bounds, XMLoadFloat3(&cached.Min), XMLoadFloat3(&cached.Max));
+	}
+	else
 	{
-		srvDesc.Format = tex2DList[i]->GetDesc().Format;
-		srvDesc.Texture2D.MipLevels = tex2DList[i]->GetDesc().MipLevels;
-		md3dDevice->CreateShaderResourceView(tex2DList[i].Get(), &srvDesc, hDescriptor);
+		BoundingBox::CreateFromPoints(bounds, prepared.VertexCount(), &prepared.Vertices()[0].Position,
+			sizeof(GeometryGenerator::Vertex));
+	}
+
+	return CreateMeshGeometry(prepared.Name, prepared.Vertices(), prepared.VertexCount(),
+		prepared.Indices(), prepared.IndexCount(), bounds, prepared.Pack, prepared.MeshSubmeshes());
+}
 
-		// next descriptor
-		hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+std::shared_ptr<PreparedMesh> NormalMapApp::PrepareAdaptiveGrid(const SceneDesc::Mesh& desc, const XMFLOAT4X4& gridWorld,
+	const std::vector<PlacedMesh>& occluders)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	auto prepared = std::make_shared<PreparedMesh>();
+	prepared->Name = desc.Name;
+	prepared->Pack = desc.Pack && mUsePackedVertices;
+
+	AdaptiveGrid::Options options;
+	options.Width = desc.Params[0];
+	options.Depth = desc.Params[1];
+	if (desc.Params.size() > 2)
+		options.BaseCells = (UINT)desc.Params[2];
+	if (desc.Params.size() > 3)
+		options.MaxLevels = (UINT)desc.Params[3];
+	if (desc.Params.size() > 4)
+		options.Threshold = desc.Params[4];
+	const UINT directionCount = 32;
+
+	// Everything the refinement depends on, so the cache is rebuilt when any of it changes.
+	// The content of the occluder meshes is not part of the key.
+	char text[256];
+	snprintf(text, sizeof(text), "adaptive grid %g %g %u %u %g %u, grid (%g %g %g)",
+		options.Width, options.Depth, options.BaseCells, options.MaxLevels, options.Threshold, directionCount,
+		gridWorld._41, gridWorld._42, gridWorld._43);
+	std::string key = text;
+	for (const PlacedMesh& occluder : occluders)
+	{
+		const XMFLOAT4X4& w = occluder.World;
+		snprintf(text, sizeof(text), ", occluder (%g %g %g) (%g %g %g)", w._11, w._22, w._33, w._41, w._42, w._43);
+		key += text;
 	}
 
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
-	srvDesc.TextureCube.MostDetailedMip = 0;
-	srvDesc.TextureCube.MipLevels = skyCubeMap->GetDesc().MipLevels;
-	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
-	srvDesc.Format = skyCubeMap->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(skyCubeMap.Get(), &srvDesc, hDescriptor);
+	PrepareCachedMesh(*prepared, key, false, desc.Lods,
+		[&](std::vector<MeshCache::Submesh>&)
+		{
+			// The occluders are prepared concurrently; wait for them only now that they are
+			// needed, running other jobs meanwhile.
+			CpuRayCaster caster;
+			for (const PlacedMesh& occluder : occluders)
+			{
+				mJobs->Wait(occluder.Mesh->Job);
+				const PreparedMesh& mesh = *occluder.Mesh->Mesh;
+				caster.AddMesh(mesh.Vertices(), mesh.Indices(),
+					Lod0IndexCount(mesh.Name, mesh.MeshSubmeshes(), mesh.IndexCount()), occluder.World);
+			}
+
+			auto refineStart = std::chrono::high_resolution_clock::now();
+
+			caster.Build();
+
+			// The same cosine distributed directions (Hammersley) at every point, so the estimate
+			// varies with the occluders only and not with sampling noise.
+			std::vector<XMFLOAT3> directions(directionCount);
+			for (UINT i = 0; i < directionCount; ++i)
+			{
+				UINT bits = i;
+				bits = (bits << 16u) | (bits >> 16u);
+				bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+				bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+				bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+				bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+
+				const float u = (i + 0.5f) / directionCount;
+				const float phi = XM_2PI * float(bits) * 2.3283064365386963e-10f;
+				const float radius = std::sqrt(u);
+				directions[i] = XMFLOAT3(radius * std::cos(phi), std::sqrt(1.0f - u), radius * std::sin(phi));
+			}
+
+			// Unoccluded fraction above a grid point, at the startup placement of the grid.
+			const XMMATRIX world = XMLoadFloat4x4(&gridWorld);
+			AdaptiveGrid::Estimator estimate = [&](const XMFLOAT3& p)
+			{
+				XMFLOAT3 origin;
+				XMStoreFloat3(&origin, XMVector3TransformCoord(XMLoadFloat3(&p), world));
+				UINT open = 0;
+				for (const XMFLOAT3& direction : directions)
+					open += caster.Occluded(origin, direction, 0.00001f, 1000000.0f) ? 0 : 1;
+				return float(open) / directionCount;
+			};
+
+			AdaptiveGrid::Stats stats;
+			GeometryGenerator::MeshData grid = AdaptiveGrid::CreateGrid(options, estimate, &stats);
+
+			auto refineEnd = std::chrono::high_resolution_clock::now();
+
+			char msg[256];
+			snprintf(msg, sizeof(msg), "Adaptive grid: %zu vertices, %zu triangles, %u leaves, %u balance splits, %u estimates, %.2f ms\n",
+				grid.Vertices.size(), grid.Indices32.size() / 3, stats.Leaves, stats.BalanceSplits, stats.Evaluations,
+				std::chrono::duration<double, std::milli>(refineEnd - refineStart).count());
+			::OutputDebugStringA(msg);
+
+			if (mBenchmarkAdaptiveGrid)
+			{
+				// Against the uniform 300x300 grid and a uniform grid with the same vertex budget.
+				GeometryGenerator geoGen;
+				const UINT budget = (UINT)std::lround(std::sqrt((double)grid.Vertices.size()));
+				const AdaptiveGrid::Reference reference = AdaptiveGrid::SampleReference(options.Width, options.Depth, 512, estimate);
+
+				struct Candidate
+				{
+					const char* Label;
+					GeometryGenerator::MeshData Mesh;
+				};
+				Candidate candidates[] =
+				{
+					{ "adaptive", grid },
+					{ "uniform 300x300", geoGen.CreateGrid(options.Width, options.Depth, 300, 300) },
+					{ "uniform same budget", geoGen.CreateGrid(options.Width, options.Depth, budget, budget) },
+				};
+
+				for (const Candidate& candidate : candidates)
+				{
+					std::vector<float> values(candidate.Mesh.Vertices.size());
+					for (size_t v = 0; v < values.size(); ++v)
+						values[v] = estimate(candidate.Mesh.Vertices[v].Position);
+
+					AdaptiveGrid::Error error = AdaptiveGrid::MeasureError(candidate.Mesh, values, reference);
+					snprintf(msg, sizeof(msg), "Adaptive grid benchmark: %s, %zu vertices, rms error %.4f, max error %.4f\n",
+						candidate.Label, candidate.Mesh.Vertices.size(), error.Rms, error.Max);
+					::OutputDebugStringA(msg);
+				}
+			}
+
+			return grid;
+		});
 
-	mSkyTexHeapIndex = (UINT)tex2DList.size();
+	auto endTime = std::chrono::high_resolution_clock::now();
+	prepared->Milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	return prepared;
+}
 
-	// depth map
-	mDepthMapHeapIndex = mSkyTexHeapIndex + 1;
-	hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-	mDepthMap->BuildDescriptors(
-		hDescriptor,
-		CD3DX12_GPU_DESCRIPTOR_HANDLE(mDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), mDepthMapHeapIndex, mCbvSrvUavDescriptorSize),
-		CD3DX12_CPU_DESCRIPTOR_HANDLE(mDsvHeap->GetCPUDescriptorHandleForHeapStart(), 1, mDsvDescriptorSize));
+void NormalMapApp::PrepareCachedMesh(PreparedMesh& prepared, const std::string& source, bool sourceIsFile, bool lods,
+	const std::function<GeometryGenerator::MeshData(std::vector<MeshCache::Submesh>&)>& build)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
 
-	// Texture space visibility4 buffer.
-	hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-	srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = mTextureSpaceVisibilityBuffer->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-	srvDesc.Format = mTextureSpaceVisibilityBuffer->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(mTextureSpaceVisibilityBuffer.Get(), &srvDesc, hDescriptor);
-	mTextureSpaceVisibility4SRVHeapIndex = mDepthMapHeapIndex + 1;
+	const std::string cachePath = "Cache/" + prepared.Name + ".mesh";
 
-	// Acceleration structure.
-	hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-	D3D12_SHADER_RESOURCE_VIEW_DESC ASSrvDesc;
-	ASSrvDesc.Format = DXGI_FORMAT_UNKNOWN;
-	ASSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
-	ASSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	ASSrvDesc.RaytracingAccelerationStructure.Location =
-		m_topLevelASBuffers.pResult->GetGPUVirtualAddress();
-	// Write the acceleration structure view in the heap
-	md3dDevice->CreateShaderResourceView(nullptr, &ASSrvDesc, hDescriptor);
-	mAccelerationStructureHeapIndex = mTextureSpaceVisibility4SRVHeapIndex + 1;
+	MeshCache::Result result = sourceIsFile ?
+		prepared.Cache.OpenForFile(cachePath, source) : prepared.Cache.OpenForKey(cachePath, source);
+	bool hit = result == MeshCache::Result::Hit || result == MeshCache::Result::HitByHash;
 
-	mScreenSpaceIntermediateSHCoeffsHeapIndex = mAccelerationStructureHeapIndex + 1;
-	for (int i = 0; i < 9; ++i)
+	// A cache written before lods= was toggled is rebuilt.
+	if (hit && (Lod0IndexCount(prepared.Name, prepared.Cache.Submeshes(), prepared.Cache.IndexCount()) <
+		prepared.Cache.IndexCount()) != lods)
 	{
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-		md3dDevice->CreateUnorderedAccessView(mIntermediateScreenSpaceSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
+		prepared.Cache.Close();
+		result = MeshCache::Result::Stale;
+		hit = false;
 	}
 
-	mScreenSpaceThisFrameSHCoeffsHeapIndex = mScreenSpaceIntermediateSHCoeffsHeapIndex + 9;
-	for (int i = 0; i < 9; ++i)
+	if (hit)
 	{
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-		md3dDevice->CreateUnorderedAccessView(mThisFrameScreenSpaceSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
+		// Uploaded straight from the mapped file, no intermediate MeshData.
+		prepared.FromCache = true;
+
+		// Cached meshes were optimized before they were written.
+		MeshOptimizer::VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(prepared.Indices(),
+			Lod0IndexCount(prepared.Name, prepared.MeshSubmeshes(), prepared.IndexCount()), prepared.VertexCount());
+		char msg[256];
+		snprintf(msg, sizeof(msg), "Mesh optimizer: %s ACMR %.3f, ATVR %.3f (cached)\n", prepared.Name.c_str(), stats.ACMR, stats.ATVR);
+		::OutputDebugStringA(msg);
 	}
-
-	mScreenSpaceLastFrameSHCoeffsHeapIndex = mScreenSpaceThisFrameSHCoeffsHeapIndex + 9;
-	for (int i = 0; i < 9; ++i)
+	else
 	{
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-		md3dDevice->CreateUnorderedAccessView(mLastFrameScreenSpaceSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
+		prepared.Mesh = build(prepared.Submeshes);
+		OptimizeMesh(prepared.Name, prepared.Mesh, prepared.Submeshes);
+		if (lods)
+			GenerateLods(prepared.Name, prepared.Mesh, prepared.Submeshes);
+
+		bool written = sourceIsFile ?
+			MeshCache::WriteForFile(cachePath, source, prepared.Mesh, prepared.Submeshes) :
+			MeshCache::WriteForKey(cachePath, source, prepared.Mesh, prepared.Submeshes);
+		if (!written)
+			::OutputDebugStringA(("Mesh cache: could not write " + cachePath + "\n").c_str());
 	}
 
-	mFilteredHorzSHCoeffsHeapIndex = mScreenSpaceLastFrameSHCoeffsHeapIndex + 9;
-	for (int i = 0; i < 9; ++i)
-	{
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-		md3dDevice->CreateUnorderedAccessView(mFilteredHorzSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
-	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::string msg = "Mesh cache: " + prepared.Name + " " + MeshCache::ResultName(result) + (hit ? ", mapped in " : ", rebuilt in ") +
+		std::to_string(std::chrono::duration<double, std::milli>(endTime - startTime).count()) + " ms\n";
+	::OutputDebugStringA(msg.c_str());
+}
 
-	mGBufferHeapIndex = mFilteredHorzSHCoeffsHeapIndex + 9;
-	for (int i = 0; i < 2; ++i)
+void NormalMapApp::OptimizeMesh(const std::string& name, GeometryGenerator::MeshData& mesh,
+	const std::vector<MeshCache::Submesh>& submeshes)
+{
+	// Keep the triangles of each submesh inside its own index range.
+	std::vector<MeshOptimizer::IndexRange> ranges;
+	for (const MeshCache::Submesh& submesh : submeshes)
 	{
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-		md3dDevice->CreateUnorderedAccessView(mGBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
+		MeshOptimizer::IndexRange range;
+		range.StartIndex = submesh.StartIndex;
+		range.IndexCount = submesh.IndexCount;
+		ranges.push_back(range);
 	}
 
-	mFilteredVertSHCoeffsHeapIndex = mGBufferHeapIndex + 2;
-	for (int i = 0; i < 9; ++i)
-	{
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-		md3dDevice->CreateUnorderedAccessView(mFilteredVertSHCoeffsBuffer[i].Get(), nullptr, &uavDesc, hDescriptor);
-	}
+	// The vertex count is preserved by the fetch remap, so vertexOffset into the per-vertex
+	// SH and visibility buffers stays valid; those buffers are filled from the remapped
+	// vertex order on the GPU, so there is nothing on the CPU to remap with it.
+	MeshOptimizer::VertexCacheStats before, after;
+	MeshOptimizer::OptimizeMesh(mesh, ranges, &before, &after);
 
-	// Texture space visibility4 buffer.
-	hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-	uavDesc = {};
-	uavDesc.Format = mTextureSpaceVisibilityBuffer->GetDesc().Format;
-	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-	uavDesc.Texture2D.MipSlice = 0;
-	md3dDevice->CreateUnorderedAccessView(mTextureSpaceVisibilityBuffer.Get(), nullptr, &uavDesc, hDescriptor);
-	mTextureSpaceVisibility4UAVHeapIndex = mFilteredVertSHCoeffsHeapIndex + 9;
+	char msg[256];
+	snprintf(msg, sizeof(msg), "Mesh optimizer: %s ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		name.c_str(), before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+	::OutputDebugStringA(msg);
 }
 
-void NormalMapApp::BuildShadersAndInputLayout()
+void NormalMapApp::GenerateLods(const std::string& name, GeometryGenerator::MeshData& mesh,
+	std::vector<MeshCache::Submesh>& submeshes)
 {
-	const D3D_SHADER_MACRO alphaTestDefines[] =
+	struct LodDesc
 	{
-		"ALPHA_TEST", "1",
-		NULL, NULL
+		const char* Suffix;
+		float Ratio;  // of the LOD0 triangle count
+		float Error;  // relative to the mesh radius
+		bool Occluder;
 	};
 
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["skyVS"] = d3dUtil::CompileShader(L"Shaders\\Sky.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["skyPS"] = d3dUtil::CompileShader(L"Shaders\\Sky.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["ProjEnvVS"] = d3dUtil::CompileShader(L"Shaders\\ProjEnv.hlsl", nullptr, "VS", "vs_5_1");
-
-	mShaders["ProjLTVS"] = d3dUtil::CompileShader(L"Shaders\\ProjLTPerVertex.hlsl", nullptr, "VS", "vs_5_1");
-
-	mShaders["ProjLTTextureVS"] = d3dUtil::CompileShader(L"Shaders\\ProjLTPerVertexTextureSpace.hlsl", nullptr, "VS", "vs_5_1");
-
-	mShaders["ReconstructLightVS"] = d3dUtil::CompileShader(L"Shaders\\ReconstructLight.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["ReconstructLightPS"] = d3dUtil::CompileShader(L"Shaders\\ReconstructLight.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["ProjLTPixellVS"] = d3dUtil::CompileShader(L"Shaders\\ProjLTPerPixelNew.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["ProjLTPixellPS"] = d3dUtil::CompileShader(L"Shaders\\ProjLTPerPixelNew.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["FilterVS"] = d3dUtil::CompileShader(L"Shaders\\Filter.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["FilterPS"] = d3dUtil::CompileShader(L"Shaders\\Filter.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["OutlierRemovalVS"] = d3dUtil::CompileShader(L"Shaders\\Outlier_removal.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["OutlierRemovalPS"] = d3dUtil::CompileShader(L"Shaders\\Outlier_removal.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["FilterHorzVS"] = d3dUtil::CompileShader(L"Shaders\\FilterHorizontal.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["FilterHorzPS"] = d3dUtil::CompileShader(L"Shaders\\FilterHorizontal.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["FilterVertVS"] = d3dUtil::CompileShader(L"Shaders\\FilterVertical.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["FilterVertPS"] = d3dUtil::CompileShader(L"Shaders\\FilterVertical.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["TemporalFilterVS"] = d3dUtil::CompileShader(L"Shaders\\TemporalFilter.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["TemporalFilterPS"] = d3dUtil::CompileShader(L"Shaders\\TemporalFilter.hlsl", nullptr, "PS", "ps_5_1");
+	// Each LOD simplifies the previous one.  The occluder welds uv and normal seams, since
+	// only its silhouette matters to the visibility rays.
+	const LodDesc lodDescs[] =
+	{
+		{ "_lod1", 0.5f, 0.01f, false },
+		{ "_lod2", 0.25f, 0.02f, false },
+		{ "_occluder", 0.05f, 0.05f, true },
+	};
 
-	mShaders["FilterHorzWorldVS"] = d3dUtil::CompileShader(L"Shaders\\FilterHorizontalWorld.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["FilterHorzWorldPS"] = d3dUtil::CompileShader(L"Shaders\\FilterHorizontalWorld.hlsl", nullptr, "PS", "ps_5_1");
+	auto startTime = std::chrono::high_resolution_clock::now();
 
-	mShaders["FilterVertWorldVS"] = d3dUtil::CompileShader(L"Shaders\\FilterVerticalWorld.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["FilterVertWorldPS"] = d3dUtil::CompileShader(L"Shaders\\FilterVerticalWorld.hlsl", nullptr, "PS", "ps_5_1");
+	const size_t lod0IndexCount = mesh.Indices32.size();
+	std::vector<std::uint32_t> previous(mesh.Indices32);
+	for (const LodDesc& desc : lodDescs)
+	{
+		MeshSimplifier::Options options;
+		if (desc.Occluder)
+		{
+			options.WeldPositions = true;
+			options.AttributeWeight = 0.0f;
+		}
 
-	mShaders["ReconLightPixelVS"] = d3dUtil::CompileShader(L"Shaders\\FilterAndReconstructPerPixel.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["ReconLightPixelPS"] = d3dUtil::CompileShader(L"Shaders\\FilterAndReconstructPerPixel.hlsl", nullptr, "PS", "ps_5_1");
+		float error = 0.0f;
+		std::vector<std::uint32_t> lod = MeshSimplifier::Simplify(mesh.Vertices.data(), mesh.Vertices.size(),
+			previous.data(), previous.size(), size_t(lod0IndexCount * desc.Ratio) / 3 * 3, desc.Error, options, &error);
 
-	mShaders["DepthVS"] = d3dUtil::CompileShader(L"Shaders\\Depth.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["DepthPS"] = d3dUtil::CompileShader(L"Shaders\\Depth.hlsl", nullptr, "PS", "ps_5_1");
+		MeshCache::Submesh submesh;
+		submesh.Name = name + desc.Suffix;
+		submesh.StartIndex = (UINT)mesh.Indices32.size();
+		submesh.IndexCount = (UINT)lod.size();
+		submesh.VertexCount = (UINT)mesh.Vertices.size();
+		submeshes.push_back(submesh);
 
-	mShaders["WriteGBufferVS"] = d3dUtil::CompileShader(L"Shaders\\WriteGBuffer.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["WriteGBufferPS"] = d3dUtil::CompileShader(L"Shaders\\WriteGBuffer.hlsl", nullptr, "PS", "ps_5_1");
+		mesh.Indices32.resize(mesh.Indices32.size() + lod.size());
+		MeshOptimizer::OptimizeVertexCache(mesh.Indices32.data() + submesh.StartIndex, lod.data(), lod.size(), mesh.Vertices.size());
 
-	mInputLayout =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-	};
-}
+		char msg[256];
+		snprintf(msg, sizeof(msg), "Mesh LOD: %s %zu -> %zu triangles (%.1f%%), max error %.4f\n",
+			submesh.Name.c_str(), lod0IndexCount / 3, lod.size() / 3,
+			100.0 * lod.size() / (std::max)(lod0IndexCount, size_t(1)), error);
+		::OutputDebugStringA(msg);
 
-void NormalMapApp::BuildShapeGeometry()
-{
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 10);
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(10.0f, 10.0f, 300, 300);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-	GeometryGenerator::MeshData quad = geoGen.CreateQuad(-1.0f, 1.0f, 2.0f, 2.0f, 0.0f);
-
-	GeometryGenerator::MeshData model = Model("Models/nanosuit/nanosuit.obj").CreateModel();
-
-	auto geoBox = std::make_unique<MeshGeometry>();
-	auto geoGrid = std::make_unique<MeshGeometry>();
-	auto geoSphere = std::make_unique<MeshGeometry>();
-	auto geoCylinder = std::make_unique<MeshGeometry>();
-	auto geoModel = std::make_unique<MeshGeometry>();
-	auto geoQuad = std::make_unique<MeshGeometry>();
-
-	geoBox->Name = "box";
-	geoGrid->Name = "grid";
-	geoSphere->Name = "sphere";
-	geoCylinder->Name = "cylinder";
-	geoModel->Name = "model";
-	geoQuad->Name = "quad";
-
-	geoBox->VertexCount = box.Vertices.size();
-	geoGrid->VertexCount = grid.Vertices.size();
-	geoSphere->VertexCount = sphere.Vertices.size();
-	geoCylinder->VertexCount = cylinder.Vertices.size();
-	geoModel->VertexCount = model.Vertices.size();
-	geoQuad->VertexCount = quad.Vertices.size();
-
-	geoBox->IndexCount = box.Indices32.size();
-	geoGrid->IndexCount = grid.Indices32.size();
-	geoSphere->IndexCount = sphere.Indices32.size();
-	geoCylinder->IndexCount = cylinder.Indices32.size();
-	geoModel->IndexCount = model.Indices32.size();
-	geoQuad->IndexCount = quad.Indices32.size();
-
-	UINT vertexSize = sizeof(Vertex);
-	UINT indexSize = sizeof(std::uint32_t);
-
-	geoBox->VertexByteStride = sizeof(Vertex);
-	geoBox->VertexBufferByteSize = geoBox->VertexCount * vertexSize;
-	geoBox->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geoBox->IndexBufferByteSize = geoBox->IndexCount * indexSize;
-
-	geoGrid->VertexByteStride = sizeof(Vertex);
-	geoGrid->VertexBufferByteSize = geoGrid->VertexCount * vertexSize;
-	geoGrid->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geoGrid->IndexBufferByteSize = geoGrid->IndexCount * indexSize;
-
-	geoSphere->VertexByteStride = sizeof(Vertex);
-	geoSphere->VertexBufferByteSize = geoSphere->VertexCount * vertexSize;
-	geoSphere->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geoSphere->IndexBufferByteSize = geoSphere->IndexCount * indexSize;
-
-	geoCylinder->VertexByteStride = sizeof(Vertex);
-	geoCylinder->VertexBufferByteSize = geoCylinder->VertexCount * vertexSize;
-	geoCylinder->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geoCylinder->IndexBufferByteSize = geoCylinder->IndexCount * indexSize;
-
-	geoModel->VertexByteStride = sizeof(Vertex);
-	geoModel->VertexBufferByteSize = geoModel->VertexCount * vertexSize;
-	geoModel->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geoModel->IndexBufferByteSize = geoModel->IndexCount * indexSize;
-
-	geoQuad->VertexByteStride = sizeof(Vertex);
-	geoQuad->VertexBufferByteSize = geoQuad->VertexCount * vertexSize;
-	geoQuad->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geoQuad->IndexBufferByteSize = geoQuad->IndexCount * indexSize;
+		previous.swap(lod);
+	}
 
-	SubmeshGeometry submesh;
-	submesh.BaseVertexLocation = 0;
-	submesh.StartIndexLocation = 0;
-	submesh.IndexCount = geoBox->IndexCount;
-	submesh.VertexCount = geoBox->VertexCount;
-	geoBox->DrawArgs["box"] = submesh;
-
-	submesh.IndexCount = geoGrid->IndexCount;
-	submesh.VertexCount = geoGrid->VertexCount;
-	geoGrid->DrawArgs["grid"] = submesh;
-
-	submesh.IndexCount = geoSphere->IndexCount;
-	submesh.VertexCount = geoSphere->VertexCount;
-	geoSphere->DrawArgs["sphere"] = submesh;
-
-	submesh.IndexCount = geoCylinder->IndexCount;
-	submesh.VertexCount = geoCylinder->VertexCount;
-	geoCylinder->DrawArgs["cylinder"] = submesh;
-
-	submesh.IndexCount = geoModel->IndexCount;
-	submesh.VertexCount = geoModel->VertexCount;
-	geoModel->DrawArgs["model"] = submesh;
-
-	submesh.IndexCount = geoQuad->IndexCount;
-	submesh.VertexCount = geoQuad->VertexCount;
-	geoQuad->DrawArgs["quad"] = submesh;
-
-	geoBox->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), box.Vertices.data(), box.Vertices.size() * vertexSize, geoBox->VertexBufferUploader);
-	geoBox->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), box.Indices32.data(), box.Indices32.size() * indexSize, geoBox->IndexBufferUploader);
-
-	geoGrid->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), grid.Vertices.data(), grid.Vertices.size() * vertexSize, geoGrid->VertexBufferUploader);
-	geoGrid->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), grid.Indices32.data(), grid.Indices32.size() * indexSize, geoGrid->IndexBufferUploader);
-
-	geoSphere->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), sphere.Vertices.data(), sphere.Vertices.size() * vertexSize, geoSphere->VertexBufferUploader);
-	geoSphere->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), sphere.Indices32.data(), sphere.Indices32.size() * indexSize, geoSphere->IndexBufferUploader);
-
-	geoCylinder->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), cylinder.Vertices.data(), cylinder.Vertices.size() * vertexSize, geoCylinder->VertexBufferUploader);
-	geoCylinder->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), cylinder.Indices32.data(), cylinder.Indices32.size() * indexSize, geoCylinder->IndexBufferUploader);
-
-	geoModel->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), model.Vertices.data(), model.Vertices.size() * vertexSize, geoModel->VertexBufferUploader);
-	geoModel->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), model.Indices32.data(), model.Indices32.size() * indexSize, geoModel->IndexBufferUploader);
-
-	geoQuad->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), quad.Vertices.data(), quad.Vertices.size() * vertexSize, geoQuad->VertexBufferUploader);
-	geoQuad->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), quad.Indices32.data(), quad.Indices32.size() * indexSize, geoModel->IndexBufferUploader);
-
-	mGeometries[geoBox->Name] = std::move(geoBox);
-	mGeometries[geoGrid->Name] = std::move(geoGrid);
-	mGeometries[geoSphere->Name] = std::move(geoSphere);
-	mGeometries[geoCylinder->Name] = std::move(geoCylinder);
-	mGeometries[geoModel->Name] = std::move(geoModel);
-	mGeometries[geoQuad->Name] = std::move(geoQuad);
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::string msg = "Mesh LOD: " + name + " chain built in " +
+		std::to_string(std::chrono::duration<double, std::milli>(endTime - startTime).count()) + " ms\n";
+	::OutputDebugStringA(msg.c_str());
 }
 
 void NormalMapApp::BuildPSOs()
 {
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
 
+	// Passes that draw the receivers use their vertex format; the sky, full-screen
+	// and filter passes inherit the full layout from opaquePsoDesc.
+	D3D12_INPUT_LAYOUT_DESC geometryInputLayout = mUsePackedVertices ?
+		D3D12_INPUT_LAYOUT_DESC{ mPackedInputLayout.data(), (UINT)mPackedInputLayout.size() } :
+		D3D12_INPUT_LAYOUT_DESC{ mInputLayout.data(), (UINT)mInputLayout.size() };
+
 	//
 	// PSO for opaque objects.
 	//
@@ -1473,7 +2685,9 @@ void NormalMapApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueGeometryPsoDesc = opaquePsoDesc;
+	opaqueGeometryPsoDesc.InputLayout = geometryInputLayout;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueGeometryPsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
 
 	//
 	// PSO for sky.
@@ -1539,6 +2753,7 @@ void NormalMapApp::BuildPSOs()
 				reinterpret_cast<BYTE*>(mShaders["ReconstructLightPS"]->GetBufferPointer()),
 				mShaders["ReconstructLightPS"]->GetBufferSize()
 	};
+	reconsteuctPsoDesc.InputLayout = geometryInputLayout;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&reconsteuctPsoDesc, IID_PPV_ARGS(&mPSOs["reconstruct"])));
 
 	//
@@ -1551,6 +2766,7 @@ void NormalMapApp::BuildPSOs()
 				reinterpret_cast<BYTE*>(mShaders["ProjLTVS"]->GetBufferPointer()),
 				mShaders["ProjLTVS"]->GetBufferSize()
 	};
+	projLTPsoDesc.InputLayout = geometryInputLayout;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&projLTPsoDesc, IID_PPV_ARGS(&mPSOs["projLT"])));
 
 	//
@@ -1563,8 +2779,37 @@ void NormalMapApp::BuildPSOs()
 				reinterpret_cast<BYTE*>(mShaders["ProjLTTextureVS"]->GetBufferPointer()),
 				mShaders["ProjLTTextureVS"]->GetBufferSize()
 	};
+	projLTTextureSpacePsoDesc.InputLayout = geometryInputLayout;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&projLTTextureSpacePsoDesc, IID_PPV_ARGS(&mPSOs["projLTTextureSpace"])));
 
+	//
+	// PSO for blending this frame's probe rays into the probes, a point per probe.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC probeUpdatePsoDesc = projEnvPsoDesc;
+	probeUpdatePsoDesc.VS =
+	{
+				reinterpret_cast<BYTE*>(mShaders["ProbeUpdateVS"]->GetBufferPointer()),
+				mShaders["ProbeUpdateVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&probeUpdatePsoDesc, IID_PPV_ARGS(&mPSOs["probeUpdate"])));
+
+	//
+	// PSO for lighting the receivers from the probe volume.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC probeShadePsoDesc = opaquePsoDesc;
+	probeShadePsoDesc.VS =
+	{
+				reinterpret_cast<BYTE*>(mShaders["ProbeShadeVS"]->GetBufferPointer()),
+				mShaders["ProbeShadeVS"]->GetBufferSize()
+	};
+	probeShadePsoDesc.PS =
+	{
+				reinterpret_cast<BYTE*>(mShaders["ProbeShadePS"]->GetBufferPointer()),
+				mShaders["ProbeShadePS"]->GetBufferSize()
+	};
+	probeShadePsoDesc.InputLayout = geometryInputLayout;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&probeShadePsoDesc, IID_PPV_ARGS(&mPSOs["probeShade"])));
+
 	//
 	// PSO for depth map pass.
 	//
@@ -1587,6 +2832,7 @@ void NormalMapApp::BuildPSOs()
 	// depth map pass does not have a render target.
 	depthMapPsoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
 	depthMapPsoDesc.NumRenderTargets = 0;
+	depthMapPsoDesc.InputLayout = geometryInputLayout;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&depthMapPsoDesc, IID_PPV_ARGS(&mPSOs["draw_depth"])));
 
 	//
@@ -1606,6 +2852,7 @@ void NormalMapApp::BuildPSOs()
 				reinterpret_cast<BYTE*>(mShaders["WriteGBufferPS"]->GetBufferPointer()),
 				mShaders["WriteGBufferPS"]->GetBufferSize()
 	};
+	writeGBufferPsoDesc.InputLayout = geometryInputLayout;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&writeGBufferPsoDesc, IID_PPV_ARGS(&mPSOs["writeGBuffer"])));
 
 	//
@@ -1772,162 +3019,117 @@ void NormalMapApp::BuildPSOs()
 
 void NormalMapApp::BuildFrameResources()
 {
+	// Reserve one indirect draw per meshlet for every receiver that is drawn whole;
+	// merged draws never outnumber meshlets.
+	UINT indirectArgCount = 0;
+	for (auto ri : mRitemLayer[(int)RenderLayer::DiffuseRTTest])
+	{
+		auto meshlets = mMeshlets.find(ri->GeoName);
+		if (meshlets == mMeshlets.end() || ri->StartIndexLocation != 0 || ri->BaseVertexLocation != 0 ||
+			ri->IndexCount != ri->Geo->IndexCount)
+			continue;
+
+		ri->IndirectArgsOffset = indirectArgCount;
+		ri->IndirectArgsCapacity = (UINT)meshlets->second.size();
+		indirectArgCount += ri->IndirectArgsCapacity;
+	}
+
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+			(UINT)mAllRitems.size(), (std::max)(indirectArgCount, 1u)));
 	}
+
+	mObjectConstants.resize(mAllRitems.size());
+	mMaterialData.resize(mMaterials.size());
 }
 
 void NormalMapApp::BuildMaterials()
 {
-	auto bricks0 = std::make_unique<Material>();
-	bricks0->Name = "bricks0";
-	bricks0->MatCBIndex = 0;
-	bricks0->DiffuseSrvHeapIndex = 0;
-	bricks0->NormalSrvHeapIndex = 1;
-	bricks0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	bricks0->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
-	bricks0->Roughness = 0.3f;
-
-	auto tile0 = std::make_unique<Material>();
-	tile0->Name = "tile0";
-	tile0->MatCBIndex = 2;
-	tile0->DiffuseSrvHeapIndex = 2;
-	tile0->NormalSrvHeapIndex = 3;
-	tile0->DiffuseAlbedo = XMFLOAT4(0.9f, 0.9f, 0.9f, 1.0f);
-	tile0->FresnelR0 = XMFLOAT3(0.2f, 0.2f, 0.2f);
-	tile0->Roughness = 0.1f;
-
-	auto mirror0 = std::make_unique<Material>();
-	mirror0->Name = "mirror0";
-	mirror0->MatCBIndex = 3;
-	mirror0->DiffuseSrvHeapIndex = 4;
-	mirror0->NormalSrvHeapIndex = 5;
-	mirror0->DiffuseAlbedo = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
-	mirror0->FresnelR0 = XMFLOAT3(0.98f, 0.97f, 0.95f);
-	mirror0->Roughness = 0.1f;
-
-	auto sky = std::make_unique<Material>();
-	sky->Name = "sky";
-	sky->MatCBIndex = 4;
-	sky->DiffuseSrvHeapIndex = 6;
-	sky->NormalSrvHeapIndex = 7;
-	sky->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	sky->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
-	sky->Roughness = 1.0f;
-
-	mMaterials["bricks0"] = std::move(bricks0);
-	mMaterials["tile0"] = std::move(tile0);
-	mMaterials["mirror0"] = std::move(mirror0);
-	mMaterials["sky"] = std::move(sky);
+	// The 2D textures open the SRV heap in scene order (see BuildDescriptorHeaps).
+	std::unordered_map<std::string, int> srvHeapIndices;
+	for (const SceneDesc::Texture& texture : mScene.Textures)
+	{
+		if (!texture.Cube)
+			srvHeapIndices.emplace(texture.Name, (int)srvHeapIndices.size());
+	}
+
+	for (const SceneDesc::Material& desc : mScene.Materials)
+	{
+		auto material = std::make_unique<Material>();
+		material->Name = desc.Name;
+		material->MatCBIndex = (int)mMaterials.size();
+		material->DiffuseSrvHeapIndex = desc.DiffuseMap.empty() ? 0 : srvHeapIndices[desc.DiffuseMap];
+		material->NormalSrvHeapIndex = desc.NormalMap.empty() ? 0 : srvHeapIndices[desc.NormalMap];
+		material->DiffuseAlbedo = desc.DiffuseAlbedo;
+		material->FresnelR0 = desc.FresnelR0;
+		material->Roughness = desc.Roughness;
+
+		mMaterials[desc.Name] = std::move(material);
+	}
 }
 
 void NormalMapApp::BuildRenderItems()
 {
-	auto skyRitem = std::make_unique<RenderItem>();
-	skyRitem->Scale = { 5000.0f, 5000.0f, 5000.0f };
-	skyRitem->WorldMat = XMMatrixScaling(5000.0f, 5000.0f, 5000.0f);
-	skyRitem->TexTransform = MathHelper::Identity4x4();
-	skyRitem->ObjCBIndex = 0;
-	skyRitem->Mat = mMaterials["sky"].get();
-	skyRitem->Geo = mGeometries["sphere"].get();
-	skyRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	skyRitem->IndexCount = skyRitem->Geo->DrawArgs["sphere"].IndexCount;
-	skyRitem->StartIndexLocation = skyRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
-	skyRitem->BaseVertexLocation = skyRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
-	skyRitem->GeoName = "sphere";
-
-	mRitemLayer[(int)RenderLayer::Sky].push_back(skyRitem.get());
-	mAllRitems.push_back(std::move(skyRitem));
-
-	auto modelRitem = std::make_unique<RenderItem>();
-	modelRitem->Position = { 0.0f, 0.0f, 0.0f };
-	modelRitem->Scale = { 0.3f, 0.3f, 0.3f };
-	modelRitem->WorldMat = XMMatrixScaling(modelRitem->Scale.x, modelRitem->Scale.y, modelRitem->Scale.z);
-	modelRitem->TexTransform = MathHelper::Identity4x4();
-	modelRitem->ObjCBIndex = 1;
-	modelRitem->Mat = mMaterials["bricks0"].get();
-	modelRitem->Geo = mGeometries["model"].get();
-	modelRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	modelRitem->IndexCount = modelRitem->Geo->DrawArgs["model"].IndexCount;
-	modelRitem->StartIndexLocation = modelRitem->Geo->DrawArgs["model"].StartIndexLocation;
-	modelRitem->BaseVertexLocation = modelRitem->Geo->DrawArgs["model"].BaseVertexLocation;
-	modelRitem->GeoName = "model";
-	modelRitem->vertexOffset = 0;
-
-	mRitemLayer[(int)RenderLayer::DiffuseRT].push_back(modelRitem.get());
-	mRitemLayer[(int)RenderLayer::DiffuseRTTest].push_back(modelRitem.get());
-	mRitemLayer[(int)RenderLayer::BVH].push_back(modelRitem.get());
-	mAllRitems.push_back(std::move(modelRitem));
-
-	auto boxRitem = std::make_unique<RenderItem>();
-	boxRitem->Position = { 0.0f, 4.0f, 2.3f };
-	boxRitem->Scale = { 1.5f, 1.5f, 1.5f };
-	boxRitem->WorldMat = XMMatrixScaling(boxRitem->Scale.x, boxRitem->Scale.x, boxRitem->Scale.x) *
-		XMMatrixTranslation(boxRitem->Position.x, boxRitem->Position.y, boxRitem->Position.z);
-	boxRitem->TexTransform = MathHelper::Identity4x4();
-	boxRitem->ObjCBIndex = 2;
-	boxRitem->Mat = mMaterials["tile0"].get();
-	boxRitem->Geo = mGeometries["box"].get();
-	boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-	boxRitem->GeoName = "box";
-	boxRitem->vertexOffset = mGeometries["model"]->VertexCount;
-
-	mBoxRitem = boxRitem.get();
-
-	mRitemLayer[(int)RenderLayer::DiffuseRTTest].push_back(boxRitem.get());
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(boxRitem.get());
-	mRitemLayer[(int)RenderLayer::BVH].push_back(boxRitem.get());
-	mAllRitems.push_back(std::move(boxRitem));
-
-	auto gridRitem = std::make_unique<RenderItem>();
-	gridRitem->Position = { 0.5f, -2.0f, 2.5f };
-	gridRitem->Scale = { 1.0f, 1.0f, 1.0f };
-	gridRitem->WorldMat = XMMatrixTranslation(gridRitem->Position.x, gridRitem->Position.y, gridRitem->Position.z);
-	XMStoreFloat4x4(&gridRitem->TexTransform, XMMatrixScaling(8.0f, 8.0f, 1.0f));
-	gridRitem->ObjCBIndex = 3;
-	gridRitem->Mat = mMaterials["tile0"].get();
-	gridRitem->Geo = mGeometries["grid"].get();
-	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
-	gridRitem->GeoName = "grid";
-	gridRitem->vertexOffset = mGeometries["model"]->VertexCount + mGeometries["box"]->VertexCount;
-
-	mGridRitem = gridRitem.get();
-
-	mRitemLayer[(int)RenderLayer::DiffuseRTTest].push_back(gridRitem.get());
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
-	mRitemLayer[(int)RenderLayer::BVH].push_back(gridRitem.get());
-	mAllRitems.push_back(std::move(gridRitem));
-
-	auto quadRitem = std::make_unique<RenderItem>();
-	quadRitem->WorldMat = XMMatrixIdentity();
-	quadRitem->TexTransform = MathHelper::Identity4x4();
-	quadRitem->ObjCBIndex = 4;
-	quadRitem->Mat = mMaterials["bricks0"].get();
-	quadRitem->Geo = mGeometries["quad"].get();
-	quadRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	quadRitem->IndexCount = quadRitem->Geo->DrawArgs["quad"].IndexCount;
-	quadRitem->StartIndexLocation = quadRitem->Geo->DrawArgs["quad"].StartIndexLocation;
-	quadRitem->BaseVertexLocation = quadRitem->Geo->DrawArgs["quad"].BaseVertexLocation;
-	quadRitem->GeoName = "quad";
-
-	mRitemLayer[(int)RenderLayer::Filter].push_back(quadRitem.get());
-	mAllRitems.push_back(std::move(quadRitem));
+	// Receivers take object constants 1 to N in scene order: the index is also their id in
+	// the G-buffer, where 0 is the background, and picks their reprojection matrices in the
+	// temporal filter.  The other objects take 0 and the indices after the receivers.
+	UINT receiverCount = 0;
+	for (const SceneDesc::Object& object : mScene.Objects)
+		receiverCount += object.ObjectRole == SceneDesc::Role::Receiver ? 1 : 0;
+
+	UINT nextReceiverIndex = 1;
+	UINT nextOtherIndex = 0;
+	mReceiverVertexCount = 0;
+
+	for (const SceneDesc::Object& object : mScene.Objects)
+	{
+		auto ritem = std::make_unique<RenderItem>();
+		ritem->TransformId = mTransforms.Add(object.Position, object.Scale);
+		XMStoreFloat4x4(&ritem->TexTransform, XMMatrixScaling(object.TexScale.x, object.TexScale.y, 1.0f));
+		ritem->Mat = mMaterials[object.Material].get();
+		ritem->Geo = mGeometries[object.Mesh].get();
+		ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		ritem->IndexCount = ritem->Geo->DrawArgs[object.Mesh].IndexCount;
+		ritem->StartIndexLocation = ritem->Geo->DrawArgs[object.Mesh].StartIndexLocation;
+		ritem->BaseVertexLocation = ritem->Geo->DrawArgs[object.Mesh].BaseVertexLocation;
+		ritem->GeoName = object.Mesh;
+
+		if (object.ObjectRole == SceneDesc::Role::Receiver)
+		{
+			ritem->ObjCBIndex = nextReceiverIndex++;
+
+			// Receivers own consecutive ranges of the per-vertex SH and visibility buffers.
+			ritem->vertexOffset = mReceiverVertexCount;
+			mReceiverVertexCount += ritem->Geo->VertexCount;
+
+			// Without texture space the receiver is drawn plainly in that mode.
+			mRitemLayer[(int)RenderLayer::DiffuseRTTest].push_back(ritem.get());
+			mRitemLayer[(int)(object.TextureSpace ? RenderLayer::DiffuseRT : RenderLayer::Opaque)].push_back(ritem.get());
+			if (object.Occluder)
+				mRitemLayer[(int)RenderLayer::BVH].push_back(ritem.get());
+		}
+		else
+		{
+			ritem->ObjCBIndex = nextOtherIndex;
+			nextOtherIndex = nextOtherIndex == 0 ? receiverCount + 1 : nextOtherIndex + 1;
+
+			mRitemLayer[(int)(object.ObjectRole == SceneDesc::Role::Sky ? RenderLayer::Sky : RenderLayer::Filter)].push_back(ritem.get());
+		}
+
+		if (object.Keys == "arrows")
+			mArrowKeysRitem = ritem.get();
+		else if (object.Keys == "ijkl")
+			mIJKLKeysRitem = ritem.get();
+
+		mAllRitems.push_back(std::move(ritem));
+	}
 }
 
 void NormalMapApp::DrawRenderItemsIndexedInstanced(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
 	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-
 	// For each render item...
 	for (size_t i = 0; i < ritems.size(); ++i)
 	{
@@ -1937,7 +3139,7 @@ void NormalMapApp::DrawRenderItemsIndexedInstanced(ID3D12GraphicsCommandList* cm
 		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = mObjectCBAddress + ri->ObjCBIndex * objCBByteSize;
 
 		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
@@ -1945,6 +3147,53 @@ void NormalMapApp::DrawRenderItemsIndexedInstanced(ID3D12GraphicsCommandList* cm
 	}
 }
 
+void NormalMapApp::DrawRenderItemsCulled(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+{
+	if (!mUseMeshletCulling)
+	{
+		DrawRenderItemsIndexedInstanced(cmdList, ritems);
+		return;
+	}
+
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+
+	auto indirectArgs = mCurrFrameResource->IndirectArgs->Resource();
+
+	for (size_t i = 0; i < ritems.size(); ++i)
+	{
+		auto ri = ritems[i];
+
+		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = mObjectCBAddress + ri->ObjCBIndex * objCBByteSize;
+
+		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+
+		if (ri->IndirectArgsCapacity == 0)
+			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		else if (ri->IndirectDrawCount > 0)
+			cmdList->ExecuteIndirect(mDrawIndexedSignature.Get(), ri->IndirectDrawCount, indirectArgs,
+				ri->IndirectArgsOffset * sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), nullptr, 0);
+	}
+}
+
+void NormalMapApp::BuildDrawIndirectSignature()
+{
+	// Plain indexed draws; the object constants are bound per item before ExecuteIndirect,
+	// so no root signature is needed.
+	D3D12_INDIRECT_ARGUMENT_DESC argumentDesc = {};
+	argumentDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+	signatureDesc.ByteStride = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+	signatureDesc.NumArgumentDescs = 1;
+	signatureDesc.pArgumentDescs = &argumentDesc;
+
+	ThrowIfFailed(md3dDevice->CreateCommandSignature(&signatureDesc, nullptr, IID_PPV_ARGS(&mDrawIndexedSignature)));
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> NormalMapApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
@@ -2005,30 +3254,31 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> NormalMapApp::GetStaticSamplers
 void NormalMapApp::BuildSHCoeffsBuffer()
 {
 	//// Create the buffer that will be a UAV. 
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(sizeof(SHCoeff), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&mEnvCoeffs)));
-
-	int vertexCount = mGeometries["model"]->VertexCount + mGeometries["box"]->VertexCount + mGeometries["grid"]->VertexCount;
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(vertexCount * sizeof(SHCoeff), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), // per-vertex
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&mTemporalObjCoeffs)));
-
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(vertexCount * sizeof(SHCoeff), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), // per-vertex
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&mThisFrameObjCoeffs)));
+	mEnvCoeffs = mResourceHeaps->CreateBuffer(sizeof(SHCoeff),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	if (mEnvironmentFromImage)
+	{
+		SHCoeff coeffs;
+		static_assert(sizeof(coeffs) == sizeof(mEnvironmentSH.Coeffs), "SHCoeff and EnvironmentMap::SH9 must match");
+		memcpy(&coeffs, mEnvironmentSH.Coeffs, sizeof(coeffs));
+
+		mEnvCoeffsUpload = std::make_unique<UploadBuffer<SHCoeff>>(md3dDevice.Get(), 1, false);
+		mEnvCoeffsUpload->CopyData(0, coeffs);
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mEnvCoeffs.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
+		mCommandList->CopyBufferRegion(mEnvCoeffs.Get(), 0, mEnvCoeffsUpload->Resource(), 0, sizeof(SHCoeff));
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mEnvCoeffs.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+		mProjectEnvironment = false;
+	}
+
+	int vertexCount = mReceiverVertexCount;
+	mTemporalObjCoeffs = mResourceHeaps->CreateBuffer(vertexCount * sizeof(SHCoeff), // per-vertex
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	mThisFrameObjCoeffs = mResourceHeaps->CreateBuffer(vertexCount * sizeof(SHCoeff), // per-vertex
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
 	// Screen space buffer(9 RWTexture2D).
 	D3D12_RESOURCE_DESC texDesc;
@@ -2048,82 +3298,40 @@ void NormalMapApp::BuildSHCoeffsBuffer()
 	// Screen space intermediate coeff buffer
 	for (int i = 0; i < 9; ++i)
 	{
-		mIntermediateScreenSpaceSHCoeffsBuffer.emplace_back(nullptr);
-		ThrowIfFailed(md3dDevice->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nullptr,
-			IID_PPV_ARGS(&mIntermediateScreenSpaceSHCoeffsBuffer[i])));
+		mIntermediateScreenSpaceSHCoeffsBuffer.push_back(mResourceHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 	}
 
 	// Screen space this frame coeff buffer
 	for (int i = 0; i < 9; ++i)
 	{
-		mThisFrameScreenSpaceSHCoeffsBuffer.emplace_back(nullptr);
-		ThrowIfFailed(md3dDevice->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nullptr,
-			IID_PPV_ARGS(&mThisFrameScreenSpaceSHCoeffsBuffer[i])));
+		mThisFrameScreenSpaceSHCoeffsBuffer.push_back(mResourceHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 	}
 
 	// Screen space last frame coeff buffer
 	for (int i = 0; i < 9; ++i)
 	{
-		mLastFrameScreenSpaceSHCoeffsBuffer.emplace_back(nullptr);
-		ThrowIfFailed(md3dDevice->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nullptr,
-			IID_PPV_ARGS(&mLastFrameScreenSpaceSHCoeffsBuffer[i])));
+		mLastFrameScreenSpaceSHCoeffsBuffer.push_back(mResourceHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 	}
 
 	// Screen space horizontal filtered coeff buffer
 	for (int i = 0; i < 9; ++i)
 	{
-		mFilteredHorzSHCoeffsBuffer.emplace_back(nullptr);
-		ThrowIfFailed(md3dDevice->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nullptr,
-			IID_PPV_ARGS(&mFilteredHorzSHCoeffsBuffer[i])));
+		mFilteredHorzSHCoeffsBuffer.push_back(mResourceHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 	}
 
 	// Screen space vertical filtered coeff buffer
 	for (int i = 0; i < 9; ++i)
 	{
-		mFilteredVertSHCoeffsBuffer.emplace_back(nullptr);
-		ThrowIfFailed(md3dDevice->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nullptr,
-			IID_PPV_ARGS(&mFilteredVertSHCoeffsBuffer[i])));
+		mFilteredVertSHCoeffsBuffer.push_back(mResourceHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 	}
 }
 
 void NormalMapApp::BuildVisibilityTermBuffer()
 {
-	int vertexCount = mGeometries["model"]->VertexCount; 
-	vertexCount += mGeometries["box"]->VertexCount;
-	vertexCount += mGeometries["grid"]->VertexCount;
+	int vertexCount = mReceiverVertexCount;
 
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(vertexCount * sizeof(XMFLOAT4X4), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&mVisibilityBuffer)));
+	mVisibilityBuffer = mResourceHeaps->CreateBuffer(vertexCount * sizeof(XMFLOAT4X4),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
 	// Texture space visibility4.
 	D3D12_RESOURCE_DESC texDesc;
@@ -2140,13 +3348,64 @@ void NormalMapApp::BuildVisibilityTermBuffer()
 	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 	texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&texDesc,
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&mTextureSpaceVisibilityBuffer)));
+	mTextureSpaceVisibilityBuffer = mResourceHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+}
+
+void NormalMapApp::BuildProbeVolume()
+{
+	if (mProjLTSpace != Space::ProbeVolume)
+		return;
+	if (mScene.ProbeVolumes.empty())
+	{
+		const std::string error = mSceneFile + ": the probe volume space needs a probes declaration";
+		::OutputDebugStringA(("Scene: " + error + "\n").c_str());
+		throw std::runtime_error(error);
+	}
+
+	mProbeVolume = std::make_unique<ProbeVolume>(mScene.ProbeVolumes[0].Desc);
+	const ProbeVolume::Desc& desc = mProbeVolume->GetDesc();
+	const UINT64 probeCount = mProbeVolume->ProbeCount();
+
+	const UINT64 texelCount = probeCount * desc.DepthResolution * desc.DepthResolution;
+
+	mProbeRays = mResourceHeaps->CreateBuffer(UINT64(mProbeVolume->ProbesPerFrame()) * desc.RaysPerProbe * sizeof(XMFLOAT4),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	mProbeRadiance = mResourceHeaps->CreateBuffer(probeCount * sizeof(SHCoeff),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	mProbeDepth = mResourceHeaps->CreateBuffer(texelCount * sizeof(XMFLOAT2),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	// Until the first sweep has reached them, the receivers read probes that were never
+	// updated: start them as the CPU reference does, dark and seeing nothing nearby.
+	static_assert(sizeof(SHCoeff) == ProbeVolume::SHCount * 3 * sizeof(float), "SHCoeff and ProbeVolume::Radiance must match");
+	mProbeRadianceUpload = std::make_unique<UploadBuffer<SHCoeff>>(md3dDevice.Get(), (UINT)probeCount, false);
+	mProbeDepthUpload = std::make_unique<UploadBuffer<XMFLOAT2>>(md3dDevice.Get(), (UINT)texelCount, false);
+	for (UINT probe = 0; probe < probeCount; ++probe)
+	{
+		SHCoeff coeffs;
+		memcpy(&coeffs, mProbeVolume->Radiance(probe), sizeof(coeffs));
+		mProbeRadianceUpload->CopyData(probe, coeffs);
+	}
+	for (UINT texel = 0; texel < texelCount; ++texel)
+		mProbeDepthUpload->CopyData(texel, mProbeVolume->Depth(0)[texel]);
+
+	ID3D12Resource* targets[] = { mProbeRadiance.Get(), mProbeDepth.Get() };
+	ID3D12Resource* sources[] = { mProbeRadianceUpload->Resource(), mProbeDepthUpload->Resource() };
+	const UINT64 sizes[] = { probeCount * sizeof(SHCoeff), texelCount * sizeof(XMFLOAT2) };
+	for (int i = 0; i < 2; ++i)
+	{
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(targets[i],
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
+		mCommandList->CopyBufferRegion(targets[i], 0, sources[i], 0, sizes[i]);
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(targets[i],
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+	}
+
+	char msg[256];
+	snprintf(msg, sizeof(msg), "Probes '%s': %u probes, %u updated per frame with %u rays, every probe in %u frames\n",
+		mScene.ProbeVolumes[0].Name.c_str(), mProbeVolume->ProbeCount(), mProbeVolume->ProbesPerFrame(),
+		mProbeVolume->ProbesPerFrame() * desc.RaysPerProbe, mProbeVolume->FramesPerSweep());
+	::OutputDebugStringA(msg);
 }
 
 void NormalMapApp::BuildRandomStateBuffer()
@@ -2155,21 +3414,29 @@ void NormalMapApp::BuildRandomStateBuffer()
 	//vertexCount += mGeometries["box"]->VertexCount;
 	//vertexCount += mGeometries["grid"]->VertexCount;
 
-	random_device rd;
-	default_random_engine gen(rd());
-	// intial state number must larger than 128.
-	uniform_real_distribution<float> dis(0, 1);
-	uniform_int_distribution<> dis2(130, (numeric_limits<int>::max)());
+	// One engine per range of rows, all seeded from the same draw: the recording's when
+	// recording or replaying, so both runs trace the same samples, else a random one.
+	const unsigned seed = mInputRecording != nullptr ? mInputRecording->Seed() : random_device()();
 	vector<RandomState> intialStates(mClientWidth * mClientHeight);
-	for (auto& state : intialStates)
+	const UINT width = mClientWidth;
+	mJobs->ParallelFor(mClientHeight, 16, [&](std::uint32_t first, std::uint32_t last)
 	{
-		state.z1 = dis2(gen);
-		state.z2 = dis2(gen);
-		state.z3 = dis2(gen);
-		state.z4 = dis2(gen);
-		state.u = dis(gen);
-		state.v = dis(gen);
-	}
+		seed_seq seq{ seed, first };
+		default_random_engine gen(seq);
+		// intial state number must larger than 128.
+		uniform_real_distribution<float> dis(0, 1);
+		uniform_int_distribution<> dis2(130, (numeric_limits<int>::max)());
+		for (size_t i = size_t(first) * width; i < size_t(last) * width; ++i)
+		{
+			RandomState& state = intialStates[i];
+			state.z1 = dis2(gen);
+			state.z2 = dis2(gen);
+			state.z3 = dis2(gen);
+			state.z4 = dis2(gen);
+			state.u = dis(gen);
+			state.v = dis(gen);
+		}
+	});
 
 	copySource = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), intialStates.data(), intialStates.size() * sizeof(RandomState), uploader);
@@ -2177,14 +3444,8 @@ void NormalMapApp::BuildRandomStateBuffer()
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(copySource.Get(),
 		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE));
 
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(intialStates.size() * sizeof(RandomState), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		nullptr,
-		IID_PPV_ARGS(&mRandomStateBuffer)
-	));
+	mRandomStateBuffer = mResourceHeaps->CreateBuffer(intialStates.size() * sizeof(RandomState),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
 
 	mCommandList->CopyResource(mRandomStateBuffer.Get(), copySource.Get());
 
@@ -2211,14 +3472,7 @@ void NormalMapApp::BuildGBuffer()
 
 	for (int i = 0; i < 2; ++i)
 	{
-		mGBuffer.emplace_back(nullptr);
-		ThrowIfFailed(md3dDevice->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nullptr,
-			IID_PPV_ARGS(&mGBuffer[i])));
+		mGBuffer.push_back(mResourceHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 	}
 }
 
@@ -2240,23 +3494,25 @@ void NormalMapApp::CheckRaytracingSupport()
 NormalMapApp::AccelerationStructureBuffers
 NormalMapApp::CreateBottomLevelAS(
 	std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers,
-	std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vIndexBuffers)
+	std::vector<std::pair<ComPtr<ID3D12Resource>, uint32_t>> vIndexBuffers,
+	UINT vertexStride, DXGI_FORMAT vertexFormat,
+	ID3D12Resource* transformBuffer, UINT64 transformOffset, UINT startIndex)
 {
 	nv_helpers_dx12::BottomLevelASGenerator bottomLevelAS;
 
-	// Adding all vertex buffers and not transforming their position.
+	// Adding all vertex buffers, transforming their position only to dequantize packed vertices.
 	for (size_t i = 0; i < vVertexBuffers.size(); i++) {
 		// for (const auto &buffer : vVertexBuffers) {
 		if (i < vIndexBuffers.size() && vIndexBuffers[i].second > 0)
 			bottomLevelAS.AddVertexBuffer(vVertexBuffers[i].first.Get(), 0,
-				vVertexBuffers[i].second, sizeof(Vertex),
-				vIndexBuffers[i].first.Get(), 0,
-				vIndexBuffers[i].second, nullptr, 0, true);
+				vVertexBuffers[i].second, vertexStride,
+				vIndexBuffers[i].first.Get(), startIndex * sizeof(std::uint32_t),
+				vIndexBuffers[i].second, transformBuffer, transformOffset, true, vertexFormat);
 
 		else
 			bottomLevelAS.AddVertexBuffer(vVertexBuffers[i].first.Get(), 0,
-				vVertexBuffers[i].second, sizeof(Vertex), 0,
-				0);
+				vVertexBuffers[i].second, vertexStride, nullptr, 0,
+				0, transformBuffer, transformOffset, true, vertexFormat);
 	}
 
 	// The AS build requires some scratch space to store temporary information.
@@ -2273,15 +3529,11 @@ NormalMapApp::CreateBottomLevelAS(
 	// the necessary buffers. Since the entire generation will be done on the GPU,
 	// we can directly allocate those on the default heap
 	AccelerationStructureBuffers buffers;
-	buffers.pScratch = nv_helpers_dx12::CreateBuffer(
-		md3dDevice.Get(), scratchSizeInBytes,
-		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON,
-		nv_helpers_dx12::kDefaultHeapProps);
-	buffers.pResult = nv_helpers_dx12::CreateBuffer(
-		md3dDevice.Get(), resultSizeInBytes,
+	buffers.pScratch = mResourceHeaps->CreateBuffer(scratchSizeInBytes,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+	buffers.pResult = mResourceHeaps->CreateBuffer(resultSizeInBytes,
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-		nv_helpers_dx12::kDefaultHeapProps);
+		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
 
 	// Build the acceleration structure. Note that this call integrates a barrier
 	// on the generated AS, so that it can be used to compute a top-level AS right
@@ -2299,6 +3551,7 @@ NormalMapApp::CreateBottomLevelAS(
 // AS itself
 //
 void NormalMapApp::CreateTopLevelAS(
+	ID3D12GraphicsCommandList4* cmdList, // Command list the build is recorded into
 	const std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>
 	& instances, // pair of bottom level AS and matrix of the instance
 // #DXR Extra - Refitting
@@ -2325,14 +3578,12 @@ bool updateOnly // If true the top-level AS will only be refitted and not
 
 		// Create the scratch and result buffers. Since the build is all done on
 		// GPU, those can be allocated on the default heap
-		m_topLevelASBuffers.pScratch = nv_helpers_dx12::CreateBuffer(
-			md3dDevice.Get(), scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nv_helpers_dx12::kDefaultHeapProps);
-		m_topLevelASBuffers.pResult = nv_helpers_dx12::CreateBuffer(
-			md3dDevice.Get(), resultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-			nv_helpers_dx12::kDefaultHeapProps);
+		m_topLevelASBuffers.pScratch = mResourceHeaps->CreateBuffer(
+			scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		m_topLevelASBuffers.pResult = mResourceHeaps->CreateBuffer(
+			resultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
 
 		// The buffer describing the instances: ID, shader binding information,
 		// matrices ... Those will be copied into the buffer by the helper through
@@ -2345,7 +3596,7 @@ bool updateOnly // If true the top-level AS will only be refitted and not
 	// can build the acceleration structure. Note that in the case of the update
 	// we also pass the existing AS as the 'previous' AS, so that it can be
 	// refitted in place.
-	m_topLevelASGenerator.Generate(mCommandList.Get(),
+	m_topLevelASGenerator.Generate(cmdList,
 		m_topLevelASBuffers.pScratch.Get(),
 		m_topLevelASBuffers.pResult.Get(),
 		m_topLevelASBuffers.pInstanceDesc.Get(),
@@ -2354,31 +3605,149 @@ bool updateOnly // If true the top-level AS will only be refitted and not
 
 void NormalMapApp::BuildAccelerationStructure()
 {
-	MeshGeometry* grid = mGeometries["grid"].get();
-	m_bottomLevelASBuffers["grid"] = CreateBottomLevelAS(
-		{ { grid->VertexBufferGPU, grid->VertexCount } },
-		{ { grid->IndexBufferGPU, grid->IndexCount } }
-	).pResult;
+	// One BLAS per mesh, shared by every occluder that uses it.
+	std::vector<std::string> blasGeometries;
+	for (const auto& renderItem : mRitemLayer[(int)RenderLayer::BVH])
+	{
+		if (std::find(blasGeometries.begin(), blasGeometries.end(), renderItem->GeoName) == blasGeometries.end())
+			blasGeometries.push_back(renderItem->GeoName);
+	}
+	const UINT transformCount = (UINT)blasGeometries.size();
+
+	// Packed positions are snorm in [-1, 1] relative to the mesh bounds, so the BLAS
+	// build maps them back to object space with a row-major 3x4 transform per geometry.
+	// Each transform is 48 bytes, which keeps them 16-byte aligned as DXR requires.
+	const UINT64 transformSize = 12 * sizeof(float);
+	m_blasTransforms = nv_helpers_dx12::CreateBuffer(
+		md3dDevice.Get(), transformCount * transformSize, D3D12_RESOURCE_FLAG_NONE,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
 
-	MeshGeometry* model = mGeometries["model"].get();
-	m_bottomLevelASBuffers["model"] = CreateBottomLevelAS(
-		{ { model->VertexBufferGPU, model->VertexCount } },
-		{ { model->IndexBufferGPU, model->IndexCount } }
-	).pResult;
+	float* transforms = nullptr;
+	ThrowIfFailed(m_blasTransforms->Map(0, nullptr, reinterpret_cast<void**>(&transforms)));
+	for (UINT i = 0; i < transformCount; ++i)
+	{
+		MeshGeometry* geo = mGeometries[blasGeometries[i]].get();
+		const float transform[12] =
+		{
+			geo->PositionScale.x, 0.0f, 0.0f, geo->PositionBias.x,
+			0.0f, geo->PositionScale.y, 0.0f, geo->PositionBias.y,
+			0.0f, 0.0f, geo->PositionScale.z, geo->PositionBias.z,
+		};
+		memcpy(transforms + i * 12, transform, sizeof(transform));
+
+		// Only visibility rays hit the BLAS, so the occluder proxy stands in for the mesh.
+		SubmeshGeometry blasRange = geo->DrawArgs[blasGeometries[i]];
+		auto occluder = geo->DrawArgs.find(blasGeometries[i] + "_occluder");
+		if (mUseOccluderProxies && occluder != geo->DrawArgs.end())
+			blasRange = occluder->second;
+
+		AccelerationStructureBuffers blas = CreateBottomLevelAS(
+			{ { geo->VertexBufferGPU, geo->VertexCount } },
+			{ { geo->IndexBufferGPU, blasRange.IndexCount } },
+			geo->VertexByteStride,
+			geo->PackedVertices ? DXGI_FORMAT_R16G16B16A16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT,
+			geo->PackedVertices ? m_blasTransforms.Get() : nullptr,
+			i * transformSize,
+			blasRange.StartIndexLocation
+		);
+		m_bottomLevelASBuffers[blasGeometries[i]] = blas.pResult;
+		mBuildScratch.push_back(blas.pScratch);
+	}
+	m_blasTransforms->Unmap(0, nullptr);
 
-	MeshGeometry* box = mGeometries["box"].get();
-	m_bottomLevelASBuffers["box"] = CreateBottomLevelAS(
-		{ { box->VertexBufferGPU, box->VertexCount } },
-		{ { box->IndexBufferGPU, box->IndexCount } }
-	).pResult;
+	if (mUseOccluderProxies && mReportOccluderError)
+		ReportOccluderError();
 
 	for (const auto& renderItem : mRitemLayer[(int)RenderLayer::BVH])
 	{
 		std::string geoName = renderItem->GeoName;
-		m_instances.push_back({ m_bottomLevelASBuffers[geoName], renderItem->WorldMat });
+		m_instances.push_back({ m_bottomLevelASBuffers[geoName], XMLoadFloat4x4(&mTransforms.World(renderItem->TransformId)) });
+	}
+
+	CreateTopLevelAS(mCommandList.Get(), m_instances);
+}
+
+void NormalMapApp::ReportOccluderError()
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	CpuRayCaster full;
+	CpuRayCaster proxy;
+	std::vector<RenderItem*> receivers;
+	for (auto ri : mRitemLayer[(int)RenderLayer::BVH])
+	{
+		MeshGeometry* geo = ri->Geo;
+		auto occluder = geo->DrawArgs.find(ri->GeoName + "_occluder");
+		if (geo->VertexBufferCPU == nullptr || occluder == geo->DrawArgs.end())
+			continue;
+
+		const GeometryGenerator::Vertex* vertices = (const GeometryGenerator::Vertex*)geo->VertexBufferCPU->GetBufferPointer();
+		const std::uint32_t* indices = (const std::uint32_t*)geo->IndexBufferCPU->GetBufferPointer();
+		const XMFLOAT4X4& world = mTransforms.World(ri->TransformId);
+
+		full.AddMesh(vertices, indices, geo->IndexCount, world);
+		proxy.AddMesh(vertices, indices + occluder->second.StartIndexLocation, occluder->second.IndexCount, world);
+		receivers.push_back(ri);
+	}
+	full.Build();
+	proxy.Build();
+
+	auto buildTime = std::chrono::high_resolution_clock::now();
+
+	// Cosine distributed rays from a subset of the receiver vertices, like RayGen.hlsl.
+	const UINT maxOrigins = 512;
+	const UINT raysPerOrigin = 16;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+	std::uint64_t rays = 0;
+	std::uint64_t fullHits = 0;
+	std::uint64_t mismatches = 0;
+	for (auto ri : receivers)
+	{
+		const GeometryGenerator::Vertex* vertices = (const GeometryGenerator::Vertex*)ri->Geo->VertexBufferCPU->GetBufferPointer();
+		const XMMATRIX world = XMLoadFloat4x4(&mTransforms.World(ri->TransformId));
+		const UINT step = (std::max)(ri->Geo->VertexCount / maxOrigins, 1u);
+		for (UINT v = 0; v < ri->Geo->VertexCount; v += step)
+		{
+			XMFLOAT3 origin;
+			XMFLOAT3 normal;
+			XMStoreFloat3(&origin, XMVector3TransformCoord(XMLoadFloat3(&vertices[v].Position), world));
+			XMStoreFloat3(&normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertices[v].Normal), world)));
+
+			const XMVECTOR n = XMLoadFloat3(&normal);
+			const XMVECTOR up = std::fabs(normal.y) < 0.999f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+			const XMVECTOR tangent = XMVector3Normalize(XMVector3Cross(up, n));
+			const XMVECTOR bitangent = XMVector3Cross(n, tangent);
+
+			for (UINT r = 0; r < raysPerOrigin; ++r)
+			{
+				const float u = uniform(rng);
+				const float phi = XM_2PI * uniform(rng);
+				const float radius = std::sqrt(u);
+
+				XMFLOAT3 direction;
+				XMStoreFloat3(&direction, XMVector3Normalize(
+					radius * std::cos(phi) * tangent + radius * std::sin(phi) * bitangent + std::sqrt(1.0f - u) * n));
+
+				const bool fullHit = full.Occluded(origin, direction, 0.00001f, 1000000.0f);
+				const bool proxyHit = proxy.Occluded(origin, direction, 0.00001f, 1000000.0f);
+				++rays;
+				fullHits += fullHit ? 1 : 0;
+				mismatches += fullHit != proxyHit ? 1 : 0;
+			}
+		}
 	}
 
-	CreateTopLevelAS(m_instances);
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	const double rayCount = (double)(std::max)(rays, std::uint64_t(1));
+	char msg[256];
+	snprintf(msg, sizeof(msg), "Occluder proxies: %zu -> %zu triangles, %llu rays, %.2f%% occluded, %.2f%% visibility mismatch, build %.2f ms, trace %.2f ms\n",
+		full.TriangleCount(), proxy.TriangleCount(), (unsigned long long)rays, 100.0 * fullHits / rayCount, 100.0 * mismatches / rayCount,
+		std::chrono::duration<double, std::milli>(buildTime - startTime).count(),
+		std::chrono::duration<double, std::milli>(endTime - buildTime).count());
+	::OutputDebugStringA(msg);
 }
 
 //-----------------------------------------------------------------------------
@@ -2388,18 +3757,29 @@ ComPtr<ID3D12RootSignature> NormalMapApp::CreateRayGenSignature()
 {
 	nv_helpers_dx12::RootSignatureGenerator rsc;
 
-	if (mProjLTSpace != Space::ScreenSpace)
+	if (mProjLTSpace == Space::ProbeVolume)
+	{
+		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 2); // Probe volume constants
+		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_UAV, 0); // RWStructured buffer(environment SH)
+		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_UAV, 6); // RWStructured buffer(probe rays)
+		rsc.AddHeapRangesParameter({
+			{0 /*t0*/, 1/*1descriptor*/, 0/*space0*/, D3D12_DESCRIPTOR_RANGE_TYPE_SRV /*Top-level acceleration structure*/,
+				0/*table slot*/}
+			});
+	}
+	else if (mProjLTSpace != Space::ScreenSpace)
 	{
 		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 1); // Vertex buffer
 		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0); // Object Constant buffer
 		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 1); // Pass Constant buffer
 		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_UAV, 1); // RWStructured buffer(visibility)
 		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_UAV, 2); // RWStructured buffer(random state)
+		// Offsets into the table UpdateShaderBindingTables gathers.
 		rsc.AddHeapRangesParameter({
 			{3 /*u3*/, 1/*1descriptor*/, 0/*space0*/, D3D12_DESCRIPTOR_RANGE_TYPE_UAV /*RWTexture2D visibility4*/,
-				mTextureSpaceVisibility4UAVHeapIndex/*heap slot*/},
+				0/*table slot*/},
 			{0 /*t0*/, 1/*1descriptor*/, 0/*space0*/, D3D12_DESCRIPTOR_RANGE_TYPE_SRV /*Top-level acceleration structure*/,
-				mAccelerationStructureHeapIndex/*heap slot*/}
+				1/*table slot*/}
 			});
 	}
 	else
@@ -2407,11 +3787,11 @@ ComPtr<ID3D12RootSignature> NormalMapApp::CreateRayGenSignature()
 		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_UAV, 1); // RWStructured buffer(random state)
 		rsc.AddHeapRangesParameter({
 			{0 /*u0*/, 1/*1descriptor*/, 0/*space0*/, D3D12_DESCRIPTOR_RANGE_TYPE_UAV /*RWTexture2D visibility4*/,
-				mScreenSpaceThisFrameSHCoeffsHeapIndex + 8/*heap slot*/},
+				0/*table slot*/},
 			{2 /*u2*/, 2/*2descriptor*/, 0/*space0*/, D3D12_DESCRIPTOR_RANGE_TYPE_UAV /*RWTexture2D GBuffer positions*/,
-				mGBufferHeapIndex/*heap slot*/},
+				1/*table slot*/},
 			{0 /*t0*/, 1/*1descriptor*/, 0/*space0*/, D3D12_DESCRIPTOR_RANGE_TYPE_SRV /*Top-level acceleration structure*/,
-				mAccelerationStructureHeapIndex/*heap slot*/}
+				3/*table slot*/}
 			});
 	}
 
@@ -2450,18 +3830,10 @@ void NormalMapApp::CreateRaytracingPipeline()
 	nv_helpers_dx12::RayTracingPipelineGenerator pipeline(md3dDevice.Get());
 
 	// The pipeline contains the DXIL code of all the shaders potentially executed
-	// during the raytracing process. This section compiles the HLSL code into a
-	// set of DXIL libraries. We chose to separate the code in several libraries
-	// by semantic (ray generation, hit, miss) for clarity. Any code layout can be
-	// used.
-
-	if (mProjLTSpace == Space::ScreenSpace)
-		m_rayGenLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayGenPerPixel.hlsl");
-	else
-		m_rayGenLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\RayGen.hlsl");
-	m_textureSpaceRayGenLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\TextureSpaceRayGen.hlsl");
-	m_missLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\Miss.hlsl");
-	m_hitLibrary = nv_helpers_dx12::CompileShaderLibrary(L"Shaders\\Hit.hlsl");
+	// during the raytracing process. BuildShadersAndInputLayout compiles the HLSL code
+	// into a set of DXIL libraries along with the other shaders. We chose to separate
+	// the code in several libraries by semantic (ray generation, hit, miss) for
+	// clarity. Any code layout can be used.
 
 	// In a way similar to DLLs, each library is associated with a number of exported symbols. This
 	// has to be done explicitly in the lines below. Note that a single library
@@ -2469,6 +3841,8 @@ void NormalMapApp::CreateRaytracingPipeline()
 	// using the [shader("xxx")] syntax
 	if (mProjLTSpace == Space::TextureSpace)
 		pipeline.AddLibrary(m_textureSpaceRayGenLibrary.Get(), { L"RayGen" });
+	else if (mProjLTSpace == Space::ProbeVolume)
+		pipeline.AddLibrary(m_probeRayGenLibrary.Get(), { L"RayGen" });
 	else
 		pipeline.AddLibrary(m_rayGenLibrary.Get(), { L"RayGen" });
 	pipeline.AddLibrary(m_missLibrary.Get(), { L"Miss" });
@@ -2495,7 +3869,7 @@ void NormalMapApp::CreateRaytracingPipeline()
 	// exchanged between shaders, such as the HitInfo structure in the HLSL code.
 	// It is important to keep this value as low as possible as a too high value
 	// would result in unnecessary memory consumption and cache trashing.
-	pipeline.SetMaxPayloadSize(sizeof(int)); // visibility term
+	pipeline.SetMaxPayloadSize(2 * sizeof(float)); // visibility term, hit distance
 
 	// Upon hitting a surface, DXR can provide several attributes to the hit. In
 	// our sample we just use the barycentric coordinates defined by the weights
@@ -2526,16 +3900,14 @@ void NormalMapApp::CreateRaytracingPipeline()
 // contains the ray generation shader, the miss shaders, then the hit groups.
 // Using the helper class, those can be specified in arbitrary order.
 //
-void NormalMapApp::CreateShaderBindingTable(int diffuseRTIndex)
+UploadAllocator::Allocation NormalMapApp::CreateShaderBindingTable(int diffuseRTIndex)
 {
 	// The SBT helper class collects calls to Add*Program.  If called several
 	// times, the helper must be emptied before re-adding shaders.
 	m_sbtHelper.Reset();
 
-	// The pointer to the beginning of the heap is the only parameter required by
-	// shaders without root parameters
-	D3D12_GPU_DESCRIPTOR_HANDLE srvUavHeapHandle =
-		mDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+	// The ray generation shader's descriptor table, gathered for this frame.
+	D3D12_GPU_DESCRIPTOR_HANDLE srvUavHeapHandle = mRayGenTable;
 
 	// The helper treats both root parameter pointers and heap pointers as void*,
 	// while DX12 uses the
@@ -2543,21 +3915,16 @@ void NormalMapApp::CreateShaderBindingTable(int diffuseRTIndex)
 	// struct is a UINT64, which then has to be reinterpreted as a pointer.
 	auto heapPointer = reinterpret_cast<UINT64*>(srvUavHeapHandle.ptr);
 
+	if (diffuseRTIndex < 0 || diffuseRTIndex >= (int)mRitemLayer[(int)RenderLayer::DiffuseRTTest].size())
+		throw std::runtime_error("wrong diffuseRTIndex");
+
 	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
 
-	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + 
+	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = mObjectCBAddress +
 		mRitemLayer[(int)RenderLayer::DiffuseRTTest][diffuseRTIndex]->ObjCBIndex * objCBByteSize;
 
-	D3D12_GPU_VIRTUAL_ADDRESS vertexAdress;
-	if (diffuseRTIndex == 0)
-		vertexAdress = mGeometries["model"].get()->VertexBufferGPU->GetGPUVirtualAddress();
-	else if (diffuseRTIndex == 1)
-		vertexAdress = mGeometries["box"].get()->VertexBufferGPU->GetGPUVirtualAddress();
-	else if (diffuseRTIndex == 2)
-		vertexAdress = mGeometries["grid"].get()->VertexBufferGPU->GetGPUVirtualAddress();
-	else
-		throw std::runtime_error("wrong diffuseRTIndex");
+	D3D12_GPU_VIRTUAL_ADDRESS vertexAdress =
+		mRitemLayer[(int)RenderLayer::DiffuseRTTest][diffuseRTIndex]->Geo->VertexBufferGPU->GetGPUVirtualAddress();
 
 
 	if (mProjLTSpace == Space::ScreenSpace)
@@ -2567,12 +3934,21 @@ void NormalMapApp::CreateShaderBindingTable(int diffuseRTIndex)
 			heapPointer 
 			});
 	}
+	else if (mProjLTSpace == Space::ProbeVolume)
+	{
+		m_sbtHelper.AddRayGenerationProgram(L"RayGen", {
+			(void*)mProbeCBAddress,
+			(void*)mEnvCoeffs->GetGPUVirtualAddress(),
+			(void*)mProbeRays->GetGPUVirtualAddress(),
+			heapPointer
+			});
+	}
 	else
 	{
 		m_sbtHelper.AddRayGenerationProgram(L"RayGen", {
 			(void*)vertexAdress,
 			(void*)objCBAddress,
-			(void*)mCurrFrameResource->PassCB->Resource()->GetGPUVirtualAddress(),
+			(void*)mPassCBAddress,
 			(void*)mVisibilityBuffer->GetGPUVirtualAddress(),
 			(void*)mRandomStateBuffer->GetGPUVirtualAddress(),
 			heapPointer
@@ -2588,30 +3964,28 @@ void NormalMapApp::CreateShaderBindingTable(int diffuseRTIndex)
 	// parameters
 	uint32_t sbtSize = m_sbtHelper.ComputeSBTSize();
 
-	// Create the SBT on the upload heap. This is required as the helper will use
-	// mapping to write the SBT contents. After the SBT compilation it could be
-	// copied to the default heap for performance.
-	m_sbtStorage = nv_helpers_dx12::CreateBuffer(
-		md3dDevice.Get(), sbtSize, D3D12_RESOURCE_FLAG_NONE,
-		D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
-	if (!m_sbtStorage) {
-		throw std::logic_error("Could not allocate the shader binding table");
-	}
+	// Take the SBT from the upload ring, where the helper writes it directly.  The
+	// table must start on D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT, which the
+	// constant buffer alignment covers.
+	UploadAllocator::Allocation sbt = mUploads->Allocate(sbtSize);
+
 	// Compile the SBT from the shader and parameters info
-	m_sbtHelper.Generate(m_sbtStorage.Get(), m_rtStateObjectProps.Get());
+	m_sbtHelper.Generate(sbt.CpuAddress, m_rtStateObjectProps.Get());
+	return sbt;
 }
 
-void NormalMapApp::CalcVisibilityTerm()
+void NormalMapApp::CalcVisibilityTerm(ID3D12GraphicsCommandList4* cmdList)
 {
 	// #DXR - Refitting
 	// Refit the top-level acceleration structure to account for the new transform matrix of the triangle. 
-	CreateTopLevelAS(m_instances, true);	
+	CreateTopLevelAS(cmdList, m_instances, true);	
 
-	const std::array<UINT, 3> widths { mGeometries["model"]->VertexCount, mGeometries["box"]->VertexCount, mGeometries["grid"]->VertexCount };
+	const std::vector<RenderItem*>& receivers = mRitemLayer[(int)RenderLayer::DiffuseRTTest];
 
-	for (int i = 0; i < 3; ++i)
+	for (int i = 0; i < (int)mShaderBindingTables.size(); ++i)
 	{
-		CreateShaderBindingTable(i);
+		// Built in Update; every table has the layout m_sbtHelper was left with.
+		const D3D12_GPU_VIRTUAL_ADDRESS sbtAddress = mShaderBindingTables[i].GpuAddress;
 
 		// Setup the raytracing task
 		D3D12_DISPATCH_RAYS_DESC desc = {};
@@ -2624,7 +3998,7 @@ void NormalMapApp::CalcVisibilityTerm()
 		uint32_t rayGenerationSectionSizeInBytes =
 			m_sbtHelper.GetRayGenSectionSize();
 		desc.RayGenerationShaderRecord.StartAddress =
-			m_sbtStorage->GetGPUVirtualAddress();
+			sbtAddress;
 		desc.RayGenerationShaderRecord.SizeInBytes =
 			rayGenerationSectionSizeInBytes;
 
@@ -2632,14 +4006,14 @@ void NormalMapApp::CalcVisibilityTerm()
 		// generation shader. We have one miss shader. 
 		uint32_t missSectionSizeInBytes = m_sbtHelper.GetMissSectionSize();
 		desc.MissShaderTable.StartAddress =
-			m_sbtStorage->GetGPUVirtualAddress() + rayGenerationSectionSizeInBytes;
+			sbtAddress + rayGenerationSectionSizeInBytes;
 		desc.MissShaderTable.SizeInBytes = missSectionSizeInBytes;
 		desc.MissShaderTable.StrideInBytes = m_sbtHelper.GetMissEntrySize();
 
 		// The hit groups section start after the miss shaders. In this sample we
 		// have one 1 hit group for the triangle
 		uint32_t hitGroupsSectionSize = m_sbtHelper.GetHitGroupSectionSize();
-		desc.HitGroupTable.StartAddress = m_sbtStorage->GetGPUVirtualAddress() +
+		desc.HitGroupTable.StartAddress = sbtAddress +
 			rayGenerationSectionSizeInBytes + missSectionSizeInBytes;
 		desc.HitGroupTable.SizeInBytes = hitGroupsSectionSize;
 		desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
@@ -2650,20 +4024,30 @@ void NormalMapApp::CalcVisibilityTerm()
 			desc.Height = mClientHeight;
 			desc.Depth = 1;
 			// Bind the raytracing pipeline
-			mCommandList->SetPipelineState1(m_rtStateObject.Get());
+			cmdList->SetPipelineState1(m_rtStateObject.Get());
 			// Dispatch the rays and write to the raytracing output
-			mCommandList->DispatchRays(&desc);
+			cmdList->DispatchRays(&desc);
+			break;
+		}
+		else if (mProjLTSpace == Space::ProbeVolume)
+		{
+			// A fixed number of rays, however many receivers and pixels there are.
+			desc.Width = mProbeVolume->GetDesc().RaysPerProbe;
+			desc.Height = mProbeVolume->ProbesPerFrame();
+			desc.Depth = 1;
+			cmdList->SetPipelineState1(m_rtStateObject.Get());
+			cmdList->DispatchRays(&desc);
 			break;
 		}
 		else
 		{
-			desc.Width = widths[i];
+			desc.Width = receivers[i]->Geo->VertexCount;
 			desc.Height = 1;
 			desc.Depth = 1;
 			// Bind the raytracing pipeline
-			mCommandList->SetPipelineState1(m_rtStateObject.Get());
+			cmdList->SetPipelineState1(m_rtStateObject.Get());
 			// Dispatch the rays and write to the raytracing output
-			mCommandList->DispatchRays(&desc);
+			cmdList->DispatchRays(&desc);
 		}
 	}
 }
@@ -2672,8 +4056,6 @@ void NormalMapApp::DrawRenderItemsInstanced(ID3D12GraphicsCommandList* cmdList,
 {
 	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-
 	// For each render item...
 	for (size_t i = 0; i < ritems.size(); ++i)
 	{
@@ -2684,7 +4066,7 @@ void NormalMapApp::DrawRenderItemsInstanced(ID3D12GraphicsCommandList* cmdList,
 		cmdList->IASetIndexBuffer(nullptr);
 		cmdList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = mObjectCBAddress + ri->ObjCBIndex * objCBByteSize;
 
 		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
@@ -2692,35 +4074,34 @@ void NormalMapApp::DrawRenderItemsInstanced(ID3D12GraphicsCommandList* cmdList,
 	}
 }
 
-void NormalMapApp::DrawSceneToDepthMap()
+void NormalMapApp::DrawSceneToDepthMap(ID3D12GraphicsCommandList* cmdList)
 {
-	mCommandList->RSSetViewports(1, &mDepthMap->Viewport());
-	mCommandList->RSSetScissorRects(1, &mDepthMap->ScissorRect());
+	cmdList->RSSetViewports(1, &mDepthMap->Viewport());
+	cmdList->RSSetScissorRects(1, &mDepthMap->ScissorRect());
 
 	// Change to DEPTH_WRITE.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthMap->Resource(),
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthMap->Resource(),
 		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE));
 
 	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
 
 	// Clear the depth buffer.
-	mCommandList->ClearDepthStencilView(mDepthMap->Dsv(),
+	cmdList->ClearDepthStencilView(mDepthMap->Dsv(),
 		D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
 	// Set null render target because we are only going to draw to
 	// depth buffer.  Setting a null render target will disable color writes.
 	// Note the active PSO also must specify a render target count of 0.
-	mCommandList->OMSetRenderTargets(0, nullptr, false, &mDepthMap->Dsv());
+	cmdList->OMSetRenderTargets(0, nullptr, false, &mDepthMap->Dsv());
 
 	// Bind the pass constant buffer for the shadow map pass.
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootConstantBufferView(1, mPassCBAddress);
 
-	mCommandList->SetPipelineState(mPSOs["draw_depth"].Get());
+	cmdList->SetPipelineState(mPSOs.at("draw_depth").Get());
 
-	DrawRenderItemsIndexedInstanced(mCommandList.Get(), mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
+	DrawRenderItemsCulled(cmdList, mRitemLayer[(int)RenderLayer::DiffuseRTTest]);
 
 	// Change back to GENERIC_READ so we can read the texture in a shader.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthMap->Resource(),
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthMap->Resource(),
 		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ));
 }
\ No newline at end of file
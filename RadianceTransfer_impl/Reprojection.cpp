@@ -0,0 +1,51 @@
+#include "Reprojection.h"
+
+using namespace DirectX;
+
+namespace
+{
+	struct Float4
+	{
+		float v[4];
+	};
+
+	// Row vector times the matrix 'm', row-major or given transposed.
+	Float4 Multiply(const Float4& p, const XMFLOAT4X4& m, bool transposed)
+	{
+		Float4 r;
+		for (int j = 0; j < 4; ++j)
+		{
+			r.v[j] = 0.0f;
+			for (int i = 0; i < 4; ++i)
+				r.v[j] += p.v[i] * (transposed ? m.m[j][i] : m.m[i][j]);
+		}
+		return r;
+	}
+
+	XMFLOAT2 ToPixel(const Float4& clip, std::uint32_t width, std::uint32_t height)
+	{
+		// As the shader does it: NDC to [0, 1] with y flipped, since the viewport's origin
+		// is at the top left, then to pixels.
+		const float x = clip.v[0] / clip.v[3];
+		const float y = clip.v[1] / clip.v[3];
+		return XMFLOAT2((x + 1.0f) / 2.0f * width, (-y + 1.0f) / 2.0f * height);
+	}
+}
+
+XMFLOAT2 Reprojection::ProjectPixel(const XMFLOAT3& positionW, const XMFLOAT4X4& viewProj,
+	uint32 width, uint32 height)
+{
+	const Float4 p = { { positionW.x, positionW.y, positionW.z, 1.0f } };
+	return ToPixel(Multiply(p, viewProj, false), width, height);
+}
+
+XMFLOAT2 Reprojection::ReprojectPixel(const XMFLOAT3& positionW, const XMFLOAT4X4& invWorldT,
+	const XMFLOAT4X4& lastFrameWorldT, const XMFLOAT4X4& lastFrameViewProjT,
+	uint32 width, uint32 height)
+{
+	Float4 p = { { positionW.x, positionW.y, positionW.z, 1.0f } };
+	p = Multiply(p, invWorldT, true);
+	p = Multiply(p, lastFrameWorldT, true);
+	p = Multiply(p, lastFrameViewProjT, true);
+	return ToPixel(p, width, height);
+}
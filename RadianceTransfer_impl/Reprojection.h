@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+#include <DirectXMath.h>
+
+// CPU reference for the temporal reprojection in TemporalFilter.hlsl: where the surface
+// seen at a pixel this frame was on screen the frame before.  The matrices are taken as
+// the shaders get them, transposed for column-major HLSL, so checking against it covers
+// what the app writes into the buffers as well as the math.
+namespace Reprojection
+{
+	using uint32 = std::uint32_t;
+
+	// Pixel position, origin at the top left, of world position 'positionW' under the
+	// row-major 'viewProj'.
+	DirectX::XMFLOAT2 ProjectPixel(const DirectX::XMFLOAT3& positionW, const DirectX::XMFLOAT4X4& viewProj,
+		uint32 width, uint32 height);
+
+	// The pixel TemporalFilter.hlsl fetches last frame's color from for G-buffer position
+	// 'positionW': back to object space with this frame's inverse world, then out with
+	// last frame's world and view-projection.
+	DirectX::XMFLOAT2 ReprojectPixel(const DirectX::XMFLOAT3& positionW, const DirectX::XMFLOAT4X4& invWorldT,
+		const DirectX::XMFLOAT4X4& lastFrameWorldT, const DirectX::XMFLOAT4X4& lastFrameViewProjT,
+		uint32 width, uint32 height);
+}
@@ -0,0 +1,175 @@
+#include "SHBasis.h"
+
+#include <stdexcept>
+
+namespace SHBasis
+{
+
+namespace
+{
+
+// Each adds one band to the bands below it, as sh_eval_basis_N calls N - 1.  The sines
+// and cosines of m * phi times sin^m theta come from the angle sum recurrence.
+
+void EvalBasis1(const float v[3], float b[4])
+{
+	b[0] = 0.282094791773878140f;
+	b[2] = 0.488602511902919920f * v[2];
+
+	const float s1 = v[1];
+	const float c1 = v[0];
+	const float p_1_1 = -0.488602511902919920f;
+	b[1] = p_1_1 * s1;
+	b[3] = p_1_1 * c1;
+}
+
+void EvalBasis2(const float v[3], float b[9])
+{
+	EvalBasis1(v, b);
+
+	const float z2 = v[2] * v[2];
+	b[6] = 0.946174695757560080f * z2 - 0.315391565252520050f;
+
+	const float s1 = v[1];
+	const float c1 = v[0];
+	const float p_2_1 = -1.092548430592079200f * v[2];
+	b[5] = p_2_1 * s1;
+	b[7] = p_2_1 * c1;
+
+	const float s2 = v[0] * s1 + v[1] * c1;
+	const float c2 = v[0] * c1 - v[1] * s1;
+	const float p_2_2 = 0.546274215296039590f;
+	b[4] = p_2_2 * s2;
+	b[8] = p_2_2 * c2;
+}
+
+void EvalBasis3(const float v[3], float b[16])
+{
+	EvalBasis2(v, b);
+
+	const float z2 = v[2] * v[2];
+	b[12] = v[2] * (1.865881662950577000f * z2 - 1.119528997770346200f);
+
+	const float s1 = v[1];
+	const float c1 = v[0];
+	const float p_3_1 = -2.285228997322328800f * z2 + 0.457045799464465770f;
+	b[11] = p_3_1 * s1;
+	b[13] = p_3_1 * c1;
+
+	const float s2 = v[0] * s1 + v[1] * c1;
+	const float c2 = v[0] * c1 - v[1] * s1;
+	const float p_3_2 = 1.445305721320277100f * v[2];
+	b[10] = p_3_2 * s2;
+	b[14] = p_3_2 * c2;
+
+	const float s3 = v[0] * s2 + v[1] * c2;
+	const float c3 = v[0] * c2 - v[1] * s2;
+	const float p_3_3 = -0.590043589926643520f;
+	b[9] = p_3_3 * s3;
+	b[15] = p_3_3 * c3;
+}
+
+void EvalBasis4(const float v[3], float b[25])
+{
+	EvalBasis3(v, b);
+
+	const float z2 = v[2] * v[2];
+	const float p_2_0 = 0.946174695757560080f * z2 - 0.315391565252520050f;
+	const float p_3_0 = v[2] * (1.865881662950577000f * z2 - 1.119528997770346200f);
+	b[20] = 1.984313483298443000f * v[2] * p_3_0 - 1.006230589874905300f * p_2_0;
+
+	const float s1 = v[1];
+	const float c1 = v[0];
+	const float p_4_1 = v[2] * (-4.683325804901024000f * z2 + 2.007139630671867200f);
+	b[19] = p_4_1 * s1;
+	b[21] = p_4_1 * c1;
+
+	const float s2 = v[0] * s1 + v[1] * c1;
+	const float c2 = v[0] * c1 - v[1] * s1;
+	const float p_4_2 = 3.311611435151459800f * z2 - 0.473087347878779980f;
+	b[18] = p_4_2 * s2;
+	b[22] = p_4_2 * c2;
+
+	const float s3 = v[0] * s2 + v[1] * c2;
+	const float c3 = v[0] * c2 - v[1] * s2;
+	const float p_4_3 = -1.770130769779930200f * v[2];
+	b[17] = p_4_3 * s3;
+	b[23] = p_4_3 * c3;
+
+	const float s4 = v[0] * s3 + v[1] * c3;
+	const float c4 = v[0] * c3 - v[1] * s3;
+	const float p_4_4 = 0.625835735449176030f;
+	b[16] = p_4_4 * s4;
+	b[24] = p_4_4 * c4;
+}
+
+void EvalBasis5(const float v[3], float b[36])
+{
+	EvalBasis4(v, b);
+
+	const float z2 = v[2] * v[2];
+	const float p_2_0 = 0.946174695757560080f * z2 - 0.315391565252520050f;
+	const float p_3_0 = v[2] * (1.865881662950577000f * z2 - 1.119528997770346200f);
+	const float p_4_0 = 1.984313483298443000f * v[2] * p_3_0 - 1.006230589874905300f * p_2_0;
+	b[30] = 1.989974874213239700f * v[2] * p_4_0 - 1.002853072844814000f * p_3_0;
+
+	const float s1 = v[1];
+	const float c1 = v[0];
+	const float p_3_1 = -2.285228997322328800f * z2 + 0.457045799464465770f;
+	const float p_4_1 = v[2] * (-4.683325804901024000f * z2 + 2.007139630671867200f);
+	const float p_5_1 = 2.031009601158990200f * v[2] * p_4_1 - 0.991031208965114650f * p_3_1;
+	b[29] = p_5_1 * s1;
+	b[31] = p_5_1 * c1;
+
+	const float s2 = v[0] * s1 + v[1] * c1;
+	const float c2 = v[0] * c1 - v[1] * s1;
+	const float p_5_2 = v[2] * (7.190305177459987500f * z2 - 2.396768392486662100f);
+	b[28] = p_5_2 * s2;
+	b[32] = p_5_2 * c2;
+
+	const float s3 = v[0] * s2 + v[1] * c2;
+	const float c3 = v[0] * c2 - v[1] * s2;
+	const float p_5_3 = -4.403144694917253700f * z2 + 0.489238299435250430f;
+	b[27] = p_5_3 * s3;
+	b[33] = p_5_3 * c3;
+
+	const float s4 = v[0] * s3 + v[1] * c3;
+	const float c4 = v[0] * c3 - v[1] * s3;
+	const float p_5_4 = 2.075662314881041100f * v[2];
+	b[26] = p_5_4 * s4;
+	b[34] = p_5_4 * c4;
+
+	const float s5 = v[0] * s4 + v[1] * c4;
+	const float c5 = v[0] * c4 - v[1] * s4;
+	const float p_5_5 = -0.656382056840170150f;
+	b[25] = p_5_5 * s5;
+	b[35] = p_5_5 * c5;
+}
+
+} // namespace
+
+void Eval(uint32 order, const float d[3], float* basis)
+{
+	switch (order)
+	{
+	case 1: basis[0] = 0.282094791773878140f; break;
+	case 2: EvalBasis1(d, basis); break;
+	case 3: EvalBasis2(d, basis); break;
+	case 4: EvalBasis3(d, basis); break;
+	case 5: EvalBasis4(d, basis); break;
+	case 6: EvalBasis5(d, basis); break;
+	default: throw std::logic_error("SH order out of range");
+	}
+}
+
+void EvalMany(uint32 order, const float* directions, uint32 count, float* basis)
+{
+	if (order == 0 || order > MaxOrder)
+		throw std::logic_error("SH order out of range");
+
+	const uint32 stride = CoeffCount(order);
+	for (uint32 i = 0; i < count; ++i)
+		Eval(order, directions + i * 3, basis + i * stride);
+}
+
+} // namespace SHBasis
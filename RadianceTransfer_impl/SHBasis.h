@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// The real SH basis as the shaders evaluate it with sh_eval_basis_N (SHUtil.hlsl): the
+// same constants, recurrences and coefficient order, coefficient l * l + l + m for band
+// l.  An order n basis has the n * n coefficients of bands 0 to n - 1; the shaders go up
+// to order 6.  For CPU references and tools that must agree with the GPU.
+namespace SHBasis
+{
+	using uint32 = std::uint32_t;
+
+	const uint32 MaxOrder = 6;
+
+	inline uint32 CoeffCount(uint32 order) { return order * order; }
+
+	// 'd' must be unit length; writes CoeffCount(order) values to 'basis'.  Throws
+	// std::logic_error for orders outside [1, MaxOrder].
+	void Eval(uint32 order, const float d[3], float* basis);
+
+	// One direction per three floats of 'directions', CoeffCount(order) values each to
+	// 'basis'.
+	void EvalMany(uint32 order, const float* directions, uint32 count, float* basis);
+}
@@ -0,0 +1,453 @@
+#include "SceneDesc.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace
+{
+	// Finite numbers separated by commas, with nothing empty between or after them.
+	bool ParseFloats(const std::string& text, std::vector<float>& values)
+	{
+		values.clear();
+		if (!text.empty() && text.back() == ',')
+			return false;
+		std::stringstream ss(text);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			char* end = nullptr;
+			const float value = std::strtof(item.c_str(), &end);
+			if (item.empty() || *end != '\0' || !std::isfinite(value))
+				return false;
+			values.push_back(value);
+		}
+		return !values.empty();
+	}
+
+	// Whole numbers from 1 to 'limit'.
+	bool ParseCounts(const std::string& text, std::vector<std::uint32_t>& counts, float limit)
+	{
+		std::vector<float> values;
+		if (!ParseFloats(text, values))
+			return false;
+		counts.clear();
+		for (float value : values)
+		{
+			if (!(value >= 1.0f && value <= limit) || value != float(std::uint32_t(value)))
+				return false;
+			counts.push_back(std::uint32_t(value));
+		}
+		return true;
+	}
+
+	bool ParseBool(const std::string& text, bool& value)
+	{
+		if (text == "1" || text == "true")
+			value = true;
+		else if (text == "0" || text == "false")
+			value = false;
+		else
+			return false;
+		return true;
+	}
+
+	bool HasExtension(const std::string& path, const char* extension)
+	{
+		const size_t length = std::char_traits<char>::length(extension);
+		if (path.size() < length)
+			return false;
+		for (size_t i = 0; i < length; ++i)
+		{
+			if (std::tolower((unsigned char)path[path.size() - length + i]) != extension[i])
+				return false;
+		}
+		return true;
+	}
+
+	struct Shape
+	{
+		const char* Key;
+		SceneDesc::Shape Type;
+		size_t MinParams;
+		size_t MaxParams;
+	};
+
+	const Shape kShapes[] =
+	{
+		{ "box", SceneDesc::Shape::Box, 4, 4 },
+		{ "sphere", SceneDesc::Shape::Sphere, 3, 3 },
+		{ "cylinder", SceneDesc::Shape::Cylinder, 5, 5 },
+		{ "quad", SceneDesc::Shape::Quad, 5, 5 },
+		{ "grid", SceneDesc::Shape::Grid, 4, 4 },
+		{ "adaptivegrid", SceneDesc::Shape::AdaptiveGrid, 2, 5 },
+	};
+
+	// Parses one declaration into 'scene', returning an empty string or the problem.
+	std::string ParseLine(const std::vector<std::string>& tokens, SceneDesc& scene)
+	{
+		const std::string& kind = tokens[0];
+		if (tokens.size() < 2)
+			return kind + " needs a name";
+		const std::string& name = tokens[1];
+
+		std::map<std::string, std::string> attributes;
+		for (size_t i = 2; i < tokens.size(); ++i)
+		{
+			const size_t eq = tokens[i].find('=');
+			if (eq == std::string::npos || eq == 0)
+				return "expected key=value, got '" + tokens[i] + "'";
+			const std::string key = tokens[i].substr(0, eq);
+			if (!attributes.insert(std::make_pair(key, tokens[i].substr(eq + 1))).second)
+				return "attribute '" + key + "' given twice";
+		}
+
+		std::vector<float> values;
+		auto take = [&](const char* key, std::string& value)
+		{
+			auto it = attributes.find(key);
+			if (it == attributes.end())
+				return false;
+			value = it->second;
+			attributes.erase(it);
+			return true;
+		};
+
+		std::string value;
+		if (kind == "texture")
+		{
+			if (scene.FindTexture(name))
+				return "texture '" + name + "' declared twice";
+			SceneDesc::Texture texture;
+			texture.Name = name;
+			if (!take("file", texture.File))
+				return "texture '" + name + "' needs file=";
+			if (take("cube", value) && !ParseBool(value, texture.Cube))
+				return "bad cube=" + value;
+			texture.LatLong = HasExtension(texture.File, ".hdr");
+			if (texture.LatLong && !texture.Cube)
+				return "texture '" + name + "' is a lat-long .hdr image, which only cube textures take";
+			if (take("size", value))
+			{
+				// Cube faces are at most 16384 texels wide in D3D12.
+				if (!ParseFloats(value, values) || values.size() != 1 || values[0] < 1.0f || values[0] > 16384.0f ||
+					values[0] != float(std::uint32_t(values[0])) || (std::uint32_t(values[0]) & (std::uint32_t(values[0]) - 1)) != 0)
+					return "bad size=" + value + ", expected a power of two";
+				if (!texture.LatLong)
+					return "size= only applies to .hdr cube textures";
+				texture.CubeSize = std::uint32_t(values[0]);
+			}
+			scene.Textures.push_back(texture);
+		}
+		else if (kind == "material")
+		{
+			if (scene.FindMaterial(name))
+				return "material '" + name + "' declared twice";
+			SceneDesc::Material material;
+			material.Name = name;
+			const char* maps[] = { "diffuse", "normal" };
+			std::string* targets[] = { &material.DiffuseMap, &material.NormalMap };
+			for (int i = 0; i < 2; ++i)
+			{
+				if (!take(maps[i], *targets[i]))
+					continue;
+				const SceneDesc::Texture* texture = scene.FindTexture(*targets[i]);
+				if (!texture)
+					return "unknown texture '" + *targets[i] + "'";
+				if (texture->Cube)
+					return "material maps must be 2D textures, '" + *targets[i] + "' is a cube";
+			}
+			if (take("albedo", value))
+			{
+				if (!ParseFloats(value, values) || values.size() != 4)
+					return "bad albedo=" + value;
+				material.DiffuseAlbedo = XMFLOAT4(values[0], values[1], values[2], values[3]);
+			}
+			if (take("fresnel", value))
+			{
+				if (!ParseFloats(value, values) || (values.size() != 1 && values.size() != 3))
+					return "bad fresnel=" + value;
+				material.FresnelR0 = values.size() == 1 ? XMFLOAT3(values[0], values[0], values[0])
+					: XMFLOAT3(values[0], values[1], values[2]);
+			}
+			if (take("roughness", value))
+			{
+				if (!ParseFloats(value, values) || values.size() != 1)
+					return "bad roughness=" + value;
+				material.Roughness = values[0];
+			}
+			scene.Materials.push_back(material);
+		}
+		else if (kind == "mesh")
+		{
+			if (scene.FindMesh(name))
+				return "mesh '" + name + "' declared twice";
+			SceneDesc::Mesh mesh;
+			mesh.Name = name;
+			int shapes = 0;
+			if (take("model", mesh.File))
+			{
+				mesh.Type = SceneDesc::Shape::Model;
+				++shapes;
+			}
+			for (const Shape& shape : kShapes)
+			{
+				if (!take(shape.Key, value))
+					continue;
+				if (!ParseFloats(value, mesh.Params) || mesh.Params.size() < shape.MinParams ||
+					mesh.Params.size() > shape.MaxParams)
+					return std::string("bad ") + shape.Key + "=" + value;
+				mesh.Type = shape.Type;
+				++shapes;
+			}
+			if (shapes != 1)
+				return "mesh '" + name + "' needs exactly one shape";
+			if (take("pack", value) && !ParseBool(value, mesh.Pack))
+				return "bad pack=" + value;
+			if (take("lods", value) && !ParseBool(value, mesh.Lods))
+				return "bad lods=" + value;
+			scene.Meshes.push_back(mesh);
+		}
+		else if (kind == "object")
+		{
+			for (const SceneDesc::Object& other : scene.Objects)
+				if (other.Name == name)
+					return "object '" + name + "' declared twice";
+			SceneDesc::Object object;
+			object.Name = name;
+			if (!take("mesh", object.Mesh) || !scene.FindMesh(object.Mesh))
+				return "object '" + name + "' needs a declared mesh=";
+			if (!take("material", object.Material) || !scene.FindMaterial(object.Material))
+				return "object '" + name + "' needs a declared material=";
+			if (take("position", value))
+			{
+				if (!ParseFloats(value, values) || values.size() != 3)
+					return "bad position=" + value;
+				object.Position = XMFLOAT3(values[0], values[1], values[2]);
+			}
+			if (take("scale", value))
+			{
+				if (!ParseFloats(value, values) || (values.size() != 1 && values.size() != 3))
+					return "bad scale=" + value;
+				object.Scale = values.size() == 1 ? XMFLOAT3(values[0], values[0], values[0])
+					: XMFLOAT3(values[0], values[1], values[2]);
+			}
+			if (take("texscale", value))
+			{
+				if (!ParseFloats(value, values) || values.size() != 2)
+					return "bad texscale=" + value;
+				object.TexScale = XMFLOAT2(values[0], values[1]);
+			}
+			if (take("role", value))
+			{
+				if (value == "receiver")
+					object.ObjectRole = SceneDesc::Role::Receiver;
+				else if (value == "sky")
+					object.ObjectRole = SceneDesc::Role::Sky;
+				else if (value == "filter")
+					object.ObjectRole = SceneDesc::Role::Filter;
+				else
+					return "bad role=" + value;
+			}
+			const bool receiver = object.ObjectRole == SceneDesc::Role::Receiver;
+			object.Occluder = receiver;
+
+			std::set<std::string> spaces;
+			if (take("spaces", value))
+			{
+				std::stringstream ss(value);
+				std::string space;
+				while (std::getline(ss, space, ','))
+				{
+					if (space != "world" && space != "screen" && space != "texture")
+						return "unknown space '" + space + "'";
+					spaces.insert(space);
+				}
+			}
+			if (receiver && (!spaces.count("world") || !spaces.count("screen")))
+				return "receiver '" + name + "' must list the world and screen spaces";
+			if (!receiver && !spaces.empty())
+				return "only receivers take spaces=";
+			object.TextureSpace = spaces.count("texture") != 0;
+
+			if (take("occluder", value) && !ParseBool(value, object.Occluder))
+				return "bad occluder=" + value;
+			if (object.Occluder && !receiver)
+				return "only receivers can be occluders";
+			if (take("keys", object.Keys) && object.Keys != "arrows" && object.Keys != "ijkl")
+				return "bad keys=" + object.Keys;
+			scene.Objects.push_back(object);
+		}
+		else if (kind == "probes")
+		{
+			if (!scene.ProbeVolumes.empty())
+				return "only one probe volume can be declared";
+			SceneDesc::Probes probes;
+			probes.Name = name;
+			ProbeVolume::Desc& desc = probes.Desc;
+			std::vector<std::uint32_t> counts;
+			if (!take("origin", value) || !ParseFloats(value, values) || values.size() != 3)
+				return "probes '" + name + "' need origin=x,y,z";
+			desc.Origin = XMFLOAT3(values[0], values[1], values[2]);
+			if (!take("spacing", value) || !ParseFloats(value, values) || (values.size() != 1 && values.size() != 3))
+				return "probes '" + name + "' need spacing=s or spacing=x,y,z";
+			desc.Spacing = values.size() == 1 ? XMFLOAT3(values[0], values[0], values[0])
+				: XMFLOAT3(values[0], values[1], values[2]);
+			if (!(desc.Spacing.x > 0.0f && desc.Spacing.y > 0.0f && desc.Spacing.z > 0.0f))
+				return "bad spacing=" + value + ", expected positive distances";
+			if (!take("counts", value) || !ParseCounts(value, counts, float(SceneDesc::MaxProbes)) || counts.size() != 3)
+				return "probes '" + name + "' need counts=x,y,z";
+			if ((std::uint64_t)counts[0] * counts[1] * counts[2] > SceneDesc::MaxProbes)
+				return "counts=" + value + " is more than " + std::to_string(SceneDesc::MaxProbes) + " probes";
+			for (int i = 0; i < 3; ++i)
+				desc.Counts[i] = counts[i];
+			if (take("rays", value))
+			{
+				if (!ParseCounts(value, counts, 1024.0f) || counts.size() != 1)
+					return "bad rays=" + value + ", expected 1 to 1024";
+				desc.RaysPerProbe = counts[0];
+			}
+			if (take("budget", value))
+			{
+				if (!ParseCounts(value, counts, 16777216.0f) || counts.size() != 1)
+					return "bad budget=" + value;
+				desc.RayBudget = counts[0];
+			}
+			if (take("hysteresis", value))
+			{
+				if (!ParseFloats(value, values) || values.size() != 1 || !(values[0] >= 0.0f && values[0] < 1.0f))
+					return "bad hysteresis=" + value + ", expected at least 0 and below 1";
+				desc.Hysteresis = values[0];
+			}
+			if (take("distance", value))
+			{
+				if (!ParseFloats(value, values) || values.size() != 1 || !(values[0] > 0.0f))
+					return "bad distance=" + value;
+				desc.MaxDistance = values[0];
+			}
+			scene.ProbeVolumes.push_back(probes);
+		}
+		else
+			return "unknown declaration '" + kind + "'";
+
+		if (!attributes.empty())
+			return "unknown attribute '" + attributes.begin()->first + "'";
+		return std::string();
+	}
+
+	std::string Validate(const SceneDesc& scene)
+	{
+		size_t textures2D = 0;
+		size_t cubes = 0;
+		for (const SceneDesc::Texture& texture : scene.Textures)
+			(texture.Cube ? cubes : textures2D)++;
+		if (textures2D > SceneDesc::MaxTextures2D)
+			return "too many 2D textures, the shaders bind " + std::to_string(SceneDesc::MaxTextures2D);
+		if (cubes != 1)
+			return "exactly one cube texture is needed for the sky";
+
+		size_t receivers = 0;
+		size_t skies = 0;
+		size_t filters = 0;
+		std::set<std::string> keys;
+		std::set<bool> receiverPacking;
+		for (const SceneDesc::Object& object : scene.Objects)
+		{
+			// The receiver passes share one input layout, the others always use the full one.
+			const bool pack = scene.FindMesh(object.Mesh)->Pack;
+			if (object.ObjectRole == SceneDesc::Role::Receiver)
+				receiverPacking.insert(pack);
+			else if (pack)
+				return "object '" + object.Name + "' is not a receiver, its mesh cannot be packed";
+
+			receivers += object.ObjectRole == SceneDesc::Role::Receiver;
+			skies += object.ObjectRole == SceneDesc::Role::Sky;
+			filters += object.ObjectRole == SceneDesc::Role::Filter;
+			if (!object.Keys.empty() && !keys.insert(object.Keys).second)
+				return "keys=" + object.Keys + " is bound to more than one object";
+		}
+		if (receivers == 0)
+			return "the scene has no receiver";
+		if (receivers > SceneDesc::MaxReceivers)
+			return "the G-buffer holds ids for up to " + std::to_string(SceneDesc::MaxReceivers) +
+			" receivers, the scene has " + std::to_string(receivers);
+		if (receiverPacking.size() > 1)
+			return "pack= must be the same for every receiver mesh";
+		if (skies != 1 || filters != 1)
+			return "exactly one sky and one filter object are needed";
+		return std::string();
+	}
+}
+
+bool SceneDesc::Load(const std::string& path, SceneDesc& scene, std::string& error)
+{
+	scene = SceneDesc();
+	std::ifstream file(path);
+	if (!file)
+	{
+		error = path + ": cannot open";
+		return false;
+	}
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		const size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::vector<std::string> tokens;
+		std::stringstream ss(line);
+		std::string token;
+		while (ss >> token)
+			tokens.push_back(token);
+		if (tokens.empty())
+			continue;
+
+		const std::string problem = ParseLine(tokens, scene);
+		if (!problem.empty())
+		{
+			error = path + "(" + std::to_string(lineNumber) + "): " + problem;
+			return false;
+		}
+	}
+
+	const std::string problem = Validate(scene);
+	if (!problem.empty())
+	{
+		error = path + ": " + problem;
+		return false;
+	}
+	return true;
+}
+
+const SceneDesc::Texture* SceneDesc::FindTexture(const std::string& name)const
+{
+	for (const Texture& texture : Textures)
+		if (texture.Name == name)
+			return &texture;
+	return nullptr;
+}
+
+const SceneDesc::Material* SceneDesc::FindMaterial(const std::string& name)const
+{
+	for (const Material& material : Materials)
+		if (material.Name == name)
+			return &material;
+	return nullptr;
+}
+
+const SceneDesc::Mesh* SceneDesc::FindMesh(const std::string& name)const
+{
+	for (const Mesh& mesh : Meshes)
+		if (mesh.Name == name)
+			return &mesh;
+	return nullptr;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../Common/GeometryGenerator.h"
+#include "ProbeVolume.h"
+
+// Scene read from a text file, one declaration per line; '#' starts a comment and
+// names must be declared before they are referenced.
+//
+//   texture  <name> file=<path.dds|path.hdr> [cube=1] [size=n]
+//   material <name> [diffuse=<texture>] [normal=<texture>] [albedo=r,g,b,a] [fresnel=r,g,b] [roughness=r]
+//   mesh     <name> <shape> [pack=1] [lods=1]
+//            shapes: model=<path> | box=w,h,d,subdivisions | sphere=radius,slices,stacks |
+//                    cylinder=bottom,top,height,slices,stacks | quad=x,y,w,h,depth |
+//                    grid=width,depth,rows,columns | adaptivegrid=width,depth[,baseCells,maxLevels,threshold]
+//   object   <name> mesh=<mesh> material=<material> [position=x,y,z] [scale=s|x,y,z] [texscale=u,v]
+//            [role=receiver|sky|filter] [spaces=world,screen,texture] [occluder=0|1] [keys=arrows|ijkl]
+//   probes   <name> origin=x,y,z spacing=s|x,y,z counts=x,y,z [rays=n] [budget=n] [hysteresis=h] [distance=d]
+//
+// Cube textures may also be lat-long Radiance .hdr images.  They are resampled into a
+// cached DDS cube 'size' texels wide (a power of two, by default the largest up to a
+// quarter of the image width) and projected onto the environment SH directly.
+//
+// Receivers are the objects radiance transfer is computed for.  'spaces' lists the
+// projection modes they receive it in; world and screen are required, since the
+// per-vertex buffers and the G-buffer cover every receiver, and texture is optional.
+// Receivers are occluders unless occluder=0.
+//
+// At most one probe volume may be declared; the probe volume space (-space probes)
+// lights every receiver from it.  'budget' is the rays traced per frame and 'distance'
+// how far they go; the rest default as in ProbeVolume::Desc.
+struct SceneDesc
+{
+	struct Texture
+	{
+		std::string Name;
+		std::string File;
+		bool Cube = false;
+		bool LatLong = false;       // a lat-long .hdr image rather than a DDS file
+		std::uint32_t CubeSize = 0; // lat-long cubes only; 0 picks one from the image
+	};
+
+	struct Material
+	{
+		std::string Name;
+		std::string DiffuseMap;
+		std::string NormalMap;
+		DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT3 FresnelR0 = { 0.1f, 0.1f, 0.1f };
+		float Roughness = 0.5f;
+	};
+
+	enum class Shape
+	{
+		Model,
+		Box,
+		Sphere,
+		Cylinder,
+		Quad,
+		Grid,
+		AdaptiveGrid
+	};
+
+	struct Mesh
+	{
+		std::string Name;
+		Shape Type = Shape::Box;
+		std::string File;          // Model only
+		std::vector<float> Params; // shape parameters, in the order listed above
+		bool Pack = false;         // upload in the packed vertex format when enabled
+		bool Lods = false;         // generate LODs and an occluder proxy
+	};
+
+	enum class Role
+	{
+		Receiver,
+		Sky,
+		Filter
+	};
+
+	struct Object
+	{
+		std::string Name;
+		std::string Mesh;
+		std::string Material;
+		DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 Scale = { 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT2 TexScale = { 1.0f, 1.0f };
+		Role ObjectRole = Role::Receiver;
+		bool TextureSpace = false;
+		bool Occluder = true;
+		std::string Keys;
+	};
+
+	struct Probes
+	{
+		std::string Name;
+		ProbeVolume::Desc Desc;
+	};
+
+	// Receivers take the object ids 1 to N.  The temporal filter reads its transforms at
+	// that index in the per-object buffer, which is sized to the scene, but the id
+	// reaches it through a float G-buffer channel, exact only up to 2^24.
+	static const size_t MaxReceivers = (size_t(1) << 24) - 1;
+	// Size of gTextureMaps in Common.hlsl.
+	static const size_t MaxTextures2D = 10;
+	// Probes in a volume; their distance moments alone take 128 MB.
+	static const size_t MaxProbes = 65536;
+
+	std::vector<Texture> Textures;
+	std::vector<Material> Materials;
+	std::vector<Mesh> Meshes;
+	std::vector<Object> Objects;
+	std::vector<Probes> ProbeVolumes; // none or one
+
+	// Parses and validates 'path'.  On failure 'error' names the file, line and problem.
+	static bool Load(const std::string& path, SceneDesc& scene, std::string& error);
+
+	const Texture* FindTexture(const std::string& name)const;
+	const Material* FindMaterial(const std::string& name)const;
+	const Mesh* FindMesh(const std::string& name)const;
+};
@@ -19,6 +19,7 @@
 #include "LightingUtil.hlsl"
 #include "RandomNumber.hlsl"
 #include "SHUtil.hlsl"
+#include "ObjectConstants.hlsl"
 
 struct MaterialData
 {
@@ -45,6 +46,14 @@ Texture2D gTextureMaps[10] : register(t3);
 // The texture array will occupy registers t0, t1, ..., t3 in space0. 
 StructuredBuffer<MaterialData> gMaterialData : register(t0, space1);
 
+// Transforms for temporal reprojection, indexed by the object id in the G-buffer.
+struct ObjectTransform
+{
+    float4x4 InvWorld;
+    float4x4 LastFrameWorld;
+};
+StructuredBuffer<ObjectTransform> gObjectTransforms : register(t1, space1);
+
 RWStructuredBuffer<SHCoeff> gSHCoeffsEnv : register(u0);
 RWStructuredBuffer<SHCoeff> gTemporalSHCoeffsObject : register(u1);
 RWStructuredBuffer<SHCoeff> gThisFrameSHCoeffsObject : register(u5);
@@ -71,19 +80,6 @@ SamplerState gsamLinearClamp      : register(s3);
 SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
-{
-    float4x4 gWorld;
-    float4x4 gInvWorld;
-	float4x4 gTexTransform;
-    float4x4 gLastFrameWorld;
-	uint gMaterialIndex;
-	uint gVertexOffset;
-	uint gObjId;
-	uint gObjPad;
-};
-
 // Constant data that varies per material.
 cbuffer cbPass : register(b1)
 {
@@ -102,10 +98,4 @@ cbuffer cbPass : register(b1)
     float gFarZ;
     float gTotalTime;
     float gDeltaTime;
-    float4x4 gInvWorld1;
-    float4x4 gLastFrameWorld1;
-    float4x4 gInvWorld2;
-    float4x4 gLastFrameWorld2;
-    float4x4 gInvWorld3;
-    float4x4 gLastFrameWorld3;
 };
\ No newline at end of file
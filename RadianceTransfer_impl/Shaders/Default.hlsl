@@ -1,14 +1,7 @@
 #include "Common.hlsl"
+#include "VertexFormat.hlsl"
 #include "Util.hlsl"
 
-struct VertexIn
-{
-    float3 PosL : POSITION;
-    float3 NormalL : NORMAL;
-    float2 TexC : TEXCOORD;
-    float3 TangentU : TANGENT;
-};
-
 struct VertexOut
 {
     float4 PosH : SV_POSITION;
@@ -20,25 +13,26 @@ struct VertexOut
 
 VertexOut VS(VertexIn vin)
 {
+    VertexData v = UnpackVertex(vin, gPosDequantScale.xyz, gPosDequantBias.xyz);
     VertexOut vout = (VertexOut) 0.0f;
 
 	// Fetch the material data.
     MaterialData matData = gMaterialData[gMaterialIndex];
 	
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(v.PosL, 1.0f), gWorld);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3) gWorld);
+    vout.NormalW = mul(v.NormalL, (float3x3) gWorld);
 	
-    vout.TangentW = mul(vin.TangentU, (float3x3) gWorld);
+    vout.TangentW = mul(v.TangentU, (float3x3) gWorld);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
 	
 	// Output vertex attributes for interpolation across triangle.
-    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
+    float4 texC = mul(float4(v.TexC, 0.0f, 1.0f), gTexTransform);
     vout.TexC = mul(texC, matData.MatTransform).xy;
 	
     return vout;
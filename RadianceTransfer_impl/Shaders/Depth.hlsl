@@ -1,12 +1,5 @@
 #include "Common.hlsl"
-
-struct VertexIn
-{
-    float3 PosL : POSITION;
-    float3 NormalL : NORMAL;
-    float2 TexC : TEXCOORD;
-    float3 TangentU : TANGENT;
-};
+#include "VertexFormat.hlsl"
 
 struct VertexOut
 {
@@ -15,10 +8,11 @@ struct VertexOut
 
 VertexOut VS(VertexIn vin)
 {
+    VertexData v = UnpackVertex(vin, gPosDequantScale.xyz, gPosDequantBias.xyz);
     VertexOut vout;
 
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(v.PosL, 1.0f), gWorld);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
@@ -4,4 +4,5 @@
 void ClosestHit(inout HitInfo payload, Attributes attrib)
 {
     payload.visibility = 0.0f;
+    payload.hitT = RayTCurrent();
 }
\ No newline at end of file
@@ -4,4 +4,5 @@
 void Miss(inout HitInfo payload : SV_RayPayload)
 {
     payload.visibility = 1.0f;
+    payload.hitT = -1.0f;
 }
\ No newline at end of file
@@ -0,0 +1,21 @@
+// Per-object constants, ObjectConstants in FrameResource.h field for field.  Every
+// shader reading cbPerObject includes this, so the copies cannot drift apart.
+
+#ifndef OBJECT_CONSTANTS_HLSL
+#define OBJECT_CONSTANTS_HLSL
+
+cbuffer cbPerObject : register(b0)
+{
+    float4x4 gWorld;
+    float4x4 gInvWorld;
+    float4x4 gTexTransform;
+    float4x4 gLastFrameWorld;
+    uint gMaterialIndex;
+    uint gVertexOffset; // of the object in the per-vertex buffers
+    uint gObjId; // index into gObjectTransforms for temporal reprojection
+    uint gObjPad;
+    float4 gPosDequantScale; // packed positions: PosL = q * scale + bias
+    float4 gPosDequantBias;
+};
+
+#endif // OBJECT_CONSTANTS_HLSL
@@ -0,0 +1,40 @@
+#include "SHUtil.hlsl"
+#include "RayCommon.hlsl"
+#include "ProbeVolumeUtil.hlsl"
+
+// Environment light, projected by ProjEnv.hlsl.
+RWStructuredBuffer<SHCoeff> gSHCoeffsEnv : register(u0);
+
+// Per ray of this frame's update: radiance arriving along it and the hit distance.
+RWStructuredBuffer<float4> gProbeRays : register(u6);
+
+// Raytracing acceleration structure, accessed as a SRV
+RaytracingAccelerationStructure SceneBVH : register(t0);
+
+// One ray per thread: x is the ray, y the slot of this frame's update.  Rays that escape
+// see the environment and rays that hit see black, as the visibility rays count them;
+// misses are recorded at the maximum distance.
+[shader("raygeneration")]
+void RayGen()
+{
+    uint ray = DispatchRaysIndex().x;
+    uint slot = DispatchRaysIndex().y;
+    uint probe = probeForSlot(slot);
+
+    RayDesc rayDesc;
+    rayDesc.Origin = probePosition(probe);
+    rayDesc.Direction = probeRayDirection(ray, gProbeRaysPerProbe);
+    rayDesc.TMin = 0.0f;
+    rayDesc.TMax = gProbeMaxDistance;
+
+    HitInfo payload;
+    payload.visibility = 0.0f;
+    payload.hitT = -1.0f;
+
+    // Closest hit, one hit group, one miss shader; see RayGen.hlsl.
+    TraceRay(SceneBVH, RAY_FLAG_NONE, 0xFF, 0, 0, 0, rayDesc, payload);
+
+    float3 radiance = payload.visibility * shRadiance(gSHCoeffsEnv[0], rayDesc.Direction);
+    float hitT = payload.hitT >= 0.0f ? min(payload.hitT, gProbeMaxDistance) : gProbeMaxDistance;
+    gProbeRays[slot * gProbeRaysPerProbe + ray] = float4(radiance, hitT);
+}
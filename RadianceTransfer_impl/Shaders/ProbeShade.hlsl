@@ -0,0 +1,35 @@
+#include "Common.hlsl"
+#include "VertexFormat.hlsl"
+#include "ProbeVolumeUtil.hlsl"
+
+// The probes, as ProbeUpdate.hlsl left them.
+RWStructuredBuffer<SHCoeff> gProbeRadiance : register(u7);
+RWStructuredBuffer<float2> gProbeDepth : register(u8);
+
+struct VertexOut
+{
+    float4 PosH : SV_POSITION;
+    float3 PosW : POSITION;
+    float3 NormalW : NORMAL;
+};
+
+VertexOut VS(VertexIn vin)
+{
+    VertexData v = UnpackVertex(vin, gPosDequantScale.xyz, gPosDequantBias.xyz);
+    VertexOut vout = (VertexOut) 0.0f;
+
+    float4 posW = mul(float4(v.PosL, 1.0f), gWorld);
+    vout.PosW = posW.xyz;
+    // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
+    vout.NormalW = mul(v.NormalL, (float3x3) gWorld);
+    vout.PosH = mul(posW, gViewProj);
+    return vout;
+}
+
+// The receivers lit from the probes around each pixel, white like in the other spaces.
+float4 PS(VertexOut pin) : SV_Target
+{
+    float3 albedo = float3(1.0f, 1.0f, 1.0f);
+    float3 irradiance = probeVolumeIrradiance(gProbeRadiance, gProbeDepth, pin.PosW, normalize(pin.NormalW));
+    return float4((albedo / PROBE_PI) * irradiance, 1.0f);
+}
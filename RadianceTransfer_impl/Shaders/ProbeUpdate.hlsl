@@ -0,0 +1,78 @@
+#include "SHUtil.hlsl"
+#include "ProbeVolumeUtil.hlsl"
+
+// What ProbeRayGen.hlsl traced this frame, and the probes it is blended into.
+RWStructuredBuffer<float4> gProbeRays : register(u6);
+RWStructuredBuffer<SHCoeff> gProbeRadiance : register(u7);
+RWStructuredBuffer<float2> gProbeDepth : register(u8);
+
+// One vertex per slot of this frame's update, drawn as a point list without a pixel
+// shader, like ProjEnv.hlsl.  Probes updated for the first time take the rays as they
+// are; the others blend them in with the hysteresis.
+void VS(uint slot : SV_VertexID)
+{
+    uint probe = probeForSlot(slot);
+    uint rayCount = gProbeRaysPerProbe;
+    uint firstRay = slot * rayCount;
+    float hysteresis = slot < gProbeFreshSlots ? 0.0f : gProbeHysteresis;
+
+    // Radiance SH: the Monte Carlo projection over the uniform directions.
+    float3 projected[9];
+    [unroll]
+    for (uint c = 0; c < 9; ++c)
+        projected[c] = 0.0f;
+    for (uint i = 0; i < rayCount; ++i)
+    {
+        float basis[9];
+        sh_eval_basis_2(probeRayDirection(i, rayCount), basis);
+        float3 radiance = gProbeRays[firstRay + i].xyz;
+        [unroll]
+        for (uint k = 0; k < 9; ++k)
+            projected[k] += radiance * basis[k];
+    }
+
+    float scale = 4.0f * PROBE_PI / rayCount;
+    SHCoeff thisFrame;
+    thisFrame.SHCoeff_l0_m0 = projected[0] * scale;
+    thisFrame.SHCoeff_l1_m_1 = projected[1] * scale;
+    thisFrame.SHCoeff_l1_m0 = projected[2] * scale;
+    thisFrame.SHCoeff_l1_m1 = projected[3] * scale;
+    thisFrame.SHCoeff_l2_m_2 = projected[4] * scale;
+    thisFrame.SHCoeff_l2_m_1 = projected[5] * scale;
+    thisFrame.SHCoeff_l2_m0 = projected[6] * scale;
+    thisFrame.SHCoeff_l2_m1 = projected[7] * scale;
+    thisFrame.SHCoeff_l2_m2 = projected[8] * scale;
+    // A probe's first update does not read what it held: the buffers start uninitialized.
+    if (hysteresis > 0.0f)
+        thisFrame = shBlend(hysteresis, gProbeRadiance[probe], thisFrame);
+    gProbeRadiance[probe] = thisFrame;
+
+    // Distance moments: each texel averages the rays near its direction.
+    uint resolution = gProbeDepthResolution;
+    uint base = probe * resolution * resolution;
+    for (uint y = 0; y < resolution; ++y)
+    {
+        for (uint x = 0; x < resolution; ++x)
+        {
+            float3 texelDirection = probeOctDecode((float2(x, y) + 0.5f) / resolution * 2.0f - 1.0f);
+
+            float weightSum = 0.0f;
+            float2 moments = 0.0f;
+            for (uint j = 0; j < rayCount; ++j)
+            {
+                float hitT = gProbeRays[firstRay + j].w;
+                float weight = pow(max(dot(texelDirection, probeRayDirection(j, rayCount)), 0.0f), gProbeDepthSharpness);
+                weightSum += weight;
+                moments += weight * float2(hitT, hitT * hitT);
+            }
+
+            uint texel = base + y * resolution + x;
+            if (weightSum > 0.0f && hysteresis > 0.0f)
+                gProbeDepth[texel] = lerp(moments / weightSum, gProbeDepth[texel], hysteresis);
+            else if (weightSum > 0.0f)
+                gProbeDepth[texel] = moments / weightSum;
+            else if (hysteresis == 0.0f)
+                gProbeDepth[texel] = float2(gProbeMaxDistance, gProbeMaxDistance * gProbeMaxDistance);
+        }
+    }
+}
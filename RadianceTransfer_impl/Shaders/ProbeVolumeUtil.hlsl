@@ -0,0 +1,198 @@
+// Probe volume space: a grid of irradiance probes, each with order 3 radiance SH and
+// octahedral distance moments, updated a fixed number of rays per frame and
+// interpolated at the receivers.  ProbeVolume.cpp is the CPU reference for all of it.
+// Include after SHUtil.hlsl, which has no include guard.
+
+#ifndef PROBE_VOLUME_UTIL_HLSL
+#define PROBE_VOLUME_UTIL_HLSL
+
+// ProbeVolume::Constants.
+cbuffer cbProbeVolume : register(b2)
+{
+    float4 gProbeRayRotation[3];
+    float3 gProbeOrigin;
+    uint gProbeRaysPerProbe;
+    float3 gProbeSpacing;
+    uint gProbeFirst;
+    uint3 gProbeCounts;
+    uint gProbesThisFrame;
+    float gProbeHysteresis;
+    float gProbeMaxDistance;
+    float gProbeNormalBias;
+    uint gProbeDepthResolution;
+    float gProbeDepthSharpness;
+    uint gProbeCount;
+    uint gProbeFreshSlots;
+    uint gProbePad;
+};
+
+static const float PROBE_PI = 3.14159265358979;
+
+// The probe a slot of this frame's update works on.
+uint probeForSlot(uint slot)
+{
+    return (gProbeFirst + slot) % gProbeCount;
+}
+
+float3 probePosition(uint probe)
+{
+    uint3 index = uint3(probe % gProbeCounts.x, probe / gProbeCounts.x % gProbeCounts.y,
+        probe / (gProbeCounts.x * gProbeCounts.y));
+    return gProbeOrigin + index * gProbeSpacing;
+}
+
+// Spherical Fibonacci direction 'ray' of 'count', turned by this frame's rotation.
+float3 probeRayDirection(uint ray, uint count)
+{
+    float turns = ray * 0.618033988749895;
+    float phi = 2.0 * PROBE_PI * frac(turns);
+    float cosTheta = 1.0 - (2.0 * ray + 1.0) / count;
+    float sinTheta = sqrt(saturate(1.0 - cosTheta * cosTheta));
+    float3 d = float3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+    return mul(d, float3x3(gProbeRayRotation[0].xyz, gProbeRayRotation[1].xyz, gProbeRayRotation[2].xyz));
+}
+
+float probeSignNotZero(float v)
+{
+    return v >= 0.0 ? 1.0 : -1.0;
+}
+
+float2 probeOctEncode(float3 d)
+{
+    float2 p = d.xy / (abs(d.x) + abs(d.y) + abs(d.z));
+    if (d.z < 0.0)
+        p = (1.0 - abs(p.yx)) * float2(probeSignNotZero(p.x), probeSignNotZero(p.y));
+    return p;
+}
+
+float3 probeOctDecode(float2 p)
+{
+    float3 d = float3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (d.z < 0.0)
+        d.xy = (1.0 - abs(p.yx)) * float2(probeSignNotZero(p.x), probeSignNotZero(p.y));
+    return normalize(d);
+}
+
+void shToArray(SHCoeff sh, out float3 c[9])
+{
+    c[0] = sh.SHCoeff_l0_m0;
+    c[1] = sh.SHCoeff_l1_m_1;
+    c[2] = sh.SHCoeff_l1_m0;
+    c[3] = sh.SHCoeff_l1_m1;
+    c[4] = sh.SHCoeff_l2_m_2;
+    c[5] = sh.SHCoeff_l2_m_1;
+    c[6] = sh.SHCoeff_l2_m0;
+    c[7] = sh.SHCoeff_l2_m1;
+    c[8] = sh.SHCoeff_l2_m2;
+}
+
+// Radiance SH evaluated in direction 'd', negative lobes clamped.
+float3 shRadiance(SHCoeff sh, float3 d)
+{
+    float basis[9];
+    sh_eval_basis_2(d, basis);
+    float3 c[9];
+    shToArray(sh, c);
+    float3 radiance = 0.0;
+    [unroll]
+    for (uint i = 0; i < 9; ++i)
+        radiance += c[i] * basis[i];
+    return max(radiance, 0.0);
+}
+
+// Irradiance from radiance SH for a surface facing 'n': each band scaled by the cosine
+// lobe's.
+float3 shIrradiance(SHCoeff sh, float3 n)
+{
+    static const float bandScale[9] = {
+        PROBE_PI,
+        2.0 * PROBE_PI / 3.0, 2.0 * PROBE_PI / 3.0, 2.0 * PROBE_PI / 3.0,
+        PROBE_PI / 4.0, PROBE_PI / 4.0, PROBE_PI / 4.0, PROBE_PI / 4.0, PROBE_PI / 4.0 };
+    float basis[9];
+    sh_eval_basis_2(n, basis);
+    float3 c[9];
+    shToArray(sh, c);
+    float3 e = 0.0;
+    [unroll]
+    for (uint i = 0; i < 9; ++i)
+        e += c[i] * (bandScale[i] * basis[i]);
+    return max(e, 0.0);
+}
+
+// Mean and mean square distance 'probe' saw in direction 'd', bilinear between texels
+// and clamped at the edges of the octahedral map.
+float2 probeDepthMoments(RWStructuredBuffer<float2> depth, uint probe, float3 d)
+{
+    uint resolution = gProbeDepthResolution;
+    float last = resolution - 1.0;
+    float2 uv = clamp((probeOctEncode(d) * 0.5 + 0.5) * resolution - 0.5, 0.0, last);
+    uint2 p0 = uint2(uv);
+    uint2 p1 = min(p0 + 1, resolution - 1);
+    float2 f = uv - p0;
+
+    uint base = probe * resolution * resolution;
+    float2 d00 = depth[base + p0.y * resolution + p0.x];
+    float2 d10 = depth[base + p0.y * resolution + p1.x];
+    float2 d01 = depth[base + p1.y * resolution + p0.x];
+    float2 d11 = depth[base + p1.y * resolution + p1.x];
+    return lerp(lerp(d00, d10, f.x), lerp(d01, d11, f.x), f.y);
+}
+
+// Irradiance at world position 'p' facing 'n' from the eight probes around it:
+// trilinear, less from probes behind the surface, and little from probes the distance
+// moments say cannot see the point.
+float3 probeVolumeIrradiance(RWStructuredBuffer<SHCoeff> radiance, RWStructuredBuffer<float2> depth,
+    float3 p, float3 n)
+{
+    // The cell and its weights are those of the biased point, as in the Chebyshev test,
+    // so a point just inside a wall leans on the probes on its side.
+    float3 biased = p + n * gProbeNormalBias;
+    float3 relative = (biased - gProbeOrigin) / gProbeSpacing;
+    int3 highest = max(int3(gProbeCounts) - 2, 0);
+    int3 base = clamp(int3(floor(relative)), 0, highest);
+    float3 alpha = saturate(relative - base);
+
+    float3 sum = 0.0;
+    float weightSum = 0.0;
+    for (uint corner = 0; corner < 8; ++corner)
+    {
+        uint3 offset = uint3(corner, corner >> 1, corner >> 2) & 1;
+        uint3 index = min(uint3(base) + offset, gProbeCounts - 1);
+        float3 trilinear = lerp(1.0 - alpha, alpha, float3(offset));
+        uint probe = index.x + gProbeCounts.x * (index.y + gProbeCounts.y * index.z);
+        float3 probePos = probePosition(probe);
+
+        float3 toProbe = probePos - p;
+        float toProbeLength = length(toProbe);
+        float facing = toProbeLength > 1e-6 ? dot(toProbe, n) / toProbeLength : 1.0;
+        float wrap = (facing + 1.0) * 0.5;
+        float weight = wrap * wrap + 0.2;
+
+        float3 fromProbe = biased - probePos;
+        float probeDistance = length(fromProbe);
+        if (probeDistance > 1e-6)
+        {
+            float2 moments = probeDepthMoments(depth, probe, fromProbe / probeDistance);
+            if (probeDistance > moments.x)
+            {
+                float variance = abs(moments.y - moments.x * moments.x);
+                float d = probeDistance - moments.x;
+                float chebyshev = variance / (variance + d * d);
+                weight *= max(chebyshev * chebyshev * chebyshev, 0.05);
+            }
+        }
+
+        weight = max(weight, 1e-6);
+        const float crushThreshold = 0.2;
+        if (weight < crushThreshold)
+            weight *= weight * weight / (crushThreshold * crushThreshold);
+
+        weight *= trilinear.x * trilinear.y * trilinear.z;
+        sum += weight * shIrradiance(radiance[probe], n);
+        weightSum += weight;
+    }
+
+    return weightSum > 0.0 ? sum / weightSum : 0.0;
+}
+
+#endif
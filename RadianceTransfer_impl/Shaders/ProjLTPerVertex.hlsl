@@ -1,16 +1,9 @@
 #include "Common.hlsl"
+#include "VertexFormat.hlsl"
 #include "Util.hlsl"
 #include "Sample.hlsl"
 
-struct VertexIn
-{
-    float3 PosL : POSITION;
-    float3 NormalL : NORMAL;
-    float2 TexC : TEXCOORD;
-    float3 TangentU : TANGENT;
-};
-
-void projLightTransport(VertexIn vin, uint vid)
+void projLightTransport(VertexData v, uint vid)
 {   
     vid = vid + gVertexOffset;
     float4x4 visibility4x4 = gVisibility4x4[vid];
@@ -24,11 +17,11 @@ void projLightTransport(VertexIn vin, uint vid)
             float visibility = visibility4x4[i][j];
         
             // Transform to world space.
-            float3 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+            float3 posW = mul(float4(v.PosL, 1.0f), gWorld);
 
             // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-            float3 NormalW = normalize(mul(vin.NormalL, (float3x3) gWorld));
-            //float3 TangentW = normalize(mul(vin.TangentU, (float3x3) gWorld));
+            float3 NormalW = normalize(mul(v.NormalL, (float3x3) gWorld));
+            //float3 TangentW = normalize(mul(v.TangentU, (float3x3) gWorld));
     
             float shEvals[9];
         
@@ -59,5 +52,5 @@ void projLightTransport(VertexIn vin, uint vid)
 
 void VS(VertexIn vin, uint vid : SV_VertexID)
 {
-    projLightTransport(vin, vid);
+    projLightTransport(UnpackVertex(vin, gPosDequantScale.xyz, gPosDequantBias.xyz), vid);
 }
@@ -1,21 +1,14 @@
 #include "Common.hlsl"
+#include "VertexFormat.hlsl"
 #include "Util.hlsl"
 #include "Sample.hlsl"
 
-struct VertexIn
+void projLightTransport(VertexData v, uint vid)
 {
-    float3 PosL : POSITION;
-    float3 NormalL : NORMAL;
-    float2 TexC : TEXCOORD;
-    float3 TangentU : TANGENT;
-};
-
-void projLightTransport(VertexIn vin, uint vid)
-{
-    float4 visibility4 = textureSpaceVisibility4.SampleLevel(gsamPointClamp, vin.TexC, 0);
+    float4 visibility4 = textureSpaceVisibility4.SampleLevel(gsamPointClamp, v.TexC, 0);
     //uint height, width;
     //textureSpaceVisibility4.GetDimensions(width, height);
-    //float4 visibility4 = textureSpaceVisibility4.Load(int3(width*vin.TexC.x, height*vin.TexC.y, 0));
+    //float4 visibility4 = textureSpaceVisibility4.Load(int3(width*v.TexC.x, height*v.TexC.y, 0));
     
     SHCoeff thisFrameSHCoeff = (SHCoeff) 0.0f;
     RandomResult result = gRandomState[vid];
@@ -25,10 +18,10 @@ void projLightTransport(VertexIn vin, uint vid)
         float visibility = visibility4[i];
         
         // Transform to world space.
-        float3 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+        float3 posW = mul(float4(v.PosL, 1.0f), gWorld);
 
         // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-        float3 NormalW = normalize(mul(vin.NormalL, (float3x3) gWorld));
+        float3 NormalW = normalize(mul(v.NormalL, (float3x3) gWorld));
         
         float shEvals[9];
         
@@ -58,5 +51,5 @@ void projLightTransport(VertexIn vin, uint vid)
 
 void VS(VertexIn vin, uint vid : SV_VertexID)
 {
-    projLightTransport(vin, vid);
+    projLightTransport(UnpackVertex(vin, gPosDequantScale.xyz, gPosDequantBias.xyz), vid);
 }
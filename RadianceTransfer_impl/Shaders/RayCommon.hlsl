@@ -6,6 +6,8 @@
 struct HitInfo
 {
     float visibility;
+    // Distance to the closest hit; probe rays only.
+    float hitT;
     //int vid;
 };
 
@@ -16,10 +18,4 @@ struct Attributes
     float2 bary;
 };
 
-struct Vertex
-{
-    float3 PosL;
-    float3 NormalL;
-    float2 TexC;
-    float3 TangentU;
-};
\ No newline at end of file
+#include "VertexFormat.hlsl"
\ No newline at end of file
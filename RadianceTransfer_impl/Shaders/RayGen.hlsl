@@ -2,6 +2,7 @@
 #include "RayCommon.hlsl"
 #include "Util.hlsl"
 #include "RandomNumber.hlsl"
+#include "ObjectConstants.hlsl"
 
 // Visibility term
 RWStructuredBuffer<float> gVisibility : register(u0);
@@ -13,20 +14,11 @@ RWStructuredBuffer<RandomResult> gRandomState : register(u2);
 // Raytracing acceleration structure, accessed as a SRV
 RaytracingAccelerationStructure SceneBVH : register(t0);
 
+#ifdef PACKED_VERTEX
+StructuredBuffer<PackedVertex> Vertices : register(t1);
+#else
 StructuredBuffer<Vertex> Vertices : register(t1);
-
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
-{
-    float4x4 gWorld;
-    float4x4 gInvWorld;
-    float4x4 gTexTransform;
-    float4x4 gLastFrameWorld;
-    uint gMaterialIndex;
-    uint gVertexOffset;
-    uint gObjPad1;
-    uint gObjPad2;
-};
+#endif
 
 // Constant data that varies per material.
 cbuffer cbPass : register(b1)
@@ -55,6 +47,7 @@ void RayGen()
     uint vertexid = DispatchRaysIndex().x + gVertexOffset;
     uint rayIndex = DispatchRaysIndex().x;
     RandomResult result = gRandomState[vertexid];
+    VertexData v = UnpackVertex(Vertices[rayIndex], gPosDequantScale.xyz, gPosDequantBias.xyz);
     float4x4 visibility4x4;
     
     for (int i = 0; i < 4; ++i)
@@ -65,9 +58,9 @@ void RayGen()
             HitInfo payload;
             payload.visibility = 0.0f;
     
-            float4 PositionW = mul(float4(Vertices[rayIndex].PosL, 1.0f), gWorld);
+            float4 PositionW = mul(float4(v.PosL, 1.0f), gWorld);
             // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-            float3 NormalW = normalize(mul(Vertices[rayIndex].NormalL, (float3x3) gWorld));
+            float3 NormalW = normalize(mul(v.NormalL, (float3x3) gWorld));
     
             result = Random(result.state);
             float3 sampleVec = hemisphereSample_cos(result.u, result.v);
@@ -1,14 +1,7 @@
 #include "Common.hlsl"
+#include "VertexFormat.hlsl"
 #include "Sample.hlsl"
 
-struct VertexIn
-{
-    float3 PosL : POSITION;
-    float3 NormalL : NORMAL;
-    float2 TexC : TEXCOORD;
-    float3 TangentU : TANGENT;
-};
-
 struct VertexOut
 {
     float4 PosH : SV_POSITION;
@@ -20,6 +13,7 @@ struct VertexOut
 
 VertexOut VS(VertexIn vin, uint vid : SV_VertexID)
 {   
+    VertexData v = UnpackVertex(vin, gPosDequantScale.xyz, gPosDequantBias.xyz);
     vid = vid + gVertexOffset;
     VertexOut vout = (VertexOut) 0.0f;
 
@@ -31,9 +25,9 @@ VertexOut VS(VertexIn vin, uint vid : SV_VertexID)
     gTemporalSHCoeffsObject[vid] = vout.shCoeffsVertex;
     
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(v.PosL, 1.0f), gWorld);
     vout.PosW = posW.xyz;
-    vout.NormalW = normalize(mul(vin.NormalL, (float3x3) gWorld));
+    vout.NormalW = normalize(mul(v.NormalL, (float3x3) gWorld));
     vout.PosH = mul(posW, gViewProj);
     
     return vout;
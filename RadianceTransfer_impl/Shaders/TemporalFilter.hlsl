@@ -21,24 +21,9 @@ float3 temporalFilter(float3 thisFrameColor, float2 uv, float ratio)
     screenSpaceFilteredHorzSHCoeffs[0].GetDimensions(width, height);
     
     float objectId = gBuffer[1][uv].w;
-    float4x4 invWorld = (float4x4) 0.0f;
-    float4x4 lastFrameWorld = (float4x4) 0.0f;
-    
-    if (objectId == 1.0f)
-    {
-        invWorld = gInvWorld1;
-        lastFrameWorld = gLastFrameWorld1;
-    }
-    else if (objectId == 2.0f)
-    {
-        invWorld = gInvWorld2;
-        lastFrameWorld = gLastFrameWorld2;
-    }
-    else if (objectId == 3.0f)
-    {
-        invWorld = gInvWorld3;
-        lastFrameWorld = gLastFrameWorld3;
-    }
+    ObjectTransform transform = gObjectTransforms[(uint)objectId];
+    float4x4 invWorld = transform.InvWorld;
+    float4x4 lastFrameWorld = transform.LastFrameWorld;
 
     float4 position = float4(gBuffer[0].Load(int3(uv, 0)).xyz, 1.0f);
     position = mul(position, invWorld);
@@ -2,6 +2,7 @@
 #include "RayCommon.hlsl"
 #include "Util.hlsl"
 #include "RandomNumber.hlsl"
+#include "ObjectConstants.hlsl"
 
 // Visibility term
 RWTexture2D<float4> gVisibility4 : register(u3);
@@ -12,19 +13,11 @@ RWStructuredBuffer<RandomResult> gRandomState : register(u2);
 // Raytracing acceleration structure, accessed as a SRV
 RaytracingAccelerationStructure SceneBVH : register(t0);
 
+#ifdef PACKED_VERTEX
+StructuredBuffer<PackedVertex> Vertices : register(t1);
+#else
 StructuredBuffer<Vertex> Vertices : register(t1);
-
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
-{
-    float4x4 gWorld;
-    float4x4 gTexTransform;
-    float4x4 gLastFrameWorld;
-    uint gMaterialIndex;
-    uint gObjPad0;
-    uint gObjPad1;
-    uint gObjPad2;
-};
+#endif
 
 // Constant data that varies per material.
 cbuffer cbPass : register(b1)
@@ -51,7 +44,8 @@ void RayGen()
 {
     uint vertexid = DispatchRaysIndex().x;
     RandomResult result = gRandomState[vertexid];
-    float2 texUV = Vertices[vertexid].TexC;
+    VertexData v = UnpackVertex(Vertices[vertexid], gPosDequantScale.xyz, gPosDequantBias.xyz);
+    float2 texUV = v.TexC;
     float4 visibility4;
     
     for (int i = 0; i < 4; ++i)
@@ -60,9 +54,9 @@ void RayGen()
         HitInfo payload;
         payload.visibility = 0.0f;
     
-        float4 PositionW = mul(float4(Vertices[vertexid].PosL, 1.0f), gWorld);
+        float4 PositionW = mul(float4(v.PosL, 1.0f), gWorld);
         // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-        float3 NormalW = normalize(mul(Vertices[vertexid].NormalL, (float3x3) gWorld));
+        float3 NormalW = normalize(mul(v.NormalL, (float3x3) gWorld));
     
         result = Random(result.state);
         float3 sampleVec = hemisphereSample_cos(result.u, result.v);
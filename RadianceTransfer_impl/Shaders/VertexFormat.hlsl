@@ -0,0 +1,114 @@
+// Vertex formats shared by the rasterization and ray generation passes.
+// Geometry shaders are compiled with PACKED_VERTEX defined when the receivers use the
+// compact 20-byte layout (see VertexPacking.h); otherwise they read the full 44-byte one.
+// Either way the shader body works on a VertexData returned by UnpackVertex.
+
+#ifndef VERTEX_FORMAT_HLSL
+#define VERTEX_FORMAT_HLSL
+
+// Full precision vertex, as laid out in a StructuredBuffer.
+struct Vertex
+{
+    float3 PosL;
+    float3 NormalL;
+    float2 TexC;
+    float3 TangentU;
+};
+
+// Packed vertex, as laid out in a StructuredBuffer.
+//   Position : 4 x snorm16, Normal / Tangent : 2 x snorm16 octahedral, TexC : 2 x float16
+struct PackedVertex
+{
+    uint2 Position;
+    uint Normal;
+    uint TexC;
+    uint Tangent;
+};
+
+#ifdef PACKED_VERTEX
+// The input assembler already expands the snorm and half components.
+struct VertexIn
+{
+    float4 PosQ : POSITION;
+    float2 NormalOct : NORMAL;
+    float2 TexC : TEXCOORD;
+    float2 TangentOct : TANGENT;
+};
+#else
+struct VertexIn
+{
+    float3 PosL : POSITION;
+    float3 NormalL : NORMAL;
+    float2 TexC : TEXCOORD;
+    float3 TangentU : TANGENT;
+};
+#endif
+
+struct VertexData
+{
+    float3 PosL;
+    float3 NormalL;
+    float2 TexC;
+    float3 TangentU;
+};
+
+float3 OctDecode(float2 f)
+{
+    float3 n = float3(f.x, f.y, 1.0f - abs(f.x) - abs(f.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+// Sign extends two 16 bit snorm values packed into a uint.
+float2 UnpackSnorm2x16(uint v)
+{
+    int2 i = int2(int(v << 16) >> 16, int(v) >> 16);
+    return max(float2(i) / 32767.0f, -1.0f);
+}
+
+float2 UnpackHalf2x16(uint v)
+{
+    return float2(f16tof32(v), f16tof32(v >> 16));
+}
+
+VertexData UnpackVertex(VertexIn vin, float3 posScale, float3 posBias)
+{
+    VertexData v;
+#ifdef PACKED_VERTEX
+    v.PosL = vin.PosQ.xyz * posScale + posBias;
+    v.NormalL = OctDecode(vin.NormalOct);
+    v.TexC = vin.TexC;
+    v.TangentU = OctDecode(vin.TangentOct);
+#else
+    v.PosL = vin.PosL;
+    v.NormalL = vin.NormalL;
+    v.TexC = vin.TexC;
+    v.TangentU = vin.TangentU;
+#endif
+    return v;
+}
+
+VertexData UnpackVertex(PackedVertex p, float3 posScale, float3 posBias)
+{
+    VertexData v;
+    float2 xy = UnpackSnorm2x16(p.Position.x);
+    float2 zw = UnpackSnorm2x16(p.Position.y);
+    v.PosL = float3(xy, zw.x) * posScale + posBias;
+    v.NormalL = OctDecode(UnpackSnorm2x16(p.Normal));
+    v.TexC = UnpackHalf2x16(p.TexC);
+    v.TangentU = OctDecode(UnpackSnorm2x16(p.Tangent));
+    return v;
+}
+
+VertexData UnpackVertex(Vertex p, float3 posScale, float3 posBias)
+{
+    VertexData v;
+    v.PosL = p.PosL;
+    v.NormalL = p.NormalL;
+    v.TexC = p.TexC;
+    v.TangentU = p.TangentU;
+    return v;
+}
+
+#endif // VERTEX_FORMAT_HLSL
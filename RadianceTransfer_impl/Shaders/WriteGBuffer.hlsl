@@ -1,15 +1,8 @@
 #include "Common.hlsl"
+#include "VertexFormat.hlsl"
 #include "Util.hlsl"
 #include "Sample.hlsl"
 
-struct VertexIn
-{
-    float3 PosL : POSITION;
-    float3 NormalL : NORMAL;
-    float2 TexC : TEXCOORD;
-    float3 TangentU : TANGENT;
-};
-
 struct VertexOut
 {
     float4 PosH : SV_POSITION;
@@ -19,9 +12,10 @@ struct VertexOut
 
 VertexOut VS(VertexIn vin)
 {
+    VertexData v = UnpackVertex(vin, gPosDequantScale.xyz, gPosDequantBias.xyz);
     VertexOut vout = (VertexOut) 0.0f;
-    vout.PosW = mul(float4(vin.PosL, 1.0f), gWorld);
-    vout.NormalW = normalize(mul(vin.NormalL, (float3x3) gWorld));
+    vout.PosW = mul(float4(v.PosL, 1.0f), gWorld);
+    vout.NormalW = normalize(mul(v.NormalL, (float3x3) gWorld));
     vout.PosH = mul(float4(vout.PosW, 1.0f), gViewProj);
     
     return vout;
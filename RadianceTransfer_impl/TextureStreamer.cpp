@@ -0,0 +1,395 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+	using uint64 = std::uint64_t;
+
+	uint64 AlignUp(uint64 value, uint64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+TextureStreamer::TextureStreamer(TextureUploadDevice& device, const Options& options)
+	: mDevice(device), mOptions(options)
+{
+	// Several copies in flight at once, so the ring is not drained every frame.
+	mMaxCopyBytes = (std::max)(mDevice.UploadMemorySize() / 4, mDevice.PlacementAlignment());
+
+	const uint32 threads = (std::max)(mOptions.IoThreads, 1u);
+	for (uint32 i = 0; i < threads; ++i)
+		mIoThreads.emplace_back([this]() { IoThread(); });
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mIoMutex);
+		mStopping = true;
+	}
+	mIoWork.notify_all();
+	for (std::thread& thread : mIoThreads)
+		thread.join();
+}
+
+TextureStreamer::uint32 TextureStreamer::Request(const std::string& path, int priority)
+{
+	auto texture = std::make_unique<Texture>();
+	texture->Path = path;
+	texture->Priority = priority;
+	texture->RequestTime = std::chrono::high_resolution_clock::now();
+
+	Texture* t = texture.get();
+	const uint32 id = (uint32)mTextures.size();
+	mTextures.push_back(std::move(texture));
+
+	auto position = std::find_if(mUploadOrder.begin(), mUploadOrder.end(),
+		[priority](const Texture* other) { return other->Priority < priority; });
+	mUploadOrder.insert(position, t);
+
+	{
+		std::lock_guard<std::mutex> lock(mIoMutex);
+		mIoQueue.push_back(t);
+		++mIoPending;
+	}
+	mIoWork.notify_one();
+	return id;
+}
+
+void TextureStreamer::IoThread()
+{
+	for (;;)
+	{
+		Texture* texture = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mIoMutex);
+			mIoWork.wait(lock, [this]() { return mStopping || !mIoQueue.empty(); });
+			if (mStopping)
+				return;
+
+			// Highest priority first, then request order.
+			auto next = mIoQueue.begin();
+			for (auto it = mIoQueue.begin(); it != mIoQueue.end(); ++it)
+			{
+				if ((*it)->Priority > (*next)->Priority)
+					next = it;
+			}
+			texture = *next;
+			mIoQueue.erase(next);
+		}
+
+		auto readStart = std::chrono::high_resolution_clock::now();
+		ReadDds(*texture);
+		auto readEnd = std::chrono::high_resolution_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(mIoMutex);
+			texture->ReadMilliseconds = std::chrono::duration<double, std::milli>(readEnd - readStart).count();
+			texture->Read = true;
+			--mIoPending;
+		}
+		mIoDone.notify_all();
+	}
+}
+
+bool TextureStreamer::ReadDds(Texture& texture)
+{
+	std::string error;
+	if (!texture.File.Open(texture.Path, &error))
+	{
+		texture.ReadError = texture.Path + ": " + error;
+		return false;
+	}
+
+	const DDSReader& file = texture.File;
+	if (file.GetDimension() != DDSReader::Dimension::Texture2D)
+	{
+		texture.ReadError = texture.Path + ": only 2D textures and cube maps are streamed";
+		texture.File.Close();
+		return false;
+	}
+	// Copies go row by row, which needs whole bytes per texel or block in one plane.
+	if (DDS::IsPackedOrPlanar(file.Format()) ||
+		(!DDS::IsBlockCompressed(file.Format()) && DDS::BitsPerPixel(file.Format()) < 8))
+	{
+		texture.ReadError = texture.Path + ": unsupported pixel format";
+		texture.File.Close();
+		return false;
+	}
+
+	TextureUploadDevice::TextureDesc& desc = texture.ReadDesc;
+	desc.Width = file.Width();
+	desc.Height = file.Height();
+	desc.MipCount = file.MipCount();
+	desc.ArraySize = file.ArraySize();
+	desc.Format = file.Format();
+	desc.Cube = file.IsCube();
+
+	// Touch every page, so the file is read here and not while recording copies.
+	const std::uint8_t* data = file.BitData();
+	std::uint8_t sum = 0;
+	for (size_t i = 0; i < file.BitSize(); i += 4096)
+		sum += data[i];
+	volatile std::uint8_t sink = sum;
+	(void)sink;
+	return true;
+}
+
+void TextureStreamer::CreateReadTextures()
+{
+	std::vector<Texture*> read;
+	{
+		std::lock_guard<std::mutex> lock(mIoMutex);
+		for (const std::unique_ptr<Texture>& texture : mTextures)
+		{
+			if (texture->Read && texture->TextureStatus.TextureState == State::Reading)
+				read.push_back(texture.get());
+		}
+	}
+
+	for (Texture* texture : read)
+	{
+		Status& status = texture->TextureStatus;
+		status.ReadMilliseconds = texture->ReadMilliseconds;
+		if (!texture->ReadError.empty())
+		{
+			status.TextureState = State::Failed;
+			status.Error = texture->ReadError;
+			texture->File.Close();
+			continue;
+		}
+
+		status.Desc = texture->ReadDesc;
+		status.DeviceTexture = mDevice.CreateTexture(status.Desc);
+		status.ResidentMip = status.Desc.MipCount;
+		status.TextureState = State::Streaming;
+
+		// The smallest level is always part of the tail, however big it is.
+		status.TailMip = status.Desc.MipCount - 1;
+		while (status.TailMip > 0 && LevelBytes(*texture, status.TailMip - 1) <= mOptions.TailBytes)
+			--status.TailMip;
+
+		texture->NextLevel = (int)status.Desc.MipCount - 1;
+	}
+}
+
+TextureStreamer::uint64 TextureStreamer::LevelBytes(const Texture& texture, uint32 level)const
+{
+	const TextureUploadDevice::TextureDesc& desc = texture.TextureStatus.Desc;
+	uint64 bytes = 0;
+	for (uint32 slice = 0; slice < desc.ArraySize; ++slice)
+	{
+		const DDSReader::Subresource& subresource = texture.File.GetSubresource(level, slice);
+		bytes += AlignUp(subresource.RowBytes, mDevice.RowPitchAlignment()) * subresource.RowCount;
+	}
+	return bytes;
+}
+
+void TextureStreamer::RetireCopies(uint64 completed)
+{
+	while (!mRing.empty() && mRing.front().Fence != 0 && mRing.front().Fence <= completed)
+		mRing.pop_front();
+	if (mRing.empty())
+		mRingHead = 0;
+
+	for (Texture* texture : mUploadOrder)
+	{
+		Status& status = texture->TextureStatus;
+		uint32 resident = status.ResidentMip;
+		while (!texture->RecordedLevels.empty() && texture->RecordedLevels.front().second != 0 &&
+			texture->RecordedLevels.front().second <= completed)
+		{
+			resident = texture->RecordedLevels.front().first;
+			texture->RecordedLevels.pop_front();
+		}
+		if (resident == status.ResidentMip)
+			continue;
+
+		mDevice.SetResidentMip(status.DeviceTexture, resident);
+		status.ResidentMip = resident;
+		if (resident == 0)
+		{
+			status.TextureState = State::Resident;
+			status.ResidentMilliseconds = std::chrono::duration<double, std::milli>(
+				std::chrono::high_resolution_clock::now() - texture->RequestTime).count();
+			texture->File.Close();
+		}
+	}
+}
+
+bool TextureStreamer::AllocateRing(uint64 size, uint64& offset)
+{
+	const uint64 capacity = mDevice.UploadMemorySize();
+	if (size > capacity)
+		throw std::runtime_error("TextureStreamer: a copy does not fit in the upload ring");
+
+	uint64 begin = 0;
+	if (!mRing.empty())
+	{
+		// Free space is [head, capacity) and [0, tail) until the allocations wrap, then
+		// [head, tail).
+		const uint64 tail = mRing.front().Begin;
+		const bool wrapped = mRing.back().Begin < tail;
+		begin = AlignUp(mRingHead, mDevice.PlacementAlignment());
+		if (!wrapped && begin + size > capacity)
+			begin = 0;
+		if ((wrapped || begin == 0) && begin + size > tail)
+			return false;
+	}
+
+	RingAllocation allocation;
+	allocation.Begin = begin;
+	allocation.End = begin + size;
+	mRing.push_back(allocation);
+	mRingHead = allocation.End;
+	offset = begin;
+	return true;
+}
+
+bool TextureStreamer::RecordLevel(Texture& texture, uint64& budget)
+{
+	const TextureUploadDevice::TextureDesc& desc = texture.TextureStatus.Desc;
+	const uint32 level = (uint32)texture.NextLevel;
+	std::uint8_t* ring = mDevice.UploadMemory();
+
+	while (texture.NextSlice < desc.ArraySize)
+	{
+		const uint32 index = level + texture.NextSlice * desc.MipCount;
+		const DDSReader::Subresource& subresource = texture.File.GetSubresource(index);
+		const uint32 rowPitch = (uint32)AlignUp(subresource.RowBytes, mDevice.RowPitchAlignment());
+		const uint32 rows = (std::min)((uint32)subresource.RowCount - texture.NextRow,
+			(std::max)((uint32)(mMaxCopyBytes / rowPitch), 1u));
+
+		uint64 offset = 0;
+		if (!AllocateRing((uint64)rowPitch * rows, offset))
+			return false;
+
+		for (uint32 row = 0; row < rows; ++row)
+		{
+			std::memcpy(ring + offset + (uint64)row * rowPitch,
+				subresource.Data + (uint64)(texture.NextRow + row) * subresource.RowBytes, subresource.RowBytes);
+		}
+		mDevice.RecordCopy(texture.TextureStatus.DeviceTexture, index, texture.NextRow, rows,
+			offset, rowPitch, (uint32)subresource.RowBytes);
+
+		const uint64 bytes = (uint64)subresource.RowBytes * rows;
+		mStats.BytesUploaded += bytes;
+		++mStats.Copies;
+		budget -= (std::min)(budget, bytes);
+
+		texture.NextRow += rows;
+		if (texture.NextRow == subresource.RowCount)
+		{
+			texture.NextRow = 0;
+			++texture.NextSlice;
+		}
+		if (budget == 0 && texture.NextSlice < desc.ArraySize)
+			return true;
+	}
+
+	texture.RecordedLevels.push_back(std::make_pair(level, (uint64)0));
+	--texture.NextLevel;
+	texture.NextSlice = 0;
+	return true;
+}
+
+void TextureStreamer::Pump(bool tailsOnly)
+{
+	CreateReadTextures();
+	RetireCopies(mDevice.CompletedFence());
+
+	const uint32 copies = mStats.Copies;
+	bool full = false;
+
+	// The tails go out first and regardless of the budget: until they are resident the
+	// texture cannot be sampled at all.
+	for (Texture* texture : mUploadOrder)
+	{
+		if (texture->TextureStatus.TextureState != State::Streaming)
+			continue;
+		uint64 unlimited = (std::numeric_limits<uint64>::max)();
+		while (!full && texture->NextLevel >= (int)texture->TextureStatus.TailMip)
+			full = !RecordLevel(*texture, unlimited);
+	}
+
+	// Then one more level per texture, as far as the budget goes.
+	uint64 budget = mOptions.BytesPerUpdate;
+	for (Texture* texture : mUploadOrder)
+	{
+		if (tailsOnly || full || budget == 0)
+			break;
+		if (texture->TextureStatus.TextureState == State::Streaming && texture->NextLevel >= 0)
+			full = !RecordLevel(*texture, budget);
+	}
+	if (full)
+		++mStats.RingStalls;
+
+	if (mStats.Copies == copies)
+		return;
+
+	mLastFence = mDevice.Submit();
+	++mStats.Submissions;
+	for (RingAllocation& allocation : mRing)
+	{
+		if (allocation.Fence == 0)
+			allocation.Fence = mLastFence;
+	}
+	for (Texture* texture : mUploadOrder)
+	{
+		for (std::pair<uint32, uint64>& level : texture->RecordedLevels)
+		{
+			if (level.second == 0)
+				level.second = mLastFence;
+		}
+	}
+}
+
+void TextureStreamer::Update()
+{
+	Pump(false);
+}
+
+void TextureStreamer::WaitForHeaders()
+{
+	{
+		std::unique_lock<std::mutex> lock(mIoMutex);
+		mIoDone.wait(lock, [this]() { return mIoPending == 0; });
+	}
+	CreateReadTextures();
+}
+
+void TextureStreamer::WaitForTails()
+{
+	WaitForHeaders();
+	for (;;)
+	{
+		Pump(true);
+
+		bool done = true;
+		for (const std::unique_ptr<Texture>& texture : mTextures)
+		{
+			const Status& status = texture->TextureStatus;
+			if (status.TextureState == State::Streaming && status.ResidentMip > status.TailMip)
+				done = false;
+		}
+		if (done)
+			return;
+		mDevice.WaitForFence(mLastFence);
+	}
+}
+
+bool TextureStreamer::Idle()const
+{
+	for (const std::unique_ptr<Texture>& texture : mTextures)
+	{
+		const State state = texture->TextureStatus.TextureState;
+		if (state != State::Failed && state != State::Resident)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/DDSReader.h"
+
+// What the streamer needs from the GPU side: textures with every mip allocated, a
+// persistently mapped upload ring, a queue that copies from it, and a way to tell
+// shaders which mips they may sample.  D3D12TextureUploadDevice implements it with a
+// copy queue, MockTextureUploadDevice on the CPU.
+class TextureUploadDevice
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct TextureDesc
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+		uint32 MipCount = 1;
+		uint32 ArraySize = 1; // 6 for a cube map
+		uint32 Format = 0;    // DXGI_FORMAT
+		bool Cube = false;
+	};
+
+	virtual ~TextureUploadDevice() = default;
+
+	// Allocates every mip; none of them can be sampled until SetResidentMip.
+	virtual uint32 CreateTexture(const TextureDesc& desc) = 0;
+
+	// The upload ring.  The streamer owns its allocation and only writes to ranges
+	// whose copies have completed.
+	virtual std::uint8_t* UploadMemory() = 0;
+	virtual uint64 UploadMemorySize()const = 0;
+	virtual uint64 PlacementAlignment()const = 0;
+	virtual uint32 RowPitchAlignment()const = 0;
+
+	// Records a copy of rows [firstRow, firstRow + rowCount) of a subresource, laid out at
+	// 'offset' in the upload ring with 'rowPitch' bytes between rows.  Rows are block rows
+	// for compressed formats; 'rowBytes' is the used part of each.
+	virtual void RecordCopy(uint32 texture, uint32 subresource, uint32 firstRow, uint32 rowCount,
+		uint64 offset, uint32 rowPitch, uint32 rowBytes) = 0;
+
+	// Submits the copies recorded since the last call.  Returns the fence value that
+	// CompletedFence() reaches when they are done.
+	virtual uint64 Submit() = 0;
+	virtual uint64 CompletedFence() = 0;
+	virtual void WaitForFence(uint64 fence) = 0;
+
+	// Lets shaders sample mips [mostDetailedMip, MipCount).  Only called once the copies
+	// of those mips have completed.
+	virtual void SetResidentMip(uint32 texture, uint32 mostDetailedMip) = 0;
+};
+
+// Streams DDS textures in.  Files are mapped and read on I/O threads; the main thread
+// then uploads them through the device's ring, smallest mips first: the tail of every
+// texture before anything else, then one more level per texture per Update(), higher
+// priorities first and within a byte budget.  A mip becomes visible to shaders once
+// its copy and those of every smaller mip have completed.
+//
+// Everything except the I/O threads runs on the thread calling Update().
+class TextureStreamer
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Options
+	{
+		uint32 IoThreads = 2;
+		// Levels of at most this many bytes, summed over cube faces, form the tail that is
+		// uploaded as soon as a file is read.
+		uint64 TailBytes = 64 * 1024;
+		// Upload bytes recorded per Update().  A copy that does not fit still goes out on
+		// its own, so large mips make progress.
+		uint64 BytesPerUpdate = 4 * 1024 * 1024;
+	};
+
+	enum class State
+	{
+		Reading,
+		Failed,
+		Streaming,
+		Resident
+	};
+
+	struct Status
+	{
+		State TextureState = State::Reading;
+		std::string Error;
+		uint32 DeviceTexture = 0;
+		TextureUploadDevice::TextureDesc Desc;
+		uint32 ResidentMip = 0;    // most detailed mip shaders can sample, Desc.MipCount while none
+		uint32 TailMip = 0;        // most detailed mip of the tail
+		double ReadMilliseconds = 0.0;
+		double ResidentMilliseconds = 0.0; // from Request() until every mip was resident
+	};
+
+	struct Stats
+	{
+		uint64 BytesUploaded = 0;
+		uint32 Copies = 0;
+		uint32 Submissions = 0;
+		uint32 RingStalls = 0; // Update() calls that stopped because the ring was full
+	};
+
+	TextureStreamer(TextureUploadDevice& device, const Options& options);
+	TextureStreamer(const TextureStreamer& rhs) = delete;
+	TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+	~TextureStreamer();
+
+	// Queues 'path' for reading; higher priorities are read and promoted first.  Returns
+	// the id to query the texture with.
+	uint32 Request(const std::string& path, int priority = 0);
+
+	// Blocks until every requested file was read and its device texture created, so
+	// views can be made for it.  Failed reads are left for the caller to check.
+	void WaitForHeaders();
+
+	// Blocks until the tail of every texture is resident, so each can be sampled.
+	void WaitForTails();
+
+	// Retires completed copies, raises residency, then records and submits the next
+	// copies.  Call once per frame at a point where the device may rewrite views.
+	void Update();
+
+	// True when every texture is resident or failed.
+	bool Idle()const;
+
+	const Status& GetStatus(uint32 id)const { return mTextures[id]->TextureStatus; }
+	uint32 TextureCount()const { return (uint32)mTextures.size(); }
+	const Stats& GetStats()const { return mStats; }
+
+private:
+	struct Texture
+	{
+		std::string Path;
+		int Priority = 0;
+		std::chrono::high_resolution_clock::time_point RequestTime;
+		Status TextureStatus;
+
+		// Filled in by the I/O thread; the status is only updated from them on the
+		// main thread, once Read is set.
+		DDSReader File;
+		TextureUploadDevice::TextureDesc ReadDesc;
+		std::string ReadError;
+		double ReadMilliseconds = 0.0;
+		bool Read = false;
+
+		// Upload cursor: the level being recorded, counting down to 0, and the slice and
+		// row within it to continue from.
+		int NextLevel = -1;
+		uint32 NextSlice = 0;
+		uint32 NextRow = 0;
+
+		// Levels whose copies were all recorded, oldest first, with the fence that
+		// signals them.  A fence of 0 means not submitted yet.
+		std::deque<std::pair<uint32, uint64>> RecordedLevels;
+	};
+
+	struct RingAllocation
+	{
+		uint64 Begin = 0;
+		uint64 End = 0;
+		uint64 Fence = 0;
+	};
+
+	void IoThread();
+	static bool ReadDds(Texture& texture);
+
+	// Records and submits the next copies; with 'tailsOnly' set, only those of the tails.
+	void Pump(bool tailsOnly);
+	void CreateReadTextures();
+	void RetireCopies(uint64 completed);
+	bool AllocateRing(uint64 size, uint64& offset);
+	uint64 LevelBytes(const Texture& texture, uint32 level)const;
+	// Records copies for the current level of 'texture' until it is done, 'budget' runs
+	// out or the ring is full.  Returns false on a full ring.
+	bool RecordLevel(Texture& texture, uint64& budget);
+
+private:
+	TextureUploadDevice& mDevice;
+	Options mOptions;
+
+	std::vector<std::unique_ptr<Texture>> mTextures;
+	// Textures by descending priority, then request order.
+	std::vector<Texture*> mUploadOrder;
+
+	std::vector<std::thread> mIoThreads;
+	mutable std::mutex mIoMutex;
+	std::condition_variable mIoWork;
+	std::condition_variable mIoDone;
+	std::vector<Texture*> mIoQueue;
+	uint32 mIoPending = 0;
+	bool mStopping = false;
+
+	std::deque<RingAllocation> mRing;
+	uint64 mRingHead = 0;
+	uint64 mMaxCopyBytes = 0;
+	uint64 mLastFence = 0;
+
+	Stats mStats;
+};
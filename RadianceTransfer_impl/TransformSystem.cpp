@@ -0,0 +1,219 @@
+#include "TransformSystem.h"
+
+#include <atomic>
+#include <chrono>
+
+#include "../Common/JobSystem.h"
+
+using namespace DirectX;
+
+static_assert(64 % TransformSystem::BatchWidth == 0, "a batch must not straddle two bitset words");
+
+namespace
+{
+	std::uint32_t PopCount(std::uint64_t bits)
+	{
+		std::uint32_t count = 0;
+		for (; bits != 0; bits &= bits - 1)
+			++count;
+		return count;
+	}
+
+	// Words of the bitsets one job takes when Update() is spread over the job system.
+	const std::uint32_t WordsPerJob = 16;
+}
+
+void TransformSystem::Reserve(uint32 count)
+{
+	const size_t padded = (count + BatchWidth - 1) / BatchWidth * BatchWidth;
+	for (std::vector<float>* lanes : { &mPositionX, &mPositionY, &mPositionZ, &mScaleX, &mScaleY, &mScaleZ })
+		lanes->reserve(padded);
+	for (std::vector<XMFLOAT4X4>* matrices : { &mWorld, &mInvWorld, &mPrevWorld, &mWorldT, &mInvWorldT, &mPrevWorldT })
+		matrices->reserve(padded);
+}
+
+TransformSystem::uint32 TransformSystem::Add(const XMFLOAT3& position, const XMFLOAT3& scale)
+{
+	const uint32 id = mCount++;
+	if (id % BatchWidth == 0)
+	{
+		for (std::vector<float>* lanes : { &mPositionX, &mPositionY, &mPositionZ })
+			lanes->resize(id + BatchWidth, 0.0f);
+		for (std::vector<float>* lanes : { &mScaleX, &mScaleY, &mScaleZ })
+			lanes->resize(id + BatchWidth, 1.0f);
+
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		for (std::vector<XMFLOAT4X4>* matrices : { &mWorld, &mInvWorld, &mPrevWorld, &mWorldT, &mInvWorldT, &mPrevWorldT })
+			matrices->resize(id + BatchWidth, identity);
+	}
+	if (id % 64 == 0)
+	{
+		mDirty.push_back(0);
+		mMoved.push_back(0);
+		mUpdated.push_back(0);
+	}
+
+	mPositionX[id] = position.x;
+	mPositionY[id] = position.y;
+	mPositionZ[id] = position.z;
+	mScaleX[id] = scale.x;
+	mScaleY[id] = scale.y;
+	mScaleZ[id] = scale.z;
+
+	XMMATRIX world = XMMatrixScaling(scale.x, scale.y, scale.z) * XMMatrixTranslation(position.x, position.y, position.z);
+	XMStoreFloat4x4(&mWorld[id], world);
+	XMStoreFloat4x4(&mPrevWorld[id], world);
+	XMStoreFloat4x4(&mWorldT[id], XMMatrixTranspose(world));
+	XMStoreFloat4x4(&mPrevWorldT[id], XMMatrixTranspose(world));
+
+	XMMATRIX invWorld = XMMatrixTranslation(-position.x, -position.y, -position.z) *
+		XMMatrixScaling(1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z);
+	XMStoreFloat4x4(&mInvWorld[id], invWorld);
+	XMStoreFloat4x4(&mInvWorldT[id], XMMatrixTranspose(invWorld));
+
+	// Whoever consumes the matrices picks the object up in the next Update().
+	MarkDirty(id);
+	return id;
+}
+
+XMFLOAT3 TransformSystem::Position(uint32 id)const
+{
+	return XMFLOAT3(mPositionX[id], mPositionY[id], mPositionZ[id]);
+}
+
+XMFLOAT3 TransformSystem::Scale(uint32 id)const
+{
+	return XMFLOAT3(mScaleX[id], mScaleY[id], mScaleZ[id]);
+}
+
+void TransformSystem::SetPosition(uint32 id, const XMFLOAT3& position)
+{
+	mPositionX[id] = position.x;
+	mPositionY[id] = position.y;
+	mPositionZ[id] = position.z;
+	MarkDirty(id);
+}
+
+void TransformSystem::SetScale(uint32 id, const XMFLOAT3& scale)
+{
+	mScaleX[id] = scale.x;
+	mScaleY[id] = scale.y;
+	mScaleZ[id] = scale.z;
+	MarkDirty(id);
+}
+
+void TransformSystem::Translate(uint32 id, const XMFLOAT3& offset)
+{
+	mPositionX[id] += offset.x;
+	mPositionY[id] += offset.y;
+	mPositionZ[id] += offset.z;
+	MarkDirty(id);
+}
+
+void TransformSystem::Update(JobSystem* jobs)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	std::atomic<uint32> updated{ 0 };
+	std::atomic<uint32> batches{ 0 };
+	auto updateWords = [this, &updated, &batches](uint32 firstWord, uint32 lastWord)
+	{
+		uint32 wordsUpdated = 0;
+		uint32 wordsBatches = 0;
+		for (uint32 w = firstWord; w < lastWord; ++w)
+		{
+			const uint64 bits = mDirty[w] | mMoved[w];
+			mUpdated[w] = bits;
+			mMoved[w] = mDirty[w];
+			mDirty[w] = 0;
+			if (bits == 0)
+				continue;
+
+			wordsUpdated += PopCount(bits);
+			for (uint32 lane = 0; lane < 64; lane += BatchWidth)
+			{
+				if ((bits >> lane) & ((uint64(1) << BatchWidth) - 1))
+				{
+					UpdateBatch(w * 64 + lane);
+					++wordsBatches;
+				}
+			}
+		}
+		updated += wordsUpdated;
+		batches += wordsBatches;
+	};
+
+	const uint32 wordCount = (uint32)mDirty.size();
+	if (jobs != nullptr)
+		jobs->ParallelFor(wordCount, WordsPerJob, updateWords);
+	else
+		updateWords(0, wordCount);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	mStats.Objects = mCount;
+	mStats.Updated = updated;
+	mStats.Batches = batches;
+	mStats.Milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void TransformSystem::UpdateBatch(uint32 first)
+{
+	// Lanes of the batch; everything below is the same operation on BatchWidth floats.
+	float sx[BatchWidth], sy[BatchWidth], sz[BatchWidth];
+	float tx[BatchWidth], ty[BatchWidth], tz[BatchWidth];
+	float isx[BatchWidth], isy[BatchWidth], isz[BatchWidth];
+	float itx[BatchWidth], ity[BatchWidth], itz[BatchWidth];
+
+	for (uint32 l = 0; l < BatchWidth; ++l)
+	{
+		sx[l] = mScaleX[first + l];
+		sy[l] = mScaleY[first + l];
+		sz[l] = mScaleZ[first + l];
+		tx[l] = mPositionX[first + l];
+		ty[l] = mPositionY[first + l];
+		tz[l] = mPositionZ[first + l];
+	}
+
+	// (S T)^-1 = T^-1 S^-1: the reciprocal scales, and the translation negated and scaled.
+	for (uint32 l = 0; l < BatchWidth; ++l)
+	{
+		isx[l] = 1.0f / sx[l];
+		isy[l] = 1.0f / sy[l];
+		isz[l] = 1.0f / sz[l];
+		itx[l] = -tx[l] * isx[l];
+		ity[l] = -ty[l] * isy[l];
+		itz[l] = -tz[l] * isz[l];
+	}
+
+	// The world being replaced is the previous one.
+	for (uint32 l = 0; l < BatchWidth; ++l)
+	{
+		mPrevWorld[first + l] = mWorld[first + l];
+		mPrevWorldT[first + l] = mWorldT[first + l];
+	}
+
+	for (uint32 l = 0; l < BatchWidth; ++l)
+	{
+		mWorld[first + l] = XMFLOAT4X4(
+			sx[l], 0.0f, 0.0f, 0.0f,
+			0.0f, sy[l], 0.0f, 0.0f,
+			0.0f, 0.0f, sz[l], 0.0f,
+			tx[l], ty[l], tz[l], 1.0f);
+		mWorldT[first + l] = XMFLOAT4X4(
+			sx[l], 0.0f, 0.0f, tx[l],
+			0.0f, sy[l], 0.0f, ty[l],
+			0.0f, 0.0f, sz[l], tz[l],
+			0.0f, 0.0f, 0.0f, 1.0f);
+		mInvWorld[first + l] = XMFLOAT4X4(
+			isx[l], 0.0f, 0.0f, 0.0f,
+			0.0f, isy[l], 0.0f, 0.0f,
+			0.0f, 0.0f, isz[l], 0.0f,
+			itx[l], ity[l], itz[l], 1.0f);
+		mInvWorldT[first + l] = XMFLOAT4X4(
+			isx[l], 0.0f, 0.0f, itx[l],
+			0.0f, isy[l], 0.0f, ity[l],
+			0.0f, 0.0f, isz[l], itz[l],
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
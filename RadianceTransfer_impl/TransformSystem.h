@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+class JobSystem;
+
+// Positions and scales of the scene's objects, kept as a structure of arrays, and the
+// matrices derived from them: world, inverse world and the world as of the previous
+// Update(), each also transposed for shaders.
+//
+// Moving an object sets its dirty bit.  Update() recomputes every object whose bit is
+// set, and every object that moved in the Update() before, so that its previous world
+// catches up.  It works on BatchWidth consecutive objects at a time, one array of lanes
+// per input and matrix element, which compilers turn into vector code; a clean object
+// that shares a batch with a dirty one is recomputed to the same values.
+//
+// World is scale then translation, as everywhere else in the app, so the inverse is
+// diagonal plus translation too and needs no general 4x4 inverse.  Scales must not be
+// zero.
+class TransformSystem
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint32 BatchWidth = 8;
+
+	struct Stats
+	{
+		uint32 Objects = 0;
+		uint32 Updated = 0;     // objects whose matrices changed in the last Update()
+		uint32 Batches = 0;
+		double Milliseconds = 0.0;
+	};
+
+	void Reserve(uint32 count);
+
+	// Returns the object's id; its previous world starts out as its world.
+	uint32 Add(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& scale);
+	uint32 Count()const { return mCount; }
+
+	DirectX::XMFLOAT3 Position(uint32 id)const;
+	DirectX::XMFLOAT3 Scale(uint32 id)const;
+	void SetPosition(uint32 id, const DirectX::XMFLOAT3& position);
+	void SetScale(uint32 id, const DirectX::XMFLOAT3& scale);
+	void Translate(uint32 id, const DirectX::XMFLOAT3& offset);
+
+	// Recomputes the objects described above, spread over 'jobs' when given.
+	void Update(JobSystem* jobs = nullptr);
+
+	// Whether the matrices of 'id' changed in the last Update().
+	bool WasUpdated(uint32 id)const { return (mUpdated[id / 64] >> (id % 64)) & 1; }
+
+	// Row-major, as XMStoreFloat4x4 writes them; the transposed ones are what the shaders'
+	// column-major cbuffers expect.
+	const DirectX::XMFLOAT4X4& World(uint32 id)const { return mWorld[id]; }
+	const DirectX::XMFLOAT4X4& InvWorld(uint32 id)const { return mInvWorld[id]; }
+	const DirectX::XMFLOAT4X4& PrevWorld(uint32 id)const { return mPrevWorld[id]; }
+	const DirectX::XMFLOAT4X4& WorldTransposed(uint32 id)const { return mWorldT[id]; }
+	const DirectX::XMFLOAT4X4& InvWorldTransposed(uint32 id)const { return mInvWorldT[id]; }
+	const DirectX::XMFLOAT4X4& PrevWorldTransposed(uint32 id)const { return mPrevWorldT[id]; }
+
+	const Stats& GetStats()const { return mStats; }
+
+private:
+	void MarkDirty(uint32 id) { mDirty[id / 64] |= uint64(1) << (id % 64); }
+
+	// Recomputes objects [first, first + BatchWidth).
+	void UpdateBatch(uint32 first);
+
+private:
+	uint32 mCount = 0;
+
+	// Padded to a whole batch with unit scales, so batches never check the count.
+	std::vector<float> mPositionX, mPositionY, mPositionZ;
+	std::vector<float> mScaleX, mScaleY, mScaleZ;
+
+	std::vector<DirectX::XMFLOAT4X4> mWorld, mInvWorld, mPrevWorld;
+	std::vector<DirectX::XMFLOAT4X4> mWorldT, mInvWorldT, mPrevWorldT;
+
+	// A bit per object: moved since the last Update(), moved in it, recomputed by it.
+	std::vector<uint64> mDirty;
+	std::vector<uint64> mMoved;
+	std::vector<uint64> mUpdated;
+
+	Stats mStats;
+};
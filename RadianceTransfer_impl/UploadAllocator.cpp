@@ -0,0 +1,145 @@
+#include "UploadAllocator.h"
+
+#include <algorithm>
+
+const UploadAllocator::uint64 UploadAllocator::ConstantBufferAlignment;
+
+namespace
+{
+	UploadAllocator::uint64 AlignUp(UploadAllocator::uint64 value, UploadAllocator::uint64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+UploadAllocator::UploadAllocator(UploadMemoryDevice& device, uint64 capacity)
+	: mDevice(device)
+{
+	mCapacity = AlignUp((std::max)(capacity, ConstantBufferAlignment), ConstantBufferAlignment);
+	mBlock = mDevice.CreateBlock(mCapacity, &mMemory);
+
+	mStats.Capacity = mCapacity;
+	mStats.Blocks = 1;
+}
+
+UploadAllocator::~UploadAllocator()
+{
+	for (const RetiredBlock& retired : mRetired)
+		mDevice.DestroyBlock(retired.Block);
+	mDevice.DestroyBlock(mBlock);
+}
+
+void UploadAllocator::BeginFrame(uint64 completedFence)
+{
+	while (!mFrames.empty() && mFrames.front().Fence <= completedFence)
+	{
+		const Frame& frame = mFrames.front();
+		// Frames in a block that was replaced go with the block.
+		if (frame.Block == mBlock)
+		{
+			// The tail only goes back when it follows the head around the end.
+			if (frame.End < mTail)
+				mWrapped = false;
+			mTail = frame.End;
+		}
+		mFrames.pop_front();
+	}
+
+	// Nothing in flight: start over at the front rather than wrap later.
+	if (mFrames.empty())
+	{
+		mHead = 0;
+		mTail = 0;
+		mWrapped = false;
+	}
+
+	for (size_t i = 0; i < mRetired.size();)
+	{
+		if (mRetired[i].Fence != 0 && mRetired[i].Fence <= completedFence)
+		{
+			mDevice.DestroyBlock(mRetired[i].Block);
+			mRetired[i] = mRetired.back();
+			mRetired.pop_back();
+		}
+		else
+			++i;
+	}
+
+	mStats.FrameBytes = 0;
+	mStats.Blocks = 1 + (uint32)mRetired.size();
+}
+
+UploadAllocator::Allocation UploadAllocator::Allocate(uint64 size, uint64 alignment)
+{
+	const uint64 alignedSize = (std::max)(AlignUp(size, alignment), alignment);
+
+	uint64 offset = AlignUp(mHead, alignment);
+	if (!mWrapped && offset + alignedSize > mCapacity)
+	{
+		// Skip the end of the block if what the GPU released at the front is enough.  The
+		// head must stay behind the tail, or a full ring would look empty.
+		if (alignedSize < mTail)
+		{
+			mStats.FrameBytes += mCapacity - mHead;
+			mHead = 0;
+			offset = 0;
+			mWrapped = true;
+			++mStats.Wraps;
+		}
+		else
+		{
+			Grow(alignedSize);
+			offset = 0;
+		}
+	}
+	else if (mWrapped && offset + alignedSize >= mTail)
+	{
+		Grow(alignedSize);
+		offset = 0;
+	}
+
+	mStats.FrameBytes += offset + alignedSize - mHead;
+	mHead = offset + alignedSize;
+
+	Allocation allocation;
+	allocation.CpuAddress = mMemory.CpuAddress + offset;
+	allocation.GpuAddress = mMemory.GpuAddress + offset;
+	allocation.Size = alignedSize;
+	return allocation;
+}
+
+void UploadAllocator::EndFrame(uint64 fence)
+{
+	Frame frame;
+	frame.Fence = fence;
+	frame.Block = mBlock;
+	frame.End = mHead;
+	mFrames.push_back(frame);
+
+	for (RetiredBlock& retired : mRetired)
+	{
+		if (retired.Fence == 0)
+			retired.Fence = fence;
+	}
+
+	mStats.PeakFrameBytes = (std::max)(mStats.PeakFrameBytes, mStats.FrameBytes);
+}
+
+void UploadAllocator::Grow(uint64 size)
+{
+	// The frames in flight and this one's allocations so far stay where they are; the
+	// block goes once the GPU is done with this frame.
+	RetiredBlock retired;
+	retired.Block = mBlock;
+	mRetired.push_back(retired);
+
+	mCapacity = (std::max)(mCapacity * 2, AlignUp(size, ConstantBufferAlignment));
+	mBlock = mDevice.CreateBlock(mCapacity, &mMemory);
+	mHead = 0;
+	mTail = 0;
+	mWrapped = false;
+
+	mStats.Capacity = mCapacity;
+	mStats.Blocks = 1 + (uint32)mRetired.size();
+	++mStats.Growths;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// What the allocator needs from the graphics API: blocks of memory the CPU writes and
+// the GPU reads in place, mapped for as long as they live.  D3D12UploadMemoryDevice
+// makes them committed upload buffers, MockUploadMemoryDevice plain CPU memory.
+class UploadMemoryDevice
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Block
+	{
+		std::uint8_t* CpuAddress = nullptr;
+		uint64 GpuAddress = 0;
+	};
+
+	virtual ~UploadMemoryDevice() = default;
+
+	// Returns the id DestroyBlock takes.
+	virtual uint32 CreateBlock(uint64 size, Block* block) = 0;
+
+	// Only called once the GPU has finished reading the block.
+	virtual void DestroyBlock(uint32 id) = 0;
+};
+
+// Linear allocator for the data the CPU writes every frame and the GPU reads once:
+// constants, structured buffers, shader records.  Everything comes from one persistently
+// mapped block used as a ring; a frame's allocations are contiguous after the last
+// frame's, and are only written over again once the fence the frame was tagged with in
+// EndFrame has completed.
+//
+// When a frame does not fit in what the GPU has released, a block twice the size (or
+// large enough for the allocation) replaces the current one, which is destroyed once
+// its last frame completes, so a frame never waits on the GPU here and the ring settles
+// at a size that holds the frames in flight.
+//
+// One thread allocates at a time.
+class UploadAllocator
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// What constant buffer views need for offset and size.
+	static const uint64 ConstantBufferAlignment = 256;
+
+	struct Allocation
+	{
+		std::uint8_t* CpuAddress = nullptr;
+		uint64 GpuAddress = 0;
+		uint64 Size = 0;
+	};
+
+	struct Stats
+	{
+		uint64 Capacity = 0;        // of the current block
+		uint64 FrameBytes = 0;      // allocated since BeginFrame, alignment included
+		uint64 PeakFrameBytes = 0;
+		uint32 Blocks = 0;          // current and not yet destroyed ones
+		uint32 Growths = 0;
+		uint32 Wraps = 0;
+	};
+
+	UploadAllocator(UploadMemoryDevice& device, uint64 capacity);
+	UploadAllocator(const UploadAllocator& rhs) = delete;
+	UploadAllocator& operator=(const UploadAllocator& rhs) = delete;
+	// Destroys every block; the GPU must be done with all of them.
+	~UploadAllocator();
+
+	// Releases the memory of the frames whose fence is at most 'completedFence'.
+	void BeginFrame(uint64 completedFence);
+
+	// 'alignment' must be a power of two.  The size is rounded up to it, so constant
+	// buffers get whole 256-byte slices.
+	Allocation Allocate(uint64 size, uint64 alignment = ConstantBufferAlignment);
+
+	// Copies 'data' into a constant buffer slice of its own.
+	template<typename T>
+	Allocation Push(const T& data)
+	{
+		Allocation allocation = Allocate(sizeof(T));
+		std::memcpy(allocation.CpuAddress, &data, sizeof(T));
+		return allocation;
+	}
+
+	// Tags what was allocated since BeginFrame with the fence the GPU signals once it has
+	// read it.
+	void EndFrame(uint64 fence);
+
+	const Stats& GetStats()const { return mStats; }
+
+private:
+	struct Frame
+	{
+		uint64 Fence = 0;
+		uint32 Block = 0;
+		uint64 End = 0; // head of the block after the frame
+	};
+
+	struct RetiredBlock
+	{
+		uint32 Block = 0;
+		uint64 Fence = 0; // 0 until the frame that retired it ends
+	};
+
+	void Grow(uint64 size);
+
+private:
+	UploadMemoryDevice& mDevice;
+
+	uint32 mBlock = 0;
+	UploadMemoryDevice::Block mMemory;
+	uint64 mCapacity = 0;
+
+	// Free memory is [mHead, mCapacity) and [0, mTail), or [mHead, mTail) once the head
+	// has wrapped behind the tail.
+	uint64 mHead = 0;
+	uint64 mTail = 0;
+	bool mWrapped = false;
+
+	std::deque<Frame> mFrames; // in flight, oldest first
+	std::vector<RetiredBlock> mRetired;
+
+	Stats mStats;
+};
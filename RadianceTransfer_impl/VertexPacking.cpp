@@ -0,0 +1,238 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace VertexPacking
+{
+
+namespace
+{
+	const float kSnormMax = 32767.0f;
+	const float kPi = 3.1415926535f;
+
+	std::int16_t FloatToSnorm16(float v)
+	{
+		v = (std::max)(-1.0f, (std::min)(1.0f, v));
+		return std::int16_t(std::lround(v * kSnormMax));
+	}
+
+	// Same rule the input assembler uses: -32768 and -32767 both map to -1.
+	float Snorm16ToFloat(std::int16_t v)
+	{
+		return (std::max)(float(v) / kSnormMax, -1.0f);
+	}
+
+	float SignNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	float Length(const XMFLOAT3& v)
+	{
+		return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+	}
+
+	// Angle between two directions in degrees; zero-length inputs count as exact.
+	float AngleDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		const float la = Length(a);
+		const float lb = Length(b);
+		if (la == 0.0f || lb == 0.0f)
+			return 0.0f;
+
+		float c = (a.x * b.x + a.y * b.y + a.z * b.z) / (la * lb);
+		c = (std::max)(-1.0f, (std::min)(1.0f, c));
+		return std::acos(c) * 180.0f / kPi;
+	}
+}
+
+PositionDequantization MakeDequantization(const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	// A flat axis (the grid's y, for example) would divide by zero; any scale works there.
+	PositionDequantization dq;
+	dq.Scale = XMFLOAT3(
+		extents.x > 0.0f ? extents.x : 1.0f,
+		extents.y > 0.0f ? extents.y : 1.0f,
+		extents.z > 0.0f ? extents.z : 1.0f);
+	dq.Bias = center;
+	return dq;
+}
+
+PositionDequantization ComputeDequantization(const GeometryGenerator::Vertex* vertices, size_t count)
+{
+	if (count == 0)
+		return PositionDequantization();
+
+	XMFLOAT3 vMin = vertices[0].Position;
+	XMFLOAT3 vMax = vertices[0].Position;
+	for (size_t i = 1; i < count; ++i)
+	{
+		const XMFLOAT3& p = vertices[i].Position;
+		vMin = XMFLOAT3((std::min)(vMin.x, p.x), (std::min)(vMin.y, p.y), (std::min)(vMin.z, p.z));
+		vMax = XMFLOAT3((std::max)(vMax.x, p.x), (std::max)(vMax.y, p.y), (std::max)(vMax.z, p.z));
+	}
+
+	return MakeDequantization(
+		XMFLOAT3(0.5f * (vMin.x + vMax.x), 0.5f * (vMin.y + vMax.y), 0.5f * (vMin.z + vMax.z)),
+		XMFLOAT3(0.5f * (vMax.x - vMin.x), 0.5f * (vMax.y - vMin.y), 0.5f * (vMax.z - vMin.z)));
+}
+
+void EncodeOctahedral(const XMFLOAT3& n, std::int16_t out[2])
+{
+	const float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	if (l1 == 0.0f)
+	{
+		out[0] = out[1] = 0;
+		return;
+	}
+
+	float x = n.x / l1;
+	float y = n.y / l1;
+	if (n.z < 0.0f)
+	{
+		// Fold the lower hemisphere over the diagonals.
+		const float fx = (1.0f - std::fabs(y)) * SignNotZero(x);
+		const float fy = (1.0f - std::fabs(x)) * SignNotZero(y);
+		x = fx;
+		y = fy;
+	}
+
+	out[0] = FloatToSnorm16(x);
+	out[1] = FloatToSnorm16(y);
+}
+
+XMFLOAT3 DecodeOctahedral(const std::int16_t in[2])
+{
+	XMFLOAT3 n(Snorm16ToFloat(in[0]), Snorm16ToFloat(in[1]), 0.0f);
+	n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+
+	const float t = (std::max)(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	const float length = Length(n);
+	return XMFLOAT3(n.x / length, n.y / length, n.z / length);
+}
+
+std::uint16_t FloatToHalf(float f)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+
+	const std::uint32_t sign = (bits >> 16) & 0x8000u;
+	const std::uint32_t exponent = (bits >> 23) & 0xffu;
+	std::uint32_t mantissa = bits & 0x7fffffu;
+
+	if (exponent == 0xffu)
+		return std::uint16_t(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+
+	const int e = int(exponent) - 127 + 15;
+	if (e >= 31)
+		return std::uint16_t(sign | 0x7c00u);
+
+	if (e <= 0)
+	{
+		// Subnormal half, or zero.
+		if (e < -10)
+			return std::uint16_t(sign);
+
+		mantissa |= 0x800000u;
+		const std::uint32_t shift = std::uint32_t(14 - e);
+		std::uint32_t h = mantissa >> shift;
+		const std::uint32_t rest = mantissa & ((1u << shift) - 1u);
+		const std::uint32_t halfway = 1u << (shift - 1u);
+		if (rest > halfway || (rest == halfway && (h & 1u)))
+			++h;
+		return std::uint16_t(sign | h);
+	}
+
+	// Rounding may carry into the exponent, which still yields the right result (up to infinity).
+	std::uint32_t h = (std::uint32_t(e) << 10) | (mantissa >> 13);
+	const std::uint32_t rest = mantissa & 0x1fffu;
+	if (rest > 0x1000u || (rest == 0x1000u && (h & 1u)))
+		++h;
+	return std::uint16_t(sign | h);
+}
+
+float HalfToFloat(std::uint16_t h)
+{
+	const std::uint32_t sign = std::uint32_t(h & 0x8000u) << 16;
+	const std::uint32_t exponent = (h >> 10) & 0x1fu;
+	const std::uint32_t mantissa = h & 0x3ffu;
+
+	if (exponent == 0)
+	{
+		const float value = std::ldexp(float(mantissa), -24);
+		return sign != 0 ? -value : value;
+	}
+
+	std::uint32_t bits;
+	if (exponent == 31)
+		bits = sign | 0x7f800000u | (mantissa << 13);
+	else
+		bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+PackedVertex Pack(const GeometryGenerator::Vertex& v, const PositionDequantization& dq)
+{
+	PackedVertex p;
+	p.Position[0] = FloatToSnorm16((v.Position.x - dq.Bias.x) / dq.Scale.x);
+	p.Position[1] = FloatToSnorm16((v.Position.y - dq.Bias.y) / dq.Scale.y);
+	p.Position[2] = FloatToSnorm16((v.Position.z - dq.Bias.z) / dq.Scale.z);
+	p.Position[3] = 0;
+	EncodeOctahedral(v.Normal, p.Normal);
+	p.TexC[0] = FloatToHalf(v.TexC.x);
+	p.TexC[1] = FloatToHalf(v.TexC.y);
+	EncodeOctahedral(v.TangentU, p.Tangent);
+	return p;
+}
+
+GeometryGenerator::Vertex Unpack(const PackedVertex& p, const PositionDequantization& dq)
+{
+	GeometryGenerator::Vertex v;
+	v.Position = XMFLOAT3(
+		Snorm16ToFloat(p.Position[0]) * dq.Scale.x + dq.Bias.x,
+		Snorm16ToFloat(p.Position[1]) * dq.Scale.y + dq.Bias.y,
+		Snorm16ToFloat(p.Position[2]) * dq.Scale.z + dq.Bias.z);
+	v.Normal = DecodeOctahedral(p.Normal);
+	v.TexC = XMFLOAT2(HalfToFloat(p.TexC[0]), HalfToFloat(p.TexC[1]));
+	v.TangentU = DecodeOctahedral(p.Tangent);
+	return v;
+}
+
+std::vector<PackedVertex> PackVertices(const GeometryGenerator::Vertex* vertices, size_t count,
+	const PositionDequantization& dq)
+{
+	std::vector<PackedVertex> packed(count);
+	for (size_t i = 0; i < count; ++i)
+		packed[i] = Pack(vertices[i], dq);
+	return packed;
+}
+
+RoundTripError MeasureRoundTripError(const GeometryGenerator::Vertex* vertices, size_t count,
+	const PositionDequantization& dq)
+{
+	RoundTripError error;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const GeometryGenerator::Vertex& a = vertices[i];
+		const GeometryGenerator::Vertex b = Unpack(Pack(a, dq), dq);
+
+		const XMFLOAT3 d(a.Position.x - b.Position.x, a.Position.y - b.Position.y, a.Position.z - b.Position.z);
+		error.Position = (std::max)(error.Position, Length(d));
+		error.NormalDegrees = (std::max)(error.NormalDegrees, AngleDegrees(a.Normal, b.Normal));
+		error.TangentDegrees = (std::max)(error.TangentDegrees, AngleDegrees(a.TangentU, b.TangentU));
+		error.TexC = (std::max)(error.TexC, (std::max)(std::fabs(a.TexC.x - b.TexC.x), std::fabs(a.TexC.y - b.TexC.y)));
+	}
+	return error;
+}
+
+} // namespace VertexPacking
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../Common/GeometryGenerator.h"
+
+// Compact 20-byte vertex used by the receiver geometry (model, box, grid):
+//   Position  4 x snorm16  position relative to the mesh bounds, w unused
+//   Normal    2 x snorm16  octahedral unit vector
+//   TexC      2 x float16
+//   Tangent   2 x snorm16  octahedral unit vector
+//
+// Positions are dequantized with PosL = q * Scale + Bias, where Scale and Bias
+// come from the mesh bounds and are passed to the shaders per object.  Must stay
+// in sync with PackedVertex and VertexIn in Shaders/VertexFormat.hlsl.
+namespace VertexPacking
+{
+	struct PackedVertex
+	{
+		std::int16_t Position[4];
+		std::int16_t Normal[2];
+		std::uint16_t TexC[2];
+		std::int16_t Tangent[2];
+	};
+
+	static_assert(sizeof(PackedVertex) == 20, "PackedVertex must match the packed input layout.");
+
+	struct PositionDequantization
+	{
+		DirectX::XMFLOAT3 Scale = { 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT3 Bias = { 0.0f, 0.0f, 0.0f };
+	};
+
+	// Maps [center - extents, center + extents] onto [-1, 1].
+	PositionDequantization MakeDequantization(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+	PositionDequantization ComputeDequantization(const GeometryGenerator::Vertex* vertices, size_t count);
+
+	void EncodeOctahedral(const DirectX::XMFLOAT3& n, std::int16_t out[2]);
+	DirectX::XMFLOAT3 DecodeOctahedral(const std::int16_t in[2]);
+
+	// IEEE half precision, round to nearest even.
+	std::uint16_t FloatToHalf(float f);
+	float HalfToFloat(std::uint16_t h);
+
+	PackedVertex Pack(const GeometryGenerator::Vertex& v, const PositionDequantization& dq);
+	GeometryGenerator::Vertex Unpack(const PackedVertex& p, const PositionDequantization& dq);
+
+	std::vector<PackedVertex> PackVertices(const GeometryGenerator::Vertex* vertices, size_t count,
+		const PositionDequantization& dq);
+
+	// Largest error of a pack/unpack round trip over a mesh.
+	struct RoundTripError
+	{
+		float Position = 0.0f;       // object space units
+		float NormalDegrees = 0.0f;
+		float TangentDegrees = 0.0f;
+		float TexC = 0.0f;
+	};
+
+	RoundTripError MeasureRoundTripError(const GeometryGenerator::Vertex* vertices, size_t count,
+		const PositionDequantization& dq);
+}
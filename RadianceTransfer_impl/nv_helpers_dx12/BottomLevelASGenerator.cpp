@@ -71,7 +71,7 @@ namespace nv_helpers_dx12
 	// float32 value. This implementation limits the original flexibility of the
 	// API:
 	//   - triangles (no custom intersector support)
-	//   - 3xfloat32 format
+	//   - 3xfloat32 format by default, or any format the DXR position fetch accepts
 	//   - 32-bit indices
 	void BottomLevelASGenerator::AddVertexBuffer(
 		ID3D12Resource* vertexBuffer, // Buffer containing the vertex coordinates,
@@ -89,19 +89,21 @@ namespace nv_helpers_dx12
 		// vertices. This buffer cannot be nullptr
 		const UINT64 transformOffsetInBytes, // Offset of the transform matrix in the
 		// transform buffer
-		const bool isOpaque /* = true */ // If true, the geometry is considered opaque,
+		const bool isOpaque /* = true */, // If true, the geometry is considered opaque,
 		// optimizing the search for a closest hit
+		const DXGI_FORMAT vertexFormat /* = DXGI_FORMAT_R32G32B32_FLOAT */ // Format of the position,
+		// the first element of each vertex
 	)
 	{
 		// Create the DX12 descriptor representing the input data, assumed to be
-		// opaque triangles, with 3xf32 vertex coordinates and 32-bit indices
+		// opaque triangles, with 3xf32 (or 'vertexFormat') vertex coordinates and 32-bit indices
 		D3D12_RAYTRACING_GEOMETRY_DESC descriptor;
 		descriptor.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
 		descriptor.Triangles.VertexBuffer.StartAddress =
 			vertexBuffer->GetGPUVirtualAddress() + vertexOffsetInBytes;
 		descriptor.Triangles.VertexBuffer.StrideInBytes = vertexSizeInBytes;
 		descriptor.Triangles.VertexCount = vertexCount;
-		descriptor.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+		descriptor.Triangles.VertexFormat = vertexFormat;
 		descriptor.Triangles.IndexBuffer =
 			indexBuffer
 				? (indexBuffer->GetGPUVirtualAddress() + indexOffsetInBytes)
@@ -122,8 +122,10 @@ namespace nv_helpers_dx12
                                                         /// be nullptr
 		                     UINT64 transformOffsetInBytes, /// Offset of the transform matrix in the
                                                         /// transform buffer
-		                     bool isOpaque = true /// If true, the geometry is considered opaque,
+		                     bool isOpaque = true, /// If true, the geometry is considered opaque,
                                             /// optimizing the search for a closest hit
+		                     DXGI_FORMAT vertexFormat = DXGI_FORMAT_R32G32B32_FLOAT /// Format of the position,
+                                            /// the first element of each vertex
 		);
 
 		/// Compute the size of the scratch space required to build the acceleration structure, as well as
@@ -32,6 +32,8 @@ dispatch rays description.
 
 #include "ShaderBindingTableGenerator.h"
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 // Helper to compute aligned buffer sizes
@@ -108,20 +110,30 @@ namespace nv_helpers_dx12
 		{
 			throw std::logic_error("Could not map the shader binding table");
 		}
+		Generate(pData, raytracingPipeline);
+
+		// Unmap the SBT
+		sbtBuffer->Unmap(0, nullptr);
+	}
+
+	//--------------------------------------------------------------------------------------------------
+	//
+	// Build the SBT into sbtData, which has to point to mapped upload memory large enough for
+	// ComputeSBTSize() bytes
+	void ShaderBindingTableGenerator::Generate(uint8_t* sbtData,
+		ID3D12StateObjectProperties* raytracingPipeline) const
+	{
 		// Copy the shader identifiers followed by their resource pointers or root constants: first the
 		// ray generation, then the miss shaders, and finally the set of hit groups
 		uint32_t offset = 0;
 
-		offset = CopyShaderData(raytracingPipeline, pData, m_rayGen, m_rayGenEntrySize);
-		pData += offset;
+		offset = CopyShaderData(raytracingPipeline, sbtData, m_rayGen, m_rayGenEntrySize);
+		sbtData += offset;
 
-		offset = CopyShaderData(raytracingPipeline, pData, m_miss, m_missEntrySize);
-		pData += offset;
+		offset = CopyShaderData(raytracingPipeline, sbtData, m_miss, m_missEntrySize);
+		sbtData += offset;
 
-		offset = CopyShaderData(raytracingPipeline, pData, m_hitGroup, m_hitGroupEntrySize);
-
-		// Unmap the SBT
-		sbtBuffer->Unmap(0, nullptr);
+		offset = CopyShaderData(raytracingPipeline, sbtData, m_hitGroup, m_hitGroupEntrySize);
 	}
 
 	//--------------------------------------------------------------------------------------------------
@@ -232,7 +244,7 @@ namespace nv_helpers_dx12
 		size_t maxArgs = 0;
 		for (const auto& shader : entries)
 		{
-			maxArgs = max(maxArgs, shader.m_inputData.size());
+			maxArgs = (std::max)(maxArgs, shader.m_inputData.size());
 		}
 		// A SBT entry is made of a program ID and a set of parameters, taking 8 bytes each. Those
 		// parameters can either be 8-bytes pointers, or 4-bytes constants
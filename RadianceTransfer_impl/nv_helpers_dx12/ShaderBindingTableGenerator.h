@@ -140,6 +140,10 @@ namespace nv_helpers_dx12
 		void Generate(ID3D12Resource* sbtBuffer,
 		              ID3D12StateObjectProperties* raytracingPipeline) const;
 
+		/// Build the SBT into sbtData, mapped upload memory of at least ComputeSBTSize() bytes
+		void Generate(uint8_t* sbtData,
+		              ID3D12StateObjectProperties* raytracingPipeline) const;
+
 		/// Reset the sets of programs and hit groups
 		void Reset();
 
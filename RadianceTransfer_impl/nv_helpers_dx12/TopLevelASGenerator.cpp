@@ -47,6 +47,7 @@ buffer needs to be kept until the command list execution is finished.
 
 #include "TopLevelASGenerator.h"
 
+#include <cstring>
 #include <stdexcept>
 
 // Helper to compute aligned buffer sizes
@@ -170,34 +171,13 @@ namespace nv_helpers_dx12
 				"in the upload heap?");
 		}
 
-		const auto instanceCount = static_cast<UINT>(m_instances.size());
-
 		// Initialize the memory to zero on the first time only
 		if (!updateOnly)
 		{
-			ZeroMemory(instanceDescs, m_instanceDescsSizeInBytes);
+			memset(instanceDescs, 0, m_instanceDescsSizeInBytes);
 		}
 
-		// Create the description for each instance
-		for (uint32_t i = 0; i < instanceCount; i++)
-		{
-			// Instance ID visible in the shader in InstanceID()
-			instanceDescs[i].InstanceID = m_instances[i].instanceID;
-			// Index of the hit group invoked upon intersection
-			instanceDescs[i].InstanceContributionToHitGroupIndex = m_instances[i].hitGroupIndex;
-			// Instance flags, including backface culling, winding, etc - TODO: should
-			// be accessible from outside
-			instanceDescs[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-			// Instance transform matrix
-			DirectX::XMMATRIX m = XMMatrixTranspose(
-				m_instances[i].transform); // GLM is column major, the INSTANCE_DESC is row major
-			memcpy(instanceDescs[i].Transform, &m, sizeof(instanceDescs[i].Transform));
-			// Get access to the bottom level
-			instanceDescs[i].AccelerationStructure = m_instances[i].bottomLevelAS->GetGPUVirtualAddress();
-			// Visibility mask, always visible here - TODO: should be accessible from
-			// outside
-			instanceDescs[i].InstanceMask = 0xFF;
-		}
+		WriteInstanceDescs(instanceDescs, true);
 
 		descriptorsBuffer->Unmap(0, nullptr);
 
@@ -229,7 +209,7 @@ namespace nv_helpers_dx12
 		buildDesc.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 		buildDesc.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 		buildDesc.Inputs.InstanceDescs = descriptorsBuffer->GetGPUVirtualAddress();
-		buildDesc.Inputs.NumDescs = instanceCount;
+		buildDesc.Inputs.NumDescs = static_cast<UINT>(m_instances.size());
 		buildDesc.DestAccelerationStructureData = {
 			resultBuffer->GetGPUVirtualAddress()
 		};
@@ -252,6 +232,43 @@ namespace nv_helpers_dx12
 		commandList->ResourceBarrier(1, &uavBarrier);
 	}
 
+	//--------------------------------------------------------------------------------------------------
+	//
+	// Write the instance descriptors, one per instance in the order they were added
+	void TopLevelASGenerator::WriteInstanceDescs(
+		D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs, // At least one per instance
+		const bool updateOnly /*= false*/ // If false, the descriptors are cleared first
+	) const
+	{
+		const auto instanceCount = static_cast<UINT>(m_instances.size());
+
+		if (!updateOnly)
+		{
+			memset(instanceDescs, 0, sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceCount);
+		}
+
+		// Create the description for each instance
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			// Instance ID visible in the shader in InstanceID()
+			instanceDescs[i].InstanceID = m_instances[i].instanceID;
+			// Index of the hit group invoked upon intersection
+			instanceDescs[i].InstanceContributionToHitGroupIndex = m_instances[i].hitGroupIndex;
+			// Instance flags, including backface culling, winding, etc - TODO: should
+			// be accessible from outside
+			instanceDescs[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+			// Instance transform matrix
+			DirectX::XMMATRIX m = XMMatrixTranspose(
+				m_instances[i].transform); // GLM is column major, the INSTANCE_DESC is row major
+			memcpy(instanceDescs[i].Transform, &m, sizeof(instanceDescs[i].Transform));
+			// Get access to the bottom level
+			instanceDescs[i].AccelerationStructure = m_instances[i].bottomLevelAS->GetGPUVirtualAddress();
+			// Visibility mask, always visible here - TODO: should be accessible from
+			// outside
+			instanceDescs[i].InstanceMask = 0xFF;
+		}
+	}
+
 	//--------------------------------------------------------------------------------------------------
 	//
 	//
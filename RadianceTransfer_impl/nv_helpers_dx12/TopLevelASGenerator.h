@@ -130,6 +130,13 @@ namespace nv_helpers_dx12
                                                /// if an iterative update is requested
 		);
 
+		/// Write the instance descriptors Generate() copies to the descriptors buffer,
+		/// one per instance in the order they were added. Needs no device, so the
+		/// layout can be checked and timed on the CPU alone
+		void WriteInstanceDescs(D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs, /// At least one per instance
+		                        bool updateOnly = false /// If false, the descriptors are cleared first
+		) const;
+
 	private:
 		/// Helper struct storing the instance data
 		struct Instance